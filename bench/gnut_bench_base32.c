@@ -0,0 +1,153 @@
+/*
+ * Copyright 2006-2007 Andrew De Ponte
+ *
+ * This file is part of lib_gnut.
+ *
+ * lib_gnut is the intellectual property of Andrew De Ponte; any
+ * distribution and/or modification and/or reproductions of any portion
+ * of lib_gnut MUST be approved by Andrew De Ponte.
+ *
+ * lib_gnut is distributed WITHOUT ANY WARRANTY; without even the
+ * implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE.
+ */
+
+/**
+ * @file gnut_bench_base32.c
+ * @brief This is a microbenchmark of urn:sha1 handling.
+ *
+ * The gnut_bench_base32.c file is a benchmark program that measures
+ * encoding and decoding SHA-1 digests in base32 with the fixed length
+ * functions against the general ones, and resolving a by-hash Query,
+ * from parsing its urn:sha1 value to finding the file, in an index of
+ * NUM_FILES files.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "harness.h"
+#include "gnut_base32.h"
+#include "gnut_index.h"
+
+#define NUM_DIGESTS 1024
+#define NUM_FILES 100000
+
+static unsigned char digests[NUM_DIGESTS][GNUT_SHA1_LEN];
+static char encoded[NUM_DIGESTS][GNUT_BASE32_SHA1_LEN];
+static char urns[NUM_DIGESTS][GNUT_URN_SHA1_LEN];
+static gnut_index_t *idx;
+static gnut_uint64_t rng = 0x9E3779B97F4A7C15ULL;
+
+static sxs_uint32_t rand32(void) {
+    rng ^= rng << 13;
+    rng ^= rng >> 7;
+    rng ^= rng << 17;
+    return (sxs_uint32_t)(rng >> 32);
+}
+
+static void setup(void) {
+    unsigned char sha1[GNUT_SHA1_LEN];
+    char name[32];
+    sxs_uint32_t file_index;
+    int i, j, len;
+
+    gnut_index_new(&idx);
+    for (i = 0; i < NUM_FILES; i++) {
+        len = snprintf(name, sizeof(name), "file %d.mp3", i);
+        gnut_index_add(idx, name, len, i, &file_index);
+        for (j = 0; j < GNUT_SHA1_LEN; j++) {
+            sha1[j] = (unsigned char)rand32();
+        }
+        gnut_index_set_sha1(idx, file_index, sha1);
+        /* Half of the looked up digests are shared files. */
+        if (i % (NUM_FILES / (NUM_DIGESTS / 2)) == 0 &&
+            i / (NUM_FILES / (NUM_DIGESTS / 2)) < NUM_DIGESTS / 2) {
+            memcpy(digests[i / (NUM_FILES / (NUM_DIGESTS / 2))], sha1,
+                GNUT_SHA1_LEN);
+        }
+    }
+    for (i = NUM_DIGESTS / 2; i < NUM_DIGESTS; i++) {
+        for (j = 0; j < GNUT_SHA1_LEN; j++) {
+            digests[i][j] = (unsigned char)rand32();
+        }
+    }
+    for (i = 0; i < NUM_DIGESTS; i++) {
+        gnut_base32_encode_sha1(digests[i], encoded[i]);
+        gnut_urn_sha1_format(digests[i], urns[i]);
+    }
+}
+
+static void bench_encode_sha1(void *arg, long iters) {
+    char out[GNUT_BASE32_SHA1_LEN];
+    long i;
+
+    for (i = 0; i < iters; i++) {
+        gnut_base32_encode_sha1(digests[i % NUM_DIGESTS], out);
+        BENCH_KEEP(out);
+    }
+}
+
+static void bench_encode(void *arg, long iters) {
+    char out[GNUT_BASE32_SHA1_LEN];
+    long i;
+
+    for (i = 0; i < iters; i++) {
+        gnut_base32_encode(digests[i % NUM_DIGESTS], GNUT_SHA1_LEN, out);
+        BENCH_KEEP(out);
+    }
+}
+
+static void bench_decode_sha1(void *arg, long iters) {
+    unsigned char sha1[GNUT_SHA1_LEN];
+    long i;
+
+    for (i = 0; i < iters; i++) {
+        gnut_base32_decode_sha1(encoded[i % NUM_DIGESTS], sha1);
+        BENCH_KEEP(sha1);
+    }
+}
+
+static void bench_decode(void *arg, long iters) {
+    unsigned char sha1[GNUT_SHA1_LEN];
+    sxs_uint32_t len;
+    long i;
+
+    for (i = 0; i < iters; i++) {
+        gnut_base32_decode(encoded[i % NUM_DIGESTS], GNUT_BASE32_SHA1_LEN,
+            sha1, &len);
+        BENCH_KEEP(sha1);
+    }
+}
+
+static void bench_resolve(void *arg, long iters) {
+    unsigned char sha1[GNUT_SHA1_LEN];
+    sxs_uint32_t file_index, found;
+    long i;
+
+    found = 0;
+    for (i = 0; i < iters; i++) {
+        gnut_urn_sha1_parse(urns[i % NUM_DIGESTS], GNUT_URN_SHA1_LEN, sha1);
+        found += (gnut_index_find_sha1(idx, sha1, &file_index) ==
+            GNUT_SUCCESS);
+    }
+    BENCH_KEEP(&found);
+}
+
+int main(int argc, char *argv[]) {
+    bench_init(argc, argv);
+    setup();
+
+    bench_run("base32", "encode_sha1", bench_encode_sha1, NULL,
+        GNUT_SHA1_LEN);
+    bench_run("base32", "encode_general", bench_encode, NULL,
+        GNUT_SHA1_LEN);
+    bench_run("base32", "decode_sha1", bench_decode_sha1, NULL,
+        GNUT_BASE32_SHA1_LEN);
+    bench_run("base32", "decode_general", bench_decode, NULL,
+        GNUT_BASE32_SHA1_LEN);
+    bench_run("base32", "resolve_urn", bench_resolve, NULL, 0);
+
+    gnut_index_free(idx);
+    return 0;
+}
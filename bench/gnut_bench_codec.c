@@ -0,0 +1,214 @@
+/*
+ * Copyright 2006-2007 Andrew De Ponte
+ *
+ * This file is part of lib_gnut.
+ *
+ * lib_gnut is the intellectual property of Andrew De Ponte; any
+ * distribution and/or modification and/or reproductions of any portion
+ * of lib_gnut MUST be approved by Andrew De Ponte.
+ *
+ * lib_gnut is distributed WITHOUT ANY WARRANTY; without even the
+ * implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE.
+ */
+
+/**
+ * @file gnut_bench_codec.c
+ * @brief This is a microbenchmark of the message codecs.
+ *
+ * The gnut_bench_codec.c file is a benchmark program that measures the
+ * time per operation and throughput of building Message IDs and
+ * Message Headers, converting headers to and from the wire, and each
+ * payload parse, build and length function. Ping has an empty payload
+ * and so has no functions to measure. Parsers cycle through a set of
+ * distinct inputs so that their branches are not trivially predicted.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "harness.h"
+#include "gnut_msgs.h"
+
+#define NUM_INPUTS 64
+
+static gnut_msg_hdr_t hdrs[NUM_INPUTS];
+static unsigned char wire_hdrs[NUM_INPUTS][GNUT_MSG_HDR_LEN];
+static gnut_pong_payload_t pongs[NUM_INPUTS];
+static unsigned char wire_pongs[NUM_INPUTS][GNUT_PONG_PAYLOAD_LEN];
+static gnut_bye_payload_t byes[NUM_INPUTS];
+static unsigned char wire_byes[NUM_INPUTS][64];
+static sxs_uint32_t wire_bye_lens[NUM_INPUTS];
+
+static void setup(void) {
+    char desc[64];
+    int i;
+
+    for (i = 0; i < NUM_INPUTS; i++) {
+        gnut_build_msg_hdr(&hdrs[i], GNUT_MSG_QUERY, 20 + i);
+        hdrs[i].hops = i % 7;
+        gnut_encode_msg_hdr(&hdrs[i], wire_hdrs[i]);
+
+        pongs[i].port_num = 6346 + i;
+        pongs[i].ip_addr.s_addr = 0x0a000001 + i * 7919;
+        pongs[i].num_shared_files = i * 131;
+        pongs[i].kb_shared = i * 40960;
+        _gnut_build_pong_msg_payload(&pongs[i], wire_pongs[i]);
+
+        snprintf(desc, sizeof(desc), "%d Shutting down after %d minutes",
+            200 + i, i * 37);
+        byes[i].code = 200 + i;
+        byes[i].desc_string = strdup(desc);
+        byes[i].desc_string_len = strlen(desc) + 1;
+        _gnut_build_bye_msg_payload(&byes[i], wire_byes[i]);
+        wire_bye_lens[i] = _gnut_calc_bye_msg_payload_len(&byes[i]);
+    }
+}
+
+static void bench_msg_id(void *arg, long iters) {
+    gnut_msg_hdr_t hdr;
+    long i;
+
+    for (i = 0; i < iters; i++) {
+        gnut_build_msg_id(&hdr);
+        BENCH_KEEP(&hdr);
+    }
+}
+
+static void bench_msg_hdr(void *arg, long iters) {
+    gnut_msg_hdr_t hdr;
+    long i;
+
+    for (i = 0; i < iters; i++) {
+        gnut_build_msg_hdr(&hdr, GNUT_MSG_QUERY, (sxs_uint32_t)i);
+        BENCH_KEEP(&hdr);
+    }
+}
+
+static void bench_msg_hdr_given_msg_id(void *arg, long iters) {
+    gnut_msg_hdr_t hdr;
+    long i;
+
+    for (i = 0; i < iters; i++) {
+        gnut_build_msg_hdr_given_msg_id(&hdr,
+            hdrs[i % NUM_INPUTS].message_id, GNUT_MSG_QUERY_HIT,
+            (sxs_uint32_t)i);
+        BENCH_KEEP(&hdr);
+    }
+}
+
+static void bench_encode_msg_hdr(void *arg, long iters) {
+    unsigned char buf[GNUT_MSG_HDR_LEN];
+    long i;
+
+    for (i = 0; i < iters; i++) {
+        gnut_encode_msg_hdr(&hdrs[i % NUM_INPUTS], buf);
+        BENCH_KEEP(buf);
+    }
+}
+
+static void bench_decode_msg_hdr(void *arg, long iters) {
+    gnut_msg_hdr_t hdr;
+    long i;
+
+    for (i = 0; i < iters; i++) {
+        gnut_decode_msg_hdr(wire_hdrs[i % NUM_INPUTS], &hdr);
+        BENCH_KEEP(&hdr);
+    }
+}
+
+static void bench_pong_parse(void *arg, long iters) {
+    gnut_pong_payload_t pl;
+    long i;
+
+    for (i = 0; i < iters; i++) {
+        _gnut_parse_pong_msg_payload(&pl, wire_pongs[i % NUM_INPUTS],
+            GNUT_PONG_PAYLOAD_LEN);
+        BENCH_KEEP(&pl);
+    }
+}
+
+static void bench_pong_build(void *arg, long iters) {
+    unsigned char buf[GNUT_PONG_PAYLOAD_LEN];
+    long i;
+
+    for (i = 0; i < iters; i++) {
+        _gnut_build_pong_msg_payload(&pongs[i % NUM_INPUTS], buf);
+        BENCH_KEEP(buf);
+    }
+}
+
+static void bench_pong_calc(void *arg, long iters) {
+    volatile int len;
+    long i;
+
+    for (i = 0; i < iters; i++) {
+        len = _gnut_calc_pong_msg_payload_len(&pongs[i % NUM_INPUTS]);
+    }
+    (void)len;
+}
+
+static void bench_bye_parse(void *arg, long iters) {
+    gnut_bye_payload_t pl;
+    long i;
+
+    for (i = 0; i < iters; i++) {
+        _gnut_parse_bye_msg_payload(&pl, wire_byes[i % NUM_INPUTS],
+            wire_bye_lens[i % NUM_INPUTS]);
+        BENCH_KEEP(&pl);
+        _gnut_free_bye_msg_payload(&pl);
+    }
+}
+
+static void bench_bye_build(void *arg, long iters) {
+    unsigned char buf[64];
+    long i;
+
+    for (i = 0; i < iters; i++) {
+        _gnut_build_bye_msg_payload(&byes[i % NUM_INPUTS], buf);
+        BENCH_KEEP(buf);
+    }
+}
+
+static void bench_bye_calc(void *arg, long iters) {
+    volatile int len;
+    long i;
+
+    for (i = 0; i < iters; i++) {
+        len = _gnut_calc_bye_msg_payload_len(&byes[i % NUM_INPUTS]);
+    }
+    (void)len;
+}
+
+int main(int argc, char *argv[]) {
+    int i;
+
+    bench_init(argc, argv);
+    setup();
+
+    bench_run("codec", "build_msg_id", bench_msg_id, NULL, GNUT_MSG_ID_LEN);
+    bench_run("codec", "build_msg_hdr", bench_msg_hdr, NULL,
+        GNUT_MSG_HDR_LEN);
+    bench_run("codec", "build_msg_hdr_given_msg_id",
+        bench_msg_hdr_given_msg_id, NULL, GNUT_MSG_HDR_LEN);
+    bench_run("codec", "encode_msg_hdr", bench_encode_msg_hdr, NULL,
+        GNUT_MSG_HDR_LEN);
+    bench_run("codec", "decode_msg_hdr", bench_decode_msg_hdr, NULL,
+        GNUT_MSG_HDR_LEN);
+    bench_run("codec", "pong_parse", bench_pong_parse, NULL,
+        GNUT_PONG_PAYLOAD_LEN);
+    bench_run("codec", "pong_build", bench_pong_build, NULL,
+        GNUT_PONG_PAYLOAD_LEN);
+    bench_run("codec", "pong_calc", bench_pong_calc, NULL, 0);
+    bench_run("codec", "bye_parse", bench_bye_parse, NULL,
+        wire_bye_lens[0]);
+    bench_run("codec", "bye_build", bench_bye_build, NULL,
+        wire_bye_lens[0]);
+    bench_run("codec", "bye_calc", bench_bye_calc, NULL, 0);
+
+    for (i = 0; i < NUM_INPUTS; i++) {
+        _gnut_free_bye_msg_payload(&byes[i]);
+    }
+
+    return 0;
+}
@@ -0,0 +1,154 @@
+/*
+ * Copyright 2006-2007 Andrew De Ponte
+ *
+ * This file is part of lib_gnut.
+ *
+ * lib_gnut is the intellectual property of Andrew De Ponte; any
+ * distribution and/or modification and/or reproductions of any portion
+ * of lib_gnut MUST be approved by Andrew De Ponte.
+ *
+ * lib_gnut is distributed WITHOUT ANY WARRANTY; without even the
+ * implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE.
+ */
+
+/**
+ * @file gnut_bench_deflate.c
+ * @brief This is a benchmark for deflate link compression.
+ *
+ * The gnut_bench_deflate.c file is a benchmark program that measures
+ * the per message cost and the compression ratio of gnut_deflate_t on
+ * a stream of Gnutella-like messages, flushing every 'burst' messages
+ * the way a connection does when its output queue goes idle. The
+ * inflated stream is checked against the messages sent.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "gnut_deflate.h"
+
+#define NUM_MSGS 200000
+#define OUT_CAP 65536
+
+static const char *words[] = {
+    "mp3", "live", "remix", "beatles", "mozart", "linux", "iso", "avi",
+    "the", "of", "concert", "2007", "album", "ogg", "flac", "bootleg"
+};
+
+static double now_ns(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (ts.tv_sec * 1e9) + ts.tv_nsec;
+}
+
+/* Fill 'buf' with a message shaped like a Query: a 23 byte header with
+ * a random GUID, then a short keyword search string. */
+static sxs_uint32_t make_msg(unsigned char *buf, unsigned int seed) {
+    sxs_uint32_t len, i, nwords;
+
+    for (i = 0; i < 16; i++) {
+        buf[i] = (unsigned char)rand();
+    }
+    buf[16] = 0x80;
+    buf[17] = 0x07 - (seed % 4);
+    buf[18] = seed % 4;
+    len = 23;
+    buf[len++] = 0;
+    buf[len++] = 0;
+    nwords = 1 + (seed % 4);
+    for (i = 0; i < nwords; i++) {
+        const char *w = words[rand() % 16];
+        memcpy(buf + len, w, strlen(w));
+        len += strlen(w);
+        buf[len++] = ' ';
+    }
+    buf[len - 1] = 0;
+    buf[19] = (unsigned char)(len - 23);
+    buf[20] = buf[21] = buf[22] = 0;
+
+    return len;
+}
+
+static void run(int burst) {
+    static unsigned char msgs[NUM_MSGS][128];
+    static sxs_uint32_t lens[NUM_MSGS];
+    static unsigned char comp[OUT_CAP], plain[OUT_CAP];
+    gnut_deflate_budget_t budget;
+    gnut_deflate_stats_t st;
+    gnut_deflate_t *tx, *rx;
+    sxs_uint32_t used, out_len, dused, dlen, voff, j;
+    double t0, t_comp, t_decomp;
+    int i, vmsg;
+
+    srand(1);
+    for (i = 0; i < NUM_MSGS; i++) {
+        lens[i] = make_msg(msgs[i], (unsigned int)i);
+    }
+
+    memset(&budget, 0, sizeof(budget));
+    if (gnut_deflate_new(&tx, NULL, &budget) != GNUT_SUCCESS ||
+        gnut_deflate_new(&rx, NULL, &budget) != GNUT_SUCCESS) {
+        fprintf(stderr, "failed to create deflate links\n");
+        exit(1);
+    }
+
+    t_comp = t_decomp = 0;
+    vmsg = 0;
+    voff = 0;
+    for (i = 0; i < NUM_MSGS; i++) {
+        t0 = now_ns();
+        gnut_deflate_compress(tx, msgs[i], lens[i], comp, OUT_CAP, &used,
+            &out_len);
+        if ((i + 1) % burst == 0) {
+            sxs_uint32_t flen;
+
+            gnut_deflate_flush(tx, comp + out_len, OUT_CAP - out_len, &flen);
+            out_len += flen;
+        }
+        t_comp += now_ns() - t0;
+
+        t0 = now_ns();
+        gnut_deflate_decompress(rx, comp, out_len, plain, OUT_CAP, &dused,
+            &dlen);
+        t_decomp += now_ns() - t0;
+
+        for (j = 0; j < dlen; j++) {
+            if (vmsg >= NUM_MSGS || plain[j] != msgs[vmsg][voff]) {
+                fprintf(stderr, "burst=%d: stream differs in msg %d\n",
+                    burst, vmsg);
+                exit(1);
+            }
+            if (++voff == lens[vmsg]) {
+                vmsg++;
+                voff = 0;
+            }
+        }
+    }
+    if (vmsg != NUM_MSGS) {
+        fprintf(stderr, "burst=%d: only %d msgs came through\n", burst,
+            vmsg);
+        exit(1);
+    }
+
+    gnut_deflate_get_stats(tx, &st);
+    printf("deflate\tburst=%d\tcompress_ns_per_msg=%.1f\t"
+        "decompress_ns_per_msg=%.1f\tratio=%.3f\tflushes=%u\t"
+        "tx_mem=%u\tpeak_budget=%u\n", burst, t_comp / NUM_MSGS,
+        t_decomp / NUM_MSGS, (double)st.out_comp / (double)st.out_raw,
+        st.flushes, st.mem, budget.peak);
+
+    gnut_deflate_free(tx);
+    gnut_deflate_free(rx);
+}
+
+int main(int argc, char *argv[]) {
+    run(1);
+    run(8);
+    run(64);
+
+    return 0;
+}
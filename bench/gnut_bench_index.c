@@ -0,0 +1,231 @@
+/*
+ * Copyright 2006-2007 Andrew De Ponte
+ *
+ * This file is part of lib_gnut.
+ *
+ * lib_gnut is the intellectual property of Andrew De Ponte; any
+ * distribution and/or modification and/or reproductions of any portion
+ * of lib_gnut MUST be approved by Andrew De Ponte.
+ *
+ * lib_gnut is distributed WITHOUT ANY WARRANTY; without even the
+ * implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE.
+ */
+
+/**
+ * @file gnut_bench_index.c
+ * @brief This is a microbenchmark of the shared file index.
+ *
+ * The gnut_bench_index.c file is a benchmark program that builds an
+ * index of NUM_FILES synthetic file names, whose words are drawn from a
+ * vocabulary with a skewed distribution like that of real names, and
+ * measures the time to answer a Query of one, two and three keywords
+ * into a Query Hit, against a linear scan of the lower cased names for
+ * the same keywords, and through a Query result cache, which after the
+ * first pass answers every Query from its entries. Each Query is made of
+ * words of one of the names, so it matches at least one file. It prints
+ * the size of the index first, and the counters of the cache last.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "harness.h"
+#include "gnut_index.h"
+#include "gnut_qcache.h"
+
+#define NUM_FILES 100000
+#define NUM_WORDS 30000
+#define NUM_QUERIES 256
+#define MAX_RESULTS 64
+#define NAME_LEN 128
+
+typedef struct query_set {
+    gnut_query_t q[NUM_QUERIES];
+    char kws[NUM_QUERIES][3][16];
+    int num_kws;
+} query_set_t;
+
+static gnut_index_t *idx;
+static gnut_qcache_t *qc;
+static char words[NUM_WORDS][12];
+static char *names;                 /* Lower cased, null terminated */
+static query_set_t sets[3];
+static unsigned char hit_buf[65536];
+static gnut_uint64_t rng = 0x9E3779B97F4A7C15ULL;
+
+static sxs_uint32_t rand32(void) {
+    rng ^= rng << 13;
+    rng ^= rng >> 7;
+    rng ^= rng << 17;
+    return (sxs_uint32_t)(rng >> 32);
+}
+
+/* Picks a word, the first ones far more often than the last. */
+static const char *pick_word(void) {
+    double u;
+
+    u = (rand32() + 0.5) / 4294967296.0;
+    return words[(int)(u * u * u * NUM_WORDS)];
+}
+
+static void setup(void) {
+    static const char seps[] = " _-";
+    char name[NAME_LEN], *kw, *p;
+    const char *name_p;
+    sxs_uint32_t name_len, size;
+    double start;
+    struct timespec ts;
+    gnut_index_stats_t st;
+    int i, j, k, n, len;
+
+    for (i = 0; i < NUM_WORDS; i++) {
+        len = 3 + rand32() % 8;
+        for (j = 0; j < len; j++) {
+            words[i][j] = 'a' + rand32() % 26;
+        }
+        words[i][len] = '\0';
+    }
+
+    names = (char *)malloc((size_t)NUM_FILES * NAME_LEN);
+    gnut_index_new(&idx);
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    start = ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+    for (i = 0; i < NUM_FILES; i++) {
+        n = 3 + rand32() % 6;
+        len = 0;
+        for (j = 0; j < n; j++) {
+            len += snprintf(name + len, sizeof(name) - len, "%s%c",
+                pick_word(), (j + 1 < n) ? seps[rand32() % 3] : '.');
+        }
+        len += snprintf(name + len, sizeof(name) - len, "mp3");
+        /* Some upper case, which the index folds. */
+        name[0] = 'A' + (name[0] - 'a');
+        gnut_index_add(idx, name, len, rand32(), NULL);
+        for (j = 0; j <= len; j++) {
+            names[(size_t)i * NAME_LEN + j] = (name[j] >= 'A' &&
+                name[j] <= 'Z') ? name[j] + ('a' - 'A') : name[j];
+        }
+    }
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    gnut_index_stats(idx, &st);
+    printf("index\tfiles=%u\tkeywords=%u\tpostings=%llu\tlist_bytes=%llu"
+        "\tbytes_per_posting=%.2f\tbuild_ms=%.1f\n", st.files, st.keywords,
+        (unsigned long long)st.postings, (unsigned long long)st.list_bytes,
+        (double)st.list_bytes / st.postings,
+        ts.tv_sec * 1e3 + ts.tv_nsec / 1e6 - start);
+
+    /* Queries of k keywords taken from the words of a random name. */
+    for (k = 0; k < 3; k++) {
+        sets[k].num_kws = k + 1;
+        for (i = 0; i < NUM_QUERIES; i++) {
+            gnut_index_file(idx, rand32() % NUM_FILES, &name_p, &name_len,
+                &size);
+            for (j = 0; j < (int)name_len; j++) {
+                name[j] = (name_p[j] >= 'A' && name_p[j] <= 'Z') ?
+                    name_p[j] + ('a' - 'A') : name_p[j];
+            }
+            name[name_len] = '\0';
+            p = name;
+            n = 0;
+            while (n <= k && (kw = strtok(p, " _-.")) != NULL) {
+                p = NULL;
+                if (strlen(kw) >= 3 && strcmp(kw, "mp3") != 0) {
+                    snprintf(sets[k].kws[i][n], 16, "%s", kw);
+                    n++;
+                }
+            }
+            for (j = n; j <= k; j++) {
+                strcpy(sets[k].kws[i][j], sets[k].kws[i][0]);
+            }
+            sets[k].q[i].criteria = (const char *)malloc(64);
+            len = 0;
+            for (j = 0; j <= k; j++) {
+                len += sprintf((char *)sets[k].q[i].criteria + len, "%s%s",
+                    (j > 0) ? " " : "", sets[k].kws[i][j]);
+            }
+            sets[k].q[i].criteria_len = len;
+        }
+    }
+}
+
+static void bench_answer(void *arg, long iters) {
+    query_set_t *s;
+    gnut_qhit_t h;
+    long i;
+
+    s = (query_set_t *)arg;
+    for (i = 0; i < iters; i++) {
+        gnut_qhit_begin(&h, hit_buf, sizeof(hit_buf), 6346, 0, 1000);
+        gnut_index_answer(idx, &s->q[i % NUM_QUERIES], &h, MAX_RESULTS);
+        BENCH_KEEP(hit_buf);
+    }
+}
+
+static void bench_cached(void *arg, long iters) {
+    query_set_t *s;
+    gnut_qhit_t h;
+    long i;
+
+    s = (query_set_t *)arg;
+    for (i = 0; i < iters; i++) {
+        gnut_qhit_begin(&h, hit_buf, sizeof(hit_buf), 6346, 0, 1000);
+        gnut_qcache_answer(qc, &s->q[i % NUM_QUERIES], &h, MAX_RESULTS);
+        BENCH_KEEP(hit_buf);
+    }
+}
+
+static void bench_scan(void *arg, long iters) {
+    query_set_t *s;
+    const char *name;
+    int q, f, j, found;
+    long i;
+
+    s = (query_set_t *)arg;
+    for (i = 0; i < iters; i++) {
+        q = i % NUM_QUERIES;
+        found = 0;
+        for (f = 0; f < NUM_FILES && found < MAX_RESULTS; f++) {
+            name = names + (size_t)f * NAME_LEN;
+            for (j = 0; j < s->num_kws; j++) {
+                if (strstr(name, s->kws[q][j]) == NULL) {
+                    break;
+                }
+            }
+            found += (j == s->num_kws);
+        }
+        BENCH_KEEP(&found);
+    }
+}
+
+int main(int argc, char *argv[]) {
+    gnut_qcache_stats_t st;
+
+    bench_init(argc, argv);
+    setup();
+    gnut_qcache_new(&qc, idx, 0, 0);
+
+    bench_run("index", "answer_1kw", bench_answer, &sets[0], 0);
+    bench_run("index", "answer_2kw", bench_answer, &sets[1], 0);
+    bench_run("index", "answer_3kw", bench_answer, &sets[2], 0);
+    bench_run("index", "cached_1kw", bench_cached, &sets[0], 0);
+    bench_run("index", "cached_2kw", bench_cached, &sets[1], 0);
+    bench_run("index", "cached_3kw", bench_cached, &sets[2], 0);
+    bench_run("index", "scan_1kw", bench_scan, &sets[0], 0);
+    bench_run("index", "scan_2kw", bench_scan, &sets[1], 0);
+    bench_run("index", "scan_3kw", bench_scan, &sets[2], 0);
+
+    gnut_qcache_stats(qc, &st);
+    printf("qcache\thits=%llu\tmisses=%llu\tevictions=%llu\tentries=%u"
+        "\tbytes=%u\n", (unsigned long long)st.hits,
+        (unsigned long long)st.misses, (unsigned long long)st.evictions,
+        st.entries, st.bytes);
+
+    gnut_qcache_free(qc);
+    gnut_index_free(idx);
+    free(names);
+    return 0;
+}
@@ -0,0 +1,215 @@
+/*
+ * Copyright 2006-2007 Andrew De Ponte
+ *
+ * This file is part of lib_gnut.
+ *
+ * lib_gnut is the intellectual property of Andrew De Ponte; any
+ * distribution and/or modification and/or reproductions of any portion
+ * of lib_gnut MUST be approved by Andrew De Ponte.
+ *
+ * lib_gnut is distributed WITHOUT ANY WARRANTY; without even the
+ * implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE.
+ */
+
+/**
+ * @file gnut_bench_mpsc.c
+ * @brief This is a contention benchmark for the MPSC ring.
+ *
+ * The gnut_bench_mpsc.c file is a benchmark program that measures the
+ * throughput of handing encoded messages from several producer threads
+ * to one consumer thread through gnut_mpsc_t, singly and in batches,
+ * against a mutex-protected deque with a condition variable, which is
+ * what a relay uses without it. The consumer sleeps whenever the queue
+ * is empty, so the cost of waking it is included.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <sched.h>
+
+#include "gnut_mpsc.h"
+#include "gnut_enc_msg.h"
+
+#define ITEMS_PER_PRODUCER 500000
+#define QUEUE_LEN 4096
+#define MAX_PRODUCERS 8
+#define BATCH 32
+
+static double now_ns(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (ts.tv_sec * 1e9) + ts.tv_nsec;
+}
+
+/* A bounded deque guarded by one mutex, with condition variables for
+ * the sleeping consumer and for producers waiting on a full deque. */
+typedef struct locked_deque {
+    pthread_mutex_t lock;
+    pthread_cond_t not_empty;
+    pthread_cond_t not_full;
+    void **slots;
+    unsigned int head, count, cap;
+} locked_deque_t;
+
+typedef struct bench {
+    int use_mpsc;
+    int batch;
+    gnut_mpsc_t q;
+    locked_deque_t d;
+    gnut_enc_msg_t *msg;
+} bench_t;
+
+static void deque_push(locked_deque_t *d, void *item) {
+    pthread_mutex_lock(&d->lock);
+    while (d->count == d->cap) {
+        pthread_cond_wait(&d->not_full, &d->lock);
+    }
+    d->slots[(d->head + d->count) % d->cap] = item;
+    d->count++;
+    pthread_cond_signal(&d->not_empty);
+    pthread_mutex_unlock(&d->lock);
+}
+
+static void *deque_pop(locked_deque_t *d) {
+    void *item;
+
+    pthread_mutex_lock(&d->lock);
+    while (d->count == 0) {
+        pthread_cond_wait(&d->not_empty, &d->lock);
+    }
+    item = d->slots[d->head];
+    d->head = (d->head + 1) % d->cap;
+    d->count--;
+    pthread_cond_signal(&d->not_full);
+    pthread_mutex_unlock(&d->lock);
+
+    return item;
+}
+
+static void *producer(void *arg) {
+    bench_t *b;
+    void *items[BATCH];
+    sxs_uint32_t pushed, done;
+    int i, j;
+
+    b = (bench_t *)arg;
+
+    if (!b->use_mpsc) {
+        for (i = 0; i < ITEMS_PER_PRODUCER; i++) {
+            deque_push(&b->d, gnut_enc_msg_ref(b->msg));
+        }
+        return NULL;
+    }
+
+    for (i = 0; i < ITEMS_PER_PRODUCER; i += b->batch) {
+        for (j = 0; j < b->batch; j++) {
+            items[j] = gnut_enc_msg_ref(b->msg);
+        }
+        done = 0;
+        while (done < (sxs_uint32_t)b->batch) {
+            gnut_mpsc_push_batch(&b->q, items + done, b->batch - done,
+                &pushed);
+            done += pushed;
+            if (done < (sxs_uint32_t)b->batch) {
+                sched_yield();
+            }
+        }
+    }
+
+    return NULL;
+}
+
+static void consume(bench_t *b, long total) {
+    void *items[BATCH];
+    sxs_uint32_t n, i;
+    long got;
+
+    got = 0;
+    while (got < total) {
+        if (!b->use_mpsc) {
+            gnut_enc_msg_unref((gnut_enc_msg_t *)deque_pop(&b->d));
+            got++;
+            continue;
+        }
+        n = gnut_mpsc_pop_batch(&b->q, items, BATCH);
+        if (n == 0) {
+            gnut_mpsc_wait(&b->q, 1000);
+            continue;
+        }
+        for (i = 0; i < n; i++) {
+            gnut_enc_msg_unref((gnut_enc_msg_t *)items[i]);
+        }
+        got += n;
+    }
+}
+
+static void run(int use_mpsc, int batch, int nprod) {
+    static unsigned char payload[64];
+    pthread_t threads[MAX_PRODUCERS];
+    gnut_msg_hdr_t hdr;
+    bench_t b;
+    double start, elapsed;
+    long total;
+    int i;
+
+    memset(&b, 0, sizeof(b));
+    b.use_mpsc = use_mpsc;
+    b.batch = batch;
+    if (use_mpsc) {
+        if (gnut_mpsc_init(&b.q, QUEUE_LEN) != GNUT_SUCCESS) {
+            fprintf(stderr, "gnut_mpsc_init failed\n");
+            exit(1);
+        }
+    } else {
+        pthread_mutex_init(&b.d.lock, NULL);
+        pthread_cond_init(&b.d.not_empty, NULL);
+        pthread_cond_init(&b.d.not_full, NULL);
+        b.d.cap = QUEUE_LEN;
+        b.d.slots = (void **)calloc(QUEUE_LEN, sizeof(void *));
+    }
+
+    gnut_build_msg_hdr(&hdr, GNUT_MSG_QUERY, sizeof(payload));
+    gnut_enc_msg_encode(&b.msg, &hdr, payload);
+
+    total = (long)nprod * ITEMS_PER_PRODUCER;
+    start = now_ns();
+    for (i = 0; i < nprod; i++) {
+        pthread_create(&threads[i], NULL, producer, &b);
+    }
+    consume(&b, total);
+    for (i = 0; i < nprod; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    elapsed = now_ns() - start;
+
+    printf("mpsc\tqueue=%s\tbatch=%d\tproducers=%d\tns_per_msg=%.1f"
+        "\tmsgs_per_sec=%.0f\n", use_mpsc ? "mpsc" : "mutex_deque", batch,
+        nprod, elapsed / total, total / elapsed * 1e9);
+
+    gnut_enc_msg_unref(b.msg);
+    if (use_mpsc) {
+        gnut_mpsc_destroy(&b.q);
+    } else {
+        free(b.d.slots);
+        pthread_cond_destroy(&b.d.not_full);
+        pthread_cond_destroy(&b.d.not_empty);
+        pthread_mutex_destroy(&b.d.lock);
+    }
+}
+
+int main(int argc, char *argv[]) {
+    int nprod;
+
+    for (nprod = 1; nprod <= MAX_PRODUCERS; nprod *= 2) {
+        run(0, 1, nprod);
+        run(1, 1, nprod);
+        run(1, BATCH, nprod);
+    }
+
+    return 0;
+}
@@ -0,0 +1,60 @@
+/*
+ * Copyright 2006-2007 Andrew De Ponte
+ *
+ * This file is part of lib_gnut.
+ *
+ * lib_gnut is the intellectual property of Andrew De Ponte; any
+ * distribution and/or modification and/or reproductions of any portion
+ * of lib_gnut MUST be approved by Andrew De Ponte.
+ *
+ * lib_gnut is distributed WITHOUT ANY WARRANTY; without even the
+ * implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE.
+ */
+
+/**
+ * @file gnut_bench_sha1.c
+ * @brief This is a microbenchmark of SHA-1 hashing.
+ *
+ * The gnut_bench_sha1.c file is a benchmark program that measures
+ * hashing a 64 KiB buffer, as the hasher does a chunk at a time, with
+ * the SHA instructions and in C. The accelerated case is skipped where
+ * the processor lacks them.
+ */
+
+#include <stdio.h>
+
+#include "harness.h"
+#include "gnut_sha1.h"
+
+#define BUF_LEN 65536
+
+static unsigned char buf[BUF_LEN];
+
+static void bench_hash(void *arg, long iters) {
+    unsigned char digest[GNUT_SHA1_LEN];
+    long i;
+
+    gnut_sha1_use_accel(*(int *)arg);
+    for (i = 0; i < iters; i++) {
+        gnut_sha1(buf, BUF_LEN, digest);
+        BENCH_KEEP(digest);
+    }
+}
+
+int main(int argc, char *argv[]) {
+    static int on = 1, off = 0;
+    int i;
+
+    bench_init(argc, argv);
+    for (i = 0; i < BUF_LEN; i++) {
+        buf[i] = (unsigned char)(i * 131 + 7);
+    }
+
+    if (gnut_sha1_use_accel(1)) {
+        bench_run("sha1", "hash_64k_accel", bench_hash, &on, BUF_LEN);
+    }
+    bench_run("sha1", "hash_64k_c", bench_hash, &off, BUF_LEN);
+
+    return 0;
+}
@@ -0,0 +1,163 @@
+/*
+ * Copyright 2006-2007 Andrew De Ponte
+ *
+ * This file is part of lib_gnut.
+ *
+ * lib_gnut is the intellectual property of Andrew De Ponte; any
+ * distribution and/or modification and/or reproductions of any portion
+ * of lib_gnut MUST be approved by Andrew De Ponte.
+ *
+ * lib_gnut is distributed WITHOUT ANY WARRANTY; without even the
+ * implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE.
+ */
+
+/**
+ * @file gnut_bench_stats.c
+ * @brief This is a contention benchmark for the traffic statistics.
+ *
+ * The gnut_bench_stats.c file is a benchmark program that measures the
+ * cost of counting a received message, and of recording a duration,
+ * from several threads at once while another thread takes snapshots
+ * in a loop, against counting into one set of counters shared with
+ * atomic adds, which is what the statistics would cost without the
+ * per-thread blocks. The cost is the CPU time of the updating threads
+ * per update, so that it does not depend on how many CPUs are shared
+ * with the snapshots. It checks that the last snapshot adds up.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "gnut_stats.h"
+
+#define UPDATES_PER_THREAD 10000000
+#define MAX_THREADS 8
+
+typedef struct bench {
+    int shared;
+    int record;
+    int stop;
+    long snapshots;
+    gnut_uint64_t msgs;         /* The shared counters */
+    gnut_uint64_t bytes;
+} bench_t;
+
+typedef struct worker {
+    bench_t *b;
+    pthread_t thread;
+    double cpu_ns;
+} worker_t;
+
+static double cpu_ns(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return (ts.tv_sec * 1e9) + ts.tv_nsec;
+}
+
+static void *updater(void *arg) {
+    worker_t *w;
+    bench_t *b;
+    long i;
+
+    w = (worker_t *)arg;
+    b = w->b;
+    w->cpu_ns = cpu_ns();
+    for (i = 0; i < UPDATES_PER_THREAD; i++) {
+        if (b->record) {
+            gnut_stats_record(GNUT_STATS_H_FORWARD, (gnut_uint64_t)i & 65535);
+        } else if (b->shared) {
+            __atomic_fetch_add(&b->msgs, 1, __ATOMIC_RELAXED);
+            __atomic_fetch_add(&b->bytes, 23, __ATOMIC_RELAXED);
+        } else {
+            gnut_stats_rx(GNUT_NODE_T_QUERY, 23);
+        }
+    }
+    w->cpu_ns = cpu_ns() - w->cpu_ns;
+
+    return NULL;
+}
+
+static void *snapshotter(void *arg) {
+    gnut_stats_t *s;
+    bench_t *b;
+
+    b = (bench_t *)arg;
+    s = (gnut_stats_t *)malloc(sizeof(gnut_stats_t));
+    while (!__atomic_load_n(&b->stop, __ATOMIC_ACQUIRE)) {
+        gnut_stats_snapshot(s);
+        b->snapshots++;
+    }
+    free(s);
+
+    return NULL;
+}
+
+static void run(const char *what, int nthreads) {
+    worker_t workers[MAX_THREADS];
+    pthread_t snap;
+    gnut_stats_t *before, *after;
+    bench_t b;
+    double cpu;
+    gnut_uint64_t want, got;
+    int i;
+
+    memset(&b, 0, sizeof(b));
+    b.shared = (strcmp(what, "shared_atomic") == 0);
+    b.record = (strcmp(what, "record") == 0);
+    before = (gnut_stats_t *)malloc(sizeof(gnut_stats_t));
+    after = (gnut_stats_t *)malloc(sizeof(gnut_stats_t));
+    gnut_stats_snapshot(before);
+
+    pthread_create(&snap, NULL, snapshotter, &b);
+    for (i = 0; i < nthreads; i++) {
+        workers[i].b = &b;
+        pthread_create(&workers[i].thread, NULL, updater, &workers[i]);
+    }
+    cpu = 0;
+    for (i = 0; i < nthreads; i++) {
+        pthread_join(workers[i].thread, NULL);
+        cpu += workers[i].cpu_ns;
+    }
+    __atomic_store_n(&b.stop, 1, __ATOMIC_RELEASE);
+    pthread_join(snap, NULL);
+
+    gnut_stats_snapshot(after);
+    want = (gnut_uint64_t)nthreads * UPDATES_PER_THREAD;
+    if (b.shared) {
+        got = b.msgs;
+    } else if (b.record) {
+        got = after->hists[GNUT_STATS_H_FORWARD].n -
+            before->hists[GNUT_STATS_H_FORWARD].n;
+    } else {
+        got = after->rx_msgs[GNUT_NODE_T_QUERY] -
+            before->rx_msgs[GNUT_NODE_T_QUERY];
+    }
+
+    printf("stats\tupdate=%s\tthreads=%d\tns_per_update=%.2f"
+        "\tsnapshots=%ld\tcounted=%s\n", what, nthreads,
+        cpu / want, b.snapshots,
+        (got == want) ? "ok" : "MISMATCH");
+
+    free(before);
+    free(after);
+    if (got != want) {
+        exit(1);
+    }
+}
+
+int main(int argc, char *argv[]) {
+    int nthreads;
+
+    for (nthreads = 1; nthreads <= MAX_THREADS; nthreads *= 2) {
+        run("shared_atomic", nthreads);
+        run("rx", nthreads);
+        run("record", nthreads);
+    }
+
+    return 0;
+}
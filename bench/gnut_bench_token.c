@@ -0,0 +1,155 @@
+/*
+ * Copyright 2006-2007 Andrew De Ponte
+ *
+ * This file is part of lib_gnut.
+ *
+ * lib_gnut is the intellectual property of Andrew De Ponte; any
+ * distribution and/or modification and/or reproductions of any portion
+ * of lib_gnut MUST be approved by Andrew De Ponte.
+ *
+ * lib_gnut is distributed WITHOUT ANY WARRANTY; without even the
+ * implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE.
+ */
+
+/**
+ * @file gnut_bench_token.c
+ * @brief This is a microbenchmark of the keyword tokenizer.
+ *
+ * The gnut_bench_token.c file is a benchmark program that measures
+ * gnut_tokenize() on synthetic file names that are all ASCII, that hold
+ * accented Latin-1 letters in UTF-8, and that hold other UTF-8 text,
+ * against a byte at a time split and fold of the ASCII names like the
+ * one the shared file index used before.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "harness.h"
+#include "gnut_token.h"
+
+#define NUM_NAMES 1024
+#define NAME_LEN 128
+
+typedef struct name_set {
+    char names[NUM_NAMES][NAME_LEN];
+    sxs_uint32_t lens[NUM_NAMES];
+    sxs_uint32_t bytes;
+} name_set_t;
+
+static name_set_t ascii, latin1, utf8;
+static gnut_uint64_t rng = 0x9E3779B97F4A7C15ULL;
+
+static sxs_uint32_t rand32(void) {
+    rng ^= rng << 13;
+    rng ^= rng >> 7;
+    rng ^= rng << 17;
+    return (sxs_uint32_t)(rng >> 32);
+}
+
+/* Fills 's' with names of words joined by separators, where each letter
+ * is 'odd' one time in 'one_in', or never when 'one_in' is 0. */
+static void fill(name_set_t *s, const char *odd, sxs_uint32_t one_in) {
+    static const char seps[] = " _-.";
+    sxs_uint32_t odd_len, len, wlen;
+    int i, j;
+
+    odd_len = (odd != NULL) ? strlen(odd) : 0;
+    s->bytes = 0;
+    for (i = 0; i < NUM_NAMES; i++) {
+        len = 0;
+        while (len + 16 + odd_len * 12 < NAME_LEN - 8) {
+            wlen = 3 + rand32() % 8;
+            for (j = 0; j < (int)wlen; j++) {
+                if (one_in > 0 && rand32() % one_in == 0) {
+                    memcpy(s->names[i] + len, odd, odd_len);
+                    len += odd_len;
+                } else {
+                    s->names[i][len++] = ((rand32() % 4 == 0) ? 'A' : 'a') +
+                        rand32() % 26;
+                }
+            }
+            s->names[i][len++] = seps[rand32() % 4];
+        }
+        memcpy(s->names[i] + len, "mp3", 3);
+        s->lens[i] = len + 3;
+        s->bytes += s->lens[i];
+    }
+    s->bytes /= NUM_NAMES;
+}
+
+static void bench_tokenize(void *arg, long iters) {
+    name_set_t *s;
+    char folded[GNUT_TOKEN_FOLD_LEN(NAME_LEN)];
+    gnut_token_t toks[GNUT_TOKEN_MAX_TOKENS(NAME_LEN)];
+    sxs_uint32_t n;
+    long i;
+
+    s = (name_set_t *)arg;
+    for (i = 0; i < iters; i++) {
+        n = gnut_tokenize(s->names[i % NUM_NAMES], s->lens[i % NUM_NAMES],
+            folded, toks, GNUT_TOKEN_MAX_TOKENS(NAME_LEN));
+        BENCH_KEEP(toks);
+        BENCH_KEEP(&n);
+    }
+}
+
+static int is_kw(unsigned char ch) {
+    return (ch >= 0x80) || (ch >= '0' && ch <= '9') ||
+        (ch >= 'a' && ch <= 'z') || (ch >= 'A' && ch <= 'Z');
+}
+
+static void bench_scalar(void *arg, long iters) {
+    name_set_t *s;
+    const char *name;
+    char folded[NAME_LEN];
+    gnut_token_t toks[GNUT_TOKEN_MAX_TOKENS(NAME_LEN)];
+    sxs_uint32_t len, pos, start, n;
+    unsigned char ch;
+    long i;
+
+    s = (name_set_t *)arg;
+    for (i = 0; i < iters; i++) {
+        name = s->names[i % NUM_NAMES];
+        len = s->lens[i % NUM_NAMES];
+        n = 0;
+        pos = 0;
+        while (pos < len) {
+            while (pos < len && !is_kw((unsigned char)name[pos])) {
+                pos++;
+            }
+            start = pos;
+            while (pos < len && is_kw((unsigned char)name[pos])) {
+                ch = (unsigned char)name[pos];
+                folded[pos++] = (ch >= 'A' && ch <= 'Z') ?
+                    ch + ('a' - 'A') : ch;
+            }
+            if (pos - start >= GNUT_TOKEN_MIN_LEN &&
+                pos - start <= GNUT_TOKEN_MAX_LEN) {
+                toks[n].off = start;
+                toks[n].len = pos - start;
+                n++;
+            }
+        }
+        BENCH_KEEP(folded);
+        BENCH_KEEP(toks);
+        BENCH_KEEP(&n);
+    }
+}
+
+int main(int argc, char *argv[]) {
+    bench_init(argc, argv);
+    fill(&ascii, NULL, 0);
+    fill(&latin1, "\xc3\xa9", 12);
+    fill(&utf8, "\xe6\x97\xa5", 12);
+
+    bench_run("token", "tokenize_ascii", bench_tokenize, &ascii,
+        ascii.bytes);
+    bench_run("token", "tokenize_latin1", bench_tokenize, &latin1,
+        latin1.bytes);
+    bench_run("token", "tokenize_utf8", bench_tokenize, &utf8, utf8.bytes);
+    bench_run("token", "scalar_ascii", bench_scalar, &ascii, ascii.bytes);
+
+    return 0;
+}
@@ -0,0 +1,159 @@
+/*
+ * Copyright 2006-2007 Andrew De Ponte
+ *
+ * This file is part of lib_gnut.
+ *
+ * lib_gnut is the intellectual property of Andrew De Ponte; any
+ * distribution and/or modification and/or reproductions of any portion
+ * of lib_gnut MUST be approved by Andrew De Ponte.
+ *
+ * lib_gnut is distributed WITHOUT ANY WARRANTY; without even the
+ * implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE.
+ */
+
+/**
+ * @file harness.c
+ * @brief This is an implementation file for the microbenchmark harness.
+ *
+ * The harness.c file is an implementation file that defines the
+ * functions shared by the microbenchmark programs.
+ */
+
+#define _GNU_SOURCE /* sched_setaffinity() */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h> /* getopt() */
+#include <math.h> /* sqrt() */
+#ifdef __linux__
+#include <sched.h>
+#endif
+
+#include "harness.h"
+
+#define MAX_SAMPLES 101
+#define WARMUP_NS 50e6
+
+static int opt_cpu = 0;
+static int opt_samples = 11;
+static double opt_sample_ns = 20e6;
+static const char *opt_filter = NULL;
+
+static double now_ns(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (ts.tv_sec * 1e9) + ts.tv_nsec;
+}
+
+static int cmp_double(const void *a, const void *b) {
+    double x, y;
+
+    x = *(const double *)a;
+    y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+void bench_init(int argc, char *argv[]) {
+    int c;
+
+    while ((c = getopt(argc, argv, "c:n:t:f:")) != -1) {
+        switch (c) {
+            case 'c':
+                opt_cpu = atoi(optarg);
+                break;
+            case 'n':
+                opt_samples = atoi(optarg);
+                break;
+            case 't':
+                opt_sample_ns = atof(optarg) * 1e6;
+                break;
+            case 'f':
+                opt_filter = optarg;
+                break;
+            default:
+                fprintf(stderr, "usage: %s [-c cpu] [-n samples] "
+                    "[-t ms_per_sample] [-f filter]\n", argv[0]);
+                exit(2);
+        }
+    }
+    if (opt_samples < 1) {
+        opt_samples = 1;
+    } else if (opt_samples > MAX_SAMPLES) {
+        opt_samples = MAX_SAMPLES;
+    }
+
+#ifdef __linux__
+    if (opt_cpu >= 0) {
+        cpu_set_t cpus;
+
+        CPU_ZERO(&cpus);
+        CPU_SET(opt_cpu, &cpus);
+        if (sched_setaffinity(0, sizeof(cpus), &cpus) != 0) {
+            fprintf(stderr, "warning: could not pin to cpu %d\n", opt_cpu);
+            opt_cpu = -1;
+        }
+    }
+#else
+    opt_cpu = -1;
+#endif
+}
+
+void bench_run(const char *suite, const char *name, bench_fn_t fn,
+    void *arg, size_t bytes) {
+
+    double ns_op[MAX_SAMPLES];
+    double start, elapsed, sum, sd, med;
+    long iters;
+    int i;
+
+    if (opt_filter != NULL && strstr(name, opt_filter) == NULL) {
+        return;
+    }
+
+    /* Warm up caches, branch predictors and the clock frequency while
+     * finding how many iterations fill a sample. */
+    iters = 1;
+    start = now_ns();
+    for (;;) {
+        elapsed = now_ns();
+        fn(arg, iters);
+        elapsed = now_ns() - elapsed;
+        if (now_ns() - start >= WARMUP_NS && elapsed >= opt_sample_ns / 4) {
+            break;
+        }
+        if (elapsed < opt_sample_ns / 4) {
+            iters *= 2;
+        }
+    }
+    iters = (long)(iters * (opt_sample_ns / elapsed));
+    if (iters < 1) {
+        iters = 1;
+    }
+
+    sum = 0;
+    for (i = 0; i < opt_samples; i++) {
+        start = now_ns();
+        fn(arg, iters);
+        ns_op[i] = (now_ns() - start) / iters;
+        sum += ns_op[i];
+    }
+
+    sd = 0;
+    for (i = 0; i < opt_samples; i++) {
+        sd += (ns_op[i] - sum / opt_samples) * (ns_op[i] - sum / opt_samples);
+    }
+    sd = sqrt(sd / opt_samples);
+    qsort(ns_op, opt_samples, sizeof(double), cmp_double);
+    med = ns_op[opt_samples / 2];
+
+    printf("%s\tname=%s\tcpu=%d\tsamples=%d\titers=%ld\tns_op_min=%.2f"
+        "\tns_op_med=%.2f\tns_op_mean=%.2f\tns_op_sd=%.2f\tops_per_sec=%.0f"
+        "\tbytes_per_sec=%.0f\n", suite, name, opt_cpu, opt_samples, iters,
+        ns_op[0], med, sum / opt_samples, sd, 1e9 / med,
+        bytes * 1e9 / med);
+    fflush(stdout);
+}
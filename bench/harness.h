@@ -0,0 +1,66 @@
+/*
+ * Copyright 2006-2007 Andrew De Ponte
+ *
+ * This file is part of lib_gnut.
+ *
+ * lib_gnut is the intellectual property of Andrew De Ponte; any
+ * distribution and/or modification and/or reproductions of any portion
+ * of lib_gnut MUST be approved by Andrew De Ponte.
+ *
+ * lib_gnut is distributed WITHOUT ANY WARRANTY; without even the
+ * implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE.
+ */
+
+/**
+ * @file harness.h
+ * @brief This is a specifications file for the microbenchmark harness.
+ *
+ * The harness.h file is a specifications file that declares the
+ * functions shared by the microbenchmark programs. A benchmark is a
+ * function that performs an operation a given number of times. The
+ * harness pins the process to one CPU, warms the operation up, sizes a
+ * sample to run for a fixed time, then times repeated samples and
+ * prints one tab separated line of key=value fields per benchmark.
+ */
+
+#ifndef BENCH_HARNESS_H
+#define BENCH_HARNESS_H
+
+#include <stddef.h>
+
+/* Makes the compiler assume 'p' is read and the memory it points to
+ * changed, so work whose result is only stored there is not removed. */
+#define BENCH_KEEP(p) __asm__ __volatile__("" : : "r"(p) : "memory")
+
+typedef void (*bench_fn_t)(void *arg, long iters);
+
+/**
+ * Initialize the Harness
+ *
+ * The bench_init() function reads the options common to every
+ * benchmark program and pins the process. The options are -c CPU to
+ * pin to (default 0, -1 to not pin), -n samples (default 11), -t
+ * milliseconds per sample (default 20) and -f substring, which runs
+ * only the benchmarks whose name contains it.
+ * @param argc The argument count given to main().
+ * @param argv The arguments given to main().
+ */
+void bench_init(int argc, char *argv[]);
+
+/**
+ * Run a Benchmark
+ *
+ * The bench_run() function times 'fn' and prints its line. 'bytes' is
+ * the number of bytes each operation processes, used for the
+ * throughput field, or 0 if it has none.
+ * @param suite The name of the benchmark program.
+ * @param name The name of the benchmark.
+ * @param fn The function performing the operation.
+ * @param arg Passed to 'fn'.
+ * @param bytes The bytes processed per operation.
+ */
+void bench_run(const char *suite, const char *name, bench_fn_t fn,
+    void *arg, size_t bytes);
+
+#endif /* BENCH_HARNESS_H */
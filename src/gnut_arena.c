@@ -0,0 +1,124 @@
+/*
+ * Copyright 2006-2007 Andrew De Ponte
+ *
+ * This file is part of lib_gnut.
+ *
+ * lib_gnut is the intellectual property of Andrew De Ponte; any
+ * distribution and/or modification and/or reproductions of any portion
+ * of lib_gnut MUST be approved by Andrew De Ponte.
+ *
+ * lib_gnut is distributed WITHOUT ANY WARRANTY; without even the
+ * implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE.
+ */
+
+/**
+ * @file gnut_arena.c
+ * @brief This is an implementation file for the arena allocator.
+ *
+ * The gnut_arena.c file is an implementation file that defines the
+ * gnut_arena_t type's associated functions.
+ */
+
+#include <stddef.h> /* offsetof() */
+#include <stdlib.h> /* malloc(), free() */
+
+#include "gnut_arena.h"
+
+#define ARENA_ALIGN 16
+
+struct gnut_arena_chunk {
+    struct gnut_arena_chunk *next;
+    size_t size;                /* Usable bytes in data */
+    size_t off;                 /* Next free byte in data */
+    union {
+        long double ld;
+        double d;
+        void *p;
+        gnut_uint64_t u;
+    } data[1];
+};
+
+#define CHUNK_HDR_LEN offsetof(struct gnut_arena_chunk, data)
+
+void gnut_arena_init(gnut_arena_t *a, size_t chunk_size) {
+    a->head = NULL;
+    a->free = NULL;
+    a->chunk_size = (chunk_size > 0) ? chunk_size : GNUT_ARENA_DEF_CHUNK;
+    a->used = 0;
+    a->reserved = 0;
+}
+
+static struct gnut_arena_chunk *_gnut_arena_new_chunk(gnut_arena_t *a,
+    size_t size) {
+
+    struct gnut_arena_chunk *c;
+
+    /* Reuse a kept chunk when the request fits in one. */
+    if (a->free != NULL && size <= a->free->size) {
+        c = a->free;
+        a->free = c->next;
+        c->off = 0;
+        return c;
+    }
+
+    if (size < a->chunk_size) {
+        size = a->chunk_size;
+    }
+    c = (struct gnut_arena_chunk *)malloc(CHUNK_HDR_LEN + size);
+    if (c == NULL) {
+        return NULL;
+    }
+    c->size = size;
+    c->off = 0;
+    a->reserved += size;
+
+    return c;
+}
+
+void *gnut_arena_alloc(gnut_arena_t *a, size_t size) {
+    struct gnut_arena_chunk *c;
+    void *p;
+
+    size = (size + (ARENA_ALIGN - 1)) & ~((size_t)ARENA_ALIGN - 1);
+
+    c = a->head;
+    if (c == NULL || c->size - c->off < size) {
+        c = _gnut_arena_new_chunk(a, size);
+        if (c == NULL) {
+            return NULL;
+        }
+        c->next = a->head;
+        a->head = c;
+    }
+
+    p = (unsigned char *)c->data + c->off;
+    c->off += size;
+    a->used += size;
+
+    return p;
+}
+
+void gnut_arena_reset(gnut_arena_t *a) {
+    struct gnut_arena_chunk *c, *next;
+
+    for (c = a->head; c != NULL; c = next) {
+        next = c->next;
+        c->next = a->free;
+        a->free = c;
+    }
+    a->head = NULL;
+    a->used = 0;
+}
+
+void gnut_arena_destroy(gnut_arena_t *a) {
+    struct gnut_arena_chunk *c, *next;
+
+    gnut_arena_reset(a);
+    for (c = a->free; c != NULL; c = next) {
+        next = c->next;
+        free(c);
+    }
+    a->free = NULL;
+    a->reserved = 0;
+}
@@ -0,0 +1,99 @@
+/*
+ * Copyright 2006-2007 Andrew De Ponte
+ *
+ * This file is part of lib_gnut.
+ *
+ * lib_gnut is the intellectual property of Andrew De Ponte; any
+ * distribution and/or modification and/or reproductions of any portion
+ * of lib_gnut MUST be approved by Andrew De Ponte.
+ *
+ * lib_gnut is distributed WITHOUT ANY WARRANTY; without even the
+ * implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE.
+ */
+
+/**
+ * @file gnut_arena.h
+ * @brief This is a specifications file for the arena allocator.
+ *
+ * The gnut_arena.h file is a specifications file that declares the
+ * gnut_arena_t type and its associated functions. An arena hands out
+ * memory by bumping a pointer through large chunks and frees it all at
+ * once, which suits per-iteration scratch memory owned by one thread.
+ */
+
+#ifndef GNUT_ARENA_H
+#define GNUT_ARENA_H
+
+#include <sxs/sxs.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+#include "gnut_export.h"
+#include "gnut_types.h"
+#include "gnut_error.h"
+
+#define GNUT_ARENA_DEF_CHUNK 65536 /**< Default chunk size in bytes */
+
+struct gnut_arena_chunk;
+
+/**
+ * An Arena
+ *
+ * The gnut_arena_t is a type which represents an arena allocator. It
+ * is not thread safe; each thread uses its own.
+ */
+typedef struct GNUT_EXPORT gnut_arena {
+    struct gnut_arena_chunk *head;  /* Chunk currently allocated from */
+    struct gnut_arena_chunk *free;  /* Chunks kept for reuse */
+    size_t chunk_size;
+    size_t used;                    /* Bytes handed out since reset */
+    size_t reserved;                /* Bytes held in chunks */
+} gnut_arena_t;
+
+/**
+ * Initialize an Arena
+ *
+ * The gnut_arena_init() function initializes an empty arena which
+ * allocates memory from the system in chunks of 'chunk_size' bytes.
+ * @param a Pointer to the arena to initialize.
+ * @param chunk_size The chunk size, or 0 for GNUT_ARENA_DEF_CHUNK.
+ */
+GNUT_EXPORT void gnut_arena_init(gnut_arena_t *a, size_t chunk_size);
+
+/**
+ * Allocate from an Arena
+ *
+ * The gnut_arena_alloc() function returns 'size' bytes aligned for any
+ * type. The memory stays valid until the arena is reset or destroyed.
+ * @param a Pointer to the arena.
+ * @param size The number of bytes to allocate.
+ * @return Pointer to the memory, or NULL if the system is out of memory.
+ */
+GNUT_EXPORT void *gnut_arena_alloc(gnut_arena_t *a, size_t size);
+
+/**
+ * Reset an Arena
+ *
+ * The gnut_arena_reset() function releases everything allocated from
+ * the arena at once. The chunks are kept for reuse.
+ * @param a Pointer to the arena.
+ */
+GNUT_EXPORT void gnut_arena_reset(gnut_arena_t *a);
+
+/**
+ * Destroy an Arena
+ *
+ * The gnut_arena_destroy() function returns all the chunks of the
+ * arena to the system.
+ * @param a Pointer to the arena.
+ */
+GNUT_EXPORT void gnut_arena_destroy(gnut_arena_t *a);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* GNUT_ARENA_H */
@@ -0,0 +1,55 @@
+/*
+ * Copyright 2006-2007 Andrew De Ponte
+ *
+ * This file is part of lib_gnut.
+ *
+ * lib_gnut is the intellectual property of Andrew De Ponte; any
+ * distribution and/or modification and/or reproductions of any portion
+ * of lib_gnut MUST be approved by Andrew De Ponte.
+ *
+ * lib_gnut is distributed WITHOUT ANY WARRANTY; without even the
+ * implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE.
+ */
+
+/**
+ * @file gnut_atomic.h
+ * @brief This is an internal specifications file for atomic operations.
+ *
+ * The gnut_atomic.h file is an internal specifications file that wraps
+ * the compiler's atomic builtins in macros so that the lock-free parts
+ * of lib_gnut spell out their memory ordering in one consistent way.
+ * It is not installed.
+ */
+
+#ifndef GNUT_ATOMIC_H
+#define GNUT_ATOMIC_H
+
+#define GNUT_CACHE_LINE 64 /**< Assumed cache line size in bytes */
+
+#define GNUT_CACHE_ALIGNED __attribute__((aligned(GNUT_CACHE_LINE)))
+
+#define GNUT_ATOMIC_LOAD_RLX(p) __atomic_load_n((p), __ATOMIC_RELAXED)
+#define GNUT_ATOMIC_LOAD_ACQ(p) __atomic_load_n((p), __ATOMIC_ACQUIRE)
+#define GNUT_ATOMIC_STORE_RLX(p, v) \
+    __atomic_store_n((p), (v), __ATOMIC_RELAXED)
+#define GNUT_ATOMIC_STORE_REL(p, v) \
+    __atomic_store_n((p), (v), __ATOMIC_RELEASE)
+#define GNUT_ATOMIC_XCHG(p, v) \
+    __atomic_exchange_n((p), (v), __ATOMIC_ACQ_REL)
+#define GNUT_ATOMIC_CAS(p, p_expected, v) \
+    __atomic_compare_exchange_n((p), (p_expected), (v), 0, \
+    __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)
+#define GNUT_ATOMIC_ADD(p, v) __atomic_fetch_add((p), (v), __ATOMIC_ACQ_REL)
+#define GNUT_ATOMIC_ADD_RLX(p, v) \
+    __atomic_fetch_add((p), (v), __ATOMIC_RELAXED)
+#define GNUT_ATOMIC_SUB(p, v) __atomic_fetch_sub((p), (v), __ATOMIC_ACQ_REL)
+#define GNUT_ATOMIC_FENCE() __atomic_thread_fence(__ATOMIC_SEQ_CST)
+
+#if defined(__x86_64__) || defined(__i386__)
+#define GNUT_CPU_RELAX() __builtin_ia32_pause()
+#else
+#define GNUT_CPU_RELAX() do { } while (0)
+#endif
+
+#endif /* GNUT_ATOMIC_H */
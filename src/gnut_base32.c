@@ -0,0 +1,218 @@
+/*
+ * Copyright 2006-2007 Andrew De Ponte
+ *
+ * This file is part of lib_gnut.
+ *
+ * lib_gnut is the intellectual property of Andrew De Ponte; any
+ * distribution and/or modification and/or reproductions of any portion
+ * of lib_gnut MUST be approved by Andrew De Ponte.
+ *
+ * lib_gnut is distributed WITHOUT ANY WARRANTY; without even the
+ * implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE.
+ */
+
+/**
+ * @file gnut_base32.c
+ * @brief This is an implementation file for base32 and urn:sha1 values.
+ *
+ * The gnut_base32.c file is an implementation file that defines the
+ * base32 functions. A SHA-1 digest is 160 bits, four groups of 40 bits
+ * that are each eight characters, so its functions move a whole group
+ * through a 64 bit integer. Each five bit value of a group is looked up
+ * in the alphabet straight from the integer; characters are turned back
+ * into values while checking them 16 at a time with SSE2, or a
+ * character at a time otherwise.
+ */
+
+#include "gnut_base32.h"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+
+/* All ones in the bytes of 'x' from 'lo' up to, but not including,
+ * 'lo' + 'n', comparing as unsigned. */
+#define V_IN_RANGE(x, lo, n) \
+    _mm_cmpgt_epi8(_mm_set1_epi8((char)((n) - 128)), \
+    _mm_xor_si128(_mm_sub_epi8((x), _mm_set1_epi8((char)(lo))), \
+    _mm_set1_epi8((char)0x80)))
+#endif
+
+static const char _gnut_base32_alphabet[32] = {
+    'A', 'B', 'C', 'D', 'E', 'F', 'G', 'H', 'I', 'J', 'K', 'L', 'M',
+    'N', 'O', 'P', 'Q', 'R', 'S', 'T', 'U', 'V', 'W', 'X', 'Y', 'Z',
+    '2', '3', '4', '5', '6', '7'
+};
+
+/* Returns the value of a base32 character, or -1. */
+static int _gnut_base32_value(unsigned char ch) {
+    unsigned char lc;
+
+    lc = ch | 0x20;
+    if (lc >= 'a' && lc <= 'z') {
+        return lc - 'a';
+    }
+    if (ch >= '2' && ch <= '7') {
+        return ch - '2' + 26;
+    }
+    return -1;
+}
+
+/* Turns 32 characters into five bit values. Returns 0 if one is not
+ * base32. */
+static int _gnut_base32_values(const char *in, unsigned char *v) {
+#ifdef __SSE2__
+    __m128i c, lc, letter, digit, x;
+    int i, ok;
+
+    ok = 1;
+    for (i = 0; i < GNUT_BASE32_SHA1_LEN; i += 16) {
+        c = _mm_loadu_si128((const __m128i *)(in + i));
+        lc = _mm_or_si128(c, _mm_set1_epi8(0x20));
+        letter = V_IN_RANGE(lc, 'a', 26);
+        digit = V_IN_RANGE(c, '2', 6);
+        ok &= (_mm_movemask_epi8(_mm_or_si128(letter, digit)) == 0xffff);
+        x = _mm_or_si128(
+            _mm_and_si128(letter, _mm_sub_epi8(lc, _mm_set1_epi8('a'))),
+            _mm_and_si128(digit, _mm_sub_epi8(c, _mm_set1_epi8('2' - 26))));
+        _mm_storeu_si128((__m128i *)(v + i), x);
+    }
+    return ok;
+#else
+    int i, val;
+
+    for (i = 0; i < GNUT_BASE32_SHA1_LEN; i++) {
+        val = _gnut_base32_value((unsigned char)in[i]);
+        if (val < 0) {
+            return 0;
+        }
+        v[i] = (unsigned char)val;
+    }
+    return 1;
+#endif
+}
+
+sxs_uint32_t gnut_base32_encode(const unsigned char *in, sxs_uint32_t len,
+    char *out) {
+
+    sxs_uint32_t i, o, bits;
+    int n;
+
+    o = 0;
+    bits = 0;
+    n = 0;
+    for (i = 0; i < len; i++) {
+        bits = (bits << 8) | in[i];
+        n += 8;
+        while (n >= 5) {
+            n -= 5;
+            out[o++] = _gnut_base32_alphabet[(bits >> n) & 31];
+        }
+    }
+    if (n > 0) {
+        out[o++] = _gnut_base32_alphabet[(bits << (5 - n)) & 31];
+    }
+
+    return o;
+}
+
+gnut_error_t gnut_base32_decode(const char *in, sxs_uint32_t len,
+    unsigned char *out, sxs_uint32_t *p_out_len) {
+
+    sxs_uint32_t i, o, bits;
+    int n, val;
+
+    while (len > 0 && in[len - 1] == '=') {
+        len--;
+    }
+    o = 0;
+    bits = 0;
+    n = 0;
+    for (i = 0; i < len; i++) {
+        val = _gnut_base32_value((unsigned char)in[i]);
+        if (val < 0) {
+            return GNUT_EMALFORMED;
+        }
+        bits = (bits << 5) | (sxs_uint32_t)val;
+        n += 5;
+        if (n >= 8) {
+            n -= 8;
+            out[o++] = (unsigned char)(bits >> n);
+        }
+    }
+
+    *p_out_len = o;
+    return GNUT_SUCCESS;
+}
+
+/* The groups are unrolled so that every shift is a constant and no
+ * value is stored before it is looked up. */
+void gnut_base32_encode_sha1(const unsigned char *sha1, char *out) {
+    gnut_uint64_t g;
+    int i;
+
+    for (i = 0; i < 4; i++, sha1 += 5, out += 8) {
+        g = ((gnut_uint64_t)sha1[0] << 32) | ((gnut_uint64_t)sha1[1] << 24) |
+            ((gnut_uint64_t)sha1[2] << 16) | ((gnut_uint64_t)sha1[3] << 8) |
+            (gnut_uint64_t)sha1[4];
+        out[0] = _gnut_base32_alphabet[(g >> 35) & 31];
+        out[1] = _gnut_base32_alphabet[(g >> 30) & 31];
+        out[2] = _gnut_base32_alphabet[(g >> 25) & 31];
+        out[3] = _gnut_base32_alphabet[(g >> 20) & 31];
+        out[4] = _gnut_base32_alphabet[(g >> 15) & 31];
+        out[5] = _gnut_base32_alphabet[(g >> 10) & 31];
+        out[6] = _gnut_base32_alphabet[(g >> 5) & 31];
+        out[7] = _gnut_base32_alphabet[g & 31];
+    }
+}
+
+gnut_error_t gnut_base32_decode_sha1(const char *in, unsigned char *sha1) {
+    unsigned char v[GNUT_BASE32_SHA1_LEN];
+    gnut_uint64_t g;
+    int i, j;
+
+    if (!_gnut_base32_values(in, v)) {
+        return GNUT_EMALFORMED;
+    }
+    for (i = 0; i < 4; i++) {
+        g = 0;
+        for (j = 0; j < 8; j++) {
+            g = (g << 5) | v[i * 8 + j];
+        }
+        for (j = 0; j < 5; j++) {
+            sha1[i * 5 + j] = (unsigned char)(g >> (32 - j * 8));
+        }
+    }
+
+    return GNUT_SUCCESS;
+}
+
+void gnut_urn_sha1_format(const unsigned char *sha1, char *out) {
+    int i;
+
+    for (i = 0; i < GNUT_URN_SHA1_PREFIX_LEN; i++) {
+        out[i] = GNUT_URN_SHA1_PREFIX[i];
+    }
+    gnut_base32_encode_sha1(sha1, out + GNUT_URN_SHA1_PREFIX_LEN);
+}
+
+gnut_error_t gnut_urn_sha1_parse(const char *s, sxs_uint32_t len,
+    unsigned char *sha1) {
+
+    char ch;
+    int i;
+
+    if (len != GNUT_URN_SHA1_LEN) {
+        return GNUT_EMALFORMED;
+    }
+    for (i = 0; i < GNUT_URN_SHA1_PREFIX_LEN; i++) {
+        ch = s[i];
+        if (ch >= 'A' && ch <= 'Z') {
+            ch += 'a' - 'A';
+        }
+        if (ch != GNUT_URN_SHA1_PREFIX[i]) {
+            return GNUT_EMALFORMED;
+        }
+    }
+    return gnut_base32_decode_sha1(s + GNUT_URN_SHA1_PREFIX_LEN, sha1);
+}
@@ -0,0 +1,131 @@
+/*
+ * Copyright 2006-2007 Andrew De Ponte
+ *
+ * This file is part of lib_gnut.
+ *
+ * lib_gnut is the intellectual property of Andrew De Ponte; any
+ * distribution and/or modification and/or reproductions of any portion
+ * of lib_gnut MUST be approved by Andrew De Ponte.
+ *
+ * lib_gnut is distributed WITHOUT ANY WARRANTY; without even the
+ * implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE.
+ */
+
+/**
+ * @file gnut_base32.h
+ * @brief This is a specifications file for base32 and urn:sha1 values.
+ *
+ * The gnut_base32.h file is a specifications file that declares the
+ * functions which encode and decode the base32 of RFC 4648, the upper
+ * case letters and the digits 2 to 7 without padding, as used in the
+ * urn:sha1 values of HUGE. A SHA-1 digest is always 32 characters of
+ * base32, and has its own functions for it. Encoding is scalar on
+ * every target, looking each character up straight from the digest;
+ * only decoding uses SSE2, checking 16 characters at a time where the
+ * compiler targets it.
+ */
+
+#ifndef GNUT_BASE32_H
+#define GNUT_BASE32_H
+
+#include <sxs/sxs.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+#include "gnut_export.h"
+#include "gnut_types.h"
+#include "gnut_error.h"
+#include "gnut_sha1.h"
+
+#define GNUT_BASE32_SHA1_LEN 32 /**< Characters of a SHA-1 in base32 */
+#define GNUT_URN_SHA1_PREFIX "urn:sha1:" /**< What precedes them in URNs */
+#define GNUT_URN_SHA1_PREFIX_LEN 9 /**< Length of the prefix */
+#define GNUT_URN_SHA1_LEN 41 /**< Characters of a urn:sha1 value */
+
+/** The number of characters encoding 'len' bytes */
+#define GNUT_BASE32_ENC_LEN(len) (((len) * 8 + 4) / 5)
+
+/**
+ * Encode Bytes in Base32
+ *
+ * @param in Pointer to the bytes.
+ * @param len The number of bytes.
+ * @param out Pointer to a buffer of GNUT_BASE32_ENC_LEN(len) characters,
+ * which is not null terminated.
+ * @return The number of characters written.
+ */
+GNUT_EXPORT sxs_uint32_t gnut_base32_encode(const unsigned char *in,
+    sxs_uint32_t len, char *out);
+
+/**
+ * Decode Base32
+ *
+ * The gnut_base32_decode() function decodes 'len' characters of either
+ * case, ignoring any '=' padding at the end. Bits left over past the
+ * last whole byte are dropped.
+ * @param in Pointer to the characters.
+ * @param len The number of characters.
+ * @param out Pointer to a buffer of len * 5 / 8 bytes.
+ * @param p_out_len Pointer to store the number of bytes written in.
+ * @return A value representing an error or success.
+ * @retval GNUT_SUCCESS Successfully decoded the characters.
+ * @retval GNUT_EMALFORMED A character is not base32.
+ */
+GNUT_EXPORT gnut_error_t gnut_base32_decode(const char *in,
+    sxs_uint32_t len, unsigned char *out, sxs_uint32_t *p_out_len);
+
+/**
+ * Encode a SHA-1 Digest in Base32
+ *
+ * @param sha1 Pointer to the GNUT_SHA1_LEN byte digest.
+ * @param out Pointer to a buffer of GNUT_BASE32_SHA1_LEN characters,
+ * which is not null terminated.
+ */
+GNUT_EXPORT void gnut_base32_encode_sha1(const unsigned char *sha1,
+    char *out);
+
+/**
+ * Decode a SHA-1 Digest from Base32
+ *
+ * @param in Pointer to GNUT_BASE32_SHA1_LEN characters of either case.
+ * @param sha1 Pointer to a buffer of GNUT_SHA1_LEN bytes.
+ * @return A value representing an error or success.
+ * @retval GNUT_SUCCESS Successfully decoded the digest.
+ * @retval GNUT_EMALFORMED A character is not base32.
+ */
+GNUT_EXPORT gnut_error_t gnut_base32_decode_sha1(const char *in,
+    unsigned char *sha1);
+
+/**
+ * Format a urn:sha1 Value
+ *
+ * @param sha1 Pointer to the GNUT_SHA1_LEN byte digest.
+ * @param out Pointer to a buffer of GNUT_URN_SHA1_LEN characters, which
+ * is not null terminated.
+ */
+GNUT_EXPORT void gnut_urn_sha1_format(const unsigned char *sha1,
+    char *out);
+
+/**
+ * Parse a urn:sha1 Value
+ *
+ * The gnut_urn_sha1_parse() function reads the digest of a urn:sha1
+ * value, whose prefix may be of either case.
+ * @param s Pointer to the value.
+ * @param len The length of the value.
+ * @param sha1 Pointer to a buffer of GNUT_SHA1_LEN bytes.
+ * @return A value representing an error or success.
+ * @retval GNUT_SUCCESS Successfully parsed the value.
+ * @retval GNUT_EMALFORMED The value is not a urn:sha1 value.
+ */
+GNUT_EXPORT gnut_error_t gnut_urn_sha1_parse(const char *s,
+    sxs_uint32_t len, unsigned char *sha1);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* GNUT_BASE32_H */
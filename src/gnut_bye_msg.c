@@ -19,45 +19,71 @@
  * The gnut_bye_msg.c file is an implementation file that defines
  * the gnut_bye_msg_t type's associated support functions.
  */
- 
-int _gnut_parse_by_msg_payload(gnut_bye_payload_t *pl,
+
+#include <stdlib.h> /* malloc(), free() */
+#include <string.h> /* memchr(), memcpy() */
+
+#include "gnut_bye_msg.h"
+
+int _gnut_parse_bye_msg_payload(gnut_bye_payload_t *pl,
     unsigned char *raw_pl, sxs_uint32_t raw_pl_len) {
-    
-    unsigned char *tmp_p;
-    int desc_string_len;
-    
+
+    unsigned char *tmp_p, *nul_p;
+    sxs_uint32_t desc_string_len;
+
+    if (raw_pl_len < sizeof(sxs_uint16_t)) {
+        return -2;
+    }
+
     tmp_p = raw_pl;
-    
-    pl->code = *((sxs_uint16_t *)tmp_p);
+
+    pl->code = (sxs_uint16_t)(tmp_p[0] | (tmp_p[1] << 8));
     tmp_p = tmp_p + sizeof(sxs_uint16_t);
-    
-    desc_string_len = strlen((const char *)tmp_p);
-    
-    if (desc_string_len == (raw_pl_len - sizeof(sxs_uint16_t) - 1)) {
-        pl->desc_string = malloc(desc_string_len + 1);
-        if (pl->desc_string = NULL) {
-            return -1;
-        }
-    } else if (desc_string_len > (raw_pl_len - sizeof(sxs_uint16_t))) {
-        /* missing a null character terminating the description string */
+
+    /* The description should be null terminated, but some servents
+     * leave the terminator off, so the payload length bounds it. */
+    desc_string_len = raw_pl_len - sizeof(sxs_uint16_t);
+    nul_p = (unsigned char *)memchr((const void *)tmp_p, '\0',
+        desc_string_len);
+    if (nul_p != NULL) {
+        desc_string_len = nul_p - tmp_p;
+    }
+    if (desc_string_len >= 0xffff) {
         return -2;
-    } else {
-        pl->desc_string = malloc(desc_string_len + 1);
-        if (pl->desc_string == NULL) {
-            return -3;
-        }
     }
-    
+
+    pl->desc_string = (char *)malloc(desc_string_len + 1);
+    if (pl->desc_string == NULL) {
+        return -1;
+    }
+
     memcpy((void *)pl->desc_string, (const void *)tmp_p, desc_string_len);
     pl->desc_string[desc_string_len] = '\0';
-    
+
     pl->desc_string_len = desc_string_len + 1;
-    
+
+    return 0;
+}
+
+int _gnut_build_bye_msg_payload(gnut_bye_payload_t *pl,
+    unsigned char *raw_pl) {
+
+    raw_pl[0] = (unsigned char)(pl->code & 0xff);
+    raw_pl[1] = (unsigned char)((pl->code >> 8) & 0xff);
+    memcpy((void *)(raw_pl + sizeof(sxs_uint16_t)),
+        (const void *)pl->desc_string, pl->desc_string_len - 1);
+    raw_pl[sizeof(sxs_uint16_t) + pl->desc_string_len - 1] = '\0';
+
     return 0;
 }
 
+int _gnut_calc_bye_msg_payload_len(gnut_bye_payload_t *pl) {
+    return (sizeof(sxs_uint16_t) + pl->desc_string_len);
+}
+
 void _gnut_free_bye_msg_payload(gnut_bye_payload_t *pl) {
     if (pl->desc_string != NULL) {
         free(pl->desc_string);
+        pl->desc_string = NULL;
     }
-}
\ No newline at end of file
+}
@@ -23,15 +23,24 @@
 #ifndef GNUT_BYE_MSG_H
 #define GNUT_BYE_MSG_H
 
+#include <sxs/sxs.h>
+
+#include "gnut_export.h"
+
 typedef struct gnut_bye_payload {
     sxs_uint16_t code;
     char *desc_string;
-    sxs_uint16_t desc_string_len;
+    sxs_uint16_t desc_string_len;   /* Including the terminating null */
 } gnut_bye_payload_t;
 
-int _gnut_parse_bye_msg_payload(gnut_bye_payload_t *pl,
+GNUT_EXPORT int _gnut_parse_bye_msg_payload(gnut_bye_payload_t *pl,
     unsigned char *raw_pl, sxs_uint32_t raw_pl_len);
 
-void _gnut_free_bye_msg_payload(gnut_bye_payload_t *pl);
+GNUT_EXPORT int _gnut_build_bye_msg_payload(gnut_bye_payload_t *pl,
+    unsigned char *raw_pl);
+
+GNUT_EXPORT int _gnut_calc_bye_msg_payload_len(gnut_bye_payload_t *pl);
+
+GNUT_EXPORT void _gnut_free_bye_msg_payload(gnut_bye_payload_t *pl);
 
-#endif /* GNUT_BYE_MSG_H */
\ No newline at end of file
+#endif /* GNUT_BYE_MSG_H */
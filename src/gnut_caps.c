@@ -0,0 +1,103 @@
+/*
+ * Copyright 2006-2007 Andrew De Ponte
+ *
+ * This file is part of lib_gnut.
+ *
+ * lib_gnut is the intellectual property of Andrew De Ponte; any
+ * distribution and/or modification and/or reproductions of any portion
+ * of lib_gnut MUST be approved by Andrew De Ponte.
+ *
+ * lib_gnut is distributed WITHOUT ANY WARRANTY; without even the
+ * implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE.
+ */
+
+/**
+ * @file gnut_caps.c
+ * @brief This is an implementation file for peer capabilities.
+ *
+ * The gnut_caps.c file is an implementation file that defines the
+ * gnut_caps_t type's associated functions.
+ */
+
+#include "gnut_caps.h"
+
+void gnut_caps_init(gnut_caps_t *caps) {
+    caps->flags = 0;
+    caps->hops_flow = GNUT_CAPS_NO_LIMIT;
+    caps->max_ttl = GNUT_CAPS_NO_LIMIT;
+}
+
+void gnut_caps_from_hs(gnut_caps_t *caps, const gnut_hs_parser_t *p,
+    const char *buf) {
+
+    const gnut_hs_hdr_t *hdr;
+    gnut_span_t val;
+    unsigned int ttl;
+    sxs_uint16_t i;
+
+    if (gnut_hs_get_hdr(p, GNUT_HS_HDR_X_ULTRAPEER, &val) == GNUT_SUCCESS &&
+        gnut_hs_has_token(buf, val, "true", 4)) {
+        caps->flags |= GNUT_CAPS_ULTRAPEER;
+    }
+    if (gnut_hs_find_hdr(p, buf, "Vendor-Message", 14) != NULL) {
+        caps->flags |= GNUT_CAPS_VENDOR_MSGS;
+    }
+
+    hdr = gnut_hs_find_hdr(p, buf, "X-Max-TTL", 9);
+    if (hdr == NULL || hdr->value.len == 0) {
+        return;
+    }
+    ttl = 0;
+    for (i = 0; i < hdr->value.len; i++) {
+        if (buf[hdr->value.off + i] < '0' || buf[hdr->value.off + i] > '9') {
+            return;
+        }
+        if (ttl < GNUT_CAPS_NO_LIMIT) {
+            ttl = (ttl * 10) + (buf[hdr->value.off + i] - '0');
+        }
+    }
+    caps->max_ttl = (ttl < GNUT_CAPS_NO_LIMIT) ? (unsigned char)ttl :
+        GNUT_CAPS_NO_LIMIT;
+}
+
+gnut_error_t gnut_caps_vmsg(gnut_caps_t *caps, const gnut_vmsg_t *vm) {
+    switch (vm->kind) {
+        case GNUT_VMSG_K_HOPS_FLOW:
+            if (vm->data_len < 1) {
+                return GNUT_EMALFORMED;
+            }
+            caps->hops_flow = vm->data[0];
+            return GNUT_SUCCESS;
+        case GNUT_VMSG_K_SUPPORTED:
+            caps->flags |= GNUT_CAPS_VENDOR_MSGS;
+            if (gnut_vmsg_supported_version(vm, GNUT_VMSG_K_HOPS_FLOW) >= 0) {
+                caps->flags |= GNUT_CAPS_HOPS_FLOW;
+            }
+            return GNUT_SUCCESS;
+        default:
+            return GNUT_ENOT_FOUND;
+    }
+}
+
+/* Only Queries are limited; a peer that is busy still wants the replies
+ * to its own searches. */
+static int _gnut_caps_allows(const gnut_caps_t *caps, int type, int ttl,
+    int hops) {
+
+    if (type != GNUT_MSG_QUERY) {
+        return 1;
+    }
+    if (caps->hops_flow != GNUT_CAPS_NO_LIMIT && hops >= caps->hops_flow) {
+        return 0;
+    }
+    return caps->max_ttl == GNUT_CAPS_NO_LIMIT || ttl <= caps->max_ttl;
+}
+
+int gnut_caps_allows(const gnut_caps_t *caps, const gnut_msg_hdr_t *hdr) {
+    return _gnut_caps_allows(caps, hdr->type, hdr->ttl, hdr->hops);
+}
+
+int gnut_caps_allows_raw(const gnut_caps_t *caps, const unsigned char *raw) {
+    return _gnut_caps_allows(caps, raw[16], raw[17], raw[18]);
+}
@@ -0,0 +1,131 @@
+/*
+ * Copyright 2006-2007 Andrew De Ponte
+ *
+ * This file is part of lib_gnut.
+ *
+ * lib_gnut is the intellectual property of Andrew De Ponte; any
+ * distribution and/or modification and/or reproductions of any portion
+ * of lib_gnut MUST be approved by Andrew De Ponte.
+ *
+ * lib_gnut is distributed WITHOUT ANY WARRANTY; without even the
+ * implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE.
+ */
+
+/**
+ * @file gnut_caps.h
+ * @brief This is a specifications file for peer capabilities.
+ *
+ * The gnut_caps.h file is a specifications file that declares the
+ * gnut_caps_t type and its associated functions. A peer says in its
+ * handshake headers what it is and takes, and later, in Vendor
+ * Messages, how much it can take: a Hops Flow asks that no Query with
+ * as many hops as it gives be sent any more, and one of 0 that no
+ * Query be sent at all, as a busy peer does. Each gnut_conn_t keeps a
+ * gnut_caps_t, fed from the handshake by the connection and from the
+ * Vendor Messages by its owner, and refuses to queue what the peer
+ * would only drop; asking gnut_conn_allows() first spares encoding
+ * such a message at all.
+ */
+
+#ifndef GNUT_CAPS_H
+#define GNUT_CAPS_H
+
+#include <sxs/sxs.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+#include "gnut_export.h"
+#include "gnut_types.h"
+#include "gnut_error.h"
+#include "gnut_msgs.h"
+#include "gnut_handshake.h"
+#include "gnut_vendor.h"
+
+#define GNUT_CAPS_NO_LIMIT 255 /**< Hops flow or TTL when none is given */
+
+#define GNUT_CAPS_ULTRAPEER 0x01 /**< Said X-Ultrapeer: True */
+#define GNUT_CAPS_VENDOR_MSGS 0x02 /**< Sent a Vendor-Message header */
+#define GNUT_CAPS_HOPS_FLOW 0x04 /**< Listed Hops Flow as supported */
+
+/**
+ * Peer Capabilities
+ *
+ * The gnut_caps_t is a type which holds what a peer has said it is and
+ * takes, as GNUT_CAPS_* flags and the limits on the Queries sent to it.
+ */
+typedef struct GNUT_EXPORT gnut_caps {
+    unsigned char flags;
+    unsigned char hops_flow;    /* Queries sent must have fewer hops */
+    unsigned char max_ttl;      /* Queries sent must have no more TTL */
+} gnut_caps_t;
+
+/**
+ * Initialize Peer Capabilities
+ *
+ * The gnut_caps_init() function clears the flags and lifts the limits.
+ * @param caps Pointer to the capabilities to initialize.
+ */
+GNUT_EXPORT void gnut_caps_init(gnut_caps_t *caps);
+
+/**
+ * Take Peer Capabilities from a Handshake
+ *
+ * The gnut_caps_from_hs() function sets the flags and limits the
+ * peer's handshake headers give: X-Ultrapeer, Vendor-Message and
+ * X-Max-TTL.
+ * @param caps Pointer to the capabilities.
+ * @param p Pointer to the parser of the peer's last handshake block.
+ * @param buf Pointer to the bytes of the block.
+ */
+GNUT_EXPORT void gnut_caps_from_hs(gnut_caps_t *caps,
+    const gnut_hs_parser_t *p, const char *buf);
+
+/**
+ * Take Peer Capabilities from a Vendor Message
+ *
+ * The gnut_caps_vmsg() function updates the capabilities from a Hops
+ * Flow or a Messages Supported Vendor Message received from the peer.
+ * @param caps Pointer to the capabilities.
+ * @param vm Pointer to the parsed Vendor Message.
+ * @return A value representing an error or success.
+ * @retval GNUT_SUCCESS Successfully updated the capabilities.
+ * @retval GNUT_ENOT_FOUND The message tells nothing of capabilities.
+ * @retval GNUT_EMALFORMED The message is too short.
+ */
+GNUT_EXPORT gnut_error_t gnut_caps_vmsg(gnut_caps_t *caps,
+    const gnut_vmsg_t *vm);
+
+/**
+ * Check Whether a Peer Takes a Message
+ *
+ * The gnut_caps_allows() function tells whether the message of header
+ * 'hdr', as it would be sent, is within the limits the peer gave.
+ * @param caps Pointer to the capabilities of the peer.
+ * @param hdr Pointer to the header of the message to send.
+ * @return Non-zero if the message may be queued, 0 if it would only be
+ * dropped by the peer.
+ */
+GNUT_EXPORT int gnut_caps_allows(const gnut_caps_t *caps,
+    const gnut_msg_hdr_t *hdr);
+
+/**
+ * Check Whether a Peer Takes an Encoded Message
+ *
+ * The gnut_caps_allows_raw() function is gnut_caps_allows() for a
+ * message already in its wire format.
+ * @param caps Pointer to the capabilities of the peer.
+ * @param raw Pointer to the message's wire bytes, header included.
+ * @return Non-zero if the message may be queued, 0 if it would only be
+ * dropped by the peer.
+ */
+GNUT_EXPORT int gnut_caps_allows_raw(const gnut_caps_t *caps,
+    const unsigned char *raw);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* GNUT_CAPS_H */
@@ -0,0 +1,297 @@
+/*
+ * Copyright 2006-2007 Andrew De Ponte
+ *
+ * This file is part of lib_gnut.
+ *
+ * lib_gnut is the intellectual property of Andrew De Ponte; any
+ * distribution and/or modification and/or reproductions of any portion
+ * of lib_gnut MUST be approved by Andrew De Ponte.
+ *
+ * lib_gnut is distributed WITHOUT ANY WARRANTY; without even the
+ * implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE.
+ */
+
+/**
+ * @file gnut_capture.c
+ * @brief This is an implementation file for stream capture files.
+ *
+ * The gnut_capture.c file is an implementation file that defines the
+ * gnut_capture_t type's associated functions.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdio.h> /* fopen(), fwrite(), fread(), fseeko(), fclose() */
+#include <stdint.h> /* SIZE_MAX */
+#include <sys/types.h> /* off_t */
+#include <stdlib.h> /* calloc(), malloc(), free() */
+#include <string.h> /* memcpy(), memcmp() */
+
+#include "gnut_capture.h"
+
+#define CAP_MAGIC "GNUTCAP\001"
+#define CAP_HDR_LEN 16
+#define CAP_MAX_REC_HDR 26 /* Three varints, or two and an address */
+
+struct gnut_capture {
+    FILE *fp;                   /* Set when writing */
+    unsigned char *buf;         /* The whole file, when reading */
+    size_t len;
+    size_t off;
+    gnut_uint64_t start;
+    gnut_uint64_t last;         /* Time of the last record */
+};
+
+static unsigned char *_gnut_cap_put_varint(unsigned char *p,
+    gnut_uint64_t v) {
+
+    while (v >= 0x80) {
+        *p++ = (unsigned char)(v | 0x80);
+        v >>= 7;
+    }
+    *p++ = (unsigned char)v;
+
+    return p;
+}
+
+static int _gnut_cap_get_varint(gnut_capture_t *cap, gnut_uint64_t *p_v) {
+    gnut_uint64_t v;
+    unsigned int shift;
+    unsigned char b;
+
+    v = 0;
+    for (shift = 0; shift < 64; shift += 7) {
+        if (cap->off >= cap->len) {
+            return -1;
+        }
+        b = cap->buf[cap->off++];
+        v |= (gnut_uint64_t)(b & 0x7f) << shift;
+        if ((b & 0x80) == 0) {
+            *p_v = v;
+            return 0;
+        }
+    }
+
+    return -1;
+}
+
+static void _gnut_cap_put_le64(unsigned char *p, gnut_uint64_t v) {
+    int i;
+
+    for (i = 0; i < 8; i++) {
+        p[i] = (unsigned char)(v >> (8 * i));
+    }
+}
+
+static gnut_uint64_t _gnut_cap_get_le64(const unsigned char *p) {
+    gnut_uint64_t v;
+    int i;
+
+    v = 0;
+    for (i = 7; i >= 0; i--) {
+        v = (v << 8) | p[i];
+    }
+
+    return v;
+}
+
+gnut_error_t gnut_capture_create(gnut_capture_t **pp_cap, const char *path,
+    gnut_uint64_t now) {
+
+    gnut_capture_t *cap;
+    unsigned char hdr[CAP_HDR_LEN];
+
+    cap = (gnut_capture_t *)calloc(1, sizeof(gnut_capture_t));
+    if (cap == NULL) {
+        return GNUT_ENOMEM;
+    }
+    cap->fp = fopen(path, "wb");
+    if (cap->fp == NULL) {
+        free(cap);
+        return GNUT_EFILE;
+    }
+
+    memcpy((void *)hdr, (const void *)CAP_MAGIC, 8);
+    _gnut_cap_put_le64(hdr + 8, now);
+    if (fwrite(hdr, 1, CAP_HDR_LEN, cap->fp) != CAP_HDR_LEN) {
+        fclose(cap->fp);
+        free(cap);
+        return GNUT_EFILE;
+    }
+    cap->start = now;
+    cap->last = now;
+
+    *pp_cap = cap;
+    return GNUT_SUCCESS;
+}
+
+gnut_error_t gnut_capture_open(gnut_capture_t **pp_cap, const char *path) {
+    gnut_capture_t *cap;
+    FILE *fp;
+    off_t size;
+
+    cap = (gnut_capture_t *)calloc(1, sizeof(gnut_capture_t));
+    if (cap == NULL) {
+        return GNUT_ENOMEM;
+    }
+    fp = fopen(path, "rb");
+    if (fp == NULL) {
+        free(cap);
+        return GNUT_EFILE;
+    }
+    if (fseeko(fp, 0, SEEK_END) != 0 || (size = ftello(fp)) < CAP_HDR_LEN ||
+        fseeko(fp, 0, SEEK_SET) != 0) {
+        fclose(fp);
+        free(cap);
+        return GNUT_EFILE;
+    }
+    /* The whole file is read into memory, so it must fit in it. */
+    if ((gnut_uint64_t)size > SIZE_MAX) {
+        fclose(fp);
+        free(cap);
+        return GNUT_ENOMEM;
+    }
+    cap->buf = (unsigned char *)malloc((size_t)size);
+    if (cap->buf == NULL) {
+        fclose(fp);
+        free(cap);
+        return GNUT_ENOMEM;
+    }
+    if (fread(cap->buf, 1, (size_t)size, fp) != (size_t)size ||
+        memcmp(cap->buf, CAP_MAGIC, 8) != 0) {
+        fclose(fp);
+        free(cap->buf);
+        free(cap);
+        return GNUT_EFILE;
+    }
+    fclose(fp);
+
+    cap->len = (size_t)size;
+    cap->start = _gnut_cap_get_le64(cap->buf + 8);
+    gnut_capture_rewind(cap);
+
+    *pp_cap = cap;
+    return GNUT_SUCCESS;
+}
+
+gnut_error_t gnut_capture_close(gnut_capture_t *cap) {
+    gnut_error_t err;
+
+    err = GNUT_SUCCESS;
+    if (cap->fp != NULL && fclose(cap->fp) != 0) {
+        err = GNUT_EFILE;
+    }
+    free(cap->buf);
+    free(cap);
+
+    return err;
+}
+
+static gnut_error_t _gnut_cap_write(gnut_capture_t *cap, int kind,
+    sxs_uint32_t conn, gnut_uint64_t now, const unsigned char *extra,
+    sxs_uint32_t extra_len, const unsigned char *data, sxs_uint32_t len) {
+
+    unsigned char hdr[CAP_MAX_REC_HDR], *p;
+
+    p = _gnut_cap_put_varint(hdr, ((gnut_uint64_t)conn << 2) | kind);
+    p = _gnut_cap_put_varint(p, (now > cap->last) ? now - cap->last : 0);
+    if (now > cap->last) {
+        cap->last = now;
+    }
+    if (extra_len > 0) {
+        memcpy((void *)p, (const void *)extra, extra_len);
+        p += extra_len;
+    }
+
+    if (fwrite(hdr, 1, p - hdr, cap->fp) != (size_t)(p - hdr)) {
+        return GNUT_EFILE;
+    }
+    if (len > 0 && fwrite(data, 1, len, cap->fp) != len) {
+        return GNUT_EFILE;
+    }
+
+    return GNUT_SUCCESS;
+}
+
+gnut_error_t gnut_capture_conn_open(gnut_capture_t *cap, sxs_uint32_t conn,
+    sxs_uint32_t ip, sxs_uint16_t port, gnut_uint64_t now) {
+
+    unsigned char addr[6];
+
+    memcpy((void *)addr, (const void *)&ip, 4);
+    addr[4] = (unsigned char)(port & 0xff);
+    addr[5] = (unsigned char)(port >> 8);
+
+    return _gnut_cap_write(cap, GNUT_CAP_OPEN, conn, now, addr, 6, NULL, 0);
+}
+
+gnut_error_t gnut_capture_data(gnut_capture_t *cap, sxs_uint32_t conn,
+    const unsigned char *data, sxs_uint32_t len, gnut_uint64_t now) {
+
+    unsigned char vlen[10];
+
+    return _gnut_cap_write(cap, GNUT_CAP_DATA, conn, now, vlen,
+        _gnut_cap_put_varint(vlen, len) - vlen, data, len);
+}
+
+gnut_error_t gnut_capture_conn_close(gnut_capture_t *cap, sxs_uint32_t conn,
+    gnut_uint64_t now) {
+
+    return _gnut_cap_write(cap, GNUT_CAP_CLOSE, conn, now, NULL, 0, NULL, 0);
+}
+
+gnut_error_t gnut_capture_next(gnut_capture_t *cap, gnut_cap_rec_t *p_rec) {
+    gnut_uint64_t tag, delta, len;
+    const unsigned char *p;
+
+    if (cap->off >= cap->len) {
+        return GNUT_EEOF;
+    }
+    if (_gnut_cap_get_varint(cap, &tag) != 0 ||
+        _gnut_cap_get_varint(cap, &delta) != 0) {
+        return GNUT_EFILE;
+    }
+    cap->last += delta;
+    p_rec->kind = (int)(tag & 3);
+    p_rec->conn = (sxs_uint32_t)(tag >> 2);
+    p_rec->when = cap->last;
+
+    switch (p_rec->kind) {
+        case GNUT_CAP_OPEN:
+            if (cap->len - cap->off < 6) {
+                return GNUT_EFILE;
+            }
+            p = cap->buf + cap->off;
+            memcpy((void *)&p_rec->ip, (const void *)p, 4);
+            p_rec->port = (sxs_uint16_t)(p[4] | (p[5] << 8));
+            cap->off += 6;
+            break;
+        case GNUT_CAP_DATA:
+            if (_gnut_cap_get_varint(cap, &len) != 0 ||
+                len > cap->len - cap->off || len > 0xffffffffUL) {
+                return GNUT_EFILE;
+            }
+            p_rec->data = cap->buf + cap->off;
+            p_rec->len = (sxs_uint32_t)len;
+            cap->off += (size_t)len;
+            break;
+        case GNUT_CAP_CLOSE:
+            break;
+        default:
+            return GNUT_EFILE;
+    }
+
+    return GNUT_SUCCESS;
+}
+
+void gnut_capture_rewind(gnut_capture_t *cap) {
+    cap->off = CAP_HDR_LEN;
+    cap->last = cap->start;
+}
+
+size_t gnut_capture_size(const gnut_capture_t *cap) {
+    return cap->len;
+}
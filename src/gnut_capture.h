@@ -0,0 +1,197 @@
+/*
+ * Copyright 2006-2007 Andrew De Ponte
+ *
+ * This file is part of lib_gnut.
+ *
+ * lib_gnut is the intellectual property of Andrew De Ponte; any
+ * distribution and/or modification and/or reproductions of any portion
+ * of lib_gnut MUST be approved by Andrew De Ponte.
+ *
+ * lib_gnut is distributed WITHOUT ANY WARRANTY; without even the
+ * implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE.
+ */
+
+/**
+ * @file gnut_capture.h
+ * @brief This is a specifications file for stream capture files.
+ *
+ * The gnut_capture.h file is a specifications file that declares the
+ * gnut_capture_t type and its associated functions. A capture file
+ * records the bytes received on any number of connections, interleaved
+ * in the order they arrived, so they can be replayed offline. The bytes
+ * recorded are those a framer is fed: after the handshake and after
+ * any decompression.
+ *
+ * The file starts with the 8 bytes "GNUTCAP" 0x01 and the 8 byte
+ * little-endian start time in microseconds. Each record that follows
+ * is a varint tag, conn << 2 | kind, and a varint of the microseconds
+ * since the previous record. An open record then has the 4 byte IPv4
+ * address in network byte order and the 2 byte little-endian port, a
+ * data record has a varint length and the bytes, and a close record
+ * has nothing more. Varints are little-endian base 128.
+ */
+
+#ifndef GNUT_CAPTURE_H
+#define GNUT_CAPTURE_H
+
+#include <sxs/sxs.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+#include "gnut_export.h"
+#include "gnut_types.h"
+#include "gnut_error.h"
+
+#define GNUT_CAP_OPEN 0 /**< A connection was opened */
+#define GNUT_CAP_DATA 1 /**< Bytes were received on a connection */
+#define GNUT_CAP_CLOSE 2 /**< A connection was closed */
+
+/**
+ * A Capture File
+ *
+ * The gnut_capture_t is an opaque type which represents a capture file
+ * open for either writing or reading.
+ */
+typedef struct gnut_capture gnut_capture_t;
+
+/**
+ * A Capture Record
+ *
+ * The gnut_cap_rec_t is a type which represents one record read from a
+ * capture file. Only the fields of its kind are set.
+ */
+typedef struct GNUT_EXPORT gnut_cap_rec {
+    int kind;                   /* GNUT_CAP_OPEN, _DATA or _CLOSE */
+    sxs_uint32_t conn;
+    gnut_uint64_t when;         /* Microseconds, on the writer's clock */
+    sxs_uint32_t ip;            /* Open: network byte order */
+    sxs_uint16_t port;          /* Open: host byte order */
+    const unsigned char *data;  /* Data: valid until the file is closed */
+    sxs_uint32_t len;           /* Data */
+} gnut_cap_rec_t;
+
+/**
+ * Create a Capture File
+ *
+ * The gnut_capture_create() function creates, or truncates, the capture
+ * file at 'path' and opens it for writing.
+ * @param pp_cap Pointer to store the pointer to the capture in.
+ * @param path Path of the file.
+ * @param now The current time in microseconds.
+ * @return A value representing an error or success.
+ * @retval GNUT_SUCCESS Successfully created the capture file.
+ * @retval GNUT_ENOMEM Failed to allocate memory.
+ * @retval GNUT_EFILE Failed to create the file.
+ */
+GNUT_EXPORT gnut_error_t gnut_capture_create(gnut_capture_t **pp_cap,
+    const char *path, gnut_uint64_t now);
+
+/**
+ * Open a Capture File
+ *
+ * The gnut_capture_open() function reads the whole capture file at
+ * 'path' into memory, so that replaying it does no I/O.
+ * @param pp_cap Pointer to store the pointer to the capture in.
+ * @param path Path of the file.
+ * @return A value representing an error or success.
+ * @retval GNUT_SUCCESS Successfully opened the capture file.
+ * @retval GNUT_ENOMEM Failed to allocate memory, or the file is larger
+ * than the address space.
+ * @retval GNUT_EFILE Failed to read the file, or it is not a capture.
+ */
+GNUT_EXPORT gnut_error_t gnut_capture_open(gnut_capture_t **pp_cap,
+    const char *path);
+
+/**
+ * Close a Capture File
+ *
+ * @param cap Pointer to the capture.
+ * @return A value representing an error or success.
+ * @retval GNUT_SUCCESS Successfully closed the capture file.
+ * @retval GNUT_EFILE Failed to write out the last records.
+ */
+GNUT_EXPORT gnut_error_t gnut_capture_close(gnut_capture_t *cap);
+
+/**
+ * Record a Connection Opening
+ *
+ * @param cap Pointer to a capture open for writing.
+ * @param conn The connection id.
+ * @param ip The peer's IPv4 address in network byte order.
+ * @param port The peer's port in host byte order.
+ * @param now The current time in microseconds.
+ * @return A value representing an error or success.
+ * @retval GNUT_SUCCESS Successfully recorded the event.
+ * @retval GNUT_EFILE Failed to write the record.
+ */
+GNUT_EXPORT gnut_error_t gnut_capture_conn_open(gnut_capture_t *cap,
+    sxs_uint32_t conn, sxs_uint32_t ip, sxs_uint16_t port,
+    gnut_uint64_t now);
+
+/**
+ * Record Bytes Received on a Connection
+ *
+ * @param cap Pointer to a capture open for writing.
+ * @param conn The connection id.
+ * @param data Pointer to the bytes received.
+ * @param len The number of bytes received.
+ * @param now The current time in microseconds.
+ * @return A value representing an error or success.
+ * @retval GNUT_SUCCESS Successfully recorded the event.
+ * @retval GNUT_EFILE Failed to write the record.
+ */
+GNUT_EXPORT gnut_error_t gnut_capture_data(gnut_capture_t *cap,
+    sxs_uint32_t conn, const unsigned char *data, sxs_uint32_t len,
+    gnut_uint64_t now);
+
+/**
+ * Record a Connection Closing
+ *
+ * @param cap Pointer to a capture open for writing.
+ * @param conn The connection id.
+ * @param now The current time in microseconds.
+ * @return A value representing an error or success.
+ * @retval GNUT_SUCCESS Successfully recorded the event.
+ * @retval GNUT_EFILE Failed to write the record.
+ */
+GNUT_EXPORT gnut_error_t gnut_capture_conn_close(gnut_capture_t *cap,
+    sxs_uint32_t conn, gnut_uint64_t now);
+
+/**
+ * Read the Next Capture Record
+ *
+ * @param cap Pointer to a capture open for reading.
+ * @param p_rec Pointer to store the record in.
+ * @return A value representing an error or success.
+ * @retval GNUT_SUCCESS Successfully read a record.
+ * @retval GNUT_EEOF There are no more records.
+ * @retval GNUT_EFILE The record is truncated or malformed.
+ */
+GNUT_EXPORT gnut_error_t gnut_capture_next(gnut_capture_t *cap,
+    gnut_cap_rec_t *p_rec);
+
+/**
+ * Rewind a Capture File
+ *
+ * The gnut_capture_rewind() function makes the next read return the
+ * first record again.
+ * @param cap Pointer to a capture open for reading.
+ */
+GNUT_EXPORT void gnut_capture_rewind(gnut_capture_t *cap);
+
+/**
+ * Get the Size of a Capture File
+ *
+ * @param cap Pointer to a capture open for reading.
+ * @return The size of the file in bytes.
+ */
+GNUT_EXPORT size_t gnut_capture_size(const gnut_capture_t *cap);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* GNUT_CAPTURE_H */
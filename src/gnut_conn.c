@@ -0,0 +1,779 @@
+/*
+ * Copyright 2006-2007 Andrew De Ponte
+ *
+ * This file is part of lib_gnut.
+ *
+ * lib_gnut is the intellectual property of Andrew De Ponte; any
+ * distribution and/or modification and/or reproductions of any portion
+ * of lib_gnut MUST be approved by Andrew De Ponte.
+ *
+ * lib_gnut is distributed WITHOUT ANY WARRANTY; without even the
+ * implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE.
+ */
+
+/**
+ * @file gnut_conn.c
+ * @brief This is an implementation file for the connection driver.
+ *
+ * The gnut_conn.c file is an implementation file that defines the
+ * gnut_conn_t type's associated functions.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdlib.h> /* calloc(), malloc(), free() */
+#include <string.h> /* memset(), memcpy(), memmove(), memcmp() */
+
+#include "gnut_conn.h"
+#include "gnut_stats.h"
+#include "gnut_probes.h"
+
+#ifdef MSG_NOSIGNAL
+#define SEND_FLAGS MSG_NOSIGNAL
+#else
+#define SEND_FLAGS 0
+#endif
+
+#define RBUF_LEN 16384
+#define READS_PER_EVENT 4 /* Bound the bytes one peer can feed per turn */
+
+#define HS_ACCEPT_DEFLATE "Accept-Encoding: deflate\r\n"
+#define HS_CONTENT_DEFLATE "Content-Encoding: deflate\r\n"
+
+/* The lanes whose messages draw on the shaper's bulk bucket. */
+#define BULK_LANES (GNUT_OUTQ_LANE_BIT(GNUT_OUTQ_LANE_QUERY) | \
+    GNUT_OUTQ_LANE_BIT(GNUT_OUTQ_LANE_PING))
+
+GNUT_PROBE_SEMAPHORE(conn_recv);
+GNUT_PROBE_SEMAPHORE(conn_send);
+GNUT_PROBE_SEMAPHORE(send_done);
+
+struct gnut_conn {
+    gnut_evloop_t *loop;
+    sxs_socket_t sd;
+    gnut_conn_cfg_t cfg;
+    int state;
+    int hs_step;                /* Incoming: 0 for CONNECT, 1 for ack */
+    char *hs_buf;               /* Handshake bytes, freed once done */
+    sxs_uint32_t hs_len;
+    gnut_hs_parser_t hs;
+    gnut_timer_t timer;         /* Handshake timeout, then shaping wait */
+    gnut_bucket_t bucket;
+    int blocked;                /* Lanes waiting for tokens */
+    gnut_framer_t framer;
+    gnut_outq_t outq;
+    gnut_deflate_t *link;       /* NULL unless a side compresses */
+    int deflate_rx;             /* The peer compresses what it sends */
+    int deflate_tx;             /* We compress what we send */
+    unsigned char *ibuf;        /* Inflated bytes, RBUF_LEN long */
+    gnut_caps_t caps;           /* What the peer has said it takes */
+    gnut_enc_msg_t *cur;        /* Message partly copied into wbuf */
+    sxs_uint32_t cur_off;
+    sxs_uint32_t wlen;
+    sxs_uint32_t woff;
+    int want_write;             /* Registered for GNUT_EV_WRITE */
+    int depth;                  /* Callbacks of ours on the stack */
+    int dead;                   /* Free once depth drops to zero */
+    int detached;               /* The socket was handed to on_http */
+    int timing;                 /* Timing the messages of this read */
+    gnut_uint64_t t_mark;       /* When framing of the next one began */
+    gnut_capture_t *cap;
+    sxs_uint32_t cap_id;
+    sxs_uint32_t ip;
+    sxs_uint16_t port;
+    gnut_conn_stats_t stats;
+    void *user;
+    unsigned char wbuf[GNUT_CONN_WBUF_LEN];
+};
+
+static void _gnut_conn_flush(gnut_conn_t *c);
+
+void gnut_conn_cfg_init(gnut_conn_cfg_t *cfg) {
+    memset(cfg, 0, sizeof(gnut_conn_cfg_t));
+    cfg->hs_timeout = GNUT_CONN_DEF_HS_TIMEOUT;
+    cfg->burst = GNUT_SHAPER_DEF_BURST;
+    gnut_outq_cfg_init(&cfg->outq);
+}
+
+static void _gnut_conn_free(gnut_conn_t *c) {
+    if (!c->detached) {
+        gnut_evloop_del(c->loop, c->sd);
+        sxs_close(c->sd);
+    }
+    gnut_evloop_timer_stop(c->loop, &c->timer);
+    if (c->cap != NULL) {
+        gnut_capture_conn_close(c->cap, c->cap_id, gnut_evloop_now(c->loop));
+    }
+    if (c->cur != NULL) {
+        gnut_enc_msg_unref(c->cur);
+    }
+    gnut_outq_destroy(&c->outq);
+    gnut_framer_destroy(&c->framer);
+    if (c->link != NULL) {
+        gnut_deflate_free(c->link);
+    }
+    free(c->ibuf);
+    free(c->hs_buf);
+    free(c);
+}
+
+/* Frees the connection if it died while our callbacks were running. */
+static void _gnut_conn_leave(gnut_conn_t *c) {
+    c->depth--;
+    if (c->dead && c->depth == 0) {
+        _gnut_conn_free(c);
+    }
+}
+
+static void _gnut_conn_fail(gnut_conn_t *c, gnut_error_t reason) {
+    if (c->state == GNUT_CONN_CLOSED) {
+        return;
+    }
+    c->state = GNUT_CONN_CLOSED;
+    c->dead = 1;
+    if (c->cfg.on_close != NULL) {
+        c->cfg.on_close(c, reason, c->cfg.arg);
+    }
+}
+
+static int _gnut_conn_send_block(gnut_conn_t *c, const char *buf,
+    sxs_uint32_t len) {
+
+    sxs_ssize_t sent;
+
+    /* A handshake block always fits in an idle socket's send buffer. */
+    if (sxs_send(c->sd, (sxs_buf_t)buf, len, SEND_FLAGS, &sent) !=
+        SXS_SUCCESS || (sxs_uint32_t)sent != len) {
+        return 0;
+    }
+    c->stats.tx_bytes += len;
+    return 1;
+}
+
+/* Sends the template, or a bare 200 OK without one, with the deflate
+ * headers: the offer if 'offer' is set, and the agreement once made. */
+static int _gnut_conn_send_hs(gnut_conn_t *c, const gnut_hs_tmpl_t *tmpl,
+    int offer) {
+
+    char extra[sizeof(HS_ACCEPT_DEFLATE) + sizeof(HS_CONTENT_DEFLATE)];
+    char buf[GNUT_HS_TMPL_MAX + sizeof(extra) + 2];
+    gnut_hs_tmpl_t ok;
+    sxs_uint32_t len, extra_len;
+
+    extra_len = 0;
+    if (offer && c->cfg.deflate) {
+        memcpy(extra, HS_ACCEPT_DEFLATE, strlen(HS_ACCEPT_DEFLATE));
+        extra_len += strlen(HS_ACCEPT_DEFLATE);
+    }
+    if (c->deflate_tx) {
+        memcpy(extra + extra_len, HS_CONTENT_DEFLATE,
+            strlen(HS_CONTENT_DEFLATE));
+        extra_len += strlen(HS_CONTENT_DEFLATE);
+    }
+
+    if (tmpl == NULL) {
+        if (gnut_hs_tmpl_init(&ok, GNUT_HS_OK_LINE) != GNUT_SUCCESS) {
+            return 0;
+        }
+        tmpl = &ok;
+    }
+    if (gnut_hs_build(tmpl, extra, extra_len, buf, sizeof(buf), &len) !=
+        GNUT_SUCCESS) {
+        return 0;
+    }
+    return _gnut_conn_send_block(c, buf, len);
+}
+
+/* Whether the block just parsed lists deflate in header 'hdr_id'. */
+static int _gnut_conn_hs_deflate(const gnut_conn_t *c, int hdr_id) {
+    gnut_span_t val;
+
+    return (gnut_hs_get_hdr(&c->hs, hdr_id, &val) == GNUT_SUCCESS &&
+        gnut_hs_has_token(c->hs_buf, val, "deflate", 7));
+}
+
+static void _gnut_conn_framed(const gnut_msg_hdr_t *hdr,
+    const unsigned char *raw, const unsigned char *payload, void *arg) {
+
+    gnut_conn_t *c;
+    gnut_uint64_t t;
+
+    c = (gnut_conn_t *)arg;
+    /* An earlier message of the same read may have closed us. */
+    if (c->state != GNUT_CONN_ESTABLISHED) {
+        return;
+    }
+    c->stats.rx_msgs++;
+    GNUT_PROBE4(conn_recv, c->sd, hdr->type,
+        GNUT_PROBE_GUID(hdr->message_id), hdr->pl_len);
+    if (c->timing) {
+        t = gnut_stats_clock();
+        gnut_stats_record(GNUT_STATS_H_PARSE, t - c->t_mark);
+        c->t_mark = t;
+    }
+    if (c->cfg.on_msg != NULL) {
+        c->cfg.on_msg(c, hdr, raw, payload, c->cfg.arg);
+        if (c->timing) {
+            t = gnut_stats_clock();
+            gnut_stats_record(GNUT_STATS_H_FORWARD, t - c->t_mark);
+            c->t_mark = t;
+        }
+    }
+}
+
+static void _gnut_conn_frame(gnut_conn_t *c, const unsigned char *data,
+    sxs_uint32_t len) {
+
+    gnut_error_t err;
+
+    if (len == 0 || c->state != GNUT_CONN_ESTABLISHED) {
+        return;
+    }
+    if (c->cap != NULL) {
+        gnut_capture_data(c->cap, c->cap_id, data, len,
+            gnut_evloop_now(c->loop));
+    }
+    /* Framing time runs from here or the end of the previous message's
+     * callback, so that the callbacks are timed on their own. */
+    c->timing = gnut_stats_timing();
+    if (c->timing) {
+        c->t_mark = gnut_stats_clock();
+    }
+    err = gnut_framer_feed(&c->framer, data, len, _gnut_conn_framed, c);
+    if (err != GNUT_SUCCESS) {
+        _gnut_conn_fail(c, err);
+    }
+}
+
+/* Hands the bytes of the stream to the framer, inflating them first if
+ * the peer compresses. */
+static void _gnut_conn_feed(gnut_conn_t *c, const unsigned char *data,
+    sxs_uint32_t len) {
+
+    sxs_uint32_t used, n;
+
+    if (!c->deflate_rx) {
+        _gnut_conn_frame(c, data, len);
+        return;
+    }
+
+    /* zlib may hold output back when 'ibuf' fills, even with all of
+     * the input taken. */
+    n = 0;
+    while ((len > 0 || n == RBUF_LEN) &&
+        c->state == GNUT_CONN_ESTABLISHED) {
+        if (gnut_deflate_decompress(c->link, data, len, c->ibuf, RBUF_LEN,
+            &used, &n) != GNUT_SUCCESS) {
+            _gnut_conn_fail(c, GNUT_EDEFLATE);
+            return;
+        }
+        data += used;
+        len -= used;
+        _gnut_conn_frame(c, c->ibuf, n);
+    }
+}
+
+static void _gnut_conn_established(gnut_conn_t *c, const unsigned char *rest,
+    sxs_uint32_t rest_len) {
+
+    gnut_error_t err;
+
+    gnut_evloop_timer_stop(c->loop, &c->timer);
+    if (c->deflate_rx && !c->cfg.deflate) {
+        _gnut_conn_fail(c, GNUT_EHS_REJECTED);
+        return;
+    }
+    if (c->deflate_rx || c->deflate_tx) {
+        err = gnut_deflate_new(&c->link, c->cfg.deflate_cfg,
+            c->cfg.deflate_budget);
+        if (err != GNUT_SUCCESS) {
+            _gnut_conn_fail(c, err);
+            return;
+        }
+    }
+    if (c->deflate_rx) {
+        c->ibuf = (unsigned char *)malloc(RBUF_LEN);
+        if (c->ibuf == NULL) {
+            _gnut_conn_fail(c, GNUT_ENOMEM);
+            return;
+        }
+    }
+    c->state = GNUT_CONN_ESTABLISHED;
+    if (c->cfg.on_up != NULL) {
+        c->cfg.on_up(c, c->cfg.arg);
+    }
+
+    /* Whatever followed the last block is the start of the stream. */
+    _gnut_conn_feed(c, (const unsigned char *)c->hs_buf + c->hs.pos,
+        c->hs_len - c->hs.pos);
+    _gnut_conn_feed(c, rest, rest_len);
+    free(c->hs_buf);
+    c->hs_buf = NULL;
+    c->hs_len = 0;
+}
+
+static void _gnut_conn_hs_input(gnut_conn_t *c, const unsigned char *data,
+    sxs_uint32_t len) {
+
+    sxs_uint32_t n;
+    gnut_error_t err;
+
+    n = GNUT_HS_MAX_LEN - c->hs_len;
+    if (n > len) {
+        n = len;
+    }
+    memcpy((void *)(c->hs_buf + c->hs_len), (const void *)data, n);
+    c->hs_len += n;
+    data += n;
+    len -= n;
+
+    if (!c->cfg.outgoing && c->hs_step == 0 && c->cfg.on_http != NULL &&
+        c->hs_len >= 4 && memcmp(c->hs_buf, "GET ", 4) == 0) {
+        gnut_evloop_del(c->loop, c->sd);
+        c->detached = 1;
+        c->state = GNUT_CONN_CLOSED;
+        c->dead = 1;
+        c->cfg.on_http(c, c->sd, c->hs_buf, c->hs_len, c->cfg.arg);
+        return;
+    }
+
+    for (;;) {
+        err = gnut_hs_parse(&c->hs, c->hs_buf, c->hs_len);
+        if (err == GNUT_EHS_INCOMPLETE) {
+            if (c->hs_len == GNUT_HS_MAX_LEN) {
+                _gnut_conn_fail(c, GNUT_EHS_TOO_LARGE);
+            }
+            return;
+        } else if (err != GNUT_SUCCESS) {
+            _gnut_conn_fail(c, err);
+            return;
+        }
+
+        /* Take what the block says of the peer now, as the parser is
+         * reused for the ack that follows a CONNECT. */
+        gnut_caps_from_hs(&c->caps, &c->hs, c->hs_buf);
+        if (c->cfg.outgoing) {
+            c->deflate_rx = _gnut_conn_hs_deflate(c,
+                GNUT_HS_HDR_CONTENT_ENCODING);
+            c->deflate_tx = c->cfg.deflate && _gnut_conn_hs_deflate(c,
+                GNUT_HS_HDR_ACCEPT_ENCODING);
+            if (c->hs.is_connect || c->hs.status_code != 200) {
+                _gnut_conn_fail(c, GNUT_EHS_REJECTED);
+            } else if (!_gnut_conn_send_hs(c, NULL, 0)) {
+                _gnut_conn_fail(c, GNUT_ESOCKET);
+            } else {
+                _gnut_conn_established(c, data, len);
+            }
+            return;
+        }
+
+        if (c->hs_step == 1) {
+            c->deflate_rx = _gnut_conn_hs_deflate(c,
+                GNUT_HS_HDR_CONTENT_ENCODING);
+            if (c->hs.is_connect || c->hs.status_code != 200) {
+                _gnut_conn_fail(c, GNUT_EHS_REJECTED);
+            } else {
+                _gnut_conn_established(c, data, len);
+            }
+            return;
+        }
+
+        if (!c->hs.is_connect) {
+            _gnut_conn_fail(c, GNUT_EHS_MALFORMED);
+            return;
+        }
+        c->deflate_tx = c->cfg.deflate && _gnut_conn_hs_deflate(c,
+            GNUT_HS_HDR_ACCEPT_ENCODING);
+        if (!_gnut_conn_send_hs(c, c->cfg.tmpl, 1)) {
+            _gnut_conn_fail(c, GNUT_ESOCKET);
+            return;
+        }
+        /* The peer's ack may have arrived with its CONNECT. */
+        c->hs_step = 1;
+        c->hs_len -= c->hs.pos;
+        memmove((void *)c->hs_buf, (const void *)(c->hs_buf + c->hs.pos),
+            c->hs_len);
+        gnut_hs_parser_init(&c->hs);
+        n = GNUT_HS_MAX_LEN - c->hs_len;
+        if (n > len) {
+            n = len;
+        }
+        memcpy((void *)(c->hs_buf + c->hs_len), (const void *)data, n);
+        c->hs_len += n;
+        data += n;
+        len -= n;
+    }
+}
+
+static void _gnut_conn_read(gnut_conn_t *c) {
+    unsigned char buf[RBUF_LEN];
+    sxs_ssize_t n;
+    sxs_error_t err;
+    int i;
+
+    for (i = 0; i < READS_PER_EVENT && c->state != GNUT_CONN_CLOSED; i++) {
+        err = sxs_recv(c->sd, (sxs_buf_t)buf, sizeof(buf), 0, &n);
+        if (err == SXS_EWOULDBLOCK || err == SXS_EINTR) {
+            return;
+        } else if (err != SXS_SUCCESS) {
+            _gnut_conn_fail(c, GNUT_ESOCKET);
+            return;
+        } else if (n == 0) {
+            _gnut_conn_fail(c, GNUT_EEOF);
+            return;
+        }
+        c->stats.rx_bytes += n;
+
+        if (c->state == GNUT_CONN_HANDSHAKE) {
+            _gnut_conn_hs_input(c, buf, (sxs_uint32_t)n);
+        } else {
+            _gnut_conn_feed(c, buf, (sxs_uint32_t)n);
+        }
+        if ((sxs_uint32_t)n < sizeof(buf)) {
+            return;
+        }
+    }
+}
+
+/* Gets the lanes the rate limits allow a message to be sent from. */
+static int _gnut_conn_lanes(gnut_conn_t *c, gnut_uint64_t now) {
+    if (!gnut_bucket_ready(&c->bucket, now)) {
+        return 0;
+    }
+    if (c->cfg.shaper != NULL &&
+        !gnut_bucket_ready(&c->cfg.shaper->bulk, now)) {
+        return GNUT_OUTQ_ALL_LANES & ~BULK_LANES;
+    }
+    return GNUT_OUTQ_ALL_LANES;
+}
+
+/* Copies as many queued messages as fit, and the rate limits allow,
+ * into the write buffer, compressed if we compress. */
+static void _gnut_conn_refill(gnut_conn_t *c) {
+    gnut_uint64_t now;
+    sxs_uint32_t n, out_len;
+    int lanes;
+
+    now = gnut_evloop_now(c->loop);
+    c->wlen = 0;
+    c->woff = 0;
+    while (c->wlen < GNUT_CONN_WBUF_LEN) {
+        if (c->cur == NULL) {
+            lanes = _gnut_conn_lanes(c, now);
+            c->cur = gnut_outq_pop_lanes(&c->outq, now, lanes);
+            if (c->cur == NULL) {
+                if (c->outq.len > 0) {
+                    c->blocked = GNUT_OUTQ_ALL_LANES & ~lanes;
+                }
+                /* Nothing more can go out for now, so let the peer
+                 * have everything compressed so far. A flush that does
+                 * not fit is resumed by the next refill. */
+                if (c->deflate_tx && gnut_deflate_needs_flush(c->link)) {
+                    if (gnut_deflate_flush(c->link, c->wbuf + c->wlen,
+                        GNUT_CONN_WBUF_LEN - c->wlen, &out_len) ==
+                        GNUT_EDEFLATE) {
+                        _gnut_conn_fail(c, GNUT_EDEFLATE);
+                        return;
+                    }
+                    c->wlen += out_len;
+                }
+                break;
+            }
+            c->cur_off = 0;
+            gnut_bucket_charge(&c->bucket, c->cur->len);
+            if (c->cfg.shaper != NULL && (BULK_LANES &
+                GNUT_OUTQ_LANE_BIT(gnut_outq_lane_of(c->cur->data[16])))) {
+                gnut_bucket_charge(&c->cfg.shaper->bulk, c->cur->len);
+            }
+        }
+        if (c->deflate_tx) {
+            if (gnut_deflate_compress(c->link, c->cur->data + c->cur_off,
+                c->cur->len - c->cur_off, c->wbuf + c->wlen,
+                GNUT_CONN_WBUF_LEN - c->wlen, &n, &out_len) !=
+                GNUT_SUCCESS) {
+                _gnut_conn_fail(c, GNUT_EDEFLATE);
+                return;
+            }
+            c->wlen += out_len;
+            if (n == 0 && out_len == 0) {
+                break;
+            }
+        } else {
+            n = c->cur->len - c->cur_off;
+            if (n > GNUT_CONN_WBUF_LEN - c->wlen) {
+                n = GNUT_CONN_WBUF_LEN - c->wlen;
+            }
+            memcpy((void *)(c->wbuf + c->wlen),
+                (const void *)(c->cur->data + c->cur_off), n);
+            c->wlen += n;
+        }
+        c->cur_off += n;
+        if (c->cur_off == c->cur->len) {
+            GNUT_PROBE4(send_done, c->sd, c->cur->data[16],
+                GNUT_PROBE_GUID(c->cur->data), c->cur->len);
+            gnut_stats_tx(gnut_node_type_index(c->cur->data[16]),
+                c->cur->len);
+            gnut_enc_msg_unref(c->cur);
+            c->cur = NULL;
+            c->stats.tx_msgs++;
+        }
+    }
+}
+
+static void _gnut_conn_shaper_cb(gnut_evloop_t *loop, void *arg) {
+    gnut_conn_t *c;
+
+    c = (gnut_conn_t *)arg;
+    c->depth++;
+    c->blocked = 0;
+    _gnut_conn_flush(c);
+    _gnut_conn_leave(c);
+}
+
+/* Waits for the tokens the blocked lanes need, with the socket's write
+ * interest dropped so the loop does not spin meanwhile. */
+static int _gnut_conn_defer(gnut_conn_t *c) {
+    gnut_uint64_t wait;
+
+    if (c->blocked & ~BULK_LANES) {
+        wait = gnut_bucket_wait(&c->bucket);
+    } else {
+        wait = gnut_bucket_wait(&c->cfg.shaper->bulk);
+    }
+    if (wait < GNUT_SHAPER_MIN_WAIT) {
+        wait = GNUT_SHAPER_MIN_WAIT;
+    }
+    if (gnut_evloop_timer_start(c->loop, &c->timer, wait,
+        _gnut_conn_shaper_cb, c) != GNUT_SUCCESS) {
+        return 0;
+    }
+    c->stats.deferred++;
+    return 1;
+}
+
+static void _gnut_conn_flush(gnut_conn_t *c) {
+    sxs_ssize_t sent;
+    sxs_error_t err;
+
+    for (;;) {
+        if (c->woff == c->wlen) {
+            _gnut_conn_refill(c);
+            if (c->state == GNUT_CONN_CLOSED) {
+                return;
+            }
+            if (c->wlen == 0) {
+                if (c->blocked && !_gnut_conn_defer(c)) {
+                    _gnut_conn_fail(c, GNUT_ENOMEM);
+                    return;
+                }
+                if (c->want_write &&
+                    gnut_evloop_mod(c->loop, c->sd, GNUT_EV_READ) ==
+                    GNUT_SUCCESS) {
+                    c->want_write = 0;
+                }
+                return;
+            }
+        }
+
+        err = sxs_send(c->sd, (sxs_buf_t)(c->wbuf + c->woff),
+            c->wlen - c->woff, SEND_FLAGS, &sent);
+        if (err == SXS_EWOULDBLOCK || err == SXS_EINTR) {
+            return;
+        } else if (err != SXS_SUCCESS) {
+            _gnut_conn_fail(c, GNUT_ESOCKET);
+            return;
+        }
+        c->stats.sends++;
+        c->stats.tx_bytes += sent;
+        c->woff += (sxs_uint32_t)sent;
+        if (c->woff < c->wlen) {
+            return;
+        }
+    }
+}
+
+static void _gnut_conn_io_cb(gnut_evloop_t *loop, sxs_socket_t sd,
+    int events, void *arg) {
+
+    gnut_conn_t *c;
+
+    c = (gnut_conn_t *)arg;
+    c->depth++;
+    if (events & (GNUT_EV_READ | GNUT_EV_ERROR)) {
+        _gnut_conn_read(c);
+    }
+    if ((events & GNUT_EV_WRITE) && c->state == GNUT_CONN_ESTABLISHED) {
+        _gnut_conn_flush(c);
+    }
+    _gnut_conn_leave(c);
+}
+
+static void _gnut_conn_timeout_cb(gnut_evloop_t *loop, void *arg) {
+    gnut_conn_t *c;
+
+    c = (gnut_conn_t *)arg;
+    c->depth++;
+    _gnut_conn_fail(c, GNUT_ETIMEDOUT);
+    _gnut_conn_leave(c);
+}
+
+gnut_error_t gnut_conn_new(gnut_conn_t **pp_c, gnut_evloop_t *loop,
+    sxs_socket_t sd, const struct sockaddr_in *addr,
+    const gnut_conn_cfg_t *cfg) {
+
+    gnut_conn_t *c;
+
+    c = (gnut_conn_t *)calloc(1, sizeof(gnut_conn_t));
+    if (c == NULL) {
+        sxs_close(sd);
+        return GNUT_ENOMEM;
+    }
+    c->hs_buf = (char *)malloc(GNUT_HS_MAX_LEN);
+    if (c->hs_buf == NULL) {
+        free(c);
+        sxs_close(sd);
+        return GNUT_ENOMEM;
+    }
+    c->loop = loop;
+    c->sd = sd;
+    c->cfg = *cfg;
+    c->state = GNUT_CONN_HANDSHAKE;
+    if (addr != NULL) {
+        c->ip = addr->sin_addr.s_addr;
+        c->port = sxs_ntohs(addr->sin_port);
+    }
+    gnut_hs_parser_init(&c->hs);
+    gnut_caps_init(&c->caps);
+    gnut_timer_init(&c->timer);
+    gnut_framer_init(&c->framer, cfg->max_pl_len);
+    gnut_outq_init(&c->outq, &cfg->outq);
+    gnut_bucket_init(&c->bucket, cfg->rate, cfg->burst,
+        (cfg->shaper != NULL) ? &cfg->shaper->classes[cfg->shaper_class] :
+        NULL, gnut_evloop_now(loop));
+
+    if (gnut_evloop_add(loop, sd, GNUT_EV_READ, _gnut_conn_io_cb, c) !=
+        GNUT_SUCCESS) {
+        _gnut_conn_free(c);
+        return GNUT_EEVLOOP;
+    }
+    if (cfg->outgoing && !cfg->hs_sent &&
+        !_gnut_conn_send_hs(c, cfg->tmpl, 1)) {
+        _gnut_conn_free(c);
+        return GNUT_ESOCKET;
+    }
+    if (cfg->hs_timeout > 0 && gnut_evloop_timer_start(loop, &c->timer,
+        cfg->hs_timeout, _gnut_conn_timeout_cb, c) != GNUT_SUCCESS) {
+        _gnut_conn_free(c);
+        return GNUT_EEVLOOP;
+    }
+
+    *pp_c = c;
+    return GNUT_SUCCESS;
+}
+
+void gnut_conn_close(gnut_conn_t *c) {
+    c->state = GNUT_CONN_CLOSED;
+    if (c->depth > 0) {
+        c->dead = 1;
+    } else {
+        _gnut_conn_free(c);
+    }
+}
+
+gnut_error_t gnut_conn_send(gnut_conn_t *c, gnut_enc_msg_t *msg) {
+    gnut_error_t err;
+
+    if (c->state != GNUT_CONN_ESTABLISHED) {
+        c->stats.refused++;
+        gnut_stats_drop(GNUT_STATS_DROP_CLOSED);
+        return GNUT_EQUEUE_FULL;
+    }
+    if (!gnut_caps_allows_raw(&c->caps, msg->data)) {
+        c->stats.pruned++;
+        gnut_stats_drop(GNUT_STATS_DROP_PRUNED);
+        return GNUT_EPEER_LIMIT;
+    }
+    GNUT_PROBE4(conn_send, c->sd, msg->data[16], GNUT_PROBE_GUID(msg->data),
+        msg->len);
+    err = gnut_outq_push(&c->outq, msg, gnut_evloop_now(c->loop));
+    if (err != GNUT_SUCCESS) {
+        c->stats.refused++;
+        return err;
+    }
+
+    /* Writing waits for the loop, so that everything queued in this
+     * turn goes out in as few sends as possible, or for the shaping
+     * timer if the message's lane is out of tokens. */
+    if (c->blocked & GNUT_OUTQ_LANE_BIT(gnut_outq_lane_of(msg->data[16]))) {
+        return GNUT_SUCCESS;
+    }
+    if (!c->want_write && gnut_evloop_mod(c->loop, c->sd,
+        GNUT_EV_READ | GNUT_EV_WRITE) == GNUT_SUCCESS) {
+        c->want_write = 1;
+    }
+
+    return GNUT_SUCCESS;
+}
+
+int gnut_conn_allows(const gnut_conn_t *c, const gnut_msg_hdr_t *hdr) {
+    return gnut_caps_allows(&c->caps, hdr);
+}
+
+void gnut_conn_set_rate(gnut_conn_t *c, gnut_uint64_t rate,
+    sxs_uint32_t burst) {
+
+    gnut_bucket_set_rate(&c->bucket, rate, burst);
+}
+
+void gnut_conn_capture(gnut_conn_t *c, gnut_capture_t *cap,
+    sxs_uint32_t id) {
+
+    c->cap = cap;
+    c->cap_id = id;
+    gnut_capture_conn_open(cap, id, c->ip, c->port, gnut_evloop_now(c->loop));
+}
+
+int gnut_conn_state(const gnut_conn_t *c) {
+    return c->state;
+}
+
+const gnut_outq_t *gnut_conn_outq(const gnut_conn_t *c) {
+    return &c->outq;
+}
+
+const gnut_conn_stats_t *gnut_conn_stats(const gnut_conn_t *c) {
+    return &c->stats;
+}
+
+gnut_caps_t *gnut_conn_caps(gnut_conn_t *c) {
+    return &c->caps;
+}
+
+const gnut_deflate_t *gnut_conn_deflate(const gnut_conn_t *c) {
+    return c->link;
+}
+
+const gnut_hs_parser_t *gnut_conn_handshake(const gnut_conn_t *c,
+    const char **p_buf) {
+
+    *p_buf = c->hs_buf;
+    return &c->hs;
+}
+
+void gnut_conn_set_user(gnut_conn_t *c, void *user) {
+    c->user = user;
+}
+
+void *gnut_conn_user(const gnut_conn_t *c) {
+    return c->user;
+}
+
+void gnut_conn_peer(const gnut_conn_t *c, sxs_uint32_t *p_ip,
+    sxs_uint16_t *p_port) {
+
+    *p_ip = c->ip;
+    *p_port = c->port;
+}
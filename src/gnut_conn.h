@@ -0,0 +1,361 @@
+/*
+ * Copyright 2006-2007 Andrew De Ponte
+ *
+ * This file is part of lib_gnut.
+ *
+ * lib_gnut is the intellectual property of Andrew De Ponte; any
+ * distribution and/or modification and/or reproductions of any portion
+ * of lib_gnut MUST be approved by Andrew De Ponte.
+ *
+ * lib_gnut is distributed WITHOUT ANY WARRANTY; without even the
+ * implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE.
+ */
+
+/**
+ * @file gnut_conn.h
+ * @brief This is a specifications file for the connection driver.
+ *
+ * The gnut_conn.h file is a specifications file that declares the
+ * gnut_conn_t type and its associated functions. A connection drives
+ * one non-blocking socket on an event loop: it performs the three way
+ * 0.6 handshake, as either side, then frames the messages it receives
+ * and writes out its output queue, coalescing small messages into as
+ * few sends as possible. A connection that offers deflate compresses
+ * the stream in each direction the handshake agreed on, flushing the
+ * compressor whenever the output queue has nothing more to give.
+ */
+
+#ifndef GNUT_CONN_H
+#define GNUT_CONN_H
+
+#include <sxs/sxs.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+#include "gnut_export.h"
+#include "gnut_types.h"
+#include "gnut_error.h"
+#include "gnut_evloop.h"
+#include "gnut_handshake.h"
+#include "gnut_outq.h"
+#include "gnut_framer.h"
+#include "gnut_capture.h"
+#include "gnut_shaper.h"
+#include "gnut_deflate.h"
+#include "gnut_caps.h"
+
+#define GNUT_CONN_DEF_HS_TIMEOUT 10000000 /**< Default handshake timeout */
+#define GNUT_CONN_WBUF_LEN 16384 /**< Bytes coalesced into one send */
+
+#define GNUT_CONN_HANDSHAKE 0 /**< Handshake in progress */
+#define GNUT_CONN_ESTABLISHED 1 /**< Exchanging messages */
+#define GNUT_CONN_CLOSED 2 /**< Closed, waiting to be freed */
+
+/**
+ * A Connection
+ *
+ * The gnut_conn_t is an opaque type which represents a connection.
+ */
+typedef struct gnut_conn gnut_conn_t;
+
+/**
+ * A Connection Established Callback
+ *
+ * The gnut_conn_up_cb_t is the type of function called once the
+ * handshake of a connection has completed.
+ */
+typedef void (*gnut_conn_up_cb_t)(gnut_conn_t *c, void *arg);
+
+/**
+ * A Connection Message Callback
+ *
+ * The gnut_conn_msg_cb_t is the type of function called with each
+ * message received. 'raw' points at the message's wire bytes, header
+ * included, and like 'payload' is only valid during the call. The
+ * callee may send on, or close, any connection, including this one.
+ */
+typedef void (*gnut_conn_msg_cb_t)(gnut_conn_t *c, const gnut_msg_hdr_t *hdr,
+    const unsigned char *raw, const unsigned char *payload, void *arg);
+
+/**
+ * A Connection Closed Callback
+ *
+ * The gnut_conn_close_cb_t is the type of function called when a
+ * connection closes on its own, with the reason it did so. The
+ * connection is freed as soon as the callback returns.
+ */
+typedef void (*gnut_conn_close_cb_t)(gnut_conn_t *c, gnut_error_t reason,
+    void *arg);
+
+/**
+ * A Connection HTTP Request Callback
+ *
+ * The gnut_conn_http_cb_t is the type of function called when an
+ * incoming connection opens with an HTTP GET rather than a CONNECT.
+ * The callee takes ownership of the socket, already removed from the
+ * event loop, and of the 'len' bytes read so far at 'data', which are
+ * only valid during the call. The connection is freed as soon as the
+ * callback returns, without its close callback being called.
+ */
+typedef void (*gnut_conn_http_cb_t)(gnut_conn_t *c, sxs_socket_t sd,
+    const char *data, sxs_uint32_t len, void *arg);
+
+/**
+ * A Connection Configuration
+ *
+ * The gnut_conn_cfg_t is a type which holds the settings of a
+ * connection. Use gnut_conn_cfg_init() to get the defaults. The
+ * template is the CONNECT block for outgoing connections and the
+ * response block for incoming ones, and must outlive the connection.
+ * A connection sends at most 'rate' bytes per second, with bursts of
+ * 'burst' bytes, and if 'shaper' is set also within the limits of
+ * class 'shaper_class' of it, which must be below
+ * GNUT_SHAPER_MAX_CLASSES, and its global and bulk limits. The limits
+ * count message bytes, before any compression. If 'deflate' is set
+ * the connection adds "Accept-Encoding: deflate" to the blocks it
+ * sends, and "Content-Encoding: deflate" once the peer has offered it
+ * too; a CONNECT block sent by the caller has to offer it itself.
+ */
+typedef struct GNUT_EXPORT gnut_conn_cfg {
+    int outgoing;               /* Non-zero if we dialed the peer */
+    int hs_sent;                /* The CONNECT block was already sent */
+    const gnut_hs_tmpl_t *tmpl;
+    gnut_uint64_t hs_timeout;   /* Microseconds */
+    sxs_uint32_t max_pl_len;    /* 0 for the framer's default */
+    gnut_outq_cfg_t outq;
+    gnut_shaper_t *shaper;      /* NULL for no shared limits */
+    int shaper_class;
+    gnut_uint64_t rate;         /* Bytes per second, 0 for unlimited */
+    sxs_uint32_t burst;         /* Bytes */
+    int deflate;                /* Non-zero to offer and accept deflate */
+    const gnut_deflate_cfg_t *deflate_cfg; /* NULL for the defaults */
+    gnut_deflate_budget_t *deflate_budget; /* NULL for no budget */
+    gnut_conn_up_cb_t on_up;
+    gnut_conn_msg_cb_t on_msg;
+    gnut_conn_close_cb_t on_close;
+    gnut_conn_http_cb_t on_http; /* NULL to fail HTTP requests */
+    void *arg;                  /* Passed to all the callbacks */
+} gnut_conn_cfg_t;
+
+/**
+ * Connection Statistics
+ *
+ * The gnut_conn_stats_t is a type which holds the counters of a
+ * connection.
+ */
+typedef struct GNUT_EXPORT gnut_conn_stats {
+    gnut_uint64_t rx_bytes;
+    gnut_uint64_t tx_bytes;
+    gnut_uint64_t rx_msgs;
+    gnut_uint64_t tx_msgs;
+    gnut_uint64_t sends;        /* Send calls made */
+    gnut_uint64_t refused;      /* Messages the output queue refused */
+    gnut_uint64_t pruned;       /* Messages over the peer's limits */
+    gnut_uint64_t deferred;     /* Times sending waited for tokens */
+} gnut_conn_stats_t;
+
+/**
+ * Initialize a Connection Configuration
+ *
+ * The gnut_conn_cfg_init() function fills in 'cfg' with default
+ * values: incoming, no template, the default handshake timeout and
+ * output queue settings, no rate limits, no compression, and no
+ * callbacks.
+ * @param cfg Pointer to the configuration to initialize.
+ */
+GNUT_EXPORT void gnut_conn_cfg_init(gnut_conn_cfg_t *cfg);
+
+/**
+ * Create a Connection
+ *
+ * The gnut_conn_new() function takes ownership of the connected,
+ * non-blocking socket 'sd', registers it with 'loop' and starts the
+ * handshake, sending the CONNECT block first if the connection is
+ * outgoing and it has not been sent yet. On failure the socket is
+ * closed.
+ * @param pp_c Pointer to store the pointer to the new connection in.
+ * @param loop Pointer to the event loop to run on.
+ * @param sd The socket.
+ * @param addr The peer's address, or NULL.
+ * @param cfg Pointer to the configuration, which is copied.
+ * @return A value representing an error or success.
+ * @retval GNUT_SUCCESS Successfully created the connection.
+ * @retval GNUT_ENOMEM Failed to allocate memory.
+ * @retval GNUT_EEVLOOP Failed to register the socket.
+ * @retval GNUT_ESOCKET Failed to send the CONNECT block.
+ */
+GNUT_EXPORT gnut_error_t gnut_conn_new(gnut_conn_t **pp_c,
+    gnut_evloop_t *loop, sxs_socket_t sd, const struct sockaddr_in *addr,
+    const gnut_conn_cfg_t *cfg);
+
+/**
+ * Close a Connection
+ *
+ * The gnut_conn_close() function closes the socket and frees the
+ * connection, without calling its close callback. Messages still
+ * queued are discarded. When called from one of the connection's own
+ * callbacks the connection is freed once the callback returns.
+ * @param c Pointer to the connection.
+ */
+GNUT_EXPORT void gnut_conn_close(gnut_conn_t *c);
+
+/**
+ * Send a Message on a Connection
+ *
+ * The gnut_conn_send() function queues 'msg' on the connection's
+ * output queue, taking a reference to it on success, and arranges for
+ * it to be written once the socket is writable and the rate limits
+ * allow it. A message the peer has asked not to be sent is refused.
+ * @param c Pointer to an established connection.
+ * @param msg Pointer to the message.
+ * @return A value representing an error or success.
+ * @retval GNUT_SUCCESS Successfully queued the message.
+ * @retval GNUT_EQUEUE_FULL The output queue shed the message, or the
+ * connection is not established.
+ * @retval GNUT_EPEER_LIMIT The message is over the peer's limits.
+ * @retval GNUT_ENOMEM Failed to grow the output queue.
+ */
+GNUT_EXPORT gnut_error_t gnut_conn_send(gnut_conn_t *c, gnut_enc_msg_t *msg);
+
+/**
+ * Check Whether a Connection Takes a Message
+ *
+ * The gnut_conn_allows() function tells whether gnut_conn_send() would
+ * take the message of header 'hdr' as far as the peer's limits go, so
+ * that a message no peer takes need not be encoded.
+ * @param c Pointer to the connection.
+ * @param hdr Pointer to the header of the message to send.
+ * @return Non-zero if the message is within the peer's limits, 0 if
+ * not.
+ */
+GNUT_EXPORT int gnut_conn_allows(const gnut_conn_t *c,
+    const gnut_msg_hdr_t *hdr);
+
+/**
+ * Change the Rate Limit of a Connection
+ *
+ * The gnut_conn_set_rate() function changes the rate and burst the
+ * connection itself is limited to. Its class and the shaper's shared
+ * limits still apply.
+ * @param c Pointer to the connection.
+ * @param rate The rate in bytes per second, or 0 for unlimited.
+ * @param burst The burst in bytes.
+ */
+GNUT_EXPORT void gnut_conn_set_rate(gnut_conn_t *c, gnut_uint64_t rate,
+    sxs_uint32_t burst);
+
+/**
+ * Record a Connection to a Capture File
+ *
+ * The gnut_conn_capture() function records the opening of the
+ * connection to 'cap' under the id 'id', and from then on every byte
+ * of the message stream it receives and its closing.
+ * @param c Pointer to the connection.
+ * @param cap Pointer to a capture open for writing, which must outlive
+ * the connection.
+ * @param id The connection id to record.
+ */
+GNUT_EXPORT void gnut_conn_capture(gnut_conn_t *c, gnut_capture_t *cap,
+    sxs_uint32_t id);
+
+/**
+ * Get the State of a Connection
+ *
+ * @param c Pointer to the connection.
+ * @return GNUT_CONN_HANDSHAKE, GNUT_CONN_ESTABLISHED or GNUT_CONN_CLOSED.
+ */
+GNUT_EXPORT int gnut_conn_state(const gnut_conn_t *c);
+
+/**
+ * Get the Output Queue of a Connection
+ *
+ * @param c Pointer to the connection.
+ * @return Pointer to the output queue.
+ */
+GNUT_EXPORT const gnut_outq_t *gnut_conn_outq(const gnut_conn_t *c);
+
+/**
+ * Get the Statistics of a Connection
+ *
+ * @param c Pointer to the connection.
+ * @return Pointer to the statistics.
+ */
+GNUT_EXPORT const gnut_conn_stats_t *gnut_conn_stats(const gnut_conn_t *c);
+
+/**
+ * Get the Capabilities of a Connection's Peer
+ *
+ * The gnut_conn_caps() function gives access to what the peer has said
+ * it is and takes. The connection fills it in from the peer's
+ * handshake blocks, the CONNECT of an incoming connection included,
+ * before calling the established callback; the owner feeds it the Hops
+ * Flow and Messages Supported Vendor Messages with gnut_caps_vmsg().
+ * @param c Pointer to the connection.
+ * @return Pointer to the capabilities.
+ */
+GNUT_EXPORT gnut_caps_t *gnut_conn_caps(gnut_conn_t *c);
+
+/**
+ * Get the Deflate Link of a Connection
+ *
+ * The gnut_conn_deflate() function gives access to the compressor and
+ * decompressor of the connection, e.g. for gnut_deflate_get_stats().
+ * A direction the handshake did not agree on has no bytes counted.
+ * @param c Pointer to the connection.
+ * @return Pointer to the link, or NULL if neither side compresses.
+ */
+GNUT_EXPORT const gnut_deflate_t *gnut_conn_deflate(const gnut_conn_t *c);
+
+/**
+ * Get the Handshake Parser of a Connection
+ *
+ * The gnut_conn_handshake() function gives access to the last
+ * handshake block received: the peer's response for an outgoing
+ * connection, and the peer's final ack, not its CONNECT, for an
+ * incoming one. It is only valid during the established callback,
+ * when the peer's headers may be inspected; what the CONNECT said of
+ * the peer is kept in gnut_conn_caps().
+ * @param c Pointer to the connection.
+ * @param p_buf Pointer to store the pointer to the block's bytes in.
+ * @return Pointer to the parser.
+ */
+GNUT_EXPORT const gnut_hs_parser_t *gnut_conn_handshake(const gnut_conn_t *c,
+    const char **p_buf);
+
+/**
+ * Set the User Pointer of a Connection
+ *
+ * @param c Pointer to the connection.
+ * @param user The pointer to store.
+ */
+GNUT_EXPORT void gnut_conn_set_user(gnut_conn_t *c, void *user);
+
+/**
+ * Get the User Pointer of a Connection
+ *
+ * @param c Pointer to the connection.
+ * @return The pointer stored with gnut_conn_set_user(), or NULL.
+ */
+GNUT_EXPORT void *gnut_conn_user(const gnut_conn_t *c);
+
+/**
+ * Get the Address of a Connection's Peer
+ *
+ * The gnut_conn_peer() function gets the address the connection was
+ * created with, or zeros if it was created without one.
+ * @param c Pointer to the connection.
+ * @param p_ip Pointer to store the IPv4 address in, in network byte
+ * order.
+ * @param p_port Pointer to store the port in, in host byte order.
+ */
+GNUT_EXPORT void gnut_conn_peer(const gnut_conn_t *c, sxs_uint32_t *p_ip,
+    sxs_uint16_t *p_port);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* GNUT_CONN_H */
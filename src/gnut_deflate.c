@@ -0,0 +1,627 @@
+/*
+ * Copyright 2006-2007 Andrew De Ponte
+ *
+ * This file is part of lib_gnut.
+ *
+ * lib_gnut is the intellectual property of Andrew De Ponte; any
+ * distribution and/or modification and/or reproductions of any portion
+ * of lib_gnut MUST be approved by Andrew De Ponte.
+ *
+ * lib_gnut is distributed WITHOUT ANY WARRANTY; without even the
+ * implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE.
+ */
+
+/**
+ * @file gnut_deflate.c
+ * @brief This is an implementation file for deflate link compression.
+ *
+ * The gnut_deflate.c file is an implementation file that defines the
+ * gnut_deflate_t type and the functions used to compress and
+ * decompress the byte stream of a connection.
+ *
+ * Incoming bytes are inflated by zlib. Outgoing bytes are compressed
+ * here: a sync flush makes zlib end its block, which means counting
+ * symbols and building Huffman trees over a few dozen bytes each time
+ * the output queue goes idle, and that dominated the cost of a
+ * compressed message. This encoder finds greedy LZ77 matches through
+ * short hash chains and writes them with the fixed Huffman codes of
+ * RFC 1951, so a flush only costs the end-of-block code and the empty
+ * stored block that byte aligns the stream.
+ */
+
+#include <stdlib.h> /* malloc(), calloc(), free() */
+#include <string.h> /* memcpy(), memmove() */
+#include <zlib.h>
+
+#include "gnut_deflate.h"
+
+#define MIN_MATCH 3
+#define MAX_MATCH 258
+
+/* Compressed bytes are built up in 'obuf' and copied out as the
+ * caller's buffer allows. OBUF_SLACK keeps room for a stream header,
+ * a block header, a sync flush and the bit buffer, so that input is
+ * only taken while at most 9 bits per byte of it are sure to fit. */
+#define OBUF_LEN 8192
+#define OBUF_SLACK 32
+
+#define HASH(p, shift) \
+    (((((sxs_uint32_t)(p)[0] << 16) | ((sxs_uint32_t)(p)[1] << 8) | \
+    (p)[2]) * 2654435761U) >> (shift))
+
+struct gnut_deflate {
+    z_stream inf;
+    int inf_ready;
+    int hdr_done;               /* The zlib stream header is written */
+    int block_open;             /* A fixed Huffman block is started */
+    int flushing;               /* A sync flush is partially written */
+    sxs_uint32_t pending;       /* Bytes taken in since last flush */
+    sxs_uint32_t flush_thresh;
+    sxs_uint32_t mem;           /* Bytes allocated for us */
+    gnut_deflate_budget_t *budget;
+    gnut_deflate_stats_t stats;
+    int window_bits;
+    sxs_uint32_t wsize;         /* Largest match distance */
+    sxs_uint32_t wlen;          /* Bytes of history in win */
+    int hash_shift;             /* 32 minus the hash bits */
+    unsigned char *win;         /* History, twice wsize bytes */
+    sxs_uint16_t *head;         /* Newest win offset + 1 per hash */
+    sxs_uint16_t *prev;         /* Older offset + 1 per win offset */
+    int max_chain;              /* Candidates tried per position */
+    gnut_uint64_t bits;         /* Bits not yet in obuf, LSB first */
+    int nbits;
+    sxs_uint32_t ooff;          /* First byte of obuf not copied out */
+    sxs_uint32_t olen;          /* Number of bytes in obuf */
+    unsigned char obuf[OBUF_LEN];
+};
+
+typedef struct {
+    sxs_uint16_t code;          /* Bit reversed, ready to write LSB first */
+    unsigned char len;
+} fixed_code_t;
+
+#define NUM_FIXED_CODES 288
+
+/* The fixed literal/length codes of RFC 1951 section 3.2.6. */
+static const fixed_code_t fixed_codes[NUM_FIXED_CODES] = {
+    {0x00c, 8}, {0x08c, 8}, {0x04c, 8}, {0x0cc, 8}, {0x02c, 8}, {0x0ac, 8},
+    {0x06c, 8}, {0x0ec, 8}, {0x01c, 8}, {0x09c, 8}, {0x05c, 8}, {0x0dc, 8},
+    {0x03c, 8}, {0x0bc, 8}, {0x07c, 8}, {0x0fc, 8}, {0x002, 8}, {0x082, 8},
+    {0x042, 8}, {0x0c2, 8}, {0x022, 8}, {0x0a2, 8}, {0x062, 8}, {0x0e2, 8},
+    {0x012, 8}, {0x092, 8}, {0x052, 8}, {0x0d2, 8}, {0x032, 8}, {0x0b2, 8},
+    {0x072, 8}, {0x0f2, 8}, {0x00a, 8}, {0x08a, 8}, {0x04a, 8}, {0x0ca, 8},
+    {0x02a, 8}, {0x0aa, 8}, {0x06a, 8}, {0x0ea, 8}, {0x01a, 8}, {0x09a, 8},
+    {0x05a, 8}, {0x0da, 8}, {0x03a, 8}, {0x0ba, 8}, {0x07a, 8}, {0x0fa, 8},
+    {0x006, 8}, {0x086, 8}, {0x046, 8}, {0x0c6, 8}, {0x026, 8}, {0x0a6, 8},
+    {0x066, 8}, {0x0e6, 8}, {0x016, 8}, {0x096, 8}, {0x056, 8}, {0x0d6, 8},
+    {0x036, 8}, {0x0b6, 8}, {0x076, 8}, {0x0f6, 8}, {0x00e, 8}, {0x08e, 8},
+    {0x04e, 8}, {0x0ce, 8}, {0x02e, 8}, {0x0ae, 8}, {0x06e, 8}, {0x0ee, 8},
+    {0x01e, 8}, {0x09e, 8}, {0x05e, 8}, {0x0de, 8}, {0x03e, 8}, {0x0be, 8},
+    {0x07e, 8}, {0x0fe, 8}, {0x001, 8}, {0x081, 8}, {0x041, 8}, {0x0c1, 8},
+    {0x021, 8}, {0x0a1, 8}, {0x061, 8}, {0x0e1, 8}, {0x011, 8}, {0x091, 8},
+    {0x051, 8}, {0x0d1, 8}, {0x031, 8}, {0x0b1, 8}, {0x071, 8}, {0x0f1, 8},
+    {0x009, 8}, {0x089, 8}, {0x049, 8}, {0x0c9, 8}, {0x029, 8}, {0x0a9, 8},
+    {0x069, 8}, {0x0e9, 8}, {0x019, 8}, {0x099, 8}, {0x059, 8}, {0x0d9, 8},
+    {0x039, 8}, {0x0b9, 8}, {0x079, 8}, {0x0f9, 8}, {0x005, 8}, {0x085, 8},
+    {0x045, 8}, {0x0c5, 8}, {0x025, 8}, {0x0a5, 8}, {0x065, 8}, {0x0e5, 8},
+    {0x015, 8}, {0x095, 8}, {0x055, 8}, {0x0d5, 8}, {0x035, 8}, {0x0b5, 8},
+    {0x075, 8}, {0x0f5, 8}, {0x00d, 8}, {0x08d, 8}, {0x04d, 8}, {0x0cd, 8},
+    {0x02d, 8}, {0x0ad, 8}, {0x06d, 8}, {0x0ed, 8}, {0x01d, 8}, {0x09d, 8},
+    {0x05d, 8}, {0x0dd, 8}, {0x03d, 8}, {0x0bd, 8}, {0x07d, 8}, {0x0fd, 8},
+    {0x013, 9}, {0x113, 9}, {0x093, 9}, {0x193, 9}, {0x053, 9}, {0x153, 9},
+    {0x0d3, 9}, {0x1d3, 9}, {0x033, 9}, {0x133, 9}, {0x0b3, 9}, {0x1b3, 9},
+    {0x073, 9}, {0x173, 9}, {0x0f3, 9}, {0x1f3, 9}, {0x00b, 9}, {0x10b, 9},
+    {0x08b, 9}, {0x18b, 9}, {0x04b, 9}, {0x14b, 9}, {0x0cb, 9}, {0x1cb, 9},
+    {0x02b, 9}, {0x12b, 9}, {0x0ab, 9}, {0x1ab, 9}, {0x06b, 9}, {0x16b, 9},
+    {0x0eb, 9}, {0x1eb, 9}, {0x01b, 9}, {0x11b, 9}, {0x09b, 9}, {0x19b, 9},
+    {0x05b, 9}, {0x15b, 9}, {0x0db, 9}, {0x1db, 9}, {0x03b, 9}, {0x13b, 9},
+    {0x0bb, 9}, {0x1bb, 9}, {0x07b, 9}, {0x17b, 9}, {0x0fb, 9}, {0x1fb, 9},
+    {0x007, 9}, {0x107, 9}, {0x087, 9}, {0x187, 9}, {0x047, 9}, {0x147, 9},
+    {0x0c7, 9}, {0x1c7, 9}, {0x027, 9}, {0x127, 9}, {0x0a7, 9}, {0x1a7, 9},
+    {0x067, 9}, {0x167, 9}, {0x0e7, 9}, {0x1e7, 9}, {0x017, 9}, {0x117, 9},
+    {0x097, 9}, {0x197, 9}, {0x057, 9}, {0x157, 9}, {0x0d7, 9}, {0x1d7, 9},
+    {0x037, 9}, {0x137, 9}, {0x0b7, 9}, {0x1b7, 9}, {0x077, 9}, {0x177, 9},
+    {0x0f7, 9}, {0x1f7, 9}, {0x00f, 9}, {0x10f, 9}, {0x08f, 9}, {0x18f, 9},
+    {0x04f, 9}, {0x14f, 9}, {0x0cf, 9}, {0x1cf, 9}, {0x02f, 9}, {0x12f, 9},
+    {0x0af, 9}, {0x1af, 9}, {0x06f, 9}, {0x16f, 9}, {0x0ef, 9}, {0x1ef, 9},
+    {0x01f, 9}, {0x11f, 9}, {0x09f, 9}, {0x19f, 9}, {0x05f, 9}, {0x15f, 9},
+    {0x0df, 9}, {0x1df, 9}, {0x03f, 9}, {0x13f, 9}, {0x0bf, 9}, {0x1bf, 9},
+    {0x07f, 9}, {0x17f, 9}, {0x0ff, 9}, {0x1ff, 9}, {0x000, 7}, {0x040, 7},
+    {0x020, 7}, {0x060, 7}, {0x010, 7}, {0x050, 7}, {0x030, 7}, {0x070, 7},
+    {0x008, 7}, {0x048, 7}, {0x028, 7}, {0x068, 7}, {0x018, 7}, {0x058, 7},
+    {0x038, 7}, {0x078, 7}, {0x004, 7}, {0x044, 7}, {0x024, 7}, {0x064, 7},
+    {0x014, 7}, {0x054, 7}, {0x034, 7}, {0x074, 7}, {0x003, 8}, {0x083, 8},
+    {0x043, 8}, {0x0c3, 8}, {0x023, 8}, {0x0a3, 8}, {0x063, 8}, {0x0e3, 8}
+};
+
+/* Every allocation is prefixed with its size so that it can be
+ * credited back on free. A double keeps the payload aligned. */
+typedef union {
+    sxs_uint32_t size;
+    double align;
+} alloc_hdr_t;
+
+static voidpf _gnut_deflate_zalloc(voidpf opaque, uInt items, uInt size) {
+    gnut_deflate_t *link;
+    alloc_hdr_t *hdr;
+    sxs_uint32_t len;
+
+    link = (gnut_deflate_t *)opaque;
+    len = (sxs_uint32_t)(items * size) + sizeof(alloc_hdr_t);
+
+    if (link->budget != NULL && link->budget->limit != 0 &&
+        link->budget->used + len > link->budget->limit) {
+        return Z_NULL;
+    }
+
+    hdr = (alloc_hdr_t *)malloc(len);
+    if (hdr == NULL) {
+        return Z_NULL;
+    }
+    hdr->size = len;
+
+    link->mem += len;
+    if (link->budget != NULL) {
+        link->budget->used += len;
+        if (link->budget->used > link->budget->peak) {
+            link->budget->peak = link->budget->used;
+        }
+    }
+
+    return (voidpf)(hdr + 1);
+}
+
+static void _gnut_deflate_zfree(voidpf opaque, voidpf address) {
+    gnut_deflate_t *link;
+    alloc_hdr_t *hdr;
+
+    link = (gnut_deflate_t *)opaque;
+    hdr = ((alloc_hdr_t *)address) - 1;
+
+    link->mem -= hdr->size;
+    if (link->budget != NULL) {
+        link->budget->used -= hdr->size;
+    }
+
+    free(hdr);
+}
+
+void gnut_deflate_cfg_init(gnut_deflate_cfg_t *cfg) {
+    cfg->window_bits = GNUT_DEFLATE_DEF_WBITS;
+    cfg->hash_bits = GNUT_DEFLATE_DEF_HASH_BITS;
+    cfg->max_chain = GNUT_DEFLATE_DEF_MAX_CHAIN;
+    cfg->inf_window_bits = GNUT_DEFLATE_DEF_INF_WBITS;
+    cfg->flush_thresh = GNUT_DEFLATE_DEF_FLUSH_THRESH;
+}
+
+gnut_error_t gnut_deflate_new(gnut_deflate_t **pp_link,
+    const gnut_deflate_cfg_t *cfg, gnut_deflate_budget_t *budget) {
+
+    gnut_deflate_cfg_t def_cfg;
+    gnut_deflate_t *link;
+    int ret;
+
+    if (cfg == NULL) {
+        gnut_deflate_cfg_init(&def_cfg);
+        cfg = &def_cfg;
+    }
+    if (cfg->window_bits < 9 || cfg->window_bits > 14 ||
+        cfg->hash_bits < 8 || cfg->hash_bits > 16 || cfg->max_chain < 1) {
+        return GNUT_EDEFLATE;
+    }
+
+    if (budget != NULL && budget->limit != 0 &&
+        budget->used + sizeof(gnut_deflate_t) > budget->limit) {
+        return GNUT_ENOMEM;
+    }
+    link = (gnut_deflate_t *)calloc(1, sizeof(gnut_deflate_t));
+    if (link == NULL) {
+        return GNUT_ENOMEM;
+    }
+    link->budget = budget;
+    link->mem = sizeof(gnut_deflate_t);
+    if (budget != NULL) {
+        budget->used += link->mem;
+        if (budget->used > budget->peak) {
+            budget->peak = budget->used;
+        }
+    }
+    link->flush_thresh = cfg->flush_thresh;
+    link->window_bits = cfg->window_bits;
+    link->wsize = (sxs_uint32_t)1 << cfg->window_bits;
+    link->hash_shift = 32 - cfg->hash_bits;
+    link->max_chain = cfg->max_chain;
+
+    link->win = (unsigned char *)_gnut_deflate_zalloc((voidpf)link,
+        2 * link->wsize, 1);
+    link->head = (sxs_uint16_t *)_gnut_deflate_zalloc((voidpf)link,
+        (uInt)1 << cfg->hash_bits, sizeof(sxs_uint16_t));
+    link->prev = (sxs_uint16_t *)_gnut_deflate_zalloc((voidpf)link,
+        2 * link->wsize, sizeof(sxs_uint16_t));
+    if (link->win == NULL || link->head == NULL || link->prev == NULL) {
+        gnut_deflate_free(link);
+        return GNUT_ENOMEM;
+    }
+    memset(link->head, 0, sizeof(sxs_uint16_t) << cfg->hash_bits);
+
+    link->inf.zalloc = _gnut_deflate_zalloc;
+    link->inf.zfree = _gnut_deflate_zfree;
+    link->inf.opaque = (voidpf)link;
+    ret = inflateInit2(&link->inf, cfg->inf_window_bits);
+    if (ret != Z_OK) {
+        gnut_deflate_free(link);
+        return (ret == Z_MEM_ERROR) ? GNUT_ENOMEM : GNUT_EDEFLATE;
+    }
+    link->inf_ready = 1;
+
+    *pp_link = link;
+
+    return GNUT_SUCCESS;
+}
+
+void gnut_deflate_free(gnut_deflate_t *link) {
+    if (link->inf_ready) {
+        inflateEnd(&link->inf);
+    }
+    if (link->win != NULL) {
+        _gnut_deflate_zfree((voidpf)link, link->win);
+    }
+    if (link->head != NULL) {
+        _gnut_deflate_zfree((voidpf)link, link->head);
+    }
+    if (link->prev != NULL) {
+        _gnut_deflate_zfree((voidpf)link, link->prev);
+    }
+    if (link->budget != NULL) {
+        link->budget->used -= sizeof(gnut_deflate_t);
+    }
+    free(link);
+}
+
+static void _gnut_deflate_put(gnut_deflate_t *link, sxs_uint32_t val,
+    int n) {
+
+    unsigned char *p;
+
+    link->bits |= (gnut_uint64_t)val << link->nbits;
+    link->nbits += n;
+    if (link->nbits >= 32) {
+        p = link->obuf + link->olen;
+        p[0] = (unsigned char)link->bits;
+        p[1] = (unsigned char)(link->bits >> 8);
+        p[2] = (unsigned char)(link->bits >> 16);
+        p[3] = (unsigned char)(link->bits >> 24);
+        link->olen += 4;
+        link->bits >>= 32;
+        link->nbits -= 32;
+    }
+}
+
+/* The index of the highest set bit of 'x', which is at least 4. */
+static int _gnut_deflate_log2(sxs_uint32_t x) {
+    int n;
+
+    n = 2;
+    while ((x >> (n + 1)) != 0) {
+        n++;
+    }
+
+    return n;
+}
+
+static void _gnut_deflate_put_match(gnut_deflate_t *link, sxs_uint32_t len,
+    sxs_uint32_t dist) {
+
+    sxs_uint32_t x, sym;
+    int n;
+
+    x = len - MIN_MATCH;
+    if (len == MAX_MATCH) {
+        _gnut_deflate_put(link, fixed_codes[285].code, fixed_codes[285].len);
+    } else if (x < 8) {
+        sym = 257 + x;
+        _gnut_deflate_put(link, fixed_codes[sym].code, fixed_codes[sym].len);
+    } else {
+        n = _gnut_deflate_log2(x);
+        sym = 257 + 4 * (n - 1) + ((x >> (n - 2)) & 3);
+        _gnut_deflate_put(link, fixed_codes[sym].code, fixed_codes[sym].len);
+        _gnut_deflate_put(link, x & ((1U << (n - 2)) - 1), n - 2);
+    }
+
+    /* Distance codes are a plain 5 bits, written MSB first. */
+    x = dist - 1;
+    if (x < 4) {
+        sym = x;
+        n = 1;
+    } else {
+        n = _gnut_deflate_log2(x);
+        sym = 2 * n + ((x >> (n - 1)) & 1);
+    }
+    sym = ((sym & 1) << 4) | ((sym & 2) << 2) | (sym & 4) |
+        ((sym & 8) >> 2) | ((sym & 16) >> 4);
+    _gnut_deflate_put(link, sym, 5);
+    if (x >= 4) {
+        _gnut_deflate_put(link, x & ((1U << (n - 1)) - 1), n - 1);
+    }
+}
+
+/* Encode win[start, end) as literals and matches against the history
+ * in front of it, trying up to max_chain earlier positions with the
+ * same hash. Positions inside a match are hashed as well so that
+ * repeats of the same text are found again. */
+static void _gnut_deflate_encode(gnut_deflate_t *link, sxs_uint32_t start,
+    sxs_uint32_t end) {
+
+    const unsigned char *win;
+    sxs_uint32_t p, q, cand, len, best, dist, max, h;
+    int chain;
+
+    win = link->win;
+    p = start;
+    while (p < end) {
+        best = 0;
+        dist = 0;
+        if (end - p >= MIN_MATCH) {
+            h = HASH(win + p, link->hash_shift);
+            cand = link->head[h];
+            link->head[h] = (sxs_uint16_t)(p + 1);
+            link->prev[p] = (sxs_uint16_t)cand;
+            max = end - p;
+            if (max > MAX_MATCH) {
+                max = MAX_MATCH;
+            }
+            chain = link->max_chain;
+            while (cand != 0 && p - (cand - 1) <= link->wsize &&
+                chain-- > 0) {
+                cand--;
+                if (win[cand + best] == win[p + best]) {
+                    len = 0;
+                    while (len < max && win[cand + len] == win[p + len]) {
+                        len++;
+                    }
+                    if (len > best) {
+                        best = len;
+                        dist = p - cand;
+                        if (len == max) {
+                            break;
+                        }
+                    }
+                }
+                cand = link->prev[cand];
+            }
+        }
+
+        if (best >= MIN_MATCH) {
+            _gnut_deflate_put_match(link, best, dist);
+            for (q = p + 1; q < p + best && end - q >= MIN_MATCH; q++) {
+                h = HASH(win + q, link->hash_shift);
+                link->prev[q] = link->head[h];
+                link->head[h] = (sxs_uint16_t)(q + 1);
+            }
+            p += best;
+        } else {
+            _gnut_deflate_put(link, fixed_codes[win[p]].code,
+                fixed_codes[win[p]].len);
+            p++;
+        }
+    }
+}
+
+/* Append 'len' bytes, at most wsize, to the history and encode them,
+ * dropping all but the last wsize bytes of history when it is full. */
+static void _gnut_deflate_take(gnut_deflate_t *link,
+    const unsigned char *in, sxs_uint32_t len) {
+
+    sxs_uint32_t shift, i, n;
+
+    if (link->wlen + len > 2 * link->wsize) {
+        shift = link->wlen - link->wsize;
+        memmove(link->win, link->win + shift, link->wsize);
+        link->wlen = link->wsize;
+        n = (sxs_uint32_t)1 << (32 - link->hash_shift);
+        for (i = 0; i < n; i++) {
+            link->head[i] = (sxs_uint16_t)((link->head[i] > shift) ?
+                link->head[i] - shift : 0);
+        }
+        for (i = 0; i < link->wsize; i++) {
+            link->prev[i] = (sxs_uint16_t)((link->prev[i + shift] > shift) ?
+                link->prev[i + shift] - shift : 0);
+        }
+    }
+
+    if (!link->hdr_done) {
+        /* CINFO announces our window, FCHECK makes the pair a multiple
+         * of 31, FLEVEL says fastest. */
+        link->obuf[link->olen] = (unsigned char)
+            (((link->window_bits - 8) << 4) | Z_DEFLATED);
+        link->obuf[link->olen + 1] = (unsigned char)
+            (31 - ((link->obuf[link->olen] << 8) % 31));
+        link->olen += 2;
+        link->hdr_done = 1;
+    }
+    if (!link->block_open) {
+        _gnut_deflate_put(link, 1 << 1, 3);
+        link->block_open = 1;
+    }
+
+    memcpy(link->win + link->wlen, in, len);
+    _gnut_deflate_encode(link, link->wlen, link->wlen + len);
+    link->wlen += len;
+}
+
+/* End the open block and add an empty stored block, which leaves the
+ * stream byte aligned and lets the peer inflate everything so far. */
+static void _gnut_deflate_sync(gnut_deflate_t *link) {
+    unsigned char *p;
+
+    if (link->block_open) {
+        _gnut_deflate_put(link, 0, 7);
+        link->block_open = 0;
+    }
+    _gnut_deflate_put(link, 0, 3);
+    if ((link->nbits & 7) != 0) {
+        _gnut_deflate_put(link, 0, 8 - (link->nbits & 7));
+    }
+    while (link->nbits > 0) {
+        link->obuf[link->olen++] = (unsigned char)link->bits;
+        link->bits >>= 8;
+        link->nbits -= 8;
+    }
+
+    p = link->obuf + link->olen;
+    p[0] = 0x00;
+    p[1] = 0x00;
+    p[2] = 0xff;
+    p[3] = 0xff;
+    link->olen += 4;
+}
+
+static void _gnut_deflate_drain(gnut_deflate_t *link, unsigned char *out,
+    sxs_uint32_t out_cap, sxs_uint32_t *p_out_len) {
+
+    sxs_uint32_t n;
+
+    n = link->olen - link->ooff;
+    if (n > out_cap) {
+        n = out_cap;
+    }
+    memcpy(out, link->obuf + link->ooff, n);
+    link->ooff += n;
+    if (link->ooff == link->olen) {
+        link->ooff = link->olen = 0;
+    }
+    link->stats.out_comp += n;
+    *p_out_len = n;
+}
+
+gnut_error_t gnut_deflate_compress(gnut_deflate_t *link,
+    const unsigned char *in, sxs_uint32_t in_len, unsigned char *out,
+    sxs_uint32_t out_cap, sxs_uint32_t *p_in_used, sxs_uint32_t *p_out_len) {
+
+    gnut_error_t reterr;
+    sxs_uint32_t produced, take;
+
+    *p_in_used = 0;
+    *p_out_len = 0;
+
+    /* Finish an interrupted flush before taking more input so that the
+     * flush point stays where it was decided. */
+    if (link->flushing) {
+        reterr = gnut_deflate_flush(link, out, out_cap, &produced);
+        *p_out_len = produced;
+        if (reterr == GNUT_EBUF_TOO_SMALL) {
+            return GNUT_SUCCESS;
+        } else if (reterr != GNUT_SUCCESS) {
+            return reterr;
+        }
+        out += produced;
+        out_cap -= produced;
+    }
+
+    _gnut_deflate_drain(link, out, out_cap, &produced);
+    *p_out_len += produced;
+    out += produced;
+    out_cap -= produced;
+    if (link->ooff != 0) {
+        memmove(link->obuf, link->obuf + link->ooff,
+            link->olen - link->ooff);
+        link->olen -= link->ooff;
+        link->ooff = 0;
+    }
+
+    take = 0;
+    if (link->olen + OBUF_SLACK < OBUF_LEN) {
+        take = (OBUF_LEN - OBUF_SLACK - link->olen) * 8 / 9;
+    }
+    if (take > link->wsize) {
+        take = link->wsize;
+    }
+    if (take > in_len) {
+        take = in_len;
+    }
+    if (take == 0) {
+        return GNUT_SUCCESS;
+    }
+
+    _gnut_deflate_take(link, in, take);
+    link->pending += take;
+    link->stats.out_raw += take;
+    *p_in_used = take;
+
+    /* Bound how long bytes can sit in the compressor when the output
+     * queue never goes idle. */
+    if (link->pending >= link->flush_thresh) {
+        reterr = gnut_deflate_flush(link, out, out_cap, &produced);
+        *p_out_len += produced;
+        if (reterr == GNUT_EDEFLATE) {
+            return reterr;
+        }
+    } else {
+        _gnut_deflate_drain(link, out, out_cap, &produced);
+        *p_out_len += produced;
+    }
+
+    return GNUT_SUCCESS;
+}
+
+gnut_error_t gnut_deflate_flush(gnut_deflate_t *link, unsigned char *out,
+    sxs_uint32_t out_cap, sxs_uint32_t *p_out_len) {
+
+    *p_out_len = 0;
+    if (!link->flushing) {
+        if (link->pending == 0) {
+            return GNUT_SUCCESS;
+        }
+        _gnut_deflate_sync(link);
+        link->flushing = 1;
+    }
+
+    _gnut_deflate_drain(link, out, out_cap, p_out_len);
+    if (link->olen != 0) {
+        return GNUT_EBUF_TOO_SMALL;
+    }
+
+    link->flushing = 0;
+    link->pending = 0;
+    link->stats.flushes++;
+
+    return GNUT_SUCCESS;
+}
+
+int gnut_deflate_needs_flush(const gnut_deflate_t *link) {
+    return (link->pending > 0 || link->flushing);
+}
+
+gnut_error_t gnut_deflate_decompress(gnut_deflate_t *link,
+    const unsigned char *in, sxs_uint32_t in_len, unsigned char *out,
+    sxs_uint32_t out_cap, sxs_uint32_t *p_in_used, sxs_uint32_t *p_out_len) {
+
+    int ret;
+
+    link->inf.next_in = (Bytef *)in;
+    link->inf.avail_in = in_len;
+    link->inf.next_out = out;
+    link->inf.avail_out = out_cap;
+
+    ret = inflate(&link->inf, Z_SYNC_FLUSH);
+
+    *p_in_used = in_len - link->inf.avail_in;
+    *p_out_len = out_cap - link->inf.avail_out;
+    link->stats.in_comp += *p_in_used;
+    link->stats.in_raw += *p_out_len;
+
+    /* A link never ends, so Z_STREAM_END is as fatal as corrupt data. */
+    if (ret != Z_OK && ret != Z_BUF_ERROR) {
+        return GNUT_EDEFLATE;
+    }
+
+    return GNUT_SUCCESS;
+}
+
+void gnut_deflate_get_stats(const gnut_deflate_t *link,
+    gnut_deflate_stats_t *p_stats) {
+
+    *p_stats = link->stats;
+    p_stats->mem = link->mem;
+}
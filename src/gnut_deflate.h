@@ -0,0 +1,217 @@
+/*
+ * Copyright 2006-2007 Andrew De Ponte
+ *
+ * This file is part of lib_gnut.
+ *
+ * lib_gnut is the intellectual property of Andrew De Ponte; any
+ * distribution and/or modification and/or reproductions of any portion
+ * of lib_gnut MUST be approved by Andrew De Ponte.
+ *
+ * lib_gnut is distributed WITHOUT ANY WARRANTY; without even the
+ * implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE.
+ */
+
+/**
+ * @file gnut_deflate.h
+ * @brief This is a specifications file for deflate link compression.
+ *
+ * The gnut_deflate.h file is a specifications file that declares the
+ * gnut_deflate_t type and the functions used to compress and
+ * decompress the byte stream of a connection that negotiated
+ * "Content-Encoding: deflate" during the handshake.
+ */
+
+#ifndef GNUT_DEFLATE_H
+#define GNUT_DEFLATE_H
+
+#include <sxs/sxs.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+#include "gnut_export.h"
+#include "gnut_types.h"
+#include "gnut_error.h"
+
+#define GNUT_DEFLATE_DEF_WBITS 12 /**< Default window, 4 KiB */
+#define GNUT_DEFLATE_DEF_HASH_BITS 12 /**< Default match finder size */
+#define GNUT_DEFLATE_DEF_MAX_CHAIN 16 /**< Default match candidates */
+#define GNUT_DEFLATE_DEF_INF_WBITS 15 /**< Peers may use a 32 KiB window */
+#define GNUT_DEFLATE_DEF_FLUSH_THRESH 8192 /**< Default forced flush */
+
+/**
+ * A Deflate Link Configuration
+ *
+ * The gnut_deflate_cfg_t is a type which holds the tunables of a
+ * deflate link. The window and hash table of the compressor are ours
+ * to choose and are what bound the memory of a link; the window of the
+ * decompressor has to be large enough for whatever window the peer
+ * compresses with.
+ */
+typedef struct GNUT_EXPORT gnut_deflate_cfg {
+    int window_bits;            /* Compressor window bits, 9-14 */
+    int hash_bits;              /* Compressor hash table bits, 8-16 */
+    int max_chain;              /* Match candidates per byte, >= 1 */
+    int inf_window_bits;        /* Decompressor window bits, 9-15 */
+    sxs_uint32_t flush_thresh;  /* Bytes pending before a forced flush */
+} gnut_deflate_cfg_t;
+
+/**
+ * A Deflate Memory Budget
+ *
+ * The gnut_deflate_budget_t is a type which accounts for the memory
+ * held by a group of deflate links, e.g. all the links owned by one
+ * thread. A limit of 0 means the group is not limited.
+ */
+typedef struct GNUT_EXPORT gnut_deflate_budget {
+    sxs_uint32_t limit;         /* Max bytes, or 0 for no limit */
+    sxs_uint32_t used;          /* Bytes currently held */
+    sxs_uint32_t peak;          /* Largest value 'used' has had */
+} gnut_deflate_budget_t;
+
+/**
+ * Deflate Link Statistics
+ *
+ * The gnut_deflate_stats_t is a type which holds the byte counts of a
+ * deflate link in both directions.
+ */
+typedef struct GNUT_EXPORT gnut_deflate_stats {
+    gnut_uint64_t out_raw;      /* Bytes given to the compressor */
+    gnut_uint64_t out_comp;     /* Bytes produced by the compressor */
+    gnut_uint64_t in_comp;      /* Bytes given to the decompressor */
+    gnut_uint64_t in_raw;       /* Bytes produced by the decompressor */
+    sxs_uint32_t flushes;       /* Number of sync flushes done */
+    sxs_uint32_t mem;           /* Bytes currently held by the link */
+} gnut_deflate_stats_t;
+
+/**
+ * A Deflate Link
+ *
+ * The gnut_deflate_t is an opaque type which represents the compressor
+ * and decompressor of one connection.
+ */
+typedef struct gnut_deflate gnut_deflate_t;
+
+/**
+ * Initialize a Deflate Link Configuration
+ *
+ * The gnut_deflate_cfg_init() function fills in the configuration
+ * pointed to by 'cfg' with the GNUT_DEFLATE_DEF_* values.
+ * @param cfg Pointer to the configuration to initialize.
+ */
+GNUT_EXPORT void gnut_deflate_cfg_init(gnut_deflate_cfg_t *cfg);
+
+/**
+ * Create a Deflate Link
+ *
+ * The gnut_deflate_new() function creates a deflate link using the
+ * configuration 'cfg' and charges all memory it allocates, including
+ * that of zlib, against 'budget'.
+ * @param pp_link Pointer to store the pointer to the new link in.
+ * @param cfg Pointer to the configuration to use, or NULL for defaults.
+ * @param budget Pointer to the budget to charge, or NULL.
+ * @return A value representing an error or success.
+ * @retval GNUT_SUCCESS Successfully created the link.
+ * @retval GNUT_ENOMEM Failed to allocate memory or exceeded budget.
+ * @retval GNUT_EDEFLATE 'cfg' is out of range or zlib failed to start.
+ */
+GNUT_EXPORT gnut_error_t gnut_deflate_new(gnut_deflate_t **pp_link,
+    const gnut_deflate_cfg_t *cfg, gnut_deflate_budget_t *budget);
+
+/**
+ * Free a Deflate Link
+ *
+ * The gnut_deflate_free() function releases all memory held by the
+ * link and credits it back to the budget it was created with.
+ * @param link Pointer to the link to free.
+ */
+GNUT_EXPORT void gnut_deflate_free(gnut_deflate_t *link);
+
+/**
+ * Compress Outgoing Bytes
+ *
+ * The gnut_deflate_compress() function compresses up to 'in_len' bytes
+ * of outgoing message data into 'out'. It does not flush on its own,
+ * so the output may lag behind the input, unless more than
+ * 'flush_thresh' bytes are pending in which case a sync flush is done
+ * to bound latency. Call gnut_deflate_flush() once the output queue
+ * of the connection has gone idle.
+ * @param link Pointer to the link.
+ * @param in Pointer to the bytes to compress.
+ * @param in_len The number of bytes in 'in'.
+ * @param out Pointer to the buffer to store compressed bytes in.
+ * @param out_cap The capacity of 'out' in bytes.
+ * @param p_in_used Pointer to store the number of bytes consumed in.
+ * @param p_out_len Pointer to store the number of bytes produced in.
+ * @return A value representing an error or success.
+ * @retval GNUT_SUCCESS Successfully compressed the bytes.
+ */
+GNUT_EXPORT gnut_error_t gnut_deflate_compress(gnut_deflate_t *link,
+    const unsigned char *in, sxs_uint32_t in_len, unsigned char *out,
+    sxs_uint32_t out_cap, sxs_uint32_t *p_in_used, sxs_uint32_t *p_out_len);
+
+/**
+ * Flush the Compressor
+ *
+ * The gnut_deflate_flush() function performs a sync flush so that the
+ * peer can decompress everything given to gnut_deflate_compress() so
+ * far. If 'out' fills up the flush is resumed by the next call.
+ * @param link Pointer to the link.
+ * @param out Pointer to the buffer to store compressed bytes in.
+ * @param out_cap The capacity of 'out' in bytes.
+ * @param p_out_len Pointer to store the number of bytes produced in.
+ * @return A value representing an error or success.
+ * @retval GNUT_SUCCESS The flush is complete.
+ * @retval GNUT_EBUF_TOO_SMALL 'out' filled up, call again.
+ */
+GNUT_EXPORT gnut_error_t gnut_deflate_flush(gnut_deflate_t *link,
+    unsigned char *out, sxs_uint32_t out_cap, sxs_uint32_t *p_out_len);
+
+/**
+ * Check if the Compressor Needs a Flush
+ *
+ * The gnut_deflate_needs_flush() function reports whether bytes have
+ * been given to the compressor since the last completed flush.
+ * @param link Pointer to the link.
+ * @return Non-zero if a flush is needed, zero otherwise.
+ */
+GNUT_EXPORT int gnut_deflate_needs_flush(const gnut_deflate_t *link);
+
+/**
+ * Decompress Incoming Bytes
+ *
+ * The gnut_deflate_decompress() function decompresses up to 'in_len'
+ * bytes received from the socket into 'out' for the framer.
+ * @param link Pointer to the link.
+ * @param in Pointer to the bytes to decompress.
+ * @param in_len The number of bytes in 'in'.
+ * @param out Pointer to the buffer to store decompressed bytes in.
+ * @param out_cap The capacity of 'out' in bytes.
+ * @param p_in_used Pointer to store the number of bytes consumed in.
+ * @param p_out_len Pointer to store the number of bytes produced in.
+ * @return A value representing an error or success.
+ * @retval GNUT_SUCCESS Successfully decompressed the bytes.
+ * @retval GNUT_EDEFLATE The peer sent a corrupt or finished stream.
+ */
+GNUT_EXPORT gnut_error_t gnut_deflate_decompress(gnut_deflate_t *link,
+    const unsigned char *in, sxs_uint32_t in_len, unsigned char *out,
+    sxs_uint32_t out_cap, sxs_uint32_t *p_in_used, sxs_uint32_t *p_out_len);
+
+/**
+ * Get Deflate Link Statistics
+ *
+ * The gnut_deflate_get_stats() function copies the byte counts and
+ * current memory use of the link into 'p_stats'.
+ * @param link Pointer to the link.
+ * @param p_stats Pointer to store the statistics in.
+ */
+GNUT_EXPORT void gnut_deflate_get_stats(const gnut_deflate_t *link,
+    gnut_deflate_stats_t *p_stats);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* GNUT_DEFLATE_H */
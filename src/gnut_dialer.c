@@ -0,0 +1,598 @@
+/*
+ * Copyright 2006-2007 Andrew De Ponte
+ *
+ * This file is part of lib_gnut.
+ *
+ * lib_gnut is the intellectual property of Andrew De Ponte; any
+ * distribution and/or modification and/or reproductions of any portion
+ * of lib_gnut MUST be approved by Andrew De Ponte.
+ *
+ * lib_gnut is distributed WITHOUT ANY WARRANTY; without even the
+ * implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE.
+ */
+
+/**
+ * @file gnut_dialer.c
+ * @brief This is an implementation file for the connection dialer.
+ *
+ * The gnut_dialer.c file is an implementation file that defines the
+ * gnut_dialer_t type and its associated functions.
+ */
+
+#include <stdlib.h> /* calloc(), free() */
+#include <string.h> /* memset() */
+
+#include "gnut_dialer.h"
+
+/* Ranking weights: one past success is worth ten minutes of freshness,
+ * one recent failure costs five. */
+#define SCORE_SUCCESS 600.0
+#define SCORE_FAILURE 300.0
+#define MAX_BACKOFF_SHIFT 16
+
+typedef struct attempt {
+    gnut_dialer_t *d;
+    sxs_socket_t sd;
+    sxs_uint32_t host;          /* Index into hosts */
+    gnut_timer_t timer;
+    int active;
+} attempt_t;
+
+struct gnut_dialer {
+    gnut_dialer_cfg_t cfg;
+    gnut_evloop_t *loop;
+    gnut_dial_host_t *hosts;
+    sxs_uint32_t num_hosts;
+    sxs_uint32_t *index;        /* Open addressing, host index + 1 */
+    sxs_uint32_t index_mask;
+    attempt_t *attempts;
+    int in_flight;
+    int handshaking;            /* Handed over, handshake not reported */
+    int needed;
+    int filling;                /* Guards _gnut_dialer_fill() reentry */
+    gnut_timer_t retry_timer;   /* Fill again once a backoff expires */
+};
+
+static void _gnut_dialer_fill(gnut_dialer_t *d);
+
+void gnut_dialer_cfg_init(gnut_dialer_cfg_t *cfg) {
+    memset(cfg, 0, sizeof(gnut_dialer_cfg_t));
+    cfg->max_in_flight = GNUT_DIALER_DEF_IN_FLIGHT;
+    cfg->timeout = GNUT_DIALER_DEF_TIMEOUT;
+    cfg->retry = GNUT_DIALER_DEF_RETRY;
+    cfg->retry_max = GNUT_DIALER_DEF_RETRY_MAX;
+    cfg->max_hosts = GNUT_DIALER_DEF_MAX_HOSTS;
+}
+
+gnut_error_t gnut_dialer_new(gnut_dialer_t **pp_d, gnut_evloop_t *loop,
+    const gnut_dialer_cfg_t *cfg) {
+
+    gnut_dialer_t *d;
+    sxs_uint32_t size;
+    int i;
+
+    d = (gnut_dialer_t *)calloc(1, sizeof(gnut_dialer_t));
+    if (d == NULL) {
+        return GNUT_ENOMEM;
+    }
+    d->cfg = *cfg;
+    d->loop = loop;
+    gnut_timer_init(&d->retry_timer);
+
+    /* A zero backoff would let a host that fails at once be picked
+     * again in the same pass, forever. */
+    if (d->cfg.retry < GNUT_DIALER_MIN_RETRY) {
+        d->cfg.retry = GNUT_DIALER_MIN_RETRY;
+    }
+    if (d->cfg.retry_max < d->cfg.retry) {
+        d->cfg.retry_max = d->cfg.retry;
+    }
+
+    /* Keep the index at most half full so probes stay short. */
+    size = 2;
+    while (size < d->cfg.max_hosts * 2) {
+        size <<= 1;
+    }
+    d->index_mask = size - 1;
+
+    d->hosts = (gnut_dial_host_t *)calloc(d->cfg.max_hosts,
+        sizeof(gnut_dial_host_t));
+    d->index = (sxs_uint32_t *)calloc(size, sizeof(sxs_uint32_t));
+    d->attempts = (attempt_t *)calloc(d->cfg.max_in_flight,
+        sizeof(attempt_t));
+    if (d->hosts == NULL || d->index == NULL || d->attempts == NULL) {
+        gnut_dialer_free(d);
+        return GNUT_ENOMEM;
+    }
+    for (i = 0; i < d->cfg.max_in_flight; i++) {
+        d->attempts[i].d = d;
+        gnut_timer_init(&d->attempts[i].timer);
+    }
+
+    *pp_d = d;
+
+    return GNUT_SUCCESS;
+}
+
+static void _gnut_dialer_abort(gnut_dialer_t *d, attempt_t *a) {
+    gnut_evloop_del(d->loop, a->sd);
+    gnut_evloop_timer_stop(d->loop, &a->timer);
+    sxs_close(a->sd);
+    d->hosts[a->host].dialing = 0;
+    a->active = 0;
+    d->in_flight--;
+}
+
+static void _gnut_dialer_abort_all(gnut_dialer_t *d) {
+    int i;
+
+    for (i = 0; i < d->cfg.max_in_flight; i++) {
+        if (d->attempts[i].active) {
+            _gnut_dialer_abort(d, &d->attempts[i]);
+        }
+    }
+}
+
+/* Connections still to be made beyond those handshaking. */
+static int _gnut_dialer_wanted(const gnut_dialer_t *d) {
+    return d->needed - d->handshaking;
+}
+
+void gnut_dialer_free(gnut_dialer_t *d) {
+    if (d->attempts != NULL) {
+        _gnut_dialer_abort_all(d);
+    }
+    gnut_evloop_timer_stop(d->loop, &d->retry_timer);
+    free(d->attempts);
+    free(d->index);
+    free(d->hosts);
+    free(d);
+}
+
+static sxs_uint32_t _gnut_dialer_hash(sxs_uint32_t ip, sxs_uint16_t port) {
+    sxs_uint32_t h;
+
+    h = ip ^ ((sxs_uint32_t)port * 0x9e3779b1U);
+    h ^= h >> 16;
+    h *= 0x85ebca6bU;
+    h ^= h >> 13;
+    return h;
+}
+
+/* Return the index slot holding the host, or the empty slot where it
+ * would go. */
+static sxs_uint32_t _gnut_dialer_slot(const gnut_dialer_t *d,
+    sxs_uint32_t ip, sxs_uint16_t port) {
+
+    const gnut_dial_host_t *h;
+    sxs_uint32_t i;
+
+    i = _gnut_dialer_hash(ip, port) & d->index_mask;
+    while (d->index[i] != 0) {
+        h = &d->hosts[d->index[i] - 1];
+        if (h->ip == ip && h->port == port) {
+            break;
+        }
+        i = (i + 1) & d->index_mask;
+    }
+    return i;
+}
+
+/* Remove the entry at slot 'i', shifting back later entries of the
+ * same probe run so that lookups never stop early at the hole. */
+static void _gnut_dialer_unindex(gnut_dialer_t *d, sxs_uint32_t i) {
+    const gnut_dial_host_t *h;
+    sxs_uint32_t j, k;
+
+    d->index[i] = 0;
+    j = i;
+    for (;;) {
+        j = (j + 1) & d->index_mask;
+        if (d->index[j] == 0) {
+            break;
+        }
+        h = &d->hosts[d->index[j] - 1];
+        k = _gnut_dialer_hash(h->ip, h->port) & d->index_mask;
+        /* Leave the entry if its home slot lies cyclically in (i, j]. */
+        if ((i <= j) ? (i < k && k <= j) : (i < k || k <= j)) {
+            continue;
+        }
+        d->index[i] = d->index[j];
+        d->index[j] = 0;
+        i = j;
+    }
+}
+
+static double _gnut_dialer_score(const gnut_dial_host_t *h,
+    gnut_uint64_t now) {
+
+    double age;
+
+    age = (now > h->last_seen) ? (double)(now - h->last_seen) / 1e6 : 0.0;
+    return (h->successes * SCORE_SUCCESS) - (h->failures * SCORE_FAILURE) -
+        age;
+}
+
+gnut_error_t gnut_dialer_add_host(gnut_dialer_t *d, sxs_uint32_t ip,
+    sxs_uint16_t port, gnut_uint64_t last_seen, sxs_uint32_t successes,
+    sxs_uint16_t failures) {
+
+    gnut_dial_host_t *h;
+    sxs_uint32_t slot, victim, i;
+    gnut_uint64_t now;
+    double score, worst;
+
+    slot = _gnut_dialer_slot(d, ip, port);
+    if (d->index[slot] != 0) {
+        h = &d->hosts[d->index[slot] - 1];
+        if (last_seen > h->last_seen) {
+            h->last_seen = last_seen;
+        }
+        return GNUT_SUCCESS;
+    }
+
+    if (d->num_hosts < d->cfg.max_hosts) {
+        victim = d->num_hosts++;
+    } else {
+        /* Reuse the slot of the worst host not being dialed. */
+        now = gnut_evloop_now(d->loop);
+        victim = d->num_hosts;
+        worst = 0.0;
+        for (i = 0; i < d->num_hosts; i++) {
+            if (d->hosts[i].dialing) {
+                continue;
+            }
+            score = _gnut_dialer_score(&d->hosts[i], now);
+            if (victim == d->num_hosts || score < worst) {
+                victim = i;
+                worst = score;
+            }
+        }
+        if (victim == d->num_hosts) {
+            return GNUT_EQUEUE_FULL;
+        }
+        _gnut_dialer_unindex(d, _gnut_dialer_slot(d, d->hosts[victim].ip,
+            d->hosts[victim].port));
+        slot = _gnut_dialer_slot(d, ip, port);
+    }
+
+    h = &d->hosts[victim];
+    memset(h, 0, sizeof(gnut_dial_host_t));
+    h->ip = ip;
+    h->port = port;
+    h->last_seen = last_seen;
+    h->successes = successes;
+    h->failures = failures;
+    d->index[slot] = victim + 1;
+
+    _gnut_dialer_fill(d);
+
+    return GNUT_SUCCESS;
+}
+
+gnut_error_t gnut_dialer_add_pong(gnut_dialer_t *d,
+    const gnut_pong_payload_t *pong, gnut_uint64_t now) {
+
+    return gnut_dialer_add_host(d, pong->ip_addr.s_addr, pong->port_num,
+        now, 0, 0);
+}
+
+/* Record the outcome of a connect and its handshake on 'h'. */
+static void _gnut_dialer_record(gnut_dialer_t *d, gnut_dial_host_t *h,
+    int ok) {
+
+    gnut_uint64_t now, backoff;
+    int shift;
+
+    now = gnut_evloop_now(d->loop);
+    if (ok) {
+        h->successes++;
+        h->failures = 0;
+        h->last_seen = now;
+        h->retry_at = now + d->cfg.retry;
+    } else {
+        h->failures++;
+        shift = (h->failures - 1 < MAX_BACKOFF_SHIFT) ?
+            h->failures - 1 : MAX_BACKOFF_SHIFT;
+        backoff = d->cfg.retry << shift;
+        if (backoff > d->cfg.retry_max) {
+            backoff = d->cfg.retry_max;
+        }
+        h->retry_at = now + backoff;
+    }
+
+    if (d->cfg.on_result != NULL) {
+        d->cfg.on_result(d, h, ok, d->cfg.arg);
+    }
+}
+
+static void _gnut_dialer_finish(gnut_dialer_t *d, attempt_t *a, int ok) {
+    gnut_dial_host_t *h;
+    struct sockaddr_in addr;
+    sxs_socket_t sd;
+
+    h = &d->hosts[a->host];
+    sd = a->sd;
+    gnut_evloop_del(d->loop, sd);
+    gnut_evloop_timer_stop(d->loop, &a->timer);
+    a->active = 0;
+    d->in_flight--;
+
+    if (!ok) {
+        h->dialing = 0;
+        sxs_close(sd);
+        _gnut_dialer_record(d, h, 0);
+        _gnut_dialer_fill(d);
+        return;
+    }
+
+    /* A peer that takes the connect may still refuse the handshake, so
+     * the host stays marked as dialing, which keeps it from being
+     * dialed again or evicted, until the caller reports how the
+     * handshake went. */
+    h->handshaking = 1;
+    d->handshaking++;
+    if (_gnut_dialer_wanted(d) <= 0) {
+        _gnut_dialer_abort_all(d);
+    }
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = sxs_htons(h->port);
+    addr.sin_addr.s_addr = h->ip;
+    d->cfg.on_connected(d, sd, &addr, d->cfg.arg);
+
+    _gnut_dialer_fill(d);
+}
+
+void gnut_dialer_handshake_done(gnut_dialer_t *d, sxs_uint32_t ip,
+    sxs_uint16_t port, int ok) {
+
+    gnut_dial_host_t *h;
+    sxs_uint32_t slot;
+
+    slot = _gnut_dialer_slot(d, ip, port);
+    if (d->index[slot] == 0) {
+        return;
+    }
+    h = &d->hosts[d->index[slot] - 1];
+    if (!h->handshaking) {
+        return;
+    }
+    h->handshaking = 0;
+    h->dialing = 0;
+    d->handshaking--;
+    if (ok && d->needed > 0) {
+        d->needed--;
+    }
+    _gnut_dialer_record(d, h, ok);
+
+    if (_gnut_dialer_wanted(d) <= 0) {
+        _gnut_dialer_abort_all(d);
+    } else {
+        _gnut_dialer_fill(d);
+    }
+}
+
+/* Send the handshake template on a socket that just connected. */
+static int _gnut_dialer_send_tmpl(gnut_dialer_t *d, sxs_socket_t sd) {
+    char buf[GNUT_HS_TMPL_MAX + 2];
+    sxs_uint32_t len;
+    sxs_ssize_t sent;
+
+    if (d->cfg.tmpl == NULL) {
+        return 1;
+    }
+    if (gnut_hs_build(d->cfg.tmpl, NULL, 0, buf, sizeof(buf), &len) !=
+        GNUT_SUCCESS) {
+        return 0;
+    }
+    /* A fresh socket's send buffer always takes a handshake block. */
+    if (sxs_send(sd, (sxs_buf_t)buf, len, 0, &sent) != SXS_SUCCESS ||
+        (sxs_uint32_t)sent != len) {
+        return 0;
+    }
+    return 1;
+}
+
+static void _gnut_dialer_io_cb(gnut_evloop_t *loop, sxs_socket_t sd,
+    int events, void *arg) {
+
+    attempt_t *a;
+    sxs_socklen_t len;
+    int soerr;
+
+    a = (attempt_t *)arg;
+
+    soerr = 0;
+    len = sizeof(soerr);
+    if (sxs_getsockopt(sd, SOL_SOCKET, SO_ERROR, (sxs_buf_t)&soerr,
+        &len) != SXS_SUCCESS) {
+        soerr = -1;
+    }
+    _gnut_dialer_finish(a->d, a,
+        (soerr == 0 && _gnut_dialer_send_tmpl(a->d, sd)));
+}
+
+static void _gnut_dialer_timeout_cb(gnut_evloop_t *loop, void *arg) {
+    attempt_t *a;
+
+    a = (attempt_t *)arg;
+    _gnut_dialer_finish(a->d, a, 0);
+}
+
+/* Start a connect to 'host'. Return 0 if no socket could be created,
+ * so the caller stops trying, and 1 otherwise, even if the connect
+ * failed at once. */
+static int _gnut_dialer_dial(gnut_dialer_t *d, sxs_uint32_t host) {
+    gnut_dial_host_t *h;
+    struct sockaddr_in addr;
+    attempt_t *a;
+    sxs_error_t err;
+    int i;
+
+    a = NULL;
+    for (i = 0; i < d->cfg.max_in_flight; i++) {
+        if (!d->attempts[i].active) {
+            a = &d->attempts[i];
+            break;
+        }
+    }
+    if (a == NULL) {
+        return 0;
+    }
+
+    h = &d->hosts[host];
+    if (sxs_socket(AF_INET, SOCK_STREAM, 0, &a->sd) != SXS_SUCCESS) {
+        return 0;
+    }
+    a->host = host;
+    a->active = 1;
+    d->in_flight++;
+    h->dialing = 1;
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = sxs_htons(h->port);
+    addr.sin_addr.s_addr = h->ip;
+
+    if (sxs_set_nonblock(a->sd, 1) != SXS_SUCCESS) {
+        _gnut_dialer_finish(d, a, 0);
+        return 1;
+    }
+    err = sxs_connect(a->sd, (const struct sockaddr *)&addr, sizeof(addr));
+    if (err != SXS_SUCCESS && err != SXS_EINPROGRESS &&
+        err != SXS_EWOULDBLOCK) {
+        _gnut_dialer_finish(d, a, 0);
+        return 1;
+    }
+    if (gnut_evloop_add(d->loop, a->sd, GNUT_EV_WRITE, _gnut_dialer_io_cb,
+        a) != GNUT_SUCCESS ||
+        gnut_evloop_timer_start(d->loop, &a->timer, d->cfg.timeout,
+        _gnut_dialer_timeout_cb, a) != GNUT_SUCCESS) {
+        _gnut_dialer_finish(d, a, 0);
+    }
+
+    return 1;
+}
+
+#define FILL_BATCH 64
+
+/* Pick up to 'want' of the best ranked eligible hosts in one pass,
+ * best first, and store in 'p_next' the earliest time a host that is
+ * backing off becomes eligible, or 0 if none is. */
+static int _gnut_dialer_pick(gnut_dialer_t *d, int want, sxs_uint32_t *best,
+    gnut_uint64_t *p_next) {
+
+    double best_score[FILL_BATCH];
+    gnut_dial_host_t *h;
+    gnut_uint64_t now;
+    double score;
+    sxs_uint32_t i;
+    int num, j;
+
+    now = gnut_evloop_now(d->loop);
+    num = 0;
+    *p_next = 0;
+    for (i = 0; i < d->num_hosts; i++) {
+        h = &d->hosts[i];
+        if (h->dialing) {
+            continue;
+        }
+        if (h->retry_at > now) {
+            if (*p_next == 0 || h->retry_at < *p_next) {
+                *p_next = h->retry_at;
+            }
+            continue;
+        }
+        score = _gnut_dialer_score(h, now);
+        if (num == want && score <= best_score[num - 1]) {
+            continue;
+        }
+        /* Insert into the list, kept sorted by descending score. */
+        j = (num < want) ? num++ : num - 1;
+        while (j > 0 && best_score[j - 1] < score) {
+            best[j] = best[j - 1];
+            best_score[j] = best_score[j - 1];
+            j--;
+        }
+        best[j] = i;
+        best_score[j] = score;
+    }
+
+    return num;
+}
+
+static void _gnut_dialer_retry_cb(gnut_evloop_t *loop, void *arg) {
+    _gnut_dialer_fill((gnut_dialer_t *)arg);
+}
+
+/* Start connects until the in flight limit is reached or no eligible
+ * host is left. Hosts dialed get 'dialing' or a retry time set, so each
+ * pass picks new ones. */
+static void _gnut_dialer_fill(gnut_dialer_t *d) {
+    sxs_uint32_t best[FILL_BATCH];
+    gnut_uint64_t next, now;
+    int want, num, i;
+
+    if (d->filling) {
+        return;
+    }
+    d->filling = 1;
+
+    next = 0;
+    while (_gnut_dialer_wanted(d) > 0 &&
+        d->in_flight < d->cfg.max_in_flight) {
+        want = d->cfg.max_in_flight - d->in_flight;
+        if (want > FILL_BATCH) {
+            want = FILL_BATCH;
+        }
+        num = _gnut_dialer_pick(d, want, best, &next);
+        if (num == 0) {
+            break;
+        }
+        for (i = 0; i < num && _gnut_dialer_wanted(d) > 0; i++) {
+            if (!_gnut_dialer_dial(d, best[i])) {
+                /* Out of sockets; try again after a backoff. */
+                next = gnut_evloop_now(d->loop) + d->cfg.retry;
+                break;
+            }
+        }
+        if (i < num) {
+            break;
+        }
+    }
+
+    /* Nothing else calls us when every candidate left is backing off
+     * and no connect is in flight, so wake up when the first of them
+     * may be dialed again. */
+    if (_gnut_dialer_wanted(d) > 0 &&
+        d->in_flight < d->cfg.max_in_flight && next != 0) {
+        now = gnut_evloop_now(d->loop);
+        gnut_evloop_timer_start(d->loop, &d->retry_timer,
+            (next > now) ? next - now : 0, _gnut_dialer_retry_cb, d);
+    } else {
+        gnut_evloop_timer_stop(d->loop, &d->retry_timer);
+    }
+
+    d->filling = 0;
+}
+
+void gnut_dialer_set_needed(gnut_dialer_t *d, int needed) {
+    d->needed = needed;
+    if (_gnut_dialer_wanted(d) <= 0) {
+        _gnut_dialer_abort_all(d);
+        gnut_evloop_timer_stop(d->loop, &d->retry_timer);
+        return;
+    }
+    _gnut_dialer_fill(d);
+}
+
+int gnut_dialer_in_flight(const gnut_dialer_t *d) {
+    return d->in_flight;
+}
+
+sxs_uint32_t gnut_dialer_num_hosts(const gnut_dialer_t *d) {
+    return d->num_hosts;
+}
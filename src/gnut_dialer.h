@@ -0,0 +1,235 @@
+/*
+ * Copyright 2006-2007 Andrew De Ponte
+ *
+ * This file is part of lib_gnut.
+ *
+ * lib_gnut is the intellectual property of Andrew De Ponte; any
+ * distribution and/or modification and/or reproductions of any portion
+ * of lib_gnut MUST be approved by Andrew De Ponte.
+ *
+ * lib_gnut is distributed WITHOUT ANY WARRANTY; without even the
+ * implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE.
+ */
+
+/**
+ * @file gnut_dialer.h
+ * @brief This is a specifications file for the connection dialer.
+ *
+ * The gnut_dialer.h file is a specifications file that declares the
+ * gnut_dialer_t type and its associated functions. A dialer keeps up
+ * to a configured number of non-blocking connects in flight on an
+ * event loop, picks the candidate hosts most likely to answer first,
+ * and sends the handshake on each socket as soon as it connects.
+ */
+
+#ifndef GNUT_DIALER_H
+#define GNUT_DIALER_H
+
+#include <sxs/sxs.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+#include "gnut_export.h"
+#include "gnut_types.h"
+#include "gnut_error.h"
+#include "gnut_evloop.h"
+#include "gnut_handshake.h"
+#include "gnut_msgs.h"
+
+#define GNUT_DIALER_DEF_IN_FLIGHT 32 /**< Default connects in flight */
+#define GNUT_DIALER_DEF_TIMEOUT 3000000 /**< Default connect timeout, us */
+#define GNUT_DIALER_DEF_RETRY 30000000 /**< Default retry backoff, us */
+#define GNUT_DIALER_DEF_RETRY_MAX 1800000000 /**< Default max backoff */
+#define GNUT_DIALER_MIN_RETRY 100000 /**< Shortest retry backoff, us */
+#define GNUT_DIALER_DEF_MAX_HOSTS 4096 /**< Default candidate hosts */
+
+/**
+ * A Dialer
+ *
+ * The gnut_dialer_t is an opaque type which represents a dialer.
+ */
+typedef struct gnut_dialer gnut_dialer_t;
+
+/**
+ * A Candidate Host
+ *
+ * The gnut_dial_host_t is a type which represents a host the dialer
+ * may connect to and what it has learned about it.
+ */
+typedef struct GNUT_EXPORT gnut_dial_host {
+    sxs_uint32_t ip;            /* Network byte order */
+    sxs_uint16_t port;          /* Host byte order */
+    sxs_uint16_t failures;      /* Consecutive failed connects */
+    sxs_uint32_t successes;     /* Successful handshakes */
+    gnut_uint64_t last_seen;    /* Last time the host was advertised */
+    gnut_uint64_t retry_at;     /* Not dialed again before this time */
+    int dialing;                /* A connect or handshake is under way */
+    int handshaking;            /* Connected, handshake not reported */
+} gnut_dial_host_t;
+
+/**
+ * A Dialer Connected Callback
+ *
+ * The gnut_dialer_conn_cb_t is the type of function called with each
+ * socket that connected. The handshake template, if any, has already
+ * been sent. The socket is non-blocking, no longer registered with the
+ * event loop, and owned by the callee, which must report how the
+ * handshake on it ends with gnut_dialer_handshake_done().
+ */
+typedef void (*gnut_dialer_conn_cb_t)(gnut_dialer_t *d, sxs_socket_t sd,
+    const struct sockaddr_in *addr, void *arg);
+
+/**
+ * A Dialer Result Callback
+ *
+ * The gnut_dialer_result_cb_t is the type of function called after the
+ * dialer updated a host with the outcome of a connect that failed or of
+ * a handshake, so a host cache can record it.
+ */
+typedef void (*gnut_dialer_result_cb_t)(gnut_dialer_t *d,
+    const gnut_dial_host_t *host, int ok, void *arg);
+
+/**
+ * A Dialer Configuration
+ *
+ * The gnut_dialer_cfg_t is a type which holds the settings of a dialer.
+ * Use gnut_dialer_cfg_init() to get the defaults.
+ */
+typedef struct GNUT_EXPORT gnut_dialer_cfg {
+    int max_in_flight;          /* Connects in flight at once */
+    gnut_uint64_t timeout;      /* Connect timeout in us */
+    gnut_uint64_t retry;        /* Backoff after the first failure, us,
+                                   at least GNUT_DIALER_MIN_RETRY */
+    gnut_uint64_t retry_max;    /* Backoff never exceeds this, us */
+    sxs_uint32_t max_hosts;     /* Candidates kept, worst evicted */
+    const gnut_hs_tmpl_t *tmpl; /* Sent on connect, or NULL */
+    gnut_dialer_conn_cb_t on_connected;
+    gnut_dialer_result_cb_t on_result; /* May be NULL */
+    void *arg;                  /* Passed to the callbacks */
+} gnut_dialer_cfg_t;
+
+/**
+ * Initialize a Dialer Configuration
+ *
+ * The gnut_dialer_cfg_init() function fills in 'cfg' with the default
+ * settings and no callbacks.
+ * @param cfg Pointer to the configuration to initialize.
+ */
+GNUT_EXPORT void gnut_dialer_cfg_init(gnut_dialer_cfg_t *cfg);
+
+/**
+ * Create a Dialer
+ *
+ * The gnut_dialer_new() function creates a dialer that runs on 'loop'.
+ * It dials nothing until gnut_dialer_set_needed() asks for connections.
+ * @param pp_d Pointer to store the pointer to the new dialer in.
+ * @param loop Pointer to the event loop to dial on.
+ * @param cfg Pointer to the configuration to use.
+ * @return A value representing an error or success.
+ * @retval GNUT_SUCCESS Successfully created the dialer.
+ * @retval GNUT_ENOMEM Failed to allocate memory.
+ */
+GNUT_EXPORT gnut_error_t gnut_dialer_new(gnut_dialer_t **pp_d,
+    gnut_evloop_t *loop, const gnut_dialer_cfg_t *cfg);
+
+/**
+ * Free a Dialer
+ *
+ * The gnut_dialer_free() function aborts any connects in flight and
+ * frees the dialer.
+ * @param d Pointer to the dialer.
+ */
+GNUT_EXPORT void gnut_dialer_free(gnut_dialer_t *d);
+
+/**
+ * Add a Candidate Host
+ *
+ * The gnut_dialer_add_host() function adds a host or, if it is already
+ * known, refreshes when it was last seen. 'successes' and 'failures'
+ * seed a new host's history, e.g. from a host cache; they are ignored
+ * for known hosts. When the dialer is full the worst ranked host that
+ * is not being dialed makes room.
+ * @param d Pointer to the dialer.
+ * @param ip The IPv4 address in network byte order.
+ * @param port The port in host byte order.
+ * @param last_seen When the host was last advertised, in us.
+ * @param successes Past successful connects.
+ * @param failures Past consecutive failed connects.
+ * @return A value representing an error or success.
+ * @retval GNUT_SUCCESS Successfully added or refreshed the host.
+ * @retval GNUT_EQUEUE_FULL Every kept host is being dialed.
+ */
+GNUT_EXPORT gnut_error_t gnut_dialer_add_host(gnut_dialer_t *d,
+    sxs_uint32_t ip, sxs_uint16_t port, gnut_uint64_t last_seen,
+    sxs_uint32_t successes, sxs_uint16_t failures);
+
+/**
+ * Add a Candidate Host from a Pong
+ *
+ * The gnut_dialer_add_pong() function adds the host a pong advertises,
+ * as seen at time 'now'.
+ * @param d Pointer to the dialer.
+ * @param pong Pointer to the parsed pong payload.
+ * @param now The current time in us.
+ * @return A value representing an error or success.
+ * @retval GNUT_SUCCESS Successfully added or refreshed the host.
+ * @retval GNUT_EQUEUE_FULL Every kept host is being dialed.
+ */
+GNUT_EXPORT gnut_error_t gnut_dialer_add_pong(gnut_dialer_t *d,
+    const gnut_pong_payload_t *pong, gnut_uint64_t now);
+
+/**
+ * Set the Number of Connections Needed
+ *
+ * The gnut_dialer_set_needed() function sets how many more connections
+ * the dialer should make, and starts connects up to the in flight
+ * limit. Each handshake reported to have succeeded lowers the count by
+ * one. Connects stop once the sockets still handshaking cover the
+ * count, and start again if one of those handshakes fails. While every
+ * candidate is backing off the dialer waits on a timer for the first
+ * of them to become eligible.
+ * @param d Pointer to the dialer.
+ * @param needed The number of connections wanted.
+ */
+GNUT_EXPORT void gnut_dialer_set_needed(gnut_dialer_t *d, int needed);
+
+/**
+ * Report a Handshake Outcome
+ *
+ * The gnut_dialer_handshake_done() function tells the dialer how the
+ * handshake ended on a socket it handed to the connected callback. A
+ * success counts towards the connections needed and resets the host's
+ * failures; a failure backs the host off as a failed connect would and
+ * lets the dialer try another host. Hosts not handshaking are ignored.
+ * @param d Pointer to the dialer.
+ * @param ip The IPv4 address in network byte order.
+ * @param port The port in host byte order.
+ * @param ok Non-zero if the handshake succeeded.
+ */
+GNUT_EXPORT void gnut_dialer_handshake_done(gnut_dialer_t *d,
+    sxs_uint32_t ip, sxs_uint16_t port, int ok);
+
+/**
+ * Get the Number of Connects in Flight
+ *
+ * @param d Pointer to the dialer.
+ * @return The number of connects in flight.
+ */
+GNUT_EXPORT int gnut_dialer_in_flight(const gnut_dialer_t *d);
+
+/**
+ * Get the Number of Candidate Hosts
+ *
+ * @param d Pointer to the dialer.
+ * @return The number of hosts the dialer knows.
+ */
+GNUT_EXPORT sxs_uint32_t gnut_dialer_num_hosts(const gnut_dialer_t *d);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* GNUT_DIALER_H */
@@ -0,0 +1,542 @@
+/*
+ * Copyright 2006-2007 Andrew De Ponte
+ *
+ * This file is part of lib_gnut.
+ *
+ * lib_gnut is the intellectual property of Andrew De Ponte; any
+ * distribution and/or modification and/or reproductions of any portion
+ * of lib_gnut MUST be approved by Andrew De Ponte.
+ *
+ * lib_gnut is distributed WITHOUT ANY WARRANTY; without even the
+ * implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE.
+ */
+
+/**
+ * @file gnut_dynq.c
+ * @brief This is an implementation file for dynamic querying.
+ *
+ * The gnut_dynq.c file is an implementation file that defines the
+ * gnut_dynq_t type's associated functions. Connections are kept in an
+ * open addressing table giving their role, the neighbours also in an
+ * array to pick from. Each search is one allocation holding its state
+ * and a copy of its payload, found by Message ID through a chained hash
+ * table which doubles as searches are added.
+ */
+
+#include <stdlib.h> /* calloc(), malloc(), realloc(), free() */
+#include <string.h> /* memcmp(), memcpy(), memset() */
+
+#include "gnut_dynq.h"
+#include "gnut_route.h"
+
+#define CONN_LEAF 0xffffffff    /* Index of a leaf in the neighbours */
+#define MIN_CONNS 16
+#define MIN_BUCKETS 16
+
+typedef struct gnut_dynq_conn {
+    sxs_uint32_t conn;          /* 0 if the entry is empty */
+    sxs_uint32_t idx;           /* In the neighbours, or CONN_LEAF */
+} gnut_dynq_conn_t;
+
+typedef struct gnut_dynq_query {
+    gnut_twheel_timer_t timer;
+    struct gnut_dynq_query *hnext;  /* Next in its bucket */
+    gnut_dynq_t *dq;
+    gnut_msg_hdr_t hdr;
+    sxs_uint32_t hash;
+    sxs_uint32_t leaf;
+    sxs_uint32_t results;
+    gnut_uint64_t started;
+    double hosts;               /* Estimated hosts reached */
+    unsigned char last_ttl;
+    sxs_uint32_t num_sent;
+    sxs_uint32_t sent_to[GNUT_DYNQ_MAX_SENDS];
+} gnut_dynq_query_t;
+
+/* The payload follows each search. */
+#define QUERY_PAYLOAD(q) ((unsigned char *)((q) + 1))
+
+struct gnut_dynq {
+    gnut_dynq_cfg_t cfg;
+    gnut_twheel_t *wheel;
+    gnut_dynq_conn_t *conns;
+    sxs_uint32_t conns_mask;
+    sxs_uint32_t num_conns;
+    sxs_uint32_t *peers;        /* Neighbouring ultrapeers */
+    sxs_uint32_t num_peers;
+    sxs_uint32_t peers_cap;
+    gnut_dynq_query_t **buckets;
+    sxs_uint32_t mask;
+    gnut_dynq_stats_t st;
+};
+
+static sxs_uint32_t _gnut_dynq_conn_hash(sxs_uint32_t conn) {
+    conn ^= conn >> 16;
+    conn *= 0x45d9f3bU;
+    conn ^= conn >> 16;
+    return conn;
+}
+
+static sxs_uint32_t _gnut_dynq_guid_hash(const unsigned char *guid) {
+    sxs_uint32_t h, i;
+
+    h = 2166136261U;
+    for (i = 0; i < 16; i++) {
+        h = (h ^ guid[i]) * 16777619U;
+    }
+    return h;
+}
+
+/* Returns the entry of 'conn', or the empty entry it would take. */
+static gnut_dynq_conn_t *_gnut_dynq_conn_find(const gnut_dynq_t *dq,
+    sxs_uint32_t conn) {
+
+    sxs_uint32_t i;
+
+    i = _gnut_dynq_conn_hash(conn) & dq->conns_mask;
+    while (dq->conns[i].conn != 0 && dq->conns[i].conn != conn) {
+        i = (i + 1) & dq->conns_mask;
+    }
+    return &dq->conns[i];
+}
+
+static gnut_error_t _gnut_dynq_conns_grow(gnut_dynq_t *dq) {
+    gnut_dynq_conn_t *old, *e;
+    sxs_uint32_t old_len, i;
+
+    old = dq->conns;
+    old_len = dq->conns_mask + 1;
+    dq->conns = (gnut_dynq_conn_t *)calloc(old_len * 2,
+        sizeof(gnut_dynq_conn_t));
+    if (dq->conns == NULL) {
+        dq->conns = old;
+        return GNUT_ENOMEM;
+    }
+    dq->conns_mask = old_len * 2 - 1;
+    for (i = 0; i < old_len; i++) {
+        if (old[i].conn != 0) {
+            e = _gnut_dynq_conn_find(dq, old[i].conn);
+            *e = old[i];
+        }
+    }
+    free(old);
+    return GNUT_SUCCESS;
+}
+
+static void _gnut_dynq_peer_remove(gnut_dynq_t *dq, gnut_dynq_conn_t *e) {
+    sxs_uint32_t last;
+
+    last = dq->peers[--dq->num_peers];
+    if (last != e->conn) {
+        dq->peers[e->idx] = last;
+        _gnut_dynq_conn_find(dq, last)->idx = e->idx;
+    }
+    e->idx = CONN_LEAF;
+}
+
+static gnut_error_t _gnut_dynq_peer_add(gnut_dynq_t *dq,
+    gnut_dynq_conn_t *e) {
+
+    sxs_uint32_t *peers;
+
+    if (dq->num_peers == dq->peers_cap) {
+        peers = (sxs_uint32_t *)realloc(dq->peers,
+            (dq->peers_cap * 2 + 8) * sizeof(sxs_uint32_t));
+        if (peers == NULL) {
+            return GNUT_ENOMEM;
+        }
+        dq->peers = peers;
+        dq->peers_cap = dq->peers_cap * 2 + 8;
+    }
+    e->idx = dq->num_peers;
+    dq->peers[dq->num_peers++] = e->conn;
+    return GNUT_SUCCESS;
+}
+
+static gnut_dynq_query_t *_gnut_dynq_find(const gnut_dynq_t *dq,
+    const unsigned char *guid) {
+
+    gnut_dynq_query_t *q;
+
+    q = dq->buckets[_gnut_dynq_guid_hash(guid) & dq->mask];
+    while (q != NULL && memcmp(q->hdr.message_id, guid, 16) != 0) {
+        q = q->hnext;
+    }
+    return q;
+}
+
+static void _gnut_dynq_buckets_grow(gnut_dynq_t *dq) {
+    gnut_dynq_query_t **buckets, *q, *next;
+    sxs_uint32_t len, i;
+
+    len = (dq->mask + 1) * 2;
+    buckets = (gnut_dynq_query_t **)calloc(len, sizeof(gnut_dynq_query_t *));
+    if (buckets == NULL) {
+        /* Longer chains will do. */
+        return;
+    }
+    for (i = 0; i <= dq->mask; i++) {
+        for (q = dq->buckets[i]; q != NULL; q = next) {
+            next = q->hnext;
+            q->hnext = buckets[q->hash & (len - 1)];
+            buckets[q->hash & (len - 1)] = q;
+        }
+    }
+    free(dq->buckets);
+    dq->buckets = buckets;
+    dq->mask = len - 1;
+}
+
+static void _gnut_dynq_finish(gnut_dynq_t *dq, gnut_dynq_query_t *q,
+    int reason) {
+
+    gnut_dynq_query_t **pp;
+
+    gnut_twheel_stop(dq->wheel, &q->timer);
+    pp = &dq->buckets[q->hash & dq->mask];
+    while (*pp != q) {
+        pp = &(*pp)->hnext;
+    }
+    *pp = q->hnext;
+    dq->st.done[reason]++;
+    dq->st.active--;
+    free(q);
+}
+
+/* Returns the hosts within 'ttl' hops through one neighbour. */
+static double _gnut_dynq_horizon(const gnut_dynq_t *dq, unsigned int ttl) {
+    double hosts, level;
+    unsigned int i;
+
+    hosts = 0.0;
+    level = 1.0;
+    for (i = 0; i < ttl; i++) {
+        hosts += level;
+        level *= (dq->cfg.degree > 1) ? dq->cfg.degree - 1 : 1;
+    }
+    return hosts;
+}
+
+/* Returns the TTL of the next step: one more than the last while
+ * nothing is found, and otherwise the smallest whose horizon holds the
+ * hosts which, at the rate so far, have the results still needed. */
+static unsigned char _gnut_dynq_next_ttl(const gnut_dynq_t *dq,
+    const gnut_dynq_query_t *q) {
+
+    double needed;
+    unsigned char ttl;
+
+    if (q->results == 0) {
+        ttl = q->last_ttl + 1;
+        return (ttl > dq->cfg.max_ttl) ? dq->cfg.max_ttl : ttl;
+    }
+    needed = (double)(dq->cfg.target - q->results) * q->hosts / q->results;
+    ttl = 1;
+    while (ttl < dq->cfg.max_ttl && _gnut_dynq_horizon(dq, ttl) < needed) {
+        ttl++;
+    }
+    return ttl;
+}
+
+static int _gnut_dynq_was_sent(const gnut_dynq_query_t *q,
+    sxs_uint32_t peer) {
+
+    sxs_uint32_t i;
+
+    for (i = 0; i < q->num_sent; i++) {
+        if (q->sent_to[i] == peer) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/* Returns a neighbour not yet sent the Query, or 0. Each search walks
+ * the neighbours from its own place, to spread the first steps. */
+static sxs_uint32_t _gnut_dynq_next_peer(const gnut_dynq_t *dq,
+    const gnut_dynq_query_t *q) {
+
+    sxs_uint32_t i, peer;
+
+    if (q->num_sent == GNUT_DYNQ_MAX_SENDS) {
+        return 0;
+    }
+    for (i = 0; i < dq->num_peers; i++) {
+        peer = dq->peers[(q->hash + i) % dq->num_peers];
+        if (!_gnut_dynq_was_sent(q, peer)) {
+            return peer;
+        }
+    }
+    return 0;
+}
+
+static void _gnut_dynq_send(gnut_dynq_t *dq, gnut_dynq_query_t *q,
+    sxs_uint32_t to, unsigned char ttl) {
+
+    gnut_msg_hdr_t hdr;
+
+    hdr = q->hdr;
+    hdr.ttl = ttl;
+    q->sent_to[q->num_sent++] = to;
+    dq->st.sends++;
+    dq->cfg.send(dq, to, &hdr, QUERY_PAYLOAD(q), dq->cfg.arg);
+}
+
+static void _gnut_dynq_expire(gnut_twheel_t *w, gnut_twheel_timer_t *t,
+    void *arg);
+
+/* Ends the search or takes its next step and waits for the replies. */
+static void _gnut_dynq_step(gnut_dynq_t *dq, gnut_dynq_query_t *q) {
+    sxs_uint32_t to, n;
+    unsigned char ttl;
+
+    if (q->leaf != GNUT_ROUTE_SELF && !gnut_dynq_is_leaf(dq, q->leaf)) {
+        _gnut_dynq_finish(dq, q, GNUT_DYNQ_DONE_GONE);
+        return;
+    }
+    if (q->results >= dq->cfg.target) {
+        _gnut_dynq_finish(dq, q, GNUT_DYNQ_DONE_TARGET);
+        return;
+    }
+    if (dq->wheel->now - q->started >= dq->cfg.max_time) {
+        _gnut_dynq_finish(dq, q, GNUT_DYNQ_DONE_TIME);
+        return;
+    }
+
+    if (q->num_sent == 0) {
+        ttl = dq->cfg.probe_ttl;
+        n = 0;
+        while (n < dq->cfg.probe_peers &&
+            (to = _gnut_dynq_next_peer(dq, q)) != 0) {
+            _gnut_dynq_send(dq, q, to, ttl);
+            n++;
+        }
+    } else {
+        ttl = _gnut_dynq_next_ttl(dq, q);
+        n = 0;
+        if ((to = _gnut_dynq_next_peer(dq, q)) != 0) {
+            _gnut_dynq_send(dq, q, to, ttl);
+            n++;
+        }
+    }
+    if (n == 0) {
+        _gnut_dynq_finish(dq, q, GNUT_DYNQ_DONE_PEERS);
+        return;
+    }
+
+    dq->st.steps++;
+    q->hosts += n * _gnut_dynq_horizon(dq, ttl);
+    q->last_ttl = ttl;
+    gnut_twheel_start(dq->wheel, &q->timer, ttl * dq->cfg.hop_wait,
+        _gnut_dynq_expire, (void *)q);
+}
+
+static void _gnut_dynq_expire(gnut_twheel_t *w, gnut_twheel_timer_t *t,
+    void *arg) {
+
+    gnut_dynq_query_t *q;
+
+    q = (gnut_dynq_query_t *)arg;
+    _gnut_dynq_step(q->dq, q);
+}
+
+void gnut_dynq_cfg_init(gnut_dynq_cfg_t *cfg, gnut_dynq_send_cb_t send,
+    void *arg) {
+
+    cfg->target = GNUT_DYNQ_DEF_TARGET;
+    cfg->probe_peers = GNUT_DYNQ_DEF_PROBE_PEERS;
+    cfg->probe_ttl = GNUT_DYNQ_DEF_PROBE_TTL;
+    cfg->max_ttl = GNUT_DYNQ_DEF_MAX_TTL;
+    cfg->degree = GNUT_DYNQ_DEF_DEGREE;
+    cfg->hop_wait = GNUT_DYNQ_DEF_HOP_WAIT;
+    cfg->max_time = GNUT_DYNQ_DEF_MAX_TIME;
+    cfg->max_queries = GNUT_DYNQ_DEF_MAX_QUERIES;
+    cfg->send = send;
+    cfg->arg = arg;
+}
+
+gnut_error_t gnut_dynq_new(gnut_dynq_t **pp_dq, const gnut_dynq_cfg_t *cfg,
+    gnut_twheel_t *wheel) {
+
+    gnut_dynq_t *dq;
+
+    dq = (gnut_dynq_t *)calloc(1, sizeof(gnut_dynq_t));
+    if (dq == NULL) {
+        return GNUT_ENOMEM;
+    }
+    dq->cfg = *cfg;
+    if (dq->cfg.probe_ttl == 0) {
+        dq->cfg.probe_ttl = 1;
+    }
+    if (dq->cfg.max_ttl < dq->cfg.probe_ttl) {
+        dq->cfg.max_ttl = dq->cfg.probe_ttl;
+    }
+    dq->wheel = wheel;
+    dq->conns = (gnut_dynq_conn_t *)calloc(MIN_CONNS,
+        sizeof(gnut_dynq_conn_t));
+    dq->buckets = (gnut_dynq_query_t **)calloc(MIN_BUCKETS,
+        sizeof(gnut_dynq_query_t *));
+    if (dq->conns == NULL || dq->buckets == NULL) {
+        gnut_dynq_free(dq);
+        return GNUT_ENOMEM;
+    }
+    dq->conns_mask = MIN_CONNS - 1;
+    dq->mask = MIN_BUCKETS - 1;
+    *pp_dq = dq;
+    return GNUT_SUCCESS;
+}
+
+void gnut_dynq_free(gnut_dynq_t *dq) {
+    gnut_dynq_query_t *q, *next;
+    sxs_uint32_t i;
+
+    if (dq->buckets != NULL) {
+        for (i = 0; i <= dq->mask; i++) {
+            for (q = dq->buckets[i]; q != NULL; q = next) {
+                next = q->hnext;
+                gnut_twheel_stop(dq->wheel, &q->timer);
+                free(q);
+            }
+        }
+    }
+    free(dq->buckets);
+    free(dq->conns);
+    free(dq->peers);
+    free(dq);
+}
+
+gnut_error_t gnut_dynq_add_conn(gnut_dynq_t *dq, sxs_uint32_t conn,
+    int is_leaf) {
+
+    gnut_dynq_conn_t *e;
+
+    if ((dq->num_conns + 1) * 2 > dq->conns_mask + 1 &&
+        _gnut_dynq_conns_grow(dq) != GNUT_SUCCESS) {
+        return GNUT_ENOMEM;
+    }
+    e = _gnut_dynq_conn_find(dq, conn);
+    if (e->conn == 0) {
+        e->conn = conn;
+        e->idx = CONN_LEAF;
+        dq->num_conns++;
+    } else if (e->idx != CONN_LEAF && is_leaf) {
+        _gnut_dynq_peer_remove(dq, e);
+    }
+    if (!is_leaf && e->idx == CONN_LEAF) {
+        return _gnut_dynq_peer_add(dq, e);
+    }
+    return GNUT_SUCCESS;
+}
+
+void gnut_dynq_remove_conn(gnut_dynq_t *dq, sxs_uint32_t conn) {
+    gnut_dynq_conn_t *e;
+    sxs_uint32_t i, j, k;
+
+    e = _gnut_dynq_conn_find(dq, conn);
+    if (e->conn == 0) {
+        return;
+    }
+    if (e->idx != CONN_LEAF) {
+        _gnut_dynq_peer_remove(dq, e);
+    }
+    dq->num_conns--;
+
+    /* Shift back the entries after it which would no longer be found,
+     * rather than leave a tombstone. */
+    i = (sxs_uint32_t)(e - dq->conns);
+    j = i;
+    for (;;) {
+        j = (j + 1) & dq->conns_mask;
+        if (dq->conns[j].conn == 0) {
+            break;
+        }
+        k = _gnut_dynq_conn_hash(dq->conns[j].conn) & dq->conns_mask;
+        if ((j > i && (k <= i || k > j)) || (j < i && k <= i && k > j)) {
+            dq->conns[i] = dq->conns[j];
+            i = j;
+        }
+    }
+    dq->conns[i].conn = 0;
+}
+
+int gnut_dynq_is_leaf(const gnut_dynq_t *dq, sxs_uint32_t conn) {
+    const gnut_dynq_conn_t *e;
+
+    e = _gnut_dynq_conn_find(dq, conn);
+    return e->conn != 0 && e->idx == CONN_LEAF;
+}
+
+gnut_error_t gnut_dynq_start(gnut_dynq_t *dq, sxs_uint32_t leaf,
+    const gnut_msg_hdr_t *hdr, const unsigned char *payload) {
+
+    gnut_dynq_query_t *q;
+
+    if (_gnut_dynq_find(dq, hdr->message_id) != NULL) {
+        return GNUT_EEXISTS;
+    }
+    if (dq->num_peers == 0) {
+        return GNUT_ENOT_FOUND;
+    }
+    if (dq->st.active >= dq->cfg.max_queries) {
+        dq->st.refused++;
+        return GNUT_EQUEUE_FULL;
+    }
+    q = (gnut_dynq_query_t *)malloc(sizeof(gnut_dynq_query_t) +
+        hdr->pl_len);
+    if (q == NULL) {
+        return GNUT_ENOMEM;
+    }
+    memset((void *)q, 0, sizeof(gnut_dynq_query_t));
+    memcpy((void *)QUERY_PAYLOAD(q), (const void *)payload, hdr->pl_len);
+    gnut_twheel_timer_init(&q->timer);
+    q->dq = dq;
+    q->hdr = *hdr;
+    q->hash = _gnut_dynq_guid_hash(hdr->message_id);
+    q->leaf = leaf;
+    q->started = dq->wheel->now;
+
+    if (dq->st.active > dq->mask) {
+        _gnut_dynq_buckets_grow(dq);
+    }
+    q->hnext = dq->buckets[q->hash & dq->mask];
+    dq->buckets[q->hash & dq->mask] = q;
+    dq->st.active++;
+    dq->st.started++;
+    _gnut_dynq_step(dq, q);
+    return GNUT_SUCCESS;
+}
+
+void gnut_dynq_hit(gnut_dynq_t *dq, const unsigned char *guid,
+    sxs_uint32_t num_results) {
+
+    gnut_dynq_query_t *q;
+
+    q = _gnut_dynq_find(dq, guid);
+    if (q == NULL) {
+        return;
+    }
+    dq->st.hits++;
+    dq->st.results += num_results;
+    q->results += num_results;
+    if (q->results >= dq->cfg.target) {
+        _gnut_dynq_finish(dq, q, GNUT_DYNQ_DONE_TARGET);
+    }
+}
+
+int gnut_dynq_results(const gnut_dynq_t *dq, const unsigned char *guid,
+    sxs_uint32_t *results) {
+
+    const gnut_dynq_query_t *q;
+
+    q = _gnut_dynq_find(dq, guid);
+    if (q == NULL) {
+        return 0;
+    }
+    *results = q->results;
+    return 1;
+}
+
+void gnut_dynq_stats(const gnut_dynq_t *dq, gnut_dynq_stats_t *st) {
+    *st = dq->st;
+}
@@ -0,0 +1,250 @@
+/*
+ * Copyright 2006-2007 Andrew De Ponte
+ *
+ * This file is part of lib_gnut.
+ *
+ * lib_gnut is the intellectual property of Andrew De Ponte; any
+ * distribution and/or modification and/or reproductions of any portion
+ * of lib_gnut MUST be approved by Andrew De Ponte.
+ *
+ * lib_gnut is distributed WITHOUT ANY WARRANTY; without even the
+ * implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE.
+ */
+
+/**
+ * @file gnut_dynq.h
+ * @brief This is a specifications file for dynamic querying.
+ *
+ * The gnut_dynq.h file is a specifications file that declares the
+ * gnut_dynq_t type and its associated functions. An ultrapeer floods a
+ * Query from one of its leaves to every neighbour with a full TTL,
+ * reaching a great many hosts even when the first few would have
+ * answered it. Dynamic querying sends it instead to a few neighbours
+ * at a time: first a probe with a small TTL, then to one more neighbour
+ * after another, each with the TTL the results so far suggest is
+ * needed, counting the results of the Query Hits routed back, until
+ * enough have come or there is no neighbour left to ask.
+ *
+ * After each step the controller waits for the replies of the hosts it
+ * reached, a time proportional to the TTL used. The horizon of a TTL
+ * is estimated from a typical number of neighbours per ultrapeer, and
+ * the hosts still needed from the results per host reached so far.
+ * The waits are timers of a gnut_twheel_t the owner advances, so that
+ * thousands of searches in progress cost nothing between steps.
+ */
+
+#ifndef GNUT_DYNQ_H
+#define GNUT_DYNQ_H
+
+#include <sxs/sxs.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+#include "gnut_export.h"
+#include "gnut_types.h"
+#include "gnut_error.h"
+#include "gnut_msgs.h"
+#include "gnut_twheel.h"
+
+#define GNUT_DYNQ_DEF_TARGET 150 /**< Default results sought */
+#define GNUT_DYNQ_DEF_PROBE_PEERS 3 /**< Default neighbours probed */
+#define GNUT_DYNQ_DEF_PROBE_TTL 2 /**< Default TTL of the probe */
+#define GNUT_DYNQ_DEF_MAX_TTL 4 /**< Default largest TTL of a step */
+#define GNUT_DYNQ_DEF_DEGREE 32 /**< Default neighbours per ultrapeer */
+#define GNUT_DYNQ_DEF_HOP_WAIT 2400000 /**< Default wait per TTL, in us */
+#define GNUT_DYNQ_DEF_MAX_TIME 200000000 /**< Default longest search, us */
+#define GNUT_DYNQ_DEF_MAX_QUERIES 16384 /**< Default searches at once */
+#define GNUT_DYNQ_MAX_SENDS 64 /**< Most neighbours one Query is sent to */
+
+#define GNUT_DYNQ_DONE_TARGET 0 /**< Enough results came */
+#define GNUT_DYNQ_DONE_PEERS 1 /**< Every neighbour was sent the Query */
+#define GNUT_DYNQ_DONE_TIME 2 /**< The search took too long */
+#define GNUT_DYNQ_DONE_GONE 3 /**< The leaf disconnected */
+#define GNUT_DYNQ_NUM_DONE 4 /**< Number of reasons a search ends */
+
+typedef struct gnut_dynq gnut_dynq_t;
+
+/**
+ * A Dynamic Query Send Callback
+ *
+ * The gnut_dynq_send_cb_t is the type of function called to send a
+ * Query to neighbour 'to'. 'hdr' has the TTL of the step and the hops
+ * of a relayed Query; the payload is only valid during the call. It
+ * must not call back into the controller.
+ */
+typedef void (*gnut_dynq_send_cb_t)(gnut_dynq_t *dq, sxs_uint32_t to,
+    const gnut_msg_hdr_t *hdr, const unsigned char *payload, void *arg);
+
+/**
+ * A Dynamic Query Configuration
+ *
+ * The gnut_dynq_cfg_t is a type which holds the parameters of a
+ * dynamic query controller.
+ */
+typedef struct GNUT_EXPORT gnut_dynq_cfg {
+    sxs_uint32_t target;        /* Results after which a search stops */
+    sxs_uint32_t probe_peers;   /* Neighbours the probe is sent to */
+    unsigned char probe_ttl;
+    unsigned char max_ttl;      /* Largest TTL of a later step */
+    sxs_uint32_t degree;        /* Neighbours per ultrapeer, for horizons */
+    gnut_uint64_t hop_wait;     /* Wait after a step, per TTL, in us */
+    gnut_uint64_t max_time;     /* Longest a search goes on, in us */
+    sxs_uint32_t max_queries;   /* Searches in progress at once */
+    gnut_dynq_send_cb_t send;
+    void *arg;                  /* Passed to 'send' */
+} gnut_dynq_cfg_t;
+
+/**
+ * Dynamic Query Statistics
+ *
+ * The gnut_dynq_stats_t is a type which holds the counters of a dynamic
+ * query controller, indexed by GNUT_DYNQ_DONE_* where there is one per
+ * reason.
+ */
+typedef struct GNUT_EXPORT gnut_dynq_stats {
+    gnut_uint64_t started;
+    gnut_uint64_t refused;      /* Over the most searches at once */
+    gnut_uint64_t done[GNUT_DYNQ_NUM_DONE];
+    gnut_uint64_t steps;        /* Probes and later steps */
+    gnut_uint64_t sends;        /* Copies of Queries sent */
+    gnut_uint64_t hits;         /* Query Hits counted */
+    gnut_uint64_t results;      /* Results in them */
+    sxs_uint32_t active;        /* Searches in progress */
+} gnut_dynq_stats_t;
+
+/**
+ * Initialize a Dynamic Query Configuration
+ *
+ * The gnut_dynq_cfg_init() function sets the GNUT_DYNQ_DEF_* defaults
+ * and the callback to send Queries with.
+ * @param cfg Pointer to the configuration to initialize.
+ * @param send The function to call to send a Query.
+ * @param arg Passed to 'send'.
+ */
+GNUT_EXPORT void gnut_dynq_cfg_init(gnut_dynq_cfg_t *cfg,
+    gnut_dynq_send_cb_t send, void *arg);
+
+/**
+ * Create a Dynamic Query Controller
+ *
+ * @param pp_dq Pointer to store the pointer to the new controller in.
+ * @param cfg Pointer to the configuration, which is copied.
+ * @param wheel Pointer to the timer wheel to wait on, which may be
+ * shared and must outlive the controller.
+ * @return A value representing an error or success.
+ * @retval GNUT_SUCCESS Successfully created the controller.
+ * @retval GNUT_ENOMEM Failed to allocate memory.
+ */
+GNUT_EXPORT gnut_error_t gnut_dynq_new(gnut_dynq_t **pp_dq,
+    const gnut_dynq_cfg_t *cfg, gnut_twheel_t *wheel);
+
+/**
+ * Free a Dynamic Query Controller
+ *
+ * The gnut_dynq_free() function stops every search in progress without
+ * counting it as done and frees the controller.
+ * @param dq Pointer to the controller.
+ */
+GNUT_EXPORT void gnut_dynq_free(gnut_dynq_t *dq);
+
+/**
+ * Add a Connection to a Dynamic Query Controller
+ *
+ * The gnut_dynq_add_conn() function makes connection 'conn' known as a
+ * neighbouring ultrapeer, to send Queries to, or as a leaf, whose
+ * Queries are searched for dynamically. Adding a known connection
+ * changes its role.
+ * @param dq Pointer to the controller.
+ * @param conn The connection id, which must not be 0.
+ * @param is_leaf Non-zero if the connection is to a leaf.
+ * @return A value representing an error or success.
+ * @retval GNUT_SUCCESS Successfully added the connection.
+ * @retval GNUT_ENOMEM Failed to allocate memory.
+ */
+GNUT_EXPORT gnut_error_t gnut_dynq_add_conn(gnut_dynq_t *dq,
+    sxs_uint32_t conn, int is_leaf);
+
+/**
+ * Remove a Connection from a Dynamic Query Controller
+ *
+ * The gnut_dynq_remove_conn() function forgets connection 'conn'. The
+ * searches of a leaf end at their next step.
+ * @param dq Pointer to the controller.
+ * @param conn The connection id.
+ */
+GNUT_EXPORT void gnut_dynq_remove_conn(gnut_dynq_t *dq, sxs_uint32_t conn);
+
+/**
+ * Check Whether a Connection is to a Leaf
+ *
+ * @param dq Pointer to the controller.
+ * @param conn The connection id.
+ * @return Non-zero if 'conn' was added as a leaf, 0 otherwise.
+ */
+GNUT_EXPORT int gnut_dynq_is_leaf(const gnut_dynq_t *dq, sxs_uint32_t conn);
+
+/**
+ * Start a Dynamic Query
+ *
+ * The gnut_dynq_start() function starts searching for the Query 'hdr'
+ * and 'payload' on behalf of 'leaf', sending the probe at once. The
+ * Query must already be in the node's routing table, so that its Query
+ * Hits come back to the leaf and are counted with gnut_dynq_hit().
+ * @param dq Pointer to the controller.
+ * @param leaf The connection id of the leaf, or GNUT_ROUTE_SELF for a
+ * search of this node's own.
+ * @param hdr Pointer to the header of the Query, whose TTL is replaced.
+ * @param payload Pointer to the hdr->pl_len bytes of payload, which are
+ * copied.
+ * @return A value representing an error or success.
+ * @retval GNUT_SUCCESS Successfully started the search.
+ * @retval GNUT_EEXISTS The Message ID is already searched for.
+ * @retval GNUT_EQUEUE_FULL There are as many searches as allowed.
+ * @retval GNUT_ENOT_FOUND There is no neighbour to send to.
+ * @retval GNUT_ENOMEM Failed to allocate memory.
+ */
+GNUT_EXPORT gnut_error_t gnut_dynq_start(gnut_dynq_t *dq, sxs_uint32_t leaf,
+    const gnut_msg_hdr_t *hdr, const unsigned char *payload);
+
+/**
+ * Count a Query Hit for a Dynamic Query
+ *
+ * The gnut_dynq_hit() function adds 'num_results' to the results of the
+ * search for Message ID 'guid', ending it if it has enough. Query Hits
+ * of other Message IDs are ignored. A node counts those it routes; the
+ * owner counts those received out of band.
+ * @param dq Pointer to the controller.
+ * @param guid Pointer to the 16 byte Message ID of the Query Hit.
+ * @param num_results The number of results in the Query Hit.
+ */
+GNUT_EXPORT void gnut_dynq_hit(gnut_dynq_t *dq, const unsigned char *guid,
+    sxs_uint32_t num_results);
+
+/**
+ * Get the Results of a Dynamic Query
+ *
+ * @param dq Pointer to the controller.
+ * @param guid Pointer to the 16 byte Message ID of the Query.
+ * @param results Pointer to store the results counted so far in.
+ * @return Non-zero if the search is in progress, 0 otherwise.
+ */
+GNUT_EXPORT int gnut_dynq_results(const gnut_dynq_t *dq,
+    const unsigned char *guid, sxs_uint32_t *results);
+
+/**
+ * Get the Statistics of a Dynamic Query Controller
+ *
+ * @param dq Pointer to the controller.
+ * @param st Pointer to the statistics to fill in.
+ */
+GNUT_EXPORT void gnut_dynq_stats(const gnut_dynq_t *dq,
+    gnut_dynq_stats_t *st);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* GNUT_DYNQ_H */
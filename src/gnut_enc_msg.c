@@ -0,0 +1,75 @@
+/*
+ * Copyright 2006-2007 Andrew De Ponte
+ *
+ * This file is part of lib_gnut.
+ *
+ * lib_gnut is the intellectual property of Andrew De Ponte; any
+ * distribution and/or modification and/or reproductions of any portion
+ * of lib_gnut MUST be approved by Andrew De Ponte.
+ *
+ * lib_gnut is distributed WITHOUT ANY WARRANTY; without even the
+ * implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE.
+ */
+
+/**
+ * @file gnut_enc_msg.c
+ * @brief This is an implementation file for encoded messages.
+ *
+ * The gnut_enc_msg.c file is an implementation file that defines the
+ * gnut_enc_msg_t type's associated functions.
+ */
+
+#include <stdlib.h> /* malloc(), free() */
+#include <string.h> /* memcpy() */
+
+#include "gnut_enc_msg.h"
+#include "gnut_atomic.h"
+
+gnut_error_t gnut_enc_msg_new(gnut_enc_msg_t **pp_msg, sxs_uint32_t len) {
+    gnut_enc_msg_t *msg;
+
+    msg = (gnut_enc_msg_t *)malloc(sizeof(gnut_enc_msg_t) + len);
+    if (msg == NULL) {
+        return GNUT_ENOMEM;
+    }
+    msg->refs = 1;
+    msg->len = len;
+    msg->data = (unsigned char *)(msg + 1);
+
+    *pp_msg = msg;
+
+    return GNUT_SUCCESS;
+}
+
+gnut_error_t gnut_enc_msg_encode(gnut_enc_msg_t **pp_msg,
+    const gnut_msg_hdr_t *p_header, const unsigned char *payload) {
+
+    gnut_enc_msg_t *msg;
+    gnut_error_t reterr;
+
+    reterr = gnut_enc_msg_new(&msg, GNUT_MSG_HDR_LEN + p_header->pl_len);
+    if (reterr != GNUT_SUCCESS) {
+        return reterr;
+    }
+    gnut_encode_msg_hdr(p_header, msg->data);
+    if (p_header->pl_len > 0) {
+        memcpy((void *)(msg->data + GNUT_MSG_HDR_LEN),
+            (const void *)payload, p_header->pl_len);
+    }
+
+    *pp_msg = msg;
+
+    return GNUT_SUCCESS;
+}
+
+gnut_enc_msg_t *gnut_enc_msg_ref(gnut_enc_msg_t *msg) {
+    GNUT_ATOMIC_ADD_RLX(&msg->refs, 1);
+    return msg;
+}
+
+void gnut_enc_msg_unref(gnut_enc_msg_t *msg) {
+    if (GNUT_ATOMIC_SUB(&msg->refs, 1) == 1) {
+        free(msg);
+    }
+}
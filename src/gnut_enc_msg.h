@@ -0,0 +1,109 @@
+/*
+ * Copyright 2006-2007 Andrew De Ponte
+ *
+ * This file is part of lib_gnut.
+ *
+ * lib_gnut is the intellectual property of Andrew De Ponte; any
+ * distribution and/or modification and/or reproductions of any portion
+ * of lib_gnut MUST be approved by Andrew De Ponte.
+ *
+ * lib_gnut is distributed WITHOUT ANY WARRANTY; without even the
+ * implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE.
+ */
+
+/**
+ * @file gnut_enc_msg.h
+ * @brief This is a specifications file for encoded messages.
+ *
+ * The gnut_enc_msg.h file is a specifications file that declares the
+ * gnut_enc_msg_t type, a Gnutella message in its wire format with a
+ * reference count. A message relayed to many connections, possibly
+ * owned by different threads, is encoded once and shared by reference
+ * instead of being copied per connection.
+ */
+
+#ifndef GNUT_ENC_MSG_H
+#define GNUT_ENC_MSG_H
+
+#include <sxs/sxs.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+#include "gnut_export.h"
+#include "gnut_types.h"
+#include "gnut_error.h"
+#include "gnut_msgs.h"
+
+/**
+ * An Encoded Gnutella Message
+ *
+ * The gnut_enc_msg_t is a type which represents a complete message,
+ * header and payload, in its wire format. 'data' points just past the
+ * structure, in the same allocation. The reference count is atomic, so
+ * a message may be shared across threads, but 'data' must not be
+ * changed once the message has been shared.
+ */
+typedef struct GNUT_EXPORT gnut_enc_msg {
+    sxs_uint32_t refs;          /* Reference count */
+    sxs_uint32_t len;           /* Bytes in data, header included */
+    unsigned char *data;
+} gnut_enc_msg_t;
+
+/**
+ * Create an Encoded Message
+ *
+ * The gnut_enc_msg_new() function allocates a message with room for
+ * 'len' bytes of wire data, header included, and a reference count of
+ * one. The data is left for the caller to fill in.
+ * @param pp_msg Pointer to store the pointer to the new message in.
+ * @param len The number of bytes of wire data.
+ * @return A value representing an error or success.
+ * @retval GNUT_SUCCESS Successfully created the message.
+ * @retval GNUT_ENOMEM Failed to allocate memory.
+ */
+GNUT_EXPORT gnut_error_t gnut_enc_msg_new(gnut_enc_msg_t **pp_msg,
+    sxs_uint32_t len);
+
+/**
+ * Encode a Message
+ *
+ * The gnut_enc_msg_encode() function creates a message from the header
+ * that 'p_header' points to and the 'p_header->pl_len' bytes of
+ * payload at 'payload'.
+ * @param pp_msg Pointer to store the pointer to the new message in.
+ * @param p_header Pointer to the message header to encode.
+ * @param payload Pointer to the payload, which may be NULL if the
+ * payload length is zero.
+ * @return A value representing an error or success.
+ * @retval GNUT_SUCCESS Successfully created the message.
+ * @retval GNUT_ENOMEM Failed to allocate memory.
+ */
+GNUT_EXPORT gnut_error_t gnut_enc_msg_encode(gnut_enc_msg_t **pp_msg,
+    const gnut_msg_hdr_t *p_header, const unsigned char *payload);
+
+/**
+ * Reference an Encoded Message
+ *
+ * The gnut_enc_msg_ref() function adds a reference to 'msg'.
+ * @param msg Pointer to the message.
+ * @return The value of 'msg', for convenience.
+ */
+GNUT_EXPORT gnut_enc_msg_t *gnut_enc_msg_ref(gnut_enc_msg_t *msg);
+
+/**
+ * Release an Encoded Message
+ *
+ * The gnut_enc_msg_unref() function drops a reference to 'msg' and
+ * frees it when the last reference is gone.
+ * @param msg Pointer to the message.
+ */
+GNUT_EXPORT void gnut_enc_msg_unref(gnut_enc_msg_t *msg);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* GNUT_ENC_MSG_H */
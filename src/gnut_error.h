@@ -25,5 +25,26 @@
 
 #define GNUT_SUCCESS    0   /**< Operation completed successfully */
 #define GNUT_EBUILD_MSG_ID  1   /**< Failed to build random message ID */
+#define GNUT_EBUF_TOO_SMALL 2   /**< Output buffer is too small */
+#define GNUT_EHS_INCOMPLETE 3   /**< Handshake needs more bytes */
+#define GNUT_EHS_MALFORMED  4   /**< Handshake is malformed */
+#define GNUT_EHS_TOO_LARGE  5   /**< Handshake exceeds max length */
+#define GNUT_EHS_TOO_MANY_HDRS  6   /**< Handshake has too many headers */
+#define GNUT_EHS_NO_HDR     7   /**< Handshake header is not present */
+#define GNUT_ENOMEM         8   /**< Failed to allocate memory */
+#define GNUT_EDEFLATE       9   /**< Deflate stream error */
+#define GNUT_EEVLOOP        10  /**< Event loop operation failed */
+#define GNUT_EQUEUE_FULL    11  /**< Queue is full */
+#define GNUT_ETHREAD        12  /**< Failed to create a thread */
+#define GNUT_ESOCKET        13  /**< Socket operation failed */
+#define GNUT_EFILE          14  /**< File cannot be opened, mapped or read */
+#define GNUT_ENOT_FOUND     15  /**< Entry is not present */
+#define GNUT_EFRAME         16  /**< Message cannot be framed */
+#define GNUT_EEOF           17  /**< End of file reached */
+#define GNUT_EHS_REJECTED   18  /**< Handshake was refused by the peer */
+#define GNUT_ETIMEDOUT      19  /**< Operation timed out */
+#define GNUT_EMALFORMED     20  /**< Payload is malformed */
+#define GNUT_EEXISTS        21  /**< Entry is already present */
+#define GNUT_EPEER_LIMIT    22  /**< Over the limits the peer gave */
 
 #endif /* GNUT_ERROR_H */
@@ -0,0 +1,555 @@
+/*
+ * Copyright 2006-2007 Andrew De Ponte
+ *
+ * This file is part of lib_gnut.
+ *
+ * lib_gnut is the intellectual property of Andrew De Ponte; any
+ * distribution and/or modification and/or reproductions of any portion
+ * of lib_gnut MUST be approved by Andrew De Ponte.
+ *
+ * lib_gnut is distributed WITHOUT ANY WARRANTY; without even the
+ * implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE.
+ */
+
+/**
+ * @file gnut_evloop.c
+ * @brief This is an implementation file for the event loop.
+ *
+ * The gnut_evloop.c file is an implementation file that defines the
+ * gnut_evloop_t type and its associated functions.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdlib.h> /* calloc(), realloc(), free() */
+#include <string.h> /* memset() */
+#include <time.h> /* clock_gettime() */
+#include <unistd.h> /* read(), write(), close(), pipe() */
+#include <fcntl.h> /* fcntl() */
+#include <errno.h> /* errno, EINTR */
+
+#ifdef HAVE_SYS_EPOLL_H
+#include <sys/epoll.h>
+#else
+#include <sys/select.h>
+#endif
+#ifdef HAVE_SYS_EVENTFD_H
+#include <sys/eventfd.h>
+#endif
+
+#include "gnut_evloop.h"
+#include "gnut_atomic.h"
+
+#define MAX_EVENTS 256
+#define EV_IN_USE 0x100 /* Marks a handler slot as in use */
+
+typedef struct handler {
+    gnut_io_cb_t cb;
+    void *arg;
+    int events;                 /* 0 when the slot is unused */
+} handler_t;
+
+struct gnut_evloop {
+    handler_t *handlers;        /* Indexed by socket descriptor */
+    int num_handlers;
+#ifdef HAVE_SYS_EPOLL_H
+    int epfd;
+#else
+    int max_sd;
+#endif
+    int wake_rd;
+    int wake_wr;
+    int wake_pending;
+    int stopped;
+    gnut_uint64_t now;
+    gnut_timer_t **heap;
+    sxs_int32_t heap_len;
+    sxs_int32_t heap_cap;
+    gnut_loop_cb_t wakeup_cb;
+    void *wakeup_arg;
+    gnut_loop_cb_t prepare_cb;
+    void *prepare_arg;
+};
+
+gnut_uint64_t gnut_time_us(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ((gnut_uint64_t)ts.tv_sec * 1000000) + (ts.tv_nsec / 1000);
+}
+
+static void _gnut_evloop_heap_swap(gnut_evloop_t *loop, sxs_int32_t a,
+    sxs_int32_t b) {
+
+    gnut_timer_t *tmp;
+
+    tmp = loop->heap[a];
+    loop->heap[a] = loop->heap[b];
+    loop->heap[b] = tmp;
+    loop->heap[a]->heap_idx = a;
+    loop->heap[b]->heap_idx = b;
+}
+
+static void _gnut_evloop_heap_up(gnut_evloop_t *loop, sxs_int32_t i) {
+    sxs_int32_t parent;
+
+    while (i > 0) {
+        parent = (i - 1) / 2;
+        if (loop->heap[parent]->when <= loop->heap[i]->when) {
+            break;
+        }
+        _gnut_evloop_heap_swap(loop, i, parent);
+        i = parent;
+    }
+}
+
+static void _gnut_evloop_heap_down(gnut_evloop_t *loop, sxs_int32_t i) {
+    sxs_int32_t child;
+
+    for (;;) {
+        child = (2 * i) + 1;
+        if (child >= loop->heap_len) {
+            break;
+        }
+        if (child + 1 < loop->heap_len &&
+            loop->heap[child + 1]->when < loop->heap[child]->when) {
+            child++;
+        }
+        if (loop->heap[i]->when <= loop->heap[child]->when) {
+            break;
+        }
+        _gnut_evloop_heap_swap(loop, i, child);
+        i = child;
+    }
+}
+
+static void _gnut_evloop_wake_cb(gnut_evloop_t *loop, sxs_socket_t sd,
+    int events, void *arg) {
+
+    unsigned char buf[64];
+
+    while (read(loop->wake_rd, buf, sizeof(buf)) > 0) {
+        /* drain */
+    }
+
+    /* Clear the flag before running the callback so that a wakeup
+     * racing with the callback is never lost. */
+    GNUT_ATOMIC_XCHG(&loop->wake_pending, 0);
+
+    if (loop->wakeup_cb != NULL) {
+        loop->wakeup_cb(loop, loop->wakeup_arg);
+    }
+}
+
+static gnut_error_t _gnut_evloop_grow(gnut_evloop_t *loop, int sd) {
+    handler_t *tmp;
+    int num;
+
+    if (sd < loop->num_handlers) {
+        return GNUT_SUCCESS;
+    }
+
+    num = (loop->num_handlers > 0) ? loop->num_handlers : 64;
+    while (num <= sd) {
+        num *= 2;
+    }
+    tmp = (handler_t *)realloc(loop->handlers, num * sizeof(handler_t));
+    if (tmp == NULL) {
+        return GNUT_ENOMEM;
+    }
+    memset(tmp + loop->num_handlers, 0,
+        (num - loop->num_handlers) * sizeof(handler_t));
+    loop->handlers = tmp;
+    loop->num_handlers = num;
+
+    return GNUT_SUCCESS;
+}
+
+gnut_error_t gnut_evloop_new(gnut_evloop_t **pp_loop) {
+    gnut_evloop_t *loop;
+#ifndef HAVE_SYS_EVENTFD_H
+    int fds[2];
+#endif
+
+    loop = (gnut_evloop_t *)calloc(1, sizeof(gnut_evloop_t));
+    if (loop == NULL) {
+        return GNUT_ENOMEM;
+    }
+    loop->wake_rd = loop->wake_wr = -1;
+
+#ifdef HAVE_SYS_EPOLL_H
+    loop->epfd = epoll_create1(EPOLL_CLOEXEC);
+    if (loop->epfd < 0) {
+        free(loop);
+        return GNUT_EEVLOOP;
+    }
+#else
+    loop->max_sd = -1;
+#endif
+
+#ifdef HAVE_SYS_EVENTFD_H
+    loop->wake_rd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    loop->wake_wr = loop->wake_rd;
+    if (loop->wake_rd < 0) {
+        gnut_evloop_free(loop);
+        return GNUT_EEVLOOP;
+    }
+#else
+    if (pipe(fds) != 0) {
+        gnut_evloop_free(loop);
+        return GNUT_EEVLOOP;
+    }
+    loop->wake_rd = fds[0];
+    loop->wake_wr = fds[1];
+    fcntl(fds[0], F_SETFL, fcntl(fds[0], F_GETFL) | O_NONBLOCK);
+    fcntl(fds[1], F_SETFL, fcntl(fds[1], F_GETFL) | O_NONBLOCK);
+#endif
+
+    if (gnut_evloop_add(loop, loop->wake_rd, GNUT_EV_READ,
+        _gnut_evloop_wake_cb, NULL) != GNUT_SUCCESS) {
+        gnut_evloop_free(loop);
+        return GNUT_EEVLOOP;
+    }
+
+    loop->now = gnut_time_us();
+    *pp_loop = loop;
+
+    return GNUT_SUCCESS;
+}
+
+void gnut_evloop_free(gnut_evloop_t *loop) {
+#ifdef HAVE_SYS_EPOLL_H
+    if (loop->epfd >= 0) {
+        close(loop->epfd);
+    }
+#endif
+    if (loop->wake_rd >= 0) {
+        close(loop->wake_rd);
+    }
+    if (loop->wake_wr >= 0 && loop->wake_wr != loop->wake_rd) {
+        close(loop->wake_wr);
+    }
+    free(loop->handlers);
+    free(loop->heap);
+    free(loop);
+}
+
+#ifdef HAVE_SYS_EPOLL_H
+static sxs_uint32_t _gnut_evloop_to_epoll(int events) {
+    sxs_uint32_t ev;
+
+    ev = 0;
+    if (events & GNUT_EV_READ) {
+        ev |= EPOLLIN;
+    }
+    if (events & GNUT_EV_WRITE) {
+        ev |= EPOLLOUT;
+    }
+    return ev;
+}
+#endif
+
+gnut_error_t gnut_evloop_add(gnut_evloop_t *loop, sxs_socket_t sd,
+    int events, gnut_io_cb_t cb, void *arg) {
+
+#ifdef HAVE_SYS_EPOLL_H
+    struct epoll_event ev;
+#endif
+
+    if (_gnut_evloop_grow(loop, sd) != GNUT_SUCCESS) {
+        return GNUT_ENOMEM;
+    }
+
+#ifdef HAVE_SYS_EPOLL_H
+    memset(&ev, 0, sizeof(ev));
+    ev.events = _gnut_evloop_to_epoll(events);
+    ev.data.fd = sd;
+    if (epoll_ctl(loop->epfd, EPOLL_CTL_ADD, sd, &ev) != 0) {
+        return GNUT_EEVLOOP;
+    }
+#else
+    if (sd >= FD_SETSIZE) {
+        return GNUT_EEVLOOP;
+    }
+    if (sd > loop->max_sd) {
+        loop->max_sd = sd;
+    }
+#endif
+
+    loop->handlers[sd].cb = cb;
+    loop->handlers[sd].arg = arg;
+    loop->handlers[sd].events = events | EV_IN_USE;
+
+    return GNUT_SUCCESS;
+}
+
+gnut_error_t gnut_evloop_mod(gnut_evloop_t *loop, sxs_socket_t sd,
+    int events) {
+
+#ifdef HAVE_SYS_EPOLL_H
+    struct epoll_event ev;
+#endif
+
+    if (sd >= loop->num_handlers || loop->handlers[sd].events == 0) {
+        return GNUT_EEVLOOP;
+    }
+    if ((loop->handlers[sd].events & ~EV_IN_USE) == events) {
+        return GNUT_SUCCESS;
+    }
+
+#ifdef HAVE_SYS_EPOLL_H
+    memset(&ev, 0, sizeof(ev));
+    ev.events = _gnut_evloop_to_epoll(events);
+    ev.data.fd = sd;
+    if (epoll_ctl(loop->epfd, EPOLL_CTL_MOD, sd, &ev) != 0) {
+        return GNUT_EEVLOOP;
+    }
+#endif
+
+    loop->handlers[sd].events = events | EV_IN_USE;
+
+    return GNUT_SUCCESS;
+}
+
+void gnut_evloop_del(gnut_evloop_t *loop, sxs_socket_t sd) {
+#ifdef HAVE_SYS_EPOLL_H
+    struct epoll_event ev;
+#endif
+
+    if (sd >= loop->num_handlers || loop->handlers[sd].events == 0) {
+        return;
+    }
+
+#ifdef HAVE_SYS_EPOLL_H
+    memset(&ev, 0, sizeof(ev));
+    epoll_ctl(loop->epfd, EPOLL_CTL_DEL, sd, &ev);
+#endif
+
+    loop->handlers[sd].events = 0;
+    loop->handlers[sd].cb = NULL;
+    loop->handlers[sd].arg = NULL;
+}
+
+void gnut_timer_init(gnut_timer_t *t) {
+    t->heap_idx = -1;
+}
+
+gnut_error_t gnut_evloop_timer_start(gnut_evloop_t *loop, gnut_timer_t *t,
+    gnut_uint64_t delay_us, gnut_loop_cb_t cb, void *arg) {
+
+    gnut_timer_t **tmp;
+    sxs_int32_t cap;
+
+    t->when = loop->now + delay_us;
+    t->cb = cb;
+    t->arg = arg;
+
+    if (t->heap_idx >= 0) {
+        _gnut_evloop_heap_up(loop, t->heap_idx);
+        _gnut_evloop_heap_down(loop, t->heap_idx);
+        return GNUT_SUCCESS;
+    }
+
+    if (loop->heap_len == loop->heap_cap) {
+        cap = (loop->heap_cap > 0) ? loop->heap_cap * 2 : 64;
+        tmp = (gnut_timer_t **)realloc(loop->heap,
+            cap * sizeof(gnut_timer_t *));
+        if (tmp == NULL) {
+            return GNUT_ENOMEM;
+        }
+        loop->heap = tmp;
+        loop->heap_cap = cap;
+    }
+
+    t->heap_idx = loop->heap_len;
+    loop->heap[loop->heap_len++] = t;
+    _gnut_evloop_heap_up(loop, t->heap_idx);
+
+    return GNUT_SUCCESS;
+}
+
+void gnut_evloop_timer_stop(gnut_evloop_t *loop, gnut_timer_t *t) {
+    sxs_int32_t i;
+
+    if (t->heap_idx < 0) {
+        return;
+    }
+
+    i = t->heap_idx;
+    loop->heap_len--;
+    if (i != loop->heap_len) {
+        _gnut_evloop_heap_swap(loop, i, loop->heap_len);
+        _gnut_evloop_heap_up(loop, i);
+        _gnut_evloop_heap_down(loop, i);
+    }
+    t->heap_idx = -1;
+}
+
+gnut_uint64_t gnut_evloop_now(const gnut_evloop_t *loop) {
+    return loop->now;
+}
+
+void gnut_evloop_set_wakeup_cb(gnut_evloop_t *loop, gnut_loop_cb_t cb,
+    void *arg) {
+
+    loop->wakeup_cb = cb;
+    loop->wakeup_arg = arg;
+}
+
+void gnut_evloop_set_prepare_cb(gnut_evloop_t *loop, gnut_loop_cb_t cb,
+    void *arg) {
+
+    loop->prepare_cb = cb;
+    loop->prepare_arg = arg;
+}
+
+void gnut_evloop_wakeup(gnut_evloop_t *loop) {
+#ifdef HAVE_SYS_EVENTFD_H
+    gnut_uint64_t one = 1;
+#else
+    unsigned char one = 1;
+#endif
+
+    /* Only the first wakeup since the loop last woke pays for the
+     * system call. */
+    if (GNUT_ATOMIC_XCHG(&loop->wake_pending, 1) == 0) {
+        if (write(loop->wake_wr, &one, sizeof(one)) < 0) {
+            /* The channel is full, so the loop is waking anyway. */
+        }
+    }
+}
+
+static void _gnut_evloop_run_timers(gnut_evloop_t *loop) {
+    gnut_timer_t *t;
+    sxs_int32_t budget;
+
+    /* Bound the pass by the timers pending on entry, so that a timer
+     * re-armed with no delay from its own callback waits for the next
+     * iteration instead of starving I/O. */
+    budget = loop->heap_len;
+    while (budget-- > 0 && loop->heap_len > 0 &&
+        loop->heap[0]->when <= loop->now) {
+        t = loop->heap[0];
+        gnut_evloop_timer_stop(loop, t);
+        t->cb(loop, t->arg);
+    }
+}
+
+static void _gnut_evloop_dispatch(gnut_evloop_t *loop, int sd, int events) {
+    handler_t *h;
+
+    if (sd >= loop->num_handlers) {
+        return;
+    }
+    h = &loop->handlers[sd];
+    if (h->events == 0 || h->cb == NULL) {
+        return;
+    }
+    h->cb(loop, sd, events, h->arg);
+}
+
+gnut_error_t gnut_evloop_run_once(gnut_evloop_t *loop,
+    gnut_uint64_t timeout_us) {
+
+#ifdef HAVE_SYS_EPOLL_H
+    struct epoll_event evs[MAX_EVENTS];
+    int timeout_ms, n, i, events;
+#else
+    fd_set rfds, wfds;
+    struct timeval tv;
+    int sd, n, events;
+#endif
+
+    if (loop->prepare_cb != NULL) {
+        loop->prepare_cb(loop, loop->prepare_arg);
+    }
+
+    loop->now = gnut_time_us();
+    if (loop->heap_len > 0) {
+        if (loop->heap[0]->when <= loop->now) {
+            timeout_us = 0;
+        } else if (loop->heap[0]->when - loop->now < timeout_us) {
+            timeout_us = loop->heap[0]->when - loop->now;
+        }
+    }
+
+#ifdef HAVE_SYS_EPOLL_H
+    /* Round up so that a timer is never woken for just before it is
+     * due. */
+    timeout_ms = (int)((timeout_us + 999) / 1000);
+    n = epoll_wait(loop->epfd, evs, MAX_EVENTS, timeout_ms);
+    if (n < 0 && errno != EINTR) {
+        return GNUT_EEVLOOP;
+    }
+    loop->now = gnut_time_us();
+    for (i = 0; i < n; i++) {
+        events = 0;
+        if (evs[i].events & EPOLLIN) {
+            events |= GNUT_EV_READ;
+        }
+        if (evs[i].events & EPOLLOUT) {
+            events |= GNUT_EV_WRITE;
+        }
+        if (evs[i].events & (EPOLLERR | EPOLLHUP)) {
+            events |= GNUT_EV_ERROR;
+        }
+        _gnut_evloop_dispatch(loop, evs[i].data.fd, events);
+    }
+#else
+    FD_ZERO(&rfds);
+    FD_ZERO(&wfds);
+    for (sd = 0; sd <= loop->max_sd; sd++) {
+        if (loop->handlers[sd].events & GNUT_EV_READ) {
+            FD_SET(sd, &rfds);
+        }
+        if (loop->handlers[sd].events & GNUT_EV_WRITE) {
+            FD_SET(sd, &wfds);
+        }
+    }
+    tv.tv_sec = timeout_us / 1000000;
+    tv.tv_usec = timeout_us % 1000000;
+    if (sxs_select(loop->max_sd + 1, &rfds, &wfds, NULL, &tv, &n) !=
+        SXS_SUCCESS) {
+        n = 0;
+    }
+    loop->now = gnut_time_us();
+    for (sd = 0; n > 0 && sd <= loop->max_sd; sd++) {
+        events = 0;
+        if (FD_ISSET(sd, &rfds)) {
+            events |= GNUT_EV_READ;
+        }
+        if (FD_ISSET(sd, &wfds)) {
+            events |= GNUT_EV_WRITE;
+        }
+        if (events != 0) {
+            n--;
+            _gnut_evloop_dispatch(loop, sd, events);
+        }
+    }
+#endif
+
+    _gnut_evloop_run_timers(loop);
+
+    return GNUT_SUCCESS;
+}
+
+gnut_error_t gnut_evloop_run(gnut_evloop_t *loop) {
+    gnut_error_t reterr;
+
+    while (!GNUT_ATOMIC_LOAD_ACQ(&loop->stopped)) {
+        reterr = gnut_evloop_run_once(loop, 1000000);
+        if (reterr != GNUT_SUCCESS) {
+            return reterr;
+        }
+    }
+
+    return GNUT_SUCCESS;
+}
+
+void gnut_evloop_stop(gnut_evloop_t *loop) {
+    GNUT_ATOMIC_STORE_REL(&loop->stopped, 1);
+    gnut_evloop_wakeup(loop);
+}
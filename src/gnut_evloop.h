@@ -0,0 +1,277 @@
+/*
+ * Copyright 2006-2007 Andrew De Ponte
+ *
+ * This file is part of lib_gnut.
+ *
+ * lib_gnut is the intellectual property of Andrew De Ponte; any
+ * distribution and/or modification and/or reproductions of any portion
+ * of lib_gnut MUST be approved by Andrew De Ponte.
+ *
+ * lib_gnut is distributed WITHOUT ANY WARRANTY; without even the
+ * implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE.
+ */
+
+/**
+ * @file gnut_evloop.h
+ * @brief This is a specifications file for the event loop.
+ *
+ * The gnut_evloop.h file is a specifications file that declares the
+ * gnut_evloop_t type and its associated functions. An event loop
+ * watches sockets for readiness, runs timers, and can be woken up from
+ * other threads. It uses epoll where available and select() otherwise.
+ * An event loop is owned by a single thread; only gnut_evloop_wakeup()
+ * and gnut_evloop_stop() may be called from other threads.
+ */
+
+#ifndef GNUT_EVLOOP_H
+#define GNUT_EVLOOP_H
+
+#include <sxs/sxs.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+#include "gnut_export.h"
+#include "gnut_types.h"
+#include "gnut_error.h"
+
+#define GNUT_EV_READ 0x01 /**< Socket is readable */
+#define GNUT_EV_WRITE 0x02 /**< Socket is writable */
+#define GNUT_EV_ERROR 0x04 /**< Socket has an error or hang up */
+
+/**
+ * An Event Loop
+ *
+ * The gnut_evloop_t is an opaque type which represents an event loop.
+ */
+typedef struct gnut_evloop gnut_evloop_t;
+
+/**
+ * A Socket Event Callback
+ *
+ * The gnut_io_cb_t is the type of function called when a watched
+ * socket becomes ready. 'events' is a mask of GNUT_EV_* values.
+ */
+typedef void (*gnut_io_cb_t)(gnut_evloop_t *loop, sxs_socket_t sd,
+    int events, void *arg);
+
+/**
+ * A Loop Callback
+ *
+ * The gnut_loop_cb_t is the type of function called for timers, for
+ * wakeups, and before the loop blocks waiting for events.
+ */
+typedef void (*gnut_loop_cb_t)(gnut_evloop_t *loop, void *arg);
+
+/**
+ * A Timer
+ *
+ * The gnut_timer_t is a type which represents a one-shot timer. It is
+ * embedded in the caller's own structures so that arming a timer never
+ * allocates; its fields are private to the event loop.
+ */
+typedef struct GNUT_EXPORT gnut_timer {
+    gnut_uint64_t when;         /* Expiry time in microseconds */
+    gnut_loop_cb_t cb;
+    void *arg;
+    sxs_int32_t heap_idx;       /* Position in the timer heap, or -1 */
+} gnut_timer_t;
+
+/**
+ * Create an Event Loop
+ *
+ * The gnut_evloop_new() function creates a new event loop.
+ * @param pp_loop Pointer to store the pointer to the new loop in.
+ * @return A value representing an error or success.
+ * @retval GNUT_SUCCESS Successfully created the loop.
+ * @retval GNUT_ENOMEM Failed to allocate memory.
+ * @retval GNUT_EEVLOOP Failed to create the poller or wakeup channel.
+ */
+GNUT_EXPORT gnut_error_t gnut_evloop_new(gnut_evloop_t **pp_loop);
+
+/**
+ * Free an Event Loop
+ *
+ * The gnut_evloop_free() function frees the loop. Watched sockets are
+ * not closed.
+ * @param loop Pointer to the loop to free.
+ */
+GNUT_EXPORT void gnut_evloop_free(gnut_evloop_t *loop);
+
+/**
+ * Watch a Socket
+ *
+ * The gnut_evloop_add() function starts watching 'sd' for the events in
+ * 'events' and calls 'cb' when any of them occur.
+ * @param loop Pointer to the loop.
+ * @param sd The socket to watch.
+ * @param events A mask of GNUT_EV_READ and GNUT_EV_WRITE.
+ * @param cb The function to call when the socket is ready.
+ * @param arg The argument to pass to 'cb'.
+ * @return A value representing an error or success.
+ * @retval GNUT_SUCCESS Successfully started watching the socket.
+ * @retval GNUT_ENOMEM Failed to allocate memory.
+ * @retval GNUT_EEVLOOP The poller rejected the socket.
+ */
+GNUT_EXPORT gnut_error_t gnut_evloop_add(gnut_evloop_t *loop,
+    sxs_socket_t sd, int events, gnut_io_cb_t cb, void *arg);
+
+/**
+ * Change the Events Watched on a Socket
+ *
+ * The gnut_evloop_mod() function replaces the event mask of a socket
+ * that is already being watched.
+ * @param loop Pointer to the loop.
+ * @param sd The socket being watched.
+ * @param events A mask of GNUT_EV_READ and GNUT_EV_WRITE.
+ * @return A value representing an error or success.
+ * @retval GNUT_SUCCESS Successfully changed the mask.
+ * @retval GNUT_EEVLOOP The socket is not watched or the poller failed.
+ */
+GNUT_EXPORT gnut_error_t gnut_evloop_mod(gnut_evloop_t *loop,
+    sxs_socket_t sd, int events);
+
+/**
+ * Stop Watching a Socket
+ *
+ * The gnut_evloop_del() function stops watching 'sd'. It must be called
+ * before the socket is closed.
+ * @param loop Pointer to the loop.
+ * @param sd The socket being watched.
+ */
+GNUT_EXPORT void gnut_evloop_del(gnut_evloop_t *loop, sxs_socket_t sd);
+
+/**
+ * Start a Timer
+ *
+ * The gnut_evloop_timer_start() function arms the timer 't' to call
+ * 'cb' once 'delay_us' microseconds from now. Starting a timer that is
+ * already armed re-arms it.
+ * @param loop Pointer to the loop.
+ * @param t Pointer to the timer.
+ * @param delay_us The delay in microseconds.
+ * @param cb The function to call when the timer expires.
+ * @param arg The argument to pass to 'cb'.
+ * @return A value representing an error or success.
+ * @retval GNUT_SUCCESS Successfully armed the timer.
+ * @retval GNUT_ENOMEM Failed to grow the timer heap.
+ */
+GNUT_EXPORT gnut_error_t gnut_evloop_timer_start(gnut_evloop_t *loop,
+    gnut_timer_t *t, gnut_uint64_t delay_us, gnut_loop_cb_t cb, void *arg);
+
+/**
+ * Stop a Timer
+ *
+ * The gnut_evloop_timer_stop() function disarms the timer 't' if it is
+ * armed.
+ * @param loop Pointer to the loop.
+ * @param t Pointer to the timer.
+ */
+GNUT_EXPORT void gnut_evloop_timer_stop(gnut_evloop_t *loop,
+    gnut_timer_t *t);
+
+/**
+ * Initialize a Timer
+ *
+ * The gnut_timer_init() function marks the timer 't' as not armed. It
+ * must be called before a timer is first used.
+ * @param t Pointer to the timer.
+ */
+GNUT_EXPORT void gnut_timer_init(gnut_timer_t *t);
+
+/**
+ * Get the Loop Time
+ *
+ * The gnut_evloop_now() function returns the monotonic time in
+ * microseconds, as sampled at the start of the current loop iteration.
+ * @param loop Pointer to the loop.
+ * @return The loop time in microseconds.
+ */
+GNUT_EXPORT gnut_uint64_t gnut_evloop_now(const gnut_evloop_t *loop);
+
+/**
+ * Get the Monotonic Time
+ *
+ * The gnut_time_us() function samples the monotonic clock.
+ * @return The monotonic time in microseconds.
+ */
+GNUT_EXPORT gnut_uint64_t gnut_time_us(void);
+
+/**
+ * Set the Wakeup Callback
+ *
+ * The gnut_evloop_set_wakeup_cb() function sets the function that is
+ * called on the loop's thread after gnut_evloop_wakeup() was called.
+ * Several wakeups may be coalesced into one call.
+ * @param loop Pointer to the loop.
+ * @param cb The function to call, or NULL.
+ * @param arg The argument to pass to 'cb'.
+ */
+GNUT_EXPORT void gnut_evloop_set_wakeup_cb(gnut_evloop_t *loop,
+    gnut_loop_cb_t cb, void *arg);
+
+/**
+ * Set the Prepare Callback
+ *
+ * The gnut_evloop_set_prepare_cb() function sets the function that is
+ * called every time the loop is about to block waiting for events. It
+ * is the place to flush work batched up during the iteration.
+ * @param loop Pointer to the loop.
+ * @param cb The function to call, or NULL.
+ * @param arg The argument to pass to 'cb'.
+ */
+GNUT_EXPORT void gnut_evloop_set_prepare_cb(gnut_evloop_t *loop,
+    gnut_loop_cb_t cb, void *arg);
+
+/**
+ * Wake up an Event Loop
+ *
+ * The gnut_evloop_wakeup() function makes the loop return from waiting
+ * and call its wakeup callback. It may be called from any thread.
+ * @param loop Pointer to the loop.
+ */
+GNUT_EXPORT void gnut_evloop_wakeup(gnut_evloop_t *loop);
+
+/**
+ * Run an Event Loop
+ *
+ * The gnut_evloop_run() function dispatches events and timers until
+ * gnut_evloop_stop() is called.
+ * @param loop Pointer to the loop.
+ * @return A value representing an error or success.
+ * @retval GNUT_SUCCESS The loop was stopped.
+ * @retval GNUT_EEVLOOP Waiting for events failed.
+ */
+GNUT_EXPORT gnut_error_t gnut_evloop_run(gnut_evloop_t *loop);
+
+/**
+ * Run One Iteration of an Event Loop
+ *
+ * The gnut_evloop_run_once() function waits at most 'timeout_us'
+ * microseconds for events, dispatches them and any expired timers,
+ * then returns.
+ * @param loop Pointer to the loop.
+ * @param timeout_us The maximum time to wait in microseconds.
+ * @return A value representing an error or success.
+ * @retval GNUT_SUCCESS Successfully ran one iteration.
+ * @retval GNUT_EEVLOOP Waiting for events failed.
+ */
+GNUT_EXPORT gnut_error_t gnut_evloop_run_once(gnut_evloop_t *loop,
+    gnut_uint64_t timeout_us);
+
+/**
+ * Stop an Event Loop
+ *
+ * The gnut_evloop_stop() function makes gnut_evloop_run() return after
+ * the current iteration. It may be called from any thread.
+ * @param loop Pointer to the loop.
+ */
+GNUT_EXPORT void gnut_evloop_stop(gnut_evloop_t *loop);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* GNUT_EVLOOP_H */
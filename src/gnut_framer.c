@@ -0,0 +1,151 @@
+/*
+ * Copyright 2006-2007 Andrew De Ponte
+ *
+ * This file is part of lib_gnut.
+ *
+ * lib_gnut is the intellectual property of Andrew De Ponte; any
+ * distribution and/or modification and/or reproductions of any portion
+ * of lib_gnut MUST be approved by Andrew De Ponte.
+ *
+ * lib_gnut is distributed WITHOUT ANY WARRANTY; without even the
+ * implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE.
+ */
+
+/**
+ * @file gnut_framer.c
+ * @brief This is an implementation file for the message framer.
+ *
+ * The gnut_framer.c file is an implementation file that defines the
+ * gnut_framer_t type's associated functions.
+ */
+
+#include <stdlib.h> /* realloc(), free() */
+#include <string.h> /* memset(), memcpy() */
+
+#include "gnut_framer.h"
+
+#define FRAMER_MIN_CAP 1024
+
+void gnut_framer_init(gnut_framer_t *f, sxs_uint32_t max_pl_len) {
+    memset(f, 0, sizeof(gnut_framer_t));
+    f->max_pl_len = (max_pl_len > 0) ? max_pl_len :
+        GNUT_FRAMER_DEF_MAX_PL_LEN;
+}
+
+void gnut_framer_destroy(gnut_framer_t *f) {
+    free(f->buf);
+    f->buf = NULL;
+    f->cap = 0;
+    f->len = 0;
+}
+
+static gnut_error_t _gnut_framer_reserve(gnut_framer_t *f,
+    sxs_uint32_t need) {
+
+    unsigned char *buf;
+    sxs_uint32_t cap;
+
+    if (need <= f->cap) {
+        return GNUT_SUCCESS;
+    }
+    cap = (f->cap > 0) ? f->cap : FRAMER_MIN_CAP;
+    while (cap < need) {
+        cap *= 2;
+    }
+    buf = (unsigned char *)realloc(f->buf, cap);
+    if (buf == NULL) {
+        return GNUT_ENOMEM;
+    }
+    f->buf = buf;
+    f->cap = cap;
+
+    return GNUT_SUCCESS;
+}
+
+/* Moves bytes into the buffered message until it is whole or the input
+ * runs out, then hands it out if it is whole. */
+static gnut_error_t _gnut_framer_buffer(gnut_framer_t *f,
+    const unsigned char **p_data, sxs_uint32_t *p_len, gnut_framer_cb_t cb,
+    void *arg) {
+
+    sxs_uint32_t want, n;
+
+    for (;;) {
+        if (f->len < GNUT_MSG_HDR_LEN) {
+            want = GNUT_MSG_HDR_LEN;
+        } else {
+            want = GNUT_MSG_HDR_LEN + f->hdr.pl_len;
+        }
+        if (_gnut_framer_reserve(f, want) != GNUT_SUCCESS) {
+            return GNUT_ENOMEM;
+        }
+        n = want - f->len;
+        if (n > *p_len) {
+            n = *p_len;
+        }
+        memcpy((void *)(f->buf + f->len), (const void *)*p_data, n);
+        f->len += n;
+        f->copied += n;
+        *p_data += n;
+        *p_len -= n;
+        if (f->len < want) {
+            return GNUT_SUCCESS;
+        }
+
+        if (want == GNUT_MSG_HDR_LEN) {
+            gnut_decode_msg_hdr(f->buf, &f->hdr);
+            if (f->hdr.pl_len > f->max_pl_len) {
+                f->failed = 1;
+                return GNUT_EFRAME;
+            }
+            if (f->hdr.pl_len > 0) {
+                continue;
+            }
+        }
+
+        f->len = 0;
+        f->msgs++;
+        cb(&f->hdr, f->buf, f->buf + GNUT_MSG_HDR_LEN, arg);
+        return GNUT_SUCCESS;
+    }
+}
+
+gnut_error_t gnut_framer_feed(gnut_framer_t *f, const unsigned char *data,
+    sxs_uint32_t len, gnut_framer_cb_t cb, void *arg) {
+
+    gnut_msg_hdr_t hdr;
+    gnut_error_t err;
+
+    if (f->failed) {
+        return GNUT_EFRAME;
+    }
+
+    if (f->len > 0) {
+        err = _gnut_framer_buffer(f, &data, &len, cb, arg);
+        if (err != GNUT_SUCCESS || f->len > 0) {
+            return err;
+        }
+    }
+
+    while (len >= GNUT_MSG_HDR_LEN) {
+        gnut_decode_msg_hdr(data, &hdr);
+        if (hdr.pl_len > f->max_pl_len) {
+            f->failed = 1;
+            return GNUT_EFRAME;
+        }
+        if (len - GNUT_MSG_HDR_LEN < hdr.pl_len) {
+            break;
+        }
+        f->msgs++;
+        cb(&hdr, data, data + GNUT_MSG_HDR_LEN, arg);
+        data += GNUT_MSG_HDR_LEN + hdr.pl_len;
+        len -= GNUT_MSG_HDR_LEN + hdr.pl_len;
+    }
+
+    if (len > 0) {
+        return _gnut_framer_buffer(f, &data, &len, cb, arg);
+    }
+
+    return GNUT_SUCCESS;
+}
@@ -0,0 +1,110 @@
+/*
+ * Copyright 2006-2007 Andrew De Ponte
+ *
+ * This file is part of lib_gnut.
+ *
+ * lib_gnut is the intellectual property of Andrew De Ponte; any
+ * distribution and/or modification and/or reproductions of any portion
+ * of lib_gnut MUST be approved by Andrew De Ponte.
+ *
+ * lib_gnut is distributed WITHOUT ANY WARRANTY; without even the
+ * implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE.
+ */
+
+/**
+ * @file gnut_framer.h
+ * @brief This is a specifications file for the message framer.
+ *
+ * The gnut_framer.h file is a specifications file that declares the
+ * gnut_framer_t type and its associated functions. A framer splits the
+ * byte stream received on a connection into whole messages. Messages
+ * which arrive whole are handed out in place; only a message split
+ * across reads is copied, into a buffer the framer keeps.
+ */
+
+#ifndef GNUT_FRAMER_H
+#define GNUT_FRAMER_H
+
+#include <sxs/sxs.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+#include "gnut_export.h"
+#include "gnut_types.h"
+#include "gnut_error.h"
+#include "gnut_msgs.h"
+
+#define GNUT_FRAMER_DEF_MAX_PL_LEN 65536 /**< Default max payload length */
+
+/**
+ * A Framer Message Callback
+ *
+ * The gnut_framer_cb_t is the type of function called with each whole
+ * message. 'raw' points to the GNUT_MSG_HDR_LEN + hdr->pl_len bytes of
+ * the encoded message, of which 'payload' is the tail. Both are only
+ * valid during the call.
+ */
+typedef void (*gnut_framer_cb_t)(const gnut_msg_hdr_t *hdr,
+    const unsigned char *raw, const unsigned char *payload, void *arg);
+
+/**
+ * A Framer
+ *
+ * The gnut_framer_t is a type which represents the framing state of
+ * one connection's input.
+ */
+typedef struct GNUT_EXPORT gnut_framer {
+    unsigned char *buf;         /* A message split across reads */
+    sxs_uint32_t cap;
+    sxs_uint32_t len;           /* Bytes of it buffered so far */
+    gnut_msg_hdr_t hdr;         /* Its header, once len reaches it */
+    sxs_uint32_t max_pl_len;
+    int failed;                 /* Set once a message could not be framed */
+    gnut_uint64_t msgs;         /* Messages framed */
+    gnut_uint64_t copied;       /* Bytes that had to be buffered */
+} gnut_framer_t;
+
+/**
+ * Initialize a Framer
+ *
+ * @param f Pointer to the framer to initialize.
+ * @param max_pl_len Longest payload accepted, or 0 for the default.
+ */
+GNUT_EXPORT void gnut_framer_init(gnut_framer_t *f, sxs_uint32_t max_pl_len);
+
+/**
+ * Destroy a Framer
+ *
+ * @param f Pointer to the framer.
+ */
+GNUT_EXPORT void gnut_framer_destroy(gnut_framer_t *f);
+
+/**
+ * Feed Bytes to a Framer
+ *
+ * The gnut_framer_feed() function calls 'cb' for each message that the
+ * 'len' bytes at 'data' complete, and keeps any trailing partial
+ * message for the next call. A payload longer than the limit means the
+ * stream cannot be resynchronized, so the framer fails from then on.
+ * @param f Pointer to the framer.
+ * @param data Pointer to the bytes received.
+ * @param len The number of bytes received.
+ * @param cb The function to call with each message.
+ * @param arg Passed to 'cb'.
+ * @return A value representing an error or success.
+ * @retval GNUT_SUCCESS Successfully consumed the bytes.
+ * @retval GNUT_EFRAME A payload exceeded the limit.
+ * @retval GNUT_ENOMEM Failed to grow the buffer.
+ */
+GNUT_EXPORT gnut_error_t gnut_framer_feed(gnut_framer_t *f,
+    const unsigned char *data, sxs_uint32_t len, gnut_framer_cb_t cb,
+    void *arg);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* GNUT_FRAMER_H */
@@ -0,0 +1,87 @@
+/*
+ * Copyright 2006-2007 Andrew De Ponte
+ *
+ * This file is part of lib_gnut.
+ *
+ * lib_gnut is the intellectual property of Andrew De Ponte; any
+ * distribution and/or modification and/or reproductions of any portion
+ * of lib_gnut MUST be approved by Andrew De Ponte.
+ *
+ * lib_gnut is distributed WITHOUT ANY WARRANTY; without even the
+ * implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE.
+ */
+
+/**
+ * @file gnut_guid.c
+ * @brief This is an implementation file for the GUID generator.
+ *
+ * The gnut_guid.c file is an implementation file that defines the
+ * gnut_guid_gen_t type's associated functions.
+ */
+
+#include <stdio.h> /* fopen(), fread(), fclose() */
+#include <string.h> /* memcpy() */
+#include <time.h> /* time() */
+
+#include "gnut_guid.h"
+
+/* splitmix64 turns any seed, including 0, into a well mixed state. */
+static gnut_uint64_t _gnut_guid_splitmix(gnut_uint64_t *x) {
+    gnut_uint64_t z;
+
+    *x += 0x9e3779b97f4a7c15ULL;
+    z = *x;
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+void gnut_guid_gen_seed(gnut_guid_gen_t *gen, gnut_uint64_t seed) {
+    gen->s[0] = _gnut_guid_splitmix(&seed);
+    gen->s[1] = _gnut_guid_splitmix(&seed);
+}
+
+void gnut_guid_gen_init(gnut_guid_gen_t *gen) {
+    gnut_uint64_t seed;
+    FILE *fp;
+
+    seed = 0;
+    fp = fopen("/dev/urandom", "rb");
+    if (fp != NULL) {
+        if (fread(&seed, sizeof(seed), 1, fp) != 1) {
+            seed = 0;
+        }
+        fclose(fp);
+    }
+    if (seed == 0) {
+        seed = ((gnut_uint64_t)time(NULL) << 32) ^
+            (gnut_uint64_t)getpid() ^ (gnut_uint64_t)(size_t)gen;
+    }
+
+    gnut_guid_gen_seed(gen, seed);
+}
+
+gnut_uint64_t gnut_guid_gen_next(gnut_guid_gen_t *gen) {
+    gnut_uint64_t s0, s1;
+
+    s1 = gen->s[0];
+    s0 = gen->s[1];
+    gen->s[0] = s0;
+    s1 ^= s1 << 23;
+    gen->s[1] = s1 ^ s0 ^ (s1 >> 17) ^ (s0 >> 26);
+
+    return gen->s[1] + s0;
+}
+
+void gnut_guid_gen_fill(gnut_guid_gen_t *gen, unsigned char *guid) {
+    gnut_uint64_t r;
+
+    r = gnut_guid_gen_next(gen);
+    memcpy(guid, &r, sizeof(r));
+    r = gnut_guid_gen_next(gen);
+    memcpy(guid + 8, &r, sizeof(r));
+
+    guid[8] = 0xff;
+    guid[15] = 0x00;
+}
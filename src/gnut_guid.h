@@ -0,0 +1,96 @@
+/*
+ * Copyright 2006-2007 Andrew De Ponte
+ *
+ * This file is part of lib_gnut.
+ *
+ * lib_gnut is the intellectual property of Andrew De Ponte; any
+ * distribution and/or modification and/or reproductions of any portion
+ * of lib_gnut MUST be approved by Andrew De Ponte.
+ *
+ * lib_gnut is distributed WITHOUT ANY WARRANTY; without even the
+ * implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE.
+ */
+
+/**
+ * @file gnut_guid.h
+ * @brief This is a specifications file for the GUID generator.
+ *
+ * The gnut_guid.h file is a specifications file that declares the
+ * gnut_guid_gen_t type and its associated functions. A generator holds
+ * its own random state so that each thread can build Message IDs
+ * without sharing the C library's rand() state.
+ */
+
+#ifndef GNUT_GUID_H
+#define GNUT_GUID_H
+
+#include <sxs/sxs.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+#include "gnut_export.h"
+#include "gnut_types.h"
+#include "gnut_error.h"
+
+/**
+ * A GUID Generator
+ *
+ * The gnut_guid_gen_t is a type which holds the state of a xorshift128+
+ * pseudo random number generator used to build Message IDs.
+ */
+typedef struct GNUT_EXPORT gnut_guid_gen {
+    gnut_uint64_t s[2];
+} gnut_guid_gen_t;
+
+/**
+ * Seed a GUID Generator
+ *
+ * The gnut_guid_gen_seed() function seeds the generator with 'seed'.
+ * The same seed always produces the same sequence of GUIDs, which is
+ * what reproducible simulations want.
+ * @param gen Pointer to the generator to seed.
+ * @param seed The seed value.
+ */
+GNUT_EXPORT void gnut_guid_gen_seed(gnut_guid_gen_t *gen,
+    gnut_uint64_t seed);
+
+/**
+ * Initialize a GUID Generator
+ *
+ * The gnut_guid_gen_init() function seeds the generator from the
+ * operating system's entropy source, falling back to the time, process
+ * id and the generator's own address when none is available.
+ * @param gen Pointer to the generator to initialize.
+ */
+GNUT_EXPORT void gnut_guid_gen_init(gnut_guid_gen_t *gen);
+
+/**
+ * Get the Next Random Value
+ *
+ * The gnut_guid_gen_next() function returns the next 64 bit value of
+ * the generator.
+ * @param gen Pointer to the generator.
+ * @return The next pseudo random value.
+ */
+GNUT_EXPORT gnut_uint64_t gnut_guid_gen_next(gnut_guid_gen_t *gen);
+
+/**
+ * Build a GUID
+ *
+ * The gnut_guid_gen_fill() function fills the 16 byte 'guid' with
+ * random bytes, then sets byte 8 to 0xff and byte 15 to 0x00 as
+ * described for gnut_build_msg_id().
+ * @param gen Pointer to the generator.
+ * @param guid Pointer to the 16 bytes to fill.
+ */
+GNUT_EXPORT void gnut_guid_gen_fill(gnut_guid_gen_t *gen,
+    unsigned char *guid);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* GNUT_GUID_H */
@@ -0,0 +1,377 @@
+/*
+ * Copyright 2006-2007 Andrew De Ponte
+ *
+ * This file is part of lib_gnut.
+ *
+ * lib_gnut is the intellectual property of Andrew De Ponte; any
+ * distribution and/or modification and/or reproductions of any portion
+ * of lib_gnut MUST be approved by Andrew De Ponte.
+ *
+ * lib_gnut is distributed WITHOUT ANY WARRANTY; without even the
+ * implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE.
+ */
+
+/**
+ * @file gnut_handshake.c
+ * @brief This is an implementation file for the 0.6 handshake.
+ *
+ * The gnut_handshake.c file is an implementation file that defines the
+ * functions used to parse and build the HTTP style headers exchanged
+ * during the Gnutella 0.6 three-way handshake.
+ */
+
+#include <string.h> /* memchr(), memcpy(), strlen() */
+
+#include "gnut_handshake.h"
+
+#define HS_STATE_START_LINE 0
+#define HS_STATE_HEADERS 1
+#define HS_STATE_DONE 2
+
+/* The names of the indexed headers, in GNUT_HS_HDR_* order. */
+static const struct {
+    const char *name;
+    sxs_uint16_t len;
+} known_hdrs[GNUT_HS_HDR_COUNT] = {
+    { "User-Agent", 10 },
+    { "X-Ultrapeer", 11 },
+    { "Accept-Encoding", 15 },
+    { "Content-Encoding", 16 },
+    { "X-Try-Ultrapeers", 16 }
+};
+
+/* ASCII only case folding; header names are always ASCII so there is
+ * no need to involve the locale. */
+static int _gnut_hs_ieq(const char *a, const char *b, sxs_uint32_t len) {
+    sxs_uint32_t i;
+    unsigned char ca, cb;
+
+    for (i = 0; i < len; i++) {
+        ca = (unsigned char)a[i];
+        cb = (unsigned char)b[i];
+        if (ca != cb) {
+            if ((ca | 0x20) != (cb | 0x20) || (ca | 0x20) < 'a' ||
+                (ca | 0x20) > 'z') {
+                return 0;
+            }
+        }
+    }
+    return 1;
+}
+
+static int _gnut_hs_is_ws(char c) {
+    return (c == ' ' || c == '\t' || c == '\r' || c == '\n');
+}
+
+/* Most names are rejected on length alone, so at most a couple of
+ * compares are done per header line. */
+static void _gnut_hs_classify(gnut_hs_parser_t *p, const char *buf,
+    sxs_uint16_t idx) {
+
+    const gnut_hs_hdr_t *hdr;
+    int i;
+
+    hdr = &p->hdrs[idx];
+    for (i = 0; i < GNUT_HS_HDR_COUNT; i++) {
+        if (hdr->name.len == known_hdrs[i].len && p->known[i] < 0 &&
+            _gnut_hs_ieq(buf + hdr->name.off, known_hdrs[i].name,
+            known_hdrs[i].len)) {
+
+            p->known[i] = (signed char)idx;
+            return;
+        }
+    }
+}
+
+static gnut_error_t _gnut_hs_parse_start_line(gnut_hs_parser_t *p,
+    const char *buf, sxs_uint16_t off, sxs_uint16_t len) {
+
+    const char *line;
+    int code, i;
+
+    line = buf + off;
+    p->start_line.off = off;
+    p->start_line.len = len;
+
+    if (len == 20 && memcmp(line, GNUT_HS_CONNECT_LINE, 20) == 0) {
+        p->is_connect = 1;
+        return GNUT_SUCCESS;
+    }
+
+    /* "GNUTELLA/0.6 200 OK", the reason phrase is free form. */
+    if (len < 16 || memcmp(line, "GNUTELLA/0.6 ", 13) != 0) {
+        return GNUT_EHS_MALFORMED;
+    }
+    code = 0;
+    for (i = 13; i < 16; i++) {
+        if (line[i] < '0' || line[i] > '9') {
+            return GNUT_EHS_MALFORMED;
+        }
+        code = (code * 10) + (line[i] - '0');
+    }
+    p->status_code = code;
+
+    return GNUT_SUCCESS;
+}
+
+static gnut_error_t _gnut_hs_parse_hdr_line(gnut_hs_parser_t *p,
+    const char *buf, sxs_uint16_t off, sxs_uint16_t len) {
+
+    const char *line, *colon;
+    gnut_hs_hdr_t *hdr;
+    sxs_uint16_t name_end, val_start, val_end;
+
+    line = buf + off;
+
+    /* A line starting with whitespace continues the previous value. */
+    if (line[0] == ' ' || line[0] == '\t') {
+        if (p->num_hdrs == 0) {
+            return GNUT_EHS_MALFORMED;
+        }
+        hdr = &p->hdrs[p->num_hdrs - 1];
+        val_end = len;
+        while (val_end > 0 && _gnut_hs_is_ws(line[val_end - 1])) {
+            val_end--;
+        }
+        if (val_end > 0) {
+            if (hdr->value.len == 0) {
+                val_start = 0;
+                while (_gnut_hs_is_ws(line[val_start])) {
+                    val_start++;
+                }
+                hdr->value.off = off + val_start;
+            }
+            hdr->value.len = (off + val_end) - hdr->value.off;
+        }
+        return GNUT_SUCCESS;
+    }
+
+    if (p->num_hdrs >= GNUT_HS_MAX_HDRS) {
+        return GNUT_EHS_TOO_MANY_HDRS;
+    }
+
+    colon = memchr(line, ':', len);
+    if (colon == NULL || colon == line) {
+        return GNUT_EHS_MALFORMED;
+    }
+
+    name_end = (sxs_uint16_t)(colon - line);
+    while (name_end > 0 && _gnut_hs_is_ws(line[name_end - 1])) {
+        name_end--;
+    }
+    val_start = (sxs_uint16_t)(colon - line) + 1;
+    while (val_start < len && _gnut_hs_is_ws(line[val_start])) {
+        val_start++;
+    }
+    val_end = len;
+    while (val_end > val_start && _gnut_hs_is_ws(line[val_end - 1])) {
+        val_end--;
+    }
+
+    hdr = &p->hdrs[p->num_hdrs];
+    hdr->name.off = off;
+    hdr->name.len = name_end;
+    hdr->value.off = off + val_start;
+    hdr->value.len = val_end - val_start;
+    _gnut_hs_classify(p, buf, p->num_hdrs);
+    p->num_hdrs++;
+
+    return GNUT_SUCCESS;
+}
+
+void gnut_hs_parser_init(gnut_hs_parser_t *p) {
+    int i;
+
+    p->pos = 0;
+    p->state = HS_STATE_START_LINE;
+    p->is_connect = 0;
+    p->status_code = 0;
+    p->start_line.off = 0;
+    p->start_line.len = 0;
+    p->num_hdrs = 0;
+    for (i = 0; i < GNUT_HS_HDR_COUNT; i++) {
+        p->known[i] = -1;
+    }
+}
+
+gnut_error_t gnut_hs_parse(gnut_hs_parser_t *p, const char *buf,
+    sxs_uint32_t len) {
+
+    const char *nl;
+    sxs_uint16_t line_len;
+    gnut_error_t reterr;
+
+    if (p->state == HS_STATE_DONE) {
+        return GNUT_SUCCESS;
+    }
+
+    while (p->pos < len) {
+        nl = memchr(buf + p->pos, '\n', len - p->pos);
+        if (nl == NULL) {
+            break;
+        }
+        if ((sxs_uint32_t)(nl - buf) >= GNUT_HS_MAX_LEN) {
+            return GNUT_EHS_TOO_LARGE;
+        }
+
+        /* Line length without the LF and an optional preceding CR. */
+        line_len = (sxs_uint16_t)((nl - buf) - p->pos);
+        if (line_len > 0 && buf[p->pos + line_len - 1] == '\r') {
+            line_len--;
+        }
+
+        if (p->state == HS_STATE_START_LINE) {
+            reterr = _gnut_hs_parse_start_line(p, buf, p->pos, line_len);
+            p->state = HS_STATE_HEADERS;
+        } else if (line_len == 0) {
+            p->pos = (sxs_uint16_t)((nl - buf) + 1);
+            p->state = HS_STATE_DONE;
+            return GNUT_SUCCESS;
+        } else {
+            reterr = _gnut_hs_parse_hdr_line(p, buf, p->pos, line_len);
+        }
+        if (reterr != GNUT_SUCCESS) {
+            return reterr;
+        }
+
+        p->pos = (sxs_uint16_t)((nl - buf) + 1);
+    }
+
+    if (len >= GNUT_HS_MAX_LEN) {
+        return GNUT_EHS_TOO_LARGE;
+    }
+
+    return GNUT_EHS_INCOMPLETE;
+}
+
+gnut_error_t gnut_hs_get_hdr(const gnut_hs_parser_t *p, int hdr_id,
+    gnut_span_t *p_val) {
+
+    if (hdr_id < 0 || hdr_id >= GNUT_HS_HDR_COUNT || p->known[hdr_id] < 0) {
+        return GNUT_EHS_NO_HDR;
+    }
+
+    *p_val = p->hdrs[(int)p->known[hdr_id]].value;
+
+    return GNUT_SUCCESS;
+}
+
+const gnut_hs_hdr_t *gnut_hs_find_hdr(const gnut_hs_parser_t *p,
+    const char *buf, const char *name, sxs_uint32_t name_len) {
+
+    sxs_uint16_t i;
+
+    for (i = 0; i < p->num_hdrs; i++) {
+        if (p->hdrs[i].name.len == name_len &&
+            _gnut_hs_ieq(buf + p->hdrs[i].name.off, name, name_len)) {
+            return &p->hdrs[i];
+        }
+    }
+
+    return NULL;
+}
+
+int gnut_hs_has_token(const char *buf, gnut_span_t val, const char *tok,
+    sxs_uint32_t tok_len) {
+
+    const char *cur, *end, *tok_end, *param;
+
+    cur = buf + val.off;
+    end = cur + val.len;
+
+    while (cur < end) {
+        while (cur < end && (_gnut_hs_is_ws(*cur) || *cur == ',')) {
+            cur++;
+        }
+        tok_end = cur;
+        while (tok_end < end && *tok_end != ',') {
+            tok_end++;
+        }
+
+        /* Ignore any ";q=" style parameters and trailing whitespace. */
+        param = memchr(cur, ';', tok_end - cur);
+        if (param == NULL) {
+            param = tok_end;
+        }
+        while (param > cur && _gnut_hs_is_ws(param[-1])) {
+            param--;
+        }
+        if ((sxs_uint32_t)(param - cur) == tok_len &&
+            _gnut_hs_ieq(cur, tok, tok_len)) {
+            return 1;
+        }
+
+        cur = tok_end;
+    }
+
+    return 0;
+}
+
+gnut_error_t gnut_hs_tmpl_init(gnut_hs_tmpl_t *t, const char *start_line) {
+    size_t len;
+
+    len = strlen(start_line);
+    if (len + 4 > GNUT_HS_TMPL_MAX) {
+        return GNUT_EBUF_TOO_SMALL;
+    }
+
+    memcpy(t->buf, start_line, len);
+    t->buf[len] = '\r';
+    t->buf[len + 1] = '\n';
+    t->len = (sxs_uint16_t)(len + 2);
+
+    return GNUT_SUCCESS;
+}
+
+gnut_error_t gnut_hs_tmpl_add_hdr(gnut_hs_tmpl_t *t, const char *name,
+    const char *value) {
+
+    size_t name_len, val_len;
+
+    name_len = strlen(name);
+    val_len = strlen(value);
+
+    /* Leave room for the ": " and the line terminator, plus the final
+     * empty line that gnut_hs_build() appends. */
+    if (t->len + name_len + val_len + 6 > GNUT_HS_TMPL_MAX) {
+        return GNUT_EBUF_TOO_SMALL;
+    }
+
+    memcpy(t->buf + t->len, name, name_len);
+    t->len += name_len;
+    t->buf[t->len++] = ':';
+    t->buf[t->len++] = ' ';
+    memcpy(t->buf + t->len, value, val_len);
+    t->len += val_len;
+    t->buf[t->len++] = '\r';
+    t->buf[t->len++] = '\n';
+
+    return GNUT_SUCCESS;
+}
+
+gnut_error_t gnut_hs_build(const gnut_hs_tmpl_t *t, const char *extra,
+    sxs_uint32_t extra_len, char *out, sxs_uint32_t out_cap,
+    sxs_uint32_t *p_len) {
+
+    sxs_uint32_t len;
+
+    if (extra == NULL) {
+        extra_len = 0;
+    }
+
+    len = t->len + extra_len + 2;
+    if (len > out_cap) {
+        return GNUT_EBUF_TOO_SMALL;
+    }
+
+    memcpy(out, t->buf, t->len);
+    if (extra_len > 0) {
+        memcpy(out + t->len, extra, extra_len);
+    }
+    out[len - 2] = '\r';
+    out[len - 1] = '\n';
+    *p_len = len;
+
+    return GNUT_SUCCESS;
+}
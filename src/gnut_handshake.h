@@ -0,0 +1,237 @@
+/*
+ * Copyright 2006-2007 Andrew De Ponte
+ *
+ * This file is part of lib_gnut.
+ *
+ * lib_gnut is the intellectual property of Andrew De Ponte; any
+ * distribution and/or modification and/or reproductions of any portion
+ * of lib_gnut MUST be approved by Andrew De Ponte.
+ *
+ * lib_gnut is distributed WITHOUT ANY WARRANTY; without even the
+ * implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE.
+ */
+
+/**
+ * @file gnut_handshake.h
+ * @brief This is a specifications file for the 0.6 handshake.
+ *
+ * The gnut_handshake.h file is a specifications file that declares the
+ * types and functions used to parse and build the HTTP style headers
+ * exchanged during the Gnutella 0.6 three-way handshake.
+ */
+
+#ifndef GNUT_HANDSHAKE_H
+#define GNUT_HANDSHAKE_H
+
+#include <sxs/sxs.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+#include "gnut_export.h"
+#include "gnut_types.h"
+#include "gnut_error.h"
+
+#define GNUT_HS_MAX_LEN 4096 /**< Max bytes in one handshake block */
+#define GNUT_HS_MAX_HDRS 32 /**< Max number of headers in one block */
+#define GNUT_HS_TMPL_MAX 1024 /**< Max bytes in a response template */
+
+#define GNUT_HS_CONNECT_LINE "GNUTELLA CONNECT/0.6"
+#define GNUT_HS_OK_LINE "GNUTELLA/0.6 200 OK"
+
+/* Identifiers of the headers that are indexed while parsing so that
+ * they can be looked up without searching the header list. */
+#define GNUT_HS_HDR_USER_AGENT 0 /**< User-Agent */
+#define GNUT_HS_HDR_X_ULTRAPEER 1 /**< X-Ultrapeer */
+#define GNUT_HS_HDR_ACCEPT_ENCODING 2 /**< Accept-Encoding */
+#define GNUT_HS_HDR_CONTENT_ENCODING 3 /**< Content-Encoding */
+#define GNUT_HS_HDR_X_TRY_ULTRAPEERS 4 /**< X-Try-Ultrapeers */
+#define GNUT_HS_HDR_COUNT 5
+
+/**
+ * A Span of Bytes
+ *
+ * The gnut_span_t is a type which represents a range of bytes within a
+ * buffer that is owned by someone else. Offsets rather than pointers
+ * are stored so that the span stays valid if the buffer is moved.
+ */
+typedef struct GNUT_EXPORT gnut_span {
+    sxs_uint16_t off;   /* Offset of the first byte in the buffer */
+    sxs_uint16_t len;   /* Number of bytes */
+} gnut_span_t;
+
+/**
+ * A Handshake Header
+ *
+ * The gnut_hs_hdr_t is a type which represents a single header line as
+ * a name span and a value span, both with surrounding whitespace
+ * already trimmed.
+ */
+typedef struct GNUT_EXPORT gnut_hs_hdr {
+    gnut_span_t name;
+    gnut_span_t value;
+} gnut_hs_hdr_t;
+
+/**
+ * A Handshake Parser
+ *
+ * The gnut_hs_parser_t is a type which holds the state of an
+ * incremental parse of one handshake block (a start line followed by
+ * headers and an empty line). Nothing is copied out of the receive
+ * buffer; all results are spans into it.
+ */
+typedef struct GNUT_EXPORT gnut_hs_parser {
+    sxs_uint16_t pos;           /* Offset of the line being scanned */
+    unsigned char state;        /* Start line, headers or done */
+    unsigned char is_connect;   /* Non-zero for GNUTELLA CONNECT/0.6 */
+    int status_code;            /* Status code of a response line */
+    gnut_span_t start_line;
+    sxs_uint16_t num_hdrs;
+    gnut_hs_hdr_t hdrs[GNUT_HS_MAX_HDRS];
+    signed char known[GNUT_HS_HDR_COUNT]; /* Index in hdrs, or -1 */
+} gnut_hs_parser_t;
+
+/**
+ * A Handshake Template
+ *
+ * The gnut_hs_tmpl_t is a type which holds a precomputed handshake
+ * block (start line plus the static headers) so that building a
+ * response is a single copy plus any per-connection headers.
+ */
+typedef struct GNUT_EXPORT gnut_hs_tmpl {
+    char buf[GNUT_HS_TMPL_MAX];
+    sxs_uint16_t len;           /* Length excluding terminating CRLF */
+} gnut_hs_tmpl_t;
+
+/**
+ * Initialize a Handshake Parser
+ *
+ * The gnut_hs_parser_init() function resets the parser pointed to by
+ * 'p' so that it is ready to parse a new handshake block starting at
+ * offset 0 of a receive buffer.
+ * @param p Pointer to the parser to initialize.
+ */
+GNUT_EXPORT void gnut_hs_parser_init(gnut_hs_parser_t *p);
+
+/**
+ * Parse a Handshake Block
+ *
+ * The gnut_hs_parse() function continues parsing the handshake block
+ * held in the first 'len' bytes of 'buf'. It may be called again with
+ * the same buffer each time more bytes have been appended to it. Once
+ * it returns GNUT_SUCCESS 'p->pos' holds the number of bytes the block
+ * occupied; anything after that belongs to the message stream.
+ * @param p Pointer to the parser holding the parse state.
+ * @param buf Pointer to the receive buffer.
+ * @param len The number of valid bytes in 'buf'.
+ * @return A value representing an error or success.
+ * @retval GNUT_SUCCESS The complete block has been parsed.
+ * @retval GNUT_EHS_INCOMPLETE More bytes are needed.
+ * @retval GNUT_EHS_MALFORMED The block is not a valid handshake.
+ * @retval GNUT_EHS_TOO_LARGE The block exceeds GNUT_HS_MAX_LEN.
+ * @retval GNUT_EHS_TOO_MANY_HDRS The block exceeds GNUT_HS_MAX_HDRS.
+ */
+GNUT_EXPORT gnut_error_t gnut_hs_parse(gnut_hs_parser_t *p,
+    const char *buf, sxs_uint32_t len);
+
+/**
+ * Get an Indexed Header Value
+ *
+ * The gnut_hs_get_hdr() function looks up one of the GNUT_HS_HDR_*
+ * headers in constant time and stores its value span in 'p_val'.
+ * @param p Pointer to a parser that has completed a parse.
+ * @param hdr_id One of the GNUT_HS_HDR_* identifiers.
+ * @param p_val Pointer to span to store the value in.
+ * @return A value representing an error or success.
+ * @retval GNUT_SUCCESS The header was present.
+ * @retval GNUT_EHS_NO_HDR The header was not present.
+ */
+GNUT_EXPORT gnut_error_t gnut_hs_get_hdr(const gnut_hs_parser_t *p,
+    int hdr_id, gnut_span_t *p_val);
+
+/**
+ * Find a Header by Name
+ *
+ * The gnut_hs_find_hdr() function searches the parsed headers for one
+ * whose name matches 'name' ignoring case. It is meant for headers that
+ * are not indexed.
+ * @param p Pointer to a parser that has completed a parse.
+ * @param buf Pointer to the receive buffer that was parsed.
+ * @param name The header name to search for.
+ * @param name_len The length of 'name' in bytes.
+ * @return Pointer to the matching header, or NULL if none matched.
+ */
+GNUT_EXPORT const gnut_hs_hdr_t *gnut_hs_find_hdr(const gnut_hs_parser_t *p,
+    const char *buf, const char *name, sxs_uint32_t name_len);
+
+/**
+ * Check a Header Value for a Token
+ *
+ * The gnut_hs_has_token() function reports whether the comma separated
+ * header value 'val' contains 'tok' ignoring case, e.g. "deflate" in an
+ * Accept-Encoding value or "true" in an X-Ultrapeer value.
+ * @param buf Pointer to the receive buffer that was parsed.
+ * @param val The value span to search.
+ * @param tok The token to search for.
+ * @param tok_len The length of 'tok' in bytes.
+ * @return Non-zero if the token is present, zero otherwise.
+ */
+GNUT_EXPORT int gnut_hs_has_token(const char *buf, gnut_span_t val,
+    const char *tok, sxs_uint32_t tok_len);
+
+/**
+ * Initialize a Handshake Template
+ *
+ * The gnut_hs_tmpl_init() function starts a new template with the given
+ * start line, e.g. GNUT_HS_CONNECT_LINE or GNUT_HS_OK_LINE.
+ * @param t Pointer to the template to initialize.
+ * @param start_line The start line without a line terminator.
+ * @return A value representing an error or success.
+ * @retval GNUT_SUCCESS Successfully initialized the template.
+ * @retval GNUT_EBUF_TOO_SMALL The line does not fit in the template.
+ */
+GNUT_EXPORT gnut_error_t gnut_hs_tmpl_init(gnut_hs_tmpl_t *t,
+    const char *start_line);
+
+/**
+ * Add a Static Header to a Handshake Template
+ *
+ * The gnut_hs_tmpl_add_hdr() function appends a header line that is
+ * the same for every connection (e.g. User-Agent) to the template.
+ * @param t Pointer to the template to add to.
+ * @param name The header name.
+ * @param value The header value.
+ * @return A value representing an error or success.
+ * @retval GNUT_SUCCESS Successfully added the header.
+ * @retval GNUT_EBUF_TOO_SMALL The header does not fit in the template.
+ */
+GNUT_EXPORT gnut_error_t gnut_hs_tmpl_add_hdr(gnut_hs_tmpl_t *t,
+    const char *name, const char *value);
+
+/**
+ * Build a Handshake Block from a Template
+ *
+ * The gnut_hs_build() function writes the template followed by the
+ * optional per-connection header lines in 'extra' (each already
+ * terminated with CRLF) and the terminating empty line into 'out'.
+ * @param t Pointer to the template to build from.
+ * @param extra Extra header lines, or NULL.
+ * @param extra_len The length of 'extra' in bytes.
+ * @param out Pointer to the buffer to write the block to.
+ * @param out_cap The capacity of 'out' in bytes.
+ * @param p_len Pointer to store the number of bytes written in.
+ * @return A value representing an error or success.
+ * @retval GNUT_SUCCESS Successfully built the block.
+ * @retval GNUT_EBUF_TOO_SMALL The block does not fit in 'out'.
+ */
+GNUT_EXPORT gnut_error_t gnut_hs_build(const gnut_hs_tmpl_t *t,
+    const char *extra, sxs_uint32_t extra_len, char *out,
+    sxs_uint32_t out_cap, sxs_uint32_t *p_len);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* GNUT_HANDSHAKE_H */
@@ -0,0 +1,652 @@
+/*
+ * Copyright 2006-2007 Andrew De Ponte
+ *
+ * This file is part of lib_gnut.
+ *
+ * lib_gnut is the intellectual property of Andrew De Ponte; any
+ * distribution and/or modification and/or reproductions of any portion
+ * of lib_gnut MUST be approved by Andrew De Ponte.
+ *
+ * lib_gnut is distributed WITHOUT ANY WARRANTY; without even the
+ * implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE.
+ */
+
+/**
+ * @file gnut_hasher.c
+ * @brief This is an implementation file for the shared file hasher.
+ *
+ * The gnut_hasher.c file is an implementation file that defines the
+ * gnut_hasher_t type's associated functions.
+ *
+ * Files wait in a list guarded by a mutex, which also guards the table
+ * of remembered digests; threads hold it only to take a file and to
+ * look up or store a digest, never while reading. Each thread reads
+ * into its own buffer. The system is told the file is read
+ * sequentially and asked for the next 'read_ahead' bytes as reading
+ * moves along, so the disk stays busy while a chunk is hashed, and the
+ * chunks already hashed are dropped from the page cache so that hashing
+ * a large share does not push everything else out of it. A file whose
+ * size or modification time changes while it is read is read again.
+ *
+ * The cache file is a 16 byte header of the magic and the record count,
+ * then for each file its size and modification time, its digest, and
+ * its path with its length, all integers little endian.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdio.h> /* fopen(), fwrite(), fread(), fclose(), rename() */
+#include <stdlib.h> /* calloc(), malloc(), realloc(), free() */
+#include <string.h> /* memset(), memcpy(), memcmp(), strlen() */
+#include <errno.h>
+#include <fcntl.h> /* open(), posix_fadvise() */
+#include <unistd.h> /* read(), lseek(), close(), sysconf() */
+#include <sys/stat.h> /* fstat() */
+#include <pthread.h>
+
+#include "gnut_hasher.h"
+
+#define SH_MAGIC "GNUTSH1\001"
+#define SH_HDR_LEN 16
+#define SH_REC_HDR_LEN 40 /* Size, time, digest and path length */
+#define SH_MAX_PATH 65535
+#define MAX_TRIES 3
+#define MIN_SLOTS 1024
+
+typedef struct gnut_hasher_job {
+    struct gnut_hasher_job *next;
+    char *path;                 /* Follows the job in its allocation */
+} gnut_hasher_job_t;
+
+typedef struct gnut_hasher_ent {
+    char *path;
+    sxs_uint32_t path_len;
+    sxs_uint32_t hash;
+    gnut_uint64_t size;
+    gnut_int64_t mtime;
+    unsigned char sha1[GNUT_SHA1_LEN];
+    int seen;                   /* Added since the hasher was created */
+} gnut_hasher_ent_t;
+
+typedef struct gnut_hasher_worker {
+    gnut_hasher_t *h;
+    pthread_t thread;
+    int started;
+    unsigned char *buf;
+} gnut_hasher_worker_t;
+
+struct gnut_hasher {
+    gnut_hasher_cfg_t cfg;
+    gnut_hasher_worker_t *workers;
+    int num_workers;
+    pthread_mutex_t lock;
+    pthread_cond_t work;        /* A file was added, or stopping */
+    pthread_cond_t idle;        /* Nothing is pending any more */
+    gnut_hasher_job_t *head;
+    gnut_hasher_job_t *tail;
+    int stopping;
+    gnut_hasher_stats_t stats;
+    gnut_hasher_ent_t *ents;
+    sxs_uint32_t num_ents;
+    sxs_uint32_t ents_cap;
+    sxs_uint32_t *slots;        /* Entry number plus one, 0 if empty */
+    sxs_uint32_t mask;
+};
+
+static void _gnut_hasher_put_le(unsigned char *p, gnut_uint64_t v,
+    int len) {
+
+    int i;
+
+    for (i = 0; i < len; i++) {
+        p[i] = (unsigned char)(v >> (8 * i));
+    }
+}
+
+static gnut_uint64_t _gnut_hasher_get_le(const unsigned char *p, int len) {
+    gnut_uint64_t v;
+    int i;
+
+    v = 0;
+    for (i = len - 1; i >= 0; i--) {
+        v = (v << 8) | p[i];
+    }
+
+    return v;
+}
+
+static sxs_uint32_t _gnut_hasher_hash(const char *path, sxs_uint32_t len) {
+    sxs_uint32_t h, i;
+
+    h = 2166136261U;
+    for (i = 0; i < len; i++) {
+        h = (h ^ (unsigned char)path[i]) * 16777619U;
+    }
+    return h;
+}
+
+/* Returns the slot holding 'path' or the empty slot it would go in. */
+static sxs_uint32_t *_gnut_hasher_probe(const gnut_hasher_t *h,
+    const char *path, sxs_uint32_t len, sxs_uint32_t hash) {
+
+    const gnut_hasher_ent_t *e;
+    sxs_uint32_t i;
+
+    i = hash & h->mask;
+    while (h->slots[i] != 0) {
+        e = &h->ents[h->slots[i] - 1];
+        if (e->hash == hash && e->path_len == len &&
+            memcmp(e->path, path, len) == 0) {
+            break;
+        }
+        i = (i + 1) & h->mask;
+    }
+    return &h->slots[i];
+}
+
+/* Keeps the table at most half full. */
+static int _gnut_hasher_rehash(gnut_hasher_t *h) {
+    sxs_uint32_t *slots, size, i, j;
+
+    if ((h->num_ents + 1) * 2 <= h->mask + 1) {
+        return 1;
+    }
+    size = (h->mask + 1) * 2;
+    slots = (sxs_uint32_t *)calloc(size, sizeof(sxs_uint32_t));
+    if (slots == NULL) {
+        return 0;
+    }
+    for (i = 0; i < h->num_ents; i++) {
+        j = h->ents[i].hash & (size - 1);
+        while (slots[j] != 0) {
+            j = (j + 1) & (size - 1);
+        }
+        slots[j] = i + 1;
+    }
+    free(h->slots);
+    h->slots = slots;
+    h->mask = size - 1;
+    return 1;
+}
+
+/* Returns the entry for 'path', adding an empty one if 'add' is set.
+ * The lock must be held. */
+static gnut_hasher_ent_t *_gnut_hasher_ent(gnut_hasher_t *h,
+    const char *path, sxs_uint32_t len, int add) {
+
+    gnut_hasher_ent_t *e, *ents;
+    sxs_uint32_t *slot, hash, cap;
+
+    hash = _gnut_hasher_hash(path, len);
+    slot = _gnut_hasher_probe(h, path, len, hash);
+    if (*slot != 0) {
+        return &h->ents[*slot - 1];
+    }
+    if (!add) {
+        return NULL;
+    }
+
+    if (h->num_ents == h->ents_cap) {
+        cap = (h->ents_cap > 0) ? h->ents_cap * 2 : MIN_SLOTS / 2;
+        ents = (gnut_hasher_ent_t *)realloc(h->ents,
+            cap * sizeof(gnut_hasher_ent_t));
+        if (ents == NULL) {
+            return NULL;
+        }
+        h->ents = ents;
+        h->ents_cap = cap;
+    }
+    if (!_gnut_hasher_rehash(h)) {
+        return NULL;
+    }
+    e = &h->ents[h->num_ents];
+    e->path = (char *)malloc(len + 1);
+    if (e->path == NULL) {
+        return NULL;
+    }
+    memcpy((void *)e->path, (const void *)path, len);
+    e->path[len] = '\0';
+    e->path_len = len;
+    e->hash = hash;
+    e->size = 0;
+    e->mtime = -1;
+    e->seen = 0;
+
+    slot = _gnut_hasher_probe(h, path, len, hash);
+    *slot = ++h->num_ents;
+    return e;
+}
+
+/* Adds the records of the cache file at 'path'. A bad record ends the
+ * load, keeping those before it. */
+static gnut_error_t _gnut_hasher_load(gnut_hasher_t *h, const char *path) {
+    gnut_hasher_ent_t *e;
+    unsigned char *buf, *p, *end;
+    sxs_uint32_t count, i, len;
+    FILE *fp;
+    long size;
+
+    fp = fopen(path, "rb");
+    if (fp == NULL) {
+        return GNUT_EFILE;
+    }
+    if (fseek(fp, 0, SEEK_END) != 0 || (size = ftell(fp)) < SH_HDR_LEN ||
+        fseek(fp, 0, SEEK_SET) != 0) {
+        fclose(fp);
+        return GNUT_EFILE;
+    }
+    buf = (unsigned char *)malloc(size);
+    if (buf == NULL) {
+        fclose(fp);
+        return GNUT_ENOMEM;
+    }
+    if (fread(buf, 1, size, fp) != (size_t)size ||
+        memcmp(buf, SH_MAGIC, 8) != 0) {
+        fclose(fp);
+        free(buf);
+        return GNUT_EFILE;
+    }
+    fclose(fp);
+
+    count = (sxs_uint32_t)_gnut_hasher_get_le(buf + 8, 4);
+    p = buf + SH_HDR_LEN;
+    end = buf + size;
+    for (i = 0; i < count && end - p >= SH_REC_HDR_LEN; i++) {
+        len = (sxs_uint32_t)_gnut_hasher_get_le(p + 36, 4);
+        if (len == 0 || len > SH_MAX_PATH ||
+            (size_t)(end - p) < SH_REC_HDR_LEN + len) {
+            break;
+        }
+        e = _gnut_hasher_ent(h, (const char *)(p + SH_REC_HDR_LEN), len, 1);
+        if (e == NULL) {
+            free(buf);
+            return GNUT_ENOMEM;
+        }
+        e->size = _gnut_hasher_get_le(p, 8);
+        e->mtime = (gnut_int64_t)_gnut_hasher_get_le(p + 8, 8);
+        memcpy((void *)e->sha1, (const void *)(p + 16), GNUT_SHA1_LEN);
+        p += SH_REC_HDR_LEN + len;
+    }
+
+    free(buf);
+    return GNUT_SUCCESS;
+}
+
+static gnut_int64_t _gnut_hasher_mtime(const struct stat *st) {
+#if defined(__APPLE__)
+    return (gnut_int64_t)st->st_mtimespec.tv_sec * 1000000000 +
+        st->st_mtimespec.tv_nsec;
+#elif defined(_WIN32)
+    return (gnut_int64_t)st->st_mtime * 1000000000;
+#else
+    return (gnut_int64_t)st->st_mtim.tv_sec * 1000000000 +
+        st->st_mtim.tv_nsec;
+#endif
+}
+
+/* Hashes the 'size' bytes of the file open on 'fd'. */
+static gnut_error_t _gnut_hasher_read(gnut_hasher_t *h, int fd,
+    gnut_uint64_t size, unsigned char *buf, unsigned char *digest) {
+
+    gnut_sha1_t ctx;
+    gnut_uint64_t off;
+    size_t want;
+    ssize_t got;
+#ifdef POSIX_FADV_WILLNEED
+    gnut_uint64_t ahead;
+#endif
+
+    if (lseek(fd, 0, SEEK_SET) != 0) {
+        return GNUT_EFILE;
+    }
+#ifdef POSIX_FADV_SEQUENTIAL
+    posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+#ifdef POSIX_FADV_WILLNEED
+    ahead = 0;
+#endif
+
+    gnut_sha1_init(&ctx);
+    off = 0;
+    while (off < size) {
+#ifdef POSIX_FADV_WILLNEED
+        if (ahead < size && ahead < off + h->cfg.read_ahead) {
+            posix_fadvise(fd, (off_t)ahead,
+                (off_t)(off + h->cfg.read_ahead - ahead),
+                POSIX_FADV_WILLNEED);
+            ahead = off + h->cfg.read_ahead;
+        }
+#endif
+        want = h->cfg.chunk_size;
+        if (want > size - off) {
+            want = (size_t)(size - off);
+        }
+        got = read(fd, buf, want);
+        if (got < 0 && errno == EINTR) {
+            continue;
+        }
+        if (got <= 0) {
+            return GNUT_EFILE;
+        }
+        gnut_sha1_update(&ctx, buf, (size_t)got);
+#ifdef POSIX_FADV_DONTNEED
+        posix_fadvise(fd, (off_t)off, (off_t)got, POSIX_FADV_DONTNEED);
+#endif
+        off += got;
+    }
+
+    gnut_sha1_final(&ctx, digest);
+    return GNUT_SUCCESS;
+}
+
+/* Answers the file at 'f->path' from the cache or by hashing it. */
+static gnut_error_t _gnut_hasher_file(gnut_hasher_t *h, unsigned char *buf,
+    gnut_hasher_file_t *f) {
+
+    gnut_hasher_ent_t *e;
+    gnut_error_t err;
+    struct stat st;
+    sxs_uint32_t len;
+    int fd, tries;
+
+    len = (sxs_uint32_t)strlen(f->path);
+    fd = open(f->path, O_RDONLY);
+    if (fd < 0) {
+        return GNUT_EFILE;
+    }
+
+    err = GNUT_EFILE;
+    for (tries = 0; tries < MAX_TRIES; tries++) {
+        if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) {
+            break;
+        }
+        f->size = (gnut_uint64_t)st.st_size;
+        f->mtime = _gnut_hasher_mtime(&st);
+
+        pthread_mutex_lock(&h->lock);
+        e = _gnut_hasher_ent(h, f->path, len, 0);
+        if (e != NULL && e->size == f->size && e->mtime == f->mtime) {
+            memcpy((void *)f->sha1, (const void *)e->sha1, GNUT_SHA1_LEN);
+            e->seen = 1;
+            f->cached = 1;
+            h->stats.files_cached++;
+            pthread_mutex_unlock(&h->lock);
+            err = GNUT_SUCCESS;
+            break;
+        }
+        pthread_mutex_unlock(&h->lock);
+
+        err = _gnut_hasher_read(h, fd, f->size, buf, f->sha1);
+        if (err != GNUT_SUCCESS) {
+            break;
+        }
+        if (fstat(fd, &st) != 0 || (gnut_uint64_t)st.st_size != f->size ||
+            _gnut_hasher_mtime(&st) != f->mtime) {
+            err = GNUT_EFILE;
+            continue;
+        }
+
+        pthread_mutex_lock(&h->lock);
+        h->stats.files_hashed++;
+        h->stats.bytes_hashed += f->size;
+        e = _gnut_hasher_ent(h, f->path, len, 1);
+        if (e != NULL) {
+            e->size = f->size;
+            e->mtime = f->mtime;
+            memcpy((void *)e->sha1, (const void *)f->sha1, GNUT_SHA1_LEN);
+            e->seen = 1;
+        }
+        pthread_mutex_unlock(&h->lock);
+        break;
+    }
+
+    close(fd);
+    return err;
+}
+
+static void *_gnut_hasher_main(void *arg) {
+    gnut_hasher_worker_t *w;
+    gnut_hasher_t *h;
+    gnut_hasher_job_t *job;
+    gnut_hasher_file_t f;
+    gnut_error_t err;
+
+    w = (gnut_hasher_worker_t *)arg;
+    h = w->h;
+
+    for (;;) {
+        pthread_mutex_lock(&h->lock);
+        while (!h->stopping && h->head == NULL) {
+            pthread_cond_wait(&h->work, &h->lock);
+        }
+        if (h->stopping) {
+            pthread_mutex_unlock(&h->lock);
+            break;
+        }
+        job = h->head;
+        h->head = job->next;
+        if (h->head == NULL) {
+            h->tail = NULL;
+        }
+        pthread_mutex_unlock(&h->lock);
+
+        memset((void *)&f, 0, sizeof(f));
+        f.path = job->path;
+        err = _gnut_hasher_file(h, w->buf, &f);
+        if (err != GNUT_SUCCESS) {
+            pthread_mutex_lock(&h->lock);
+            h->stats.errors++;
+            pthread_mutex_unlock(&h->lock);
+        }
+        if (h->cfg.cb != NULL) {
+            h->cfg.cb(h, err, &f, h->cfg.arg);
+        }
+        free(job);
+
+        pthread_mutex_lock(&h->lock);
+        if (--h->stats.pending == 0) {
+            pthread_cond_broadcast(&h->idle);
+        }
+        pthread_mutex_unlock(&h->lock);
+    }
+
+    return NULL;
+}
+
+void gnut_hasher_cfg_init(gnut_hasher_cfg_t *cfg) {
+    memset((void *)cfg, 0, sizeof(gnut_hasher_cfg_t));
+    cfg->chunk_size = GNUT_HASHER_DEF_CHUNK;
+    cfg->read_ahead = GNUT_HASHER_DEF_AHEAD;
+}
+
+gnut_error_t gnut_hasher_new(gnut_hasher_t **pp_h,
+    const gnut_hasher_cfg_t *cfg) {
+
+    gnut_hasher_t *h;
+    long ncpu;
+    int i;
+
+    h = (gnut_hasher_t *)calloc(1, sizeof(gnut_hasher_t));
+    if (h == NULL) {
+        return GNUT_ENOMEM;
+    }
+    h->cfg = *cfg;
+    h->cfg.cache_path = NULL;
+    if (h->cfg.chunk_size == 0) {
+        h->cfg.chunk_size = GNUT_HASHER_DEF_CHUNK;
+    }
+    h->num_workers = cfg->num_threads;
+    if (h->num_workers <= 0) {
+        ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+        h->num_workers = (ncpu > 0) ? (int)ncpu : 1;
+    }
+    pthread_mutex_init(&h->lock, NULL);
+    pthread_cond_init(&h->work, NULL);
+    pthread_cond_init(&h->idle, NULL);
+
+    h->slots = (sxs_uint32_t *)calloc(MIN_SLOTS, sizeof(sxs_uint32_t));
+    h->workers = (gnut_hasher_worker_t *)calloc(h->num_workers,
+        sizeof(gnut_hasher_worker_t));
+    if (h->slots == NULL || h->workers == NULL) {
+        gnut_hasher_free(h);
+        return GNUT_ENOMEM;
+    }
+    h->mask = MIN_SLOTS - 1;
+
+    if (cfg->cache_path != NULL &&
+        _gnut_hasher_load(h, cfg->cache_path) == GNUT_ENOMEM) {
+        gnut_hasher_free(h);
+        return GNUT_ENOMEM;
+    }
+
+    for (i = 0; i < h->num_workers; i++) {
+        h->workers[i].h = h;
+        h->workers[i].buf = (unsigned char *)malloc(h->cfg.chunk_size);
+        if (h->workers[i].buf == NULL) {
+            gnut_hasher_free(h);
+            return GNUT_ENOMEM;
+        }
+        if (pthread_create(&h->workers[i].thread, NULL, _gnut_hasher_main,
+            &h->workers[i]) != 0) {
+            gnut_hasher_free(h);
+            return GNUT_ETHREAD;
+        }
+        h->workers[i].started = 1;
+    }
+
+    *pp_h = h;
+    return GNUT_SUCCESS;
+}
+
+void gnut_hasher_free(gnut_hasher_t *h) {
+    gnut_hasher_job_t *job;
+    sxs_uint32_t i;
+    int j;
+
+    pthread_mutex_lock(&h->lock);
+    h->stopping = 1;
+    pthread_cond_broadcast(&h->work);
+    pthread_mutex_unlock(&h->lock);
+
+    if (h->workers != NULL) {
+        for (j = 0; j < h->num_workers; j++) {
+            if (h->workers[j].started) {
+                pthread_join(h->workers[j].thread, NULL);
+            }
+            free(h->workers[j].buf);
+        }
+        free(h->workers);
+    }
+    while ((job = h->head) != NULL) {
+        h->head = job->next;
+        free(job);
+    }
+    for (i = 0; i < h->num_ents; i++) {
+        free(h->ents[i].path);
+    }
+    free(h->ents);
+    free(h->slots);
+
+    pthread_cond_destroy(&h->idle);
+    pthread_cond_destroy(&h->work);
+    pthread_mutex_destroy(&h->lock);
+    free(h);
+}
+
+gnut_error_t gnut_hasher_add(gnut_hasher_t *h, const char *path) {
+    gnut_hasher_job_t *job;
+    size_t len;
+
+    len = strlen(path);
+    job = (gnut_hasher_job_t *)malloc(sizeof(gnut_hasher_job_t) + len + 1);
+    if (job == NULL) {
+        return GNUT_ENOMEM;
+    }
+    job->next = NULL;
+    job->path = (char *)(job + 1);
+    memcpy((void *)job->path, (const void *)path, len + 1);
+
+    pthread_mutex_lock(&h->lock);
+    if (h->tail != NULL) {
+        h->tail->next = job;
+    } else {
+        h->head = job;
+    }
+    h->tail = job;
+    h->stats.pending++;
+    pthread_cond_signal(&h->work);
+    pthread_mutex_unlock(&h->lock);
+
+    return GNUT_SUCCESS;
+}
+
+void gnut_hasher_wait(gnut_hasher_t *h) {
+    pthread_mutex_lock(&h->lock);
+    while (h->stats.pending > 0) {
+        pthread_cond_wait(&h->idle, &h->lock);
+    }
+    pthread_mutex_unlock(&h->lock);
+}
+
+gnut_error_t gnut_hasher_save(gnut_hasher_t *h, const char *path) {
+    unsigned char hdr[SH_REC_HDR_LEN];
+    const gnut_hasher_ent_t *e;
+    char *tmp;
+    FILE *fp;
+    sxs_uint32_t i, count;
+    size_t len;
+    int ok;
+
+    len = strlen(path);
+    tmp = (char *)malloc(len + 5);
+    if (tmp == NULL) {
+        return GNUT_EFILE;
+    }
+    memcpy((void *)tmp, (const void *)path, len);
+    memcpy((void *)(tmp + len), (const void *)".tmp", 5);
+    fp = fopen(tmp, "wb");
+    if (fp == NULL) {
+        free(tmp);
+        return GNUT_EFILE;
+    }
+
+    pthread_mutex_lock(&h->lock);
+    count = 0;
+    for (i = 0; i < h->num_ents; i++) {
+        count += (h->ents[i].seen && h->ents[i].path_len <= SH_MAX_PATH);
+    }
+    memset((void *)hdr, 0, SH_HDR_LEN);
+    memcpy((void *)hdr, (const void *)SH_MAGIC, 8);
+    _gnut_hasher_put_le(hdr + 8, count, 4);
+    ok = (fwrite(hdr, 1, SH_HDR_LEN, fp) == SH_HDR_LEN);
+    for (i = 0; ok && i < h->num_ents; i++) {
+        e = &h->ents[i];
+        if (!e->seen || e->path_len > SH_MAX_PATH) {
+            continue;
+        }
+        _gnut_hasher_put_le(hdr, e->size, 8);
+        _gnut_hasher_put_le(hdr + 8, (gnut_uint64_t)e->mtime, 8);
+        memcpy((void *)(hdr + 16), (const void *)e->sha1, GNUT_SHA1_LEN);
+        _gnut_hasher_put_le(hdr + 36, e->path_len, 4);
+        ok = (fwrite(hdr, 1, SH_REC_HDR_LEN, fp) == SH_REC_HDR_LEN &&
+            fwrite(e->path, 1, e->path_len, fp) == e->path_len);
+    }
+    pthread_mutex_unlock(&h->lock);
+
+    if (fclose(fp) != 0 || !ok || rename(tmp, path) != 0) {
+        remove(tmp);
+        free(tmp);
+        return GNUT_EFILE;
+    }
+    free(tmp);
+    return GNUT_SUCCESS;
+}
+
+void gnut_hasher_stats(gnut_hasher_t *h, gnut_hasher_stats_t *st) {
+    pthread_mutex_lock(&h->lock);
+    *st = h->stats;
+    pthread_mutex_unlock(&h->lock);
+}
@@ -0,0 +1,201 @@
+/*
+ * Copyright 2006-2007 Andrew De Ponte
+ *
+ * This file is part of lib_gnut.
+ *
+ * lib_gnut is the intellectual property of Andrew De Ponte; any
+ * distribution and/or modification and/or reproductions of any portion
+ * of lib_gnut MUST be approved by Andrew De Ponte.
+ *
+ * lib_gnut is distributed WITHOUT ANY WARRANTY; without even the
+ * implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE.
+ */
+
+/**
+ * @file gnut_hasher.h
+ * @brief This is a specifications file for the shared file hasher.
+ *
+ * The gnut_hasher.h file is a specifications file that declares the
+ * gnut_hasher_t type and its associated functions. A hasher computes
+ * the SHA-1 digests of shared files on a pool of threads, reading each
+ * file sequentially with the system told to read ahead of the hashing.
+ * Digests are remembered by path along with the file's size and
+ * modification time, and may be saved to a cache file and loaded at
+ * the next start, so that only files which are new or have changed
+ * since are hashed again.
+ */
+
+#ifndef GNUT_HASHER_H
+#define GNUT_HASHER_H
+
+#include <sxs/sxs.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+#include "gnut_export.h"
+#include "gnut_types.h"
+#include "gnut_error.h"
+#include "gnut_sha1.h"
+
+#define GNUT_HASHER_DEF_CHUNK 1048576 /**< Default bytes read at once */
+#define GNUT_HASHER_DEF_AHEAD 8388608 /**< Default bytes read ahead */
+
+/**
+ * A Shared File Hasher
+ *
+ * The gnut_hasher_t is an opaque type which represents a pool of
+ * hashing threads and the digests they have computed.
+ */
+typedef struct gnut_hasher gnut_hasher_t;
+
+/**
+ * A Hashed File
+ *
+ * The gnut_hasher_file_t is a type which describes the file a digest
+ * was computed for.
+ */
+typedef struct GNUT_EXPORT gnut_hasher_file {
+    const char *path;
+    gnut_uint64_t size;
+    gnut_int64_t mtime;         /* Modification time, in nanoseconds */
+    unsigned char sha1[GNUT_SHA1_LEN];
+    int cached;                 /* Taken from the cache, not hashed */
+} gnut_hasher_file_t;
+
+/**
+ * The type of function called with each file a hasher is done with.
+ *
+ * It is called from one of the hasher's threads, and may be called from
+ * several at once.
+ * @param h Pointer to the hasher.
+ * @param err GNUT_SUCCESS, or GNUT_EFILE if the file could not be
+ * opened or read, or kept changing while it was read.
+ * @param f Pointer to the file, whose digest is only meaningful on
+ * success. It is valid for the duration of the call.
+ * @param arg The argument given in the configuration.
+ */
+typedef void (*gnut_hasher_cb_t)(gnut_hasher_t *h, gnut_error_t err,
+    const gnut_hasher_file_t *f, void *arg);
+
+/**
+ * A Hasher Configuration
+ *
+ * The gnut_hasher_cfg_t is a type which holds the settings of a hasher.
+ * Use gnut_hasher_cfg_init() to get the defaults.
+ */
+typedef struct GNUT_EXPORT gnut_hasher_cfg {
+    int num_threads;            /* 0 for one per online CPU */
+    const char *cache_path;     /* File to load digests from, or NULL */
+    sxs_uint32_t chunk_size;    /* Bytes read and hashed at once */
+    sxs_uint32_t read_ahead;    /* Bytes the system is asked to read ahead */
+    gnut_hasher_cb_t cb;
+    void *arg;                  /* Passed to 'cb' */
+} gnut_hasher_cfg_t;
+
+/**
+ * Hasher Statistics
+ *
+ * The gnut_hasher_stats_t is a type which counts what a hasher has done.
+ */
+typedef struct GNUT_EXPORT gnut_hasher_stats {
+    gnut_uint64_t files_hashed;
+    gnut_uint64_t bytes_hashed;
+    gnut_uint64_t files_cached; /* Unchanged files answered from cache */
+    gnut_uint64_t errors;
+    sxs_uint32_t pending;       /* Files added and not yet done */
+} gnut_hasher_stats_t;
+
+/**
+ * Initialize a Hasher Configuration
+ *
+ * The gnut_hasher_cfg_init() function fills in 'cfg' with default
+ * values: one thread per CPU, no cache file, reads of
+ * GNUT_HASHER_DEF_CHUNK bytes with GNUT_HASHER_DEF_AHEAD bytes read
+ * ahead, and no callback.
+ * @param cfg Pointer to the configuration to initialize.
+ */
+GNUT_EXPORT void gnut_hasher_cfg_init(gnut_hasher_cfg_t *cfg);
+
+/**
+ * Create a Hasher
+ *
+ * The gnut_hasher_new() function loads the digests in the cache file,
+ * if one is given and it exists, and starts the hashing threads. A
+ * cache file which cannot be read or is not one is ignored.
+ * @param pp_h Pointer to store the pointer to the new hasher in.
+ * @param cfg Pointer to the configuration to use.
+ * @return A value representing an error or success.
+ * @retval GNUT_SUCCESS Successfully created the hasher.
+ * @retval GNUT_ENOMEM Failed to allocate memory.
+ * @retval GNUT_ETHREAD Failed to start a thread.
+ */
+GNUT_EXPORT gnut_error_t gnut_hasher_new(gnut_hasher_t **pp_h,
+    const gnut_hasher_cfg_t *cfg);
+
+/**
+ * Free a Hasher
+ *
+ * The gnut_hasher_free() function stops the threads once they finish
+ * the files they are on, drops the files not started, and frees the
+ * hasher. It does not save the cache.
+ * @param h Pointer to the hasher.
+ */
+GNUT_EXPORT void gnut_hasher_free(gnut_hasher_t *h);
+
+/**
+ * Add a File to a Hasher
+ *
+ * The gnut_hasher_add() function queues the file at 'path' and returns
+ * at once. A thread later looks the file up in the cache, hashes it if
+ * its size or modification time differ from those remembered, and
+ * calls the callback.
+ * @param h Pointer to the hasher.
+ * @param path Path of the file, which is copied.
+ * @return A value representing an error or success.
+ * @retval GNUT_SUCCESS Successfully queued the file.
+ * @retval GNUT_ENOMEM Failed to allocate memory.
+ */
+GNUT_EXPORT gnut_error_t gnut_hasher_add(gnut_hasher_t *h, const char *path);
+
+/**
+ * Wait for a Hasher
+ *
+ * The gnut_hasher_wait() function blocks until every file added has
+ * been done with and its callback has returned.
+ * @param h Pointer to the hasher.
+ */
+GNUT_EXPORT void gnut_hasher_wait(gnut_hasher_t *h);
+
+/**
+ * Save a Hasher's Cache
+ *
+ * The gnut_hasher_save() function writes the digests of the files added
+ * since the hasher was created to 'path', replacing it only once the
+ * new file is complete. Digests loaded for files that were not added
+ * again are left out, so files no longer shared drop out of the cache.
+ * @param h Pointer to the hasher.
+ * @param path Path of the cache file.
+ * @return A value representing an error or success.
+ * @retval GNUT_SUCCESS Successfully saved the cache.
+ * @retval GNUT_EFILE Failed to write or rename the file.
+ */
+GNUT_EXPORT gnut_error_t gnut_hasher_save(gnut_hasher_t *h,
+    const char *path);
+
+/**
+ * Get the Statistics of a Hasher
+ *
+ * @param h Pointer to the hasher.
+ * @param st Pointer to the statistics to fill in.
+ */
+GNUT_EXPORT void gnut_hasher_stats(gnut_hasher_t *h,
+    gnut_hasher_stats_t *st);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* GNUT_HASHER_H */
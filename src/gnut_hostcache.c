@@ -0,0 +1,541 @@
+/*
+ * Copyright 2006-2007 Andrew De Ponte
+ *
+ * This file is part of lib_gnut.
+ *
+ * lib_gnut is the intellectual property of Andrew De Ponte; any
+ * distribution and/or modification and/or reproductions of any portion
+ * of lib_gnut MUST be approved by Andrew De Ponte.
+ *
+ * lib_gnut is distributed WITHOUT ANY WARRANTY; without even the
+ * implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE.
+ */
+
+/**
+ * @file gnut_hostcache.c
+ * @brief This is an implementation file for the persistent host cache.
+ *
+ * The gnut_hostcache.c file is an implementation file that defines the
+ * gnut_hostcache_t type's associated functions.
+ *
+ * The file is a 64 byte header, 'capacity' records, then an index of
+ * 'index_size' slots each holding a record number plus one, or zero if
+ * the slot is empty. The index is checked when the file is opened and
+ * rebuilt from the records if any slot names no record, so lookups can
+ * trust it. Lookups probe the index linearly without locking; a slot is
+ * only published after the record it names is written, so a reader
+ * sees either nothing or a complete key. Inserts, removals and connect
+ * results are serialized by a mutex, and removals shift the following
+ * entries back rather than leaving tombstones. A reader racing such a
+ * shift may miss the host being moved, which only costs a touch.
+ *
+ * gnut_hostcache_touch() and gnut_hostcache_get() stay lock free, so a
+ * record may be evicted and reused for another host between their
+ * lookup and their access to it. Both check the key again afterwards
+ * and report the host as not found if it changed. A touch that lost
+ * this race has moved the new host's last seen time forward, which
+ * only delays its eviction.
+ *
+ * Times are seconds since the epoch, read by the cache itself so that
+ * every record uses the same clock.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdlib.h> /* calloc(), free() */
+#include <string.h> /* memset(), memcmp(), memcpy() */
+#include <fcntl.h> /* open() */
+#include <unistd.h> /* ftruncate(), close() */
+#include <sys/stat.h> /* fstat() */
+#include <sys/mman.h> /* mmap(), msync(), munmap() */
+#include <time.h> /* time() */
+#include <pthread.h>
+
+#include "gnut_hostcache.h"
+#include "gnut_atomic.h"
+
+#define HC_MAGIC "GNUTHC\0\1"
+#define HC_BYTE_ORDER 0x01020304
+#define HC_HDR_SIZE 64
+#define HC_EVICT_SAMPLE 32
+
+typedef struct gnut_hc_hdr {
+    unsigned char magic[8];
+    sxs_uint32_t byte_order;    /* Written natively, rejects foreign files */
+    sxs_uint32_t rec_size;
+    sxs_uint32_t capacity;
+    sxs_uint32_t index_size;    /* Power of two, at least 2 * capacity */
+    sxs_uint32_t count;
+    sxs_uint32_t hand;          /* Where free slot and eviction scans start */
+    sxs_uint32_t dirty;         /* Set while open, index suspect if found */
+    unsigned char pad[HC_HDR_SIZE - 36];
+} gnut_hc_hdr_t;
+
+struct gnut_hostcache {
+    int fd;
+    void *map;
+    size_t map_len;
+    gnut_hc_hdr_t *hdr;
+    gnut_hc_rec_t *recs;
+    sxs_uint32_t *index;
+    sxs_uint32_t mask;
+    pthread_mutex_t lock;
+};
+
+static gnut_uint64_t _gnut_hc_now(void) {
+    return (gnut_uint64_t)time(NULL);
+}
+
+static gnut_uint64_t _gnut_hc_key(sxs_uint32_t ip, sxs_uint16_t port) {
+    return ((gnut_uint64_t)ip << 16) | port;
+}
+
+static sxs_uint32_t _gnut_hc_home(const gnut_hostcache_t *hc,
+    gnut_uint64_t key) {
+
+    return (sxs_uint32_t)((key * 0x9E3779B97F4A7C15ULL) >> 32) & hc->mask;
+}
+
+/* Returns the index slot naming 'key', or -1. Safe without the lock. */
+static sxs_int32_t _gnut_hc_find(const gnut_hostcache_t *hc,
+    gnut_uint64_t key) {
+
+    sxs_uint32_t i, n, v;
+
+    i = _gnut_hc_home(hc, key);
+    for (n = 0; n <= hc->mask; n++) {
+        v = GNUT_ATOMIC_LOAD_ACQ(&hc->index[i]);
+        if (v == 0) {
+            return -1;
+        }
+        if (GNUT_ATOMIC_LOAD_RLX(&hc->recs[v - 1].key) == key) {
+            return (sxs_int32_t)i;
+        }
+        i = (i + 1) & hc->mask;
+    }
+
+    return -1;
+}
+
+static gnut_hc_rec_t *_gnut_hc_lookup(const gnut_hostcache_t *hc,
+    gnut_uint64_t key) {
+
+    sxs_int32_t slot;
+
+    slot = _gnut_hc_find(hc, key);
+    if (slot < 0) {
+        return NULL;
+    }
+    return &hc->recs[GNUT_ATOMIC_LOAD_ACQ(&hc->index[slot]) - 1];
+}
+
+static void _gnut_hc_index_add(gnut_hostcache_t *hc, sxs_uint32_t rec) {
+    sxs_uint32_t i;
+
+    i = _gnut_hc_home(hc, hc->recs[rec].key);
+    while (hc->index[i] != 0) {
+        i = (i + 1) & hc->mask;
+    }
+    GNUT_ATOMIC_STORE_REL(&hc->index[i], rec + 1);
+}
+
+/* Empties index slot 'i' and shifts back the entries probing past it. */
+static void _gnut_hc_index_del(gnut_hostcache_t *hc, sxs_uint32_t i) {
+    sxs_uint32_t j, home, v;
+
+    j = i;
+    for (;;) {
+        j = (j + 1) & hc->mask;
+        v = hc->index[j];
+        if (v == 0) {
+            break;
+        }
+        home = _gnut_hc_home(hc, hc->recs[v - 1].key);
+        /* Leave it if its home lies cyclically within (i, j]. */
+        if (((j - home) & hc->mask) < ((j - i) & hc->mask)) {
+            continue;
+        }
+        GNUT_ATOMIC_STORE_REL(&hc->index[i], v);
+        i = j;
+    }
+    GNUT_ATOMIC_STORE_REL(&hc->index[i], 0);
+}
+
+static void _gnut_hc_remove(gnut_hostcache_t *hc, gnut_hc_rec_t *rec) {
+    sxs_int32_t slot;
+
+    slot = _gnut_hc_find(hc, rec->key);
+    if (slot >= 0) {
+        _gnut_hc_index_del(hc, (sxs_uint32_t)slot);
+    }
+    GNUT_ATOMIC_STORE_REL(&rec->key, 0);
+    hc->hdr->count--;
+}
+
+static void _gnut_hc_rebuild(gnut_hostcache_t *hc) {
+    sxs_uint32_t i;
+
+    memset((void *)hc->index, 0, hc->hdr->index_size * sizeof(sxs_uint32_t));
+    hc->hdr->count = 0;
+    for (i = 0; i < hc->hdr->capacity; i++) {
+        if (hc->recs[i].key == 0) {
+            continue;
+        }
+        if (_gnut_hc_find(hc, hc->recs[i].key) >= 0) {
+            hc->recs[i].key = 0;
+            continue;
+        }
+        _gnut_hc_index_add(hc, i);
+        hc->hdr->count++;
+    }
+}
+
+/* Check that every index slot names a distinct record in use, and that
+ * they are as many as the records counted. A file left by a crash or
+ * damaged on disk fails this and gets its index rebuilt. */
+static int _gnut_hc_index_ok(const gnut_hostcache_t *hc) {
+    unsigned char *named;
+    sxs_uint32_t i, v, num;
+    int ok;
+
+    named = (unsigned char *)calloc(hc->hdr->capacity, 1);
+    if (named == NULL) {
+        return 0;
+    }
+    ok = 1;
+    num = 0;
+    for (i = 0; i <= hc->mask && ok; i++) {
+        v = hc->index[i];
+        if (v == 0) {
+            continue;
+        }
+        if (v > hc->hdr->capacity || named[v - 1] ||
+            hc->recs[v - 1].key == 0) {
+            ok = 0;
+        } else {
+            named[v - 1] = 1;
+            num++;
+        }
+    }
+    free(named);
+
+    return (ok && num == hc->hdr->count);
+}
+
+static int _gnut_hc_hdr_ok(const gnut_hc_hdr_t *hdr, sxs_uint32_t capacity,
+    sxs_uint32_t index_size) {
+
+    return (memcmp(hdr->magic, HC_MAGIC, 8) == 0 &&
+        hdr->byte_order == HC_BYTE_ORDER &&
+        hdr->rec_size == sizeof(gnut_hc_rec_t) &&
+        hdr->capacity == capacity && hdr->index_size == index_size &&
+        hdr->count <= capacity && hdr->hand < capacity);
+}
+
+gnut_error_t gnut_hostcache_open(gnut_hostcache_t **pp_hc, const char *path,
+    sxs_uint32_t capacity) {
+
+    gnut_hostcache_t *hc;
+    struct stat st;
+    sxs_uint32_t index_size;
+    size_t len;
+    int fresh;
+
+    if (capacity == 0) {
+        capacity = GNUT_HOSTCACHE_DEF_CAPACITY;
+    }
+    index_size = 2;
+    while (index_size < capacity * 2) {
+        index_size <<= 1;
+    }
+    len = HC_HDR_SIZE + (size_t)capacity * sizeof(gnut_hc_rec_t) +
+        (size_t)index_size * sizeof(sxs_uint32_t);
+
+    hc = (gnut_hostcache_t *)calloc(1, sizeof(gnut_hostcache_t));
+    if (hc == NULL) {
+        return GNUT_ENOMEM;
+    }
+
+    hc->fd = open(path, O_RDWR | O_CREAT, 0644);
+    if (hc->fd < 0) {
+        free(hc);
+        return GNUT_EFILE;
+    }
+    fresh = 0;
+    if (fstat(hc->fd, &st) != 0 || (size_t)st.st_size != len) {
+        fresh = 1;
+        if (ftruncate(hc->fd, 0) != 0 || ftruncate(hc->fd, len) != 0) {
+            close(hc->fd);
+            free(hc);
+            return GNUT_EFILE;
+        }
+    }
+    hc->map = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_SHARED, hc->fd, 0);
+    if (hc->map == MAP_FAILED) {
+        close(hc->fd);
+        free(hc);
+        return GNUT_EFILE;
+    }
+    hc->map_len = len;
+    hc->hdr = (gnut_hc_hdr_t *)hc->map;
+    hc->recs = (gnut_hc_rec_t *)((unsigned char *)hc->map + HC_HDR_SIZE);
+    hc->index = (sxs_uint32_t *)(hc->recs + capacity);
+    hc->mask = index_size - 1;
+
+    if (!fresh && !_gnut_hc_hdr_ok(hc->hdr, capacity, index_size)) {
+        memset(hc->map, 0, len);
+        fresh = 1;
+    }
+    if (fresh) {
+        memcpy((void *)hc->hdr->magic, (const void *)HC_MAGIC, 8);
+        hc->hdr->byte_order = HC_BYTE_ORDER;
+        hc->hdr->rec_size = sizeof(gnut_hc_rec_t);
+        hc->hdr->capacity = capacity;
+        hc->hdr->index_size = index_size;
+    } else if (hc->hdr->dirty || !_gnut_hc_index_ok(hc)) {
+        _gnut_hc_rebuild(hc);
+    }
+    hc->hdr->dirty = 1;
+
+    pthread_mutex_init(&hc->lock, NULL);
+
+    *pp_hc = hc;
+    return GNUT_SUCCESS;
+}
+
+void gnut_hostcache_close(gnut_hostcache_t *hc) {
+    msync(hc->map, hc->map_len, MS_SYNC);
+    hc->hdr->dirty = 0;
+    msync(hc->map, HC_HDR_SIZE, MS_SYNC);
+    munmap(hc->map, hc->map_len);
+    close(hc->fd);
+    pthread_mutex_destroy(&hc->lock);
+    free(hc);
+}
+
+void gnut_hostcache_sync(gnut_hostcache_t *hc) {
+    msync(hc->map, hc->map_len, MS_ASYNC);
+}
+
+/* Moves 'rec->last_seen' forward to 'now', never backward. */
+static void _gnut_hc_seen(gnut_hc_rec_t *rec, gnut_uint64_t now) {
+    gnut_uint64_t cur;
+
+    cur = GNUT_ATOMIC_LOAD_RLX(&rec->last_seen);
+    while (cur < now) {
+        if (GNUT_ATOMIC_CAS(&rec->last_seen, &cur, now)) {
+            break;
+        }
+    }
+}
+
+/* Removes the oldest of a sample of records, starting at the hand. */
+static void _gnut_hc_evict_one(gnut_hostcache_t *hc) {
+    gnut_hc_rec_t *rec, *victim;
+    sxs_uint32_t i, n, seen;
+
+    victim = NULL;
+    i = hc->hdr->hand;
+    seen = 0;
+    for (n = 0; n < hc->hdr->capacity && seen < HC_EVICT_SAMPLE; n++) {
+        rec = &hc->recs[i];
+        if (rec->key != 0) {
+            seen++;
+            if (victim == NULL || rec->last_seen < victim->last_seen) {
+                victim = rec;
+            }
+        }
+        i = (i + 1) % hc->hdr->capacity;
+    }
+    hc->hdr->hand = i;
+    if (victim != NULL) {
+        _gnut_hc_remove(hc, victim);
+    }
+}
+
+gnut_error_t gnut_hostcache_put(gnut_hostcache_t *hc, sxs_uint32_t ip,
+    sxs_uint16_t port, sxs_uint32_t num_files, sxs_uint32_t kb_shared) {
+
+    gnut_hc_rec_t *rec;
+    gnut_uint64_t key, now;
+    sxs_uint32_t i;
+
+    key = _gnut_hc_key(ip, port);
+    if (key == 0) {
+        return GNUT_SUCCESS;
+    }
+    now = _gnut_hc_now();
+
+    pthread_mutex_lock(&hc->lock);
+
+    rec = _gnut_hc_lookup(hc, key);
+    if (rec != NULL) {
+        _gnut_hc_seen(rec, now);
+        GNUT_ATOMIC_STORE_RLX(&rec->num_files, num_files);
+        GNUT_ATOMIC_STORE_RLX(&rec->kb_shared, kb_shared);
+        pthread_mutex_unlock(&hc->lock);
+        return GNUT_SUCCESS;
+    }
+
+    if (hc->hdr->count == hc->hdr->capacity) {
+        _gnut_hc_evict_one(hc);
+    }
+    i = hc->hdr->hand;
+    while (hc->recs[i].key != 0) {
+        i = (i + 1) % hc->hdr->capacity;
+    }
+    hc->hdr->hand = (i + 1) % hc->hdr->capacity;
+
+    rec = &hc->recs[i];
+    /* A touch that lost the race above may still update it. */
+    GNUT_ATOMIC_STORE_RLX(&rec->last_seen, now);
+    rec->successes = 0;
+    rec->failures = 0;
+    rec->num_files = num_files;
+    rec->kb_shared = kb_shared;
+    GNUT_ATOMIC_STORE_REL(&rec->key, key);
+    _gnut_hc_index_add(hc, i);
+    hc->hdr->count++;
+
+    pthread_mutex_unlock(&hc->lock);
+
+    return GNUT_SUCCESS;
+}
+
+gnut_error_t gnut_hostcache_put_pong(gnut_hostcache_t *hc,
+    const gnut_pong_payload_t *pong) {
+
+    return gnut_hostcache_put(hc, (sxs_uint32_t)pong->ip_addr.s_addr,
+        pong->port_num, pong->num_shared_files, pong->kb_shared);
+}
+
+gnut_error_t gnut_hostcache_touch(gnut_hostcache_t *hc, sxs_uint32_t ip,
+    sxs_uint16_t port) {
+
+    gnut_hc_rec_t *rec;
+    gnut_uint64_t key;
+
+    key = _gnut_hc_key(ip, port);
+    rec = _gnut_hc_lookup(hc, key);
+    if (rec == NULL) {
+        return GNUT_ENOT_FOUND;
+    }
+    _gnut_hc_seen(rec, _gnut_hc_now());
+    if (GNUT_ATOMIC_LOAD_ACQ(&rec->key) != key) {
+        return GNUT_ENOT_FOUND;
+    }
+
+    return GNUT_SUCCESS;
+}
+
+gnut_error_t gnut_hostcache_result(gnut_hostcache_t *hc,
+    const gnut_dial_host_t *host, int ok) {
+
+    gnut_hc_rec_t *rec;
+
+    /* Unlike a touch, a result written to a reused record would give
+     * another host this one's history, so it holds off removals. */
+    pthread_mutex_lock(&hc->lock);
+    rec = _gnut_hc_lookup(hc, _gnut_hc_key(host->ip, host->port));
+    if (rec == NULL) {
+        pthread_mutex_unlock(&hc->lock);
+        return GNUT_ENOT_FOUND;
+    }
+    /* The dialer seeded its history from ours, so it is the newer. */
+    GNUT_ATOMIC_STORE_RLX(&rec->successes, host->successes);
+    GNUT_ATOMIC_STORE_RLX(&rec->failures, host->failures);
+    if (ok) {
+        _gnut_hc_seen(rec, _gnut_hc_now());
+    }
+    pthread_mutex_unlock(&hc->lock);
+
+    return GNUT_SUCCESS;
+}
+
+sxs_uint32_t gnut_hostcache_evict(gnut_hostcache_t *hc,
+    gnut_uint64_t max_age) {
+
+    gnut_uint64_t now, cutoff;
+    sxs_uint32_t i, num;
+
+    now = _gnut_hc_now();
+    cutoff = (now > max_age) ? now - max_age : 0;
+    num = 0;
+    pthread_mutex_lock(&hc->lock);
+    for (i = 0; i < hc->hdr->capacity; i++) {
+        if (hc->recs[i].key != 0 &&
+            GNUT_ATOMIC_LOAD_RLX(&hc->recs[i].last_seen) < cutoff) {
+            _gnut_hc_remove(hc, &hc->recs[i]);
+            num++;
+        }
+    }
+    pthread_mutex_unlock(&hc->lock);
+
+    return num;
+}
+
+sxs_uint32_t gnut_hostcache_feed_dialer(gnut_hostcache_t *hc,
+    gnut_dialer_t *d) {
+
+    gnut_hc_rec_t *rec;
+    gnut_uint64_t now, mono, age, last_seen;
+    sxs_uint32_t i, num, failures;
+
+    now = _gnut_hc_now();
+    mono = gnut_time_us();
+    num = 0;
+    pthread_mutex_lock(&hc->lock);
+    for (i = 0; i < hc->hdr->capacity; i++) {
+        rec = &hc->recs[i];
+        if (rec->key == 0) {
+            continue;
+        }
+        last_seen = GNUT_ATOMIC_LOAD_RLX(&rec->last_seen);
+        age = (now > last_seen) ? (now - last_seen) * 1000000 : 0;
+        failures = GNUT_ATOMIC_LOAD_RLX(&rec->failures);
+        if (failures > 0xffff) {
+            failures = 0xffff;
+        }
+        if (gnut_dialer_add_host(d, (sxs_uint32_t)(rec->key >> 16),
+            (sxs_uint16_t)rec->key, (mono > age) ? mono - age : 0,
+            GNUT_ATOMIC_LOAD_RLX(&rec->successes),
+            (sxs_uint16_t)failures) == GNUT_SUCCESS) {
+            num++;
+        }
+    }
+    pthread_mutex_unlock(&hc->lock);
+
+    return num;
+}
+
+sxs_uint32_t gnut_hostcache_count(const gnut_hostcache_t *hc) {
+    return GNUT_ATOMIC_LOAD_RLX(&hc->hdr->count);
+}
+
+gnut_error_t gnut_hostcache_get(gnut_hostcache_t *hc, sxs_uint32_t ip,
+    sxs_uint16_t port, gnut_hc_rec_t *p_rec) {
+
+    gnut_hc_rec_t *rec;
+    gnut_uint64_t key;
+
+    key = _gnut_hc_key(ip, port);
+    rec = _gnut_hc_lookup(hc, key);
+    if (rec == NULL) {
+        return GNUT_ENOT_FOUND;
+    }
+    p_rec->key = key;
+    p_rec->last_seen = GNUT_ATOMIC_LOAD_RLX(&rec->last_seen);
+    p_rec->successes = GNUT_ATOMIC_LOAD_RLX(&rec->successes);
+    p_rec->failures = GNUT_ATOMIC_LOAD_RLX(&rec->failures);
+    p_rec->num_files = GNUT_ATOMIC_LOAD_RLX(&rec->num_files);
+    p_rec->kb_shared = GNUT_ATOMIC_LOAD_RLX(&rec->kb_shared);
+    GNUT_ATOMIC_FENCE();
+    if (GNUT_ATOMIC_LOAD_RLX(&rec->key) != key) {
+        return GNUT_ENOT_FOUND;
+    }
+
+    return GNUT_SUCCESS;
+}
@@ -0,0 +1,226 @@
+/*
+ * Copyright 2006-2007 Andrew De Ponte
+ *
+ * This file is part of lib_gnut.
+ *
+ * lib_gnut is the intellectual property of Andrew De Ponte; any
+ * distribution and/or modification and/or reproductions of any portion
+ * of lib_gnut MUST be approved by Andrew De Ponte.
+ *
+ * lib_gnut is distributed WITHOUT ANY WARRANTY; without even the
+ * implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE.
+ */
+
+/**
+ * @file gnut_hostcache.h
+ * @brief This is a specifications file for the persistent host cache.
+ *
+ * The gnut_hostcache.h file is a specifications file that declares the
+ * gnut_hostcache_t type and its associated functions. The host cache
+ * remembers hosts learned from pongs, and how connecting to them went,
+ * across restarts. It lives in a memory mapped file of fixed size
+ * records followed by an open addressing index of them, so opening it
+ * maps the file and does no parsing.
+ */
+
+#ifndef GNUT_HOSTCACHE_H
+#define GNUT_HOSTCACHE_H
+
+#include <sxs/sxs.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+#include "gnut_export.h"
+#include "gnut_types.h"
+#include "gnut_error.h"
+#include "gnut_msgs.h"
+#include "gnut_dialer.h"
+
+#define GNUT_HOSTCACHE_DEF_CAPACITY 16384 /**< Default number of records */
+
+/**
+ * A Host Cache Record
+ *
+ * The gnut_hc_rec_t is a type which represents one host as it is
+ * stored in the file. Times are in seconds since the epoch, as read by
+ * the cache itself, so that they stay meaningful across restarts.
+ */
+typedef struct GNUT_EXPORT gnut_hc_rec {
+    gnut_uint64_t key;          /* ip << 16 | port, 0 if unused */
+    gnut_uint64_t last_seen;    /* Last time the host was heard of */
+    sxs_uint32_t successes;     /* Successful connects */
+    sxs_uint32_t failures;      /* Consecutive failed connects */
+    sxs_uint32_t num_files;     /* Shared files, from its last pong */
+    sxs_uint32_t kb_shared;     /* Shared kilobytes, from its last pong */
+} gnut_hc_rec_t;
+
+/**
+ * A Host Cache
+ *
+ * The gnut_hostcache_t is an opaque type which represents an open host
+ * cache. Its functions may be called from any thread.
+ * gnut_hostcache_touch() and gnut_hostcache_get() never lock; adding
+ * and evicting hosts and recording connect results take a lock.
+ */
+typedef struct gnut_hostcache gnut_hostcache_t;
+
+/**
+ * Open a Host Cache
+ *
+ * The gnut_hostcache_open() function maps the host cache file at
+ * 'path', creating it if it does not exist or was made with a
+ * different capacity. If the process that last had it open did not
+ * close it cleanly, or the index names records that are not there,
+ * the index is rebuilt from the records.
+ * @param pp_hc Pointer to store the pointer to the host cache in.
+ * @param path Path of the host cache file.
+ * @param capacity The number of records the file holds.
+ * @return A value representing an error or success.
+ * @retval GNUT_SUCCESS Successfully opened the host cache.
+ * @retval GNUT_ENOMEM Failed to allocate memory.
+ * @retval GNUT_EFILE Failed to open, size or map the file.
+ */
+GNUT_EXPORT gnut_error_t gnut_hostcache_open(gnut_hostcache_t **pp_hc,
+    const char *path, sxs_uint32_t capacity);
+
+/**
+ * Close a Host Cache
+ *
+ * The gnut_hostcache_close() function marks the file clean, unmaps it
+ * and frees the host cache.
+ * @param hc Pointer to the host cache.
+ */
+GNUT_EXPORT void gnut_hostcache_close(gnut_hostcache_t *hc);
+
+/**
+ * Flush a Host Cache
+ *
+ * The gnut_hostcache_sync() function asks the system to write the
+ * mapped file back to disk without waiting for it.
+ * @param hc Pointer to the host cache.
+ */
+GNUT_EXPORT void gnut_hostcache_sync(gnut_hostcache_t *hc);
+
+/**
+ * Add or Refresh a Host
+ *
+ * The gnut_hostcache_put() function records that the host was heard of
+ * now, along with what it shares, adding it if it is new. When the
+ * cache is full the oldest of a sample of records makes room.
+ * @param hc Pointer to the host cache.
+ * @param ip The IPv4 address in network byte order.
+ * @param port The port in host byte order.
+ * @param num_files The number of files the host shares.
+ * @param kb_shared The number of kilobytes the host shares.
+ * @return A value representing an error or success.
+ * @retval GNUT_SUCCESS Successfully added or refreshed the host.
+ */
+GNUT_EXPORT gnut_error_t gnut_hostcache_put(gnut_hostcache_t *hc,
+    sxs_uint32_t ip, sxs_uint16_t port, sxs_uint32_t num_files,
+    sxs_uint32_t kb_shared);
+
+/**
+ * Add or Refresh a Host from a Pong
+ *
+ * The gnut_hostcache_put_pong() function records the host a pong
+ * advertises, as heard of now.
+ * @param hc Pointer to the host cache.
+ * @param pong Pointer to the parsed pong payload.
+ * @return A value representing an error or success.
+ * @retval GNUT_SUCCESS Successfully added or refreshed the host.
+ */
+GNUT_EXPORT gnut_error_t gnut_hostcache_put_pong(gnut_hostcache_t *hc,
+    const gnut_pong_payload_t *pong);
+
+/**
+ * Refresh a Host
+ *
+ * The gnut_hostcache_touch() function moves the last seen time of a
+ * known host forward to now with an atomic update. It never adds a
+ * host and never blocks. If the host is evicted while it runs, the
+ * host that takes its record may be touched instead, and the host is
+ * reported as not found.
+ * @param hc Pointer to the host cache.
+ * @param ip The IPv4 address in network byte order.
+ * @param port The port in host byte order.
+ * @return A value representing an error or success.
+ * @retval GNUT_SUCCESS Successfully refreshed the host.
+ * @retval GNUT_ENOT_FOUND The host is not in the cache.
+ */
+GNUT_EXPORT gnut_error_t gnut_hostcache_touch(gnut_hostcache_t *hc,
+    sxs_uint32_t ip, sxs_uint16_t port);
+
+/**
+ * Record a Connect Result
+ *
+ * The gnut_hostcache_result() function records whether connecting to
+ * a known host succeeded. It is meant to be called from a dialer's
+ * result callback.
+ * @param hc Pointer to the host cache.
+ * @param host Pointer to the dialer's record of the host.
+ * @param ok Non-zero if the connect succeeded.
+ * @return A value representing an error or success.
+ * @retval GNUT_SUCCESS Successfully recorded the result.
+ * @retval GNUT_ENOT_FOUND The host is not in the cache.
+ */
+GNUT_EXPORT gnut_error_t gnut_hostcache_result(gnut_hostcache_t *hc,
+    const gnut_dial_host_t *host, int ok);
+
+/**
+ * Evict Old Hosts
+ *
+ * The gnut_hostcache_evict() function removes every host last heard of
+ * more than 'max_age' seconds ago.
+ * @param hc Pointer to the host cache.
+ * @param max_age The age of the oldest hosts kept, in seconds.
+ * @return The number of hosts removed.
+ */
+GNUT_EXPORT sxs_uint32_t gnut_hostcache_evict(gnut_hostcache_t *hc,
+    gnut_uint64_t max_age);
+
+/**
+ * Feed a Dialer from a Host Cache
+ *
+ * The gnut_hostcache_feed_dialer() function adds every cached host to
+ * 'd' along with its connect history, converting last seen times from
+ * the cache's seconds since the epoch to the microseconds of the
+ * dialer's event loop clock.
+ * @param hc Pointer to the host cache.
+ * @param d Pointer to the dialer.
+ * @return The number of hosts added.
+ */
+GNUT_EXPORT sxs_uint32_t gnut_hostcache_feed_dialer(gnut_hostcache_t *hc,
+    gnut_dialer_t *d);
+
+/**
+ * Get the Number of Cached Hosts
+ *
+ * @param hc Pointer to the host cache.
+ * @return The number of hosts in the cache.
+ */
+GNUT_EXPORT sxs_uint32_t gnut_hostcache_count(const gnut_hostcache_t *hc);
+
+/**
+ * Look Up a Host
+ *
+ * The gnut_hostcache_get() function copies the record of a host
+ * without locking. A host evicted while it runs is not found.
+ * @param hc Pointer to the host cache.
+ * @param ip The IPv4 address in network byte order.
+ * @param port The port in host byte order.
+ * @param p_rec Pointer to store the record in.
+ * @return A value representing an error or success.
+ * @retval GNUT_SUCCESS Successfully found the host.
+ * @retval GNUT_ENOT_FOUND The host is not in the cache.
+ */
+GNUT_EXPORT gnut_error_t gnut_hostcache_get(gnut_hostcache_t *hc,
+    sxs_uint32_t ip, sxs_uint16_t port, gnut_hc_rec_t *p_rec);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* GNUT_HOSTCACHE_H */
@@ -0,0 +1,682 @@
+/*
+ * Copyright 2006-2007 Andrew De Ponte
+ *
+ * This file is part of lib_gnut.
+ *
+ * lib_gnut is the intellectual property of Andrew De Ponte; any
+ * distribution and/or modification and/or reproductions of any portion
+ * of lib_gnut MUST be approved by Andrew De Ponte.
+ *
+ * lib_gnut is distributed WITHOUT ANY WARRANTY; without even the
+ * implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE.
+ */
+
+/**
+ * @file gnut_index.c
+ * @brief This is an implementation file for the shared file index.
+ *
+ * The gnut_index.c file is an implementation file that defines the
+ * gnut_index_t type's associated functions.
+ */
+
+#include <stdlib.h> /* calloc(), realloc(), free() */
+#include <string.h> /* memset(), memcpy(), memcmp() */
+
+#include "gnut_index.h"
+
+#define MIN_SLOTS 1024
+
+/* A block of a list: its first file number and where its deltas are. */
+typedef struct gnut_index_skip {
+    sxs_uint32_t first;
+    sxs_uint32_t off;
+} gnut_index_skip_t;
+
+typedef struct gnut_index_term {
+    sxs_uint32_t kw_off;        /* Keyword, in the keyword pool */
+    sxs_uint32_t kw_len;
+    sxs_uint32_t hash;
+    sxs_uint32_t n;             /* File numbers in the list */
+    sxs_uint32_t last;          /* The last of them */
+    unsigned char *data;        /* Deltas after each block's first */
+    sxs_uint32_t len;
+    sxs_uint32_t cap;
+    gnut_index_skip_t *skips;   /* One per block */
+    sxs_uint32_t skip_cap;
+} gnut_index_term_t;
+
+typedef struct gnut_index_file {
+    sxs_uint32_t name_off;      /* Name, in the name pool */
+    sxs_uint32_t name_len;
+    sxs_uint32_t size;
+    int live;
+    int has_sha1;
+    unsigned char sha1[GNUT_SHA1_LEN];
+} gnut_index_file_t;
+
+struct gnut_index {
+    gnut_index_file_t *files;
+    sxs_uint32_t num_files;
+    sxs_uint32_t files_cap;
+    sxs_uint32_t num_live;
+    char *names;
+    sxs_uint32_t names_len;
+    sxs_uint32_t names_cap;
+    gnut_index_term_t *terms;
+    sxs_uint32_t num_terms;
+    sxs_uint32_t terms_cap;
+    char *kws;
+    sxs_uint32_t kws_len;
+    sxs_uint32_t kws_cap;
+    sxs_uint32_t *slots;        /* Term number + 1, or 0 if empty */
+    sxs_uint32_t mask;
+    sxs_uint32_t *sha1_slots;   /* File number + 1, or 0 if empty */
+    sxs_uint32_t sha1_mask;
+    sxs_uint32_t sha1_used;     /* Slots in use, stale ones included */
+    sxs_uint32_t gen;           /* Changes with what Queries would match */
+};
+
+/* Reads a list of one term, in file number order. */
+typedef struct gnut_index_cursor {
+    const gnut_index_term_t *t;
+    sxs_uint32_t blk;
+    sxs_uint32_t num_blks;
+    sxs_uint32_t off;           /* Next delta to decode */
+    sxs_uint32_t left;          /* File numbers left in the block */
+    sxs_uint32_t cur;
+    int done;
+} gnut_index_cursor_t;
+
+typedef struct gnut_index_answer {
+    gnut_qhit_t *h;
+    sxs_uint32_t max;
+    sxs_uint32_t added;
+} gnut_index_answer_t;
+
+/* Makes room for 'need' elements of 'size' bytes in '*pp', doubling. */
+static int _gnut_index_grow(void **pp, sxs_uint32_t *p_cap,
+    sxs_uint32_t need, size_t size) {
+
+    void *tmp;
+    sxs_uint32_t cap;
+
+    if (need <= *p_cap) {
+        return 1;
+    }
+    cap = (*p_cap > 0) ? *p_cap : 1;
+    while (cap < need) {
+        cap *= 2;
+    }
+    tmp = realloc(*pp, (size_t)cap * size);
+    if (tmp == NULL) {
+        return 0;
+    }
+    *pp = tmp;
+    *p_cap = cap;
+    return 1;
+}
+
+static sxs_uint32_t _gnut_index_hash(const char *kw, sxs_uint32_t len) {
+    sxs_uint32_t h, i;
+
+    h = 2166136261U;
+    for (i = 0; i < len; i++) {
+        h = (h ^ (unsigned char)kw[i]) * 16777619U;
+    }
+    return h;
+}
+
+/* Returns the slot holding 'kw' or the empty slot it would go in. */
+static sxs_uint32_t *_gnut_index_probe(const gnut_index_t *idx,
+    const char *kw, sxs_uint32_t len, sxs_uint32_t hash) {
+
+    const gnut_index_term_t *t;
+    sxs_uint32_t i;
+
+    i = hash & idx->mask;
+    for (;;) {
+        if (idx->slots[i] == 0) {
+            return &idx->slots[i];
+        }
+        t = &idx->terms[idx->slots[i] - 1];
+        if (t->hash == hash && t->kw_len == len &&
+            memcmp(idx->kws + t->kw_off, kw, len) == 0) {
+            return &idx->slots[i];
+        }
+        i = (i + 1) & idx->mask;
+    }
+}
+
+static int _gnut_index_rehash(gnut_index_t *idx) {
+    sxs_uint32_t *old, *slot;
+    sxs_uint32_t old_slots, i;
+    gnut_index_term_t *t;
+
+    old = idx->slots;
+    old_slots = idx->mask + 1;
+    idx->slots = (sxs_uint32_t *)calloc(old_slots * 2, sizeof(sxs_uint32_t));
+    if (idx->slots == NULL) {
+        idx->slots = old;
+        return 0;
+    }
+    idx->mask = old_slots * 2 - 1;
+    for (i = 0; i < old_slots; i++) {
+        if (old[i] != 0) {
+            t = &idx->terms[old[i] - 1];
+            slot = _gnut_index_probe(idx, idx->kws + t->kw_off, t->kw_len,
+                t->hash);
+            *slot = old[i];
+        }
+    }
+    free(old);
+    return 1;
+}
+
+static gnut_index_term_t *_gnut_index_term(gnut_index_t *idx, const char *kw,
+    sxs_uint32_t len, int create) {
+
+    gnut_index_term_t *t;
+    sxs_uint32_t *slot;
+    sxs_uint32_t hash;
+
+    hash = _gnut_index_hash(kw, len);
+    slot = _gnut_index_probe(idx, kw, len, hash);
+    if (*slot != 0) {
+        return &idx->terms[*slot - 1];
+    } else if (!create) {
+        return NULL;
+    }
+
+    if (!_gnut_index_grow((void **)&idx->terms, &idx->terms_cap,
+        idx->num_terms + 1, sizeof(gnut_index_term_t)) ||
+        !_gnut_index_grow((void **)&idx->kws, &idx->kws_cap,
+        idx->kws_len + len, 1)) {
+        return NULL;
+    }
+    t = &idx->terms[idx->num_terms];
+    memset((void *)t, 0, sizeof(gnut_index_term_t));
+    t->kw_off = idx->kws_len;
+    t->kw_len = len;
+    t->hash = hash;
+    memcpy((void *)(idx->kws + idx->kws_len), (const void *)kw, len);
+    idx->kws_len += len;
+    idx->num_terms++;
+    *slot = idx->num_terms;
+
+    /* Keep the table at most half full. */
+    if (idx->num_terms * 2 > idx->mask + 1 && !_gnut_index_rehash(idx)) {
+        return NULL;
+    }
+    return t;
+}
+
+static int _gnut_index_append(gnut_index_term_t *t, sxs_uint32_t file) {
+    sxs_uint32_t delta;
+
+    if (t->n % GNUT_INDEX_BLOCK == 0) {
+        if (!_gnut_index_grow((void **)&t->skips, &t->skip_cap,
+            t->n / GNUT_INDEX_BLOCK + 1, sizeof(gnut_index_skip_t))) {
+            return 0;
+        }
+        t->skips[t->n / GNUT_INDEX_BLOCK].first = file;
+        t->skips[t->n / GNUT_INDEX_BLOCK].off = t->len;
+    } else {
+        /* A delta takes at most 5 bytes of 7 bits. */
+        if (!_gnut_index_grow((void **)&t->data, &t->cap, t->len + 5, 1)) {
+            return 0;
+        }
+        delta = file - t->last;
+        while (delta >= 0x80) {
+            t->data[t->len++] = (unsigned char)(delta | 0x80);
+            delta >>= 7;
+        }
+        t->data[t->len++] = (unsigned char)delta;
+    }
+    t->last = file;
+    t->n++;
+    return 1;
+}
+
+static void _gnut_index_enter(gnut_index_cursor_t *c, sxs_uint32_t blk) {
+    c->blk = blk;
+    c->cur = c->t->skips[blk].first;
+    c->off = c->t->skips[blk].off;
+    if (blk + 1 < c->num_blks) {
+        c->left = GNUT_INDEX_BLOCK - 1;
+    } else {
+        c->left = c->t->n - blk * GNUT_INDEX_BLOCK - 1;
+    }
+}
+
+static void _gnut_index_cursor_init(gnut_index_cursor_t *c,
+    const gnut_index_term_t *t) {
+
+    c->t = t;
+    c->num_blks = (t->n + GNUT_INDEX_BLOCK - 1) / GNUT_INDEX_BLOCK;
+    c->done = 0;
+    _gnut_index_enter(c, 0);
+}
+
+static void _gnut_index_next(gnut_index_cursor_t *c) {
+    const unsigned char *p;
+    sxs_uint32_t delta;
+    int shift;
+
+    if (c->left == 0) {
+        if (c->blk + 1 == c->num_blks) {
+            c->done = 1;
+        } else {
+            _gnut_index_enter(c, c->blk + 1);
+        }
+        return;
+    }
+
+    p = c->t->data + c->off;
+    delta = 0;
+    shift = 0;
+    while (*p & 0x80) {
+        delta |= (sxs_uint32_t)(*p++ & 0x7f) << shift;
+        shift += 7;
+    }
+    delta |= (sxs_uint32_t)*p++ << shift;
+    c->off = p - c->t->data;
+    c->cur += delta;
+    c->left--;
+}
+
+/* Moves to the first file number not below 'target'. The blocks are
+ * searched by galloping from the current one, then the block found is
+ * decoded up to the target. */
+static void _gnut_index_seek(gnut_index_cursor_t *c, sxs_uint32_t target) {
+    const gnut_index_skip_t *skips;
+    sxs_uint32_t lo, hi, step, mid;
+
+    if (c->done || c->cur >= target) {
+        return;
+    }
+
+    skips = c->t->skips;
+    lo = c->blk + 1;
+    if (lo < c->num_blks && skips[lo].first <= target) {
+        step = 1;
+        while (lo + step < c->num_blks && skips[lo + step].first <= target) {
+            lo += step;
+            step *= 2;
+        }
+        hi = (lo + step < c->num_blks) ? lo + step : c->num_blks;
+        while (hi - lo > 1) {
+            mid = lo + (hi - lo) / 2;
+            if (skips[mid].first <= target) {
+                lo = mid;
+            } else {
+                hi = mid;
+            }
+        }
+        _gnut_index_enter(c, lo);
+    }
+
+    while (!c->done && c->cur < target) {
+        _gnut_index_next(c);
+    }
+}
+
+static sxs_uint32_t _gnut_index_sha1_home(const gnut_index_t *idx,
+    const unsigned char *sha1) {
+
+    /* The digest is already uniform, so its first bytes will do. */
+    return (((sxs_uint32_t)sha1[0] << 24) | ((sxs_uint32_t)sha1[1] << 16) |
+        ((sxs_uint32_t)sha1[2] << 8) | sha1[3]) & idx->sha1_mask;
+}
+
+static void _gnut_index_sha1_put(gnut_index_t *idx, sxs_uint32_t id) {
+    sxs_uint32_t i;
+
+    i = _gnut_index_sha1_home(idx, idx->files[id].sha1);
+    while (idx->sha1_slots[i] != 0) {
+        i = (i + 1) & idx->sha1_mask;
+    }
+    idx->sha1_slots[i] = id + 1;
+    idx->sha1_used++;
+}
+
+/* Rebuilds the digest table from the files' current digests, which
+ * drops stale slots, when adding one would fill more than half of it. */
+static int _gnut_index_sha1_grow(gnut_index_t *idx) {
+    sxs_uint32_t *slots, size, count, i;
+
+    if (idx->sha1_slots != NULL &&
+        (idx->sha1_used + 1) * 2 <= idx->sha1_mask + 1) {
+        return 1;
+    }
+    count = 1;
+    for (i = 0; i < idx->num_files; i++) {
+        count += idx->files[i].has_sha1;
+    }
+    size = MIN_SLOTS;
+    while (size < count * 4) {
+        size *= 2;
+    }
+    slots = (sxs_uint32_t *)calloc(size, sizeof(sxs_uint32_t));
+    if (slots == NULL) {
+        return 0;
+    }
+    free(idx->sha1_slots);
+    idx->sha1_slots = slots;
+    idx->sha1_mask = size - 1;
+    idx->sha1_used = 0;
+    for (i = 0; i < idx->num_files; i++) {
+        if (idx->files[i].has_sha1) {
+            _gnut_index_sha1_put(idx, i);
+        }
+    }
+    return 1;
+}
+
+gnut_error_t gnut_index_new(gnut_index_t **pp_idx) {
+    gnut_index_t *idx;
+
+    idx = (gnut_index_t *)calloc(1, sizeof(gnut_index_t));
+    if (idx == NULL) {
+        return GNUT_ENOMEM;
+    }
+    idx->slots = (sxs_uint32_t *)calloc(MIN_SLOTS, sizeof(sxs_uint32_t));
+    if (idx->slots == NULL) {
+        free(idx);
+        return GNUT_ENOMEM;
+    }
+    idx->mask = MIN_SLOTS - 1;
+
+    *pp_idx = idx;
+    return GNUT_SUCCESS;
+}
+
+void gnut_index_free(gnut_index_t *idx) {
+    sxs_uint32_t i;
+
+    for (i = 0; i < idx->num_terms; i++) {
+        free(idx->terms[i].data);
+        free(idx->terms[i].skips);
+    }
+    free(idx->terms);
+    free(idx->kws);
+    free(idx->slots);
+    free(idx->sha1_slots);
+    free(idx->files);
+    free(idx->names);
+    free(idx);
+}
+
+gnut_error_t gnut_index_add(gnut_index_t *idx, const char *name,
+    sxs_uint32_t name_len, sxs_uint32_t size, sxs_uint32_t *p_file_index) {
+
+    gnut_index_file_t *f;
+    gnut_index_term_t *t;
+    char folded[GNUT_TOKEN_FOLD_LEN(GNUT_INDEX_MAX_TEXT)];
+    gnut_token_t toks[GNUT_TOKEN_MAX_TOKENS(GNUT_INDEX_MAX_TEXT)];
+    sxs_uint32_t id, n, i;
+
+    if (!_gnut_index_grow((void **)&idx->files, &idx->files_cap,
+        idx->num_files + 1, sizeof(gnut_index_file_t)) ||
+        !_gnut_index_grow((void **)&idx->names, &idx->names_cap,
+        idx->names_len + name_len, 1)) {
+        return GNUT_ENOMEM;
+    }
+
+    id = idx->num_files;
+    f = &idx->files[id];
+    f->name_off = idx->names_len;
+    f->name_len = name_len;
+    f->size = size;
+    f->live = 0;
+    f->has_sha1 = 0;
+    memcpy((void *)(idx->names + idx->names_len), (const void *)name,
+        name_len);
+    idx->names_len += name_len;
+    idx->num_files++;
+
+    n = gnut_tokenize(name, (name_len < GNUT_INDEX_MAX_TEXT) ? name_len :
+        GNUT_INDEX_MAX_TEXT, folded, toks,
+        GNUT_TOKEN_MAX_TOKENS(GNUT_INDEX_MAX_TEXT));
+    for (i = 0; i < n; i++) {
+        t = _gnut_index_term(idx, folded + toks[i].off, toks[i].len, 1);
+        if (t == NULL) {
+            return GNUT_ENOMEM;
+        }
+        /* A keyword repeated in the name is listed once. */
+        if (t->n > 0 && t->last == id) {
+            continue;
+        }
+        if (!_gnut_index_append(t, id)) {
+            return GNUT_ENOMEM;
+        }
+    }
+
+    f->live = 1;
+    idx->num_live++;
+    idx->gen++;
+    if (p_file_index != NULL) {
+        *p_file_index = id;
+    }
+    return GNUT_SUCCESS;
+}
+
+gnut_error_t gnut_index_remove(gnut_index_t *idx, sxs_uint32_t file_index) {
+    if (file_index >= idx->num_files || !idx->files[file_index].live) {
+        return GNUT_ENOT_FOUND;
+    }
+    idx->files[file_index].live = 0;
+    idx->num_live--;
+    idx->gen++;
+    return GNUT_SUCCESS;
+}
+
+gnut_error_t gnut_index_file(const gnut_index_t *idx,
+    sxs_uint32_t file_index, const char **p_name, sxs_uint32_t *p_name_len,
+    sxs_uint32_t *p_size) {
+
+    const gnut_index_file_t *f;
+
+    if (file_index >= idx->num_files || !idx->files[file_index].live) {
+        return GNUT_ENOT_FOUND;
+    }
+    f = &idx->files[file_index];
+    *p_name = idx->names + f->name_off;
+    *p_name_len = f->name_len;
+    *p_size = f->size;
+    return GNUT_SUCCESS;
+}
+
+gnut_error_t gnut_index_set_sha1(gnut_index_t *idx, sxs_uint32_t file_index,
+    const unsigned char *sha1) {
+
+    gnut_index_file_t *f;
+
+    if (file_index >= idx->num_files || !idx->files[file_index].live) {
+        return GNUT_ENOT_FOUND;
+    }
+    f = &idx->files[file_index];
+    if (f->has_sha1 && memcmp(f->sha1, sha1, GNUT_SHA1_LEN) == 0) {
+        return GNUT_SUCCESS;
+    }
+    /* A slot naming the file under its old digest goes stale, and is
+     * skipped by lookups until the table is rebuilt. */
+    f->has_sha1 = 0;
+    idx->gen++;
+    if (!_gnut_index_sha1_grow(idx)) {
+        return GNUT_ENOMEM;
+    }
+    memcpy((void *)f->sha1, (const void *)sha1, GNUT_SHA1_LEN);
+    f->has_sha1 = 1;
+    _gnut_index_sha1_put(idx, file_index);
+    return GNUT_SUCCESS;
+}
+
+gnut_error_t gnut_index_find_sha1(const gnut_index_t *idx,
+    const unsigned char *sha1, sxs_uint32_t *p_file_index) {
+
+    const gnut_index_file_t *f;
+    sxs_uint32_t i;
+
+    if (idx->sha1_slots == NULL) {
+        return GNUT_ENOT_FOUND;
+    }
+    i = _gnut_index_sha1_home(idx, sha1);
+    while (idx->sha1_slots[i] != 0) {
+        f = &idx->files[idx->sha1_slots[i] - 1];
+        if (f->live && f->has_sha1 &&
+            memcmp(f->sha1, sha1, GNUT_SHA1_LEN) == 0) {
+            *p_file_index = idx->sha1_slots[i] - 1;
+            return GNUT_SUCCESS;
+        }
+        i = (i + 1) & idx->sha1_mask;
+    }
+    return GNUT_ENOT_FOUND;
+}
+
+sxs_uint32_t gnut_index_search(gnut_index_t *idx, const char *criteria,
+    sxs_uint32_t criteria_len, gnut_index_cb_t cb, void *arg) {
+
+    gnut_index_cursor_t curs[GNUT_INDEX_MAX_TERMS], tmp;
+    const gnut_index_term_t *t;
+    const gnut_index_file_t *f;
+    char folded[GNUT_TOKEN_FOLD_LEN(GNUT_INDEX_MAX_TEXT)];
+    gnut_token_t toks[GNUT_INDEX_MAX_TERMS];
+    sxs_uint32_t num_toks, k, cand, calls;
+    int n, i, j;
+
+    num_toks = gnut_tokenize(criteria, (criteria_len < GNUT_INDEX_MAX_TEXT) ?
+        criteria_len : GNUT_INDEX_MAX_TEXT, folded, toks,
+        GNUT_INDEX_MAX_TERMS);
+    n = 0;
+    for (k = 0; k < num_toks; k++) {
+        t = _gnut_index_term(idx, folded + toks[k].off, toks[k].len, 0);
+        if (t == NULL) {
+            return 0;
+        }
+        for (i = 0; i < n && curs[i].t != t; i++) {
+        }
+        if (i == n) {
+            _gnut_index_cursor_init(&curs[n++], t);
+        }
+    }
+    if (n == 0) {
+        return 0;
+    }
+
+    /* The shortest list leads, so the others are sought sparsely. */
+    for (i = 1; i < n; i++) {
+        tmp = curs[i];
+        for (j = i; j > 0 && curs[j - 1].t->n > tmp.t->n; j--) {
+            curs[j] = curs[j - 1];
+        }
+        curs[j] = tmp;
+    }
+
+    calls = 0;
+    cand = curs[0].cur;
+    for (;;) {
+        for (i = 1; i < n; i++) {
+            _gnut_index_seek(&curs[i], cand);
+            if (curs[i].done) {
+                return calls;
+            }
+            if (curs[i].cur > cand) {
+                break;
+            }
+        }
+
+        if (i < n) {
+            _gnut_index_seek(&curs[0], curs[i].cur);
+        } else {
+            f = &idx->files[cand];
+            if (f->live) {
+                calls++;
+                if (cb(idx, cand, idx->names + f->name_off, f->name_len,
+                    f->size, arg)) {
+                    return calls;
+                }
+            }
+            _gnut_index_next(&curs[0]);
+        }
+        if (curs[0].done) {
+            return calls;
+        }
+        cand = curs[0].cur;
+    }
+}
+
+static int _gnut_index_answer_cb(gnut_index_t *idx, sxs_uint32_t file_index,
+    const char *name, sxs_uint32_t name_len, sxs_uint32_t size, void *arg) {
+
+    gnut_index_answer_t *a;
+    const gnut_index_file_t *f;
+
+    a = (gnut_index_answer_t *)arg;
+    f = &idx->files[file_index];
+    if (gnut_qhit_add(a->h, file_index, size, name, name_len,
+        f->has_sha1 ? f->sha1 : NULL) != GNUT_SUCCESS) {
+        return 1;
+    }
+    a->added++;
+    return (a->added == a->max);
+}
+
+sxs_uint32_t gnut_index_answer(gnut_index_t *idx, const gnut_query_t *q,
+    gnut_qhit_t *h, sxs_uint32_t max_results) {
+
+    gnut_index_answer_t a;
+    const gnut_index_file_t *f;
+    unsigned char sha1[GNUT_SHA1_LEN];
+    sxs_uint32_t pos, file_index;
+    int by_hash;
+
+    if (max_results == 0) {
+        return 0;
+    }
+    a.h = h;
+    a.max = max_results;
+    a.added = 0;
+
+    by_hash = 0;
+    pos = 0;
+    while (a.added < a.max &&
+        gnut_ext_next_sha1(q->ext, q->ext_len, &pos, sha1)) {
+
+        by_hash = 1;
+        if (gnut_index_find_sha1(idx, sha1, &file_index) != GNUT_SUCCESS) {
+            continue;
+        }
+        f = &idx->files[file_index];
+        if (_gnut_index_answer_cb(idx, file_index, idx->names + f->name_off,
+            f->name_len, f->size, &a)) {
+            break;
+        }
+    }
+    if (!by_hash) {
+        gnut_index_search(idx, q->criteria, q->criteria_len,
+            _gnut_index_answer_cb, &a);
+    }
+    return a.added;
+}
+
+sxs_uint32_t gnut_index_generation(const gnut_index_t *idx) {
+    return idx->gen;
+}
+
+void gnut_index_stats(const gnut_index_t *idx, gnut_index_stats_t *st) {
+    const gnut_index_term_t *t;
+    sxs_uint32_t i;
+
+    st->files = idx->num_files;
+    st->live = idx->num_live;
+    st->keywords = idx->num_terms;
+    st->postings = 0;
+    st->list_bytes = 0;
+    for (i = 0; i < idx->num_terms; i++) {
+        t = &idx->terms[i];
+        st->postings += t->n;
+        st->list_bytes += t->len + ((t->n + GNUT_INDEX_BLOCK - 1) /
+            GNUT_INDEX_BLOCK) * sizeof(gnut_index_skip_t);
+    }
+}
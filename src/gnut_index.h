@@ -0,0 +1,254 @@
+/*
+ * Copyright 2006-2007 Andrew De Ponte
+ *
+ * This file is part of lib_gnut.
+ *
+ * lib_gnut is the intellectual property of Andrew De Ponte; any
+ * distribution and/or modification and/or reproductions of any portion
+ * of lib_gnut MUST be approved by Andrew De Ponte.
+ *
+ * lib_gnut is distributed WITHOUT ANY WARRANTY; without even the
+ * implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE.
+ */
+
+/**
+ * @file gnut_index.h
+ * @brief This is a specifications file for the shared file index.
+ *
+ * The gnut_index.h file is a specifications file that declares the
+ * gnut_index_t type and its associated functions. The index maps each
+ * keyword of the names of the shared files to the list of files whose
+ * name holds it, so that a Query is answered by intersecting the lists
+ * of its keywords rather than by looking at every file. Names and
+ * criteria are split into keywords by gnut_tokenize(), and a file
+ * matches a Query when its name holds every keyword of the criteria.
+ * Files may also be given their SHA-1 digest, which a table keyed by
+ * digest maps back to the file, so that a Query naming urn:sha1 values
+ * is answered by looking each up.
+ *
+ * Files are numbered in the order they are added, and the number is
+ * the file index given in Query Hits. Each list is kept as the deltas
+ * between successive file numbers in a variable length encoding, in
+ * blocks of GNUT_INDEX_BLOCK whose first file number is kept apart, so
+ * that an intersection can skip whole blocks. Removed files stay in the
+ * lists and are skipped when answering; the index never shrinks.
+ */
+
+#ifndef GNUT_INDEX_H
+#define GNUT_INDEX_H
+
+#include <sxs/sxs.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+#include "gnut_export.h"
+#include "gnut_types.h"
+#include "gnut_error.h"
+#include "gnut_query.h"
+#include "gnut_token.h"
+#include "gnut_sha1.h"
+
+#define GNUT_INDEX_MAX_TERMS 16 /**< Keywords of a Query considered */
+#define GNUT_INDEX_MAX_TEXT 1024 /**< Bytes of a name or criteria split */
+#define GNUT_INDEX_BLOCK 64 /**< File numbers per block of a list */
+
+/**
+ * A Shared File Index
+ *
+ * The gnut_index_t is an opaque type which represents a shared file
+ * index.
+ */
+typedef struct gnut_index gnut_index_t;
+
+/**
+ * Shared File Index Statistics
+ *
+ * The gnut_index_stats_t is a type which holds the sizes of an index.
+ */
+typedef struct GNUT_EXPORT gnut_index_stats {
+    sxs_uint32_t files;         /* Files added */
+    sxs_uint32_t live;          /* Files added and not removed */
+    sxs_uint32_t keywords;      /* Distinct keywords */
+    gnut_uint64_t postings;     /* File numbers in all the lists */
+    gnut_uint64_t list_bytes;   /* Bytes the lists take, skips included */
+} gnut_index_stats_t;
+
+/**
+ * The type of function called with each file matching a search.
+ *
+ * @param idx Pointer to the index.
+ * @param file_index The file's number.
+ * @param name Pointer to the file's name, not null terminated.
+ * @param name_len The length of the name.
+ * @param size The size of the file.
+ * @param arg The argument given with the callback.
+ * @return Non-zero to stop searching, 0 to go on.
+ */
+typedef int (*gnut_index_cb_t)(gnut_index_t *idx, sxs_uint32_t file_index,
+    const char *name, sxs_uint32_t name_len, sxs_uint32_t size, void *arg);
+
+/**
+ * Create a Shared File Index
+ *
+ * @param pp_idx Pointer to store the pointer to the new, empty index in.
+ * @return A value representing an error or success.
+ * @retval GNUT_SUCCESS Successfully created the index.
+ * @retval GNUT_ENOMEM Failed to allocate memory.
+ */
+GNUT_EXPORT gnut_error_t gnut_index_new(gnut_index_t **pp_idx);
+
+/**
+ * Free a Shared File Index
+ *
+ * @param idx Pointer to the index.
+ */
+GNUT_EXPORT void gnut_index_free(gnut_index_t *idx);
+
+/**
+ * Add a File to a Shared File Index
+ *
+ * The gnut_index_add() function gives the file the next file number
+ * and adds it to the list of each keyword of its name, looking no
+ * further than GNUT_INDEX_MAX_TEXT bytes into it. A name that holds no
+ * keyword is stored but matches no Query.
+ * @param idx Pointer to the index.
+ * @param name Pointer to the file's name, which must not contain a null
+ * byte.
+ * @param name_len The length of the name.
+ * @param size The size of the file.
+ * @param p_file_index Pointer to store the file's number in, or NULL.
+ * @return A value representing an error or success.
+ * @retval GNUT_SUCCESS Successfully added the file.
+ * @retval GNUT_ENOMEM Failed to allocate memory. The file is not added,
+ * though its number may be used up.
+ */
+GNUT_EXPORT gnut_error_t gnut_index_add(gnut_index_t *idx, const char *name,
+    sxs_uint32_t name_len, sxs_uint32_t size, sxs_uint32_t *p_file_index);
+
+/**
+ * Remove a File from a Shared File Index
+ *
+ * @param idx Pointer to the index.
+ * @param file_index The file's number.
+ * @return A value representing an error or success.
+ * @retval GNUT_SUCCESS Successfully removed the file.
+ * @retval GNUT_ENOT_FOUND No such file, or it was already removed.
+ */
+GNUT_EXPORT gnut_error_t gnut_index_remove(gnut_index_t *idx,
+    sxs_uint32_t file_index);
+
+/**
+ * Look up a File in a Shared File Index
+ *
+ * @param idx Pointer to the index.
+ * @param file_index The file's number.
+ * @param p_name Pointer to store a pointer to the file's name in. The
+ * name is not null terminated and is valid until the index is freed.
+ * @param p_name_len Pointer to store the length of the name in.
+ * @param p_size Pointer to store the size of the file in.
+ * @return A value representing an error or success.
+ * @retval GNUT_SUCCESS Successfully looked up the file.
+ * @retval GNUT_ENOT_FOUND No such file, or it was removed.
+ */
+GNUT_EXPORT gnut_error_t gnut_index_file(const gnut_index_t *idx,
+    sxs_uint32_t file_index, const char **p_name, sxs_uint32_t *p_name_len,
+    sxs_uint32_t *p_size);
+
+/**
+ * Set the Digest of a File in a Shared File Index
+ *
+ * The gnut_index_set_sha1() function gives the file its SHA-1 digest,
+ * replacing any it had, so that it can be found by the digest and its
+ * results carry its urn:sha1 value.
+ * @param idx Pointer to the index.
+ * @param file_index The file's number.
+ * @param sha1 Pointer to the GNUT_SHA1_LEN byte digest.
+ * @return A value representing an error or success.
+ * @retval GNUT_SUCCESS Successfully set the digest.
+ * @retval GNUT_ENOT_FOUND No such file, or it was removed.
+ * @retval GNUT_ENOMEM Failed to allocate memory.
+ */
+GNUT_EXPORT gnut_error_t gnut_index_set_sha1(gnut_index_t *idx,
+    sxs_uint32_t file_index, const unsigned char *sha1);
+
+/**
+ * Find a File by Digest in a Shared File Index
+ *
+ * The gnut_index_find_sha1() function looks up a file which has the
+ * SHA-1 digest and has not been removed. Of several such files, any
+ * one is found.
+ * @param idx Pointer to the index.
+ * @param sha1 Pointer to the GNUT_SHA1_LEN byte digest.
+ * @param p_file_index Pointer to store the file's number in.
+ * @return A value representing an error or success.
+ * @retval GNUT_SUCCESS Successfully found a file.
+ * @retval GNUT_ENOT_FOUND No file has the digest.
+ */
+GNUT_EXPORT gnut_error_t gnut_index_find_sha1(const gnut_index_t *idx,
+    const unsigned char *sha1, sxs_uint32_t *p_file_index);
+
+/**
+ * Search a Shared File Index
+ *
+ * The gnut_index_search() function calls 'cb' with each file whose name
+ * holds every keyword of 'criteria', in file number order, until it
+ * returns non-zero. Keywords beyond the first GNUT_INDEX_MAX_TERMS are
+ * ignored, and criteria without a keyword match nothing.
+ * @param idx Pointer to the index.
+ * @param criteria Pointer to the search criteria.
+ * @param criteria_len The length of the criteria.
+ * @param cb The function to call with each match.
+ * @param arg Passed to 'cb'.
+ * @return The number of times 'cb' was called.
+ */
+GNUT_EXPORT sxs_uint32_t gnut_index_search(gnut_index_t *idx,
+    const char *criteria, sxs_uint32_t criteria_len, gnut_index_cb_t cb,
+    void *arg);
+
+/**
+ * Answer a Query from a Shared File Index
+ *
+ * The gnut_index_answer() function searches for the criteria of 'q'
+ * and adds a result record for each match to the Query Hit 'h', until
+ * 'max_results' were added or 'h' is full. A Query whose extension
+ * block holds urn:sha1 values is answered with the files having those
+ * digests instead, whatever its criteria. Results of files with a
+ * digest carry their urn:sha1 value.
+ * @param idx Pointer to the index.
+ * @param q Pointer to the parsed Query.
+ * @param h Pointer to a Query Hit begun with gnut_qhit_begin().
+ * @param max_results The most results to add.
+ * @return The number of results added.
+ */
+GNUT_EXPORT sxs_uint32_t gnut_index_answer(gnut_index_t *idx,
+    const gnut_query_t *q, gnut_qhit_t *h, sxs_uint32_t max_results);
+
+/**
+ * Get the Generation of a Shared File Index
+ *
+ * The gnut_index_generation() function returns a number which changes
+ * whenever a file is added or removed or given a digest, that is when
+ * a Query may be answered differently, so that answers kept elsewhere
+ * can tell they are out of date.
+ * @param idx Pointer to the index.
+ * @return The generation of the index.
+ */
+GNUT_EXPORT sxs_uint32_t gnut_index_generation(const gnut_index_t *idx);
+
+/**
+ * Get the Statistics of a Shared File Index
+ *
+ * @param idx Pointer to the index.
+ * @param st Pointer to the statistics to fill in.
+ */
+GNUT_EXPORT void gnut_index_stats(const gnut_index_t *idx,
+    gnut_index_stats_t *st);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* GNUT_INDEX_H */
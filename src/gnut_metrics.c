@@ -0,0 +1,449 @@
+/*
+ * Copyright 2006-2007 Andrew De Ponte
+ *
+ * This file is part of lib_gnut.
+ *
+ * lib_gnut is the intellectual property of Andrew De Ponte; any
+ * distribution and/or modification and/or reproductions of any portion
+ * of lib_gnut MUST be approved by Andrew De Ponte.
+ *
+ * lib_gnut is distributed WITHOUT ANY WARRANTY; without even the
+ * implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE.
+ */
+
+/**
+ * @file gnut_metrics.c
+ * @brief This is an implementation file for the metrics endpoint.
+ *
+ * The gnut_metrics.c file is an implementation file that defines the
+ * gnut_metrics_t type's associated functions.
+ *
+ * Each client slot holds its request and its whole response, so a
+ * scrape renders straight into the slot and is written out from there
+ * however slowly the client reads. The body is rendered first, past
+ * room left for the header, and the header is then written in front of
+ * it once the body's length is known. The histograms are exported with
+ * one bucket per power of two rather than all of their buckets.
+ */
+
+#include <stdlib.h> /* calloc(), free() */
+#include <string.h> /* memcpy(), memcmp() */
+#include <stdio.h> /* vsnprintf(), snprintf() */
+#include <stdarg.h> /* va_list */
+
+#include "gnut_metrics.h"
+#include "gnut_stats.h"
+
+#ifdef MSG_NOSIGNAL
+#define SEND_FLAGS MSG_NOSIGNAL
+#else
+#define SEND_FLAGS 0
+#endif
+
+#define HDR_ROOM 256            /* Bytes kept in front of the body */
+#define FIRST_EXP 4             /* Exponent of the first bucket group */
+#define LAST_EXP 38             /* And of the last one given a bound */
+
+#define CONTENT_TYPE "text/plain; version=0.0.4"
+
+typedef struct gnut_metrics_client {
+    gnut_metrics_t *m;
+    sxs_socket_t sd;
+    int busy;
+    int writing;                /* Request read, response being sent */
+    int want_write;             /* Registered for GNUT_EV_WRITE */
+    gnut_timer_t timer;
+    sxs_uint32_t req_len;
+    sxs_uint32_t out_off;
+    sxs_uint32_t out_len;
+    char req[GNUT_METRICS_REQ_LEN];
+    char out[GNUT_METRICS_OUT_LEN];
+} gnut_metrics_client_t;
+
+struct gnut_metrics {
+    gnut_evloop_t *loop;
+    sxs_socket_t lsd;
+    int listening;
+    gnut_uint64_t scrapes;
+    gnut_stats_t snap;
+    gnut_metrics_client_t clients[GNUT_METRICS_MAX_CLIENTS];
+};
+
+/* A bounded append cursor; 'full' is set once anything did not fit. */
+typedef struct gnut_metrics_buf {
+    char *p;
+    sxs_uint32_t len;
+    sxs_uint32_t pos;
+    int full;
+} gnut_metrics_buf_t;
+
+static const char *_gnut_metrics_hist_help[GNUT_STATS_NUM_HISTS] = {
+    "Time taken to frame a message out of the bytes read.",
+    "Time a message spent in an output queue.",
+    "Time taken to route a message received and queue its copies."
+};
+
+static void _gnut_metrics_put(gnut_metrics_buf_t *b, const char *fmt, ...) {
+    va_list ap;
+    int n;
+
+    if (b->full) {
+        return;
+    }
+    va_start(ap, fmt);
+    n = vsnprintf(b->p + b->pos, b->len - b->pos, fmt, ap);
+    va_end(ap);
+    if (n < 0 || (sxs_uint32_t)n >= b->len - b->pos) {
+        b->full = 1;
+        return;
+    }
+    b->pos += (sxs_uint32_t)n;
+}
+
+static void _gnut_metrics_family(gnut_metrics_buf_t *b, const char *name,
+    const char *type, const char *help) {
+
+    _gnut_metrics_put(b, "# HELP %s %s\n# TYPE %s %s\n", name, help, name,
+        type);
+}
+
+static void _gnut_metrics_by_type(gnut_metrics_buf_t *b, const char *name,
+    const char *help, const gnut_uint64_t *v) {
+
+    int t;
+
+    _gnut_metrics_family(b, name, "counter", help);
+    for (t = 0; t < GNUT_NODE_NUM_T; t++) {
+        _gnut_metrics_put(b, "%s{type=\"%s\"} %llu\n", name,
+            gnut_stats_type_name(t), (unsigned long long)v[t]);
+    }
+}
+
+static void _gnut_metrics_hist(gnut_metrics_buf_t *b, int h,
+    const gnut_stats_hist_t *hist) {
+
+    char name[64];
+    gnut_uint64_t cum;
+    int i, e;
+
+    snprintf(name, sizeof(name), "gnut_%s_seconds", gnut_stats_hist_name(h));
+    _gnut_metrics_family(b, name, "histogram", _gnut_metrics_hist_help[h]);
+
+    /* Values are whole nanoseconds and le is inclusive, so a group is
+     * bounded by its last value, 2^(e+1) - 1, and the first by 15. */
+    cum = 0;
+    for (i = 0; i < 16; i++) {
+        cum += hist->b[i];
+    }
+    _gnut_metrics_put(b, "%s_bucket{le=\"%.12g\"} %llu\n", name, 15 / 1e9,
+        (unsigned long long)cum);
+    for (e = FIRST_EXP; e <= LAST_EXP; e++) {
+        for (i = 0; i < 16; i++) {
+            cum += hist->b[16 + (e - FIRST_EXP) * 16 + i];
+        }
+        _gnut_metrics_put(b, "%s_bucket{le=\"%.12g\"} %llu\n", name,
+            (double)(((gnut_uint64_t)1 << (e + 1)) - 1) / 1e9,
+            (unsigned long long)cum);
+    }
+    _gnut_metrics_put(b, "%s_bucket{le=\"+Inf\"} %llu\n%s_sum %.9f\n"
+        "%s_count %llu\n", name, (unsigned long long)hist->n, name,
+        hist->sum / 1e9, name, (unsigned long long)hist->n);
+}
+
+gnut_error_t gnut_metrics_render(gnut_metrics_t *m, char *buf,
+    sxs_uint32_t len, sxs_uint32_t *p_out_len) {
+
+    gnut_metrics_buf_t b;
+    gnut_stats_t *s;
+    int i;
+
+    b.p = buf;
+    b.len = len;
+    b.pos = 0;
+    b.full = (len == 0);
+    s = &m->snap;
+    gnut_stats_snapshot(s);
+
+    _gnut_metrics_by_type(&b, "gnut_received_messages_total",
+        "Messages received, by type.", s->rx_msgs);
+    _gnut_metrics_by_type(&b, "gnut_received_bytes_total",
+        "Bytes of messages received, headers included, by type.",
+        s->rx_bytes);
+    _gnut_metrics_by_type(&b, "gnut_sent_messages_total",
+        "Messages sent, by type.", s->tx_msgs);
+    _gnut_metrics_by_type(&b, "gnut_sent_bytes_total",
+        "Bytes of messages sent, headers included, by type.", s->tx_bytes);
+    _gnut_metrics_by_type(&b, "gnut_duplicate_messages_total",
+        "Messages whose Message ID was seen before, by type.", s->dup_hits);
+
+    _gnut_metrics_family(&b, "gnut_dropped_messages_total", "counter",
+        "Messages dropped, by reason.");
+    for (i = 0; i < GNUT_STATS_NUM_DROPS; i++) {
+        _gnut_metrics_put(&b, "gnut_dropped_messages_total{reason=\"%s\"} "
+            "%llu\n", gnut_stats_drop_name(i),
+            (unsigned long long)s->drops[i]);
+    }
+
+    for (i = 0; i < GNUT_STATS_NUM_HISTS; i++) {
+        _gnut_metrics_hist(&b, i, &s->hists[i]);
+    }
+
+    _gnut_metrics_family(&b, "gnut_metrics_scrapes_total", "counter",
+        "Scrapes of this endpoint.");
+    _gnut_metrics_put(&b, "gnut_metrics_scrapes_total %llu\n",
+        (unsigned long long)m->scrapes);
+
+    if (b.full) {
+        return GNUT_EBUF_TOO_SMALL;
+    }
+    *p_out_len = b.pos;
+    return GNUT_SUCCESS;
+}
+
+static void _gnut_metrics_close(gnut_metrics_client_t *cl) {
+    gnut_evloop_timer_stop(cl->m->loop, &cl->timer);
+    gnut_evloop_del(cl->m->loop, cl->sd);
+    sxs_close(cl->sd);
+    cl->busy = 0;
+}
+
+static void _gnut_metrics_flush(gnut_metrics_client_t *cl) {
+    sxs_ssize_t sent;
+    sxs_error_t err;
+
+    while (cl->out_off < cl->out_len) {
+        err = sxs_send(cl->sd, (sxs_buf_t)(cl->out + cl->out_off),
+            cl->out_len - cl->out_off, SEND_FLAGS, &sent);
+        if (err == SXS_EWOULDBLOCK || err == SXS_EINTR) {
+            if (!cl->want_write) {
+                if (gnut_evloop_mod(cl->m->loop, cl->sd, GNUT_EV_WRITE) !=
+                    GNUT_SUCCESS) {
+                    _gnut_metrics_close(cl);
+                    return;
+                }
+                cl->want_write = 1;
+            }
+            return;
+        } else if (err != SXS_SUCCESS) {
+            _gnut_metrics_close(cl);
+            return;
+        }
+        cl->out_off += (sxs_uint32_t)sent;
+    }
+    _gnut_metrics_close(cl);
+}
+
+/* Lays out a response whose body is already at out + HDR_ROOM. */
+static void _gnut_metrics_respond(gnut_metrics_client_t *cl,
+    const char *status, sxs_uint32_t body_len) {
+
+    char hdr[HDR_ROOM];
+    int n;
+
+    n = snprintf(hdr, sizeof(hdr), "HTTP/1.0 %s\r\nContent-Type: "
+        CONTENT_TYPE "\r\nContent-Length: %lu\r\nConnection: close\r\n\r\n",
+        status, (unsigned long)body_len);
+    memcpy((void *)(cl->out + HDR_ROOM - n), (const void *)hdr, n);
+    cl->out_off = HDR_ROOM - n;
+    cl->out_len = HDR_ROOM + body_len;
+    cl->writing = 1;
+    _gnut_metrics_flush(cl);
+}
+
+static void _gnut_metrics_respond_text(gnut_metrics_client_t *cl,
+    const char *status, const char *body) {
+
+    sxs_uint32_t len;
+
+    len = strlen(body);
+    memcpy((void *)(cl->out + HDR_ROOM), (const void *)body, len);
+    _gnut_metrics_respond(cl, status, len);
+}
+
+static int _gnut_metrics_is(const char *p, sxs_uint32_t len, const char *s) {
+    sxs_uint32_t n;
+
+    n = strlen(s);
+    return (len >= n && memcmp(p, s, n) == 0);
+}
+
+static void _gnut_metrics_request(gnut_metrics_client_t *cl) {
+    const char *target;
+    sxs_uint32_t i, n;
+
+    /* Nothing is answered before the end of the header, so a client
+     * never has unread bytes discarded when the socket closes. */
+    for (i = 0; i + 1 < cl->req_len; i++) {
+        if (cl->req[i] == '\n' && (cl->req[i + 1] == '\n' ||
+            (cl->req[i + 1] == '\r' && i + 2 < cl->req_len &&
+            cl->req[i + 2] == '\n'))) {
+            break;
+        }
+    }
+    if (i + 1 >= cl->req_len) {
+        if (cl->req_len == GNUT_METRICS_REQ_LEN) {
+            _gnut_metrics_respond_text(cl, "400 Bad Request",
+                "request too long\n");
+        }
+        return;
+    }
+
+    if (!_gnut_metrics_is(cl->req, cl->req_len, "GET ")) {
+        _gnut_metrics_respond_text(cl, "405 Method Not Allowed",
+            "only GET is supported\n");
+        return;
+    }
+    target = cl->req + 4;
+    n = cl->req_len - 4;
+    if (!_gnut_metrics_is(target, n, "/metrics") || n == 8 ||
+        (target[8] != ' ' && target[8] != '?' && target[8] != '\r' &&
+        target[8] != '\n')) {
+        _gnut_metrics_respond_text(cl, "404 Not Found", "try /metrics\n");
+        return;
+    }
+
+    cl->m->scrapes++;
+    if (gnut_metrics_render(cl->m, cl->out + HDR_ROOM,
+        GNUT_METRICS_OUT_LEN - HDR_ROOM, &n) != GNUT_SUCCESS) {
+        _gnut_metrics_respond_text(cl, "500 Internal Server Error",
+            "metrics do not fit the response buffer\n");
+        return;
+    }
+    _gnut_metrics_respond(cl, "200 OK", n);
+}
+
+static void _gnut_metrics_io_cb(gnut_evloop_t *loop, sxs_socket_t sd,
+    int events, void *arg) {
+
+    gnut_metrics_client_t *cl;
+    sxs_ssize_t n;
+    sxs_error_t err;
+
+    cl = (gnut_metrics_client_t *)arg;
+    if (cl->writing) {
+        _gnut_metrics_flush(cl);
+        return;
+    }
+
+    err = sxs_recv(sd, (sxs_buf_t)(cl->req + cl->req_len),
+        GNUT_METRICS_REQ_LEN - cl->req_len, 0, &n);
+    if (err == SXS_EWOULDBLOCK || err == SXS_EINTR) {
+        return;
+    } else if (err != SXS_SUCCESS || n == 0) {
+        _gnut_metrics_close(cl);
+        return;
+    }
+    cl->req_len += (sxs_uint32_t)n;
+    _gnut_metrics_request(cl);
+}
+
+static void _gnut_metrics_timeout_cb(gnut_evloop_t *loop, void *arg) {
+    _gnut_metrics_close((gnut_metrics_client_t *)arg);
+}
+
+void gnut_metrics_adopt(gnut_metrics_t *m, sxs_socket_t sd,
+    const char *data, sxs_uint32_t len) {
+
+    gnut_metrics_client_t *cl;
+    int i;
+
+    cl = NULL;
+    for (i = 0; i < GNUT_METRICS_MAX_CLIENTS; i++) {
+        if (!m->clients[i].busy) {
+            cl = &m->clients[i];
+            break;
+        }
+    }
+    if (cl == NULL || gnut_evloop_add(m->loop, sd, GNUT_EV_READ,
+        _gnut_metrics_io_cb, cl) != GNUT_SUCCESS) {
+        sxs_close(sd);
+        return;
+    }
+
+    cl->sd = sd;
+    cl->busy = 1;
+    cl->writing = 0;
+    cl->want_write = 0;
+    cl->req_len = 0;
+    if (gnut_evloop_timer_start(m->loop, &cl->timer, GNUT_METRICS_TIMEOUT,
+        _gnut_metrics_timeout_cb, cl) != GNUT_SUCCESS) {
+        _gnut_metrics_close(cl);
+        return;
+    }
+    if (len > 0) {
+        if (len > GNUT_METRICS_REQ_LEN) {
+            len = GNUT_METRICS_REQ_LEN;
+        }
+        memcpy((void *)cl->req, (const void *)data, len);
+        cl->req_len = len;
+        _gnut_metrics_request(cl);
+    }
+}
+
+static void _gnut_metrics_accept_cb(gnut_evloop_t *loop, sxs_socket_t sd,
+    int events, void *arg) {
+
+    gnut_metrics_t *m;
+    struct sockaddr_in addr;
+    sxs_socklen_t addr_len;
+    sxs_socket_t new_sd;
+
+    m = (gnut_metrics_t *)arg;
+    for (;;) {
+        addr_len = sizeof(addr);
+        if (sxs_accept(sd, (struct sockaddr *)&addr, &addr_len, &new_sd) !=
+            SXS_SUCCESS) {
+            break;
+        }
+        if (sxs_set_nonblock(new_sd, 1) != SXS_SUCCESS) {
+            sxs_close(new_sd);
+            continue;
+        }
+        gnut_metrics_adopt(m, new_sd, NULL, 0);
+    }
+}
+
+gnut_error_t gnut_metrics_new(gnut_metrics_t **pp_m, gnut_evloop_t *loop) {
+    gnut_metrics_t *m;
+    int i;
+
+    m = (gnut_metrics_t *)calloc(1, sizeof(gnut_metrics_t));
+    if (m == NULL) {
+        return GNUT_ENOMEM;
+    }
+    m->loop = loop;
+    for (i = 0; i < GNUT_METRICS_MAX_CLIENTS; i++) {
+        m->clients[i].m = m;
+        gnut_timer_init(&m->clients[i].timer);
+    }
+
+    *pp_m = m;
+    return GNUT_SUCCESS;
+}
+
+void gnut_metrics_free(gnut_metrics_t *m) {
+    int i;
+
+    for (i = 0; i < GNUT_METRICS_MAX_CLIENTS; i++) {
+        if (m->clients[i].busy) {
+            _gnut_metrics_close(&m->clients[i]);
+        }
+    }
+    if (m->listening) {
+        gnut_evloop_del(m->loop, m->lsd);
+        sxs_close(m->lsd);
+    }
+    free(m);
+}
+
+gnut_error_t gnut_metrics_listen(gnut_metrics_t *m, sxs_socket_t lsd) {
+    if (gnut_evloop_add(m->loop, lsd, GNUT_EV_READ, _gnut_metrics_accept_cb,
+        m) != GNUT_SUCCESS) {
+        sxs_close(lsd);
+        return GNUT_EEVLOOP;
+    }
+    m->lsd = lsd;
+    m->listening = 1;
+    return GNUT_SUCCESS;
+}
@@ -0,0 +1,128 @@
+/*
+ * Copyright 2006-2007 Andrew De Ponte
+ *
+ * This file is part of lib_gnut.
+ *
+ * lib_gnut is the intellectual property of Andrew De Ponte; any
+ * distribution and/or modification and/or reproductions of any portion
+ * of lib_gnut MUST be approved by Andrew De Ponte.
+ *
+ * lib_gnut is distributed WITHOUT ANY WARRANTY; without even the
+ * implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE.
+ */
+
+/**
+ * @file gnut_metrics.h
+ * @brief This is a specifications file for the metrics endpoint.
+ *
+ * The gnut_metrics.h file is a specifications file that declares the
+ * gnut_metrics_t type and its associated functions. A metrics endpoint
+ * answers HTTP requests for /metrics on an event loop with a snapshot
+ * of the traffic statistics in the Prometheus text format. Requests
+ * may arrive on a listener of its own, or on the Gnutella listener,
+ * whose connections hand over any that open with an HTTP GET. All the
+ * memory a scrape needs is allocated when the endpoint is created.
+ */
+
+#ifndef GNUT_METRICS_H
+#define GNUT_METRICS_H
+
+#include <sxs/sxs.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+#include "gnut_export.h"
+#include "gnut_types.h"
+#include "gnut_error.h"
+#include "gnut_evloop.h"
+
+#define GNUT_METRICS_MAX_CLIENTS 4 /**< Scrapes served at once */
+#define GNUT_METRICS_REQ_LEN 1024 /**< Longest request accepted */
+#define GNUT_METRICS_OUT_LEN 32768 /**< Longest response sent */
+#define GNUT_METRICS_TIMEOUT 5000000 /**< Microseconds to serve a client */
+
+/**
+ * A Metrics Endpoint
+ *
+ * The gnut_metrics_t is an opaque type which represents a metrics
+ * endpoint.
+ */
+typedef struct gnut_metrics gnut_metrics_t;
+
+/**
+ * Create a Metrics Endpoint
+ *
+ * The gnut_metrics_new() function creates an endpoint on 'loop' with
+ * room for GNUT_METRICS_MAX_CLIENTS clients at a time, and no listener.
+ * @param pp_m Pointer to store the pointer to the new endpoint in.
+ * @param loop Pointer to the event loop to serve on.
+ * @return A value representing an error or success.
+ * @retval GNUT_SUCCESS Successfully created the endpoint.
+ * @retval GNUT_ENOMEM Failed to allocate memory.
+ */
+GNUT_EXPORT gnut_error_t gnut_metrics_new(gnut_metrics_t **pp_m,
+    gnut_evloop_t *loop);
+
+/**
+ * Free a Metrics Endpoint
+ *
+ * The gnut_metrics_free() function closes the endpoint's listener and
+ * clients, and frees it.
+ * @param m Pointer to the endpoint.
+ */
+GNUT_EXPORT void gnut_metrics_free(gnut_metrics_t *m);
+
+/**
+ * Listen for Metrics Requests
+ *
+ * The gnut_metrics_listen() function takes ownership of the bound,
+ * listening, non-blocking socket 'lsd' and serves the connections
+ * made to it.
+ * @param m Pointer to the endpoint, which must not be listening yet.
+ * @param lsd The listening socket.
+ * @return A value representing an error or success.
+ * @retval GNUT_SUCCESS Successfully started listening.
+ * @retval GNUT_EEVLOOP Failed to register the socket, which is closed.
+ */
+GNUT_EXPORT gnut_error_t gnut_metrics_listen(gnut_metrics_t *m,
+    sxs_socket_t lsd);
+
+/**
+ * Hand a Connection to a Metrics Endpoint
+ *
+ * The gnut_metrics_adopt() function takes ownership of the connected,
+ * non-blocking socket 'sd' on which 'len' bytes of a request were
+ * already read, and serves it. The socket is closed right away if all
+ * the clients are busy.
+ * @param m Pointer to the endpoint.
+ * @param sd The socket.
+ * @param data Pointer to the bytes already read, or NULL if none were.
+ * @param len The number of bytes already read.
+ */
+GNUT_EXPORT void gnut_metrics_adopt(gnut_metrics_t *m, sxs_socket_t sd,
+    const char *data, sxs_uint32_t len);
+
+/**
+ * Render the Metrics
+ *
+ * The gnut_metrics_render() function takes a snapshot of the traffic
+ * statistics and writes it to 'buf' in the Prometheus text format.
+ * @param m Pointer to the endpoint, whose snapshot space is used.
+ * @param buf Pointer to the buffer to write to.
+ * @param len The size of the buffer.
+ * @param p_out_len Pointer to store the number of bytes written in.
+ * @return A value representing an error or success.
+ * @retval GNUT_SUCCESS Successfully rendered the metrics.
+ * @retval GNUT_EBUF_TOO_SMALL The buffer is too small.
+ */
+GNUT_EXPORT gnut_error_t gnut_metrics_render(gnut_metrics_t *m, char *buf,
+    sxs_uint32_t len, sxs_uint32_t *p_out_len);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* GNUT_METRICS_H */
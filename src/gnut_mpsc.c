@@ -0,0 +1,237 @@
+/*
+ * Copyright 2006-2007 Andrew De Ponte
+ *
+ * This file is part of lib_gnut.
+ *
+ * lib_gnut is the intellectual property of Andrew De Ponte; any
+ * distribution and/or modification and/or reproductions of any portion
+ * of lib_gnut MUST be approved by Andrew De Ponte.
+ *
+ * lib_gnut is distributed WITHOUT ANY WARRANTY; without even the
+ * implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE.
+ */
+
+/**
+ * @file gnut_mpsc.c
+ * @brief This is an implementation file for the MPSC ring.
+ *
+ * The gnut_mpsc.c file is an implementation file that defines the
+ * gnut_mpsc_t type's associated functions.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdlib.h> /* calloc(), free() */
+#include <unistd.h> /* read(), write(), close(), pipe() */
+#include <fcntl.h> /* fcntl() */
+#include <poll.h> /* poll() */
+#ifdef HAVE_SYS_EVENTFD_H
+#include <sys/eventfd.h>
+#endif
+
+#include "gnut_mpsc.h"
+#include "gnut_atomic.h"
+
+gnut_error_t gnut_mpsc_init(gnut_mpsc_t *q, sxs_uint32_t capacity) {
+    sxs_uint32_t size;
+#ifndef HAVE_SYS_EVENTFD_H
+    int fds[2];
+#endif
+
+    size = 2;
+    while (size < capacity) {
+        size <<= 1;
+    }
+
+    /* Every seq starts at 0, which never equals pos + 1 on the first
+     * lap, so all slots begin empty. */
+    q->slots = (gnut_mpsc_slot_t *)calloc(size, sizeof(gnut_mpsc_slot_t));
+    if (q->slots == NULL) {
+        return GNUT_ENOMEM;
+    }
+    q->mask = size - 1;
+    q->tail = q->head_cache = 0;
+    q->head = 0;
+    q->sleeping = 0;
+
+#ifdef HAVE_SYS_EVENTFD_H
+    q->wake_rd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    q->wake_wr = q->wake_rd;
+    if (q->wake_rd < 0) {
+        free(q->slots);
+        return GNUT_EEVLOOP;
+    }
+#else
+    if (pipe(fds) != 0) {
+        free(q->slots);
+        return GNUT_EEVLOOP;
+    }
+    q->wake_rd = fds[0];
+    q->wake_wr = fds[1];
+    fcntl(fds[0], F_SETFL, fcntl(fds[0], F_GETFL) | O_NONBLOCK);
+    fcntl(fds[1], F_SETFL, fcntl(fds[1], F_GETFL) | O_NONBLOCK);
+#endif
+
+    return GNUT_SUCCESS;
+}
+
+void gnut_mpsc_destroy(gnut_mpsc_t *q) {
+    close(q->wake_rd);
+    if (q->wake_wr != q->wake_rd) {
+        close(q->wake_wr);
+    }
+    free(q->slots);
+    q->slots = NULL;
+}
+
+/* Signal the consumer if it announced that it is going to sleep. The
+ * fence orders the slot stores before the load of 'sleeping', pairing
+ * with the one in gnut_mpsc_prepare_sleep(). */
+static void _gnut_mpsc_signal(gnut_mpsc_t *q) {
+#ifdef HAVE_SYS_EVENTFD_H
+    gnut_uint64_t one = 1;
+#else
+    unsigned char one = 1;
+#endif
+
+    GNUT_ATOMIC_FENCE();
+    if (GNUT_ATOMIC_LOAD_RLX(&q->sleeping) &&
+        GNUT_ATOMIC_XCHG(&q->sleeping, 0)) {
+        if (write(q->wake_wr, &one, sizeof(one)) < 0) {
+            /* The channel is full, so the consumer is waking anyway. */
+        }
+    }
+}
+
+gnut_error_t gnut_mpsc_push_batch(gnut_mpsc_t *q, void *const *items,
+    sxs_uint32_t num, sxs_uint32_t *p_pushed) {
+
+    sxs_uint32_t pos, head, size, cnt, i;
+    sxs_int32_t used;
+
+    size = q->mask + 1;
+    pos = GNUT_ATOMIC_LOAD_RLX(&q->tail);
+    for (;;) {
+        head = GNUT_ATOMIC_LOAD_RLX(&q->head_cache);
+        used = (sxs_int32_t)(pos - head);
+        if (used < 0 || num > size || (sxs_uint32_t)used > size - num) {
+            /* Only touch the consumer's cache line when the cached
+             * head says the ring is too full. */
+            head = GNUT_ATOMIC_LOAD_ACQ(&q->head);
+            GNUT_ATOMIC_STORE_RLX(&q->head_cache, head);
+            used = (sxs_int32_t)(pos - head);
+            if (used < 0) {
+                /* 'pos' is stale; another producer moved on. */
+                pos = GNUT_ATOMIC_LOAD_RLX(&q->tail);
+                continue;
+            }
+        }
+        cnt = size - (sxs_uint32_t)used;
+        if (cnt > num) {
+            cnt = num;
+        }
+        if (cnt == 0) {
+            *p_pushed = 0;
+            return GNUT_EQUEUE_FULL;
+        }
+        if (GNUT_ATOMIC_CAS(&q->tail, &pos, pos + cnt)) {
+            break;
+        }
+    }
+
+    for (i = 0; i < cnt; i++) {
+        q->slots[(pos + i) & q->mask].item = items[i];
+        GNUT_ATOMIC_STORE_REL(&q->slots[(pos + i) & q->mask].seq,
+            pos + i + 1);
+    }
+    _gnut_mpsc_signal(q);
+
+    *p_pushed = cnt;
+    return (cnt == num) ? GNUT_SUCCESS : GNUT_EQUEUE_FULL;
+}
+
+gnut_error_t gnut_mpsc_push(gnut_mpsc_t *q, void *item) {
+    sxs_uint32_t pushed;
+
+    return gnut_mpsc_push_batch(q, &item, 1, &pushed);
+}
+
+sxs_uint32_t gnut_mpsc_pop_batch(gnut_mpsc_t *q, void **items,
+    sxs_uint32_t max) {
+
+    gnut_mpsc_slot_t *slot;
+    sxs_uint32_t head, i;
+
+    head = q->head;
+    for (i = 0; i < max; i++) {
+        slot = &q->slots[(head + i) & q->mask];
+        if (GNUT_ATOMIC_LOAD_ACQ(&slot->seq) != head + i + 1) {
+            break;
+        }
+        items[i] = slot->item;
+    }
+    if (i > 0) {
+        GNUT_ATOMIC_STORE_REL(&q->head, head + i);
+    }
+
+    return i;
+}
+
+void *gnut_mpsc_pop(gnut_mpsc_t *q) {
+    void *item;
+
+    if (gnut_mpsc_pop_batch(q, &item, 1) == 0) {
+        return NULL;
+    }
+    return item;
+}
+
+int gnut_mpsc_wake_fd(const gnut_mpsc_t *q) {
+    return q->wake_rd;
+}
+
+int gnut_mpsc_prepare_sleep(gnut_mpsc_t *q) {
+    gnut_mpsc_slot_t *slot;
+
+    GNUT_ATOMIC_STORE_RLX(&q->sleeping, 1);
+    GNUT_ATOMIC_FENCE();
+
+    slot = &q->slots[q->head & q->mask];
+    if (GNUT_ATOMIC_LOAD_ACQ(&slot->seq) == q->head + 1) {
+        /* A producer may already have signalled; the extra wakeup is
+         * harmless. */
+        GNUT_ATOMIC_STORE_RLX(&q->sleeping, 0);
+        return 0;
+    }
+
+    return 1;
+}
+
+void gnut_mpsc_clear_wake(gnut_mpsc_t *q) {
+    unsigned char buf[64];
+
+    while (read(q->wake_rd, buf, sizeof(buf)) > 0) {
+        /* drain */
+    }
+    GNUT_ATOMIC_STORE_RLX(&q->sleeping, 0);
+}
+
+int gnut_mpsc_wait(gnut_mpsc_t *q, gnut_uint64_t timeout_us) {
+    struct pollfd pfd;
+    int n;
+
+    if (!gnut_mpsc_prepare_sleep(q)) {
+        return 1;
+    }
+
+    pfd.fd = q->wake_rd;
+    pfd.events = POLLIN;
+    pfd.revents = 0;
+    n = poll(&pfd, 1, (int)((timeout_us + 999) / 1000));
+    gnut_mpsc_clear_wake(q);
+
+    return (n > 0) ? 1 : 0;
+}
@@ -0,0 +1,210 @@
+/*
+ * Copyright 2006-2007 Andrew De Ponte
+ *
+ * This file is part of lib_gnut.
+ *
+ * lib_gnut is the intellectual property of Andrew De Ponte; any
+ * distribution and/or modification and/or reproductions of any portion
+ * of lib_gnut MUST be approved by Andrew De Ponte.
+ *
+ * lib_gnut is distributed WITHOUT ANY WARRANTY; without even the
+ * implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE.
+ */
+
+/**
+ * @file gnut_mpsc.h
+ * @brief This is a specifications file for the MPSC ring.
+ *
+ * The gnut_mpsc.h file is a specifications file that declares the
+ * gnut_mpsc_t type, a bounded lock-free ring of pointers which any
+ * number of producer threads may push onto and exactly one consumer
+ * thread pops from. A consumer with nothing to do can sleep on the
+ * ring's wakeup descriptor, either directly with gnut_mpsc_wait() or
+ * by registering it with an event loop.
+ */
+
+#ifndef GNUT_MPSC_H
+#define GNUT_MPSC_H
+
+#include <sxs/sxs.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+#include "gnut_export.h"
+#include "gnut_types.h"
+#include "gnut_error.h"
+
+/**
+ * An MPSC Ring Slot
+ *
+ * The gnut_mpsc_slot_t is a type which represents one slot of a ring.
+ * A producer publishes an item at position 'pos' by storing pos + 1 in
+ * 'seq', which is how the consumer tells a filled slot from one left
+ * over from the previous lap.
+ */
+typedef struct GNUT_EXPORT gnut_mpsc_slot {
+    sxs_uint32_t seq;
+    void *item;
+} gnut_mpsc_slot_t;
+
+/**
+ * A Multiple Producer Single Consumer Ring
+ *
+ * The gnut_mpsc_t is a type which represents a bounded ring of
+ * pointers. Producers reserve slots by advancing 'tail' with a compare
+ * and swap, so a batch costs one atomic operation however many items
+ * it holds. The producer, consumer and wakeup state each sit on their
+ * own cache line.
+ */
+typedef struct GNUT_EXPORT gnut_mpsc {
+    /* Producer side */
+    sxs_uint32_t tail __attribute__((aligned(64)));
+    sxs_uint32_t head_cache;    /* A recent, possibly stale, 'head' */
+    /* Consumer side */
+    sxs_uint32_t head __attribute__((aligned(64)));
+    /* Wakeup state */
+    int sleeping __attribute__((aligned(64)));
+    /* Read only after init */
+    sxs_uint32_t mask __attribute__((aligned(64)));
+    gnut_mpsc_slot_t *slots;
+    int wake_rd;
+    int wake_wr;
+} gnut_mpsc_t;
+
+/**
+ * Initialize an MPSC Ring
+ *
+ * The gnut_mpsc_init() function initializes an empty ring able to hold
+ * 'capacity' items, rounded up to a power of two, along with its
+ * wakeup descriptor.
+ * @param q Pointer to the ring to initialize.
+ * @param capacity The minimum number of items the ring must hold.
+ * @return A value representing an error or success.
+ * @retval GNUT_SUCCESS Successfully initialized the ring.
+ * @retval GNUT_ENOMEM Failed to allocate the slots.
+ * @retval GNUT_EEVLOOP Failed to create the wakeup descriptor.
+ */
+GNUT_EXPORT gnut_error_t gnut_mpsc_init(gnut_mpsc_t *q,
+    sxs_uint32_t capacity);
+
+/**
+ * Destroy an MPSC Ring
+ *
+ * The gnut_mpsc_destroy() function frees the slots and closes the
+ * wakeup descriptor of the ring. Items still in the ring are not
+ * touched.
+ * @param q Pointer to the ring.
+ */
+GNUT_EXPORT void gnut_mpsc_destroy(gnut_mpsc_t *q);
+
+/**
+ * Push onto an MPSC Ring
+ *
+ * The gnut_mpsc_push() function appends 'item'. Any thread may call
+ * it.
+ * @param q Pointer to the ring.
+ * @param item The item to append, which must not be NULL.
+ * @return A value representing an error or success.
+ * @retval GNUT_SUCCESS Successfully appended the item.
+ * @retval GNUT_EQUEUE_FULL The ring is full.
+ */
+GNUT_EXPORT gnut_error_t gnut_mpsc_push(gnut_mpsc_t *q, void *item);
+
+/**
+ * Push a Batch onto an MPSC Ring
+ *
+ * The gnut_mpsc_push_batch() function appends as many of the 'num'
+ * items in 'items' as fit, in order, reserving their slots with a
+ * single atomic operation. Any thread may call it.
+ * @param q Pointer to the ring.
+ * @param items Array of items to append, none of which may be NULL.
+ * @param num The number of items in 'items'.
+ * @param p_pushed Pointer to store the number of items appended in.
+ * @return A value representing an error or success.
+ * @retval GNUT_SUCCESS Successfully appended all of the items.
+ * @retval GNUT_EQUEUE_FULL The ring filled up; only the first
+ * '*p_pushed' items were appended.
+ */
+GNUT_EXPORT gnut_error_t gnut_mpsc_push_batch(gnut_mpsc_t *q,
+    void *const *items, sxs_uint32_t num, sxs_uint32_t *p_pushed);
+
+/**
+ * Pop from an MPSC Ring
+ *
+ * The gnut_mpsc_pop() function removes and returns the oldest item.
+ * Only the consumer thread may call it.
+ * @param q Pointer to the ring.
+ * @return The oldest item, or NULL if the ring is empty.
+ */
+GNUT_EXPORT void *gnut_mpsc_pop(gnut_mpsc_t *q);
+
+/**
+ * Pop a Batch from an MPSC Ring
+ *
+ * The gnut_mpsc_pop_batch() function removes up to 'max' of the oldest
+ * items and stores them in 'items'. It stops early at a slot whose
+ * producer has reserved it but not yet filled it in. Only the consumer
+ * thread may call it.
+ * @param q Pointer to the ring.
+ * @param items Array to store the items in.
+ * @param max The number of entries in 'items'.
+ * @return The number of items removed.
+ */
+GNUT_EXPORT sxs_uint32_t gnut_mpsc_pop_batch(gnut_mpsc_t *q, void **items,
+    sxs_uint32_t max);
+
+/**
+ * Get an MPSC Ring's Wakeup Descriptor
+ *
+ * The gnut_mpsc_wake_fd() function returns the descriptor that becomes
+ * readable when a producer pushes onto the ring while the consumer is
+ * sleeping, for registering with an event loop.
+ * @param q Pointer to the ring.
+ * @return The readable end of the wakeup descriptor.
+ */
+GNUT_EXPORT int gnut_mpsc_wake_fd(const gnut_mpsc_t *q);
+
+/**
+ * Prepare an MPSC Ring's Consumer to Sleep
+ *
+ * The gnut_mpsc_prepare_sleep() function tells producers that the
+ * consumer is about to block on the wakeup descriptor, then checks the
+ * ring once more. Any push that the check misses will signal the
+ * descriptor, so no wakeup is lost. Producers only pay for signalling
+ * while the consumer is sleeping.
+ * @param q Pointer to the ring.
+ * @return 1 if the ring is empty and the consumer may block, or 0 if
+ * items arrived and it should pop them instead.
+ */
+GNUT_EXPORT int gnut_mpsc_prepare_sleep(gnut_mpsc_t *q);
+
+/**
+ * Acknowledge an MPSC Ring Wakeup
+ *
+ * The gnut_mpsc_clear_wake() function drains the wakeup descriptor and
+ * tells producers the consumer is awake. The consumer calls it when the
+ * descriptor becomes readable, before popping.
+ * @param q Pointer to the ring.
+ */
+GNUT_EXPORT void gnut_mpsc_clear_wake(gnut_mpsc_t *q);
+
+/**
+ * Wait for an MPSC Ring
+ *
+ * The gnut_mpsc_wait() function blocks the consumer until the ring is
+ * not empty or 'timeout_us' microseconds pass. It is for consumers that
+ * do not run an event loop.
+ * @param q Pointer to the ring.
+ * @param timeout_us Maximum time to block in microseconds.
+ * @return 1 if the ring may have items, or 0 on timeout.
+ */
+GNUT_EXPORT int gnut_mpsc_wait(gnut_mpsc_t *q, gnut_uint64_t timeout_us);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* GNUT_MPSC_H */
@@ -20,25 +20,102 @@
  * functions and types which compose the general API for lib_gnut.
  */
 
-#include <stdlib.h> /* NULL, srand(), rand() */
-#include <time.h> /* time() */
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdlib.h> /* NULL, malloc() */
+#include <string.h> /* memcpy() */
+#ifndef HAVE_TLS
+#include <pthread.h>
+#endif
 
 #include "gnut_msgs.h"
+#include "gnut_guid.h"
+#include "gnut_probes.h"
+
+GNUT_PROBE_SEMAPHORE(hdr_decode);
+
+/* Each thread lazily gets its own generator so that building Message
+ * IDs never touches shared state such as that behind rand(). */
+#ifdef HAVE_TLS
+static __thread gnut_guid_gen_t tls_guid_gen;
+static __thread int tls_guid_gen_ready = 0;
+
+static gnut_guid_gen_t *_gnut_msgs_guid_gen(void) {
+    if (!tls_guid_gen_ready) {
+        gnut_guid_gen_init(&tls_guid_gen);
+        tls_guid_gen_ready = 1;
+    }
+    return &tls_guid_gen;
+}
+#else
+static pthread_once_t _gnut_msgs_once = PTHREAD_ONCE_INIT;
+static pthread_key_t _gnut_msgs_key;
+
+static void _gnut_msgs_key_init(void) {
+    pthread_key_create(&_gnut_msgs_key, free);
+}
+
+static gnut_guid_gen_t *_gnut_msgs_guid_gen(void) {
+    gnut_guid_gen_t *gen;
+
+    pthread_once(&_gnut_msgs_once, _gnut_msgs_key_init);
+    gen = (gnut_guid_gen_t *)pthread_getspecific(_gnut_msgs_key);
+    if (gen == NULL) {
+        gen = (gnut_guid_gen_t *)malloc(sizeof(gnut_guid_gen_t));
+        if (gen == NULL) {
+            return NULL;
+        }
+        gnut_guid_gen_init(gen);
+        pthread_setspecific(_gnut_msgs_key, gen);
+    }
+    return gen;
+}
+#endif
 
 gnut_error_t gnut_build_msg_id(gnut_msg_hdr_t *p_header) {
-    int i;
+    gnut_guid_gen_t *gen;
+
+    gen = _gnut_msgs_guid_gen();
+    if (gen == NULL) {
+        return GNUT_ENOMEM;
+    }
+
+    gnut_guid_gen_fill(gen, p_header->message_id);
+
+    return GNUT_SUCCESS;
+}
 
-    srand((unsigned int)time(NULL));
+gnut_error_t gnut_build_oob_msg_id(gnut_msg_hdr_t *p_header, sxs_uint32_t ip,
+    sxs_uint16_t port) {
 
-    for (i = 0; i < GNUT_MSG_ID_LEN; i++) {
-        p_header->message_id[i] = (char)(rand() % 255);
+    gnut_error_t reterr;
+
+    reterr = gnut_build_msg_id(p_header);
+    if (reterr != GNUT_SUCCESS) {
+        return reterr;
     }
-    p_header->message_id[8] = 0xff;
-    p_header->message_id[15] = 0x00;
-    
+    gnut_msg_id_set_oob_addr(p_header->message_id, ip, port);
+
     return GNUT_SUCCESS;
 }
 
+void gnut_msg_id_set_oob_addr(unsigned char *message_id, sxs_uint32_t ip,
+    sxs_uint16_t port) {
+
+    memcpy((void *)message_id, (const void *)&ip, 4);
+    message_id[13] = (unsigned char)(port & 0xff);
+    message_id[14] = (unsigned char)(port >> 8);
+}
+
+void gnut_msg_id_oob_addr(const unsigned char *message_id,
+    sxs_uint32_t *p_ip, sxs_uint16_t *p_port) {
+
+    memcpy((void *)p_ip, (const void *)message_id, 4);
+    *p_port = (sxs_uint16_t)(message_id[13] | (message_id[14] << 8));
+}
+
 gnut_error_t gnut_build_msg_hdr(gnut_msg_hdr_t *p_header, unsigned char type,
     sxs_uint32_t pl_len) {
 
@@ -71,3 +148,30 @@ gnut_error_t gnut_build_msg_hdr_given_msg_id(gnut_msg_hdr_t *p_header,
 
     return GNUT_SUCCESS;
 }
+
+void gnut_encode_msg_hdr(const gnut_msg_hdr_t *p_header, unsigned char *buf) {
+    memcpy((void *)buf, (const void *)p_header->message_id,
+        GNUT_MSG_ID_LEN);
+    buf[16] = p_header->type;
+    buf[17] = p_header->ttl;
+    buf[18] = p_header->hops;
+    buf[19] = (unsigned char)(p_header->pl_len & 0xff);
+    buf[20] = (unsigned char)((p_header->pl_len >> 8) & 0xff);
+    buf[21] = (unsigned char)((p_header->pl_len >> 16) & 0xff);
+    buf[22] = (unsigned char)((p_header->pl_len >> 24) & 0xff);
+}
+
+void gnut_decode_msg_hdr(const unsigned char *buf, gnut_msg_hdr_t *p_header) {
+    memcpy((void *)p_header->message_id, (const void *)buf,
+        GNUT_MSG_ID_LEN);
+    p_header->type = buf[16];
+    p_header->ttl = buf[17];
+    p_header->hops = buf[18];
+    p_header->pl_len = (sxs_uint32_t)buf[19] |
+        ((sxs_uint32_t)buf[20] << 8) |
+        ((sxs_uint32_t)buf[21] << 16) |
+        ((sxs_uint32_t)buf[22] << 24);
+    GNUT_PROBE5(hdr_decode, p_header->type,
+        GNUT_PROBE_GUID(p_header->message_id), p_header->pl_len,
+        p_header->ttl, p_header->hops);
+}
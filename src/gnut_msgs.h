@@ -40,6 +40,16 @@ extern "C" {
 #define GNUT_MSG_ID_LEN 16 /**< Length of Message ID in bytes */
 #define GNUT_INITIAL_TTL 0x07 /**< Initial TTL (time-to-live) */
 #define GNUT_INITIAL_HOPS 0x00 /**< Initial HOPS */
+#define GNUT_MSG_HDR_LEN 23 /**< Length of an encoded Message Header */
+
+#define GNUT_MSG_PING 0x00 /**< Ping Payload Type */
+#define GNUT_MSG_PONG 0x01 /**< Pong Payload Type */
+#define GNUT_MSG_BYE 0x02 /**< Bye Payload Type */
+#define GNUT_MSG_PUSH 0x40 /**< Push Payload Type */
+#define GNUT_MSG_QUERY 0x80 /**< Query Payload Type */
+#define GNUT_MSG_QUERY_HIT 0x81 /**< Query Hit Payload Type */
+#define GNUT_MSG_VENDOR 0x31 /**< Vendor Message Payload Type */
+#define GNUT_MSG_VENDOR_STD 0x32 /**< Standard Vendor Message Type */
 
 /**
  * A Gnutella Message Header
@@ -85,13 +95,59 @@ typedef struct GNUT_EXPORT gnut_msg {
  * to. The Message ID is 16 bytes consisting of bytes which are all
  * assigned random values, except for byte 8 which has a value of 0xff
  * and byte 15 which has a value of 0x00. Note: The bytes are number
- * 0-15.
+ * 0-15. The random bytes come from a generator private to the calling
+ * thread, so the function may be called from several threads at once.
  * @param p_header Pointer to message header to store Message ID in.
  * @return A value representing an error or success.
  * @retval GNUT_SUCCESS Successfully built message id.
+ * @retval GNUT_ENOMEM Failed to allocate this thread's generator.
  */
 GNUT_EXPORT gnut_error_t gnut_build_msg_id(gnut_msg_hdr_t *p_header);
 
+/**
+ * Build an Address Encoded Gnutella Message ID
+ *
+ * The gnut_build_oob_msg_id() function builds a Message ID as
+ * gnut_build_msg_id() does and then encodes the address Query Hits may
+ * be sent to out of band in it: the IP address in bytes 0-3, in network
+ * byte order, and the port in bytes 13-14, in little-endian byte order.
+ * Bytes 8 and 15 keep their values.
+ * @param p_header Pointer to message header to store Message ID in.
+ * @param ip The IP address in network byte order.
+ * @param port The UDP port.
+ * @return A value representing an error or success.
+ * @retval GNUT_SUCCESS Successfully built message id.
+ * @retval GNUT_ENOMEM Failed to allocate this thread's generator.
+ */
+GNUT_EXPORT gnut_error_t gnut_build_oob_msg_id(gnut_msg_hdr_t *p_header,
+    sxs_uint32_t ip, sxs_uint16_t port);
+
+/**
+ * Encode an Address in a Gnutella Message ID
+ *
+ * The gnut_msg_id_set_oob_addr() function overwrites the bytes of the
+ * Message ID 'message_id' which gnut_build_oob_msg_id() encodes the
+ * address in, leaving the others as they are.
+ * @param message_id Pointer to the GNUT_MSG_ID_LEN bytes of Message ID.
+ * @param ip The IP address in network byte order.
+ * @param port The UDP port.
+ */
+GNUT_EXPORT void gnut_msg_id_set_oob_addr(unsigned char *message_id,
+    sxs_uint32_t ip, sxs_uint16_t port);
+
+/**
+ * Decode the Address of a Gnutella Message ID
+ *
+ * The gnut_msg_id_oob_addr() function reads the address that
+ * gnut_build_oob_msg_id() encodes in a Message ID. Any Message ID has
+ * one; only a Query flagged as wanting out of band replies means it.
+ * @param message_id Pointer to the GNUT_MSG_ID_LEN bytes of Message ID.
+ * @param p_ip Pointer to store the IP address in, in network byte order.
+ * @param p_port Pointer to store the UDP port in.
+ */
+GNUT_EXPORT void gnut_msg_id_oob_addr(const unsigned char *message_id,
+    sxs_uint32_t *p_ip, sxs_uint16_t *p_port);
+
 /**
  * Build a Gnutella Message Header
  *
@@ -128,6 +184,30 @@ GNUT_EXPORT gnut_error_t gnut_build_msg_hdr_given_msg_id(
     gnut_msg_hdr_t *p_header, const unsigned char *message_id,
     unsigned char type, sxs_uint32_t pl_len);
 
+/**
+ * Encode a Gnutella Message Header
+ *
+ * The gnut_encode_msg_hdr() function writes the header that 'p_header'
+ * points to in its wire format, with the payload length in
+ * little-endian byte order, into the GNUT_MSG_HDR_LEN bytes at 'buf'.
+ * @param p_header Pointer to message header to encode.
+ * @param buf Pointer to at least GNUT_MSG_HDR_LEN bytes to write to.
+ */
+GNUT_EXPORT void gnut_encode_msg_hdr(const gnut_msg_hdr_t *p_header,
+    unsigned char *buf);
+
+/**
+ * Decode a Gnutella Message Header
+ *
+ * The gnut_decode_msg_hdr() function reads a header in its wire format
+ * from the GNUT_MSG_HDR_LEN bytes at 'buf' into the header structure
+ * that 'p_header' points to.
+ * @param buf Pointer to at least GNUT_MSG_HDR_LEN bytes to read from.
+ * @param p_header Pointer to message header to fill in.
+ */
+GNUT_EXPORT void gnut_decode_msg_hdr(const unsigned char *buf,
+    gnut_msg_hdr_t *p_header);
+
 #ifdef __cplusplus
 }
 #endif /* __cplusplus */
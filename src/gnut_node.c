@@ -0,0 +1,257 @@
+/*
+ * Copyright 2006-2007 Andrew De Ponte
+ *
+ * This file is part of lib_gnut.
+ *
+ * lib_gnut is the intellectual property of Andrew De Ponte; any
+ * distribution and/or modification and/or reproductions of any portion
+ * of lib_gnut MUST be approved by Andrew De Ponte.
+ *
+ * lib_gnut is distributed WITHOUT ANY WARRANTY; without even the
+ * implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE.
+ */
+
+/**
+ * @file gnut_node.c
+ * @brief This is an implementation file for the message dispatcher.
+ *
+ * The gnut_node.c file is an implementation file that defines the
+ * gnut_node_t type's associated functions.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <string.h> /* memset(), memcpy(), memcmp() */
+
+#include "gnut_node.h"
+#include "gnut_stats.h"
+#include "gnut_probes.h"
+
+GNUT_PROBE_SEMAPHORE(dispatch);
+GNUT_PROBE_SEMAPHORE(dedupe);
+GNUT_PROBE_SEMAPHORE(route);
+
+int gnut_node_type_index(unsigned char type) {
+    switch (type) {
+        case GNUT_MSG_PING:
+            return GNUT_NODE_T_PING;
+        case GNUT_MSG_PONG:
+            return GNUT_NODE_T_PONG;
+        case GNUT_MSG_BYE:
+            return GNUT_NODE_T_BYE;
+        case GNUT_MSG_PUSH:
+            return GNUT_NODE_T_PUSH;
+        case GNUT_MSG_QUERY:
+            return GNUT_NODE_T_QUERY;
+        case GNUT_MSG_QUERY_HIT:
+            return GNUT_NODE_T_QUERY_HIT;
+        default:
+            return GNUT_NODE_T_OTHER;
+    }
+}
+
+gnut_error_t gnut_node_init(gnut_node_t *node, sxs_uint32_t route_capacity,
+    gnut_node_fwd_cb_t forward, gnut_node_deliver_cb_t deliver, void *arg) {
+
+    gnut_msg_hdr_t tmp;
+
+    memset(node, 0, sizeof(gnut_node_t));
+    if (gnut_route_init(&node->pings, route_capacity) != GNUT_SUCCESS ||
+        gnut_route_init(&node->queries, route_capacity) != GNUT_SUCCESS ||
+        gnut_route_init(&node->pushes, route_capacity) != GNUT_SUCCESS) {
+        gnut_node_destroy(node);
+        return GNUT_ENOMEM;
+    }
+
+    gnut_build_msg_id(&tmp);
+    memcpy((void *)node->servent_id, (const void *)tmp.message_id, 16);
+    node->max_ttl = GNUT_NODE_DEF_MAX_TTL;
+    node->forward = forward;
+    node->deliver = deliver;
+    node->arg = arg;
+
+    return GNUT_SUCCESS;
+}
+
+void gnut_node_destroy(gnut_node_t *node) {
+    gnut_route_destroy(&node->pings);
+    gnut_route_destroy(&node->queries);
+    gnut_route_destroy(&node->pushes);
+}
+
+void gnut_node_set_qdedupe(gnut_node_t *node, gnut_qdedupe_t *qd) {
+    node->qdedupe = qd;
+}
+
+void gnut_node_set_dynq(gnut_node_t *node, gnut_dynq_t *dq) {
+    node->dynq = dq;
+}
+
+void gnut_node_set_vmsgs(gnut_node_t *node,
+    const gnut_vmsg_cb_t *handlers) {
+
+    node->vmsgs = handlers;
+}
+
+static void _gnut_node_deliver(gnut_node_t *node, int t, sxs_uint32_t from,
+    const gnut_msg_hdr_t *hdr, const unsigned char *payload) {
+
+    if (node->deliver != NULL) {
+        node->stats.delivered[t]++;
+        node->deliver(node, from, hdr, payload, node->arg);
+    }
+}
+
+/* Sends a reply back along the route recorded for its request. */
+static void _gnut_node_route(gnut_node_t *node, int t, sxs_uint32_t to,
+    sxs_uint32_t from, const gnut_msg_hdr_t *hdr, const gnut_msg_hdr_t *fwd,
+    const unsigned char *payload) {
+
+    GNUT_PROBE4(route, from, hdr->type, GNUT_PROBE_GUID(hdr->message_id),
+        to);
+    if (to == GNUT_ROUTE_SELF) {
+        _gnut_node_deliver(node, t, from, hdr, payload);
+    } else if (to == GNUT_ROUTE_NONE || to == from) {
+        node->stats.dropped_unroutable++;
+        gnut_stats_drop(GNUT_STATS_DROP_UNROUTABLE);
+    } else if (fwd->ttl == 0) {
+        node->stats.dropped_ttl++;
+        gnut_stats_drop(GNUT_STATS_DROP_TTL);
+    } else {
+        node->stats.forwarded[t]++;
+        node->forward(node, to, from, fwd, payload, node->arg);
+    }
+}
+
+void gnut_node_dispatch(gnut_node_t *node, sxs_uint32_t from,
+    const gnut_msg_hdr_t *hdr, const unsigned char *payload) {
+
+    gnut_msg_hdr_t fwd;
+    gnut_route_t *rt;
+    const unsigned char *servent_id;
+    int t;
+
+    GNUT_PROBE4(dispatch, from, hdr->type, GNUT_PROBE_GUID(hdr->message_id),
+        hdr->pl_len);
+    t = gnut_node_type_index(hdr->type);
+    node->stats.rx[t]++;
+    node->stats.rx_bytes[t] += GNUT_MSG_HDR_LEN + hdr->pl_len;
+    gnut_stats_rx(t, GNUT_MSG_HDR_LEN + hdr->pl_len);
+
+    if (hdr->ttl == 0) {
+        node->stats.dropped_ttl++;
+        gnut_stats_drop(GNUT_STATS_DROP_TTL);
+        return;
+    }
+
+    /* The copy forwarded has one hop more and one TTL less, and never
+     * more TTL than the limit allows after the hops it has made. */
+    fwd = *hdr;
+    fwd.hops = hdr->hops + 1;
+    fwd.ttl = hdr->ttl - 1;
+    if ((unsigned int)fwd.ttl + fwd.hops > node->max_ttl) {
+        fwd.ttl = (node->max_ttl > fwd.hops) ? node->max_ttl - fwd.hops : 0;
+    }
+
+    switch (t) {
+        case GNUT_NODE_T_PING:
+        case GNUT_NODE_T_QUERY:
+            rt = (t == GNUT_NODE_T_PING) ? &node->pings : &node->queries;
+            if (!gnut_route_add(rt, hdr->message_id, from)) {
+                GNUT_PROBE4(dedupe, from, hdr->type,
+                    GNUT_PROBE_GUID(hdr->message_id), 1);
+                node->stats.dropped_dup++;
+                gnut_stats_dup(t);
+                return;
+            }
+            GNUT_PROBE4(dedupe, from, hdr->type,
+                GNUT_PROBE_GUID(hdr->message_id), 0);
+            if (t == GNUT_NODE_T_QUERY && node->qdedupe != NULL &&
+                !gnut_qdedupe_check(node->qdedupe, from, payload,
+                hdr->pl_len)) {
+                node->stats.dropped_repeat++;
+                gnut_stats_drop(GNUT_STATS_DROP_REPEAT);
+                return;
+            }
+            _gnut_node_deliver(node, t, from, hdr, payload);
+            /* A leaf's own Query goes to a few neighbours at a time. */
+            if (t == GNUT_NODE_T_QUERY && node->dynq != NULL &&
+                hdr->hops == 0 && gnut_dynq_is_leaf(node->dynq, from) &&
+                gnut_dynq_start(node->dynq, from, &fwd, payload) ==
+                GNUT_SUCCESS) {
+                node->stats.dynamic++;
+            } else if (fwd.ttl > 0) {
+                node->stats.forwarded[t]++;
+                node->forward(node, GNUT_NODE_BROADCAST, from, &fwd, payload,
+                    node->arg);
+            }
+            break;
+        case GNUT_NODE_T_PONG:
+            _gnut_node_route(node, t,
+                gnut_route_lookup(&node->pings, hdr->message_id), from, hdr,
+                &fwd, payload);
+            break;
+        case GNUT_NODE_T_QUERY_HIT:
+            if (hdr->pl_len < GNUT_QUERY_HIT_MIN_LEN) {
+                node->stats.dropped_malformed++;
+                gnut_stats_drop(GNUT_STATS_DROP_MALFORMED);
+                return;
+            }
+            /* The responder's Servent ID closes the payload; Pushes for
+             * it go back the way this hit came. */
+            gnut_route_add(&node->pushes, payload + hdr->pl_len - 16, from);
+            if (node->dynq != NULL) {
+                gnut_dynq_hit(node->dynq, hdr->message_id, payload[0]);
+            }
+            _gnut_node_route(node, t,
+                gnut_route_lookup(&node->queries, hdr->message_id), from,
+                hdr, &fwd, payload);
+            break;
+        case GNUT_NODE_T_PUSH:
+            if (hdr->pl_len < GNUT_PUSH_PAYLOAD_LEN) {
+                node->stats.dropped_malformed++;
+                gnut_stats_drop(GNUT_STATS_DROP_MALFORMED);
+                return;
+            }
+            servent_id = payload;
+            if (memcmp(servent_id, node->servent_id, 16) == 0) {
+                _gnut_node_deliver(node, t, from, hdr, payload);
+            } else {
+                _gnut_node_route(node, t,
+                    gnut_route_lookup(&node->pushes, servent_id), from, hdr,
+                    &fwd, payload);
+            }
+            break;
+        default:
+            if (node->vmsgs == NULL || (hdr->type != GNUT_MSG_VENDOR &&
+                hdr->type != GNUT_MSG_VENDOR_STD)) {
+                _gnut_node_deliver(node, t, from, hdr, payload);
+                break;
+            }
+            switch (gnut_vmsg_dispatch(node->vmsgs, from, hdr, payload,
+                node->arg)) {
+                case GNUT_SUCCESS:
+                    node->stats.delivered[t]++;
+                    break;
+                case GNUT_EMALFORMED:
+                    node->stats.dropped_malformed++;
+                    gnut_stats_drop(GNUT_STATS_DROP_MALFORMED);
+                    break;
+                default:
+                    node->stats.vendor_skipped++;
+                    break;
+            }
+            break;
+    }
+}
+
+void gnut_node_originate(gnut_node_t *node, const gnut_msg_hdr_t *hdr) {
+    if (hdr->type == GNUT_MSG_PING) {
+        gnut_route_add(&node->pings, hdr->message_id, GNUT_ROUTE_SELF);
+    } else if (hdr->type == GNUT_MSG_QUERY) {
+        gnut_route_add(&node->queries, hdr->message_id, GNUT_ROUTE_SELF);
+    }
+}
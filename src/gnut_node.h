@@ -0,0 +1,235 @@
+/*
+ * Copyright 2006-2007 Andrew De Ponte
+ *
+ * This file is part of lib_gnut.
+ *
+ * lib_gnut is the intellectual property of Andrew De Ponte; any
+ * distribution and/or modification and/or reproductions of any portion
+ * of lib_gnut MUST be approved by Andrew De Ponte.
+ *
+ * lib_gnut is distributed WITHOUT ANY WARRANTY; without even the
+ * implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE.
+ */
+
+/**
+ * @file gnut_node.h
+ * @brief This is a specifications file for the message dispatcher.
+ *
+ * The gnut_node.h file is a specifications file that declares the
+ * gnut_node_t type and its associated functions. A node decides what
+ * happens to each framed message: Pings and Queries are checked for
+ * duplicates and broadcast, Pongs and Query Hits are routed back along
+ * the path their Ping or Query came, Pushes are routed to the servent
+ * that sent the matching Query Hit, and whatever is addressed to this
+ * node is delivered to it. Queries may also go through a Query deduper,
+ * which drops the same search sent again under a new Message ID, and
+ * Vendor Messages, which go no further than the next hop, may be handed
+ * to the callbacks of their kinds. The node does no I/O; it tells its
+ * owner what to send through callbacks.
+ */
+
+#ifndef GNUT_NODE_H
+#define GNUT_NODE_H
+
+#include <sxs/sxs.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+#include "gnut_export.h"
+#include "gnut_types.h"
+#include "gnut_error.h"
+#include "gnut_msgs.h"
+#include "gnut_route.h"
+#include "gnut_qdedupe.h"
+#include "gnut_dynq.h"
+#include "gnut_vendor.h"
+
+#define GNUT_NODE_BROADCAST GNUT_ROUTE_NONE /**< Forward to all but origin */
+#define GNUT_NODE_DEF_MAX_TTL 7 /**< Default limit of TTL plus hops */
+
+#define GNUT_NODE_T_PING 0 /**< Statistics index of Pings */
+#define GNUT_NODE_T_PONG 1 /**< Statistics index of Pongs */
+#define GNUT_NODE_T_BYE 2 /**< Statistics index of Byes */
+#define GNUT_NODE_T_PUSH 3 /**< Statistics index of Pushes */
+#define GNUT_NODE_T_QUERY 4 /**< Statistics index of Queries */
+#define GNUT_NODE_T_QUERY_HIT 5 /**< Statistics index of Query Hits */
+#define GNUT_NODE_T_OTHER 6 /**< Statistics index of unknown types */
+#define GNUT_NODE_NUM_T 7 /**< Number of statistics indexes */
+
+#define GNUT_PUSH_PAYLOAD_LEN 26 /**< Length of a Push payload */
+#define GNUT_QUERY_HIT_MIN_LEN 27 /**< Shortest valid Query Hit payload */
+
+typedef struct gnut_node gnut_node_t;
+
+/**
+ * A Node Forward Callback
+ *
+ * The gnut_node_fwd_cb_t is the type of function called to send a
+ * message on connection 'to', or on every connection but 'from' if
+ * 'to' is GNUT_NODE_BROADCAST. 'hdr' already has its TTL and hops
+ * updated; the payload is unchanged and only valid during the call.
+ */
+typedef void (*gnut_node_fwd_cb_t)(gnut_node_t *node, sxs_uint32_t to,
+    sxs_uint32_t from, const gnut_msg_hdr_t *hdr,
+    const unsigned char *payload, void *arg);
+
+/**
+ * A Node Deliver Callback
+ *
+ * The gnut_node_deliver_cb_t is the type of function called with each
+ * message meant for this node: every Ping, Query and Bye, and the
+ * Pongs, Query Hits and Pushes routed to it.
+ */
+typedef void (*gnut_node_deliver_cb_t)(gnut_node_t *node, sxs_uint32_t from,
+    const gnut_msg_hdr_t *hdr, const unsigned char *payload, void *arg);
+
+/**
+ * Node Statistics
+ *
+ * The gnut_node_stats_t is a type which holds the counters of a node,
+ * indexed by GNUT_NODE_T_* where there is one per type.
+ */
+typedef struct GNUT_EXPORT gnut_node_stats {
+    gnut_uint64_t rx[GNUT_NODE_NUM_T];          /* Messages dispatched */
+    gnut_uint64_t rx_bytes[GNUT_NODE_NUM_T];    /* Including headers */
+    gnut_uint64_t forwarded[GNUT_NODE_NUM_T];   /* Forward callbacks */
+    gnut_uint64_t delivered[GNUT_NODE_NUM_T];   /* Deliver callbacks */
+    gnut_uint64_t dropped_dup;      /* Ping or Query seen before */
+    gnut_uint64_t dropped_ttl;      /* Zero TTL, or none left to forward */
+    gnut_uint64_t dropped_unroutable; /* Reply with no known route */
+    gnut_uint64_t dropped_malformed;  /* Payload too short for its type */
+    gnut_uint64_t dropped_repeat;   /* Query over its deduper's limits */
+    gnut_uint64_t dynamic;      /* Leaf Queries searched for dynamically */
+    gnut_uint64_t vendor_skipped; /* Vendor Messages not known or handled */
+} gnut_node_stats_t;
+
+/**
+ * A Node
+ *
+ * The gnut_node_t is a type which represents the routing state of this
+ * servent.
+ */
+struct gnut_node {
+    gnut_route_t pings;         /* Ping Message IDs, to route Pongs */
+    gnut_route_t queries;       /* Query Message IDs, to route Query Hits */
+    gnut_route_t pushes;        /* Servent IDs from Query Hits */
+    unsigned char servent_id[16];
+    unsigned char max_ttl;
+    gnut_node_fwd_cb_t forward;
+    gnut_node_deliver_cb_t deliver; /* May be NULL */
+    gnut_qdedupe_t *qdedupe;    /* May be NULL */
+    gnut_dynq_t *dynq;          /* May be NULL */
+    const gnut_vmsg_cb_t *vmsgs; /* GNUT_VMSG_NUM_K callbacks, or NULL */
+    void *arg;
+    gnut_node_stats_t stats;
+};
+
+/**
+ * Get the Statistics Index of a Payload Type
+ *
+ * @param type The payload type of a message.
+ * @return One of the GNUT_NODE_T_* values.
+ */
+GNUT_EXPORT int gnut_node_type_index(unsigned char type);
+
+/**
+ * Initialize a Node
+ *
+ * The gnut_node_init() function initializes a node whose routing
+ * tables each hold at least 'route_capacity' GUIDs.
+ * @param node Pointer to the node to initialize.
+ * @param route_capacity Routing table size, or 0 for the default.
+ * @param forward The function to call to send messages.
+ * @param deliver The function to call with messages for this node, or
+ * NULL.
+ * @param arg Passed to the callbacks.
+ * @return A value representing an error or success.
+ * @retval GNUT_SUCCESS Successfully initialized the node.
+ * @retval GNUT_ENOMEM Failed to allocate memory.
+ */
+GNUT_EXPORT gnut_error_t gnut_node_init(gnut_node_t *node,
+    sxs_uint32_t route_capacity, gnut_node_fwd_cb_t forward,
+    gnut_node_deliver_cb_t deliver, void *arg);
+
+/**
+ * Destroy a Node
+ *
+ * @param node Pointer to the node.
+ */
+GNUT_EXPORT void gnut_node_destroy(gnut_node_t *node);
+
+/**
+ * Set the Query Deduper of a Node
+ *
+ * The gnut_node_set_qdedupe() function makes the node check each new
+ * Query against 'qd' before delivering and broadcasting it, dropping
+ * those over its limits. The owner keeps the deduper's clock with
+ * gnut_qdedupe_tick().
+ * @param node Pointer to the node.
+ * @param qd Pointer to the deduper, which must outlive its use, or NULL
+ * to stop checking.
+ */
+GNUT_EXPORT void gnut_node_set_qdedupe(gnut_node_t *node,
+    gnut_qdedupe_t *qd);
+
+/**
+ * Set the Dynamic Query Controller of a Node
+ *
+ * The gnut_node_set_dynq() function makes the node search dynamically
+ * for each new Query a leaf of 'dq' sends, rather than broadcast it,
+ * and count the results of the Query Hits of every Message ID 'dq' is
+ * searching for. A Query 'dq' cannot start is broadcast as before. The
+ * owner tells 'dq' the role of each connection and advances its wheel.
+ * @param node Pointer to the node.
+ * @param dq Pointer to the controller, which must outlive its use, or
+ * NULL to broadcast every Query.
+ */
+GNUT_EXPORT void gnut_node_set_dynq(gnut_node_t *node, gnut_dynq_t *dq);
+
+/**
+ * Set the Vendor Message Callbacks of a Node
+ *
+ * The gnut_node_set_vmsgs() function makes the node hand each Vendor
+ * Message to the callback of its kind in 'handlers', with the node's
+ * 'arg', rather than deliver it. Vendor Messages of other kinds are
+ * counted and passed over.
+ * @param node Pointer to the node.
+ * @param handlers The GNUT_VMSG_NUM_K callbacks, NULL where not handled,
+ * which must outlive their use, or NULL to deliver Vendor Messages.
+ */
+GNUT_EXPORT void gnut_node_set_vmsgs(gnut_node_t *node,
+    const gnut_vmsg_cb_t *handlers);
+
+/**
+ * Dispatch a Message
+ *
+ * The gnut_node_dispatch() function routes a message received on
+ * connection 'from', typically straight from a framer callback.
+ * @param node Pointer to the node.
+ * @param from The connection id the message arrived on.
+ * @param hdr Pointer to the decoded header.
+ * @param payload Pointer to the hdr->pl_len bytes of payload.
+ */
+GNUT_EXPORT void gnut_node_dispatch(gnut_node_t *node, sxs_uint32_t from,
+    const gnut_msg_hdr_t *hdr, const unsigned char *payload);
+
+/**
+ * Register a Message Sent by this Node
+ *
+ * The gnut_node_originate() function records the Message ID of a Ping
+ * or Query this node sends, so that the replies are delivered to it and
+ * the message is not forwarded should it come back.
+ * @param node Pointer to the node.
+ * @param hdr Pointer to the header of the message being sent.
+ */
+GNUT_EXPORT void gnut_node_originate(gnut_node_t *node,
+    const gnut_msg_hdr_t *hdr);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* GNUT_NODE_H */
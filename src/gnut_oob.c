@@ -0,0 +1,462 @@
+/*
+ * Copyright 2006-2007 Andrew De Ponte
+ *
+ * This file is part of lib_gnut.
+ *
+ * lib_gnut is the intellectual property of Andrew De Ponte; any
+ * distribution and/or modification and/or reproductions of any portion
+ * of lib_gnut MUST be approved by Andrew De Ponte.
+ *
+ * lib_gnut is distributed WITHOUT ANY WARRANTY; without even the
+ * implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE.
+ */
+
+/**
+ * @file gnut_oob.c
+ * @brief This is an implementation file for out of band Query Hits.
+ *
+ * The gnut_oob.c file is an implementation file that defines the
+ * gnut_oob_t type's associated functions. Offers, searches and the
+ * ACKs sent for searches are entries of one chained hash table, keyed
+ * by their kind, Message ID and address, each with its own timer. An
+ * offer holds the whole datagram of its Query Hit, header included, so
+ * that it is sent as it is.
+ */
+
+#include <stdlib.h> /* calloc(), malloc(), free() */
+#include <string.h> /* memcmp(), memcpy(), memset() */
+
+#include "gnut_oob.h"
+#include "gnut_query.h"
+#include "gnut_vendor.h"
+
+#define KIND_OFFER 1            /* Address of the Message ID, port 0 */
+#define KIND_SEARCH 2           /* No address */
+#define KIND_ACKED 3            /* Address of the servent ACKed */
+#define MIN_BUCKETS 16
+#define VMSG_DGRAM_LEN (GNUT_MSG_HDR_LEN + GNUT_VMSG_HDR_LEN + 2)
+
+typedef struct gnut_oob_ent {
+    gnut_twheel_timer_t timer;
+    struct gnut_oob_ent *hnext; /* Next in its bucket */
+    gnut_oob_t *o;
+    unsigned char guid[GNUT_MSG_ID_LEN];
+    sxs_uint32_t ip;
+    sxs_uint16_t port;
+    unsigned char kind;
+    sxs_uint32_t hash;
+    sxs_uint32_t num;           /* Results offered, still wanted or ACKed */
+    sxs_uint32_t len;           /* Of the datagram following an offer */
+} gnut_oob_ent_t;
+
+/* The datagram of an offer follows it. */
+#define ENT_DGRAM(e) ((unsigned char *)((e) + 1))
+
+struct gnut_oob {
+    gnut_oob_cfg_t cfg;
+    gnut_twheel_t *wheel;
+    gnut_oob_ent_t **buckets;
+    sxs_uint32_t mask;
+    gnut_oob_stats_t st;
+};
+
+static sxs_uint32_t _gnut_oob_hash(const unsigned char *guid,
+    unsigned char kind, sxs_uint32_t ip, sxs_uint16_t port) {
+
+    sxs_uint32_t h, i;
+
+    h = 2166136261U ^ kind;
+    for (i = 0; i < GNUT_MSG_ID_LEN; i++) {
+        h = (h ^ guid[i]) * 16777619U;
+    }
+    h ^= ip;
+    h *= 0x45d9f3bU;
+    h ^= port;
+    h *= 0x45d9f3bU;
+    return h ^ (h >> 16);
+}
+
+static gnut_oob_ent_t *_gnut_oob_find(const gnut_oob_t *o,
+    const unsigned char *guid, unsigned char kind, sxs_uint32_t ip,
+    sxs_uint16_t port) {
+
+    gnut_oob_ent_t *e;
+
+    e = o->buckets[_gnut_oob_hash(guid, kind, ip, port) & o->mask];
+    while (e != NULL && (e->kind != kind || e->ip != ip ||
+        e->port != port || memcmp(e->guid, guid, GNUT_MSG_ID_LEN) != 0)) {
+        e = e->hnext;
+    }
+    return e;
+}
+
+static void _gnut_oob_buckets_grow(gnut_oob_t *o) {
+    gnut_oob_ent_t **buckets, *e, *next;
+    sxs_uint32_t len, i;
+
+    len = (o->mask + 1) * 2;
+    buckets = (gnut_oob_ent_t **)calloc(len, sizeof(gnut_oob_ent_t *));
+    if (buckets == NULL) {
+        /* Longer chains will do. */
+        return;
+    }
+    for (i = 0; i <= o->mask; i++) {
+        for (e = o->buckets[i]; e != NULL; e = next) {
+            next = e->hnext;
+            e->hnext = buckets[e->hash & (len - 1)];
+            buckets[e->hash & (len - 1)] = e;
+        }
+    }
+    free(o->buckets);
+    o->buckets = buckets;
+    o->mask = len - 1;
+}
+
+static void _gnut_oob_remove(gnut_oob_t *o, gnut_oob_ent_t *e) {
+    gnut_oob_ent_t **pp;
+
+    gnut_twheel_stop(o->wheel, &e->timer);
+    pp = &o->buckets[e->hash & o->mask];
+    while (*pp != e) {
+        pp = &(*pp)->hnext;
+    }
+    *pp = e->hnext;
+    o->st.entries--;
+    o->st.bytes -= e->len;
+    free(e);
+}
+
+static void _gnut_oob_expire(gnut_twheel_t *w, gnut_twheel_timer_t *t,
+    void *arg) {
+
+    gnut_oob_ent_t *e;
+
+    e = (gnut_oob_ent_t *)arg;
+    if (e->kind == KIND_OFFER) {
+        e->o->st.expired++;
+    }
+    _gnut_oob_remove(e->o, e);
+}
+
+/* Adds an entry with 'len' bytes of datagram after it, which the
+ * caller fills in, and starts its timer. */
+static gnut_error_t _gnut_oob_add(gnut_oob_t *o, const unsigned char *guid,
+    unsigned char kind, sxs_uint32_t ip, sxs_uint16_t port,
+    sxs_uint32_t len, gnut_uint64_t life, gnut_oob_ent_t **pp_e) {
+
+    gnut_oob_ent_t *e;
+
+    if (o->st.entries >= o->cfg.max_entries ||
+        len > o->cfg.max_bytes - o->st.bytes) {
+        o->st.refused++;
+        return GNUT_EQUEUE_FULL;
+    }
+    e = (gnut_oob_ent_t *)malloc(sizeof(gnut_oob_ent_t) + len);
+    if (e == NULL) {
+        return GNUT_ENOMEM;
+    }
+    memset((void *)e, 0, sizeof(gnut_oob_ent_t));
+    gnut_twheel_timer_init(&e->timer);
+    e->o = o;
+    memcpy((void *)e->guid, (const void *)guid, GNUT_MSG_ID_LEN);
+    e->kind = kind;
+    e->ip = ip;
+    e->port = port;
+    e->hash = _gnut_oob_hash(guid, kind, ip, port);
+    e->len = len;
+
+    if (o->st.entries > o->mask) {
+        _gnut_oob_buckets_grow(o);
+    }
+    e->hnext = o->buckets[e->hash & o->mask];
+    o->buckets[e->hash & o->mask] = e;
+    o->st.entries++;
+    o->st.bytes += len;
+    gnut_twheel_start(o->wheel, &e->timer, life, _gnut_oob_expire,
+        (void *)e);
+    *pp_e = e;
+    return GNUT_SUCCESS;
+}
+
+/* Sends a LIME Vendor Message carrying the one byte 'num', and for a
+ * Reply Number the flags too. */
+static void _gnut_oob_send_vmsg(gnut_oob_t *o, const unsigned char *guid,
+    sxs_uint16_t selector, sxs_uint32_t num, sxs_uint32_t ip,
+    sxs_uint16_t port) {
+
+    unsigned char dgram[VMSG_DGRAM_LEN], data[2];
+    gnut_msg_hdr_t hdr;
+    sxs_uint32_t pl_len;
+
+    data[0] = (unsigned char)((num > 255) ? 255 : num);
+    data[1] = 0;
+    gnut_vmsg_build(GNUT_VMSG_LIME, selector, GNUT_VMSG_OOB_VERSION, data,
+        (selector == GNUT_VMSG_REPLY_NUMBER) ? 2 : 1,
+        dgram + GNUT_MSG_HDR_LEN, VMSG_DGRAM_LEN - GNUT_MSG_HDR_LEN,
+        &pl_len);
+    gnut_build_msg_hdr_given_msg_id(&hdr, guid, GNUT_MSG_VENDOR, pl_len);
+    hdr.ttl = 1;
+    gnut_encode_msg_hdr(&hdr, dgram);
+    o->cfg.send(o, ip, port, dgram, GNUT_MSG_HDR_LEN + pl_len, o->cfg.arg);
+}
+
+/* Answers a Reply Number for a search with an ACK for as many results
+ * as it still wants, once per servent. */
+static gnut_error_t _gnut_oob_reply_number(gnut_oob_t *o,
+    const gnut_msg_hdr_t *hdr, const gnut_vmsg_t *vm, sxs_uint32_t ip,
+    sxs_uint16_t port) {
+
+    gnut_oob_ent_t *search, *acked;
+    sxs_uint32_t num;
+
+    search = _gnut_oob_find(o, hdr->message_id, KIND_SEARCH, 0, 0);
+    if (search == NULL) {
+        o->st.unsolicited++;
+        return GNUT_ENOT_FOUND;
+    }
+    if (vm->data_len < 1) {
+        o->st.malformed++;
+        return GNUT_EMALFORMED;
+    }
+    o->st.replies_rx++;
+    if (_gnut_oob_find(o, hdr->message_id, KIND_ACKED, ip, port) != NULL) {
+        return GNUT_SUCCESS;
+    }
+    num = vm->data[0];
+    if (num > search->num) {
+        num = search->num;
+    }
+    if (num == 0) {
+        o->st.declined++;
+        return GNUT_SUCCESS;
+    }
+    if (_gnut_oob_add(o, hdr->message_id, KIND_ACKED, ip, port, 0,
+        o->cfg.hold, &acked) != GNUT_SUCCESS) {
+        return GNUT_SUCCESS;
+    }
+    acked->num = num;
+    search->num -= num;
+    o->st.acks_sent++;
+    _gnut_oob_send_vmsg(o, hdr->message_id, GNUT_VMSG_LIME_ACK, num, ip,
+        port);
+    return GNUT_SUCCESS;
+}
+
+/* Sends an offer's Query Hit to the servent ACKing it, which is at the
+ * address of the Message ID. */
+static gnut_error_t _gnut_oob_ack(gnut_oob_t *o, const gnut_msg_hdr_t *hdr,
+    const gnut_vmsg_t *vm, sxs_uint32_t ip, sxs_uint16_t port) {
+
+    gnut_oob_ent_t *offer;
+
+    offer = _gnut_oob_find(o, hdr->message_id, KIND_OFFER, ip, 0);
+    if (offer == NULL) {
+        o->st.unsolicited++;
+        return GNUT_ENOT_FOUND;
+    }
+    if (vm->data_len < 1) {
+        o->st.malformed++;
+        return GNUT_EMALFORMED;
+    }
+    o->st.acks_rx++;
+    if (vm->data[0] == 0) {
+        o->st.declined++;
+    } else {
+        o->st.hits_sent++;
+        o->st.hit_bytes_sent += offer->len;
+        o->cfg.send(o, ip, port, ENT_DGRAM(offer), offer->len, o->cfg.arg);
+    }
+    _gnut_oob_remove(o, offer);
+    return GNUT_SUCCESS;
+}
+
+static gnut_error_t _gnut_oob_hit(gnut_oob_t *o, const gnut_msg_hdr_t *hdr,
+    const unsigned char *payload, sxs_uint32_t ip, sxs_uint16_t port) {
+
+    if (_gnut_oob_find(o, hdr->message_id, KIND_ACKED, ip, port) == NULL) {
+        o->st.unsolicited++;
+        return GNUT_ENOT_FOUND;
+    }
+    if (hdr->pl_len < GNUT_QHIT_HDR_LEN + GNUT_QHIT_SERVENT_ID_LEN) {
+        o->st.malformed++;
+        return GNUT_EMALFORMED;
+    }
+    o->st.hits_rx++;
+    o->st.results_rx += payload[0];
+    if (o->cfg.deliver != NULL) {
+        o->cfg.deliver(o, ip, port, hdr, payload, o->cfg.arg);
+    }
+    return GNUT_SUCCESS;
+}
+
+void gnut_oob_cfg_init(gnut_oob_cfg_t *cfg, gnut_oob_send_cb_t send,
+    gnut_oob_deliver_cb_t deliver, void *arg) {
+
+    cfg->hold = GNUT_OOB_DEF_HOLD;
+    cfg->search_time = GNUT_OOB_DEF_SEARCH_TIME;
+    cfg->max_entries = GNUT_OOB_DEF_MAX_ENTRIES;
+    cfg->max_bytes = GNUT_OOB_DEF_MAX_BYTES;
+    cfg->send = send;
+    cfg->deliver = deliver;
+    cfg->arg = arg;
+}
+
+gnut_error_t gnut_oob_new(gnut_oob_t **pp_o, const gnut_oob_cfg_t *cfg,
+    gnut_twheel_t *wheel) {
+
+    gnut_oob_t *o;
+
+    o = (gnut_oob_t *)calloc(1, sizeof(gnut_oob_t));
+    if (o == NULL) {
+        return GNUT_ENOMEM;
+    }
+    o->buckets = (gnut_oob_ent_t **)calloc(MIN_BUCKETS,
+        sizeof(gnut_oob_ent_t *));
+    if (o->buckets == NULL) {
+        free(o);
+        return GNUT_ENOMEM;
+    }
+    o->cfg = *cfg;
+    o->wheel = wheel;
+    o->mask = MIN_BUCKETS - 1;
+    *pp_o = o;
+    return GNUT_SUCCESS;
+}
+
+void gnut_oob_free(gnut_oob_t *o) {
+    gnut_oob_ent_t *e, *next;
+    sxs_uint32_t i;
+
+    for (i = 0; i <= o->mask; i++) {
+        for (e = o->buckets[i]; e != NULL; e = next) {
+            next = e->hnext;
+            gnut_twheel_stop(o->wheel, &e->timer);
+            free(e);
+        }
+    }
+    free(o->buckets);
+    free(o);
+}
+
+int gnut_oob_wanted(const gnut_msg_hdr_t *hdr, const unsigned char *payload) {
+    sxs_uint32_t ip;
+    sxs_uint16_t speed, port;
+
+    if (hdr->type != GNUT_MSG_QUERY || hdr->pl_len < 2) {
+        return 0;
+    }
+    speed = (sxs_uint16_t)(payload[0] | (payload[1] << 8));
+    if ((speed & GNUT_QUERY_SPEED_FLAGS) == 0 ||
+        (speed & GNUT_QUERY_SPEED_OOB) == 0) {
+        return 0;
+    }
+    gnut_msg_id_oob_addr(hdr->message_id, &ip, &port);
+    return ip != 0 && port != 0;
+}
+
+gnut_error_t gnut_oob_offer(gnut_oob_t *o, const unsigned char *guid,
+    const unsigned char *hit, sxs_uint32_t hit_len) {
+
+    gnut_oob_ent_t *offer;
+    gnut_msg_hdr_t hdr;
+    gnut_error_t err;
+    sxs_uint32_t ip;
+    sxs_uint16_t port;
+
+    gnut_msg_id_oob_addr(guid, &ip, &port);
+    if (ip == 0 || port == 0 ||
+        hit_len < GNUT_QHIT_HDR_LEN + GNUT_QHIT_SERVENT_ID_LEN) {
+        return GNUT_EMALFORMED;
+    }
+    if (hit_len > GNUT_OOB_MAX_DGRAM - GNUT_MSG_HDR_LEN) {
+        return GNUT_EBUF_TOO_SMALL;
+    }
+    if (_gnut_oob_find(o, guid, KIND_OFFER, ip, 0) != NULL) {
+        return GNUT_EEXISTS;
+    }
+    err = _gnut_oob_add(o, guid, KIND_OFFER, ip, 0,
+        GNUT_MSG_HDR_LEN + hit_len, o->cfg.hold, &offer);
+    if (err != GNUT_SUCCESS) {
+        return err;
+    }
+    gnut_build_msg_hdr_given_msg_id(&hdr, guid, GNUT_MSG_QUERY_HIT,
+        hit_len);
+    hdr.ttl = 1;
+    gnut_encode_msg_hdr(&hdr, ENT_DGRAM(offer));
+    memcpy((void *)(ENT_DGRAM(offer) + GNUT_MSG_HDR_LEN), (const void *)hit,
+        hit_len);
+    offer->num = hit[0];
+
+    o->st.offers++;
+    _gnut_oob_send_vmsg(o, guid, GNUT_VMSG_REPLY_NUMBER, offer->num, ip,
+        port);
+    return GNUT_SUCCESS;
+}
+
+gnut_error_t gnut_oob_request(gnut_oob_t *o, const unsigned char *guid,
+    sxs_uint32_t wanted) {
+
+    gnut_oob_ent_t *search;
+    gnut_error_t err;
+
+    if (_gnut_oob_find(o, guid, KIND_SEARCH, 0, 0) != NULL) {
+        return GNUT_EEXISTS;
+    }
+    err = _gnut_oob_add(o, guid, KIND_SEARCH, 0, 0, 0, o->cfg.search_time,
+        &search);
+    if (err != GNUT_SUCCESS) {
+        return err;
+    }
+    search->num = wanted;
+    o->st.searches++;
+    return GNUT_SUCCESS;
+}
+
+void gnut_oob_cancel(gnut_oob_t *o, const unsigned char *guid) {
+    gnut_oob_ent_t *search;
+
+    search = _gnut_oob_find(o, guid, KIND_SEARCH, 0, 0);
+    if (search != NULL) {
+        _gnut_oob_remove(o, search);
+    }
+}
+
+gnut_error_t gnut_oob_recv(gnut_oob_t *o, sxs_uint32_t ip, sxs_uint16_t port,
+    const unsigned char *dgram, sxs_uint32_t len) {
+
+    gnut_msg_hdr_t hdr;
+    gnut_vmsg_t vm;
+
+    if (len < GNUT_MSG_HDR_LEN) {
+        o->st.malformed++;
+        return GNUT_EMALFORMED;
+    }
+    gnut_decode_msg_hdr(dgram, &hdr);
+    if (hdr.pl_len != len - GNUT_MSG_HDR_LEN) {
+        o->st.malformed++;
+        return GNUT_EMALFORMED;
+    }
+
+    if (hdr.type == GNUT_MSG_QUERY_HIT) {
+        return _gnut_oob_hit(o, &hdr, dgram + GNUT_MSG_HDR_LEN, ip, port);
+    }
+    if (hdr.type != GNUT_MSG_VENDOR ||
+        gnut_vmsg_parse(&vm, dgram + GNUT_MSG_HDR_LEN, hdr.pl_len) !=
+        GNUT_SUCCESS) {
+        o->st.unsolicited++;
+        return GNUT_ENOT_FOUND;
+    }
+    if (vm.kind == GNUT_VMSG_K_REPLY_NUMBER) {
+        return _gnut_oob_reply_number(o, &hdr, &vm, ip, port);
+    }
+    if (vm.kind == GNUT_VMSG_K_LIME_ACK) {
+        return _gnut_oob_ack(o, &hdr, &vm, ip, port);
+    }
+    o->st.unsolicited++;
+    return GNUT_ENOT_FOUND;
+}
+
+void gnut_oob_stats(const gnut_oob_t *o, gnut_oob_stats_t *st) {
+    *st = o->st;
+}
@@ -0,0 +1,258 @@
+/*
+ * Copyright 2006-2007 Andrew De Ponte
+ *
+ * This file is part of lib_gnut.
+ *
+ * lib_gnut is the intellectual property of Andrew De Ponte; any
+ * distribution and/or modification and/or reproductions of any portion
+ * of lib_gnut MUST be approved by Andrew De Ponte.
+ *
+ * lib_gnut is distributed WITHOUT ANY WARRANTY; without even the
+ * implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE.
+ */
+
+/**
+ * @file gnut_oob.h
+ * @brief This is a specifications file for out of band Query Hits.
+ *
+ * The gnut_oob.h file is a specifications file that declares the
+ * gnut_oob_t type and its associated functions. A Query Hit routed back
+ * over the overlay is relayed by every ultrapeer on the way, though
+ * only the servent that searched wants it. A servent which can take
+ * UDP encodes its address in the Message ID of its Query, with
+ * gnut_build_oob_msg_id(), and flags the Query as wanting out of band
+ * replies. A servent with results for it then holds them and tells the
+ * searcher how many it has with a LIME Reply Number message sent over
+ * UDP; the searcher answers with a LIME ACK asking for as many as it
+ * still wants, and only then are the Query Hits sent, over UDP too.
+ *
+ * A gnut_oob_t plays both parts. Query Hits are only sent to the
+ * address the Message ID names, once an ACK from that address asks for
+ * them, so that a forged Query cannot aim them at another host; and
+ * Query Hits are only taken from servents this searcher asked. What is
+ * held is dropped after a while, on the timers of a gnut_twheel_t the
+ * owner advances. The owner moves the datagrams: it is given those to
+ * send, and passes those received to gnut_oob_recv().
+ */
+
+#ifndef GNUT_OOB_H
+#define GNUT_OOB_H
+
+#include <sxs/sxs.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+#include "gnut_export.h"
+#include "gnut_types.h"
+#include "gnut_error.h"
+#include "gnut_msgs.h"
+#include "gnut_twheel.h"
+
+#define GNUT_OOB_DEF_HOLD 30000000 /**< Default time results held, in us */
+#define GNUT_OOB_DEF_SEARCH_TIME 120000000 /**< Default search, in us */
+#define GNUT_OOB_DEF_MAX_ENTRIES 8192 /**< Default most offers and asks */
+#define GNUT_OOB_DEF_MAX_BYTES (4 * 1024 * 1024) /**< Default bytes held */
+#define GNUT_OOB_MAX_DGRAM 65507 /**< Largest datagram, header included */
+
+typedef struct gnut_oob gnut_oob_t;
+
+/**
+ * An Out of Band Send Callback
+ *
+ * The gnut_oob_send_cb_t is the type of function called to send the
+ * encoded message 'dgram' over UDP to 'ip' and 'port'. The IP address
+ * is in network byte order; the datagram is only valid during the call.
+ */
+typedef void (*gnut_oob_send_cb_t)(gnut_oob_t *o, sxs_uint32_t ip,
+    sxs_uint16_t port, const unsigned char *dgram, sxs_uint32_t len,
+    void *arg);
+
+/**
+ * An Out of Band Deliver Callback
+ *
+ * The gnut_oob_deliver_cb_t is the type of function called with each
+ * Query Hit received out of band for a search of this servent.
+ */
+typedef void (*gnut_oob_deliver_cb_t)(gnut_oob_t *o, sxs_uint32_t ip,
+    sxs_uint16_t port, const gnut_msg_hdr_t *hdr,
+    const unsigned char *payload, void *arg);
+
+/**
+ * An Out of Band Configuration
+ *
+ * The gnut_oob_cfg_t is a type which holds the limits and callbacks of
+ * an out of band Query Hit handler.
+ */
+typedef struct GNUT_EXPORT gnut_oob_cfg {
+    gnut_uint64_t hold;         /* How long offers and ACKs last, in us */
+    gnut_uint64_t search_time;  /* How long searches take replies, in us */
+    sxs_uint32_t max_entries;   /* Offers, searches and ACKs at once */
+    sxs_uint32_t max_bytes;     /* Bytes of Query Hits held */
+    gnut_oob_send_cb_t send;
+    gnut_oob_deliver_cb_t deliver; /* May be NULL */
+    void *arg;                  /* Passed to the callbacks */
+} gnut_oob_cfg_t;
+
+/**
+ * Out of Band Statistics
+ *
+ * The gnut_oob_stats_t is a type which holds the counters of an out of
+ * band Query Hit handler, of its part answering first and then of its
+ * part searching.
+ */
+typedef struct GNUT_EXPORT gnut_oob_stats {
+    gnut_uint64_t offers;       /* Query Hits held, Reply Numbers sent */
+    gnut_uint64_t refused;      /* Offers or searches over the limits */
+    gnut_uint64_t acks_rx;
+    gnut_uint64_t hits_sent;
+    gnut_uint64_t hit_bytes_sent; /* Headers included */
+    gnut_uint64_t expired;      /* Offers no ACK came for */
+    gnut_uint64_t declined;     /* ACKs for none, Reply Numbers not wanted */
+    gnut_uint64_t searches;
+    gnut_uint64_t replies_rx;   /* Reply Numbers for searches */
+    gnut_uint64_t acks_sent;
+    gnut_uint64_t hits_rx;
+    gnut_uint64_t results_rx;
+    gnut_uint64_t unsolicited;  /* Messages for nothing offered or asked */
+    gnut_uint64_t malformed;
+    sxs_uint32_t entries;       /* Offers, searches and ACKs held */
+    sxs_uint32_t bytes;         /* Bytes of Query Hits held */
+} gnut_oob_stats_t;
+
+/**
+ * Initialize an Out of Band Configuration
+ *
+ * The gnut_oob_cfg_init() function sets the GNUT_OOB_DEF_* defaults and
+ * the callbacks.
+ * @param cfg Pointer to the configuration to initialize.
+ * @param send The function to call to send a datagram.
+ * @param deliver The function to call with Query Hits for searches of
+ * this servent, or NULL.
+ * @param arg Passed to the callbacks.
+ */
+GNUT_EXPORT void gnut_oob_cfg_init(gnut_oob_cfg_t *cfg,
+    gnut_oob_send_cb_t send, gnut_oob_deliver_cb_t deliver, void *arg);
+
+/**
+ * Create an Out of Band Query Hit Handler
+ *
+ * @param pp_o Pointer to store the pointer to the new handler in.
+ * @param cfg Pointer to the configuration, which is copied.
+ * @param wheel Pointer to the timer wheel to expire entries on, which
+ * may be shared and must outlive the handler.
+ * @return A value representing an error or success.
+ * @retval GNUT_SUCCESS Successfully created the handler.
+ * @retval GNUT_ENOMEM Failed to allocate memory.
+ */
+GNUT_EXPORT gnut_error_t gnut_oob_new(gnut_oob_t **pp_o,
+    const gnut_oob_cfg_t *cfg, gnut_twheel_t *wheel);
+
+/**
+ * Free an Out of Band Query Hit Handler
+ *
+ * @param o Pointer to the handler.
+ */
+GNUT_EXPORT void gnut_oob_free(gnut_oob_t *o);
+
+/**
+ * Check Whether a Query Wants Out of Band Replies
+ *
+ * The gnut_oob_wanted() function tells whether the Query 'hdr' and
+ * 'payload' is flagged as wanting its Query Hits out of band, and its
+ * Message ID holds an address to send them to.
+ * @param hdr Pointer to the header of the Query.
+ * @param payload Pointer to the hdr->pl_len bytes of payload.
+ * @return Non-zero if the Query wants out of band replies, 0 otherwise.
+ */
+GNUT_EXPORT int gnut_oob_wanted(const gnut_msg_hdr_t *hdr,
+    const unsigned char *payload);
+
+/**
+ * Offer a Query Hit Out of Band
+ *
+ * The gnut_oob_offer() function holds a copy of the Query Hit payload
+ * 'hit' for the Query of Message ID 'guid', which should want out of
+ * band replies, and sends a Reply Number message to the address of the
+ * Message ID. The Query Hit is sent there when an ACK comes from it,
+ * or dropped after the hold time.
+ * @param o Pointer to the handler.
+ * @param guid Pointer to the 16 byte Message ID of the Query.
+ * @param hit Pointer to the Query Hit payload.
+ * @param hit_len The length of the payload.
+ * @return A value representing an error or success.
+ * @retval GNUT_SUCCESS Successfully offered the Query Hit.
+ * @retval GNUT_EEXISTS A Query Hit is already offered for the Query.
+ * @retval GNUT_EQUEUE_FULL The handler holds as much as allowed.
+ * @retval GNUT_EBUF_TOO_SMALL The Query Hit does not fit a datagram.
+ * @retval GNUT_EMALFORMED The Query Hit is too short, or the Message ID
+ * holds no address.
+ * @retval GNUT_ENOMEM Failed to allocate memory.
+ */
+GNUT_EXPORT gnut_error_t gnut_oob_offer(gnut_oob_t *o,
+    const unsigned char *guid, const unsigned char *hit,
+    sxs_uint32_t hit_len);
+
+/**
+ * Start Taking Query Hits Out of Band
+ *
+ * The gnut_oob_request() function makes the handler answer the Reply
+ * Numbers for the Query of Message ID 'guid', which this servent sends,
+ * asking for up to 'wanted' results in all, and take the Query Hits
+ * that follow, until the search time ends.
+ * @param o Pointer to the handler.
+ * @param guid Pointer to the 16 byte Message ID of the Query.
+ * @param wanted The most results to ask for.
+ * @return A value representing an error or success.
+ * @retval GNUT_SUCCESS Successfully started taking Query Hits.
+ * @retval GNUT_EEXISTS The Message ID is already searched for.
+ * @retval GNUT_EQUEUE_FULL The handler holds as much as allowed.
+ * @retval GNUT_ENOMEM Failed to allocate memory.
+ */
+GNUT_EXPORT gnut_error_t gnut_oob_request(gnut_oob_t *o,
+    const unsigned char *guid, sxs_uint32_t wanted);
+
+/**
+ * Stop Asking for Query Hits Out of Band
+ *
+ * The gnut_oob_cancel() function stops answering the Reply Numbers for
+ * Message ID 'guid'. Query Hits already asked for are still taken.
+ * @param o Pointer to the handler.
+ * @param guid Pointer to the 16 byte Message ID of the Query.
+ */
+GNUT_EXPORT void gnut_oob_cancel(gnut_oob_t *o, const unsigned char *guid);
+
+/**
+ * Receive an Out of Band Datagram
+ *
+ * The gnut_oob_recv() function handles the datagram 'dgram' received
+ * from 'ip' and 'port': a Reply Number, an ACK or a Query Hit.
+ * @param o Pointer to the handler.
+ * @param ip The IP address of the sender in network byte order.
+ * @param port The UDP port of the sender.
+ * @param dgram Pointer to the datagram, an encoded message.
+ * @param len The length of the datagram.
+ * @return A value representing an error or success.
+ * @retval GNUT_SUCCESS Successfully handled the datagram.
+ * @retval GNUT_ENOT_FOUND The datagram is of another kind, or for
+ * nothing offered or asked for.
+ * @retval GNUT_EMALFORMED The datagram is malformed.
+ */
+GNUT_EXPORT gnut_error_t gnut_oob_recv(gnut_oob_t *o, sxs_uint32_t ip,
+    sxs_uint16_t port, const unsigned char *dgram, sxs_uint32_t len);
+
+/**
+ * Get the Statistics of an Out of Band Query Hit Handler
+ *
+ * @param o Pointer to the handler.
+ * @param st Pointer to the statistics to fill in.
+ */
+GNUT_EXPORT void gnut_oob_stats(const gnut_oob_t *o, gnut_oob_stats_t *st);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* GNUT_OOB_H */
@@ -0,0 +1,288 @@
+/*
+ * Copyright 2006-2007 Andrew De Ponte
+ *
+ * This file is part of lib_gnut.
+ *
+ * lib_gnut is the intellectual property of Andrew De Ponte; any
+ * distribution and/or modification and/or reproductions of any portion
+ * of lib_gnut MUST be approved by Andrew De Ponte.
+ *
+ * lib_gnut is distributed WITHOUT ANY WARRANTY; without even the
+ * implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE.
+ */
+
+/**
+ * @file gnut_outq.c
+ * @brief This is an implementation file for connection output queues.
+ *
+ * The gnut_outq.c file is an implementation file that defines the
+ * gnut_outq_t type's associated functions.
+ */
+
+#include <stdlib.h> /* realloc(), free() */
+#include <string.h> /* memset(), memcpy() */
+
+#include "gnut_outq.h"
+#include "gnut_stats.h"
+
+#define LANE_MIN_CAP 16
+
+/* Sheddable entries, in the order they are shed. */
+#define SHED_STALE_PONGS 0
+#define SHED_PINGS 1
+#define SHED_HIGH_HOP_QUERIES 2
+
+void gnut_outq_cfg_init(gnut_outq_cfg_t *cfg) {
+    cfg->hi_water = GNUT_OUTQ_DEF_HI_WATER;
+    cfg->lo_water = GNUT_OUTQ_DEF_LO_WATER;
+    cfg->max_bytes = GNUT_OUTQ_DEF_MAX_BYTES;
+    cfg->control_max = GNUT_OUTQ_DEF_CONTROL_MAX;
+    cfg->shed_hops = GNUT_OUTQ_DEF_SHED_HOPS;
+    cfg->pong_max_age = GNUT_OUTQ_DEF_PONG_AGE;
+}
+
+void gnut_outq_init(gnut_outq_t *q, const gnut_outq_cfg_t *cfg) {
+    memset(q, 0, sizeof(gnut_outq_t));
+    if (cfg != NULL) {
+        q->cfg = *cfg;
+    } else {
+        gnut_outq_cfg_init(&q->cfg);
+    }
+}
+
+void gnut_outq_destroy(gnut_outq_t *q) {
+    gnut_outq_lane_t *lane;
+    sxs_uint32_t i;
+    int l;
+
+    for (l = 0; l < GNUT_OUTQ_NUM_LANES; l++) {
+        lane = &q->lanes[l];
+        for (i = 0; i < lane->len; i++) {
+            gnut_enc_msg_unref(lane->ents[(lane->head + i) &
+                (lane->cap - 1)].msg);
+        }
+        free(lane->ents);
+        lane->ents = NULL;
+        lane->cap = lane->head = lane->len = lane->bytes = 0;
+    }
+    q->bytes = 0;
+    q->len = 0;
+}
+
+int gnut_outq_lane_of(unsigned char type) {
+    switch (type) {
+        case GNUT_MSG_BYE:
+            return GNUT_OUTQ_LANE_BYE;
+        case GNUT_MSG_PUSH:
+            return GNUT_OUTQ_LANE_PUSH;
+        case GNUT_MSG_QUERY_HIT:
+            return GNUT_OUTQ_LANE_QUERY_HIT;
+        case GNUT_MSG_PONG:
+            return GNUT_OUTQ_LANE_PONG;
+        case GNUT_MSG_QUERY:
+            return GNUT_OUTQ_LANE_QUERY;
+        case GNUT_MSG_PING:
+            return GNUT_OUTQ_LANE_PING;
+        default:
+            return GNUT_OUTQ_LANE_CONTROL;
+    }
+}
+
+static gnut_error_t _gnut_outq_grow(gnut_outq_lane_t *lane) {
+    gnut_outq_ent_t *ents;
+    sxs_uint32_t cap, first;
+
+    cap = (lane->cap > 0) ? lane->cap * 2 : LANE_MIN_CAP;
+    ents = (gnut_outq_ent_t *)realloc(lane->ents,
+        cap * sizeof(gnut_outq_ent_t));
+    if (ents == NULL) {
+        return GNUT_ENOMEM;
+    }
+
+    /* Unwrap the entries that ran past the end of the old ring. */
+    first = lane->cap - lane->head;
+    if (lane->len > first) {
+        memcpy((void *)(ents + lane->cap), (const void *)ents,
+            (lane->len - first) * sizeof(gnut_outq_ent_t));
+    }
+    lane->ents = ents;
+    lane->cap = cap;
+
+    return GNUT_SUCCESS;
+}
+
+static void _gnut_outq_account_drop(gnut_outq_t *q, int l,
+    gnut_enc_msg_t *msg) {
+
+    q->bytes -= msg->len;
+    q->lanes[l].bytes -= msg->len;
+    q->len--;
+    q->stats.dropped[l]++;
+    gnut_stats_drop(GNUT_STATS_DROP_SHED);
+    gnut_enc_msg_unref(msg);
+}
+
+static int _gnut_outq_sheddable(const gnut_outq_t *q, int what,
+    const gnut_outq_ent_t *ent, gnut_uint64_t now) {
+
+    switch (what) {
+        case SHED_STALE_PONGS:
+            return (now - ent->when > q->cfg.pong_max_age);
+        case SHED_PINGS:
+            return 1;
+        default:
+            return (ent->msg->data[18] >= q->cfg.shed_hops);
+    }
+}
+
+/* Remove the entries of 'lane' that 'what' selects, oldest first, until
+ * the queue is down to 'target' bytes. The survivors keep their order. */
+static void _gnut_outq_shed_lane(gnut_outq_t *q, int l, int what,
+    gnut_uint64_t now, sxs_uint32_t target) {
+
+    gnut_outq_lane_t *lane;
+    gnut_outq_ent_t *src, *dst;
+    sxs_uint32_t i, kept, mask;
+
+    lane = &q->lanes[l];
+    mask = lane->cap - 1;
+    kept = 0;
+    for (i = 0; i < lane->len; i++) {
+        src = &lane->ents[(lane->head + i) & mask];
+        if (q->bytes > target && _gnut_outq_sheddable(q, what, src, now)) {
+            _gnut_outq_account_drop(q, l, src->msg);
+            continue;
+        }
+        dst = &lane->ents[(lane->head + kept) & mask];
+        if (dst != src) {
+            *dst = *src;
+        }
+        kept++;
+    }
+    lane->len = kept;
+}
+
+static void _gnut_outq_shed(gnut_outq_t *q, gnut_uint64_t now) {
+    _gnut_outq_shed_lane(q, GNUT_OUTQ_LANE_PONG, SHED_STALE_PONGS, now, 0);
+    if (q->bytes > q->cfg.lo_water) {
+        _gnut_outq_shed_lane(q, GNUT_OUTQ_LANE_PING, SHED_PINGS, now,
+            q->cfg.lo_water);
+    }
+    if (q->bytes > q->cfg.lo_water) {
+        _gnut_outq_shed_lane(q, GNUT_OUTQ_LANE_QUERY, SHED_HIGH_HOP_QUERIES,
+            now, q->cfg.lo_water);
+    }
+}
+
+gnut_error_t gnut_outq_push(gnut_outq_t *q, gnut_enc_msg_t *msg,
+    gnut_uint64_t now) {
+
+    gnut_outq_lane_t *lane;
+    gnut_outq_ent_t *ent;
+    int l;
+
+    l = gnut_outq_lane_of(msg->data[16]);
+
+    /* Shed on every crossing, not just the one that starts congestion,
+     * so that a queue hovering between the watermarks is cut back each
+     * time it reaches hi_water again. */
+    if (q->bytes <= q->cfg.hi_water &&
+        q->bytes + msg->len > q->cfg.hi_water) {
+        q->congested = 1;
+        _gnut_outq_shed(q, now);
+        if (q->bytes <= q->cfg.lo_water) {
+            q->congested = 0;
+        }
+    }
+
+    if (q->congested) {
+        if (l == GNUT_OUTQ_LANE_PING ||
+            (l == GNUT_OUTQ_LANE_QUERY &&
+            msg->data[18] >= q->cfg.shed_hops)) {
+            q->stats.dropped[l]++;
+            gnut_stats_drop(GNUT_STATS_DROP_SHED);
+            return GNUT_EQUEUE_FULL;
+        }
+    }
+    lane = &q->lanes[l];
+    if ((l == GNUT_OUTQ_LANE_CONTROL &&
+        lane->bytes + msg->len > q->cfg.control_max) ||
+        (l != GNUT_OUTQ_LANE_BYE && l != GNUT_OUTQ_LANE_CONTROL &&
+        q->bytes + msg->len > q->cfg.max_bytes)) {
+        q->stats.dropped[l]++;
+        gnut_stats_drop(GNUT_STATS_DROP_SHED);
+        return GNUT_EQUEUE_FULL;
+    }
+
+    if (lane->len == lane->cap) {
+        if (_gnut_outq_grow(lane) != GNUT_SUCCESS) {
+            return GNUT_ENOMEM;
+        }
+    }
+    ent = &lane->ents[(lane->head + lane->len) & (lane->cap - 1)];
+    ent->msg = gnut_enc_msg_ref(msg);
+    ent->when = now;
+    lane->len++;
+    lane->bytes += msg->len;
+
+    q->bytes += msg->len;
+    q->len++;
+    q->stats.queued[l]++;
+    if (q->bytes > q->stats.peak_bytes) {
+        q->stats.peak_bytes = q->bytes;
+    }
+
+    return GNUT_SUCCESS;
+}
+
+gnut_enc_msg_t *gnut_outq_pop(gnut_outq_t *q, gnut_uint64_t now) {
+    return gnut_outq_pop_lanes(q, now, GNUT_OUTQ_ALL_LANES);
+}
+
+gnut_enc_msg_t *gnut_outq_pop_lanes(gnut_outq_t *q, gnut_uint64_t now,
+    int mask) {
+
+    gnut_outq_lane_t *lane;
+    gnut_outq_ent_t *ent;
+    gnut_enc_msg_t *msg;
+    int l;
+
+    for (l = 0; l < GNUT_OUTQ_NUM_LANES; l++) {
+        if (!(mask & GNUT_OUTQ_LANE_BIT(l))) {
+            continue;
+        }
+        lane = &q->lanes[l];
+        while (lane->len > 0) {
+            ent = &lane->ents[lane->head];
+            msg = ent->msg;
+            lane->head = (lane->head + 1) & (lane->cap - 1);
+            lane->len--;
+
+            if (l == GNUT_OUTQ_LANE_PONG &&
+                now - ent->when > q->cfg.pong_max_age) {
+                _gnut_outq_account_drop(q, l, msg);
+                continue;
+            }
+
+            q->bytes -= msg->len;
+            lane->bytes -= msg->len;
+            q->len--;
+            gnut_stats_record(GNUT_STATS_H_QUEUE, (now - ent->when) * 1000);
+            if (q->congested && q->bytes <= q->cfg.lo_water) {
+                q->congested = 0;
+            }
+            return msg;
+        }
+    }
+
+    if (q->bytes <= q->cfg.lo_water) {
+        q->congested = 0;
+    }
+
+    return NULL;
+}
+
+int gnut_outq_congested(const gnut_outq_t *q) {
+    return q->congested;
+}
@@ -0,0 +1,232 @@
+/*
+ * Copyright 2006-2007 Andrew De Ponte
+ *
+ * This file is part of lib_gnut.
+ *
+ * lib_gnut is the intellectual property of Andrew De Ponte; any
+ * distribution and/or modification and/or reproductions of any portion
+ * of lib_gnut MUST be approved by Andrew De Ponte.
+ *
+ * lib_gnut is distributed WITHOUT ANY WARRANTY; without even the
+ * implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE.
+ */
+
+/**
+ * @file gnut_outq.h
+ * @brief This is a specifications file for connection output queues.
+ *
+ * The gnut_outq.h file is a specifications file that declares the
+ * gnut_outq_t type, the output queue of a single connection. Messages
+ * wait in one lane per payload type and are sent in strict priority
+ * order: Bye, control, Push, Query Hit, Query, Pong, then Ping. Control
+ * messages, Vendor Messages and any other type, are this servent's own
+ * and go no further than the peer, so they are never shed once queued,
+ * but they have a small byte limit of their own. The number of queued
+ * bytes is bounded by watermarks, and when a peer falls behind the
+ * messages least likely to matter, high hop Queries and stale Pongs,
+ * are shed first.
+ */
+
+#ifndef GNUT_OUTQ_H
+#define GNUT_OUTQ_H
+
+#include <sxs/sxs.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+#include "gnut_export.h"
+#include "gnut_types.h"
+#include "gnut_error.h"
+#include "gnut_enc_msg.h"
+
+#define GNUT_OUTQ_LANE_BYE 0 /**< Bye lane, sent first */
+#define GNUT_OUTQ_LANE_CONTROL 1 /**< Vendor Message lane, also other types */
+#define GNUT_OUTQ_LANE_PUSH 2 /**< Push lane */
+#define GNUT_OUTQ_LANE_QUERY_HIT 3 /**< Query Hit lane */
+#define GNUT_OUTQ_LANE_QUERY 4 /**< Query lane */
+#define GNUT_OUTQ_LANE_PONG 5 /**< Pong lane */
+#define GNUT_OUTQ_LANE_PING 6 /**< Ping lane, sent last */
+#define GNUT_OUTQ_NUM_LANES 7 /**< Number of lanes */
+
+/** The bit of a lane in a lane mask */
+#define GNUT_OUTQ_LANE_BIT(l) (1 << (l))
+/** A lane mask with every lane */
+#define GNUT_OUTQ_ALL_LANES ((1 << GNUT_OUTQ_NUM_LANES) - 1)
+
+#define GNUT_OUTQ_DEF_HI_WATER 65536 /**< Default high watermark */
+#define GNUT_OUTQ_DEF_LO_WATER 32768 /**< Default low watermark */
+#define GNUT_OUTQ_DEF_MAX_BYTES 262144 /**< Default hard limit */
+#define GNUT_OUTQ_DEF_CONTROL_MAX 16384 /**< Default control lane limit */
+#define GNUT_OUTQ_DEF_SHED_HOPS 2 /**< Default hops of sheddable Queries */
+#define GNUT_OUTQ_DEF_PONG_AGE 5000000 /**< Default Pong lifetime in us */
+
+/**
+ * An Output Queue Configuration
+ *
+ * The gnut_outq_cfg_t is a type which holds the limits of an output
+ * queue. Use gnut_outq_cfg_init() to get the defaults.
+ */
+typedef struct GNUT_EXPORT gnut_outq_cfg {
+    sxs_uint32_t hi_water;      /* Start shedding at this many bytes */
+    sxs_uint32_t lo_water;      /* Stop shedding at this many bytes */
+    sxs_uint32_t max_bytes;     /* Refuse all but Byes, control past this */
+    sxs_uint32_t control_max;   /* Refuse control past this many in lane */
+    unsigned char shed_hops;    /* Queries with hops >= this are shed */
+    gnut_uint64_t pong_max_age; /* Pongs queued longer are stale, in us */
+} gnut_outq_cfg_t;
+
+/**
+ * An Output Queue Lane Entry
+ *
+ * The gnut_outq_ent_t is a type which represents one queued message
+ * and the time it was queued at.
+ */
+typedef struct GNUT_EXPORT gnut_outq_ent {
+    gnut_enc_msg_t *msg;
+    gnut_uint64_t when;
+} gnut_outq_ent_t;
+
+/**
+ * An Output Queue Lane
+ *
+ * The gnut_outq_lane_t is a type which represents a growable ring of
+ * entries of one priority.
+ */
+typedef struct GNUT_EXPORT gnut_outq_lane {
+    gnut_outq_ent_t *ents;
+    sxs_uint32_t cap;           /* Zero or a power of two */
+    sxs_uint32_t head;
+    sxs_uint32_t len;
+    sxs_uint32_t bytes;         /* Bytes queued in this lane */
+} gnut_outq_lane_t;
+
+/**
+ * Output Queue Statistics
+ *
+ * The gnut_outq_stats_t is a type which holds the counters of an
+ * output queue.
+ */
+typedef struct GNUT_EXPORT gnut_outq_stats {
+    gnut_uint64_t queued[GNUT_OUTQ_NUM_LANES];  /* Messages accepted */
+    gnut_uint64_t dropped[GNUT_OUTQ_NUM_LANES]; /* Messages shed */
+    sxs_uint32_t peak_bytes;
+} gnut_outq_stats_t;
+
+/**
+ * An Output Queue
+ *
+ * The gnut_outq_t is a type which represents the output queue of a
+ * connection. It holds a reference to each queued message.
+ */
+typedef struct GNUT_EXPORT gnut_outq {
+    gnut_outq_cfg_t cfg;
+    gnut_outq_lane_t lanes[GNUT_OUTQ_NUM_LANES];
+    sxs_uint32_t bytes;         /* Bytes queued in all lanes */
+    sxs_uint32_t len;           /* Messages queued in all lanes */
+    int congested;              /* Set at hi_water, cleared at lo_water */
+    gnut_outq_stats_t stats;
+} gnut_outq_t;
+
+/**
+ * Initialize an Output Queue Configuration
+ *
+ * The gnut_outq_cfg_init() function fills in 'cfg' with the default
+ * limits.
+ * @param cfg Pointer to the configuration to initialize.
+ */
+GNUT_EXPORT void gnut_outq_cfg_init(gnut_outq_cfg_t *cfg);
+
+/**
+ * Initialize an Output Queue
+ *
+ * The gnut_outq_init() function initializes an empty output queue with
+ * the limits in 'cfg', or the defaults if 'cfg' is NULL.
+ * @param q Pointer to the output queue to initialize.
+ * @param cfg Pointer to the configuration to use, or NULL.
+ */
+GNUT_EXPORT void gnut_outq_init(gnut_outq_t *q, const gnut_outq_cfg_t *cfg);
+
+/**
+ * Destroy an Output Queue
+ *
+ * The gnut_outq_destroy() function releases every queued message and
+ * frees the lanes.
+ * @param q Pointer to the output queue.
+ */
+GNUT_EXPORT void gnut_outq_destroy(gnut_outq_t *q);
+
+/**
+ * Get the Lane of a Payload Type
+ *
+ * @param type The payload type of a message.
+ * @return The lane messages of the type are queued in.
+ */
+GNUT_EXPORT int gnut_outq_lane_of(unsigned char type);
+
+/**
+ * Queue a Message
+ *
+ * The gnut_outq_push() function queues 'msg' in the lane for its type,
+ * taking a reference to it on success. Each push that takes the queue
+ * over the high watermark first sheds stale Pongs, Pings and high hop
+ * Queries already queued. While the queue is congested, Pings and high
+ * hop Queries are refused, once 'max_bytes' is reached everything but
+ * Byes and control messages is refused, and control messages are
+ * refused once their lane holds 'control_max' bytes.
+ * @param q Pointer to the output queue.
+ * @param msg Pointer to the message to queue.
+ * @param now The current time in microseconds.
+ * @return A value representing an error or success.
+ * @retval GNUT_SUCCESS Successfully queued the message.
+ * @retval GNUT_EQUEUE_FULL The message was shed by the drop policy.
+ * @retval GNUT_ENOMEM Failed to grow the lane.
+ */
+GNUT_EXPORT gnut_error_t gnut_outq_push(gnut_outq_t *q, gnut_enc_msg_t *msg,
+    gnut_uint64_t now);
+
+/**
+ * Dequeue a Message
+ *
+ * The gnut_outq_pop() function removes the message that should be sent
+ * next, skipping any Pongs that went stale while queued. The caller
+ * takes over the queue's reference.
+ * @param q Pointer to the output queue.
+ * @param now The current time in microseconds.
+ * @return Pointer to the message, or NULL if the queue is empty.
+ */
+GNUT_EXPORT gnut_enc_msg_t *gnut_outq_pop(gnut_outq_t *q, gnut_uint64_t now);
+
+/**
+ * Dequeue a Message from Some Lanes
+ *
+ * The gnut_outq_pop_lanes() function is gnut_outq_pop() restricted to
+ * the lanes whose GNUT_OUTQ_LANE_BIT() is set in 'mask'. Messages in
+ * the other lanes stay queued.
+ * @param q Pointer to the output queue.
+ * @param now The current time in microseconds.
+ * @param mask The lanes to dequeue from.
+ * @return Pointer to the message, or NULL if those lanes are empty.
+ */
+GNUT_EXPORT gnut_enc_msg_t *gnut_outq_pop_lanes(gnut_outq_t *q,
+    gnut_uint64_t now, int mask);
+
+/**
+ * Check Whether an Output Queue is Congested
+ *
+ * The gnut_outq_congested() function tells whether the queue has
+ * reached its high watermark and not yet drained to its low watermark.
+ * A connection may stop reading from peers whose traffic would be
+ * routed to a congested queue.
+ * @param q Pointer to the output queue.
+ * @return Non-zero if the queue is congested, 0 otherwise.
+ */
+GNUT_EXPORT int gnut_outq_congested(const gnut_outq_t *q);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* GNUT_OUTQ_H */
@@ -20,56 +20,76 @@
  * the gnut_pong_msg_t type's associated support functions.
  */
 
+#include <string.h> /* memcpy() */
+
 #include "gnut_pong_msg.h"
 
+/* All Pong fields are little-endian on the wire except the IP address,
+ * which is in network byte order and is kept that way. The bytes are
+ * assembled one at a time since a payload need not be aligned. */
+
 int _gnut_parse_pong_msg_payload(gnut_pong_payload_t *pl,
     unsigned char *raw_pl, sxs_uint32_t raw_pl_len) {
 
     unsigned char *tmp_p;
-    
+
+    if (raw_pl_len < GNUT_PONG_PAYLOAD_LEN) {
+        return -1;
+    }
+
     tmp_p = raw_pl;
-    pl->port_num = sxs_ntohs(*((sxs_uint16_t *)tmp_p));
+    pl->port_num = (sxs_uint16_t)(tmp_p[0] | (tmp_p[1] << 8));
     tmp_p += sizeof(sxs_uint16_t);
-    
-    pl->ip_addr.s_addr = sxs_ntohs(*((sxs_uint32_t *)tmp_p));
+
+    memcpy((void *)&pl->ip_addr.s_addr, (const void *)tmp_p,
+        sizeof(sxs_uint32_t));
     tmp_p += sizeof(sxs_uint32_t);
-    
-    pl->num_shared_files = sxs_ntohs(*((sxs_uint32_t *)tmp_p));
+
+    pl->num_shared_files = (sxs_uint32_t)tmp_p[0] |
+        ((sxs_uint32_t)tmp_p[1] << 8) | ((sxs_uint32_t)tmp_p[2] << 16) |
+        ((sxs_uint32_t)tmp_p[3] << 24);
     tmp_p += sizeof(sxs_uint32_t);
-    
-    pl->kb_shared = sxs_ntohs(*((sxs_uint32_t *)tmp_p));
-    tmp_ += sizeof(sxs_uint32_t);
-    
+
+    pl->kb_shared = (sxs_uint32_t)tmp_p[0] |
+        ((sxs_uint32_t)tmp_p[1] << 8) | ((sxs_uint32_t)tmp_p[2] << 16) |
+        ((sxs_uint32_t)tmp_p[3] << 24);
+
     return 0;
 }
 
 int _gnut_build_pong_msg_payload(gnut_pong_payload_t *pl,
     unsigned char *raw_pl) {
-   
+
     unsigned char *tmp_p;
-    
+
     tmp_p = raw_pl;
-    
-    *((sxs_uint16_t)tmp_p) = sxs_htons(pl->port_num);
+
+    tmp_p[0] = (unsigned char)(pl->port_num & 0xff);
+    tmp_p[1] = (unsigned char)((pl->port_num >> 8) & 0xff);
     tmp_p = tmp_p + sizeof(sxs_uint16_t);
-    
-    *((sxs_uint32_t)tmp_p) = sxs_htonl(pl->ip_addr.s_addr);
-    tmp_p = tmp_p + sizeof(sxs_uint32_t);
-    
-    *((sxs_uint32_t)tmp_p) = sxs_htonl(pl->num_shared_files);
+
+    memcpy((void *)tmp_p, (const void *)&pl->ip_addr.s_addr,
+        sizeof(sxs_uint32_t));
     tmp_p = tmp_p + sizeof(sxs_uint32_t);
-    
-    *((sxs_uint32_t)tmp_p) = sxs_htonl(pl->kb_shared);
+
+    tmp_p[0] = (unsigned char)(pl->num_shared_files & 0xff);
+    tmp_p[1] = (unsigned char)((pl->num_shared_files >> 8) & 0xff);
+    tmp_p[2] = (unsigned char)((pl->num_shared_files >> 16) & 0xff);
+    tmp_p[3] = (unsigned char)((pl->num_shared_files >> 24) & 0xff);
     tmp_p = tmp_p + sizeof(sxs_uint32_t);
-    
+
+    tmp_p[0] = (unsigned char)(pl->kb_shared & 0xff);
+    tmp_p[1] = (unsigned char)((pl->kb_shared >> 8) & 0xff);
+    tmp_p[2] = (unsigned char)((pl->kb_shared >> 16) & 0xff);
+    tmp_p[3] = (unsigned char)((pl->kb_shared >> 24) & 0xff);
+
     return 0;
 }
 
 int _gnut_calc_pong_msg_payload_len(gnut_pong_payload_t *pl) {
-    return (sizeof(sxs_uint16_t) + sizeof(sxs_uint32_t) + \
-        sizeof(sxs_uint32_t) + sizeof(sxs_uint32_t));
+    return GNUT_PONG_PAYLOAD_LEN;
 }
 
 void _gnut_free_pong_msg_payload(gnut_pong_payload_t *pl) {
     return;
-}
\ No newline at end of file
+}
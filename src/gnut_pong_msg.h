@@ -13,7 +13,7 @@
  */
  
 /**
- * @file gnut_pong_msgs.h
+ * @file gnut_pong_msg.h
  * @brief This is a specifications file for gnut_pong_msg_t type.
  *
  * The gnut_pong_msg.h file is a specifications file that declares the
@@ -23,6 +23,12 @@
 #ifndef GNUT_PONG_MSG_H
 #define GNUT_PONG_MSG_H
 
+#include <sxs/sxs.h>
+
+#include "gnut_export.h"
+
+#define GNUT_PONG_PAYLOAD_LEN 14 /**< Length of a Pong payload in bytes */
+
 typedef struct gnut_pong_payload {
     sxs_uint16_t port_num;
     struct in_addr ip_addr;
@@ -30,14 +36,14 @@ typedef struct gnut_pong_payload {
     sxs_uint32_t kb_shared;
 } gnut_pong_payload_t;
 
-int _gnut_parse_pong_msg_payload(gnut_pong_payload_t *pl,
+GNUT_EXPORT int _gnut_parse_pong_msg_payload(gnut_pong_payload_t *pl,
     unsigned char *raw_pl, sxs_uint32_t raw_pl_len);
-    
-int _gnut_build_pong_msg_payload(gnut_pong_payload_t *pl,
+
+GNUT_EXPORT int _gnut_build_pong_msg_payload(gnut_pong_payload_t *pl,
     unsigned char *raw_pl);
-    
-int _gnut_calc_pong_msg_payload_len(gnut_pong_payload_t *pl);
 
-void _gnut_free_pong_msg_payload(gnut_pong_payload_t *pl);
+GNUT_EXPORT int _gnut_calc_pong_msg_payload_len(gnut_pong_payload_t *pl);
+
+GNUT_EXPORT void _gnut_free_pong_msg_payload(gnut_pong_payload_t *pl);
 
 #endif /* GNUT_PONG_MSG_H */
@@ -0,0 +1,95 @@
+/*
+ * Copyright 2006-2007 Andrew De Ponte
+ *
+ * This file is part of lib_gnut.
+ *
+ * lib_gnut is the intellectual property of Andrew De Ponte; any
+ * distribution and/or modification and/or reproductions of any portion
+ * of lib_gnut MUST be approved by Andrew De Ponte.
+ *
+ * lib_gnut is distributed WITHOUT ANY WARRANTY; without even the
+ * implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE.
+ */
+
+/**
+ * @file gnut_probes.h
+ * @brief This is an internal specifications file for static tracepoints.
+ *
+ * The gnut_probes.h file is an internal specifications file that wraps
+ * the USDT probes of sys/sdt.h, under the provider lib_gnut, so that a
+ * tracer such as bpftrace can follow a message through a running
+ * servent. It is not installed. Where sys/sdt.h is missing, or the
+ * build was configured with --disable-probes, the probes compile to
+ * nothing.
+ *
+ * Each probe has a semaphore, which a tracer raises while it is
+ * attached. Until then a probe site costs one load and a branch, and
+ * its arguments are not evaluated. The probes, with their arguments,
+ * are:
+ *
+ * - hdr_decode(type, guid, pl_len, ttl, hops): a header was decoded.
+ * - conn_recv(sd, type, guid, pl_len): a connection framed a message.
+ * - dispatch(from, type, guid, pl_len): a node began routing it.
+ * - dedupe(from, type, guid, dup): a Ping or Query was checked against
+ *   the Message IDs seen before; 'dup' is 1 if it was among them.
+ * - route(from, type, guid, to): a reply or Push was looked up; 'to'
+ *   is the connection id found, or GNUT_ROUTE_NONE or GNUT_ROUTE_SELF.
+ * - conn_send(sd, type, guid, len): a message was queued to be sent.
+ * - send_done(sd, type, guid, len): its last byte was handed to the
+ *   write that sends it.
+ *
+ * 'guid' is the first 8 bytes of the Message ID as a big endian number,
+ * 'sd' is the connection's socket, 'from' and 'to' are the connection
+ * ids of the node's owner, and 'len' counts the header.
+ */
+
+#ifndef GNUT_PROBES_H
+#define GNUT_PROBES_H
+
+#ifdef HAVE_SYS_SDT_H
+
+#define _SDT_HAS_SEMAPHORES 1
+#include <sys/sdt.h>
+
+/* Defines the semaphore of a probe, in the one file that fires it. */
+#define GNUT_PROBE_SEMAPHORE(name) \
+    volatile unsigned short lib_gnut_##name##_semaphore \
+    __attribute__((unused, section(".probes")))
+
+#define GNUT_PROBE_ON(name) \
+    __builtin_expect(lib_gnut_##name##_semaphore != 0, 0)
+
+#define GNUT_PROBE4(name, a, b, c, d) do { \
+    if (GNUT_PROBE_ON(name)) { \
+        DTRACE_PROBE4(lib_gnut, name, a, b, c, d); \
+    } \
+} while (0)
+
+#define GNUT_PROBE5(name, a, b, c, d, e) do { \
+    if (GNUT_PROBE_ON(name)) { \
+        DTRACE_PROBE5(lib_gnut, name, a, b, c, d, e); \
+    } \
+} while (0)
+
+#else
+
+#define GNUT_PROBE_SEMAPHORE(name) \
+    extern int _gnut_probe_unused_##name /* Swallows the semicolon */
+#define GNUT_PROBE4(name, a, b, c, d) do { } while (0)
+#define GNUT_PROBE5(name, a, b, c, d, e) do { } while (0)
+
+#endif /* HAVE_SYS_SDT_H */
+
+/* The first 8 bytes of a Message ID, most significant first. */
+#define GNUT_PROBE_GUID(id) \
+    (((unsigned long long)(id)[0] << 56) | \
+    ((unsigned long long)(id)[1] << 48) | \
+    ((unsigned long long)(id)[2] << 40) | \
+    ((unsigned long long)(id)[3] << 32) | \
+    ((unsigned long long)(id)[4] << 24) | \
+    ((unsigned long long)(id)[5] << 16) | \
+    ((unsigned long long)(id)[6] << 8) | \
+    (unsigned long long)(id)[7])
+
+#endif /* GNUT_PROBES_H */
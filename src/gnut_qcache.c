@@ -0,0 +1,344 @@
+/*
+ * Copyright 2006-2007 Andrew De Ponte
+ *
+ * This file is part of lib_gnut.
+ *
+ * lib_gnut is the intellectual property of Andrew De Ponte; any
+ * distribution and/or modification and/or reproductions of any portion
+ * of lib_gnut MUST be approved by Andrew De Ponte.
+ *
+ * lib_gnut is distributed WITHOUT ANY WARRANTY; without even the
+ * implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE.
+ */
+
+/**
+ * @file gnut_qcache.c
+ * @brief This is an implementation file for the Query result cache.
+ *
+ * The gnut_qcache.c file is an implementation file that defines the
+ * gnut_qcache_t type's associated functions. Each entry is one
+ * allocation holding its key and its result records, found through a
+ * chained hash table and kept on a list from least to most recently
+ * used.
+ */
+
+#include <stdlib.h> /* calloc(), malloc(), free() */
+#include <string.h> /* memcmp(), memcpy(), memset() */
+
+#include "gnut_qcache.h"
+
+#define KEY_MAX (1 + GNUT_INDEX_MAX_TERMS * (GNUT_TOKEN_MAX_LEN + 1))
+#define KEY_KEYWORDS 'K'
+#define KEY_URNS 'U'
+
+typedef struct gnut_qcache_ent {
+    struct gnut_qcache_ent *hnext;  /* Next in its bucket */
+    struct gnut_qcache_ent *prev;   /* Less recently used */
+    struct gnut_qcache_ent *next;   /* More recently used */
+    sxs_uint32_t hash;
+    sxs_uint32_t max_results;
+    sxs_uint32_t key_len;
+    sxs_uint32_t recs_len;
+    sxs_uint32_t num_recs;
+} gnut_qcache_ent_t;
+
+struct gnut_qcache {
+    gnut_index_t *idx;
+    sxs_uint32_t gen;           /* Of the index, when the entries were made */
+    gnut_qcache_ent_t **buckets;
+    sxs_uint32_t mask;
+    gnut_qcache_ent_t *lru;     /* Least recently used */
+    gnut_qcache_ent_t *mru;     /* Most recently used */
+    sxs_uint32_t max_entries;
+    sxs_uint32_t max_bytes;
+    unsigned char key[KEY_MAX];
+    unsigned char *hit_buf;     /* GNUT_QCACHE_MAX_HIT_LEN, for misses */
+    gnut_qcache_stats_t st;
+};
+
+/* The key and then the result records follow each entry. */
+#define ENT_KEY(e) ((unsigned char *)((e) + 1))
+#define ENT_RECS(e) (ENT_KEY(e) + (e)->key_len)
+
+static sxs_uint32_t _gnut_qcache_hash(const unsigned char *key,
+    sxs_uint32_t len, sxs_uint32_t max_results) {
+
+    sxs_uint32_t h, i;
+
+    h = 2166136261U ^ max_results;
+    for (i = 0; i < len; i++) {
+        h = (h ^ key[i]) * 16777619U;
+    }
+    return h;
+}
+
+/* Orders keywords by their bytes, a prefix before what it begins. */
+static int _gnut_qcache_kw_cmp(const char *folded, const gnut_token_t *a,
+    const gnut_token_t *b) {
+
+    int c;
+
+    c = memcmp((const void *)(folded + a->off),
+        (const void *)(folded + b->off), (a->len < b->len) ? a->len : b->len);
+    if (c != 0) {
+        return c;
+    }
+    return (a->len > b->len) - (a->len < b->len);
+}
+
+/* Builds the key of 'q' in 'key' and returns its length, or 0 if 'q'
+ * names too many urn:sha1 values to be cached. Like the index, a Query
+ * with urn:sha1 values is keyed by them alone, in order since results
+ * follow it, and one without by its first GNUT_INDEX_MAX_TERMS keywords
+ * sorted, each once. */
+static sxs_uint32_t _gnut_qcache_key(const gnut_query_t *q,
+    unsigned char *key) {
+
+    char folded[GNUT_TOKEN_FOLD_LEN(GNUT_INDEX_MAX_TEXT)];
+    gnut_token_t toks[GNUT_INDEX_MAX_TERMS], tmp;
+    unsigned char sha1[GNUT_SHA1_LEN];
+    sxs_uint32_t n, pos, len, i, j;
+
+    n = 0;
+    pos = 0;
+    while (gnut_ext_next_sha1(q->ext, q->ext_len, &pos, sha1)) {
+        if (n == GNUT_QCACHE_MAX_URNS) {
+            return 0;
+        }
+        memcpy((void *)(key + 1 + n * GNUT_SHA1_LEN), (const void *)sha1,
+            GNUT_SHA1_LEN);
+        n++;
+    }
+    if (n > 0) {
+        key[0] = KEY_URNS;
+        return 1 + n * GNUT_SHA1_LEN;
+    }
+
+    n = gnut_tokenize(q->criteria, (q->criteria_len < GNUT_INDEX_MAX_TEXT) ?
+        q->criteria_len : GNUT_INDEX_MAX_TEXT, folded, toks,
+        GNUT_INDEX_MAX_TERMS);
+    for (i = 1; i < n; i++) {
+        tmp = toks[i];
+        for (j = i; j > 0 && _gnut_qcache_kw_cmp(folded, &toks[j - 1],
+            &tmp) > 0; j--) {
+            toks[j] = toks[j - 1];
+        }
+        toks[j] = tmp;
+    }
+    key[0] = KEY_KEYWORDS;
+    len = 1;
+    for (i = 0; i < n; i++) {
+        if (i > 0 && _gnut_qcache_kw_cmp(folded, &toks[i - 1],
+            &toks[i]) == 0) {
+            continue;
+        }
+        memcpy((void *)(key + len), (const void *)(folded + toks[i].off),
+            toks[i].len);
+        len += toks[i].len;
+        key[len++] = '\0';
+    }
+    return len;
+}
+
+static void _gnut_qcache_unlink(gnut_qcache_t *qc, gnut_qcache_ent_t *e) {
+    if (e->prev != NULL) {
+        e->prev->next = e->next;
+    } else {
+        qc->lru = e->next;
+    }
+    if (e->next != NULL) {
+        e->next->prev = e->prev;
+    } else {
+        qc->mru = e->prev;
+    }
+}
+
+static void _gnut_qcache_link(gnut_qcache_t *qc, gnut_qcache_ent_t *e) {
+    e->prev = qc->mru;
+    e->next = NULL;
+    if (qc->mru != NULL) {
+        qc->mru->next = e;
+    } else {
+        qc->lru = e;
+    }
+    qc->mru = e;
+}
+
+static void _gnut_qcache_drop(gnut_qcache_t *qc, gnut_qcache_ent_t *e) {
+    gnut_qcache_ent_t **pp;
+
+    for (pp = &qc->buckets[e->hash & qc->mask]; *pp != e;
+        pp = &(*pp)->hnext) {
+    }
+    *pp = e->hnext;
+    _gnut_qcache_unlink(qc, e);
+    qc->st.entries--;
+    qc->st.bytes -= e->key_len + e->recs_len;
+    free(e);
+}
+
+static gnut_qcache_ent_t *_gnut_qcache_find(const gnut_qcache_t *qc,
+    sxs_uint32_t hash, sxs_uint32_t key_len, sxs_uint32_t max_results) {
+
+    gnut_qcache_ent_t *e;
+
+    for (e = qc->buckets[hash & qc->mask]; e != NULL; e = e->hnext) {
+        if (e->hash == hash && e->key_len == key_len &&
+            e->max_results == max_results &&
+            memcmp((const void *)ENT_KEY(e), (const void *)qc->key,
+            key_len) == 0) {
+            return e;
+        }
+    }
+    return NULL;
+}
+
+/* Keeps the records answering the key in qc->key, making room for them
+ * by dropping the least recently used entries. Nothing is kept if they
+ * could never fit or memory runs out, as the cache is only an aid. */
+static void _gnut_qcache_keep(gnut_qcache_t *qc, sxs_uint32_t hash,
+    sxs_uint32_t key_len, sxs_uint32_t max_results,
+    const unsigned char *recs, sxs_uint32_t recs_len, sxs_uint32_t num) {
+
+    gnut_qcache_ent_t *e;
+
+    if (key_len + recs_len > qc->max_bytes) {
+        return;
+    }
+    while (qc->st.entries == qc->max_entries ||
+        qc->st.bytes + key_len + recs_len > qc->max_bytes) {
+        _gnut_qcache_drop(qc, qc->lru);
+        qc->st.evictions++;
+    }
+
+    e = (gnut_qcache_ent_t *)malloc(sizeof(gnut_qcache_ent_t) + key_len +
+        recs_len);
+    if (e == NULL) {
+        return;
+    }
+    e->hash = hash;
+    e->max_results = max_results;
+    e->key_len = key_len;
+    e->recs_len = recs_len;
+    e->num_recs = num;
+    memcpy((void *)ENT_KEY(e), (const void *)qc->key, key_len);
+    memcpy((void *)ENT_RECS(e), (const void *)recs, recs_len);
+
+    e->hnext = qc->buckets[hash & qc->mask];
+    qc->buckets[hash & qc->mask] = e;
+    _gnut_qcache_link(qc, e);
+    qc->st.entries++;
+    qc->st.bytes += key_len + recs_len;
+}
+
+gnut_error_t gnut_qcache_new(gnut_qcache_t **pp_qc, gnut_index_t *idx,
+    sxs_uint32_t max_entries, sxs_uint32_t max_bytes) {
+
+    gnut_qcache_t *qc;
+    sxs_uint32_t num_buckets;
+
+    if (max_entries == 0) {
+        max_entries = GNUT_QCACHE_DEF_ENTRIES;
+    }
+    if (max_bytes == 0) {
+        max_bytes = GNUT_QCACHE_DEF_BYTES;
+    }
+    num_buckets = 16;
+    while (num_buckets < max_entries && num_buckets < 0x80000000U) {
+        num_buckets <<= 1;
+    }
+
+    qc = (gnut_qcache_t *)calloc(1, sizeof(gnut_qcache_t));
+    if (qc == NULL) {
+        return GNUT_ENOMEM;
+    }
+    qc->buckets = (gnut_qcache_ent_t **)calloc(num_buckets,
+        sizeof(gnut_qcache_ent_t *));
+    qc->hit_buf = (unsigned char *)malloc(GNUT_QCACHE_MAX_HIT_LEN);
+    if (qc->buckets == NULL || qc->hit_buf == NULL) {
+        free(qc->buckets);
+        free(qc->hit_buf);
+        free(qc);
+        return GNUT_ENOMEM;
+    }
+    qc->idx = idx;
+    qc->gen = gnut_index_generation(idx);
+    qc->mask = num_buckets - 1;
+    qc->max_entries = max_entries;
+    qc->max_bytes = max_bytes;
+
+    *pp_qc = qc;
+    return GNUT_SUCCESS;
+}
+
+void gnut_qcache_free(gnut_qcache_t *qc) {
+    gnut_qcache_clear(qc);
+    free(qc->buckets);
+    free(qc->hit_buf);
+    free(qc);
+}
+
+sxs_uint32_t gnut_qcache_answer(gnut_qcache_t *qc, const gnut_query_t *q,
+    gnut_qhit_t *h, sxs_uint32_t max_results) {
+
+    gnut_qcache_ent_t *e;
+    gnut_qhit_t miss;
+    sxs_uint32_t gen, key_len, hash, num;
+
+    if (max_results == 0) {
+        return 0;
+    }
+    gen = gnut_index_generation(qc->idx);
+    if (gen != qc->gen) {
+        if (qc->st.entries > 0) {
+            gnut_qcache_clear(qc);
+            qc->st.flushes++;
+        }
+        qc->gen = gen;
+    }
+
+    key_len = _gnut_qcache_key(q, qc->key);
+    if (key_len == 0) {
+        qc->st.uncached++;
+        return gnut_index_answer(qc->idx, q, h, max_results);
+    }
+    hash = _gnut_qcache_hash(qc->key, key_len, max_results);
+    e = _gnut_qcache_find(qc, hash, key_len, max_results);
+    if (e != NULL) {
+        qc->st.hits++;
+        _gnut_qcache_unlink(qc, e);
+        _gnut_qcache_link(qc, e);
+        return gnut_qhit_add_records(h, ENT_RECS(e), e->recs_len,
+            e->num_recs);
+    }
+
+    /* Answer into a Query Hit of our own, so that what is kept does not
+     * depend on the room left in 'h'. */
+    qc->st.misses++;
+    gnut_qhit_begin(&miss, qc->hit_buf, GNUT_QCACHE_MAX_HIT_LEN, 0, 0, 0);
+    num = gnut_index_answer(qc->idx, q, &miss, max_results);
+    _gnut_qcache_keep(qc, hash, key_len, max_results,
+        qc->hit_buf + GNUT_QHIT_HDR_LEN, miss.len - GNUT_QHIT_HDR_LEN, num);
+    return gnut_qhit_add_records(h, qc->hit_buf + GNUT_QHIT_HDR_LEN,
+        miss.len - GNUT_QHIT_HDR_LEN, num);
+}
+
+void gnut_qcache_clear(gnut_qcache_t *qc) {
+    gnut_qcache_ent_t *e, *next;
+
+    for (e = qc->lru; e != NULL; e = next) {
+        next = e->next;
+        free(e);
+    }
+    memset((void *)qc->buckets, 0,
+        (qc->mask + 1) * sizeof(gnut_qcache_ent_t *));
+    qc->lru = NULL;
+    qc->mru = NULL;
+    qc->st.entries = 0;
+    qc->st.bytes = 0;
+}
+
+void gnut_qcache_stats(const gnut_qcache_t *qc, gnut_qcache_stats_t *st) {
+    *st = qc->st;
+}
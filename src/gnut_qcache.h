@@ -0,0 +1,140 @@
+/*
+ * Copyright 2006-2007 Andrew De Ponte
+ *
+ * This file is part of lib_gnut.
+ *
+ * lib_gnut is the intellectual property of Andrew De Ponte; any
+ * distribution and/or modification and/or reproductions of any portion
+ * of lib_gnut MUST be approved by Andrew De Ponte.
+ *
+ * lib_gnut is distributed WITHOUT ANY WARRANTY; without even the
+ * implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE.
+ */
+
+/**
+ * @file gnut_qcache.h
+ * @brief This is a specifications file for the Query result cache.
+ *
+ * The gnut_qcache.h file is a specifications file that declares the
+ * gnut_qcache_t type and its associated functions. A Query result cache
+ * sits in front of a shared file index and keeps the result records it
+ * answered recent Queries with, so that a popular search arriving again
+ * from other leaves is answered by copying them rather than by
+ * intersecting lists and encoding results once more.
+ *
+ * Queries are keyed by what the index answers them by: their sorted,
+ * distinct keywords, or their urn:sha1 values when they have any,
+ * together with the most results asked for. So "Foo bar" and
+ * "BAR  foo" share an entry. Entries are dropped, least recently used
+ * first, to stay within a number of entries and of bytes, and all of
+ * them are dropped when the generation of the index shows that a file
+ * was added, removed or given a digest since they were made.
+ */
+
+#ifndef GNUT_QCACHE_H
+#define GNUT_QCACHE_H
+
+#include <sxs/sxs.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+#include "gnut_export.h"
+#include "gnut_types.h"
+#include "gnut_error.h"
+#include "gnut_query.h"
+#include "gnut_index.h"
+
+#define GNUT_QCACHE_DEF_ENTRIES 4096 /**< Default most entries */
+#define GNUT_QCACHE_DEF_BYTES (4 * 1024 * 1024) /**< Default most bytes */
+#define GNUT_QCACHE_MAX_URNS 16 /**< More urn:sha1 values are not cached */
+#define GNUT_QCACHE_MAX_HIT_LEN 65536 /**< Payload a miss is answered in */
+
+/**
+ * A Query Result Cache
+ *
+ * The gnut_qcache_t is an opaque type which represents a Query result
+ * cache.
+ */
+typedef struct gnut_qcache gnut_qcache_t;
+
+/**
+ * Query Result Cache Statistics
+ *
+ * The gnut_qcache_stats_t is a type which holds the counters and the
+ * size of a Query result cache.
+ */
+typedef struct GNUT_EXPORT gnut_qcache_stats {
+    gnut_uint64_t hits;         /* Queries answered from an entry */
+    gnut_uint64_t misses;       /* Queries answered by the index */
+    gnut_uint64_t uncached;     /* Queries too big to be keyed */
+    gnut_uint64_t evictions;    /* Entries dropped to make room */
+    gnut_uint64_t flushes;      /* Times the index changed under entries */
+    sxs_uint32_t entries;       /* Entries held */
+    sxs_uint32_t bytes;         /* Bytes of keys and results held */
+} gnut_qcache_stats_t;
+
+/**
+ * Create a Query Result Cache
+ *
+ * @param pp_qc Pointer to store the pointer to the new, empty cache in.
+ * @param idx Pointer to the index to answer misses with, which must
+ * outlive the cache.
+ * @param max_entries The most entries to hold, or 0 for the default.
+ * @param max_bytes The most bytes of keys and results to hold, or 0
+ * for the default.
+ * @return A value representing an error or success.
+ * @retval GNUT_SUCCESS Successfully created the cache.
+ * @retval GNUT_ENOMEM Failed to allocate memory.
+ */
+GNUT_EXPORT gnut_error_t gnut_qcache_new(gnut_qcache_t **pp_qc,
+    gnut_index_t *idx, sxs_uint32_t max_entries, sxs_uint32_t max_bytes);
+
+/**
+ * Free a Query Result Cache
+ *
+ * @param qc Pointer to the cache.
+ */
+GNUT_EXPORT void gnut_qcache_free(gnut_qcache_t *qc);
+
+/**
+ * Answer a Query through a Query Result Cache
+ *
+ * The gnut_qcache_answer() function adds the result records the index
+ * would answer 'q' with to the Query Hit 'h', as gnut_index_answer()
+ * does, taking them from the cache if a Query with the same key was
+ * answered since the index last changed, and keeping them otherwise.
+ * Misses are answered into a payload of GNUT_QCACHE_MAX_HIT_LEN bytes,
+ * so no more results than fit in it are added.
+ * @param qc Pointer to the cache.
+ * @param q Pointer to the parsed Query.
+ * @param h Pointer to a Query Hit begun with gnut_qhit_begin().
+ * @param max_results The most results to add.
+ * @return The number of results added.
+ */
+GNUT_EXPORT sxs_uint32_t gnut_qcache_answer(gnut_qcache_t *qc,
+    const gnut_query_t *q, gnut_qhit_t *h, sxs_uint32_t max_results);
+
+/**
+ * Empty a Query Result Cache
+ *
+ * @param qc Pointer to the cache.
+ */
+GNUT_EXPORT void gnut_qcache_clear(gnut_qcache_t *qc);
+
+/**
+ * Get the Statistics of a Query Result Cache
+ *
+ * @param qc Pointer to the cache.
+ * @param st Pointer to the statistics to fill in.
+ */
+GNUT_EXPORT void gnut_qcache_stats(const gnut_qcache_t *qc,
+    gnut_qcache_stats_t *st);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* GNUT_QCACHE_H */
@@ -0,0 +1,202 @@
+/*
+ * Copyright 2006-2007 Andrew De Ponte
+ *
+ * This file is part of lib_gnut.
+ *
+ * lib_gnut is the intellectual property of Andrew De Ponte; any
+ * distribution and/or modification and/or reproductions of any portion
+ * of lib_gnut MUST be approved by Andrew De Ponte.
+ *
+ * lib_gnut is distributed WITHOUT ANY WARRANTY; without even the
+ * implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE.
+ */
+
+/**
+ * @file gnut_qdedupe.c
+ * @brief This is an implementation file for repeated Query suppression.
+ *
+ * The gnut_qdedupe.c file is an implementation file that defines the
+ * gnut_qdedupe_t type's associated functions. The hash is that of
+ * MurmurHash64A, which reads eight bytes per multiply.
+ */
+
+#include <stdlib.h> /* calloc(), free() */
+#include <string.h> /* memcpy(), memset() */
+
+#include "gnut_qdedupe.h"
+#include "gnut_msgs.h"
+
+#define MIN_SPEED_LEN 2
+#define HASH_M 0xc6a4a7935bd1e995ULL
+#define HASH_R 47
+
+static gnut_uint64_t _gnut_qdedupe_mix(gnut_uint64_t h) {
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    return h;
+}
+
+/* Returns the count of 'hash' on 'conn', or the empty entry it would
+ * take. */
+static gnut_qdedupe_ent_t *_gnut_qdedupe_find(gnut_qdedupe_t *qd,
+    gnut_uint64_t hash, sxs_uint32_t conn) {
+
+    gnut_qdedupe_ent_t *e;
+    sxs_uint32_t i;
+
+    i = (sxs_uint32_t)_gnut_qdedupe_mix(hash ^ conn) & qd->mask;
+    for (;;) {
+        e = &qd->ents[i];
+        if (e->count == 0 || (e->hash == hash && e->conn == conn)) {
+            return e;
+        }
+        i = (i + 1) & qd->mask;
+    }
+}
+
+static void _gnut_qdedupe_count(gnut_qdedupe_t *qd, gnut_qdedupe_ent_t *e,
+    gnut_uint64_t hash, sxs_uint32_t conn) {
+
+    if (e->count == 0) {
+        e->hash = hash;
+        e->conn = conn;
+        qd->used++;
+    }
+    e->count++;
+}
+
+static void _gnut_qdedupe_restart(gnut_qdedupe_t *qd) {
+    memset((void *)qd->ents, 0,
+        (qd->mask + 1) * sizeof(gnut_qdedupe_ent_t));
+    qd->used = 0;
+    qd->window_start = qd->now;
+    qd->stats.windows++;
+}
+
+void gnut_qdedupe_cfg_init(gnut_qdedupe_cfg_t *cfg) {
+    cfg->window = GNUT_QDEDUPE_DEF_WINDOW;
+    cfg->per_conn = GNUT_QDEDUPE_DEF_PER_CONN;
+    cfg->global = GNUT_QDEDUPE_DEF_GLOBAL;
+    cfg->capacity = GNUT_QDEDUPE_DEF_CAPACITY;
+}
+
+gnut_error_t gnut_qdedupe_init(gnut_qdedupe_t *qd,
+    const gnut_qdedupe_cfg_t *cfg, gnut_uint64_t now) {
+
+    sxs_uint32_t len;
+
+    memset((void *)qd, 0, sizeof(gnut_qdedupe_t));
+    qd->cfg = *cfg;
+    if (qd->cfg.capacity < 2) {
+        qd->cfg.capacity = 2;
+    }
+    len = 4;
+    while (len < 2 * qd->cfg.capacity && len < 0x80000000U) {
+        len <<= 1;
+    }
+    qd->ents = (gnut_qdedupe_ent_t *)calloc(len,
+        sizeof(gnut_qdedupe_ent_t));
+    if (qd->ents == NULL) {
+        return GNUT_ENOMEM;
+    }
+    qd->mask = len - 1;
+    qd->now = now;
+    qd->window_start = now;
+    return GNUT_SUCCESS;
+}
+
+void gnut_qdedupe_destroy(gnut_qdedupe_t *qd) {
+    free(qd->ents);
+    qd->ents = NULL;
+}
+
+void gnut_qdedupe_tick(gnut_qdedupe_t *qd, gnut_uint64_t now) {
+    qd->now = now;
+    if (now - qd->window_start >= qd->cfg.window) {
+        _gnut_qdedupe_restart(qd);
+    }
+}
+
+gnut_uint64_t gnut_qdedupe_hash(const unsigned char *pl,
+    sxs_uint32_t pl_len) {
+
+    const unsigned char *p;
+    gnut_uint64_t h, k;
+    sxs_uint32_t len;
+
+    if (pl_len < MIN_SPEED_LEN) {
+        return 0;
+    }
+    p = pl + MIN_SPEED_LEN;
+    len = pl_len - MIN_SPEED_LEN;
+    h = (gnut_uint64_t)len * HASH_M;
+    for (; len >= 8; p += 8, len -= 8) {
+        memcpy((void *)&k, (const void *)p, 8);
+        k *= HASH_M;
+        k ^= k >> HASH_R;
+        k *= HASH_M;
+        h ^= k;
+        h *= HASH_M;
+    }
+    if (len > 0) {
+        k = 0;
+        memcpy((void *)&k, (const void *)p, len);
+        h ^= k;
+        h *= HASH_M;
+    }
+    h ^= h >> HASH_R;
+    h *= HASH_M;
+    h ^= h >> HASH_R;
+    return h;
+}
+
+int gnut_qdedupe_check(gnut_qdedupe_t *qd, sxs_uint32_t conn,
+    const unsigned char *pl, sxs_uint32_t pl_len) {
+
+    gnut_qdedupe_ent_t *pc, *g;
+    gnut_uint64_t hash;
+
+    if (qd->cfg.per_conn == 0 && qd->cfg.global == 0) {
+        qd->stats.passed++;
+        return 1;
+    }
+    if (qd->used + 2 > qd->cfg.capacity) {
+        _gnut_qdedupe_restart(qd);
+        qd->stats.early++;
+    }
+
+    hash = gnut_qdedupe_hash(pl, pl_len);
+    pc = NULL;
+    if (qd->cfg.per_conn > 0) {
+        pc = _gnut_qdedupe_find(qd, hash, conn);
+        if (pc->count >= qd->cfg.per_conn) {
+            qd->stats.suppressed_conn++;
+            qd->stats.bytes_saved += GNUT_MSG_HDR_LEN + pl_len;
+            return 0;
+        }
+    }
+    g = NULL;
+    if (qd->cfg.global > 0) {
+        g = _gnut_qdedupe_find(qd, hash, 0);
+        if (g->count >= qd->cfg.global) {
+            qd->stats.suppressed_global++;
+            qd->stats.bytes_saved += GNUT_MSG_HDR_LEN + pl_len;
+            return 0;
+        }
+    }
+
+    if (pc != NULL) {
+        _gnut_qdedupe_count(qd, pc, hash, conn);
+        /* Both may have been the same empty entry. */
+        if (g == pc) {
+            g = _gnut_qdedupe_find(qd, hash, 0);
+        }
+    }
+    if (g != NULL) {
+        _gnut_qdedupe_count(qd, g, hash, 0);
+    }
+    qd->stats.passed++;
+    return 1;
+}
@@ -0,0 +1,184 @@
+/*
+ * Copyright 2006-2007 Andrew De Ponte
+ *
+ * This file is part of lib_gnut.
+ *
+ * lib_gnut is the intellectual property of Andrew De Ponte; any
+ * distribution and/or modification and/or reproductions of any portion
+ * of lib_gnut MUST be approved by Andrew De Ponte.
+ *
+ * lib_gnut is distributed WITHOUT ANY WARRANTY; without even the
+ * implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE.
+ */
+
+/**
+ * @file gnut_qdedupe.h
+ * @brief This is a specifications file for repeated Query suppression.
+ *
+ * The gnut_qdedupe.h file is a specifications file that declares the
+ * gnut_qdedupe_t type and its associated functions. A routing table
+ * only catches a Query seen before under the same Message ID; some
+ * servents send the same search again and again under new ones. A
+ * Query deduper hashes what a Query asks, its criteria and extension
+ * block, and counts how often each is seen in a window of time, from
+ * each connection and from all of them, so that a node relays no more
+ * than a few of each per window.
+ *
+ * Windows are fixed: counts start over when one ends, or early if the
+ * table of counts fills. Forgetting only lets Queries through, so the
+ * table is bounded and nothing is allocated per Query. The time is
+ * given by the owner with gnut_qdedupe_tick(), so that the deduper
+ * works the same under a simulated clock.
+ */
+
+#ifndef GNUT_QDEDUPE_H
+#define GNUT_QDEDUPE_H
+
+#include <sxs/sxs.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+#include "gnut_export.h"
+#include "gnut_types.h"
+#include "gnut_error.h"
+
+#define GNUT_QDEDUPE_DEF_WINDOW 10000000 /**< Default window, 10 s in us */
+#define GNUT_QDEDUPE_DEF_PER_CONN 1 /**< Default repeats per connection */
+#define GNUT_QDEDUPE_DEF_GLOBAL 4 /**< Default repeats from all of them */
+#define GNUT_QDEDUPE_DEF_CAPACITY 65536 /**< Default counts per window */
+
+/**
+ * A Query Deduper Configuration
+ *
+ * The gnut_qdedupe_cfg_t is a type which holds the limits of a Query
+ * deduper. A limit of 0 turns it off.
+ */
+typedef struct GNUT_EXPORT gnut_qdedupe_cfg {
+    gnut_uint64_t window;       /* Length of a window in microseconds */
+    sxs_uint32_t per_conn;      /* Same Queries relayed per connection */
+    sxs_uint32_t global;        /* Same Queries relayed in all */
+    sxs_uint32_t capacity;      /* Counts kept before starting over */
+} gnut_qdedupe_cfg_t;
+
+/**
+ * A Query Deduper Count
+ *
+ * The gnut_qdedupe_ent_t is a type which represents how often a Query
+ * was seen in the current window, on one connection or, with a 'conn'
+ * of 0, on all of them.
+ */
+typedef struct GNUT_EXPORT gnut_qdedupe_ent {
+    gnut_uint64_t hash;         /* Of the criteria and extension block */
+    sxs_uint32_t conn;
+    sxs_uint32_t count;         /* 0 if the entry is empty */
+} gnut_qdedupe_ent_t;
+
+/**
+ * Query Deduper Statistics
+ *
+ * The gnut_qdedupe_stats_t is a type which holds the counters of a
+ * Query deduper. The bytes saved are those of the Queries suppressed,
+ * headers included, which would otherwise have been relayed to each
+ * neighbour.
+ */
+typedef struct GNUT_EXPORT gnut_qdedupe_stats {
+    gnut_uint64_t passed;
+    gnut_uint64_t suppressed_conn;  /* Over the limit of the connection */
+    gnut_uint64_t suppressed_global; /* Over the limit of all of them */
+    gnut_uint64_t bytes_saved;
+    gnut_uint64_t windows;      /* Windows started, early ones included */
+    gnut_uint64_t early;        /* Windows started as the table filled */
+} gnut_qdedupe_stats_t;
+
+/**
+ * A Query Deduper
+ *
+ * The gnut_qdedupe_t is a type which represents a Query deduper.
+ */
+typedef struct GNUT_EXPORT gnut_qdedupe {
+    gnut_qdedupe_cfg_t cfg;
+    gnut_qdedupe_ent_t *ents;   /* Open addressing, at most half full */
+    sxs_uint32_t mask;
+    sxs_uint32_t used;
+    gnut_uint64_t now;
+    gnut_uint64_t window_start;
+    gnut_qdedupe_stats_t stats;
+} gnut_qdedupe_t;
+
+/**
+ * Initialize a Query Deduper Configuration
+ *
+ * The gnut_qdedupe_cfg_init() function sets the GNUT_QDEDUPE_DEF_*
+ * defaults.
+ * @param cfg Pointer to the configuration to initialize.
+ */
+GNUT_EXPORT void gnut_qdedupe_cfg_init(gnut_qdedupe_cfg_t *cfg);
+
+/**
+ * Initialize a Query Deduper
+ *
+ * @param qd Pointer to the deduper to initialize.
+ * @param cfg Pointer to the configuration, which is copied.
+ * @param now The current time in microseconds.
+ * @return A value representing an error or success.
+ * @retval GNUT_SUCCESS Successfully initialized the deduper.
+ * @retval GNUT_ENOMEM Failed to allocate memory.
+ */
+GNUT_EXPORT gnut_error_t gnut_qdedupe_init(gnut_qdedupe_t *qd,
+    const gnut_qdedupe_cfg_t *cfg, gnut_uint64_t now);
+
+/**
+ * Destroy a Query Deduper
+ *
+ * @param qd Pointer to the deduper.
+ */
+GNUT_EXPORT void gnut_qdedupe_destroy(gnut_qdedupe_t *qd);
+
+/**
+ * Advance the Clock of a Query Deduper
+ *
+ * The gnut_qdedupe_tick() function sets the time Queries are counted
+ * at, starting a new window if the current one has ended. It is cheap
+ * enough to call before each message.
+ * @param qd Pointer to the deduper.
+ * @param now The current time in microseconds.
+ */
+GNUT_EXPORT void gnut_qdedupe_tick(gnut_qdedupe_t *qd, gnut_uint64_t now);
+
+/**
+ * Check a Query against a Query Deduper
+ *
+ * The gnut_qdedupe_check() function counts the Query payload 'pl'
+ * received on connection 'conn' and tells whether it is within the
+ * limits of the current window. Suppressed Queries are not counted, so
+ * that a flood from one connection does not use up the global limit.
+ * @param qd Pointer to the deduper.
+ * @param conn The connection id, which must not be 0.
+ * @param pl Pointer to the Query payload.
+ * @param pl_len The length of the payload.
+ * @return Non-zero if the Query may be relayed, 0 to suppress it.
+ */
+GNUT_EXPORT int gnut_qdedupe_check(gnut_qdedupe_t *qd, sxs_uint32_t conn,
+    const unsigned char *pl, sxs_uint32_t pl_len);
+
+/**
+ * Hash a Query Payload
+ *
+ * The gnut_qdedupe_hash() function hashes the criteria and extension
+ * block of a Query payload, leaving out its minimum speed, eight bytes
+ * at a time.
+ * @param pl Pointer to the Query payload.
+ * @param pl_len The length of the payload.
+ * @return The 64 bit hash.
+ */
+GNUT_EXPORT gnut_uint64_t gnut_qdedupe_hash(const unsigned char *pl,
+    sxs_uint32_t pl_len);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* GNUT_QDEDUPE_H */
@@ -0,0 +1,299 @@
+/*
+ * Copyright 2006-2007 Andrew De Ponte
+ *
+ * This file is part of lib_gnut.
+ *
+ * lib_gnut is the intellectual property of Andrew De Ponte; any
+ * distribution and/or modification and/or reproductions of any portion
+ * of lib_gnut MUST be approved by Andrew De Ponte.
+ *
+ * lib_gnut is distributed WITHOUT ANY WARRANTY; without even the
+ * implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE.
+ */
+
+/**
+ * @file gnut_query.c
+ * @brief This is an implementation file for Query and Query Hit payloads.
+ *
+ * The gnut_query.c file is an implementation file that defines the
+ * gnut_query_t and gnut_qhit_t types' associated functions.
+ */
+
+#include <string.h> /* memchr(), memcpy(), memset() */
+
+#include "gnut_query.h"
+#include "gnut_base32.h"
+
+#define RESULT_FIXED_LEN 8 /* File index and file size */
+
+static sxs_uint32_t _gnut_query_get32(const unsigned char *p) {
+    return (sxs_uint32_t)p[0] | ((sxs_uint32_t)p[1] << 8) |
+        ((sxs_uint32_t)p[2] << 16) | ((sxs_uint32_t)p[3] << 24);
+}
+
+static void _gnut_query_put32(unsigned char *p, sxs_uint32_t v) {
+    p[0] = (unsigned char)(v & 0xff);
+    p[1] = (unsigned char)((v >> 8) & 0xff);
+    p[2] = (unsigned char)((v >> 16) & 0xff);
+    p[3] = (unsigned char)((v >> 24) & 0xff);
+}
+
+gnut_error_t gnut_query_parse(gnut_query_t *q, const unsigned char *pl,
+    sxs_uint32_t pl_len) {
+
+    const unsigned char *nul_p;
+    sxs_uint32_t rest;
+
+    if (pl_len < sizeof(sxs_uint16_t)) {
+        return GNUT_EMALFORMED;
+    }
+    q->min_speed = (sxs_uint16_t)(pl[0] | (pl[1] << 8));
+    q->criteria = (const char *)(pl + sizeof(sxs_uint16_t));
+    rest = pl_len - sizeof(sxs_uint16_t);
+
+    nul_p = (const unsigned char *)memchr((const void *)q->criteria, '\0',
+        rest);
+    if (nul_p == NULL) {
+        q->criteria_len = rest;
+        q->ext = NULL;
+        q->ext_len = 0;
+    } else {
+        q->criteria_len = nul_p - (const unsigned char *)q->criteria;
+        q->ext = nul_p + 1;
+        q->ext_len = rest - q->criteria_len - 1;
+    }
+
+    return GNUT_SUCCESS;
+}
+
+gnut_error_t gnut_query_build(const gnut_query_t *q, unsigned char *buf,
+    sxs_uint32_t len, sxs_uint32_t *p_pl_len) {
+
+    sxs_uint32_t pl_len;
+
+    pl_len = sizeof(sxs_uint16_t) + q->criteria_len + 1 + q->ext_len;
+    if (len < pl_len) {
+        return GNUT_EBUF_TOO_SMALL;
+    }
+
+    buf[0] = (unsigned char)(q->min_speed & 0xff);
+    buf[1] = (unsigned char)((q->min_speed >> 8) & 0xff);
+    memcpy((void *)(buf + sizeof(sxs_uint16_t)), (const void *)q->criteria,
+        q->criteria_len);
+    buf[sizeof(sxs_uint16_t) + q->criteria_len] = '\0';
+    if (q->ext_len > 0) {
+        memcpy((void *)(buf + sizeof(sxs_uint16_t) + q->criteria_len + 1),
+            (const void *)q->ext, q->ext_len);
+    }
+
+    *p_pl_len = pl_len;
+    return GNUT_SUCCESS;
+}
+
+int gnut_ext_next_sha1(const unsigned char *ext, sxs_uint32_t ext_len,
+    sxs_uint32_t *p_pos, unsigned char *sha1) {
+
+    const unsigned char *sep_p;
+    sxs_uint32_t pos, len;
+
+    pos = *p_pos;
+    while (pos < ext_len && ext[pos] != GNUT_EXT_GGEP_MAGIC) {
+        sep_p = (const unsigned char *)memchr((const void *)(ext + pos),
+            GNUT_EXT_SEP, ext_len - pos);
+        len = (sep_p != NULL) ? (sxs_uint32_t)(sep_p - ext) - pos :
+            ext_len - pos;
+        /* A field may end in the null of a result's extension block. */
+        if (len > 0 && ext[pos + len - 1] == '\0') {
+            len--;
+        }
+        if (gnut_urn_sha1_parse((const char *)(ext + pos), len, sha1) ==
+            GNUT_SUCCESS) {
+            *p_pos = pos + len + 1;
+            return 1;
+        }
+        if (sep_p == NULL) {
+            break;
+        }
+        pos = (sxs_uint32_t)(sep_p - ext) + 1;
+    }
+
+    *p_pos = ext_len;
+    return 0;
+}
+
+gnut_error_t gnut_qhit_begin(gnut_qhit_t *h, unsigned char *buf,
+    sxs_uint32_t len, sxs_uint16_t port, sxs_uint32_t ip,
+    sxs_uint32_t speed) {
+
+    if (len < GNUT_QHIT_HDR_LEN + GNUT_QHIT_SERVENT_ID_LEN) {
+        return GNUT_EBUF_TOO_SMALL;
+    }
+
+    memset((void *)h, 0, sizeof(gnut_qhit_t));
+    h->port = port;
+    h->ip = ip;
+    h->speed = speed;
+    h->buf = buf;
+    h->cap = len;
+
+    buf[1] = (unsigned char)(port & 0xff);
+    buf[2] = (unsigned char)((port >> 8) & 0xff);
+    memcpy((void *)(buf + 3), (const void *)&ip, 4);
+    _gnut_query_put32(buf + 7, speed);
+    h->len = GNUT_QHIT_HDR_LEN;
+
+    return GNUT_SUCCESS;
+}
+
+gnut_error_t gnut_qhit_add(gnut_qhit_t *h, sxs_uint32_t file_index,
+    sxs_uint32_t file_size, const char *name, sxs_uint32_t name_len,
+    const unsigned char *sha1) {
+
+    unsigned char *p;
+    sxs_uint32_t rec_len, ext_len;
+
+    /* The name and the extension block are each null terminated. */
+    ext_len = (sha1 != NULL) ? GNUT_URN_SHA1_LEN : 0;
+    rec_len = RESULT_FIXED_LEN + name_len + 1 + ext_len + 1;
+    if (h->num_hits == GNUT_QHIT_MAX_RESULTS ||
+        h->cap - h->len - GNUT_QHIT_SERVENT_ID_LEN < rec_len) {
+        return GNUT_EBUF_TOO_SMALL;
+    }
+
+    p = h->buf + h->len;
+    _gnut_query_put32(p, file_index);
+    _gnut_query_put32(p + 4, file_size);
+    memcpy((void *)(p + RESULT_FIXED_LEN), (const void *)name, name_len);
+    p[RESULT_FIXED_LEN + name_len] = '\0';
+    if (sha1 != NULL) {
+        gnut_urn_sha1_format(sha1, (char *)(p + RESULT_FIXED_LEN +
+            name_len + 1));
+    }
+    p[rec_len - 1] = '\0';
+    h->len += rec_len;
+    h->num_hits++;
+
+    return GNUT_SUCCESS;
+}
+
+sxs_uint32_t gnut_qhit_add_records(gnut_qhit_t *h,
+    const unsigned char *recs, sxs_uint32_t len, sxs_uint32_t num) {
+
+    const unsigned char *nul_p;
+    sxs_uint32_t room, pos, end, i;
+
+    room = h->cap - h->len - GNUT_QHIT_SERVENT_ID_LEN;
+    if (num <= GNUT_QHIT_MAX_RESULTS - h->num_hits && len <= room) {
+        i = num;
+        end = len;
+    } else {
+        /* Only some fit, so find where the last of them ends. */
+        if (num > GNUT_QHIT_MAX_RESULTS - h->num_hits) {
+            num = GNUT_QHIT_MAX_RESULTS - h->num_hits;
+        }
+        pos = 0;
+        end = 0;
+        for (i = 0; i < num; i++) {
+            nul_p = (const unsigned char *)memchr((const void *)(recs +
+                pos + RESULT_FIXED_LEN), '\0', len - pos - RESULT_FIXED_LEN);
+            nul_p = (const unsigned char *)memchr((const void *)(nul_p + 1),
+                '\0', len - (sxs_uint32_t)(nul_p + 1 - recs));
+            pos = (sxs_uint32_t)(nul_p - recs) + 1;
+            if (pos > room) {
+                break;
+            }
+            end = pos;
+        }
+    }
+
+    memcpy((void *)(h->buf + h->len), (const void *)recs, end);
+    h->len += end;
+    h->num_hits += i;
+
+    return i;
+}
+
+sxs_uint32_t gnut_qhit_finish(gnut_qhit_t *h,
+    const unsigned char *servent_id) {
+
+    h->buf[0] = (unsigned char)h->num_hits;
+    memcpy((void *)(h->buf + h->len), (const void *)servent_id,
+        GNUT_QHIT_SERVENT_ID_LEN);
+    h->len += GNUT_QHIT_SERVENT_ID_LEN;
+
+    return h->len;
+}
+
+gnut_error_t gnut_qhit_parse(gnut_qhit_t *h, const unsigned char *pl,
+    sxs_uint32_t pl_len) {
+
+    const unsigned char *nul_p;
+    sxs_uint32_t pos, end, i;
+
+    if (pl_len < GNUT_QHIT_HDR_LEN + GNUT_QHIT_SERVENT_ID_LEN) {
+        return GNUT_EMALFORMED;
+    }
+
+    memset((void *)h, 0, sizeof(gnut_qhit_t));
+    h->num_hits = pl[0];
+    h->port = (sxs_uint16_t)(pl[1] | (pl[2] << 8));
+    memcpy((void *)&h->ip, (const void *)(pl + 3), 4);
+    h->speed = _gnut_query_get32(pl + 7);
+    h->pl = pl;
+    h->len = pl_len;
+    h->pos = GNUT_QHIT_HDR_LEN;
+
+    /* Each result is a fixed part, then a name and an extension block
+     * which are each null terminated. */
+    end = pl_len - GNUT_QHIT_SERVENT_ID_LEN;
+    pos = GNUT_QHIT_HDR_LEN;
+    for (i = 0; i < h->num_hits; i++) {
+        if (end - pos < RESULT_FIXED_LEN) {
+            return GNUT_EMALFORMED;
+        }
+        pos += RESULT_FIXED_LEN;
+        nul_p = (const unsigned char *)memchr((const void *)(pl + pos),
+            '\0', end - pos);
+        if (nul_p == NULL) {
+            return GNUT_EMALFORMED;
+        }
+        pos = (nul_p - pl) + 1;
+        nul_p = (const unsigned char *)memchr((const void *)(pl + pos),
+            '\0', end - pos);
+        if (nul_p == NULL) {
+            return GNUT_EMALFORMED;
+        }
+        pos = (nul_p - pl) + 1;
+    }
+
+    h->trailer = pl + pos;
+    h->trailer_len = end - pos;
+    h->servent_id = pl + end;
+
+    return GNUT_SUCCESS;
+}
+
+int gnut_qhit_next(gnut_qhit_t *h, gnut_qhit_result_t *res) {
+    const unsigned char *p, *nul_p;
+
+    if (h->read == h->num_hits) {
+        return 0;
+    }
+
+    p = h->pl + h->pos;
+    res->file_index = _gnut_query_get32(p);
+    res->file_size = _gnut_query_get32(p + 4);
+    res->name = (const char *)(p + RESULT_FIXED_LEN);
+    nul_p = (const unsigned char *)memchr((const void *)res->name, '\0',
+        h->trailer - (const unsigned char *)res->name);
+    res->name_len = nul_p - (const unsigned char *)res->name;
+    res->ext = nul_p + 1;
+    nul_p = (const unsigned char *)memchr((const void *)res->ext, '\0',
+        h->trailer - res->ext);
+    res->ext_len = nul_p - res->ext;
+
+    h->pos = (nul_p - h->pl) + 1;
+    h->read++;
+    return 1;
+}
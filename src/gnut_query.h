@@ -0,0 +1,251 @@
+/*
+ * Copyright 2006-2007 Andrew De Ponte
+ *
+ * This file is part of lib_gnut.
+ *
+ * lib_gnut is the intellectual property of Andrew De Ponte; any
+ * distribution and/or modification and/or reproductions of any portion
+ * of lib_gnut MUST be approved by Andrew De Ponte.
+ *
+ * lib_gnut is distributed WITHOUT ANY WARRANTY; without even the
+ * implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE.
+ */
+
+/**
+ * @file gnut_query.h
+ * @brief This is a specifications file for Query and Query Hit payloads.
+ *
+ * The gnut_query.h file is a specifications file that declares the
+ * gnut_query_t and gnut_qhit_t types and their associated functions.
+ * Parsing does not copy: the parsed types point into the payload they
+ * were parsed from, which must outlive them. A Query Hit is built in
+ * place, one result record at a time, in a buffer of the caller's.
+ */
+
+#ifndef GNUT_QUERY_H
+#define GNUT_QUERY_H
+
+#include <sxs/sxs.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+#include "gnut_export.h"
+#include "gnut_types.h"
+#include "gnut_error.h"
+#include "gnut_sha1.h"
+
+#define GNUT_QHIT_HDR_LEN 11 /**< Count, port, IP address and speed */
+#define GNUT_QHIT_SERVENT_ID_LEN 16 /**< Servent ID closing a Query Hit */
+#define GNUT_QHIT_MAX_RESULTS 255 /**< Results one Query Hit can hold */
+#define GNUT_EXT_SEP 0x1c /**< Separates the fields of an extension block */
+#define GNUT_EXT_GGEP_MAGIC 0xc3 /**< Begins a GGEP block */
+#define GNUT_QUERY_SPEED_FLAGS 0x8000 /**< Minimum speed holds flags */
+#define GNUT_QUERY_SPEED_OOB 0x0400 /**< Flag, wants out of band replies */
+
+/**
+ * A Query Payload
+ *
+ * The gnut_query_t is a type which represents a parsed Query payload.
+ * The search criteria are not null terminated here; 'ext' holds the
+ * extension block that may follow them, such as HUGE URNs or GGEP.
+ */
+typedef struct GNUT_EXPORT gnut_query {
+    sxs_uint16_t min_speed;
+    const char *criteria;
+    sxs_uint32_t criteria_len;
+    const unsigned char *ext;
+    sxs_uint32_t ext_len;
+} gnut_query_t;
+
+/**
+ * A Query Hit Result
+ *
+ * The gnut_qhit_result_t is a type which represents one result record
+ * of a Query Hit. The file name is not null terminated here.
+ */
+typedef struct GNUT_EXPORT gnut_qhit_result {
+    sxs_uint32_t file_index;
+    sxs_uint32_t file_size;
+    const char *name;
+    sxs_uint32_t name_len;
+    const unsigned char *ext;
+    sxs_uint32_t ext_len;
+} gnut_qhit_result_t;
+
+/**
+ * A Query Hit
+ *
+ * The gnut_qhit_t is a type which represents a Query Hit payload being
+ * built or read. Its results are read one at a time with
+ * gnut_qhit_next(). The IP address is in network byte order.
+ */
+typedef struct GNUT_EXPORT gnut_qhit {
+    sxs_uint32_t num_hits;
+    sxs_uint16_t port;
+    sxs_uint32_t ip;
+    sxs_uint32_t speed;
+    unsigned char *buf;         /* Payload, when building */
+    const unsigned char *pl;    /* Payload, when reading */
+    sxs_uint32_t len;           /* Bytes of it built, or its length */
+    sxs_uint32_t cap;           /* Size of the buffer, when building */
+    sxs_uint32_t pos;           /* Next result to read */
+    sxs_uint32_t read;          /* Results read */
+    const unsigned char *trailer; /* Vendor data after the results */
+    sxs_uint32_t trailer_len;
+    const unsigned char *servent_id;
+} gnut_qhit_t;
+
+/**
+ * Parse a Query Payload
+ *
+ * The gnut_query_parse() function parses the Query payload 'pl'. The
+ * criteria end at the first null byte; one missing at the end of the
+ * payload is tolerated.
+ * @param q Pointer to the Query to fill in.
+ * @param pl Pointer to the payload.
+ * @param pl_len The length of the payload.
+ * @return A value representing an error or success.
+ * @retval GNUT_SUCCESS Successfully parsed the payload.
+ * @retval GNUT_EMALFORMED The payload is too short.
+ */
+GNUT_EXPORT gnut_error_t gnut_query_parse(gnut_query_t *q,
+    const unsigned char *pl, sxs_uint32_t pl_len);
+
+/**
+ * Build a Query Payload
+ *
+ * The gnut_query_build() function writes the payload of 'q' to 'buf',
+ * null terminating the criteria and appending the extension block.
+ * @param q Pointer to the Query.
+ * @param buf Pointer to the buffer to write to.
+ * @param len The size of the buffer.
+ * @param p_pl_len Pointer to store the length of the payload in.
+ * @return A value representing an error or success.
+ * @retval GNUT_SUCCESS Successfully built the payload.
+ * @retval GNUT_EBUF_TOO_SMALL The buffer is too small.
+ */
+GNUT_EXPORT gnut_error_t gnut_query_build(const gnut_query_t *q,
+    unsigned char *buf, sxs_uint32_t len, sxs_uint32_t *p_pl_len);
+
+/**
+ * Find the Next urn:sha1 Value of an Extension Block
+ *
+ * The gnut_ext_next_sha1() function looks through the HUGE fields of
+ * the extension block of a Query or of a Query Hit result, from
+ * '*p_pos' on, for the next urn:sha1 value. It stops at a GGEP block,
+ * whose bytes may look like a separator.
+ * @param ext Pointer to the extension block.
+ * @param ext_len The length of the extension block.
+ * @param p_pos Pointer to where to look from, 0 to start, which is
+ * moved past the value found.
+ * @param sha1 Pointer to a buffer of GNUT_SHA1_LEN bytes to store the
+ * digest in.
+ * @return Non-zero if a value was found, 0 once there are no more.
+ */
+GNUT_EXPORT int gnut_ext_next_sha1(const unsigned char *ext,
+    sxs_uint32_t ext_len, sxs_uint32_t *p_pos, unsigned char *sha1);
+
+/**
+ * Begin Building a Query Hit
+ *
+ * The gnut_qhit_begin() function starts a Query Hit payload with no
+ * results in 'buf', which must stay valid until gnut_qhit_finish().
+ * @param h Pointer to the Query Hit to initialize.
+ * @param buf Pointer to the buffer to build the payload in.
+ * @param len The size of the buffer.
+ * @param port The port to download from.
+ * @param ip The IP address to download from, in network byte order.
+ * @param speed The speed of the servent in kb/s.
+ * @return A value representing an error or success.
+ * @retval GNUT_SUCCESS Successfully started the payload.
+ * @retval GNUT_EBUF_TOO_SMALL The buffer cannot hold an empty Query Hit.
+ */
+GNUT_EXPORT gnut_error_t gnut_qhit_begin(gnut_qhit_t *h, unsigned char *buf,
+    sxs_uint32_t len, sxs_uint16_t port, sxs_uint32_t ip,
+    sxs_uint32_t speed);
+
+/**
+ * Add a Result to a Query Hit
+ *
+ * The gnut_qhit_add() function appends a result record, keeping room
+ * for the Servent ID. Its extension block holds the file's urn:sha1
+ * value if a digest is given, and is empty otherwise.
+ * @param h Pointer to the Query Hit being built.
+ * @param file_index The index the servent serves the file under.
+ * @param file_size The size of the file in bytes.
+ * @param name Pointer to the file name, which must not contain a null
+ * byte.
+ * @param name_len The length of the file name.
+ * @param sha1 Pointer to the GNUT_SHA1_LEN byte digest of the file, or
+ * NULL.
+ * @return A value representing an error or success.
+ * @retval GNUT_SUCCESS Successfully added the result.
+ * @retval GNUT_EBUF_TOO_SMALL The buffer is full, or the Query Hit
+ * already holds GNUT_QHIT_MAX_RESULTS results.
+ */
+GNUT_EXPORT gnut_error_t gnut_qhit_add(gnut_qhit_t *h,
+    sxs_uint32_t file_index, sxs_uint32_t file_size, const char *name,
+    sxs_uint32_t name_len, const unsigned char *sha1);
+
+/**
+ * Add Encoded Results to a Query Hit
+ *
+ * The gnut_qhit_add_records() function appends result records that
+ * gnut_qhit_add() encoded in another Query Hit, such as the bytes
+ * between its header and its Servent ID, as many of them as fit.
+ * @param h Pointer to the Query Hit being built.
+ * @param recs Pointer to the records.
+ * @param len The length of the records.
+ * @param num The number of records.
+ * @return The number of records added.
+ */
+GNUT_EXPORT sxs_uint32_t gnut_qhit_add_records(gnut_qhit_t *h,
+    const unsigned char *recs, sxs_uint32_t len, sxs_uint32_t num);
+
+/**
+ * Finish Building a Query Hit
+ *
+ * The gnut_qhit_finish() function fills in the number of results and
+ * appends the Servent ID.
+ * @param h Pointer to the Query Hit being built.
+ * @param servent_id Pointer to the GNUT_QHIT_SERVENT_ID_LEN byte
+ * Servent ID.
+ * @return The length of the payload.
+ */
+GNUT_EXPORT sxs_uint32_t gnut_qhit_finish(gnut_qhit_t *h,
+    const unsigned char *servent_id);
+
+/**
+ * Parse a Query Hit Payload
+ *
+ * The gnut_qhit_parse() function parses the fixed fields of the Query
+ * Hit payload 'pl' and checks that its result records are well formed,
+ * so that gnut_qhit_next() can read them without checking again.
+ * @param h Pointer to the Query Hit to fill in.
+ * @param pl Pointer to the payload.
+ * @param pl_len The length of the payload.
+ * @return A value representing an error or success.
+ * @retval GNUT_SUCCESS Successfully parsed the payload.
+ * @retval GNUT_EMALFORMED The payload is truncated or its results
+ * overrun it.
+ */
+GNUT_EXPORT gnut_error_t gnut_qhit_parse(gnut_qhit_t *h,
+    const unsigned char *pl, sxs_uint32_t pl_len);
+
+/**
+ * Read the Next Result of a Query Hit
+ *
+ * @param h Pointer to a Query Hit parsed by gnut_qhit_parse().
+ * @param res Pointer to the result to fill in.
+ * @return Non-zero if a result was read, 0 once all have been.
+ */
+GNUT_EXPORT int gnut_qhit_next(gnut_qhit_t *h, gnut_qhit_result_t *res);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* GNUT_QUERY_H */
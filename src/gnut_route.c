@@ -0,0 +1,139 @@
+/*
+ * Copyright 2006-2007 Andrew De Ponte
+ *
+ * This file is part of lib_gnut.
+ *
+ * lib_gnut is the intellectual property of Andrew De Ponte; any
+ * distribution and/or modification and/or reproductions of any portion
+ * of lib_gnut MUST be approved by Andrew De Ponte.
+ *
+ * lib_gnut is distributed WITHOUT ANY WARRANTY; without even the
+ * implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE.
+ */
+
+/**
+ * @file gnut_route.c
+ * @brief This is an implementation file for GUID routing tables.
+ *
+ * The gnut_route.c file is an implementation file that defines the
+ * gnut_route_t type's associated functions.
+ */
+
+#include <stdlib.h> /* calloc(), free() */
+#include <string.h> /* memset(), memcpy(), memcmp() */
+
+#include "gnut_route.h"
+
+static sxs_uint32_t _gnut_route_hash(const unsigned char *guid) {
+    gnut_uint64_t a, b;
+
+    /* GUIDs are mostly random already, but some servents put fixed
+     * bytes in them, so both halves are mixed in. */
+    memcpy((void *)&a, (const void *)guid, 8);
+    memcpy((void *)&b, (const void *)(guid + 8), 8);
+    return (sxs_uint32_t)(((a ^ (b * 0x9E3779B97F4A7C15ULL)) *
+        0xC2B2AE3D27D4EB4FULL) >> 32);
+}
+
+/* Returns the entry holding 'guid' or the empty entry it would go in. */
+static gnut_route_ent_t *_gnut_route_probe(const gnut_route_t *rt,
+    const gnut_route_gen_t *gen, const unsigned char *guid,
+    sxs_uint32_t hash) {
+
+    gnut_route_ent_t *ent;
+    sxs_uint32_t i;
+
+    i = hash & rt->mask;
+    for (;;) {
+        ent = &gen->ents[i];
+        if (ent->conn == GNUT_ROUTE_NONE ||
+            memcmp(ent->guid, guid, 16) == 0) {
+            return ent;
+        }
+        i = (i + 1) & rt->mask;
+    }
+}
+
+gnut_error_t gnut_route_init(gnut_route_t *rt, sxs_uint32_t capacity) {
+    sxs_uint32_t slots;
+
+    memset(rt, 0, sizeof(gnut_route_t));
+    if (capacity == 0) {
+        capacity = GNUT_ROUTE_DEF_CAPACITY;
+    }
+    slots = 4;
+    while (slots < capacity * 2) {
+        slots <<= 1;
+    }
+
+    rt->gens[0].ents = (gnut_route_ent_t *)calloc(slots,
+        sizeof(gnut_route_ent_t));
+    rt->gens[1].ents = (gnut_route_ent_t *)calloc(slots,
+        sizeof(gnut_route_ent_t));
+    if (rt->gens[0].ents == NULL || rt->gens[1].ents == NULL) {
+        gnut_route_destroy(rt);
+        return GNUT_ENOMEM;
+    }
+    rt->mask = slots - 1;
+
+    return GNUT_SUCCESS;
+}
+
+void gnut_route_destroy(gnut_route_t *rt) {
+    free(rt->gens[0].ents);
+    free(rt->gens[1].ents);
+    rt->gens[0].ents = NULL;
+    rt->gens[1].ents = NULL;
+}
+
+int gnut_route_add(gnut_route_t *rt, const unsigned char *guid,
+    sxs_uint32_t conn) {
+
+    gnut_route_gen_t *cur;
+    gnut_route_ent_t *ent;
+    sxs_uint32_t hash;
+
+    hash = _gnut_route_hash(guid);
+    if (_gnut_route_probe(rt, &rt->gens[rt->cur ^ 1], guid,
+        hash)->conn != GNUT_ROUTE_NONE) {
+        return 0;
+    }
+    cur = &rt->gens[rt->cur];
+    ent = _gnut_route_probe(rt, cur, guid, hash);
+    if (ent->conn != GNUT_ROUTE_NONE) {
+        return 0;
+    }
+
+    if (cur->len >= (rt->mask + 1) / 2) {
+        /* Forget the old generation and start filling it afresh. */
+        rt->cur ^= 1;
+        cur = &rt->gens[rt->cur];
+        memset((void *)cur->ents, 0,
+            (rt->mask + 1) * sizeof(gnut_route_ent_t));
+        cur->len = 0;
+        rt->rotations++;
+        ent = _gnut_route_probe(rt, cur, guid, hash);
+    }
+
+    memcpy((void *)ent->guid, (const void *)guid, 16);
+    ent->conn = conn;
+    cur->len++;
+
+    return 1;
+}
+
+sxs_uint32_t gnut_route_lookup(const gnut_route_t *rt,
+    const unsigned char *guid) {
+
+    const gnut_route_ent_t *ent;
+    sxs_uint32_t hash;
+
+    hash = _gnut_route_hash(guid);
+    ent = _gnut_route_probe(rt, &rt->gens[rt->cur], guid, hash);
+    if (ent->conn == GNUT_ROUTE_NONE) {
+        ent = _gnut_route_probe(rt, &rt->gens[rt->cur ^ 1], guid, hash);
+    }
+
+    return ent->conn;
+}
@@ -0,0 +1,127 @@
+/*
+ * Copyright 2006-2007 Andrew De Ponte
+ *
+ * This file is part of lib_gnut.
+ *
+ * lib_gnut is the intellectual property of Andrew De Ponte; any
+ * distribution and/or modification and/or reproductions of any portion
+ * of lib_gnut MUST be approved by Andrew De Ponte.
+ *
+ * lib_gnut is distributed WITHOUT ANY WARRANTY; without even the
+ * implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE.
+ */
+
+/**
+ * @file gnut_route.h
+ * @brief This is a specifications file for GUID routing tables.
+ *
+ * The gnut_route.h file is a specifications file that declares the
+ * gnut_route_t type and its associated functions. A routing table maps
+ * a 16 byte GUID, a Message ID or a Servent ID, to the connection it
+ * arrived on, which both detects duplicates and tells where replies go.
+ * It holds two fixed size generations; when the current one fills, the
+ * old one is dropped wholesale and the current one takes its place, so
+ * memory is bounded and nothing is allocated per entry.
+ */
+
+#ifndef GNUT_ROUTE_H
+#define GNUT_ROUTE_H
+
+#include <sxs/sxs.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+#include "gnut_export.h"
+#include "gnut_types.h"
+#include "gnut_error.h"
+
+#define GNUT_ROUTE_NONE 0 /**< Not a connection, marks empty entries */
+#define GNUT_ROUTE_SELF 0xffffffff /**< Connection id of this node */
+#define GNUT_ROUTE_DEF_CAPACITY 65536 /**< Default entries per generation */
+
+/**
+ * A Routing Table Entry
+ *
+ * The gnut_route_ent_t is a type which represents a GUID and the
+ * connection it was seen on.
+ */
+typedef struct GNUT_EXPORT gnut_route_ent {
+    unsigned char guid[16];
+    sxs_uint32_t conn;          /* GNUT_ROUTE_NONE if the entry is empty */
+} gnut_route_ent_t;
+
+/**
+ * A Routing Table Generation
+ *
+ * The gnut_route_gen_t is a type which represents an open addressing
+ * table of entries which is never more than half full.
+ */
+typedef struct GNUT_EXPORT gnut_route_gen {
+    gnut_route_ent_t *ents;
+    sxs_uint32_t len;
+} gnut_route_gen_t;
+
+/**
+ * A Routing Table
+ *
+ * The gnut_route_t is a type which represents a routing table.
+ */
+typedef struct GNUT_EXPORT gnut_route {
+    gnut_route_gen_t gens[2];
+    int cur;                    /* Index of the generation added to */
+    sxs_uint32_t mask;          /* Slots per generation less one */
+    gnut_uint64_t rotations;
+} gnut_route_t;
+
+/**
+ * Initialize a Routing Table
+ *
+ * The gnut_route_init() function initializes an empty routing table
+ * which remembers between 'capacity' and twice 'capacity' GUIDs.
+ * @param rt Pointer to the routing table to initialize.
+ * @param capacity Entries per generation, or 0 for the default.
+ * @return A value representing an error or success.
+ * @retval GNUT_SUCCESS Successfully initialized the routing table.
+ * @retval GNUT_ENOMEM Failed to allocate memory.
+ */
+GNUT_EXPORT gnut_error_t gnut_route_init(gnut_route_t *rt,
+    sxs_uint32_t capacity);
+
+/**
+ * Destroy a Routing Table
+ *
+ * @param rt Pointer to the routing table.
+ */
+GNUT_EXPORT void gnut_route_destroy(gnut_route_t *rt);
+
+/**
+ * Add a GUID to a Routing Table
+ *
+ * The gnut_route_add() function records that 'guid' was seen on
+ * connection 'conn', unless it was already seen.
+ * @param rt Pointer to the routing table.
+ * @param guid Pointer to the 16 byte GUID.
+ * @param conn The connection id, which must not be GNUT_ROUTE_NONE.
+ * @return 1 if the GUID was added, 0 if it was already present.
+ */
+GNUT_EXPORT int gnut_route_add(gnut_route_t *rt, const unsigned char *guid,
+    sxs_uint32_t conn);
+
+/**
+ * Look Up a GUID in a Routing Table
+ *
+ * @param rt Pointer to the routing table.
+ * @param guid Pointer to the 16 byte GUID.
+ * @return The connection the GUID was seen on, or GNUT_ROUTE_NONE.
+ */
+GNUT_EXPORT sxs_uint32_t gnut_route_lookup(const gnut_route_t *rt,
+    const unsigned char *guid);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* GNUT_ROUTE_H */
@@ -0,0 +1,299 @@
+/*
+ * Copyright 2006-2007 Andrew De Ponte
+ *
+ * This file is part of lib_gnut.
+ *
+ * lib_gnut is the intellectual property of Andrew De Ponte; any
+ * distribution and/or modification and/or reproductions of any portion
+ * of lib_gnut MUST be approved by Andrew De Ponte.
+ *
+ * lib_gnut is distributed WITHOUT ANY WARRANTY; without even the
+ * implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE.
+ */
+
+/**
+ * @file gnut_sha1.c
+ * @brief This is an implementation file for SHA-1 hashing.
+ *
+ * The gnut_sha1.c file is an implementation file that defines the
+ * gnut_sha1_t type's associated functions. Whole blocks go straight
+ * from the caller's buffer to the block function, which is the SHA
+ * extension one when the processor reports them through CPUID, and the
+ * C one otherwise. The choice is made on first use and kept.
+ */
+
+#include <string.h> /* memcpy(), memset() */
+
+#include "gnut_sha1.h"
+#include "gnut_atomic.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define SHA1_NI 1
+#include <cpuid.h>
+#include <immintrin.h>
+#endif
+
+#define MODE_UNKNOWN 0
+#define MODE_C 1
+#define MODE_NI 2
+
+#define ROL(x, n) (((x) << (n)) | ((x) >> (32 - (n))))
+
+static int _gnut_sha1_mode = MODE_UNKNOWN;
+
+static sxs_uint32_t _gnut_sha1_be32(const unsigned char *p) {
+    return ((sxs_uint32_t)p[0] << 24) | ((sxs_uint32_t)p[1] << 16) |
+        ((sxs_uint32_t)p[2] << 8) | p[3];
+}
+
+static void _gnut_sha1_blocks_c(sxs_uint32_t *h, const unsigned char *p,
+    size_t n) {
+
+    sxs_uint32_t w[16], a, b, c, d, e, f, k, t;
+    int i;
+
+    for (; n > 0; n--, p += GNUT_SHA1_BLOCK_LEN) {
+        a = h[0];
+        b = h[1];
+        c = h[2];
+        d = h[3];
+        e = h[4];
+        for (i = 0; i < 80; i++) {
+            /* The schedule is kept as a ring of its last 16 words. */
+            if (i < 16) {
+                w[i] = _gnut_sha1_be32(p + i * 4);
+            } else {
+                t = w[(i + 13) & 15] ^ w[(i + 8) & 15] ^ w[(i + 2) & 15] ^
+                    w[i & 15];
+                w[i & 15] = ROL(t, 1);
+            }
+            if (i < 20) {
+                f = (b & c) | (~b & d);
+                k = 0x5a827999;
+            } else if (i < 40) {
+                f = b ^ c ^ d;
+                k = 0x6ed9eba1;
+            } else if (i < 60) {
+                f = (b & c) | (b & d) | (c & d);
+                k = 0x8f1bbcdc;
+            } else {
+                f = b ^ c ^ d;
+                k = 0xca62c1d6;
+            }
+            t = ROL(a, 5) + f + e + k + w[i & 15];
+            e = d;
+            d = c;
+            c = ROL(b, 30);
+            b = a;
+            a = t;
+        }
+        h[0] += a;
+        h[1] += b;
+        h[2] += c;
+        h[3] += d;
+        h[4] += e;
+    }
+}
+
+#ifdef SHA1_NI
+/* Four rounds of the 'g'th group, with 'm' the message words of the
+ * group and 'm1' to 'm3' those of the next three, whose schedule is
+ * advanced alongside. */
+#define NI_QUAD(g, e, ex, m, m1, m2, m3) \
+    do { \
+        if ((g) == 0) { \
+            e = _mm_add_epi32(e, m); \
+        } else { \
+            e = _mm_sha1nexte_epu32(e, m); \
+        } \
+        ex = abcd; \
+        if ((g) >= 3 && (g) <= 18) { \
+            m1 = _mm_sha1msg2_epu32(m1, m); \
+        } \
+        abcd = _mm_sha1rnds4_epu32(abcd, e, (g) / 5); \
+        if ((g) >= 1 && (g) <= 16) { \
+            m3 = _mm_sha1msg1_epu32(m3, m); \
+        } \
+        if ((g) >= 2 && (g) <= 17) { \
+            m2 = _mm_xor_si128(m2, m); \
+        } \
+    } while (0)
+
+#define NI_LOAD(m, i) \
+    m = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(p + (i) * 16)), \
+        swap)
+
+__attribute__((target("sha,sse4.1")))
+static void _gnut_sha1_blocks_ni(sxs_uint32_t *h, const unsigned char *p,
+    size_t n) {
+
+    __m128i abcd, e0, e1, abcd_save, e_save, m0, m1, m2, m3, swap;
+
+    swap = _mm_set_epi64x(0x0001020304050607LL, 0x08090a0b0c0d0e0fLL);
+    abcd = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *)h), 0x1b);
+    e0 = _mm_set_epi32((int)h[4], 0, 0, 0);
+
+    for (; n > 0; n--, p += GNUT_SHA1_BLOCK_LEN) {
+        abcd_save = abcd;
+        e_save = e0;
+
+        NI_LOAD(m0, 0);
+        NI_QUAD(0, e0, e1, m0, m1, m2, m3);
+        NI_LOAD(m1, 1);
+        NI_QUAD(1, e1, e0, m1, m2, m3, m0);
+        NI_LOAD(m2, 2);
+        NI_QUAD(2, e0, e1, m2, m3, m0, m1);
+        NI_LOAD(m3, 3);
+        NI_QUAD(3, e1, e0, m3, m0, m1, m2);
+        NI_QUAD(4, e0, e1, m0, m1, m2, m3);
+        NI_QUAD(5, e1, e0, m1, m2, m3, m0);
+        NI_QUAD(6, e0, e1, m2, m3, m0, m1);
+        NI_QUAD(7, e1, e0, m3, m0, m1, m2);
+        NI_QUAD(8, e0, e1, m0, m1, m2, m3);
+        NI_QUAD(9, e1, e0, m1, m2, m3, m0);
+        NI_QUAD(10, e0, e1, m2, m3, m0, m1);
+        NI_QUAD(11, e1, e0, m3, m0, m1, m2);
+        NI_QUAD(12, e0, e1, m0, m1, m2, m3);
+        NI_QUAD(13, e1, e0, m1, m2, m3, m0);
+        NI_QUAD(14, e0, e1, m2, m3, m0, m1);
+        NI_QUAD(15, e1, e0, m3, m0, m1, m2);
+        NI_QUAD(16, e0, e1, m0, m1, m2, m3);
+        NI_QUAD(17, e1, e0, m1, m2, m3, m0);
+        NI_QUAD(18, e0, e1, m2, m3, m0, m1);
+        NI_QUAD(19, e1, e0, m3, m0, m1, m2);
+
+        e0 = _mm_sha1nexte_epu32(e0, e_save);
+        abcd = _mm_add_epi32(abcd, abcd_save);
+    }
+
+    _mm_storeu_si128((__m128i *)h, _mm_shuffle_epi32(abcd, 0x1b));
+    h[4] = (sxs_uint32_t)_mm_extract_epi32(e0, 3);
+}
+
+static int _gnut_sha1_cpu_has_ni(void) {
+    unsigned int a, b, c, d;
+
+    if (!__get_cpuid(1, &a, &b, &c, &d) || !(c & bit_SSE4_1) ||
+        !(c & bit_SSSE3)) {
+        return 0;
+    }
+    if (__get_cpuid_max(0, NULL) < 7) {
+        return 0;
+    }
+    __cpuid_count(7, 0, a, b, c, d);
+    return (b & (1U << 29)) != 0;
+}
+#endif
+
+static void _gnut_sha1_blocks(sxs_uint32_t *h, const unsigned char *p,
+    size_t n) {
+
+    int mode;
+
+    mode = GNUT_ATOMIC_LOAD_RLX(&_gnut_sha1_mode);
+    if (mode == MODE_UNKNOWN) {
+        gnut_sha1_use_accel(1);
+        mode = GNUT_ATOMIC_LOAD_RLX(&_gnut_sha1_mode);
+    }
+#ifdef SHA1_NI
+    if (mode == MODE_NI) {
+        _gnut_sha1_blocks_ni(h, p, n);
+        return;
+    }
+#endif
+    _gnut_sha1_blocks_c(h, p, n);
+}
+
+int gnut_sha1_use_accel(int on) {
+    int mode;
+
+    mode = MODE_C;
+#ifdef SHA1_NI
+    if (on && _gnut_sha1_cpu_has_ni()) {
+        mode = MODE_NI;
+    }
+#endif
+    GNUT_ATOMIC_STORE_RLX(&_gnut_sha1_mode, mode);
+    return (mode == MODE_NI);
+}
+
+void gnut_sha1_init(gnut_sha1_t *ctx) {
+    ctx->h[0] = 0x67452301;
+    ctx->h[1] = 0xefcdab89;
+    ctx->h[2] = 0x98badcfe;
+    ctx->h[3] = 0x10325476;
+    ctx->h[4] = 0xc3d2e1f0;
+    ctx->len = 0;
+    ctx->buf_len = 0;
+}
+
+void gnut_sha1_update(gnut_sha1_t *ctx, const void *data, size_t len) {
+    const unsigned char *p;
+    size_t n;
+
+    p = (const unsigned char *)data;
+    ctx->len += len;
+
+    if (ctx->buf_len > 0) {
+        n = GNUT_SHA1_BLOCK_LEN - ctx->buf_len;
+        if (n > len) {
+            n = len;
+        }
+        memcpy((void *)(ctx->buf + ctx->buf_len), (const void *)p, n);
+        ctx->buf_len += n;
+        p += n;
+        len -= n;
+        if (ctx->buf_len < GNUT_SHA1_BLOCK_LEN) {
+            return;
+        }
+        _gnut_sha1_blocks(ctx->h, ctx->buf, 1);
+        ctx->buf_len = 0;
+    }
+
+    n = len / GNUT_SHA1_BLOCK_LEN;
+    if (n > 0) {
+        _gnut_sha1_blocks(ctx->h, p, n);
+        p += n * GNUT_SHA1_BLOCK_LEN;
+        len -= n * GNUT_SHA1_BLOCK_LEN;
+    }
+
+    memcpy((void *)ctx->buf, (const void *)p, len);
+    ctx->buf_len = len;
+}
+
+void gnut_sha1_final(gnut_sha1_t *ctx, unsigned char *digest) {
+    gnut_uint64_t bits;
+    int i;
+
+    bits = ctx->len * 8;
+    ctx->buf[ctx->buf_len++] = 0x80;
+    if (ctx->buf_len > GNUT_SHA1_BLOCK_LEN - 8) {
+        memset((void *)(ctx->buf + ctx->buf_len), 0,
+            GNUT_SHA1_BLOCK_LEN - ctx->buf_len);
+        _gnut_sha1_blocks(ctx->h, ctx->buf, 1);
+        ctx->buf_len = 0;
+    }
+    memset((void *)(ctx->buf + ctx->buf_len), 0,
+        GNUT_SHA1_BLOCK_LEN - 8 - ctx->buf_len);
+    for (i = 0; i < 8; i++) {
+        ctx->buf[GNUT_SHA1_BLOCK_LEN - 1 - i] =
+            (unsigned char)(bits >> (i * 8));
+    }
+    _gnut_sha1_blocks(ctx->h, ctx->buf, 1);
+
+    for (i = 0; i < 5; i++) {
+        digest[i * 4] = (unsigned char)(ctx->h[i] >> 24);
+        digest[i * 4 + 1] = (unsigned char)(ctx->h[i] >> 16);
+        digest[i * 4 + 2] = (unsigned char)(ctx->h[i] >> 8);
+        digest[i * 4 + 3] = (unsigned char)ctx->h[i];
+    }
+}
+
+void gnut_sha1(const void *data, size_t len, unsigned char *digest) {
+    gnut_sha1_t ctx;
+
+    gnut_sha1_init(&ctx);
+    gnut_sha1_update(&ctx, data, len);
+    gnut_sha1_final(&ctx, digest);
+}
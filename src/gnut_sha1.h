@@ -0,0 +1,110 @@
+/*
+ * Copyright 2006-2007 Andrew De Ponte
+ *
+ * This file is part of lib_gnut.
+ *
+ * lib_gnut is the intellectual property of Andrew De Ponte; any
+ * distribution and/or modification and/or reproductions of any portion
+ * of lib_gnut MUST be approved by Andrew De Ponte.
+ *
+ * lib_gnut is distributed WITHOUT ANY WARRANTY; without even the
+ * implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE.
+ */
+
+/**
+ * @file gnut_sha1.h
+ * @brief This is a specifications file for SHA-1 hashing.
+ *
+ * The gnut_sha1.h file is a specifications file that declares the
+ * gnut_sha1_t type and its associated functions, which compute the
+ * SHA-1 digests that name shared files in urn:sha1 values. On x86
+ * processors with the SHA extensions the blocks are hashed with those
+ * instructions, which is chosen once at run time; elsewhere they are
+ * hashed in portable C.
+ */
+
+#ifndef GNUT_SHA1_H
+#define GNUT_SHA1_H
+
+#include <sxs/sxs.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+#include "gnut_export.h"
+#include "gnut_types.h"
+#include "gnut_error.h"
+
+#define GNUT_SHA1_LEN 20 /**< Bytes in a digest */
+#define GNUT_SHA1_BLOCK_LEN 64 /**< Bytes hashed at once */
+
+/**
+ * A SHA-1 Context
+ *
+ * The gnut_sha1_t is a type which holds the state of a digest being
+ * computed.
+ */
+typedef struct GNUT_EXPORT gnut_sha1 {
+    sxs_uint32_t h[5];
+    gnut_uint64_t len;          /* Bytes hashed so far */
+    unsigned char buf[GNUT_SHA1_BLOCK_LEN];
+    sxs_uint32_t buf_len;       /* Bytes of a partial block in buf */
+} gnut_sha1_t;
+
+/**
+ * Begin a SHA-1 Digest
+ *
+ * @param ctx Pointer to the context to initialize.
+ */
+GNUT_EXPORT void gnut_sha1_init(gnut_sha1_t *ctx);
+
+/**
+ * Hash Bytes into a SHA-1 Digest
+ *
+ * @param ctx Pointer to the context.
+ * @param data Pointer to the bytes.
+ * @param len The number of bytes.
+ */
+GNUT_EXPORT void gnut_sha1_update(gnut_sha1_t *ctx, const void *data,
+    size_t len);
+
+/**
+ * Finish a SHA-1 Digest
+ *
+ * The gnut_sha1_final() function pads the bytes hashed and stores the
+ * digest. The context must be initialized again before reuse.
+ * @param ctx Pointer to the context.
+ * @param digest Pointer to a buffer of GNUT_SHA1_LEN bytes.
+ */
+GNUT_EXPORT void gnut_sha1_final(gnut_sha1_t *ctx, unsigned char *digest);
+
+/**
+ * Compute a SHA-1 Digest
+ *
+ * The gnut_sha1() function computes the digest of 'len' bytes at
+ * 'data' in one call.
+ * @param data Pointer to the bytes.
+ * @param len The number of bytes.
+ * @param digest Pointer to a buffer of GNUT_SHA1_LEN bytes.
+ */
+GNUT_EXPORT void gnut_sha1(const void *data, size_t len,
+    unsigned char *digest);
+
+/**
+ * Choose the SHA-1 Implementation
+ *
+ * The gnut_sha1_use_accel() function turns hashing with the SHA
+ * instructions on or off. They are on by default; turning them on has
+ * no effect where the processor lacks them.
+ * @param on Non-zero to use the instructions, 0 to hash in C.
+ * @return Non-zero if the instructions are now used, 0 if not.
+ */
+GNUT_EXPORT int gnut_sha1_use_accel(int on);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* GNUT_SHA1_H */
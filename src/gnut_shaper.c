@@ -0,0 +1,129 @@
+/*
+ * Copyright 2006-2007 Andrew De Ponte
+ *
+ * This file is part of lib_gnut.
+ *
+ * lib_gnut is the intellectual property of Andrew De Ponte; any
+ * distribution and/or modification and/or reproductions of any portion
+ * of lib_gnut MUST be approved by Andrew De Ponte.
+ *
+ * lib_gnut is distributed WITHOUT ANY WARRANTY; without even the
+ * implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE.
+ */
+
+/**
+ * @file gnut_shaper.c
+ * @brief This is an implementation file for bandwidth shaping.
+ *
+ * The gnut_shaper.c file is an implementation file that defines the
+ * gnut_bucket_t and gnut_shaper_t types' associated functions.
+ */
+
+#include "gnut_shaper.h"
+
+#define US_PER_SEC 1000000
+
+static void _gnut_bucket_refill(gnut_bucket_t *b, gnut_uint64_t now) {
+    gnut_uint64_t elapsed;
+
+    if (now <= b->last) {
+        return;
+    }
+    elapsed = now - b->last;
+    b->last = now;
+    if (b->rate == 0) {
+        return;
+    }
+    if (elapsed > GNUT_SHAPER_MAX_IDLE) {
+        elapsed = GNUT_SHAPER_MAX_IDLE;
+    }
+    b->tokens += (gnut_int64_t)(elapsed * b->rate);
+    if (b->tokens > b->depth) {
+        b->tokens = b->depth;
+    }
+}
+
+void gnut_bucket_init(gnut_bucket_t *b, gnut_uint64_t rate,
+    sxs_uint32_t burst, gnut_bucket_t *parent, gnut_uint64_t now) {
+
+    b->rate = rate;
+    b->depth = (gnut_int64_t)burst * US_PER_SEC;
+    b->tokens = b->depth;
+    b->last = now;
+    b->parent = parent;
+}
+
+void gnut_bucket_set_rate(gnut_bucket_t *b, gnut_uint64_t rate,
+    sxs_uint32_t burst) {
+
+    b->rate = rate;
+    b->depth = (gnut_int64_t)burst * US_PER_SEC;
+    if (b->tokens > b->depth) {
+        b->tokens = b->depth;
+    }
+}
+
+int gnut_bucket_ready(gnut_bucket_t *b, gnut_uint64_t now) {
+    int ready;
+
+    ready = 1;
+    for (; b != NULL; b = b->parent) {
+        _gnut_bucket_refill(b, now);
+        if (b->rate != 0 && b->tokens <= 0) {
+            ready = 0;
+        }
+    }
+
+    return ready;
+}
+
+gnut_uint64_t gnut_bucket_wait(const gnut_bucket_t *b) {
+    gnut_uint64_t wait, w;
+
+    wait = 0;
+    for (; b != NULL; b = b->parent) {
+        if (b->rate != 0 && b->tokens <= 0) {
+            w = (gnut_uint64_t)(-b->tokens) / b->rate + 1;
+            if (w > wait) {
+                wait = w;
+            }
+        }
+    }
+
+    return wait;
+}
+
+void gnut_bucket_charge(gnut_bucket_t *b, sxs_uint32_t bytes) {
+    for (; b != NULL; b = b->parent) {
+        if (b->rate != 0) {
+            b->tokens -= (gnut_int64_t)bytes * US_PER_SEC;
+        }
+    }
+}
+
+void gnut_shaper_cfg_init(gnut_shaper_cfg_t *cfg) {
+    int i;
+
+    cfg->rate = 0;
+    cfg->burst = GNUT_SHAPER_DEF_BURST;
+    cfg->bulk_rate = 0;
+    cfg->bulk_burst = GNUT_SHAPER_DEF_BURST;
+    for (i = 0; i < GNUT_SHAPER_MAX_CLASSES; i++) {
+        cfg->class_rate[i] = 0;
+        cfg->class_burst[i] = GNUT_SHAPER_DEF_BURST;
+    }
+}
+
+void gnut_shaper_init(gnut_shaper_t *s, const gnut_shaper_cfg_t *cfg,
+    gnut_uint64_t now) {
+
+    int i;
+
+    gnut_bucket_init(&s->global, cfg->rate, cfg->burst, NULL, now);
+    gnut_bucket_init(&s->bulk, cfg->bulk_rate, cfg->bulk_burst, NULL, now);
+    for (i = 0; i < GNUT_SHAPER_MAX_CLASSES; i++) {
+        gnut_bucket_init(&s->classes[i], cfg->class_rate[i],
+            cfg->class_burst[i], &s->global, now);
+    }
+}
@@ -0,0 +1,178 @@
+/*
+ * Copyright 2006-2007 Andrew De Ponte
+ *
+ * This file is part of lib_gnut.
+ *
+ * lib_gnut is the intellectual property of Andrew De Ponte; any
+ * distribution and/or modification and/or reproductions of any portion
+ * of lib_gnut MUST be approved by Andrew De Ponte.
+ *
+ * lib_gnut is distributed WITHOUT ANY WARRANTY; without even the
+ * implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE.
+ */
+
+/**
+ * @file gnut_shaper.h
+ * @brief This is a specifications file for bandwidth shaping.
+ *
+ * The gnut_shaper.h file is a specifications file that declares the
+ * gnut_bucket_t token bucket, the gnut_shaper_t type which holds the
+ * buckets shared by connections, and their associated functions.
+ * Buckets form a hierarchy: each connection's bucket has the bucket of
+ * its connection class as parent, which has the global bucket as
+ * parent, and a message may be sent only once every bucket up the
+ * chain has tokens. Queries and Pings also draw on a separate bulk
+ * bucket, so that relaying them can be capped while replies, which
+ * their connections send first, keep flowing. Connections defer their
+ * writes with a timer until the tokens are there; nothing sleeps.
+ */
+
+#ifndef GNUT_SHAPER_H
+#define GNUT_SHAPER_H
+
+#include <sxs/sxs.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+#include "gnut_export.h"
+#include "gnut_types.h"
+#include "gnut_error.h"
+
+#define GNUT_SHAPER_MAX_CLASSES 4 /**< Number of connection classes */
+#define GNUT_SHAPER_DEF_BURST 16384 /**< Default bucket depth in bytes */
+#define GNUT_SHAPER_MIN_WAIT 1000 /**< Shortest deferral in microseconds */
+#define GNUT_SHAPER_MAX_IDLE 60000000 /**< Longest refill counted, in us */
+
+/**
+ * A Token Bucket
+ *
+ * The gnut_bucket_t is a type which represents a token bucket. Tokens
+ * are kept in byte microseconds so that refills of less than a byte are
+ * not lost. A bucket may go into debt by the length of the message that
+ * emptied it, so messages longer than the depth still go out. A rate of
+ * zero means the bucket never limits. The depth should be no more than
+ * GNUT_SHAPER_MAX_IDLE worth of the rate.
+ */
+typedef struct GNUT_EXPORT gnut_bucket {
+    gnut_uint64_t rate;         /* Bytes per second, 0 for unlimited */
+    gnut_int64_t tokens;        /* Byte microseconds, may be negative */
+    gnut_int64_t depth;         /* Most tokens held, in byte microseconds */
+    gnut_uint64_t last;         /* When tokens were last added */
+    struct gnut_bucket *parent;
+} gnut_bucket_t;
+
+/**
+ * A Shaper Configuration
+ *
+ * The gnut_shaper_cfg_t is a type which holds the rates, in bytes per
+ * second, and depths, in bytes, of the shared buckets. Use
+ * gnut_shaper_cfg_init() to get the defaults.
+ */
+typedef struct GNUT_EXPORT gnut_shaper_cfg {
+    gnut_uint64_t rate;         /* All connections together */
+    sxs_uint32_t burst;
+    gnut_uint64_t bulk_rate;    /* Queries and Pings of all connections */
+    sxs_uint32_t bulk_burst;
+    gnut_uint64_t class_rate[GNUT_SHAPER_MAX_CLASSES];
+    sxs_uint32_t class_burst[GNUT_SHAPER_MAX_CLASSES];
+} gnut_shaper_cfg_t;
+
+/**
+ * A Shaper
+ *
+ * The gnut_shaper_t is a type which holds the buckets that connections
+ * share. It must outlive the connections that use it, and is only used
+ * from the thread of their event loop.
+ */
+typedef struct GNUT_EXPORT gnut_shaper {
+    gnut_bucket_t global;
+    gnut_bucket_t bulk;
+    gnut_bucket_t classes[GNUT_SHAPER_MAX_CLASSES];
+} gnut_shaper_t;
+
+/**
+ * Initialize a Token Bucket
+ *
+ * The gnut_bucket_init() function initializes a full bucket.
+ * @param b Pointer to the bucket to initialize.
+ * @param rate The rate in bytes per second, or 0 for unlimited.
+ * @param burst The depth in bytes.
+ * @param parent Pointer to the parent bucket, or NULL.
+ * @param now The current time in microseconds.
+ */
+GNUT_EXPORT void gnut_bucket_init(gnut_bucket_t *b, gnut_uint64_t rate,
+    sxs_uint32_t burst, gnut_bucket_t *parent, gnut_uint64_t now);
+
+/**
+ * Change the Rate of a Token Bucket
+ *
+ * The gnut_bucket_set_rate() function changes the rate and depth of a
+ * bucket, keeping the tokens it holds up to the new depth.
+ * @param b Pointer to the bucket.
+ * @param rate The rate in bytes per second, or 0 for unlimited.
+ * @param burst The depth in bytes.
+ */
+GNUT_EXPORT void gnut_bucket_set_rate(gnut_bucket_t *b, gnut_uint64_t rate,
+    sxs_uint32_t burst);
+
+/**
+ * Check Whether a Token Bucket Chain Allows Sending
+ *
+ * The gnut_bucket_ready() function adds the tokens earned since the
+ * last call to 'b' and each of its ancestors, and tells whether all of
+ * them hold some.
+ * @param b Pointer to the bucket.
+ * @param now The current time in microseconds.
+ * @return Non-zero if a message may be sent, 0 otherwise.
+ */
+GNUT_EXPORT int gnut_bucket_ready(gnut_bucket_t *b, gnut_uint64_t now);
+
+/**
+ * Get the Wait Before a Token Bucket Chain Allows Sending
+ *
+ * @param b Pointer to the bucket, as left by gnut_bucket_ready().
+ * @return The microseconds until every bucket up the chain holds
+ * tokens, or 0 if they already do.
+ */
+GNUT_EXPORT gnut_uint64_t gnut_bucket_wait(const gnut_bucket_t *b);
+
+/**
+ * Charge a Token Bucket Chain
+ *
+ * The gnut_bucket_charge() function takes 'bytes' worth of tokens from
+ * 'b' and each of its ancestors.
+ * @param b Pointer to the bucket.
+ * @param bytes The number of bytes sent.
+ */
+GNUT_EXPORT void gnut_bucket_charge(gnut_bucket_t *b, sxs_uint32_t bytes);
+
+/**
+ * Initialize a Shaper Configuration
+ *
+ * The gnut_shaper_cfg_init() function fills in 'cfg' with unlimited
+ * rates and the default depth for every bucket.
+ * @param cfg Pointer to the configuration to initialize.
+ */
+GNUT_EXPORT void gnut_shaper_cfg_init(gnut_shaper_cfg_t *cfg);
+
+/**
+ * Initialize a Shaper
+ *
+ * The gnut_shaper_init() function initializes the global, bulk and
+ * class buckets of 's' from 'cfg', with the class buckets as children
+ * of the global one.
+ * @param s Pointer to the shaper to initialize.
+ * @param cfg Pointer to the configuration to use.
+ * @param now The current time in microseconds.
+ */
+GNUT_EXPORT void gnut_shaper_init(gnut_shaper_t *s,
+    const gnut_shaper_cfg_t *cfg, gnut_uint64_t now);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* GNUT_SHAPER_H */
@@ -0,0 +1,441 @@
+/*
+ * Copyright 2006-2007 Andrew De Ponte
+ *
+ * This file is part of lib_gnut.
+ *
+ * lib_gnut is the intellectual property of Andrew De Ponte; any
+ * distribution and/or modification and/or reproductions of any portion
+ * of lib_gnut MUST be approved by Andrew De Ponte.
+ *
+ * lib_gnut is distributed WITHOUT ANY WARRANTY; without even the
+ * implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE.
+ */
+
+/**
+ * @file gnut_shard.c
+ * @brief This is an implementation file for the sharded runtime.
+ *
+ * The gnut_shard.c file is an implementation file that defines the
+ * gnut_runtime_t and gnut_shard_t types and their associated
+ * functions.
+ */
+
+#define _GNU_SOURCE /* pthread_setaffinity_np() */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdlib.h> /* calloc(), free() */
+#include <string.h> /* memset() */
+#include <unistd.h> /* sysconf() */
+#include <pthread.h>
+#ifdef __linux__
+#include <sched.h> /* cpu_set_t */
+#endif
+
+#include "gnut_shard.h"
+#include "gnut_mpsc.h"
+
+struct gnut_shard {
+    int id;
+    gnut_runtime_t *rt;
+    pthread_t thread;
+    int started;
+    gnut_evloop_t *loop;
+    sxs_socket_t listen_sd;
+    int listening;
+    gnut_arena_t arena;
+    gnut_guid_gen_t guid_gen;
+    void *user;
+    gnut_mpsc_t inbox;
+    int inbox_ready;
+};
+
+struct gnut_runtime {
+    gnut_runtime_cfg_t cfg;
+    int num_shards;
+    gnut_shard_t **shards;
+};
+
+void gnut_runtime_cfg_init(gnut_runtime_cfg_t *cfg) {
+    memset(cfg, 0, sizeof(gnut_runtime_cfg_t));
+    cfg->num_shards = 0;
+    cfg->pin_threads = 1;
+    cfg->listen = 0;
+    cfg->listen_addr.sin_family = AF_INET;
+    cfg->backlog = 128;
+    cfg->fwd_queue_len = GNUT_SHARD_DEF_FWD_LEN;
+    cfg->arena_chunk = GNUT_ARENA_DEF_CHUNK;
+}
+
+static void _gnut_shard_accept_cb(gnut_evloop_t *loop, sxs_socket_t sd,
+    int events, void *arg) {
+
+    gnut_shard_t *shard;
+    gnut_runtime_t *rt;
+    struct sockaddr_in addr;
+    sxs_socklen_t addr_len;
+    sxs_socket_t new_sd;
+
+    shard = (gnut_shard_t *)arg;
+    rt = shard->rt;
+
+    for (;;) {
+        addr_len = sizeof(addr);
+        if (sxs_accept(sd, (struct sockaddr *)&addr, &addr_len, &new_sd) !=
+            SXS_SUCCESS) {
+            break;
+        }
+        if (sxs_set_nonblock(new_sd, 1) != SXS_SUCCESS ||
+            rt->cfg.on_accept == NULL) {
+            sxs_close(new_sd);
+            continue;
+        }
+        rt->cfg.on_accept(shard, new_sd, &addr, rt->cfg.arg);
+    }
+}
+
+#define DRAIN_BATCH 64
+
+static void _gnut_shard_drain(gnut_shard_t *shard) {
+    gnut_runtime_t *rt;
+    void *items[DRAIN_BATCH];
+    sxs_uint32_t n, i, budget;
+
+    rt = shard->rt;
+
+    /* Take at most one ring's worth per call, so producers that keep
+     * up with the drain cannot starve the shard's sockets. */
+    budget = shard->inbox.mask + 1;
+    while (budget > 0) {
+        n = gnut_mpsc_pop_batch(&shard->inbox, items,
+            (budget < DRAIN_BATCH) ? budget : DRAIN_BATCH);
+        if (n == 0) {
+            break;
+        }
+        for (i = 0; i < n; i++) {
+            if (rt->cfg.on_forward != NULL) {
+                rt->cfg.on_forward(shard, items[i], rt->cfg.arg);
+            }
+        }
+        budget -= n;
+    }
+}
+
+static void _gnut_shard_inbox_cb(gnut_evloop_t *loop, sxs_socket_t sd,
+    int events, void *arg) {
+
+    gnut_shard_t *shard;
+
+    shard = (gnut_shard_t *)arg;
+    gnut_mpsc_clear_wake(&shard->inbox);
+    _gnut_shard_drain(shard);
+}
+
+/* Runs before the loop blocks. Producers only signal the inbox after
+ * this announces the sleep, so a busy shard costs them nothing. */
+static void _gnut_shard_prepare_cb(gnut_evloop_t *loop, void *arg) {
+    gnut_shard_t *shard;
+
+    shard = (gnut_shard_t *)arg;
+    if (!gnut_mpsc_prepare_sleep(&shard->inbox)) {
+        _gnut_shard_drain(shard);
+        /* More may have arrived during the drain; do not block on
+         * them. */
+        if (!gnut_mpsc_prepare_sleep(&shard->inbox)) {
+            gnut_evloop_wakeup(loop);
+        }
+    }
+}
+
+static gnut_error_t _gnut_shard_listen(gnut_shard_t *shard) {
+    gnut_runtime_t *rt;
+    sxs_socket_t sd;
+    int on;
+
+    rt = shard->rt;
+
+#ifndef SO_REUSEPORT
+    /* Without SO_REUSEPORT only one socket can be bound to the address,
+     * so shard 0 does all the accepting. */
+    if (shard->id != 0) {
+        return GNUT_SUCCESS;
+    }
+#endif
+
+    if (sxs_socket(AF_INET, SOCK_STREAM, 0, &sd) != SXS_SUCCESS) {
+        return GNUT_ESOCKET;
+    }
+
+    on = 1;
+    sxs_setsockopt(sd, SOL_SOCKET, SO_REUSEADDR, (sxs_buf_t)&on,
+        sizeof(on));
+#ifdef SO_REUSEPORT
+    if (sxs_setsockopt(sd, SOL_SOCKET, SO_REUSEPORT, (sxs_buf_t)&on,
+        sizeof(on)) != SXS_SUCCESS) {
+        sxs_close(sd);
+        return GNUT_ESOCKET;
+    }
+#endif
+
+    if (sxs_bind(sd, (const struct sockaddr *)&rt->cfg.listen_addr,
+        sizeof(rt->cfg.listen_addr)) != SXS_SUCCESS ||
+        sxs_listen(sd, rt->cfg.backlog) != SXS_SUCCESS ||
+        sxs_set_nonblock(sd, 1) != SXS_SUCCESS) {
+        sxs_close(sd);
+        return GNUT_ESOCKET;
+    }
+
+    if (gnut_evloop_add(shard->loop, sd, GNUT_EV_READ,
+        _gnut_shard_accept_cb, shard) != GNUT_SUCCESS) {
+        sxs_close(sd);
+        return GNUT_EEVLOOP;
+    }
+    shard->listen_sd = sd;
+    shard->listening = 1;
+
+    return GNUT_SUCCESS;
+}
+
+static void _gnut_shard_free(gnut_shard_t *shard) {
+    if (shard->listening) {
+        gnut_evloop_del(shard->loop, shard->listen_sd);
+        sxs_close(shard->listen_sd);
+    }
+    if (shard->inbox_ready) {
+        gnut_evloop_del(shard->loop, gnut_mpsc_wake_fd(&shard->inbox));
+        gnut_mpsc_destroy(&shard->inbox);
+    }
+    if (shard->loop != NULL) {
+        gnut_evloop_free(shard->loop);
+    }
+    gnut_arena_destroy(&shard->arena);
+    free(shard);
+}
+
+static gnut_error_t _gnut_shard_new(gnut_runtime_t *rt, int id,
+    gnut_shard_t **pp_shard) {
+
+    gnut_shard_t *shard;
+    gnut_error_t reterr;
+
+    shard = (gnut_shard_t *)calloc(1, sizeof(gnut_shard_t));
+    if (shard == NULL) {
+        return GNUT_ENOMEM;
+    }
+    shard->id = id;
+    shard->rt = rt;
+    gnut_arena_init(&shard->arena, rt->cfg.arena_chunk);
+    gnut_guid_gen_init(&shard->guid_gen);
+
+    reterr = gnut_evloop_new(&shard->loop);
+    if (reterr != GNUT_SUCCESS) {
+        _gnut_shard_free(shard);
+        return reterr;
+    }
+    gnut_evloop_set_prepare_cb(shard->loop, _gnut_shard_prepare_cb, shard);
+
+    reterr = gnut_mpsc_init(&shard->inbox, rt->cfg.fwd_queue_len);
+    if (reterr != GNUT_SUCCESS) {
+        _gnut_shard_free(shard);
+        return reterr;
+    }
+    shard->inbox_ready = 1;
+    if (gnut_evloop_add(shard->loop, gnut_mpsc_wake_fd(&shard->inbox),
+        GNUT_EV_READ, _gnut_shard_inbox_cb, shard) != GNUT_SUCCESS) {
+        gnut_mpsc_destroy(&shard->inbox);
+        shard->inbox_ready = 0;
+        _gnut_shard_free(shard);
+        return GNUT_EEVLOOP;
+    }
+
+    if (rt->cfg.listen) {
+        reterr = _gnut_shard_listen(shard);
+        if (reterr != GNUT_SUCCESS) {
+            _gnut_shard_free(shard);
+            return reterr;
+        }
+    }
+
+    *pp_shard = shard;
+
+    return GNUT_SUCCESS;
+}
+
+gnut_error_t gnut_runtime_new(gnut_runtime_t **pp_rt,
+    const gnut_runtime_cfg_t *cfg) {
+
+    gnut_runtime_t *rt;
+    gnut_error_t reterr;
+    long ncpu;
+    int i;
+
+    rt = (gnut_runtime_t *)calloc(1, sizeof(gnut_runtime_t));
+    if (rt == NULL) {
+        return GNUT_ENOMEM;
+    }
+    rt->cfg = *cfg;
+
+    rt->num_shards = cfg->num_shards;
+    if (rt->num_shards <= 0) {
+        ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+        rt->num_shards = (ncpu > 0) ? (int)ncpu : 1;
+    }
+    if (rt->num_shards > GNUT_SHARD_MAX) {
+        rt->num_shards = GNUT_SHARD_MAX;
+    }
+
+    rt->shards = (gnut_shard_t **)calloc(rt->num_shards,
+        sizeof(gnut_shard_t *));
+    if (rt->shards == NULL) {
+        free(rt);
+        return GNUT_ENOMEM;
+    }
+
+    for (i = 0; i < rt->num_shards; i++) {
+        reterr = _gnut_shard_new(rt, i, &rt->shards[i]);
+        if (reterr != GNUT_SUCCESS) {
+            gnut_runtime_free(rt);
+            return reterr;
+        }
+    }
+
+    *pp_rt = rt;
+
+    return GNUT_SUCCESS;
+}
+
+static void *_gnut_shard_main(void *arg) {
+    gnut_shard_t *shard;
+    gnut_runtime_t *rt;
+#ifdef __linux__
+    cpu_set_t cpus;
+    long ncpu;
+#endif
+
+    shard = (gnut_shard_t *)arg;
+    rt = shard->rt;
+
+#ifdef __linux__
+    if (rt->cfg.pin_threads) {
+        ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+        if (ncpu > 0) {
+            CPU_ZERO(&cpus);
+            CPU_SET(shard->id % ncpu, &cpus);
+            pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+        }
+    }
+#endif
+
+    if (rt->cfg.on_start != NULL &&
+        rt->cfg.on_start(shard, rt->cfg.arg) != GNUT_SUCCESS) {
+        gnut_runtime_stop(rt);
+        return NULL;
+    }
+
+    gnut_evloop_run(shard->loop);
+
+    return NULL;
+}
+
+gnut_error_t gnut_runtime_start(gnut_runtime_t *rt) {
+    int i;
+
+    for (i = 0; i < rt->num_shards; i++) {
+        if (pthread_create(&rt->shards[i]->thread, NULL, _gnut_shard_main,
+            rt->shards[i]) != 0) {
+            gnut_runtime_stop(rt);
+            gnut_runtime_join(rt);
+            return GNUT_ETHREAD;
+        }
+        rt->shards[i]->started = 1;
+    }
+
+    return GNUT_SUCCESS;
+}
+
+void gnut_runtime_stop(gnut_runtime_t *rt) {
+    int i;
+
+    for (i = 0; i < rt->num_shards; i++) {
+        gnut_evloop_stop(rt->shards[i]->loop);
+    }
+}
+
+void gnut_runtime_join(gnut_runtime_t *rt) {
+    int i;
+
+    for (i = 0; i < rt->num_shards; i++) {
+        if (rt->shards[i]->started) {
+            pthread_join(rt->shards[i]->thread, NULL);
+            rt->shards[i]->started = 0;
+        }
+    }
+}
+
+void gnut_runtime_free(gnut_runtime_t *rt) {
+    int i;
+
+    for (i = 0; i < rt->num_shards; i++) {
+        if (rt->shards[i] != NULL) {
+            _gnut_shard_free(rt->shards[i]);
+        }
+    }
+    free(rt->shards);
+    free(rt);
+}
+
+int gnut_runtime_num_shards(const gnut_runtime_t *rt) {
+    return rt->num_shards;
+}
+
+gnut_shard_t *gnut_runtime_shard(gnut_runtime_t *rt, int id) {
+    return rt->shards[id];
+}
+
+int gnut_shard_id(const gnut_shard_t *shard) {
+    return shard->id;
+}
+
+gnut_runtime_t *gnut_shard_runtime(gnut_shard_t *shard) {
+    return shard->rt;
+}
+
+gnut_evloop_t *gnut_shard_loop(gnut_shard_t *shard) {
+    return shard->loop;
+}
+
+gnut_arena_t *gnut_shard_arena(gnut_shard_t *shard) {
+    return &shard->arena;
+}
+
+gnut_guid_gen_t *gnut_shard_guid_gen(gnut_shard_t *shard) {
+    return &shard->guid_gen;
+}
+
+void gnut_shard_set_user(gnut_shard_t *shard, void *user) {
+    shard->user = user;
+}
+
+void *gnut_shard_user(gnut_shard_t *shard) {
+    return shard->user;
+}
+
+gnut_error_t gnut_shard_forward(gnut_shard_t *dst, void *item) {
+    if (dst->rt->cfg.on_forward == NULL) {
+        return GNUT_EQUEUE_FULL;
+    }
+    return gnut_mpsc_push(&dst->inbox, item);
+}
+
+gnut_error_t gnut_shard_forward_batch(gnut_shard_t *dst, void *const *items,
+    sxs_uint32_t num, sxs_uint32_t *p_queued) {
+
+    if (dst->rt->cfg.on_forward == NULL) {
+        *p_queued = 0;
+        return GNUT_EQUEUE_FULL;
+    }
+    return gnut_mpsc_push_batch(&dst->inbox, items, num, p_queued);
+}
@@ -0,0 +1,289 @@
+/*
+ * Copyright 2006-2007 Andrew De Ponte
+ *
+ * This file is part of lib_gnut.
+ *
+ * lib_gnut is the intellectual property of Andrew De Ponte; any
+ * distribution and/or modification and/or reproductions of any portion
+ * of lib_gnut MUST be approved by Andrew De Ponte.
+ *
+ * lib_gnut is distributed WITHOUT ANY WARRANTY; without even the
+ * implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE.
+ */
+
+/**
+ * @file gnut_shard.h
+ * @brief This is a specifications file for the sharded runtime.
+ *
+ * The gnut_shard.h file is a specifications file that declares the
+ * gnut_runtime_t and gnut_shard_t types and their associated
+ * functions. A runtime runs one shard per core. Each shard is a thread
+ * with its own event loop, arena, GUID generator and listening socket
+ * bound with SO_REUSEPORT, so the kernel spreads incoming connections
+ * across shards and a connection never leaves the shard that accepted
+ * it. Each shard has a lock-free inbox that any thread may hand it
+ * work through.
+ */
+
+#ifndef GNUT_SHARD_H
+#define GNUT_SHARD_H
+
+#include <sxs/sxs.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+#include "gnut_export.h"
+#include "gnut_types.h"
+#include "gnut_error.h"
+#include "gnut_evloop.h"
+#include "gnut_arena.h"
+#include "gnut_guid.h"
+
+#define GNUT_SHARD_MAX 64 /**< Max number of shards in a runtime */
+#define GNUT_SHARD_DEF_FWD_LEN 4096 /**< Default forward queue length */
+
+/**
+ * A Shard
+ *
+ * The gnut_shard_t is an opaque type which represents one shard of a
+ * runtime.
+ */
+typedef struct gnut_shard gnut_shard_t;
+
+/**
+ * A Runtime
+ *
+ * The gnut_runtime_t is an opaque type which represents a set of
+ * shards.
+ */
+typedef struct gnut_runtime gnut_runtime_t;
+
+/**
+ * A Shard Start Callback
+ *
+ * The gnut_shard_start_cb_t is the type of function called on a
+ * shard's own thread before its event loop starts running. It is the
+ * place to set up per-shard state with gnut_shard_set_user().
+ */
+typedef gnut_error_t (*gnut_shard_start_cb_t)(gnut_shard_t *shard,
+    void *arg);
+
+/**
+ * A Shard Accept Callback
+ *
+ * The gnut_shard_accept_cb_t is the type of function called on a
+ * shard's thread for each connection its listener accepts. The socket
+ * is already non-blocking and is owned by the callee.
+ */
+typedef void (*gnut_shard_accept_cb_t)(gnut_shard_t *shard,
+    sxs_socket_t sd, const struct sockaddr_in *addr, void *arg);
+
+/**
+ * A Shard Forward Callback
+ *
+ * The gnut_shard_forward_cb_t is the type of function called on the
+ * destination shard's thread for each item handed to it with
+ * gnut_shard_forward().
+ */
+typedef void (*gnut_shard_forward_cb_t)(gnut_shard_t *shard, void *item,
+    void *arg);
+
+/**
+ * A Runtime Configuration
+ *
+ * The gnut_runtime_cfg_t is a type which holds the settings of a
+ * runtime. Use gnut_runtime_cfg_init() to get the defaults.
+ */
+typedef struct GNUT_EXPORT gnut_runtime_cfg {
+    int num_shards;             /* 0 for one per online CPU */
+    int pin_threads;            /* Pin shard i to CPU i when supported */
+    int listen;                 /* Open a listener on each shard */
+    struct sockaddr_in listen_addr;
+    int backlog;
+    sxs_uint32_t fwd_queue_len; /* Items per shard inbox */
+    size_t arena_chunk;         /* Chunk size of the shard arenas */
+    gnut_shard_start_cb_t on_start;
+    gnut_shard_accept_cb_t on_accept;
+    gnut_shard_forward_cb_t on_forward; /* NULL if nothing is forwarded */
+    void *arg;                  /* Passed to all the callbacks */
+} gnut_runtime_cfg_t;
+
+/**
+ * Initialize a Runtime Configuration
+ *
+ * The gnut_runtime_cfg_init() function fills in 'cfg' with default
+ * values: one pinned shard per CPU, no listener, and no callbacks.
+ * @param cfg Pointer to the configuration to initialize.
+ */
+GNUT_EXPORT void gnut_runtime_cfg_init(gnut_runtime_cfg_t *cfg);
+
+/**
+ * Create a Runtime
+ *
+ * The gnut_runtime_new() function creates the shards, their event
+ * loops and their listening sockets, but does not start the threads.
+ * @param pp_rt Pointer to store the pointer to the new runtime in.
+ * @param cfg Pointer to the configuration to use.
+ * @return A value representing an error or success.
+ * @retval GNUT_SUCCESS Successfully created the runtime.
+ * @retval GNUT_ENOMEM Failed to allocate memory.
+ * @retval GNUT_EEVLOOP Failed to create an event loop.
+ * @retval GNUT_ESOCKET Failed to set up a listening socket.
+ */
+GNUT_EXPORT gnut_error_t gnut_runtime_new(gnut_runtime_t **pp_rt,
+    const gnut_runtime_cfg_t *cfg);
+
+/**
+ * Start a Runtime
+ *
+ * The gnut_runtime_start() function starts one thread per shard.
+ * @param rt Pointer to the runtime.
+ * @return A value representing an error or success.
+ * @retval GNUT_SUCCESS Successfully started all shards.
+ * @retval GNUT_ETHREAD Failed to start a thread; any started shards
+ * are stopped and joined.
+ */
+GNUT_EXPORT gnut_error_t gnut_runtime_start(gnut_runtime_t *rt);
+
+/**
+ * Stop a Runtime
+ *
+ * The gnut_runtime_stop() function asks every shard's event loop to
+ * stop. It may be called from any thread, including a shard's.
+ * @param rt Pointer to the runtime.
+ */
+GNUT_EXPORT void gnut_runtime_stop(gnut_runtime_t *rt);
+
+/**
+ * Wait for a Runtime
+ *
+ * The gnut_runtime_join() function waits for all shard threads to
+ * exit after gnut_runtime_stop().
+ * @param rt Pointer to the runtime.
+ */
+GNUT_EXPORT void gnut_runtime_join(gnut_runtime_t *rt);
+
+/**
+ * Free a Runtime
+ *
+ * The gnut_runtime_free() function closes the listeners and frees the
+ * shards. The runtime must have been joined.
+ * @param rt Pointer to the runtime.
+ */
+GNUT_EXPORT void gnut_runtime_free(gnut_runtime_t *rt);
+
+/**
+ * Get the Number of Shards
+ *
+ * @param rt Pointer to the runtime.
+ * @return The number of shards in the runtime.
+ */
+GNUT_EXPORT int gnut_runtime_num_shards(const gnut_runtime_t *rt);
+
+/**
+ * Get a Shard
+ *
+ * @param rt Pointer to the runtime.
+ * @param id The shard id, from 0 to the number of shards - 1.
+ * @return Pointer to the shard.
+ */
+GNUT_EXPORT gnut_shard_t *gnut_runtime_shard(gnut_runtime_t *rt, int id);
+
+/**
+ * Get a Shard's Id
+ *
+ * @param shard Pointer to the shard.
+ * @return The id of the shard.
+ */
+GNUT_EXPORT int gnut_shard_id(const gnut_shard_t *shard);
+
+/**
+ * Get a Shard's Runtime
+ *
+ * @param shard Pointer to the shard.
+ * @return Pointer to the runtime the shard belongs to.
+ */
+GNUT_EXPORT gnut_runtime_t *gnut_shard_runtime(gnut_shard_t *shard);
+
+/**
+ * Get a Shard's Event Loop
+ *
+ * @param shard Pointer to the shard.
+ * @return Pointer to the event loop of the shard.
+ */
+GNUT_EXPORT gnut_evloop_t *gnut_shard_loop(gnut_shard_t *shard);
+
+/**
+ * Get a Shard's Arena
+ *
+ * @param shard Pointer to the shard.
+ * @return Pointer to the arena of the shard.
+ */
+GNUT_EXPORT gnut_arena_t *gnut_shard_arena(gnut_shard_t *shard);
+
+/**
+ * Get a Shard's GUID Generator
+ *
+ * @param shard Pointer to the shard.
+ * @return Pointer to the GUID generator of the shard.
+ */
+GNUT_EXPORT gnut_guid_gen_t *gnut_shard_guid_gen(gnut_shard_t *shard);
+
+/**
+ * Set a Shard's User Data
+ *
+ * @param shard Pointer to the shard.
+ * @param user The user data to associate with the shard.
+ */
+GNUT_EXPORT void gnut_shard_set_user(gnut_shard_t *shard, void *user);
+
+/**
+ * Get a Shard's User Data
+ *
+ * @param shard Pointer to the shard.
+ * @return The user data associated with the shard.
+ */
+GNUT_EXPORT void *gnut_shard_user(gnut_shard_t *shard);
+
+/**
+ * Forward an Item to a Shard
+ *
+ * The gnut_shard_forward() function queues 'item' in the inbox of
+ * 'dst', whose forward callback will receive it on its own thread. Any
+ * thread may call it. The destination's thread is only signalled if it
+ * is sleeping.
+ * @param dst Pointer to the destination shard.
+ * @param item The item to hand over, which must not be NULL.
+ * @return A value representing an error or success.
+ * @retval GNUT_SUCCESS Successfully queued the item.
+ * @retval GNUT_EQUEUE_FULL The inbox of the destination is full, or
+ * the runtime has no forward callback to take it.
+ */
+GNUT_EXPORT gnut_error_t gnut_shard_forward(gnut_shard_t *dst, void *item);
+
+/**
+ * Forward a Batch of Items to a Shard
+ *
+ * The gnut_shard_forward_batch() function queues as many of the 'num'
+ * items in 'items' as fit in the inbox of 'dst', in order, with a
+ * single atomic reservation. Any thread may call it.
+ * @param dst Pointer to the destination shard.
+ * @param items Array of items to hand over, none of which may be NULL.
+ * @param num The number of items in 'items'.
+ * @param p_queued Pointer to store the number of items queued in.
+ * @return A value representing an error or success.
+ * @retval GNUT_SUCCESS Successfully queued all of the items.
+ * @retval GNUT_EQUEUE_FULL The inbox filled up, or the runtime has no
+ * forward callback; only the first '*p_queued' items were queued.
+ */
+GNUT_EXPORT gnut_error_t gnut_shard_forward_batch(gnut_shard_t *dst,
+    void *const *items, sxs_uint32_t num, sxs_uint32_t *p_queued);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* GNUT_SHARD_H */
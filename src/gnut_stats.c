@@ -0,0 +1,294 @@
+/*
+ * Copyright 2006-2007 Andrew De Ponte
+ *
+ * This file is part of lib_gnut.
+ *
+ * lib_gnut is the intellectual property of Andrew De Ponte; any
+ * distribution and/or modification and/or reproductions of any portion
+ * of lib_gnut MUST be approved by Andrew De Ponte.
+ *
+ * lib_gnut is distributed WITHOUT ANY WARRANTY; without even the
+ * implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE.
+ */
+
+/**
+ * @file gnut_stats.c
+ * @brief This is an implementation file for the traffic statistics.
+ *
+ * The gnut_stats.c file is an implementation file that defines the
+ * traffic statistics functions.
+ *
+ * Blocks are kept on a list that only ever grows. A thread claims a
+ * free block the first time it updates a statistic and gives it back
+ * when it exits, so the next new thread carries on from its totals and
+ * the sums never go backwards. Only the owner writes a block, and it
+ * does so with relaxed atomic stores so that a snapshot never reads a
+ * torn counter; on 64 bit targets these are plain moves.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdlib.h> /* posix_memalign(), abort() */
+#include <string.h> /* memset() */
+#include <time.h> /* clock_gettime() */
+#include <pthread.h>
+
+#include "gnut_stats.h"
+#include "gnut_atomic.h"
+
+#define HIST_MAX_EXP 40 /* Values from 2^HIST_MAX_EXP share the last bucket */
+
+#define BUMP(p, v) GNUT_ATOMIC_STORE_RLX((p), GNUT_ATOMIC_LOAD_RLX(p) + (v))
+
+typedef struct gnut_stats_block {
+    gnut_stats_t s;
+    struct gnut_stats_block *next;
+    int in_use;
+} GNUT_CACHE_ALIGNED gnut_stats_block_t;
+
+static const char *_gnut_stats_type_names[GNUT_NODE_NUM_T] = {
+    "ping", "pong", "bye", "push", "query", "query_hit", "other"
+};
+
+static const char *_gnut_stats_drop_names[GNUT_STATS_NUM_DROPS] = {
+    "dup", "ttl", "unroutable", "malformed", "shed", "closed", "repeat",
+    "pruned"
+};
+
+static const char *_gnut_stats_hist_names[GNUT_STATS_NUM_HISTS] = {
+    "parse", "queue", "forward"
+};
+
+static gnut_stats_block_t *_gnut_stats_blocks = NULL;
+static int _gnut_stats_timing = 1;
+static pthread_once_t _gnut_stats_once = PTHREAD_ONCE_INIT;
+static pthread_key_t _gnut_stats_key;
+#ifdef HAVE_TLS
+static __thread gnut_stats_block_t *_gnut_stats_self = NULL;
+#endif
+
+static void _gnut_stats_release(void *arg) {
+    gnut_stats_block_t *blk;
+
+    blk = (gnut_stats_block_t *)arg;
+    GNUT_ATOMIC_STORE_REL(&blk->in_use, 0);
+}
+
+static void _gnut_stats_key_init(void) {
+    pthread_key_create(&_gnut_stats_key, _gnut_stats_release);
+}
+
+/* Claims a block left by an exited thread, or adds a new one. */
+static gnut_stats_block_t *_gnut_stats_attach(void) {
+    gnut_stats_block_t *blk, *head;
+    void *mem;
+    int expected;
+
+    pthread_once(&_gnut_stats_once, _gnut_stats_key_init);
+
+    for (blk = GNUT_ATOMIC_LOAD_ACQ(&_gnut_stats_blocks); blk != NULL;
+        blk = blk->next) {
+
+        expected = 0;
+        if (GNUT_ATOMIC_LOAD_RLX(&blk->in_use) == 0 &&
+            GNUT_ATOMIC_CAS(&blk->in_use, &expected, 1)) {
+            break;
+        }
+    }
+
+    if (blk == NULL) {
+        /* Statistics have nowhere to report a failure to, and a
+         * process that cannot allocate one block will not get far. */
+        if (posix_memalign(&mem, GNUT_CACHE_LINE,
+            sizeof(gnut_stats_block_t)) != 0) {
+            abort();
+        }
+        blk = (gnut_stats_block_t *)mem;
+        memset(blk, 0, sizeof(gnut_stats_block_t));
+        blk->in_use = 1;
+        head = GNUT_ATOMIC_LOAD_RLX(&_gnut_stats_blocks);
+        do {
+            blk->next = head;
+        } while (!GNUT_ATOMIC_CAS(&_gnut_stats_blocks, &head, blk));
+    }
+
+    pthread_setspecific(_gnut_stats_key, blk);
+#ifdef HAVE_TLS
+    _gnut_stats_self = blk;
+#endif
+    return blk;
+}
+
+static gnut_stats_t *_gnut_stats_local(void) {
+    gnut_stats_block_t *blk;
+
+#ifdef HAVE_TLS
+    blk = _gnut_stats_self;
+#else
+    /* Without __thread the key is the only per-thread pointer. */
+    pthread_once(&_gnut_stats_once, _gnut_stats_key_init);
+    blk = (gnut_stats_block_t *)pthread_getspecific(_gnut_stats_key);
+#endif
+    if (blk == NULL) {
+        blk = _gnut_stats_attach();
+    }
+    return &blk->s;
+}
+
+static unsigned int _gnut_stats_bucket(gnut_uint64_t v) {
+    unsigned int e;
+
+    if (v < 16) {
+        return (unsigned int)v;
+    }
+    e = 63 - __builtin_clzll(v);
+    if (e >= HIST_MAX_EXP) {
+        return GNUT_STATS_HIST_LEN - 1;
+    }
+    return 16 + (e - 4) * 16 + (unsigned int)((v >> (e - 4)) & 15);
+}
+
+void gnut_stats_rx(int t, sxs_uint32_t bytes) {
+    gnut_stats_t *s;
+
+    s = _gnut_stats_local();
+    BUMP(&s->rx_msgs[t], 1);
+    BUMP(&s->rx_bytes[t], bytes);
+}
+
+void gnut_stats_tx(int t, sxs_uint32_t bytes) {
+    gnut_stats_t *s;
+
+    s = _gnut_stats_local();
+    BUMP(&s->tx_msgs[t], 1);
+    BUMP(&s->tx_bytes[t], bytes);
+}
+
+void gnut_stats_dup(int t) {
+    gnut_stats_t *s;
+
+    s = _gnut_stats_local();
+    BUMP(&s->dup_hits[t], 1);
+    BUMP(&s->drops[GNUT_STATS_DROP_DUP], 1);
+}
+
+void gnut_stats_drop(int reason) {
+    gnut_stats_t *s;
+
+    s = _gnut_stats_local();
+    BUMP(&s->drops[reason], 1);
+}
+
+void gnut_stats_record(int h, gnut_uint64_t ns) {
+    gnut_stats_hist_t *hist;
+
+    hist = &_gnut_stats_local()->hists[h];
+    BUMP(&hist->b[_gnut_stats_bucket(ns)], 1);
+    BUMP(&hist->n, 1);
+    BUMP(&hist->sum, ns);
+    if (ns > hist->max) {
+        GNUT_ATOMIC_STORE_RLX(&hist->max, ns);
+    }
+}
+
+gnut_uint64_t gnut_stats_clock(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ((gnut_uint64_t)ts.tv_sec * 1000000000) + ts.tv_nsec;
+}
+
+void gnut_stats_set_timing(int on) {
+    GNUT_ATOMIC_STORE_RLX(&_gnut_stats_timing, on);
+}
+
+int gnut_stats_timing(void) {
+    return GNUT_ATOMIC_LOAD_RLX(&_gnut_stats_timing);
+}
+
+static void _gnut_stats_sum(gnut_uint64_t *dst, const gnut_uint64_t *src,
+    int n) {
+
+    int i;
+
+    for (i = 0; i < n; i++) {
+        dst[i] += GNUT_ATOMIC_LOAD_RLX(&src[i]);
+    }
+}
+
+void gnut_stats_snapshot(gnut_stats_t *out) {
+    const gnut_stats_block_t *blk;
+    const gnut_stats_hist_t *src;
+    gnut_stats_hist_t *dst;
+    gnut_uint64_t max;
+    int h;
+
+    memset(out, 0, sizeof(gnut_stats_t));
+    for (blk = GNUT_ATOMIC_LOAD_ACQ(&_gnut_stats_blocks); blk != NULL;
+        blk = blk->next) {
+
+        _gnut_stats_sum(out->rx_msgs, blk->s.rx_msgs, GNUT_NODE_NUM_T);
+        _gnut_stats_sum(out->rx_bytes, blk->s.rx_bytes, GNUT_NODE_NUM_T);
+        _gnut_stats_sum(out->tx_msgs, blk->s.tx_msgs, GNUT_NODE_NUM_T);
+        _gnut_stats_sum(out->tx_bytes, blk->s.tx_bytes, GNUT_NODE_NUM_T);
+        _gnut_stats_sum(out->dup_hits, blk->s.dup_hits, GNUT_NODE_NUM_T);
+        _gnut_stats_sum(out->drops, blk->s.drops, GNUT_STATS_NUM_DROPS);
+        for (h = 0; h < GNUT_STATS_NUM_HISTS; h++) {
+            src = &blk->s.hists[h];
+            dst = &out->hists[h];
+            _gnut_stats_sum(dst->b, src->b, GNUT_STATS_HIST_LEN);
+            dst->n += GNUT_ATOMIC_LOAD_RLX(&src->n);
+            dst->sum += GNUT_ATOMIC_LOAD_RLX(&src->sum);
+            max = GNUT_ATOMIC_LOAD_RLX(&src->max);
+            if (max > dst->max) {
+                dst->max = max;
+            }
+        }
+    }
+}
+
+gnut_uint64_t gnut_stats_hist_upper(int i) {
+    unsigned int e;
+
+    if (i < 16) {
+        return (gnut_uint64_t)i;
+    }
+    e = (i - 16) / 16 + 4;
+    return (((gnut_uint64_t)(16 + (i - 16) % 16 + 1)) << (e - 4)) - 1;
+}
+
+gnut_uint64_t gnut_stats_hist_pct(const gnut_stats_hist_t *h, double q) {
+    gnut_uint64_t want, seen;
+    int i;
+
+    if (h->n == 0) {
+        return 0;
+    }
+    want = (gnut_uint64_t)(q * h->n);
+    if ((double)want < q * h->n) {
+        want++;
+    }
+    seen = 0;
+    for (i = 0; i < GNUT_STATS_HIST_LEN - 1; i++) {
+        seen += h->b[i];
+        if (seen >= want && seen > 0) {
+            break;
+        }
+    }
+    return gnut_stats_hist_upper(i);
+}
+
+const char *gnut_stats_type_name(int t) {
+    return _gnut_stats_type_names[t];
+}
+
+const char *gnut_stats_drop_name(int reason) {
+    return _gnut_stats_drop_names[reason];
+}
+
+const char *gnut_stats_hist_name(int h) {
+    return _gnut_stats_hist_names[h];
+}
@@ -0,0 +1,218 @@
+/*
+ * Copyright 2006-2007 Andrew De Ponte
+ *
+ * This file is part of lib_gnut.
+ *
+ * lib_gnut is the intellectual property of Andrew De Ponte; any
+ * distribution and/or modification and/or reproductions of any portion
+ * of lib_gnut MUST be approved by Andrew De Ponte.
+ *
+ * lib_gnut is distributed WITHOUT ANY WARRANTY; without even the
+ * implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE.
+ */
+
+/**
+ * @file gnut_stats.h
+ * @brief This is a specifications file for the traffic statistics.
+ *
+ * The gnut_stats.h file is a specifications file that declares the
+ * process wide traffic counters and latency histograms of lib_gnut and
+ * the functions that update and read them. Every thread that updates a
+ * statistic gets its own cache line aligned block of counters, which
+ * only it writes, so an update is a thread local lookup and a plain
+ * add. A snapshot sums the blocks of all threads while they keep
+ * running.
+ */
+
+#ifndef GNUT_STATS_H
+#define GNUT_STATS_H
+
+#include <sxs/sxs.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+#include "gnut_export.h"
+#include "gnut_types.h"
+#include "gnut_error.h"
+#include "gnut_node.h"
+
+#define GNUT_STATS_DROP_DUP 0 /**< Ping or Query seen before */
+#define GNUT_STATS_DROP_TTL 1 /**< Zero TTL, or over the hop limit */
+#define GNUT_STATS_DROP_UNROUTABLE 2 /**< Reply with no known route */
+#define GNUT_STATS_DROP_MALFORMED 3 /**< Payload too short for its type */
+#define GNUT_STATS_DROP_SHED 4 /**< Shed or refused by an output queue */
+#define GNUT_STATS_DROP_CLOSED 5 /**< Sent to a connection not up */
+#define GNUT_STATS_DROP_REPEAT 6 /**< Query repeated under a new ID */
+#define GNUT_STATS_DROP_PRUNED 7 /**< Over the limits its peer gave */
+#define GNUT_STATS_NUM_DROPS 8 /**< Number of drop reasons */
+
+#define GNUT_STATS_H_PARSE 0 /**< Framing a message out of a read */
+#define GNUT_STATS_H_QUEUE 1 /**< Time spent in an output queue */
+#define GNUT_STATS_H_FORWARD 2 /**< Routing a message and queueing it */
+#define GNUT_STATS_NUM_HISTS 3 /**< Number of histograms */
+
+#define GNUT_STATS_HIST_LEN 592 /**< 16 exact buckets, 16 per power of 2 */
+
+/**
+ * A Latency Histogram
+ *
+ * The gnut_stats_hist_t is a type which holds a log-linear histogram
+ * of durations in nanoseconds. Values below 16 have a bucket each, and
+ * every power of two above that is split into 16 buckets, so a bucket
+ * is never wider than 1/16 of its lower bound. Values of 2^40 ns or
+ * more land in the last bucket.
+ */
+typedef struct GNUT_EXPORT gnut_stats_hist {
+    gnut_uint64_t n;            /* Values recorded */
+    gnut_uint64_t sum;          /* Their total */
+    gnut_uint64_t max;
+    gnut_uint64_t b[GNUT_STATS_HIST_LEN];
+} gnut_stats_hist_t;
+
+/**
+ * Traffic Statistics
+ *
+ * The gnut_stats_t is a type which holds a snapshot of the statistics,
+ * indexed by GNUT_NODE_T_* where there is one per type, and by the
+ * GNUT_STATS_DROP_* and GNUT_STATS_H_* values otherwise.
+ */
+typedef struct GNUT_EXPORT gnut_stats {
+    gnut_uint64_t rx_msgs[GNUT_NODE_NUM_T];
+    gnut_uint64_t rx_bytes[GNUT_NODE_NUM_T];    /* Including headers */
+    gnut_uint64_t tx_msgs[GNUT_NODE_NUM_T];
+    gnut_uint64_t tx_bytes[GNUT_NODE_NUM_T];
+    gnut_uint64_t dup_hits[GNUT_NODE_NUM_T];    /* Message IDs seen before */
+    gnut_uint64_t drops[GNUT_STATS_NUM_DROPS];
+    gnut_stats_hist_t hists[GNUT_STATS_NUM_HISTS];
+} gnut_stats_t;
+
+/**
+ * Count a Received Message
+ *
+ * @param t The GNUT_NODE_T_* index of the message's type.
+ * @param bytes The length of the message, header included.
+ */
+GNUT_EXPORT void gnut_stats_rx(int t, sxs_uint32_t bytes);
+
+/**
+ * Count a Sent Message
+ *
+ * @param t The GNUT_NODE_T_* index of the message's type.
+ * @param bytes The length of the message, header included.
+ */
+GNUT_EXPORT void gnut_stats_tx(int t, sxs_uint32_t bytes);
+
+/**
+ * Count a Duplicate Message
+ *
+ * The gnut_stats_dup() function counts a message whose Message ID was
+ * found in a routing table, and the drop that follows.
+ * @param t The GNUT_NODE_T_* index of the message's type.
+ */
+GNUT_EXPORT void gnut_stats_dup(int t);
+
+/**
+ * Count a Dropped Message
+ *
+ * @param reason One of the GNUT_STATS_DROP_* values.
+ */
+GNUT_EXPORT void gnut_stats_drop(int reason);
+
+/**
+ * Record a Duration
+ *
+ * @param h One of the GNUT_STATS_H_* values.
+ * @param ns The duration in nanoseconds.
+ */
+GNUT_EXPORT void gnut_stats_record(int h, gnut_uint64_t ns);
+
+/**
+ * Sample the Statistics Clock
+ *
+ * The gnut_stats_clock() function samples the monotonic clock with the
+ * resolution the histograms are kept in.
+ * @return The monotonic time in nanoseconds.
+ */
+GNUT_EXPORT gnut_uint64_t gnut_stats_clock(void);
+
+/**
+ * Enable or Disable Timing
+ *
+ * The gnut_stats_set_timing() function sets whether lib_gnut samples
+ * the clock to fill in the parse and forward histograms, which costs
+ * two clock reads per message received. Timing is enabled by default.
+ * Counters are always kept.
+ * @param on Non-zero to enable timing.
+ */
+GNUT_EXPORT void gnut_stats_set_timing(int on);
+
+/**
+ * Check Whether Timing is Enabled
+ *
+ * @return Non-zero if timing is enabled, 0 otherwise.
+ */
+GNUT_EXPORT int gnut_stats_timing(void);
+
+/**
+ * Take a Snapshot of the Statistics
+ *
+ * The gnut_stats_snapshot() function sums the statistics of every
+ * thread that has ever updated them into 'out', without stopping those
+ * threads. Each counter is read whole, but counters updated while the
+ * snapshot is taken may or may not be included, so related counters
+ * can be off from one another by the updates in flight.
+ * @param out Pointer to store the sums in.
+ */
+GNUT_EXPORT void gnut_stats_snapshot(gnut_stats_t *out);
+
+/**
+ * Get the Upper Bound of a Histogram Bucket
+ *
+ * @param i The bucket index, below GNUT_STATS_HIST_LEN.
+ * @return The largest value bucket 'i' holds, in nanoseconds.
+ */
+GNUT_EXPORT gnut_uint64_t gnut_stats_hist_upper(int i);
+
+/**
+ * Get a Quantile of a Histogram
+ *
+ * @param h Pointer to the histogram.
+ * @param q The quantile, between 0 and 1.
+ * @return The upper bound of the bucket holding the quantile, or 0 if
+ * the histogram is empty.
+ */
+GNUT_EXPORT gnut_uint64_t gnut_stats_hist_pct(const gnut_stats_hist_t *h,
+    double q);
+
+/**
+ * Get the Name of a Message Type Index
+ *
+ * @param t A GNUT_NODE_T_* index.
+ * @return A lower case name such as "query_hit".
+ */
+GNUT_EXPORT const char *gnut_stats_type_name(int t);
+
+/**
+ * Get the Name of a Drop Reason
+ *
+ * @param reason A GNUT_STATS_DROP_* value.
+ * @return A lower case name such as "unroutable".
+ */
+GNUT_EXPORT const char *gnut_stats_drop_name(int reason);
+
+/**
+ * Get the Name of a Histogram
+ *
+ * @param h A GNUT_STATS_H_* value.
+ * @return A lower case name such as "parse".
+ */
+GNUT_EXPORT const char *gnut_stats_hist_name(int h);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* GNUT_STATS_H */
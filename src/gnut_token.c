@@ -0,0 +1,311 @@
+/*
+ * Copyright 2006-2007 Andrew De Ponte
+ *
+ * This file is part of lib_gnut.
+ *
+ * lib_gnut is the intellectual property of Andrew De Ponte; any
+ * distribution and/or modification and/or reproductions of any portion
+ * of lib_gnut MUST be approved by Andrew De Ponte.
+ *
+ * lib_gnut is distributed WITHOUT ANY WARRANTY; without even the
+ * implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE.
+ */
+
+/**
+ * @file gnut_token.c
+ * @brief This is an implementation file for the keyword tokenizer.
+ *
+ * The gnut_token.c file is an implementation file that defines the
+ * gnut_tokenize() function. ASCII text is folded and classified a
+ * vector at a time, and the bit mask of keyword bytes of each vector
+ * gives the keyword boundaries by counting trailing zeros. At the first
+ * vector holding a byte beyond ASCII the rest of the text is normalized
+ * a character at a time, then classified a vector at a time again.
+ */
+
+#include <string.h> /* memcpy() */
+
+#include "gnut_token.h"
+
+#if defined(__AVX2__)
+
+#include <immintrin.h>
+
+#define VEC_LEN 32
+typedef __m256i vec_t;
+#define V_LOAD(p) _mm256_loadu_si256((const __m256i *)(p))
+#define V_STORE(p, v) _mm256_storeu_si256((__m256i *)(p), (v))
+#define V_SET1(c) _mm256_set1_epi8((char)(c))
+#define V_ADD(a, b) _mm256_add_epi8((a), (b))
+#define V_SUB(a, b) _mm256_sub_epi8((a), (b))
+#define V_AND(a, b) _mm256_and_si256((a), (b))
+#define V_OR(a, b) _mm256_or_si256((a), (b))
+#define V_XOR(a, b) _mm256_xor_si256((a), (b))
+#define V_GT(a, b) _mm256_cmpgt_epi8((a), (b))
+#define V_MASK(v) ((sxs_uint32_t)_mm256_movemask_epi8(v))
+#define VEC_FULL 0xffffffffU
+
+#elif defined(__SSE2__)
+
+#include <emmintrin.h>
+
+#define VEC_LEN 16
+typedef __m128i vec_t;
+#define V_LOAD(p) _mm_loadu_si128((const __m128i *)(p))
+#define V_STORE(p, v) _mm_storeu_si128((__m128i *)(p), (v))
+#define V_SET1(c) _mm_set1_epi8((char)(c))
+#define V_ADD(a, b) _mm_add_epi8((a), (b))
+#define V_SUB(a, b) _mm_sub_epi8((a), (b))
+#define V_AND(a, b) _mm_and_si128((a), (b))
+#define V_OR(a, b) _mm_or_si128((a), (b))
+#define V_XOR(a, b) _mm_xor_si128((a), (b))
+#define V_GT(a, b) _mm_cmpgt_epi8((a), (b))
+#define V_MASK(v) ((sxs_uint32_t)_mm_movemask_epi8(v))
+#define VEC_FULL 0xffffU
+
+#endif
+
+#ifdef VEC_LEN
+/* All ones in the bytes of 'x' from 'lo' up to, but not including,
+ * 'lo' + 'n'. There is no unsigned byte compare, so the bytes are
+ * shifted into the signed range first. */
+#define V_IN_RANGE(x, lo, n) V_GT(V_SET1((n) - 128), \
+    V_XOR(V_SUB((x), V_SET1(lo)), V_SET1(0x80)))
+#endif
+
+/* What the letters of Latin-1 fold to, from U+00C0 on. A space stands
+ * for the two signs among them, which separate keywords. */
+static const char _gnut_token_latin1_fold[64][3] = {
+    "a", "a", "a", "a", "a", "a", "ae", "c",
+    "e", "e", "e", "e", "i", "i", "i", "i",
+    "d", "n", "o", "o", "o", "o", "o", " ",
+    "o", "u", "u", "u", "u", "y", "th", "ss",
+    "a", "a", "a", "a", "a", "a", "ae", "c",
+    "e", "e", "e", "e", "i", "i", "i", "i",
+    "d", "n", "o", "o", "o", "o", "o", " ",
+    "o", "u", "u", "u", "u", "y", "th", "y"
+};
+
+typedef struct gnut_token_state {
+    gnut_token_t *toks;
+    sxs_uint32_t max;
+    sxs_uint32_t n;
+    int in;                     /* Inside a keyword */
+    sxs_uint32_t start;         /* Where it began */
+} gnut_token_state_t;
+
+static unsigned char _gnut_token_fold(unsigned char ch) {
+    return (ch >= 'A' && ch <= 'Z') ? ch + ('a' - 'A') : ch;
+}
+
+static int _gnut_token_is_kw(unsigned char ch) {
+    return (ch >= 0x80) || (ch >= '0' && ch <= '9') ||
+        (ch >= 'a' && ch <= 'z') || (ch >= 'A' && ch <= 'Z');
+}
+
+static void _gnut_token_end(gnut_token_state_t *st, sxs_uint32_t end) {
+    sxs_uint32_t len;
+
+    st->in = 0;
+    len = end - st->start;
+    if (len >= GNUT_TOKEN_MIN_LEN && len <= GNUT_TOKEN_MAX_LEN &&
+        st->n < st->max) {
+        st->toks[st->n].off = st->start;
+        st->toks[st->n].len = len;
+        st->n++;
+    }
+}
+
+static void _gnut_token_byte(gnut_token_state_t *st, int is_kw,
+    sxs_uint32_t pos) {
+
+    if (is_kw) {
+        if (!st->in) {
+            st->in = 1;
+            st->start = pos;
+        }
+    } else if (st->in) {
+        _gnut_token_end(st, pos);
+    }
+}
+
+#ifdef VEC_LEN
+/* Follows the keyword boundaries in the mask of keyword bytes of the
+ * vector at 'base'. */
+static void _gnut_token_bits(gnut_token_state_t *st, sxs_uint32_t kw,
+    sxs_uint32_t base) {
+
+    sxs_uint32_t x;
+    int b;
+
+    x = st->in ? (~kw & VEC_FULL) : kw;
+    while (x != 0) {
+        b = __builtin_ctz(x);
+        if (st->in) {
+            _gnut_token_end(st, base + b);
+            x = kw & (VEC_FULL << b);
+        } else {
+            st->in = 1;
+            st->start = base + b;
+            x = ~kw & (VEC_FULL << b) & VEC_FULL;
+        }
+    }
+}
+#endif
+
+/* Returns the length of the valid UTF-8 sequence at 'p', or 0. */
+static sxs_uint32_t _gnut_token_utf8_len(const unsigned char *p,
+    sxs_uint32_t avail) {
+
+    sxs_uint32_t n, i;
+    unsigned char lo, hi;
+
+    lo = 0x80;
+    hi = 0xbf;
+    if (p[0] >= 0xc2 && p[0] <= 0xdf) {
+        n = 2;
+    } else if (p[0] >= 0xe0 && p[0] <= 0xef) {
+        n = 3;
+        lo = (p[0] == 0xe0) ? 0xa0 : 0x80;
+        hi = (p[0] == 0xed) ? 0x9f : 0xbf;
+    } else if (p[0] >= 0xf0 && p[0] <= 0xf4) {
+        n = 4;
+        lo = (p[0] == 0xf0) ? 0x90 : 0x80;
+        hi = (p[0] == 0xf4) ? 0x8f : 0xbf;
+    } else {
+        return 0;
+    }
+
+    if (avail < n || p[1] < lo || p[1] > hi) {
+        return 0;
+    }
+    for (i = 2; i < n; i++) {
+        if ((p[i] & 0xc0) != 0x80) {
+            return 0;
+        }
+    }
+    return n;
+}
+
+/* Writes what the Latin-1 character 'cp' folds to. */
+static sxs_uint32_t _gnut_token_latin1(unsigned char *out, sxs_uint32_t cp) {
+    const char *f;
+
+    if (cp < 0xc0) {
+        out[0] = ' ';
+        return 1;
+    }
+    f = _gnut_token_latin1_fold[cp - 0xc0];
+    out[0] = (unsigned char)f[0];
+    if (f[1] == '\0') {
+        return 1;
+    }
+    out[1] = (unsigned char)f[1];
+    return 2;
+}
+
+/* Folds text holding bytes beyond ASCII, a character at a time. */
+static sxs_uint32_t _gnut_token_normalize(const unsigned char *s,
+    sxs_uint32_t len, unsigned char *out) {
+
+    sxs_uint32_t i, o, n, cp;
+
+    i = 0;
+    o = 0;
+    while (i < len) {
+        if (s[i] < 0x80) {
+            out[o++] = _gnut_token_fold(s[i++]);
+            continue;
+        }
+
+        n = _gnut_token_utf8_len(s + i, len - i);
+        if (n == 2 && (cp = ((sxs_uint32_t)(s[i] & 0x1f) << 6) |
+            (s[i + 1] & 0x3f)) < 0x100) {
+            o += _gnut_token_latin1(out + o, cp);
+        } else if (n > 0) {
+            memcpy((void *)(out + o), (const void *)(s + i), n);
+            o += n;
+        } else {
+            o += _gnut_token_latin1(out + o, s[i]);
+            n = 1;
+        }
+        i += n;
+    }
+
+    return o;
+}
+
+/* Finds the keywords in already folded text from 'i' to 'end'. */
+static void _gnut_token_scan(gnut_token_state_t *st, const unsigned char *f,
+    sxs_uint32_t i, sxs_uint32_t end) {
+
+#ifdef VEC_LEN
+    vec_t x;
+    sxs_uint32_t kw;
+
+    for (; i + VEC_LEN <= end && st->n < st->max; i += VEC_LEN) {
+        x = V_LOAD(f + i);
+        kw = V_MASK(V_OR(V_IN_RANGE(x, 'a', 26), V_IN_RANGE(x, '0', 10))) |
+            V_MASK(x);
+        _gnut_token_bits(st, kw, i);
+    }
+#endif
+    for (; i < end; i++) {
+        _gnut_token_byte(st, _gnut_token_is_kw(f[i]), i);
+    }
+}
+
+sxs_uint32_t gnut_tokenize(const char *s, sxs_uint32_t len, char *folded,
+    gnut_token_t *toks, sxs_uint32_t max_tokens) {
+
+    const unsigned char *in;
+    unsigned char *out;
+    gnut_token_state_t st;
+    sxs_uint32_t i, end;
+#ifdef VEC_LEN
+    vec_t x, upper;
+    sxs_uint32_t kw;
+#endif
+
+    in = (const unsigned char *)s;
+    out = (unsigned char *)folded;
+    st.toks = toks;
+    st.max = max_tokens;
+    st.n = 0;
+    st.in = 0;
+    st.start = 0;
+
+    i = 0;
+#ifdef VEC_LEN
+    for (; i + VEC_LEN <= len && st.n < st.max; i += VEC_LEN) {
+        x = V_LOAD(in + i);
+        if (V_MASK(x) != 0) {
+            break;
+        }
+        upper = V_IN_RANGE(x, 'A', 26);
+        V_STORE(out + i, V_ADD(x, V_AND(upper, V_SET1(0x20))));
+        kw = V_MASK(V_OR(V_OR(upper, V_IN_RANGE(x, 'a', 26)),
+            V_IN_RANGE(x, '0', 10)));
+        _gnut_token_bits(&st, kw, i);
+    }
+    if (st.n == st.max) {
+        return st.n;
+    }
+#endif
+    for (; i < len && in[i] < 0x80; i++) {
+        out[i] = _gnut_token_fold(in[i]);
+        _gnut_token_byte(&st, _gnut_token_is_kw(in[i]), i);
+    }
+
+    end = i;
+    if (i < len) {
+        end = i + _gnut_token_normalize(in + i, len - i, out + i);
+        _gnut_token_scan(&st, out, i, end);
+    }
+    if (st.in) {
+        _gnut_token_end(&st, end);
+    }
+
+    return st.n;
+}
@@ -0,0 +1,89 @@
+/*
+ * Copyright 2006-2007 Andrew De Ponte
+ *
+ * This file is part of lib_gnut.
+ *
+ * lib_gnut is the intellectual property of Andrew De Ponte; any
+ * distribution and/or modification and/or reproductions of any portion
+ * of lib_gnut MUST be approved by Andrew De Ponte.
+ *
+ * lib_gnut is distributed WITHOUT ANY WARRANTY; without even the
+ * implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE.
+ */
+
+/**
+ * @file gnut_token.h
+ * @brief This is a specifications file for the keyword tokenizer.
+ *
+ * The gnut_token.h file is a specifications file that declares the
+ * gnut_tokenize() function, which splits search criteria and file names
+ * into keywords the same way everywhere they are compared. The text is
+ * folded into a buffer of the caller's, and the keywords are returned
+ * as spans of it, so tokenizing allocates nothing.
+ *
+ * A keyword is a run of ASCII letters and digits and of characters
+ * beyond Latin-1. ASCII letters are folded to lower case, and the
+ * letters of Latin-1 lose their case and accents, so that "Café" and
+ * "CAFE" give the same keyword; the other Latin-1 characters separate
+ * keywords. Text is read as UTF-8, and bytes which are not valid UTF-8
+ * are read as Latin-1. Text that is all ASCII is folded and split many
+ * bytes at a time where the compiler targets SSE2 or AVX2.
+ */
+
+#ifndef GNUT_TOKEN_H
+#define GNUT_TOKEN_H
+
+#include <sxs/sxs.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+#include "gnut_export.h"
+#include "gnut_types.h"
+#include "gnut_error.h"
+
+#define GNUT_TOKEN_MIN_LEN 2 /**< Shorter keywords are dropped */
+#define GNUT_TOKEN_MAX_LEN 64 /**< Longer keywords are dropped */
+
+/** The size of the folding buffer needed for 'len' bytes of text */
+#define GNUT_TOKEN_FOLD_LEN(len) (2 * (len))
+
+/** The most keywords 'len' bytes of text can give */
+#define GNUT_TOKEN_MAX_TOKENS(len) \
+    (GNUT_TOKEN_FOLD_LEN(len) / (GNUT_TOKEN_MIN_LEN + 1) + 1)
+
+/**
+ * A Keyword
+ *
+ * The gnut_token_t is a type which represents a keyword as the offset
+ * and length of its bytes in the folding buffer.
+ */
+typedef struct GNUT_EXPORT gnut_token {
+    sxs_uint32_t off;
+    sxs_uint32_t len;
+} gnut_token_t;
+
+/**
+ * Split Text into Keywords
+ *
+ * The gnut_tokenize() function folds 'len' bytes of 's' into 'folded'
+ * and stores the keywords found in it, in order, until 'max_tokens' are
+ * found. Keywords shorter than GNUT_TOKEN_MIN_LEN or longer than
+ * GNUT_TOKEN_MAX_LEN are dropped.
+ * @param s Pointer to the text.
+ * @param len The length of the text.
+ * @param folded Pointer to a buffer of GNUT_TOKEN_FOLD_LEN(len) bytes.
+ * @param toks Pointer to an array to store the keywords in.
+ * @param max_tokens The size of the array.
+ * @return The number of keywords stored.
+ */
+GNUT_EXPORT sxs_uint32_t gnut_tokenize(const char *s, sxs_uint32_t len,
+    char *folded, gnut_token_t *toks, sxs_uint32_t max_tokens);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* GNUT_TOKEN_H */
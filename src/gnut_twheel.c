@@ -0,0 +1,181 @@
+/*
+ * Copyright 2006-2007 Andrew De Ponte
+ *
+ * This file is part of lib_gnut.
+ *
+ * lib_gnut is the intellectual property of Andrew De Ponte; any
+ * distribution and/or modification and/or reproductions of any portion
+ * of lib_gnut MUST be approved by Andrew De Ponte.
+ *
+ * lib_gnut is distributed WITHOUT ANY WARRANTY; without even the
+ * implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE.
+ */
+
+/**
+ * @file gnut_twheel.c
+ * @brief This is an implementation file for timer wheels.
+ *
+ * The gnut_twheel.c file is an implementation file that defines the
+ * gnut_twheel_t type's associated functions. Expired timers are moved
+ * off their slot onto a list of their own before any is fired, so that
+ * a callback may start or stop any timer, itself included.
+ */
+
+#include <stdlib.h> /* malloc(), free() */
+#include <string.h> /* memset() */
+
+#include "gnut_twheel.h"
+
+static void _gnut_twheel_unlink(gnut_twheel_timer_t *t) {
+    t->prev->next = t->next;
+    t->next->prev = t->prev;
+    t->next = NULL;
+    t->prev = NULL;
+}
+
+static void _gnut_twheel_link(gnut_twheel_timer_t *head,
+    gnut_twheel_timer_t *t) {
+
+    t->next = head;
+    t->prev = head->prev;
+    head->prev->next = t;
+    head->prev = t;
+}
+
+/* Moves the timers of the slot of 'tick' which expire by 'upto' onto
+ * the list 'due'. */
+static void _gnut_twheel_collect(gnut_twheel_t *w, gnut_uint64_t tick,
+    gnut_uint64_t upto, gnut_twheel_timer_t *due) {
+
+    gnut_twheel_timer_t *head, *t, *next;
+
+    head = &w->slots[tick & w->mask];
+    for (t = head->next; t != head; t = next) {
+        next = t->next;
+        if (t->when <= upto) {
+            _gnut_twheel_unlink(t);
+            _gnut_twheel_link(due, t);
+        }
+    }
+}
+
+static sxs_uint32_t _gnut_twheel_fire(gnut_twheel_t *w,
+    gnut_twheel_timer_t *due) {
+
+    gnut_twheel_timer_t *t;
+    sxs_uint32_t num;
+
+    num = 0;
+    while (due->next != due) {
+        t = due->next;
+        _gnut_twheel_unlink(t);
+        w->num_armed--;
+        num++;
+        t->cb(w, t, t->arg);
+    }
+    return num;
+}
+
+gnut_error_t gnut_twheel_init(gnut_twheel_t *w, gnut_uint64_t tick,
+    sxs_uint32_t num_slots, gnut_uint64_t now) {
+
+    sxs_uint32_t len, i;
+
+    memset((void *)w, 0, sizeof(gnut_twheel_t));
+    if (tick == 0) {
+        tick = GNUT_TWHEEL_DEF_TICK;
+    }
+    if (num_slots == 0) {
+        num_slots = GNUT_TWHEEL_DEF_SLOTS;
+    }
+    len = 1;
+    while (len < num_slots && len < 0x80000000U) {
+        len <<= 1;
+    }
+    w->slots = (gnut_twheel_timer_t *)malloc(len *
+        sizeof(gnut_twheel_timer_t));
+    if (w->slots == NULL) {
+        return GNUT_ENOMEM;
+    }
+    for (i = 0; i < len; i++) {
+        w->slots[i].next = &w->slots[i];
+        w->slots[i].prev = &w->slots[i];
+    }
+    w->mask = len - 1;
+    w->tick = tick;
+    w->now = now;
+    w->cur = now / tick;
+    return GNUT_SUCCESS;
+}
+
+void gnut_twheel_destroy(gnut_twheel_t *w) {
+    free(w->slots);
+    w->slots = NULL;
+    w->num_armed = 0;
+}
+
+void gnut_twheel_timer_init(gnut_twheel_timer_t *t) {
+    memset((void *)t, 0, sizeof(gnut_twheel_timer_t));
+}
+
+void gnut_twheel_start(gnut_twheel_t *w, gnut_twheel_timer_t *t,
+    gnut_uint64_t delay, gnut_twheel_cb_t cb, void *arg) {
+
+    gnut_uint64_t when;
+
+    if (t->next != NULL) {
+        _gnut_twheel_unlink(t);
+        w->num_armed--;
+    }
+    /* Rounded up, so that it never fires early. */
+    when = (w->now + delay + w->tick - 1) / w->tick;
+    if (when < w->cur) {
+        when = w->cur;
+    }
+    t->when = when;
+    t->cb = cb;
+    t->arg = arg;
+    _gnut_twheel_link(&w->slots[when & w->mask], t);
+    w->num_armed++;
+}
+
+void gnut_twheel_stop(gnut_twheel_t *w, gnut_twheel_timer_t *t) {
+    if (t->next != NULL) {
+        _gnut_twheel_unlink(t);
+        w->num_armed--;
+    }
+}
+
+int gnut_twheel_armed(const gnut_twheel_timer_t *t) {
+    return t->next != NULL;
+}
+
+sxs_uint32_t gnut_twheel_advance(gnut_twheel_t *w, gnut_uint64_t now) {
+    gnut_twheel_timer_t due;
+    gnut_uint64_t target, tick;
+    sxs_uint32_t num;
+
+    if (now > w->now) {
+        w->now = now;
+    }
+    target = w->now / w->tick;
+    num = 0;
+    due.next = &due;
+    due.prev = &due;
+
+    if (target >= w->cur && target - w->cur > w->mask) {
+        for (tick = 0; tick <= w->mask; tick++) {
+            _gnut_twheel_collect(w, tick, target, &due);
+        }
+        w->cur = target + 1;
+        return _gnut_twheel_fire(w, &due);
+    }
+
+    while (w->cur <= target) {
+        tick = w->cur++;
+        _gnut_twheel_collect(w, tick, tick, &due);
+        num += _gnut_twheel_fire(w, &due);
+    }
+    return num;
+}
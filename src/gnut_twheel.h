@@ -0,0 +1,174 @@
+/*
+ * Copyright 2006-2007 Andrew De Ponte
+ *
+ * This file is part of lib_gnut.
+ *
+ * lib_gnut is the intellectual property of Andrew De Ponte; any
+ * distribution and/or modification and/or reproductions of any portion
+ * of lib_gnut MUST be approved by Andrew De Ponte.
+ *
+ * lib_gnut is distributed WITHOUT ANY WARRANTY; without even the
+ * implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE.
+ */
+
+/**
+ * @file gnut_twheel.h
+ * @brief This is a specifications file for timer wheels.
+ *
+ * The gnut_twheel.h file is a specifications file that declares the
+ * gnut_twheel_t type and its associated functions. A timer wheel keeps
+ * timers in a ring of slots, one per tick of time, each a list of the
+ * timers expiring in it or a whole number of turns later. Starting and
+ * stopping a timer take constant time whatever the number armed, where
+ * the event loop's heap takes logarithmic time, so a wheel suits many
+ * thousands of coarse timers such as those of searches in progress.
+ *
+ * Timers fire no earlier than asked and up to a tick late. The wheel
+ * has no clock of its own: its owner advances it to the current time,
+ * real or simulated, and expired timers fire from there.
+ */
+
+#ifndef GNUT_TWHEEL_H
+#define GNUT_TWHEEL_H
+
+#include <sxs/sxs.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+#include "gnut_export.h"
+#include "gnut_types.h"
+#include "gnut_error.h"
+
+#define GNUT_TWHEEL_DEF_TICK 100000 /**< Default tick, 100 ms in us */
+#define GNUT_TWHEEL_DEF_SLOTS 1024 /**< Default slots, a power of two */
+
+typedef struct gnut_twheel gnut_twheel_t;
+typedef struct gnut_twheel_timer gnut_twheel_timer_t;
+
+/**
+ * The type of function called when a timer expires. The timer is no
+ * longer armed and may be started again or freed from it.
+ */
+typedef void (*gnut_twheel_cb_t)(gnut_twheel_t *w, gnut_twheel_timer_t *t,
+    void *arg);
+
+/**
+ * A Timer Wheel Timer
+ *
+ * The gnut_twheel_timer_t is a type which represents a one-shot timer
+ * of a wheel. It is embedded in the caller's own structures so that
+ * arming it never allocates.
+ */
+struct GNUT_EXPORT gnut_twheel_timer {
+    gnut_twheel_timer_t *next;  /* NULL if not armed */
+    gnut_twheel_timer_t *prev;
+    gnut_uint64_t when;         /* Tick it expires at */
+    gnut_twheel_cb_t cb;
+    void *arg;
+};
+
+/**
+ * A Timer Wheel
+ *
+ * The gnut_twheel_t is a type which represents a timer wheel. Each slot
+ * is the head of a circular list of timers.
+ */
+struct GNUT_EXPORT gnut_twheel {
+    gnut_twheel_timer_t *slots;
+    sxs_uint32_t mask;          /* Slots less one */
+    gnut_uint64_t tick;         /* Length of a tick in microseconds */
+    gnut_uint64_t cur;          /* Next tick to expire timers of */
+    gnut_uint64_t now;          /* Time it was last advanced to */
+    sxs_uint32_t num_armed;
+};
+
+/**
+ * Initialize a Timer Wheel
+ *
+ * @param w Pointer to the wheel to initialize.
+ * @param tick The length of a tick in microseconds, or 0 for the
+ * default.
+ * @param num_slots The number of slots, rounded up to a power of two,
+ * or 0 for the default.
+ * @param now The current time in microseconds.
+ * @return A value representing an error or success.
+ * @retval GNUT_SUCCESS Successfully initialized the wheel.
+ * @retval GNUT_ENOMEM Failed to allocate memory.
+ */
+GNUT_EXPORT gnut_error_t gnut_twheel_init(gnut_twheel_t *w,
+    gnut_uint64_t tick, sxs_uint32_t num_slots, gnut_uint64_t now);
+
+/**
+ * Destroy a Timer Wheel
+ *
+ * The gnut_twheel_destroy() function frees the slots of the wheel. The
+ * timers still armed are forgotten without firing.
+ * @param w Pointer to the wheel.
+ */
+GNUT_EXPORT void gnut_twheel_destroy(gnut_twheel_t *w);
+
+/**
+ * Initialize a Timer Wheel Timer
+ *
+ * The gnut_twheel_timer_init() function marks the timer 't' as not
+ * armed. It must be called once before the timer is first used.
+ * @param t Pointer to the timer.
+ */
+GNUT_EXPORT void gnut_twheel_timer_init(gnut_twheel_timer_t *t);
+
+/**
+ * Start a Timer Wheel Timer
+ *
+ * The gnut_twheel_start() function arms the timer 't' to call 'cb'
+ * once 'delay' microseconds from the time the wheel was last advanced
+ * to. Starting a timer that is armed moves it.
+ * @param w Pointer to the wheel.
+ * @param t Pointer to the timer.
+ * @param delay The delay in microseconds.
+ * @param cb The function to call when the timer expires.
+ * @param arg Passed to 'cb'.
+ */
+GNUT_EXPORT void gnut_twheel_start(gnut_twheel_t *w, gnut_twheel_timer_t *t,
+    gnut_uint64_t delay, gnut_twheel_cb_t cb, void *arg);
+
+/**
+ * Stop a Timer Wheel Timer
+ *
+ * The gnut_twheel_stop() function disarms the timer 't' if it is
+ * armed.
+ * @param w Pointer to the wheel.
+ * @param t Pointer to the timer.
+ */
+GNUT_EXPORT void gnut_twheel_stop(gnut_twheel_t *w, gnut_twheel_timer_t *t);
+
+/**
+ * Check Whether a Timer Wheel Timer is Armed
+ *
+ * @param t Pointer to the timer.
+ * @return Non-zero if the timer is armed, 0 otherwise.
+ */
+GNUT_EXPORT int gnut_twheel_armed(const gnut_twheel_timer_t *t);
+
+/**
+ * Advance a Timer Wheel
+ *
+ * The gnut_twheel_advance() function moves the wheel to 'now', firing
+ * every timer which expires by then, tick by tick. When more than a
+ * turn of the wheel has passed, each slot is swept once instead, and
+ * timers of different ticks may fire out of order.
+ * @param w Pointer to the wheel.
+ * @param now The current time in microseconds, which must not be
+ * earlier than the last.
+ * @return The number of timers fired.
+ */
+GNUT_EXPORT sxs_uint32_t gnut_twheel_advance(gnut_twheel_t *w,
+    gnut_uint64_t now);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* GNUT_TWHEEL_H */
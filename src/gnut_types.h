@@ -34,4 +34,28 @@
  */
 typedef sxs_int32_t gnut_error_t;
 
+/**
+ * An unsigned 64 bit integer.
+ *
+ * The gnut_uint64_t is a cross-platform type which represents an
+ * unsigned 64 bit integer, which lib_sxs does not provide.
+ */
+#ifndef WIN32
+typedef uint64_t gnut_uint64_t;
+#else
+typedef unsigned __int64 gnut_uint64_t;
+#endif
+
+/**
+ * A signed 64 bit integer.
+ *
+ * The gnut_int64_t is a cross-platform type which represents a signed
+ * 64 bit integer, which lib_sxs does not provide.
+ */
+#ifndef WIN32
+typedef int64_t gnut_int64_t;
+#else
+typedef __int64 gnut_int64_t;
+#endif
+
 #endif /* GNUT_TYPES_H */
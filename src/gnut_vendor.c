@@ -0,0 +1,237 @@
+/*
+ * Copyright 2006-2007 Andrew De Ponte
+ *
+ * This file is part of lib_gnut.
+ *
+ * lib_gnut is the intellectual property of Andrew De Ponte; any
+ * distribution and/or modification and/or reproductions of any portion
+ * of lib_gnut MUST be approved by Andrew De Ponte.
+ *
+ * lib_gnut is distributed WITHOUT ANY WARRANTY; without even the
+ * implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE.
+ */
+
+/**
+ * @file gnut_vendor.c
+ * @brief This is an implementation file for Vendor Messages.
+ *
+ * The gnut_vendor.c file is an implementation file that defines the
+ * gnut_vmsg_t type's associated functions.
+ */
+
+#include <string.h> /* memcmp(), memcpy() */
+
+#include "gnut_vendor.h"
+
+#define VENDOR(a, b, c, d) (((sxs_uint32_t)(a) << 24) | \
+    ((sxs_uint32_t)(b) << 16) | ((sxs_uint32_t)(c) << 8) | (sxs_uint32_t)(d))
+#define SUPPORTED_ENT_LEN 8     /* Vendor code, selector and version */
+#define CAPABILITY_ENT_LEN 6    /* Name and version */
+
+/* The known Vendor Messages, in GNUT_VMSG_K_* order, with the highest
+ * version understood and the least data each must carry. */
+static const struct {
+    sxs_uint32_t vendor;
+    sxs_uint16_t selector;
+    sxs_uint16_t version;
+    sxs_uint16_t min_len;
+} known_vmsgs[GNUT_VMSG_NUM_K] = {
+    { VENDOR(0, 0, 0, 0), 0, 0, 2 },
+    { VENDOR(0, 0, 0, 0), 10, 1, 2 },
+    { VENDOR('B', 'E', 'A', 'R'), 4, 1, 1 },
+    { VENDOR('B', 'E', 'A', 'R'), 7, 1, 2 },
+    { VENDOR('B', 'E', 'A', 'R'), 11, 1, 0 },
+    { VENDOR('B', 'E', 'A', 'R'), 12, 1, 2 },
+    { VENDOR('G', 'T', 'K', 'G'), 7, 2, 16 },
+    { VENDOR('L', 'I', 'M', 'E'), 11, 2, 1 },
+    { VENDOR('L', 'I', 'M', 'E'), 12, 2, 1 },
+    { VENDOR('L', 'I', 'M', 'E'), 21, 2, 0 },
+    { VENDOR('L', 'I', 'M', 'E'), 22, 2, 6 }
+};
+
+static sxs_uint32_t _gnut_vmsg_vendor(const unsigned char *p) {
+    return VENDOR(p[0], p[1], p[2], p[3]);
+}
+
+static void _gnut_vmsg_put_vendor(unsigned char *p, sxs_uint32_t vendor) {
+    p[0] = (unsigned char)(vendor >> 24);
+    p[1] = (unsigned char)((vendor >> 16) & 0xff);
+    p[2] = (unsigned char)((vendor >> 8) & 0xff);
+    p[3] = (unsigned char)(vendor & 0xff);
+}
+
+/* The table is short enough that a scan comparing integers beats
+ * anything cleverer. */
+static int _gnut_vmsg_lookup(sxs_uint32_t vendor, sxs_uint16_t selector) {
+    int i;
+
+    for (i = 0; i < GNUT_VMSG_NUM_K; i++) {
+        if (known_vmsgs[i].selector == selector &&
+            known_vmsgs[i].vendor == vendor) {
+            return i;
+        }
+    }
+    return GNUT_VMSG_K_UNKNOWN;
+}
+
+gnut_error_t gnut_vmsg_parse(gnut_vmsg_t *vm, const unsigned char *pl,
+    sxs_uint32_t pl_len) {
+
+    if (pl_len < GNUT_VMSG_HDR_LEN) {
+        return GNUT_EMALFORMED;
+    }
+    memcpy((void *)vm->vendor, (const void *)pl, 4);
+    vm->selector = (sxs_uint16_t)(pl[4] | (pl[5] << 8));
+    vm->version = (sxs_uint16_t)(pl[6] | (pl[7] << 8));
+    vm->kind = _gnut_vmsg_lookup(_gnut_vmsg_vendor(pl), vm->selector);
+    if (vm->kind != GNUT_VMSG_K_UNKNOWN &&
+        vm->version > known_vmsgs[vm->kind].version) {
+        vm->kind = GNUT_VMSG_K_UNKNOWN;
+    }
+    vm->data = pl + GNUT_VMSG_HDR_LEN;
+    vm->data_len = pl_len - GNUT_VMSG_HDR_LEN;
+    return GNUT_SUCCESS;
+}
+
+gnut_error_t gnut_vmsg_build(const char *vendor, sxs_uint16_t selector,
+    sxs_uint16_t version, const unsigned char *data, sxs_uint32_t data_len,
+    unsigned char *buf, sxs_uint32_t len, sxs_uint32_t *p_pl_len) {
+
+    if (len < GNUT_VMSG_HDR_LEN || len - GNUT_VMSG_HDR_LEN < data_len) {
+        return GNUT_EBUF_TOO_SMALL;
+    }
+    memcpy((void *)buf, (const void *)vendor, 4);
+    buf[4] = (unsigned char)(selector & 0xff);
+    buf[5] = (unsigned char)(selector >> 8);
+    buf[6] = (unsigned char)(version & 0xff);
+    buf[7] = (unsigned char)(version >> 8);
+    if (data_len > 0) {
+        memcpy((void *)(buf + GNUT_VMSG_HDR_LEN), (const void *)data,
+            data_len);
+    }
+    *p_pl_len = GNUT_VMSG_HDR_LEN + data_len;
+    return GNUT_SUCCESS;
+}
+
+gnut_error_t gnut_vmsg_build_known(int kind, const unsigned char *data,
+    sxs_uint32_t data_len, unsigned char *buf, sxs_uint32_t len,
+    sxs_uint32_t *p_pl_len) {
+
+    unsigned char vendor[4];
+
+    if (kind < 0 || kind >= GNUT_VMSG_NUM_K) {
+        return GNUT_ENOT_FOUND;
+    }
+    if (data_len < known_vmsgs[kind].min_len) {
+        return GNUT_EMALFORMED;
+    }
+    _gnut_vmsg_put_vendor(vendor, known_vmsgs[kind].vendor);
+    return gnut_vmsg_build((const char *)vendor, known_vmsgs[kind].selector,
+        known_vmsgs[kind].version, data, data_len, buf, len, p_pl_len);
+}
+
+gnut_error_t gnut_vmsg_build_supported(const gnut_vmsg_cb_t *handlers,
+    unsigned char *buf, sxs_uint32_t len, sxs_uint32_t *p_pl_len) {
+
+    unsigned char *p;
+    sxs_uint32_t num;
+    int i;
+
+    num = 0;
+    for (i = 0; i < GNUT_VMSG_NUM_K; i++) {
+        if (handlers[i] != NULL) {
+            num++;
+        }
+    }
+    if (len < GNUT_VMSG_HDR_LEN + 2 + (num * SUPPORTED_ENT_LEN)) {
+        return GNUT_EBUF_TOO_SMALL;
+    }
+
+    _gnut_vmsg_put_vendor(buf, known_vmsgs[GNUT_VMSG_K_SUPPORTED].vendor);
+    buf[4] = (unsigned char)known_vmsgs[GNUT_VMSG_K_SUPPORTED].selector;
+    buf[5] = 0;
+    buf[6] = (unsigned char)known_vmsgs[GNUT_VMSG_K_SUPPORTED].version;
+    buf[7] = 0;
+    buf[8] = (unsigned char)(num & 0xff);
+    buf[9] = (unsigned char)(num >> 8);
+    p = buf + GNUT_VMSG_HDR_LEN + 2;
+    for (i = 0; i < GNUT_VMSG_NUM_K; i++) {
+        if (handlers[i] != NULL) {
+            _gnut_vmsg_put_vendor(p, known_vmsgs[i].vendor);
+            p[4] = (unsigned char)(known_vmsgs[i].selector & 0xff);
+            p[5] = (unsigned char)(known_vmsgs[i].selector >> 8);
+            p[6] = (unsigned char)(known_vmsgs[i].version & 0xff);
+            p[7] = (unsigned char)(known_vmsgs[i].version >> 8);
+            p += SUPPORTED_ENT_LEN;
+        }
+    }
+    *p_pl_len = (sxs_uint32_t)(p - buf);
+    return GNUT_SUCCESS;
+}
+
+int gnut_vmsg_supported_version(const gnut_vmsg_t *vm, int kind) {
+    const unsigned char *p;
+    sxs_uint32_t num, i;
+
+    if (kind < 0 || kind >= GNUT_VMSG_NUM_K || vm->data_len < 2) {
+        return -1;
+    }
+    num = vm->data[0] | (vm->data[1] << 8);
+    if (num > (vm->data_len - 2) / SUPPORTED_ENT_LEN) {
+        num = (vm->data_len - 2) / SUPPORTED_ENT_LEN;
+    }
+    p = vm->data + 2;
+    for (i = 0; i < num; i++, p += SUPPORTED_ENT_LEN) {
+        if (_gnut_vmsg_vendor(p) == known_vmsgs[kind].vendor &&
+            (p[4] | (p[5] << 8)) == known_vmsgs[kind].selector) {
+            return p[6] | (p[7] << 8);
+        }
+    }
+    return -1;
+}
+
+int gnut_vmsg_capability_version(const gnut_vmsg_t *vm, const char *name) {
+    const unsigned char *p;
+    sxs_uint32_t num, i;
+
+    if (vm->data_len < 2) {
+        return -1;
+    }
+    num = vm->data[0] | (vm->data[1] << 8);
+    if (num > (vm->data_len - 2) / CAPABILITY_ENT_LEN) {
+        num = (vm->data_len - 2) / CAPABILITY_ENT_LEN;
+    }
+    p = vm->data + 2;
+    for (i = 0; i < num; i++, p += CAPABILITY_ENT_LEN) {
+        if (memcmp(p, name, 4) == 0) {
+            return p[4] | (p[5] << 8);
+        }
+    }
+    return -1;
+}
+
+gnut_error_t gnut_vmsg_dispatch(const gnut_vmsg_cb_t *handlers,
+    sxs_uint32_t from, const gnut_msg_hdr_t *hdr,
+    const unsigned char *payload, void *arg) {
+
+    gnut_vmsg_t vm;
+
+    if (gnut_vmsg_parse(&vm, payload, hdr->pl_len) != GNUT_SUCCESS) {
+        return GNUT_EMALFORMED;
+    }
+    if (vm.kind == GNUT_VMSG_K_UNKNOWN || handlers[vm.kind] == NULL) {
+        return GNUT_ENOT_FOUND;
+    }
+    if (vm.data_len < known_vmsgs[vm.kind].min_len) {
+        return GNUT_EMALFORMED;
+    }
+    handlers[vm.kind](from, hdr, &vm, arg);
+    return GNUT_SUCCESS;
+}
+
+int gnut_vmsg_is(const gnut_vmsg_t *vm, const char *vendor,
+    sxs_uint16_t selector) {
+
+    return memcmp(vm->vendor, vendor, 4) == 0 && vm->selector == selector;
+}
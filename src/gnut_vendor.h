@@ -0,0 +1,230 @@
+/*
+ * Copyright 2006-2007 Andrew De Ponte
+ *
+ * This file is part of lib_gnut.
+ *
+ * lib_gnut is the intellectual property of Andrew De Ponte; any
+ * distribution and/or modification and/or reproductions of any portion
+ * of lib_gnut MUST be approved by Andrew De Ponte.
+ *
+ * lib_gnut is distributed WITHOUT ANY WARRANTY; without even the
+ * implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE.
+ */
+
+/**
+ * @file gnut_vendor.h
+ * @brief This is a specifications file for Vendor Messages.
+ *
+ * The gnut_vendor.h file is a specifications file that declares the
+ * gnut_vmsg_t type and its associated functions. A Vendor Message
+ * payload begins with a four character vendor code, a two byte
+ * selector and a two byte version, both little-endian, followed by
+ * data whose meaning they name.
+ *
+ * The Vendor Messages this library knows are listed in one table built
+ * at compile time, each under a GNUT_VMSG_K_* index, with the highest
+ * version of it understood and the least data it must carry. An owner
+ * handles those it wants with an array of GNUT_VMSG_NUM_K callbacks in
+ * the same order, which gnut_vmsg_dispatch() calls; any other Vendor
+ * Message is passed over without allocating anything.
+ */
+
+#ifndef GNUT_VENDOR_H
+#define GNUT_VENDOR_H
+
+#include <sxs/sxs.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+#include "gnut_export.h"
+#include "gnut_types.h"
+#include "gnut_error.h"
+#include "gnut_msgs.h"
+
+#define GNUT_VMSG_HDR_LEN 8 /**< Vendor code, selector and version */
+#define GNUT_VMSG_LIME "LIME" /**< Vendor code of the messages below */
+#define GNUT_VMSG_LIME_ACK 11 /**< Selector, results wanted out of band */
+#define GNUT_VMSG_REPLY_NUMBER 12 /**< Selector, results held out of band */
+#define GNUT_VMSG_OOB_VERSION 2 /**< Version of both messages */
+#define GNUT_VMSG_UNSOLICITED 0x01 /**< Reply Number flag, takes any UDP */
+
+#define GNUT_VMSG_K_UNKNOWN (-1) /**< Kind of Vendor Messages not known */
+#define GNUT_VMSG_K_SUPPORTED 0 /**< Messages Supported, NULL 0 v0 */
+#define GNUT_VMSG_K_CAPABILITIES 1 /**< Capabilities, NULL 10 v1 */
+#define GNUT_VMSG_K_HOPS_FLOW 2 /**< Hops Flow, BEAR 4 v1 */
+#define GNUT_VMSG_K_TCP_CONNECT_BACK 3 /**< TCP Connect Back, BEAR 7 v1 */
+#define GNUT_VMSG_K_QUERY_STATUS_REQ 4 /**< Query Status Request, BEAR 11 */
+#define GNUT_VMSG_K_QUERY_STATUS 5 /**< Query Status Response, BEAR 12 v1 */
+#define GNUT_VMSG_K_UDP_CONNECT_BACK 6 /**< UDP Connect Back, GTKG 7 v2 */
+#define GNUT_VMSG_K_LIME_ACK 7 /**< LIME ACK, LIME 11 v2 */
+#define GNUT_VMSG_K_REPLY_NUMBER 8 /**< Reply Number, LIME 12 v2 */
+#define GNUT_VMSG_K_PUSH_PROXY_REQ 9 /**< Push Proxy Request, LIME 21 v2 */
+#define GNUT_VMSG_K_PUSH_PROXY_ACK 10 /**< Push Proxy ACK, LIME 22 v2 */
+#define GNUT_VMSG_NUM_K 11 /**< Number of known Vendor Messages */
+
+/**
+ * A Vendor Message Payload
+ *
+ * The gnut_vmsg_t is a type which represents a parsed Vendor Message
+ * payload. The vendor code is not null terminated.
+ */
+typedef struct GNUT_EXPORT gnut_vmsg {
+    char vendor[4];
+    sxs_uint16_t selector;
+    sxs_uint16_t version;
+    int kind;                   /* GNUT_VMSG_K_*, or GNUT_VMSG_K_UNKNOWN */
+    const unsigned char *data;
+    sxs_uint32_t data_len;
+} gnut_vmsg_t;
+
+/**
+ * A Vendor Message Callback
+ *
+ * The gnut_vmsg_cb_t is the type of function called with a known
+ * Vendor Message received on connection 'from', whose data is at least
+ * as long as its kind needs. The message is only valid during the call.
+ */
+typedef void (*gnut_vmsg_cb_t)(sxs_uint32_t from, const gnut_msg_hdr_t *hdr,
+    const gnut_vmsg_t *vm, void *arg);
+
+/**
+ * Parse a Vendor Message Payload
+ *
+ * The gnut_vmsg_parse() function splits the payload 'pl' and looks up
+ * which known Vendor Message it is, if any. A newer version of a known
+ * message than is understood is of kind GNUT_VMSG_K_UNKNOWN.
+ * @param vm Pointer to the Vendor Message to fill in.
+ * @param pl Pointer to the payload.
+ * @param pl_len The length of the payload.
+ * @return A value representing an error or success.
+ * @retval GNUT_SUCCESS Successfully parsed the payload.
+ * @retval GNUT_EMALFORMED The payload is too short.
+ */
+GNUT_EXPORT gnut_error_t gnut_vmsg_parse(gnut_vmsg_t *vm,
+    const unsigned char *pl, sxs_uint32_t pl_len);
+
+/**
+ * Build a Vendor Message Payload
+ *
+ * @param vendor Pointer to the four character vendor code.
+ * @param selector The selector.
+ * @param version The version.
+ * @param data Pointer to the data.
+ * @param data_len The length of the data.
+ * @param buf Pointer to the buffer to write to.
+ * @param len The size of the buffer.
+ * @param p_pl_len Pointer to store the length of the payload in.
+ * @return A value representing an error or success.
+ * @retval GNUT_SUCCESS Successfully built the payload.
+ * @retval GNUT_EBUF_TOO_SMALL The buffer is too small.
+ */
+GNUT_EXPORT gnut_error_t gnut_vmsg_build(const char *vendor,
+    sxs_uint16_t selector, sxs_uint16_t version, const unsigned char *data,
+    sxs_uint32_t data_len, unsigned char *buf, sxs_uint32_t len,
+    sxs_uint32_t *p_pl_len);
+
+/**
+ * Build a Known Vendor Message Payload
+ *
+ * The gnut_vmsg_build_known() function builds the payload of the known
+ * Vendor Message 'kind', at the highest version understood, carrying
+ * 'data'.
+ * @param kind One of the GNUT_VMSG_K_* values.
+ * @param data Pointer to the data.
+ * @param data_len The length of the data.
+ * @param buf Pointer to the buffer to write to.
+ * @param len The size of the buffer.
+ * @param p_pl_len Pointer to store the length of the payload in.
+ * @return A value representing an error or success.
+ * @retval GNUT_SUCCESS Successfully built the payload.
+ * @retval GNUT_EBUF_TOO_SMALL The buffer is too small.
+ * @retval GNUT_ENOT_FOUND The kind is not known.
+ * @retval GNUT_EMALFORMED The data is too short for the kind.
+ */
+GNUT_EXPORT gnut_error_t gnut_vmsg_build_known(int kind,
+    const unsigned char *data, sxs_uint32_t data_len, unsigned char *buf,
+    sxs_uint32_t len, sxs_uint32_t *p_pl_len);
+
+/**
+ * Build a Messages Supported Payload
+ *
+ * The gnut_vmsg_build_supported() function builds the payload of a
+ * Messages Supported Vendor Message listing each known Vendor Message
+ * 'handlers' has a callback for.
+ * @param handlers The GNUT_VMSG_NUM_K callbacks, NULL where not handled.
+ * @param buf Pointer to the buffer to write to.
+ * @param len The size of the buffer.
+ * @param p_pl_len Pointer to store the length of the payload in.
+ * @return A value representing an error or success.
+ * @retval GNUT_SUCCESS Successfully built the payload.
+ * @retval GNUT_EBUF_TOO_SMALL The buffer is too small.
+ */
+GNUT_EXPORT gnut_error_t gnut_vmsg_build_supported(
+    const gnut_vmsg_cb_t *handlers, unsigned char *buf, sxs_uint32_t len,
+    sxs_uint32_t *p_pl_len);
+
+/**
+ * Get the Version of a Vendor Message a Peer Supports
+ *
+ * The gnut_vmsg_supported_version() function finds the known Vendor
+ * Message 'kind' in the Messages Supported Vendor Message 'vm'.
+ * @param vm Pointer to a parsed Messages Supported Vendor Message.
+ * @param kind One of the GNUT_VMSG_K_* values.
+ * @return The version listed, or -1 if the message is not listed.
+ */
+GNUT_EXPORT int gnut_vmsg_supported_version(const gnut_vmsg_t *vm,
+    int kind);
+
+/**
+ * Get the Version of a Capability a Peer Has
+ *
+ * The gnut_vmsg_capability_version() function finds the capability of
+ * four character name 'name' in the Capabilities Vendor Message 'vm'.
+ * @param vm Pointer to a parsed Capabilities Vendor Message.
+ * @param name Pointer to the four character name.
+ * @return The version listed, or -1 if the capability is not listed.
+ */
+GNUT_EXPORT int gnut_vmsg_capability_version(const gnut_vmsg_t *vm,
+    const char *name);
+
+/**
+ * Dispatch a Vendor Message
+ *
+ * The gnut_vmsg_dispatch() function parses the payload of the Vendor
+ * Message 'hdr' and 'payload' received on connection 'from' and calls
+ * the callback of its kind in 'handlers'. A message of a kind not known
+ * or not handled is passed over.
+ * @param handlers The GNUT_VMSG_NUM_K callbacks, NULL where not handled.
+ * @param from The connection id the message arrived on.
+ * @param hdr Pointer to the header of the message.
+ * @param payload Pointer to the hdr->pl_len bytes of payload.
+ * @param arg Passed to the callback.
+ * @return A value representing an error or success.
+ * @retval GNUT_SUCCESS Successfully handled the message.
+ * @retval GNUT_ENOT_FOUND The message is not known or not handled.
+ * @retval GNUT_EMALFORMED The payload is too short for its kind.
+ */
+GNUT_EXPORT gnut_error_t gnut_vmsg_dispatch(const gnut_vmsg_cb_t *handlers,
+    sxs_uint32_t from, const gnut_msg_hdr_t *hdr,
+    const unsigned char *payload, void *arg);
+
+/**
+ * Check the Kind of a Vendor Message
+ *
+ * @param vm Pointer to the parsed Vendor Message.
+ * @param vendor Pointer to the four character vendor code.
+ * @param selector The selector.
+ * @return Non-zero if the message has this vendor code and selector, 0
+ * otherwise.
+ */
+GNUT_EXPORT int gnut_vmsg_is(const gnut_vmsg_t *vm, const char *vendor,
+    sxs_uint16_t selector);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* GNUT_VENDOR_H */
@@ -0,0 +1,44 @@
+/*
+ * Copyright 2006-2007 Andrew De Ponte
+ *
+ * This file is part of lib_gnut.
+ *
+ * lib_gnut is the intellectual property of Andrew De Ponte; any
+ * distribution and/or modification and/or reproductions of any portion
+ * of lib_gnut MUST be approved by Andrew De Ponte.
+ *
+ * lib_gnut is distributed WITHOUT ANY WARRANTY; without even the
+ * implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE.
+ */
+
+/**
+ * @file check.h
+ * @brief This is a specifications file for the test programs.
+ *
+ * The check.h file is a specifications file that defines the CHECK()
+ * macro the programs run by 'make check' use to report a failed
+ * expectation, and the counter of failures they exit with.
+ */
+
+#ifndef GNUT_CHECK_H
+#define GNUT_CHECK_H
+
+#include <stdio.h>
+
+static int check_failures = 0;
+
+/* Report 'expr' with its location if it is false and carry on, so that
+ * one run shows every failure. */
+#define CHECK(expr) \
+    do { \
+        if (!(expr)) { \
+            fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, \
+                __LINE__, #expr); \
+            check_failures++; \
+        } \
+    } while (0)
+
+#define CHECK_EXIT() ((check_failures == 0) ? 0 : 1)
+
+#endif /* GNUT_CHECK_H */
@@ -0,0 +1,153 @@
+/*
+ * Copyright 2006-2007 Andrew De Ponte
+ *
+ * This file is part of lib_gnut.
+ *
+ * lib_gnut is the intellectual property of Andrew De Ponte; any
+ * distribution and/or modification and/or reproductions of any portion
+ * of lib_gnut MUST be approved by Andrew De Ponte.
+ *
+ * lib_gnut is distributed WITHOUT ANY WARRANTY; without even the
+ * implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE.
+ */
+
+/**
+ * @file test_conn.c
+ * @brief This is a test of the capabilities a connection keeps.
+ *
+ * The test_conn.c file is a test program that hands one end of a
+ * socketpair to gnut_conn_new(), plays the peer on the other end with
+ * a CONNECT block that carries X-Max-TTL, and checks that the
+ * connection keeps the peer's capabilities and refuses to send over
+ * its limits.
+ */
+
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/socket.h>
+
+#include "gnut_conn.h"
+#include "gnut_enc_msg.h"
+#include "check.h"
+
+static const char connect_block[] =
+    "GNUTELLA CONNECT/0.6\r\n"
+    "X-Ultrapeer: True\r\n"
+    "Vendor-Message: 0.1\r\n"
+    "X-Max-TTL: 3\r\n"
+    "\r\n";
+
+static const char ack_block[] = "GNUTELLA/0.6 200 OK\r\n\r\n";
+
+static int up = 0;
+static int closed = 0;
+
+static gnut_error_t send_query(gnut_conn_t *c, unsigned char ttl) {
+    static const unsigned char payload[4] = { 0, 0, 'a', 0 };
+    gnut_msg_hdr_t hdr;
+    gnut_enc_msg_t *msg;
+    gnut_error_t err;
+
+    gnut_build_msg_hdr(&hdr, GNUT_MSG_QUERY, sizeof(payload));
+    hdr.ttl = ttl;
+    hdr.hops = 0;
+    CHECK(gnut_enc_msg_encode(&msg, &hdr, payload) == GNUT_SUCCESS);
+    err = gnut_conn_send(c, msg);
+    gnut_enc_msg_unref(msg);
+
+    return err;
+}
+
+static void on_up(gnut_conn_t *c, void *arg) {
+    gnut_caps_t *caps;
+    gnut_msg_hdr_t hdr;
+
+    up = 1;
+    caps = gnut_conn_caps(c);
+    CHECK(caps->flags == (GNUT_CAPS_ULTRAPEER | GNUT_CAPS_VENDOR_MSGS));
+    CHECK(caps->max_ttl == 3);
+    CHECK(caps->hops_flow == GNUT_CAPS_NO_LIMIT);
+
+    gnut_build_msg_hdr(&hdr, GNUT_MSG_QUERY, 4);
+    hdr.ttl = 5;
+    CHECK(!gnut_conn_allows(c, &hdr));
+    hdr.ttl = 3;
+    CHECK(gnut_conn_allows(c, &hdr));
+
+    CHECK(send_query(c, 5) == GNUT_EPEER_LIMIT);
+    CHECK(gnut_conn_stats(c)->pruned == 1);
+    CHECK(send_query(c, 3) == GNUT_SUCCESS);
+}
+
+static void on_close(gnut_conn_t *c, gnut_error_t err, void *arg) {
+    closed = 1;
+}
+
+int main(int argc, char *argv[]) {
+    gnut_evloop_t *loop;
+    gnut_conn_t *c;
+    gnut_conn_cfg_t cfg;
+    gnut_hs_tmpl_t tmpl;
+    const char *hs_buf;
+    const gnut_hs_parser_t *hs;
+    unsigned char buf[4096];
+    sxs_uint32_t len;
+    char *end;
+    int sv[2], i, n;
+
+    CHECK(socketpair(AF_UNIX, SOCK_STREAM, 0, sv) == 0);
+    fcntl(sv[0], F_SETFL, O_NONBLOCK);
+    fcntl(sv[1], F_SETFL, O_NONBLOCK);
+    CHECK(gnut_evloop_new(&loop) == GNUT_SUCCESS);
+
+    gnut_hs_tmpl_init(&tmpl, GNUT_HS_OK_LINE);
+    gnut_conn_cfg_init(&cfg);
+    cfg.tmpl = &tmpl;
+    cfg.on_up = on_up;
+    cfg.on_close = on_close;
+    CHECK(gnut_conn_new(&c, loop, sv[0], NULL, &cfg) == GNUT_SUCCESS);
+
+    CHECK(write(sv[1], connect_block, strlen(connect_block)) ==
+        (ssize_t)strlen(connect_block));
+    CHECK(write(sv[1], ack_block, strlen(ack_block)) ==
+        (ssize_t)strlen(ack_block));
+
+    /* Our response block, then the one Query within the limits. */
+    len = 0;
+    for (i = 0; i < 100 && !closed; i++) {
+        gnut_evloop_run_once(loop, 10000);
+        n = read(sv[1], buf + len, sizeof(buf) - 1 - len);
+        if (n > 0) {
+            len += n;
+        }
+        buf[len] = '\0';
+        end = strstr((char *)buf, "\r\n\r\n");
+        if (end != NULL && len - ((unsigned char *)end + 4 - buf) >= 27) {
+            break;
+        }
+    }
+    CHECK(up && !closed);
+
+    /* What is kept of an incoming handshake is the peer's final ack. */
+    hs = gnut_conn_handshake(c, &hs_buf);
+    CHECK(hs != NULL && !hs->is_connect && hs->status_code == 200);
+
+    CHECK(strncmp((char *)buf, GNUT_HS_OK_LINE "\r\n",
+        strlen(GNUT_HS_OK_LINE) + 2) == 0);
+    end = strstr((char *)buf, "\r\n\r\n");
+    CHECK(end != NULL);
+    if (end != NULL) {
+        end += 4;
+        CHECK(len - ((unsigned char *)end - buf) == 27);
+        CHECK((unsigned char)end[16] == GNUT_MSG_QUERY);
+        CHECK(end[17] == 3);
+    }
+
+    gnut_conn_close(c);
+    gnut_evloop_free(loop);
+    close(sv[1]);
+
+    return CHECK_EXIT();
+}
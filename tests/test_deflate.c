@@ -0,0 +1,154 @@
+/*
+ * Copyright 2006-2007 Andrew De Ponte
+ *
+ * This file is part of lib_gnut.
+ *
+ * lib_gnut is the intellectual property of Andrew De Ponte; any
+ * distribution and/or modification and/or reproductions of any portion
+ * of lib_gnut MUST be approved by Andrew De Ponte.
+ *
+ * lib_gnut is distributed WITHOUT ANY WARRANTY; without even the
+ * implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE.
+ */
+
+/**
+ * @file test_deflate.c
+ * @brief This is a test of deflate link compression.
+ *
+ * The test_deflate.c file is a test program that compresses random,
+ * repetitive and text-like data with gnut_deflate_compress(), flushes
+ * at random points into output buffers of awkward sizes, and checks
+ * that zlib inflates it back to the same bytes.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "gnut_deflate.h"
+#include "check.h"
+
+#define DATA_LEN (256 * 1024)
+
+static unsigned char data[DATA_LEN];
+static unsigned char comp[2 * DATA_LEN];
+static unsigned char plain[DATA_LEN];
+
+static void fill(int kind) {
+    static const char *words[] = {
+        "mozart ", "concert", "the mp3", "bootleg"
+    };
+    sxs_uint32_t i;
+
+    for (i = 0; i < DATA_LEN; i++) {
+        if (kind == 0) {
+            data[i] = (unsigned char)rand();
+        } else if (kind == 1) {
+            data[i] = (unsigned char)((i / 1000) % 3);
+        } else {
+            data[i] = (unsigned char)words[(i / 7 + rand() % 2) % 4][i % 7];
+        }
+    }
+}
+
+/* Compress 'data' in chunks of up to 'chunk' bytes into buffers of at
+ * most 'out_step' bytes, flushing after about one chunk in 'every',
+ * then inflate the whole stream and compare. */
+static void round_trip(const gnut_deflate_cfg_t *cfg, sxs_uint32_t chunk,
+    sxs_uint32_t out_step, int every) {
+
+    gnut_deflate_budget_t budget;
+    gnut_deflate_stats_t st;
+    gnut_deflate_t *tx, *rx;
+    gnut_error_t err;
+    sxs_uint32_t in_off, out_len, n, used, produced, plain_len;
+
+    memset(&budget, 0, sizeof(budget));
+    CHECK(gnut_deflate_new(&tx, cfg, &budget) == GNUT_SUCCESS);
+    CHECK(gnut_deflate_new(&rx, NULL, &budget) == GNUT_SUCCESS);
+
+    in_off = 0;
+    out_len = 0;
+    while (in_off < DATA_LEN) {
+        n = 1 + (sxs_uint32_t)rand() % chunk;
+        if (n > DATA_LEN - in_off) {
+            n = DATA_LEN - in_off;
+        }
+        while (n > 0) {
+            CHECK(gnut_deflate_compress(tx, data + in_off, n,
+                comp + out_len, out_step, &used, &produced) ==
+                GNUT_SUCCESS);
+            in_off += used;
+            n -= used;
+            out_len += produced;
+        }
+        if (rand() % every == 0) {
+            do {
+                err = gnut_deflate_flush(tx, comp + out_len, out_step,
+                    &produced);
+                out_len += produced;
+            } while (err == GNUT_EBUF_TOO_SMALL);
+            CHECK(err == GNUT_SUCCESS);
+            CHECK(!gnut_deflate_needs_flush(tx));
+        }
+    }
+    do {
+        err = gnut_deflate_flush(tx, comp + out_len, out_step, &produced);
+        out_len += produced;
+    } while (err == GNUT_EBUF_TOO_SMALL);
+    CHECK(err == GNUT_SUCCESS);
+
+    CHECK(gnut_deflate_decompress(rx, comp, out_len, plain, DATA_LEN,
+        &used, &plain_len) == GNUT_SUCCESS);
+    CHECK(used == out_len);
+    CHECK(plain_len == DATA_LEN);
+    CHECK(memcmp(plain, data, DATA_LEN) == 0);
+
+    gnut_deflate_get_stats(tx, &st);
+    CHECK(st.out_raw == DATA_LEN);
+    CHECK(st.out_comp == out_len);
+
+    gnut_deflate_free(tx);
+    gnut_deflate_free(rx);
+    CHECK(budget.used == 0);
+}
+
+int main(int argc, char *argv[]) {
+    gnut_deflate_cfg_t cfg;
+    gnut_deflate_t *link;
+    int kind;
+
+    srand(1);
+    for (kind = 0; kind < 3; kind++) {
+        fill(kind);
+
+        gnut_deflate_cfg_init(&cfg);
+        round_trip(&cfg, 64, 2 * DATA_LEN, 1);
+        round_trip(&cfg, 8192, 7, 4);
+        round_trip(&cfg, 100000, 65536, 1000);
+
+        cfg.window_bits = 9;
+        cfg.hash_bits = 8;
+        cfg.max_chain = 1;
+        cfg.flush_thresh = 300;
+        round_trip(&cfg, 1000, 1, 8);
+
+        cfg.window_bits = 14;
+        cfg.hash_bits = 16;
+        cfg.max_chain = 64;
+        round_trip(&cfg, 20000, 4096, 2);
+    }
+
+    /* Runs longer than the longest match, a window behind. */
+    memset(data, 'x', DATA_LEN);
+    gnut_deflate_cfg_init(&cfg);
+    round_trip(&cfg, DATA_LEN, 2 * DATA_LEN, 1);
+
+    cfg.window_bits = 15;
+    CHECK(gnut_deflate_new(&link, &cfg, NULL) == GNUT_EDEFLATE);
+    gnut_deflate_cfg_init(&cfg);
+    cfg.max_chain = 0;
+    CHECK(gnut_deflate_new(&link, &cfg, NULL) == GNUT_EDEFLATE);
+
+    return CHECK_EXIT();
+}
@@ -0,0 +1,154 @@
+/*
+ * Copyright 2006-2007 Andrew De Ponte
+ *
+ * This file is part of lib_gnut.
+ *
+ * lib_gnut is the intellectual property of Andrew De Ponte; any
+ * distribution and/or modification and/or reproductions of any portion
+ * of lib_gnut MUST be approved by Andrew De Ponte.
+ *
+ * lib_gnut is distributed WITHOUT ANY WARRANTY; without even the
+ * implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE.
+ */
+
+/**
+ * @file test_dialer.c
+ * @brief This is a test of the connection dialer.
+ *
+ * The test_dialer.c file is a test program that dials a listening and
+ * a refusing port on the loopback interface. It checks that a dialer
+ * whose only candidate is backing off dials again on its own, that a
+ * connect only counts once its handshake is reported to have
+ * succeeded, and that a failed handshake makes it dial again.
+ */
+
+#include <string.h>
+#include <unistd.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+
+#include "gnut_dialer.h"
+#include "check.h"
+
+static int connected = 0;
+static int last_sd = -1;
+static int refused = 0;
+static sxs_uint16_t refused_port;
+static sxs_uint32_t good_successes = 0;
+
+static void on_connected(gnut_dialer_t *d, sxs_socket_t sd,
+    const struct sockaddr_in *addr, void *arg) {
+
+    connected++;
+    last_sd = sd;
+}
+
+static void on_result(gnut_dialer_t *d, const gnut_dial_host_t *host,
+    int ok, void *arg) {
+
+    if (host->port == refused_port) {
+        CHECK(!ok);
+        refused++;
+    } else if (ok) {
+        good_successes = host->successes;
+    }
+}
+
+/* Bind a loopback TCP socket to any port and return its port. */
+static sxs_uint16_t bind_any(int sd) {
+    struct sockaddr_in addr;
+    socklen_t len;
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    CHECK(bind(sd, (struct sockaddr *)&addr, sizeof(addr)) == 0);
+    len = sizeof(addr);
+    CHECK(getsockname(sd, (struct sockaddr *)&addr, &len) == 0);
+
+    return ntohs(addr.sin_port);
+}
+
+/* Run 'loop' for about 'ms' milliseconds. */
+static void run_for(gnut_evloop_t *loop, int ms) {
+    gnut_uint64_t end;
+
+    end = gnut_time_us() + (gnut_uint64_t)ms * 1000;
+    while (gnut_time_us() < end) {
+        gnut_evloop_run_once(loop, 10000);
+    }
+}
+
+int main(int argc, char *argv[]) {
+    gnut_evloop_t *loop;
+    gnut_dialer_t *d;
+    gnut_dialer_cfg_t cfg;
+    sxs_uint32_t ip;
+    sxs_uint16_t good_port;
+    int lsd, rsd, n;
+
+    lsd = socket(AF_INET, SOCK_STREAM, 0);
+    good_port = bind_any(lsd);
+    CHECK(listen(lsd, 8) == 0);
+    rsd = socket(AF_INET, SOCK_STREAM, 0);
+    refused_port = bind_any(rsd);
+    close(rsd);
+    ip = htonl(INADDR_LOOPBACK);
+
+    CHECK(gnut_evloop_new(&loop) == GNUT_SUCCESS);
+    gnut_dialer_cfg_init(&cfg);
+    cfg.retry = 0;
+    cfg.retry_max = 0;
+    cfg.timeout = 1000000;
+    cfg.on_connected = on_connected;
+    cfg.on_result = on_result;
+    CHECK(gnut_dialer_new(&d, loop, &cfg) == GNUT_SUCCESS);
+
+    /* A zero backoff is raised to the minimum, so the refused host is
+     * dialed again only by the retry timer, a few times a second. */
+    CHECK(gnut_dialer_add_host(d, ip, refused_port, 0, 0, 0) ==
+        GNUT_SUCCESS);
+    gnut_dialer_set_needed(d, 1);
+    run_for(loop, 350);
+    CHECK(refused >= 2 && refused <= 5);
+
+    /* Connecting is not enough, nor does it stop the dialer for good. */
+    CHECK(gnut_dialer_add_host(d, ip, good_port, 0, 0, 0) ==
+        GNUT_SUCCESS);
+    for (n = 0; n < 100 && connected == 0; n++) {
+        gnut_evloop_run_once(loop, 10000);
+    }
+    CHECK(connected == 1);
+    CHECK(good_successes == 0);
+    run_for(loop, 250);
+    CHECK(connected == 1);
+    CHECK(gnut_dialer_in_flight(d) == 0);
+
+    /* The handshake failed: back off and dial again. */
+    close(last_sd);
+    gnut_dialer_handshake_done(d, ip, good_port, 0);
+    for (n = 0; n < 100 && connected == 1; n++) {
+        gnut_evloop_run_once(loop, 10000);
+    }
+    CHECK(connected == 2);
+
+    /* The handshake succeeded: done, and nothing is dialed after. */
+    close(last_sd);
+    gnut_dialer_handshake_done(d, ip, good_port, 1);
+    CHECK(good_successes == 1);
+    gnut_dialer_handshake_done(d, ip, good_port, 1);
+    CHECK(good_successes == 1);
+    n = refused;
+    run_for(loop, 250);
+    CHECK(connected == 2);
+    CHECK(refused == n);
+    CHECK(gnut_dialer_in_flight(d) == 0);
+
+    gnut_dialer_free(d);
+    gnut_evloop_free(loop);
+    close(lsd);
+
+    return CHECK_EXIT();
+}
@@ -0,0 +1,238 @@
+/*
+ * Copyright 2006-2007 Andrew De Ponte
+ *
+ * This file is part of lib_gnut.
+ *
+ * lib_gnut is the intellectual property of Andrew De Ponte; any
+ * distribution and/or modification and/or reproductions of any portion
+ * of lib_gnut MUST be approved by Andrew De Ponte.
+ *
+ * lib_gnut is distributed WITHOUT ANY WARRANTY; without even the
+ * implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE.
+ */
+
+/**
+ * @file test_handshake.c
+ * @brief This is a test of the handshake parser.
+ *
+ * The test_handshake.c file is a test program that runs gnut_hs_parse()
+ * over complete, folded, truncated and oversized handshake blocks and
+ * checks the spans and errors it reports.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "gnut_handshake.h"
+#include "check.h"
+
+/* Check that the bytes 'span' covers in 'buf' are exactly 'val'. */
+static int span_is(const char *buf, gnut_span_t span, const char *val) {
+    return (span.len == strlen(val) &&
+        memcmp(buf + span.off, val, span.len) == 0);
+}
+
+static gnut_error_t parse_all(gnut_hs_parser_t *p, const char *buf) {
+    gnut_hs_parser_init(p);
+    return gnut_hs_parse(p, buf, (sxs_uint32_t)strlen(buf));
+}
+
+static void test_connect(void) {
+    static const char buf[] =
+        "GNUTELLA CONNECT/0.6\r\n"
+        "User-Agent: lib_gnut/0.1\r\n"
+        "X-Ultrapeer:   True  \r\n"
+        "Pong-Caching: 0.1\r\n"
+        "\r\n"
+        "\0\1\2";
+    gnut_hs_parser_t p;
+    gnut_span_t val;
+    const gnut_hs_hdr_t *hdr;
+
+    /* The three bytes after the block are the message stream. */
+    gnut_hs_parser_init(&p);
+    CHECK(gnut_hs_parse(&p, buf, sizeof(buf) - 1) == GNUT_SUCCESS);
+    CHECK(p.is_connect);
+    CHECK(p.num_hdrs == 3);
+    CHECK(p.pos == sizeof(buf) - 4);
+    CHECK(gnut_hs_get_hdr(&p, GNUT_HS_HDR_USER_AGENT, &val) ==
+        GNUT_SUCCESS);
+    CHECK(span_is(buf, val, "lib_gnut/0.1"));
+    CHECK(gnut_hs_get_hdr(&p, GNUT_HS_HDR_X_ULTRAPEER, &val) ==
+        GNUT_SUCCESS);
+    CHECK(span_is(buf, val, "True"));
+    CHECK(gnut_hs_has_token(buf, val, "true", 4));
+    CHECK(gnut_hs_get_hdr(&p, GNUT_HS_HDR_ACCEPT_ENCODING, &val) ==
+        GNUT_EHS_NO_HDR);
+    hdr = gnut_hs_find_hdr(&p, buf, "pong-caching", 12);
+    CHECK(hdr != NULL && span_is(buf, hdr->value, "0.1"));
+}
+
+static void test_response(void) {
+    static const char buf[] =
+        "GNUTELLA/0.6 503 Full\n"
+        "X-Try-Ultrapeers: 1.2.3.4:6346\n"
+        "\n";
+    gnut_hs_parser_t p;
+
+    CHECK(parse_all(&p, buf) == GNUT_SUCCESS);
+    CHECK(!p.is_connect);
+    CHECK(p.status_code == 503);
+    CHECK(p.pos == sizeof(buf) - 1);
+
+    CHECK(parse_all(&p, "GNUTELLA/0.6 2x0 OK\r\n\r\n") ==
+        GNUT_EHS_MALFORMED);
+    CHECK(parse_all(&p, "HTTP/1.1 200 OK\r\n\r\n") == GNUT_EHS_MALFORMED);
+    CHECK(parse_all(&p, "GNUTELLA CONNECT/0.6\r\nNoColon\r\n\r\n") ==
+        GNUT_EHS_MALFORMED);
+    CHECK(parse_all(&p, "GNUTELLA CONNECT/0.6\r\n: empty\r\n\r\n") ==
+        GNUT_EHS_MALFORMED);
+}
+
+static void test_folded(void) {
+    static const char buf[] =
+        "GNUTELLA CONNECT/0.6\r\n"
+        "X-Try-Ultrapeers: 1.2.3.4:6346,\r\n"
+        "  5.6.7.8:6346,\r\n"
+        "\t9.9.9.9:6346\r\n"
+        "Empty-First:\r\n"
+        "   later  \r\n"
+        "User-Agent: x\r\n"
+        "\r\n";
+    gnut_hs_parser_t p;
+    gnut_span_t val;
+    const gnut_hs_hdr_t *hdr;
+
+    CHECK(parse_all(&p, buf) == GNUT_SUCCESS);
+    CHECK(p.num_hdrs == 3);
+    CHECK(gnut_hs_get_hdr(&p, GNUT_HS_HDR_X_TRY_ULTRAPEERS, &val) ==
+        GNUT_SUCCESS);
+    CHECK(span_is(buf, val,
+        "1.2.3.4:6346,\r\n  5.6.7.8:6346,\r\n\t9.9.9.9:6346"));
+    CHECK(gnut_hs_has_token(buf, val, "9.9.9.9:6346", 12));
+    hdr = gnut_hs_find_hdr(&p, buf, "Empty-First", 11);
+    CHECK(hdr != NULL && span_is(buf, hdr->value, "later"));
+    CHECK(gnut_hs_get_hdr(&p, GNUT_HS_HDR_USER_AGENT, &val) ==
+        GNUT_SUCCESS);
+    CHECK(span_is(buf, val, "x"));
+
+    /* A continuation needs a header to continue. */
+    CHECK(parse_all(&p, "GNUTELLA CONNECT/0.6\r\n  stray\r\n\r\n") ==
+        GNUT_EHS_MALFORMED);
+}
+
+/* Names of 16 bytes and more, in any case, including the indexed ones
+ * that are exactly 16 bytes long. */
+static void test_long_names(void) {
+    static const char buf[] =
+        "GNUTELLA CONNECT/0.6\r\n"
+        "content-ENCODING: deflate\r\n"
+        "X-TRY-ULTRAPEERS: 1.2.3.4:6346\r\n"
+        "X-Try-Ultrapeers-Extended: no\r\n"
+        "X-A-Rather-Long-Vendor-Specific-Header-Name : yes\r\n"
+        "\r\n";
+    gnut_hs_parser_t p;
+    gnut_span_t val;
+    const gnut_hs_hdr_t *hdr;
+
+    CHECK(parse_all(&p, buf) == GNUT_SUCCESS);
+    CHECK(p.num_hdrs == 4);
+    CHECK(gnut_hs_get_hdr(&p, GNUT_HS_HDR_CONTENT_ENCODING, &val) ==
+        GNUT_SUCCESS);
+    CHECK(span_is(buf, val, "deflate"));
+    CHECK(gnut_hs_get_hdr(&p, GNUT_HS_HDR_X_TRY_ULTRAPEERS, &val) ==
+        GNUT_SUCCESS);
+    CHECK(span_is(buf, val, "1.2.3.4:6346"));
+    hdr = gnut_hs_find_hdr(&p, buf, "x-try-ultrapeers-extended", 25);
+    CHECK(hdr != NULL && span_is(buf, hdr->value, "no"));
+    hdr = gnut_hs_find_hdr(&p, buf,
+        "x-a-rather-long-vendor-specific-header-name", 43);
+    CHECK(hdr != NULL && span_is(buf, hdr->value, "yes"));
+    CHECK(gnut_hs_find_hdr(&p, buf, "X-Try-Ultrapeers-Extende", 24) ==
+        NULL);
+}
+
+/* Feed a block one byte at a time, the way it may come off a socket;
+ * every prefix short of the final LF is incomplete. */
+static void test_truncated(void) {
+    static const char buf[] =
+        "GNUTELLA CONNECT/0.6\r\n"
+        "User-Agent: x\r\n"
+        "\r\n";
+    gnut_hs_parser_t p;
+    sxs_uint32_t len, full;
+
+    full = (sxs_uint32_t)strlen(buf);
+    gnut_hs_parser_init(&p);
+    for (len = 0; len < full; len++) {
+        CHECK(gnut_hs_parse(&p, buf, len) == GNUT_EHS_INCOMPLETE);
+    }
+    CHECK(gnut_hs_parse(&p, buf, full) == GNUT_SUCCESS);
+    CHECK(p.pos == full);
+    CHECK(p.num_hdrs == 1);
+
+    /* A fresh parser on each truncated copy, e.g. ending in "\r\n\r". */
+    for (len = 0; len < full; len++) {
+        gnut_hs_parser_init(&p);
+        CHECK(gnut_hs_parse(&p, buf, len) == GNUT_EHS_INCOMPLETE);
+    }
+}
+
+static void test_oversized(void) {
+    static char buf[GNUT_HS_MAX_LEN + 64];
+    gnut_hs_parser_t p;
+    sxs_uint32_t len;
+    int i;
+
+    /* No blank line within GNUT_HS_MAX_LEN bytes, all of it short lines
+     * that continue one header. */
+    len = (sxs_uint32_t)sprintf(buf, "GNUTELLA CONNECT/0.6\r\nX-Pad: 0\r\n");
+    while (len + 16 < sizeof(buf)) {
+        len += (sxs_uint32_t)sprintf(buf + len, " 12345\r\n");
+    }
+    gnut_hs_parser_init(&p);
+    CHECK(gnut_hs_parse(&p, buf, len) == GNUT_EHS_TOO_LARGE);
+
+    /* One line running past GNUT_HS_MAX_LEN. */
+    len = (sxs_uint32_t)sprintf(buf, "GNUTELLA CONNECT/0.6\r\nX-Long: ");
+    memset(buf + len, 'a', sizeof(buf) - len);
+    gnut_hs_parser_init(&p);
+    CHECK(gnut_hs_parse(&p, buf, GNUT_HS_MAX_LEN - 1) ==
+        GNUT_EHS_INCOMPLETE);
+    CHECK(gnut_hs_parse(&p, buf, GNUT_HS_MAX_LEN) == GNUT_EHS_TOO_LARGE);
+    buf[sizeof(buf) - 1] = '\n';
+    gnut_hs_parser_init(&p);
+    CHECK(gnut_hs_parse(&p, buf, sizeof(buf)) == GNUT_EHS_TOO_LARGE);
+
+    /* Exactly GNUT_HS_MAX_HDRS headers fit, one more does not. */
+    len = (sxs_uint32_t)sprintf(buf, "GNUTELLA CONNECT/0.6\r\n");
+    for (i = 0; i < GNUT_HS_MAX_HDRS; i++) {
+        len += (sxs_uint32_t)sprintf(buf + len, "X-H%d: %d\r\n", i, i);
+    }
+    strcpy(buf + len, "\r\n");
+    CHECK(parse_all(&p, buf) == GNUT_SUCCESS);
+    CHECK(p.num_hdrs == GNUT_HS_MAX_HDRS);
+    strcpy(buf + len, "X-One-More: 1\r\n\r\n");
+    CHECK(parse_all(&p, buf) == GNUT_EHS_TOO_MANY_HDRS);
+
+    /* Continuation lines do not count as headers. */
+    len = (sxs_uint32_t)sprintf(buf, "GNUTELLA CONNECT/0.6\r\nX-Fold: 0\r\n");
+    for (i = 1; i < 2 * GNUT_HS_MAX_HDRS; i++) {
+        len += (sxs_uint32_t)sprintf(buf + len, " %d\r\n", i);
+    }
+    strcpy(buf + len, "\r\n");
+    CHECK(parse_all(&p, buf) == GNUT_SUCCESS);
+    CHECK(p.num_hdrs == 1);
+}
+
+int main(int argc, char *argv[]) {
+    test_connect();
+    test_response();
+    test_folded();
+    test_long_names();
+    test_truncated();
+    test_oversized();
+
+    return CHECK_EXIT();
+}
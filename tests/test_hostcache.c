@@ -0,0 +1,138 @@
+/*
+ * Copyright 2006-2007 Andrew De Ponte
+ *
+ * This file is part of lib_gnut.
+ *
+ * lib_gnut is the intellectual property of Andrew De Ponte; any
+ * distribution and/or modification and/or reproductions of any portion
+ * of lib_gnut MUST be approved by Andrew De Ponte.
+ *
+ * lib_gnut is distributed WITHOUT ANY WARRANTY; without even the
+ * implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE.
+ */
+
+/**
+ * @file test_hostcache.c
+ * @brief This is a test of the persistent host cache.
+ *
+ * The test_hostcache.c file is a test program that fills a host cache,
+ * reopens it, damages its index on disk and checks that the index is
+ * rebuilt, and that a dialer fed from it gets last seen times on its
+ * own clock.
+ */
+
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <arpa/inet.h>
+
+#include "gnut_hostcache.h"
+#include "check.h"
+
+#define CAPACITY 100
+#define NUM_HOSTS 60
+#define HDR_SIZE 64
+#define INDEX_SIZE 256
+
+static const char path[] = "test_hostcache.tmp";
+
+static sxs_uint32_t host_ip(int i) {
+    return htonl(0x0a000001 + i);
+}
+
+static void check_hosts(gnut_hostcache_t *hc) {
+    gnut_hc_rec_t rec;
+    int i, found;
+
+    CHECK(gnut_hostcache_count(hc) == NUM_HOSTS);
+    found = 0;
+    for (i = 0; i < NUM_HOSTS; i++) {
+        if (gnut_hostcache_get(hc, host_ip(i), 6346, &rec) ==
+            GNUT_SUCCESS && rec.num_files == (sxs_uint32_t)i) {
+            found++;
+        }
+    }
+    CHECK(found == NUM_HOSTS);
+}
+
+/* Overwrite the first used index slot of the closed cache file with
+ * 'v', or with the value of the last used slot if 'v' is 0. */
+static void damage_index(sxs_uint32_t v) {
+    sxs_uint32_t index[INDEX_SIZE];
+    off_t off;
+    int fd, i, j;
+
+    off = HDR_SIZE + CAPACITY * sizeof(gnut_hc_rec_t);
+    fd = open(path, O_RDWR);
+    CHECK(fd >= 0);
+    CHECK(pread(fd, index, sizeof(index), off) == sizeof(index));
+    for (i = 0; i < INDEX_SIZE && index[i] == 0; i++) {
+    }
+    for (j = INDEX_SIZE - 1; j > i && index[j] == 0; j--) {
+    }
+    CHECK(j > i);
+    index[i] = (v != 0) ? v : index[j];
+    CHECK(pwrite(fd, index, sizeof(index), off) == sizeof(index));
+    close(fd);
+}
+
+static void on_connected(gnut_dialer_t *d, sxs_socket_t sd,
+    const struct sockaddr_in *addr, void *arg) {
+}
+
+int main(int argc, char *argv[]) {
+    gnut_hostcache_t *hc;
+    gnut_evloop_t *loop;
+    gnut_dialer_t *d;
+    gnut_dialer_cfg_t cfg;
+    int i;
+
+    unlink(path);
+    CHECK(gnut_hostcache_open(&hc, path, CAPACITY) == GNUT_SUCCESS);
+    for (i = 0; i < NUM_HOSTS; i++) {
+        CHECK(gnut_hostcache_put(hc, host_ip(i), 6346, i, 0) ==
+            GNUT_SUCCESS);
+    }
+    CHECK(gnut_hostcache_touch(hc, host_ip(0), 6346) == GNUT_SUCCESS);
+    CHECK(gnut_hostcache_touch(hc, host_ip(NUM_HOSTS), 6346) ==
+        GNUT_ENOT_FOUND);
+    check_hosts(hc);
+    gnut_hostcache_close(hc);
+
+    /* Closed cleanly: loads as it was. */
+    CHECK(gnut_hostcache_open(&hc, path, CAPACITY) == GNUT_SUCCESS);
+    check_hosts(hc);
+    gnut_hostcache_close(hc);
+
+    /* A slot naming a record past the end, one naming an unused record,
+     * and one naming a record another slot names. */
+    damage_index(0x7fffffff);
+    CHECK(gnut_hostcache_open(&hc, path, CAPACITY) == GNUT_SUCCESS);
+    check_hosts(hc);
+    gnut_hostcache_close(hc);
+    damage_index(CAPACITY);
+    CHECK(gnut_hostcache_open(&hc, path, CAPACITY) == GNUT_SUCCESS);
+    check_hosts(hc);
+    gnut_hostcache_close(hc);
+    damage_index(0);
+    CHECK(gnut_hostcache_open(&hc, path, CAPACITY) == GNUT_SUCCESS);
+    check_hosts(hc);
+
+    /* Every cached host reaches a dialer. */
+    CHECK(gnut_evloop_new(&loop) == GNUT_SUCCESS);
+    gnut_dialer_cfg_init(&cfg);
+    cfg.on_connected = on_connected;
+    CHECK(gnut_dialer_new(&d, loop, &cfg) == GNUT_SUCCESS);
+    CHECK(gnut_hostcache_feed_dialer(hc, d) == NUM_HOSTS);
+    CHECK(gnut_dialer_num_hosts(d) == NUM_HOSTS);
+    gnut_dialer_free(d);
+    gnut_evloop_free(loop);
+
+    CHECK(gnut_hostcache_evict(hc, 3600) == 0);
+    CHECK(gnut_hostcache_count(hc) == NUM_HOSTS);
+    gnut_hostcache_close(hc);
+    unlink(path);
+
+    return CHECK_EXIT();
+}
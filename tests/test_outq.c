@@ -0,0 +1,126 @@
+/*
+ * Copyright 2006-2007 Andrew De Ponte
+ *
+ * This file is part of lib_gnut.
+ *
+ * lib_gnut is the intellectual property of Andrew De Ponte; any
+ * distribution and/or modification and/or reproductions of any portion
+ * of lib_gnut MUST be approved by Andrew De Ponte.
+ *
+ * lib_gnut is distributed WITHOUT ANY WARRANTY; without even the
+ * implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE.
+ */
+
+/**
+ * @file test_outq.c
+ * @brief This is a test of the output queue drop policy.
+ *
+ * The test_outq.c file is a test program that checks the byte limit
+ * of the control lane and that every push crossing the high watermark
+ * sheds, including those made while the queue is already congested.
+ */
+
+#include <string.h>
+
+#include "gnut_outq.h"
+#include "check.h"
+
+#define PAYLOAD_LEN 100
+#define MSG_LEN (23 + PAYLOAD_LEN)
+
+static gnut_error_t push(gnut_outq_t *q, unsigned char type,
+    unsigned char hops, gnut_uint64_t now) {
+
+    static const unsigned char payload[PAYLOAD_LEN];
+    gnut_msg_hdr_t hdr;
+    gnut_enc_msg_t *msg;
+    gnut_error_t err;
+
+    gnut_build_msg_hdr(&hdr, type, PAYLOAD_LEN);
+    hdr.hops = hops;
+    CHECK(gnut_enc_msg_encode(&msg, &hdr, payload) == GNUT_SUCCESS);
+    err = gnut_outq_push(q, msg, now);
+    gnut_enc_msg_unref(msg);
+
+    return err;
+}
+
+static void test_control_max(void) {
+    gnut_outq_cfg_t cfg;
+    gnut_outq_t q;
+
+    gnut_outq_cfg_init(&cfg);
+    cfg.max_bytes = MSG_LEN;
+    cfg.control_max = 2 * MSG_LEN + 10;
+    gnut_outq_init(&q, &cfg);
+
+    /* Control is not held to max_bytes, only to its own limit. */
+    CHECK(push(&q, GNUT_MSG_VENDOR, 0, 0) == GNUT_SUCCESS);
+    CHECK(push(&q, GNUT_MSG_VENDOR, 0, 0) == GNUT_SUCCESS);
+    CHECK(push(&q, GNUT_MSG_VENDOR, 0, 0) == GNUT_EQUEUE_FULL);
+    CHECK(q.lanes[GNUT_OUTQ_LANE_CONTROL].bytes == 2 * MSG_LEN);
+    CHECK(q.stats.dropped[GNUT_OUTQ_LANE_CONTROL] == 1);
+    CHECK(push(&q, GNUT_MSG_QUERY_HIT, 0, 0) == GNUT_EQUEUE_FULL);
+    CHECK(push(&q, GNUT_MSG_BYE, 0, 0) == GNUT_SUCCESS);
+
+    /* Sending one makes room for the next. */
+    gnut_enc_msg_unref(gnut_outq_pop(&q, 0));
+    gnut_enc_msg_unref(gnut_outq_pop(&q, 0));
+    CHECK(q.lanes[GNUT_OUTQ_LANE_CONTROL].bytes == MSG_LEN);
+    CHECK(push(&q, GNUT_MSG_VENDOR, 0, 0) == GNUT_SUCCESS);
+
+    gnut_outq_destroy(&q);
+}
+
+static void test_reshed(void) {
+    gnut_outq_cfg_t cfg;
+    gnut_outq_t q;
+    int i;
+
+    gnut_outq_cfg_init(&cfg);
+    cfg.hi_water = 1000;
+    cfg.lo_water = 500;
+    cfg.pong_max_age = 10;
+    gnut_outq_init(&q, &cfg);
+
+    /* Nothing to shed the first time, so the queue stays congested. */
+    for (i = 0; i < 9; i++) {
+        CHECK(push(&q, GNUT_MSG_QUERY, 0, 0) == GNUT_SUCCESS);
+    }
+    CHECK(gnut_outq_congested(&q));
+    CHECK(q.bytes == 9 * MSG_LEN);
+
+    /* Back between the watermarks, still congested. */
+    for (i = 0; i < 3; i++) {
+        gnut_enc_msg_unref(gnut_outq_pop(&q, 0));
+    }
+    CHECK(gnut_outq_congested(&q));
+    CHECK(push(&q, GNUT_MSG_PONG, 0, 0) == GNUT_SUCCESS);
+    CHECK(push(&q, GNUT_MSG_PONG, 0, 0) == GNUT_SUCCESS);
+    CHECK(q.bytes == 8 * MSG_LEN);
+
+    /* Crossing hi_water again sheds the Pongs that went stale. */
+    CHECK(push(&q, GNUT_MSG_QUERY, 0, 100) == GNUT_SUCCESS);
+    CHECK(q.stats.dropped[GNUT_OUTQ_LANE_PONG] == 2);
+    CHECK(q.lanes[GNUT_OUTQ_LANE_PONG].bytes == 0);
+    CHECK(q.bytes == 7 * MSG_LEN);
+
+    /* Staying over hi_water does not shed on every push. */
+    CHECK(push(&q, GNUT_MSG_QUERY, 0, 100) == GNUT_SUCCESS);
+    CHECK(push(&q, GNUT_MSG_QUERY, 0, 100) == GNUT_SUCCESS);
+    CHECK(q.bytes > cfg.hi_water);
+    CHECK(push(&q, GNUT_MSG_PONG, 0, 100) == GNUT_SUCCESS);
+    CHECK(push(&q, GNUT_MSG_QUERY, 0, 200) == GNUT_SUCCESS);
+    CHECK(q.stats.dropped[GNUT_OUTQ_LANE_PONG] == 2);
+    CHECK(q.bytes == 11 * MSG_LEN);
+
+    gnut_outq_destroy(&q);
+}
+
+int main(int argc, char *argv[]) {
+    test_control_max();
+    test_reshed();
+
+    return CHECK_EXIT();
+}
@@ -0,0 +1,152 @@
+/*
+ * Copyright 2006-2007 Andrew De Ponte
+ *
+ * This file is part of lib_gnut.
+ *
+ * lib_gnut is the intellectual property of Andrew De Ponte; any
+ * distribution and/or modification and/or reproductions of any portion
+ * of lib_gnut MUST be approved by Andrew De Ponte.
+ *
+ * lib_gnut is distributed WITHOUT ANY WARRANTY; without even the
+ * implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE.
+ */
+
+/**
+ * @file gnut_hashshare.c
+ * @brief This is a tool which hashes the files of a share.
+ *
+ * The gnut_hashshare.c file is a program that walks the given
+ * directories, without following symbolic links, and hashes every
+ * regular file in them with a hasher, loading and saving its cache if
+ * one is given, so a second run only hashes what changed. It prints a
+ * tab separated key=value line with the urn:sha1 value of each file
+ * unless quiet, then one with the totals and the throughput.
+ *
+ * usage: gnut_hashshare [-q] [-s] [-t threads] [-c cache] [-C chunk_kb]
+ *     [-A ahead_kb] dir...
+ */
+
+#define _GNU_SOURCE /* nftw() */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h> /* getopt() */
+#include <ftw.h> /* nftw() */
+
+#include "gnut_hasher.h"
+#include "gnut_base32.h"
+
+#define MAX_FDS 64
+
+static gnut_hasher_t *hasher;
+static int quiet = 0;
+
+static void file_done(gnut_hasher_t *h, gnut_error_t err,
+    const gnut_hasher_file_t *f, void *arg) {
+
+    char urn[GNUT_URN_SHA1_LEN];
+
+    if (err != GNUT_SUCCESS) {
+        fprintf(stderr, "%s: cannot hash\n", f->path);
+        return;
+    }
+    if (quiet) {
+        return;
+    }
+    gnut_urn_sha1_format(f->sha1, urn);
+    printf("urn=%.*s\tsize=%llu\tcached=%d\tpath=%s\n", GNUT_URN_SHA1_LEN,
+        urn, (unsigned long long)f->size, f->cached, f->path);
+}
+
+static int walk(const char *path, const struct stat *st, int type,
+    struct FTW *ftw) {
+
+    if (type == FTW_F && S_ISREG(st->st_mode) &&
+        gnut_hasher_add(hasher, path) != GNUT_SUCCESS) {
+        fprintf(stderr, "out of memory\n");
+        return 1;
+    }
+    return 0;
+}
+
+static double now_s(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int main(int argc, char *argv[]) {
+    gnut_hasher_cfg_t cfg;
+    gnut_hasher_stats_t st;
+    double start, elapsed;
+    int accel, c, i;
+
+    gnut_hasher_cfg_init(&cfg);
+    cfg.cb = file_done;
+    accel = 1;
+    while ((c = getopt(argc, argv, "qst:c:C:A:")) != -1) {
+        switch (c) {
+            case 'q':
+                quiet = 1;
+                break;
+            case 's':
+                accel = 0;
+                break;
+            case 't':
+                cfg.num_threads = atoi(optarg);
+                break;
+            case 'c':
+                cfg.cache_path = optarg;
+                break;
+            case 'C':
+                cfg.chunk_size = (sxs_uint32_t)atol(optarg) * 1024;
+                break;
+            case 'A':
+                cfg.read_ahead = (sxs_uint32_t)atol(optarg) * 1024;
+                break;
+            default:
+                optind = argc;
+                break;
+        }
+    }
+    if (optind >= argc) {
+        fprintf(stderr, "usage: %s [-q] [-s] [-t threads] [-c cache] "
+            "[-C chunk_kb] [-A ahead_kb] dir...\n", argv[0]);
+        return 1;
+    }
+    accel = gnut_sha1_use_accel(accel);
+
+    start = now_s();
+    if (gnut_hasher_new(&hasher, &cfg) != GNUT_SUCCESS) {
+        fprintf(stderr, "cannot start the hasher\n");
+        return 1;
+    }
+    for (i = optind; i < argc; i++) {
+        if (nftw(argv[i], walk, MAX_FDS, FTW_PHYS) != 0) {
+            fprintf(stderr, "%s: cannot walk\n", argv[i]);
+        }
+    }
+    gnut_hasher_wait(hasher);
+    elapsed = now_s() - start;
+
+    if (cfg.cache_path != NULL &&
+        gnut_hasher_save(hasher, cfg.cache_path) != GNUT_SUCCESS) {
+        fprintf(stderr, "%s: cannot save cache\n", cfg.cache_path);
+    }
+    gnut_hasher_stats(hasher, &st);
+    gnut_hasher_free(hasher);
+
+    printf("total\taccel=%d\thashed=%llu\tcached=%llu\terrors=%llu"
+        "\tbytes=%llu\tseconds=%.3f\tmb_per_sec=%.1f\n", accel,
+        (unsigned long long)st.files_hashed,
+        (unsigned long long)st.files_cached,
+        (unsigned long long)st.errors,
+        (unsigned long long)st.bytes_hashed, elapsed,
+        st.bytes_hashed / 1e6 / elapsed);
+
+    return 0;
+}
@@ -0,0 +1,891 @@
+/*
+ * Copyright 2006-2007 Andrew De Ponte
+ *
+ * This file is part of lib_gnut.
+ *
+ * lib_gnut is the intellectual property of Andrew De Ponte; any
+ * distribution and/or modification and/or reproductions of any portion
+ * of lib_gnut MUST be approved by Andrew De Ponte.
+ *
+ * lib_gnut is distributed WITHOUT ANY WARRANTY; without even the
+ * implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE.
+ */
+
+/**
+ * @file gnut_loadgen.c
+ * @brief This is a load generator simulating a swarm of servents.
+ *
+ * The gnut_loadgen.c file is a program that opens many connections to
+ * a relay, usually gnut_relayd on the loopback interface, performs the
+ * 0.6 handshake on each, and then sends a weighted mix of message types
+ * at a target rate from randomly chosen connections. Pongs and Query
+ * Hits answer recent Pings and Queries of other connections, and
+ * Pushes target the Servent IDs of recent Query Hits, so the relay has
+ * to route every reply. A Bye closes its connection, which then
+ * reconnects.
+ *
+ * Every message carries the time it was sent: in its Message ID, or in
+ * its payload for replies, whose Message ID is the request's. Each copy
+ * received gives one forwarding latency sample, and the copies expected
+ * are counted as they are sent, one per other connection for a
+ * broadcast and one for a reply, so what never arrives is the relay's
+ * drop rate. Messages our own output queues refuse are not expected.
+ *
+ * Given a range of rates it runs a step per rate, doubling each time,
+ * and stops after the first step that drops more than the threshold or
+ * cannot be sent at the target rate: the rate before it is the
+ * saturation point. It prints tab separated key=value lines per step,
+ * per step and type, and for the saturation point. The generator is a
+ * single thread, so it should be run on its own cores, and a step in
+ * which it could not keep up says so with a low sent_rate. With -z
+ * each connection offers deflate.
+ *
+ * usage: gnut_loadgen [-a addr] [-p port] [-n conns] [-r rate[:max]]
+ *     [-d secs] [-g grace_ms] [-m mix] [-D max_drop] [-P pending]
+ *     [-s seed] [-z]
+ */
+
+#include <math.h>
+#include <netinet/tcp.h> /* TCP_NODELAY */
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h> /* setrlimit() */
+#include <unistd.h> /* getopt() */
+
+#include "gnut_conn.h"
+#include "gnut_enc_msg.h"
+#include "gnut_node.h"
+#include "gnut_pong_msg.h"
+
+#define TICK_US 1000
+#define RETRY_US 100000         /* Before reconnecting after a failure */
+#define LEAVE_US 50000          /* Between sending a Bye and closing */
+#define CONNECT_TIMEOUT 30000000
+#define RING_LEN 4096           /* Recent requests replies may answer */
+#define HIST_LEN 976            /* 16 exact buckets, 16 per power of 2 */
+#define MAGIC "LG06"            /* Closes the Message ID of our messages */
+#define QUERY_STR "loadgen"
+#define HIT_LEN 37              /* One result, two NULs, Servent ID */
+#define HIT_TAG_OFF 11          /* The result's file index and size */
+#define PONG_TAG_OFF 6          /* The files and kilobytes shared */
+
+#define P_IDLE 0
+#define P_CONNECTING 1
+#define P_HANDSHAKE 2
+#define P_UP 3
+#define P_LEAVING 4
+
+static const char *type_names[GNUT_NODE_NUM_T] = {
+    "ping", "pong", "bye", "push", "query", "query_hit", "other"
+};
+
+typedef struct hist {
+    gnut_uint64_t n;
+    gnut_uint64_t max;
+    gnut_uint64_t b[HIST_LEN];
+} hist_t;
+
+struct lg;
+
+typedef struct peer {
+    struct lg *lg;
+    gnut_conn_t *conn;
+    sxs_socket_t sd;            /* While connecting */
+    int state;
+    sxs_uint32_t gen;           /* Bumped each time it connects */
+    sxs_uint32_t up_idx;
+    gnut_timer_t timer;
+    unsigned char servent_id[16];
+} peer_t;
+
+typedef struct req {
+    unsigned char id[16];       /* Message ID, or Servent ID for hits */
+    sxs_uint32_t peer;
+    sxs_uint32_t gen;
+} req_t;
+
+typedef struct ring {
+    req_t ents[RING_LEN];
+    sxs_uint32_t len;
+    sxs_uint32_t next;
+} ring_t;
+
+typedef struct step {
+    gnut_uint64_t sent[GNUT_NODE_NUM_T];
+    gnut_uint64_t expected[GNUT_NODE_NUM_T];
+    gnut_uint64_t received[GNUT_NODE_NUM_T];
+    gnut_uint64_t shed[GNUT_NODE_NUM_T];
+    hist_t lat[GNUT_NODE_NUM_T];
+    gnut_uint64_t late;         /* Received from an earlier step */
+    gnut_uint64_t foreign;      /* Not sent by us */
+    gnut_uint64_t behind;       /* Sends skipped to bound a tick's burst */
+} step_t;
+
+typedef struct lg {
+    gnut_evloop_t *loop;
+    gnut_hs_tmpl_t tmpl;
+    gnut_conn_cfg_t ccfg;
+    struct sockaddr_in addr;
+    peer_t *peers;
+    sxs_uint32_t num_peers;
+    sxs_uint32_t *up;           /* Peers that are up, in any order */
+    sxs_uint32_t num_up;
+    sxs_uint32_t *idle;         /* Peers waiting to connect */
+    sxs_uint32_t num_idle;
+    sxs_uint32_t pending;       /* Connecting or handshaking */
+    sxs_uint32_t max_pending;
+    unsigned int mix[GNUT_NODE_NUM_T];
+    unsigned int mix_total;
+    double rate;
+    gnut_timer_t tick;
+    gnut_uint64_t step_start;
+    gnut_uint64_t attempts;     /* Sends due so far in the step */
+    sxs_uint32_t seq;
+    gnut_uint64_t rng;
+    ring_t pings;
+    ring_t queries;
+    ring_t hits;
+    step_t st;
+    gnut_uint64_t connects;
+    gnut_uint64_t connect_failures;
+    gnut_uint64_t disconnects;
+} lg_t;
+
+static volatile sig_atomic_t stopping = 0;
+
+static void on_signal(int sig) {
+    stopping = 1;
+}
+
+static gnut_uint64_t rnd(lg_t *lg) {
+    lg->rng ^= lg->rng << 13;
+    lg->rng ^= lg->rng >> 7;
+    lg->rng ^= lg->rng << 17;
+    return lg->rng;
+}
+
+static void hist_add(hist_t *h, gnut_uint64_t v) {
+    unsigned int e, idx;
+
+    if (v < 16) {
+        idx = (unsigned int)v;
+    } else {
+        e = 63;
+        while (!(v >> e)) {
+            e--;
+        }
+        idx = 16 + (e - 4) * 16 + (unsigned int)((v >> (e - 4)) & 15);
+    }
+    h->b[idx]++;
+    h->n++;
+    if (v > h->max) {
+        h->max = v;
+    }
+}
+
+static void hist_merge(hist_t *dst, const hist_t *src) {
+    int i;
+
+    for (i = 0; i < HIST_LEN; i++) {
+        dst->b[i] += src->b[i];
+    }
+    dst->n += src->n;
+    if (src->max > dst->max) {
+        dst->max = src->max;
+    }
+}
+
+/* Returns the upper bound of the bucket holding the q quantile. */
+static gnut_uint64_t hist_pct(const hist_t *h, double q) {
+    gnut_uint64_t want, seen;
+    unsigned int i, e;
+
+    if (h->n == 0) {
+        return 0;
+    }
+    want = (gnut_uint64_t)ceil(q * h->n);
+    seen = 0;
+    for (i = 0; i < HIST_LEN; i++) {
+        seen += h->b[i];
+        if (seen >= want && seen > 0) {
+            break;
+        }
+    }
+    if (i < 16) {
+        return i;
+    }
+    e = (i - 16) / 16 + 4;
+    return (((gnut_uint64_t)(16 + (i - 16) % 16 + 1)) << (e - 4)) - 1;
+}
+
+static void put_le64(unsigned char *p, gnut_uint64_t v) {
+    int i;
+
+    for (i = 0; i < 8; i++) {
+        p[i] = (unsigned char)(v >> (8 * i));
+    }
+}
+
+static gnut_uint64_t get_le64(const unsigned char *p) {
+    gnut_uint64_t v;
+    int i;
+
+    v = 0;
+    for (i = 7; i >= 0; i--) {
+        v = (v << 8) | p[i];
+    }
+    return v;
+}
+
+static void ring_add(ring_t *r, const unsigned char *id, sxs_uint32_t peer,
+    sxs_uint32_t gen) {
+
+    req_t *q;
+
+    q = &r->ents[r->next];
+    memcpy((void *)q->id, (const void *)id, 16);
+    q->peer = peer;
+    q->gen = gen;
+    r->next = (r->next + 1) % RING_LEN;
+    if (r->len < RING_LEN) {
+        r->len++;
+    }
+}
+
+/* Picks a recent request whose peer is still the same connection. */
+static req_t *ring_pick(lg_t *lg, ring_t *r) {
+    req_t *q;
+    int tries;
+
+    for (tries = 0; tries < 4 && r->len > 0; tries++) {
+        q = &r->ents[rnd(lg) % r->len];
+        if (lg->peers[q->peer].state == P_UP &&
+            lg->peers[q->peer].gen == q->gen) {
+            return q;
+        }
+    }
+    return NULL;
+}
+
+static void up_add(lg_t *lg, peer_t *p) {
+    p->up_idx = lg->num_up;
+    lg->up[lg->num_up++] = (sxs_uint32_t)(p - lg->peers);
+}
+
+static void up_remove(lg_t *lg, peer_t *p) {
+    sxs_uint32_t last;
+
+    last = lg->up[--lg->num_up];
+    lg->up[p->up_idx] = last;
+    lg->peers[last].up_idx = p->up_idx;
+}
+
+static void fill_connects(lg_t *lg);
+
+static void retry_cb(gnut_evloop_t *loop, void *arg) {
+    peer_t *p;
+
+    p = (peer_t *)arg;
+    p->lg->idle[p->lg->num_idle++] = (sxs_uint32_t)(p - p->lg->peers);
+    fill_connects(p->lg);
+}
+
+static void connect_failed(lg_t *lg, peer_t *p) {
+    lg->connect_failures++;
+    lg->pending--;
+    p->state = P_IDLE;
+    gnut_evloop_timer_start(lg->loop, &p->timer, RETRY_US, retry_cb, p);
+}
+
+static void on_up(gnut_conn_t *c, void *arg) {
+    peer_t *p;
+
+    p = (peer_t *)gnut_conn_user(c);
+    p->lg->pending--;
+    p->lg->connects++;
+    p->state = P_UP;
+    up_add(p->lg, p);
+    fill_connects(p->lg);
+}
+
+static void on_close(gnut_conn_t *c, gnut_error_t reason, void *arg) {
+    peer_t *p;
+
+    p = (peer_t *)gnut_conn_user(c);
+    p->conn = NULL;
+    if (p->state == P_HANDSHAKE) {
+        connect_failed(p->lg, p);
+        return;
+    }
+    if (p->state == P_UP) {
+        up_remove(p->lg, p);
+    }
+    gnut_evloop_timer_stop(p->lg->loop, &p->timer);
+    if (p->state != P_LEAVING) {
+        p->lg->disconnects++;
+    }
+    p->state = P_IDLE;
+    gnut_evloop_timer_start(p->lg->loop, &p->timer, RETRY_US, retry_cb, p);
+}
+
+static void on_msg(gnut_conn_t *c, const gnut_msg_hdr_t *hdr,
+    const unsigned char *raw, const unsigned char *payload, void *arg) {
+
+    lg_t *lg;
+    gnut_uint64_t tag, now;
+    int t;
+
+    lg = (lg_t *)arg;
+    t = gnut_node_type_index(hdr->type);
+    if (memcmp(hdr->message_id + 12, MAGIC, 4) != 0) {
+        lg->st.foreign++;
+        return;
+    }
+    switch (t) {
+        case GNUT_NODE_T_PING:
+        case GNUT_NODE_T_QUERY:
+        case GNUT_NODE_T_PUSH:
+            tag = get_le64(hdr->message_id);
+            break;
+        case GNUT_NODE_T_PONG:
+            if (hdr->pl_len < GNUT_PONG_PAYLOAD_LEN) {
+                lg->st.foreign++;
+                return;
+            }
+            tag = get_le64(payload + PONG_TAG_OFF);
+            break;
+        case GNUT_NODE_T_QUERY_HIT:
+            if (hdr->pl_len < HIT_LEN) {
+                lg->st.foreign++;
+                return;
+            }
+            tag = get_le64(payload + HIT_TAG_OFF);
+            break;
+        default:
+            lg->st.foreign++;
+            return;
+    }
+    if (tag < lg->step_start) {
+        lg->st.late++;
+        return;
+    }
+    now = gnut_time_us();
+    lg->st.received[t]++;
+    hist_add(&lg->st.lat[t], (now > tag) ? now - tag : 0);
+}
+
+static void connect_cb(gnut_evloop_t *loop, sxs_socket_t sd, int events,
+    void *arg) {
+
+    peer_t *p;
+    lg_t *lg;
+    sxs_socklen_t len;
+    int soerr;
+
+    p = (peer_t *)arg;
+    lg = p->lg;
+    gnut_evloop_del(loop, sd);
+    soerr = 0;
+    len = sizeof(soerr);
+    if (sxs_getsockopt(sd, SOL_SOCKET, SO_ERROR, (sxs_buf_t)&soerr,
+        &len) != SXS_SUCCESS || soerr != 0) {
+        sxs_close(sd);
+        connect_failed(lg, p);
+        return;
+    }
+    if (gnut_conn_new(&p->conn, loop, sd, &lg->addr, &lg->ccfg) !=
+        GNUT_SUCCESS) {
+        p->conn = NULL;
+        connect_failed(lg, p);
+        return;
+    }
+    gnut_conn_set_user(p->conn, p);
+    p->state = P_HANDSHAKE;
+}
+
+static void start_connect(lg_t *lg, peer_t *p) {
+    gnut_msg_hdr_t tmp;
+    sxs_error_t err;
+    int on;
+
+    lg->pending++;
+    p->state = P_CONNECTING;
+    p->gen++;
+    /* A route to a Servent ID stays with the first connection it was
+     * seen on, so each connection is a new servent. */
+    gnut_build_msg_id(&tmp);
+    memcpy((void *)p->servent_id, (const void *)tmp.message_id, 16);
+    if (sxs_socket(AF_INET, SOCK_STREAM, 0, &p->sd) != SXS_SUCCESS) {
+        connect_failed(lg, p);
+        return;
+    }
+    on = 1;
+    sxs_setsockopt(p->sd, IPPROTO_TCP, TCP_NODELAY, (sxs_buf_t)&on,
+        sizeof(on));
+    if (sxs_set_nonblock(p->sd, 1) != SXS_SUCCESS) {
+        sxs_close(p->sd);
+        connect_failed(lg, p);
+        return;
+    }
+    err = sxs_connect(p->sd, (const struct sockaddr *)&lg->addr,
+        sizeof(lg->addr));
+    if ((err != SXS_SUCCESS && err != SXS_EINPROGRESS &&
+        err != SXS_EWOULDBLOCK) || gnut_evloop_add(lg->loop, p->sd,
+        GNUT_EV_WRITE, connect_cb, p) != GNUT_SUCCESS) {
+        sxs_close(p->sd);
+        connect_failed(lg, p);
+    }
+}
+
+static void fill_connects(lg_t *lg) {
+    while (lg->pending < lg->max_pending && lg->num_idle > 0 && !stopping) {
+        start_connect(lg, &lg->peers[lg->idle[--lg->num_idle]]);
+    }
+}
+
+static void leave_cb(gnut_evloop_t *loop, void *arg) {
+    peer_t *p;
+
+    p = (peer_t *)arg;
+    gnut_conn_close(p->conn);
+    p->conn = NULL;
+    p->state = P_IDLE;
+    retry_cb(loop, p);
+}
+
+static peer_t *pick_peer(lg_t *lg, sxs_uint32_t not_idx) {
+    sxs_uint32_t i;
+
+    i = lg->up[rnd(lg) % lg->num_up];
+    if (i == not_idx) {
+        i = lg->up[(lg->peers[i].up_idx + 1) % lg->num_up];
+    }
+    return &lg->peers[i];
+}
+
+static int pick_type(lg_t *lg) {
+    unsigned int r;
+    int t;
+
+    r = (unsigned int)(rnd(lg) % lg->mix_total);
+    for (t = 0; t < GNUT_NODE_NUM_T; t++) {
+        if (r < lg->mix[t]) {
+            return t;
+        }
+        r -= lg->mix[t];
+    }
+    return GNUT_NODE_T_PING;
+}
+
+static void send_one(lg_t *lg) {
+    static const unsigned char types[GNUT_NODE_NUM_T] = {
+        GNUT_MSG_PING, GNUT_MSG_PONG, GNUT_MSG_BYE, GNUT_MSG_PUSH,
+        GNUT_MSG_QUERY, GNUT_MSG_QUERY_HIT, 0
+    };
+    unsigned char pl[64];
+    gnut_msg_hdr_t hdr;
+    gnut_enc_msg_t *m;
+    gnut_uint64_t now, expected;
+    peer_t *p;
+    req_t *q;
+    int t;
+
+    if (lg->num_up < 2) {
+        return;
+    }
+    t = pick_type(lg);
+    q = NULL;
+    if (t == GNUT_NODE_T_PONG || t == GNUT_NODE_T_QUERY_HIT ||
+        t == GNUT_NODE_T_PUSH) {
+        q = ring_pick(lg, (t == GNUT_NODE_T_PONG) ? &lg->pings :
+            (t == GNUT_NODE_T_QUERY_HIT) ? &lg->queries : &lg->hits);
+        if (q == NULL) {
+            /* Nothing to answer yet; ask instead. */
+            t = (t == GNUT_NODE_T_PUSH) ? GNUT_NODE_T_QUERY :
+                (t == GNUT_NODE_T_PONG) ? GNUT_NODE_T_PING :
+                GNUT_NODE_T_QUERY;
+        }
+    }
+    p = pick_peer(lg, (q != NULL) ? q->peer : lg->num_peers);
+
+    now = gnut_time_us();
+    memset(&hdr, 0, sizeof(hdr));
+    put_le64(hdr.message_id, now);
+    memcpy((void *)(hdr.message_id + 8), (const void *)&lg->seq, 4);
+    memcpy((void *)(hdr.message_id + 12), (const void *)MAGIC, 4);
+    lg->seq++;
+    hdr.type = types[t];
+    hdr.ttl = GNUT_NODE_DEF_MAX_TTL;
+    hdr.hops = 0;
+    memset(pl, 0, sizeof(pl));
+    expected = 1;
+
+    switch (t) {
+        case GNUT_NODE_T_PING:
+            expected = lg->num_up - 1;
+            break;
+        case GNUT_NODE_T_QUERY:
+            memcpy((void *)(pl + 2), (const void *)QUERY_STR,
+                sizeof(QUERY_STR));
+            hdr.pl_len = 2 + sizeof(QUERY_STR);
+            expected = lg->num_up - 1;
+            break;
+        case GNUT_NODE_T_PONG:
+            memcpy((void *)hdr.message_id, (const void *)q->id, 16);
+            put_le64(pl + PONG_TAG_OFF, now);
+            hdr.pl_len = GNUT_PONG_PAYLOAD_LEN;
+            break;
+        case GNUT_NODE_T_QUERY_HIT:
+            memcpy((void *)hdr.message_id, (const void *)q->id, 16);
+            pl[0] = 1;
+            put_le64(pl + HIT_TAG_OFF, now);
+            memcpy((void *)(pl + HIT_LEN - 16), (const void *)p->servent_id,
+                16);
+            hdr.pl_len = HIT_LEN;
+            break;
+        case GNUT_NODE_T_PUSH:
+            memcpy((void *)pl, (const void *)q->id, 16);
+            hdr.pl_len = GNUT_PUSH_PAYLOAD_LEN;
+            break;
+        default:
+            pl[0] = 200;
+            memcpy((void *)(pl + 2), (const void *)QUERY_STR,
+                sizeof(QUERY_STR));
+            hdr.pl_len = 2 + sizeof(QUERY_STR);
+            expected = 0;
+            break;
+    }
+
+    if (gnut_enc_msg_encode(&m, &hdr, pl) != GNUT_SUCCESS) {
+        return;
+    }
+    lg->st.sent[t]++;
+    if (gnut_conn_send(p->conn, m) != GNUT_SUCCESS) {
+        lg->st.shed[t]++;
+        gnut_enc_msg_unref(m);
+        return;
+    }
+    gnut_enc_msg_unref(m);
+    lg->st.expected[t] += expected;
+
+    if (t == GNUT_NODE_T_PING) {
+        ring_add(&lg->pings, hdr.message_id, (sxs_uint32_t)(p - lg->peers),
+            p->gen);
+    } else if (t == GNUT_NODE_T_QUERY) {
+        ring_add(&lg->queries, hdr.message_id,
+            (sxs_uint32_t)(p - lg->peers), p->gen);
+    } else if (t == GNUT_NODE_T_QUERY_HIT) {
+        ring_add(&lg->hits, p->servent_id, (sxs_uint32_t)(p - lg->peers),
+            p->gen);
+    } else if (t == GNUT_NODE_T_BYE) {
+        /* Give the Bye time to leave before closing. */
+        up_remove(lg, p);
+        p->state = P_LEAVING;
+        gnut_evloop_timer_start(lg->loop, &p->timer, LEAVE_US, leave_cb, p);
+    }
+}
+
+static void tick_cb(gnut_evloop_t *loop, void *arg) {
+    lg_t *lg;
+    gnut_uint64_t due, max_burst;
+
+    lg = (lg_t *)arg;
+    due = (gnut_uint64_t)(lg->rate * (gnut_time_us() - lg->step_start) /
+        1e6);
+    /* Never send more than ten ticks' worth at once: a generator that
+     * fell behind reports it rather than flooding. */
+    max_burst = (gnut_uint64_t)(lg->rate * TICK_US * 10 / 1e6) + 1;
+    if (due > lg->attempts + max_burst) {
+        lg->st.behind += due - lg->attempts - max_burst;
+        lg->attempts = due - max_burst;
+    }
+    while (lg->attempts < due) {
+        send_one(lg);
+        lg->attempts++;
+    }
+    gnut_evloop_timer_start(loop, &lg->tick, TICK_US, tick_cb, lg);
+}
+
+static void run_for(lg_t *lg, gnut_uint64_t us) {
+    gnut_uint64_t end;
+
+    end = gnut_time_us() + us;
+    while (!stopping && gnut_time_us() < end) {
+        gnut_evloop_run_once(lg->loop, 10000);
+    }
+}
+
+/* Runs one step and returns whether the relay kept up with it. */
+static int run_step(lg_t *lg, double rate, gnut_uint64_t duration,
+    gnut_uint64_t grace, double max_drop) {
+
+    step_t *st;
+    hist_t all;
+    gnut_uint64_t sent, expected, received, shed;
+    double secs, drop, sent_rate;
+    int t;
+
+    st = &lg->st;
+    memset(st, 0, sizeof(step_t));
+    lg->rate = rate;
+    lg->attempts = 0;
+    lg->step_start = gnut_time_us();
+    gnut_evloop_timer_start(lg->loop, &lg->tick, TICK_US, tick_cb, lg);
+    run_for(lg, duration);
+    gnut_evloop_timer_stop(lg->loop, &lg->tick);
+    secs = (gnut_time_us() - lg->step_start) / 1e6;
+    run_for(lg, grace);
+
+    memset(&all, 0, sizeof(all));
+    sent = expected = received = shed = 0;
+    for (t = 0; t < GNUT_NODE_NUM_T; t++) {
+        sent += st->sent[t];
+        expected += st->expected[t];
+        received += st->received[t];
+        shed += st->shed[t];
+        hist_merge(&all, &st->lat[t]);
+    }
+    drop = (expected > 0 && expected > received) ?
+        (double)(expected - received) / expected : 0.0;
+    sent_rate = (secs > 0) ? sent / secs : 0.0;
+
+    printf("loadgen_step\trate=%.0f\tconns=%u\tsecs=%.2f\tsent=%llu"
+        "\tsent_rate=%.0f\tlocal_shed=%llu\tbehind=%llu\texpected=%llu"
+        "\treceived=%llu\trecv_rate=%.0f\tdrop_rate=%.5f\tlate=%llu"
+        "\tforeign=%llu\tp50_us=%llu\tp90_us=%llu\tp99_us=%llu"
+        "\tp999_us=%llu\tmax_us=%llu\n", rate, lg->num_up, secs,
+        (unsigned long long)sent, sent_rate, (unsigned long long)shed,
+        (unsigned long long)st->behind, (unsigned long long)expected,
+        (unsigned long long)received, (secs > 0) ? received / secs : 0.0,
+        drop, (unsigned long long)st->late, (unsigned long long)st->foreign,
+        (unsigned long long)hist_pct(&all, 0.5),
+        (unsigned long long)hist_pct(&all, 0.9),
+        (unsigned long long)hist_pct(&all, 0.99),
+        (unsigned long long)hist_pct(&all, 0.999),
+        (unsigned long long)all.max);
+    for (t = 0; t < GNUT_NODE_NUM_T; t++) {
+        if (st->sent[t] == 0) {
+            continue;
+        }
+        printf("loadgen_type\trate=%.0f\ttype=%s\tsent=%llu\tlocal_shed=%llu"
+            "\texpected=%llu\treceived=%llu\tdrop_rate=%.5f\tp50_us=%llu"
+            "\tp99_us=%llu\tmax_us=%llu\n", rate, type_names[t],
+            (unsigned long long)st->sent[t], (unsigned long long)st->shed[t],
+            (unsigned long long)st->expected[t],
+            (unsigned long long)st->received[t],
+            (st->expected[t] > st->received[t]) ?
+            (double)(st->expected[t] - st->received[t]) / st->expected[t] :
+            0.0, (unsigned long long)hist_pct(&st->lat[t], 0.5),
+            (unsigned long long)hist_pct(&st->lat[t], 0.99),
+            (unsigned long long)st->lat[t].max);
+    }
+    fflush(stdout);
+
+    return drop <= max_drop && sent_rate >= 0.95 * rate;
+}
+
+static int parse_mix(lg_t *lg, const char *spec) {
+    char buf[256], *tok, *eq, *save;
+    int t, found;
+
+    if (strlen(spec) >= sizeof(buf)) {
+        return -1;
+    }
+    strcpy(buf, spec);
+    memset(lg->mix, 0, sizeof(lg->mix));
+    lg->mix_total = 0;
+    for (tok = strtok_r(buf, ",", &save); tok != NULL;
+        tok = strtok_r(NULL, ",", &save)) {
+
+        eq = strchr(tok, '=');
+        if (eq == NULL) {
+            return -1;
+        }
+        *eq = '\0';
+        found = 0;
+        for (t = 0; t < GNUT_NODE_T_OTHER; t++) {
+            if (strcmp(tok, type_names[t]) == 0) {
+                lg->mix[t] = (unsigned int)atoi(eq + 1);
+                found = 1;
+            }
+        }
+        if (!found) {
+            return -1;
+        }
+    }
+    for (t = 0; t < GNUT_NODE_NUM_T; t++) {
+        lg->mix_total += lg->mix[t];
+    }
+    return (lg->mix_total > 0) ? 0 : -1;
+}
+
+static void raise_fd_limit(void) {
+    struct rlimit rl;
+
+    if (getrlimit(RLIMIT_NOFILE, &rl) == 0 && rl.rlim_cur < rl.rlim_max) {
+        rl.rlim_cur = rl.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &rl);
+    }
+}
+
+int main(int argc, char *argv[]) {
+    static lg_t lg;
+    const char *addr, *mix, *colon;
+    gnut_uint64_t duration, grace, start;
+    double rate, rate_max, max_drop, ok_rate;
+    sxs_uint32_t i;
+    int port, c, ok, deflate;
+
+    addr = "127.0.0.1";
+    deflate = 0;
+    port = 6346;
+    mix = "ping=10,pong=20,query=40,query_hit=20,push=9,bye=1";
+    rate = 1000;
+    rate_max = 0;
+    duration = 5000000;
+    grace = 500000;
+    max_drop = 0.001;
+    lg.num_peers = 1000;
+    lg.max_pending = 128;
+    lg.rng = gnut_time_us() | 1;
+    while ((c = getopt(argc, argv, "a:p:n:r:d:g:m:D:P:s:z")) != -1) {
+        switch (c) {
+            case 'a':
+                addr = optarg;
+                break;
+            case 'p':
+                port = atoi(optarg);
+                break;
+            case 'n':
+                lg.num_peers = (sxs_uint32_t)atol(optarg);
+                break;
+            case 'r':
+                rate = atof(optarg);
+                colon = strchr(optarg, ':');
+                rate_max = (colon != NULL) ? atof(colon + 1) : 0;
+                break;
+            case 'd':
+                duration = (gnut_uint64_t)(atof(optarg) * 1e6);
+                break;
+            case 'g':
+                grace = (gnut_uint64_t)atol(optarg) * 1000;
+                break;
+            case 'm':
+                mix = optarg;
+                break;
+            case 'D':
+                max_drop = atof(optarg);
+                break;
+            case 'P':
+                lg.max_pending = (sxs_uint32_t)atol(optarg);
+                break;
+            case 's':
+                lg.rng = (gnut_uint64_t)atoll(optarg) | 1;
+                break;
+            case 'z':
+                deflate = 1;
+                break;
+            default:
+                optind = argc + 1;
+                break;
+        }
+    }
+    if (optind != argc || lg.num_peers < 2 || rate <= 0 ||
+        lg.max_pending == 0 || parse_mix(&lg, mix) != 0) {
+        fprintf(stderr, "usage: %s [-a addr] [-p port] [-n conns] "
+            "[-r rate[:max]] [-d secs] [-g grace_ms] [-m mix] "
+            "[-D max_drop] [-P pending] [-s seed] [-z]\n"
+            "  mix: type=weight,... of ping, pong, bye, push, query, "
+            "query_hit\n", argv[0]);
+        return 2;
+    }
+
+    raise_fd_limit();
+    signal(SIGPIPE, SIG_IGN);
+    signal(SIGINT, on_signal);
+    signal(SIGTERM, on_signal);
+
+    memset(&lg.addr, 0, sizeof(lg.addr));
+    lg.addr.sin_family = AF_INET;
+    lg.addr.sin_port = sxs_htons((sxs_uint16_t)port);
+    lg.addr.sin_addr.s_addr = sxs_inet_addr(addr);
+
+    lg.peers = (peer_t *)calloc(lg.num_peers, sizeof(peer_t));
+    lg.up = (sxs_uint32_t *)calloc(lg.num_peers, sizeof(sxs_uint32_t));
+    lg.idle = (sxs_uint32_t *)calloc(lg.num_peers, sizeof(sxs_uint32_t));
+    if (lg.peers == NULL || lg.up == NULL || lg.idle == NULL ||
+        gnut_evloop_new(&lg.loop) != GNUT_SUCCESS) {
+        fprintf(stderr, "out of memory\n");
+        return 1;
+    }
+
+    gnut_hs_tmpl_init(&lg.tmpl, GNUT_HS_CONNECT_LINE);
+    gnut_hs_tmpl_add_hdr(&lg.tmpl, "User-Agent", "gnut_loadgen");
+    gnut_hs_tmpl_add_hdr(&lg.tmpl, "X-Ultrapeer", "False");
+    gnut_conn_cfg_init(&lg.ccfg);
+    lg.ccfg.outgoing = 1;
+    lg.ccfg.deflate = deflate;
+    lg.ccfg.tmpl = &lg.tmpl;
+    lg.ccfg.on_up = on_up;
+    lg.ccfg.on_msg = on_msg;
+    lg.ccfg.on_close = on_close;
+    lg.ccfg.arg = &lg;
+
+    for (i = 0; i < lg.num_peers; i++) {
+        lg.peers[i].lg = &lg;
+        gnut_timer_init(&lg.peers[i].timer);
+        lg.idle[lg.num_idle++] = lg.num_peers - 1 - i;
+    }
+    gnut_timer_init(&lg.tick);
+
+    start = gnut_time_us();
+    fill_connects(&lg);
+    while (!stopping && lg.num_up < lg.num_peers &&
+        gnut_time_us() - start < CONNECT_TIMEOUT) {
+        gnut_evloop_run_once(lg.loop, 10000);
+    }
+    printf("loadgen_connect\tconns=%u\twanted=%u\tsecs=%.2f"
+        "\tfailures=%llu\n", lg.num_up, lg.num_peers,
+        (gnut_time_us() - start) / 1e6,
+        (unsigned long long)lg.connect_failures);
+    fflush(stdout);
+    if (lg.num_up < 2) {
+        fprintf(stderr, "%s:%d: could not connect\n", addr, port);
+        return 1;
+    }
+
+    ok_rate = 0;
+    do {
+        ok = run_step(&lg, rate, duration, grace, max_drop);
+        if (ok) {
+            ok_rate = rate;
+        }
+        rate *= 2;
+    } while (ok && !stopping && rate_max > 0 && rate <= rate_max);
+    if (rate_max > 0) {
+        printf("loadgen_saturation\tmax_ok_rate=%.0f\tsaturated=%s"
+            "\tmax_drop=%.5f\tdisconnects=%llu\n", ok_rate,
+            ok ? "no" : "yes", max_drop,
+            (unsigned long long)lg.disconnects);
+    }
+
+    stopping = 1;
+    for (i = 0; i < lg.num_peers; i++) {
+        gnut_evloop_timer_stop(lg.loop, &lg.peers[i].timer);
+        if (lg.peers[i].conn != NULL) {
+            gnut_conn_close(lg.peers[i].conn);
+        } else if (lg.peers[i].state == P_CONNECTING) {
+            gnut_evloop_del(lg.loop, lg.peers[i].sd);
+            sxs_close(lg.peers[i].sd);
+        }
+    }
+    gnut_evloop_free(lg.loop);
+    free(lg.peers);
+    free(lg.up);
+    free(lg.idle);
+
+    return 0;
+}
@@ -0,0 +1,939 @@
+/*
+ * Copyright 2006-2007 Andrew De Ponte
+ *
+ * This file is part of lib_gnut.
+ *
+ * lib_gnut is the intellectual property of Andrew De Ponte; any
+ * distribution and/or modification and/or reproductions of any portion
+ * of lib_gnut MUST be approved by Andrew De Ponte.
+ *
+ * lib_gnut is distributed WITHOUT ANY WARRANTY; without even the
+ * implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE.
+ */
+
+/**
+ * @file gnut_relayd.c
+ * @brief This is a minimal sharded relay.
+ *
+ * The gnut_relayd.c file is a program that accepts 0.6 connections and
+ * relays messages between them through a node: Pings and Queries are
+ * broadcast, replies and Pushes are routed, and a Bye closes its
+ * connection. Each forwarded message is encoded once and shared by the
+ * output queues of all its recipients. It exists to be driven by
+ * gnut_loadgen, and optionally records what it receives to a capture
+ * file for gnut_replay. It prints tab separated key=value lines every
+ * interval and when it exits, and serves the library's statistics at
+ * /metrics, on its own port with -S and always on the Gnutella port.
+ * It can cap, in bytes per second, what it sends altogether with -B,
+ * what it sends of Queries and Pings altogether with -Q, and what it
+ * sends on each connection with -K. With -D it drops Queries repeated
+ * under new Message IDs beyond the default limits of a Query deduper
+ * whose window is the given number of seconds. It keeps what each peer
+ * said of itself in its handshake and in Hops Flow and Messages
+ * Supported Vendor Messages, and does not queue Queries a peer has
+ * asked not to be sent. With -z it offers deflate, compressing and
+ * decompressing the streams of the peers that take it up. With -O it
+ * dials out to keep that many outgoing connections, picking hosts from
+ * the host cache file given with -C, seeded with -P, and from the
+ * Pongs it relays, which it also adds to the cache.
+ *
+ * It runs on a sharded runtime, one shard by default and one per CPU
+ * with -T 0. Each shard is a thread with its own listener, connections,
+ * node and limits; -c, -B and -Q are split evenly between the shards.
+ * Pings and Queries are handed to every other shard, whose node takes
+ * them as if from a connection to the shard they came from, so replies
+ * find their way back the same way. A capture needs a single shard,
+ * and the dialer and the metrics port run on the first.
+ *
+ * usage: gnut_relayd [-a addr] [-p port] [-c max_conns] [-d secs]
+ *     [-i secs] [-R route_capacity] [-H hi_water] [-M max_bytes]
+ *     [-w capture] [-S metrics_port] [-B rate] [-Q bulk_rate]
+ *     [-K conn_rate] [-D dedupe_secs] [-z] [-C host_cache]
+ *     [-P addr:port] [-O outgoing] [-T shards]
+ */
+
+#include <netinet/tcp.h> /* TCP_NODELAY */
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h> /* setrlimit() */
+#include <unistd.h> /* getopt() */
+
+#include "gnut_conn.h"
+#include "gnut_enc_msg.h"
+#include "gnut_node.h"
+#include "gnut_metrics.h"
+#include "gnut_caps.h"
+#include "gnut_dialer.h"
+#include "gnut_hostcache.h"
+#include "gnut_pong_msg.h"
+#include "gnut_shard.h"
+
+#define MAX_SLOTS 65535 /* Connection ids keep the slot in 16 bits */
+#define SUPPORTED_LEN (GNUT_VMSG_HDR_LEN + 2 + (8 * GNUT_VMSG_NUM_K))
+
+/* Ids the nodes know other shards by. Connection ids never have a
+ * generation of 0, so these never collide with them. */
+#define SHARD_CONN_ID(id) ((sxs_uint32_t)(id) + 1)
+#define IS_SHARD_CONN(conn) (((conn) >> 16) == 0)
+
+typedef struct peer {
+    gnut_conn_t *conn;
+    sxs_uint32_t id;            /* Generation << 16 | slot, never 0 */
+    sxs_uint32_t live_idx;      /* Position in the live list */
+    int outgoing;               /* Dialed by us */
+} peer_t;
+
+/* A message handed from one shard to another. */
+typedef struct xmsg {
+    int from;                   /* Shard it arrived on */
+    gnut_msg_hdr_t hdr;         /* As it arrived there */
+    unsigned char payload[1];
+} xmsg_t;
+
+/* The settings all shards start their relay from. */
+typedef struct opts {
+    gnut_conn_cfg_t ccfg;       /* Without templates or callbacks */
+    gnut_shaper_cfg_t scfg;     /* Rates already split between shards */
+    gnut_qdedupe_cfg_t qcfg;
+    sxs_uint32_t route_capacity;
+    sxs_uint32_t max_conns;     /* Per shard */
+    sxs_uint32_t want_out;
+    gnut_uint64_t interval;
+    gnut_uint64_t started;
+    gnut_hostcache_t *hc;
+    gnut_capture_t *cap;
+    sxs_socket_t msd;           /* Metrics listener, or -1 */
+} opts_t;
+
+/* The relay run by one shard. */
+typedef struct relay {
+    int id;                     /* Of its shard */
+    int ready;                  /* Started on its shard */
+    gnut_runtime_t *rt;
+    gnut_evloop_t *loop;
+    gnut_node_t node;
+    gnut_conn_cfg_t ccfg;
+    gnut_conn_cfg_t occfg;      /* For outgoing connections */
+    gnut_shaper_t shaper;
+    gnut_qdedupe_t qd;
+    gnut_deflate_budget_t zbudget;
+    gnut_hs_tmpl_t tmpl;
+    gnut_hs_tmpl_t otmpl;       /* The CONNECT block */
+    gnut_hostcache_t *hc;
+    gnut_dialer_t *dialer;
+    sxs_uint32_t want_out;      /* Outgoing connections to keep */
+    sxs_uint32_t num_out;       /* Established outgoing connections */
+    gnut_capture_t *cap;
+    gnut_metrics_t *metrics;
+    peer_t *peers;
+    sxs_uint32_t *live;         /* Slots of established connections */
+    sxs_uint32_t num_live;
+    sxs_uint32_t *free_slots;
+    sxs_uint32_t num_free;
+    sxs_uint32_t max_conns;
+    sxs_uint32_t num_open;      /* Established or handshaking */
+    sxs_uint32_t gen;
+    gnut_timer_t stats_timer;
+    gnut_uint64_t accepted;
+    gnut_uint64_t dialed;       /* Outgoing connections handshaking */
+    gnut_uint64_t rejected;     /* Over max_conns */
+    gnut_uint64_t hs_failed;
+    gnut_uint64_t http;         /* Connections handed to the metrics */
+    gnut_uint64_t closed;
+    gnut_uint64_t fwd_copies;   /* Messages queued on a connection */
+    gnut_uint64_t shed;         /* Copies the output queues refused */
+    gnut_uint64_t pruned;       /* Copies over the limits of their peer */
+    gnut_uint64_t enc_failed;
+    gnut_uint64_t xfwd;         /* Messages handed to other shards */
+    gnut_uint64_t xshed;        /* Those their inboxes refused */
+} relay_t;
+
+static volatile sig_atomic_t stopping = 0;
+static volatile sig_atomic_t failed = 0;
+static gnut_vmsg_cb_t vmsgs[GNUT_VMSG_NUM_K];
+static opts_t opts;
+static relay_t *relays;         /* One per shard */
+static int num_relays;
+
+static void on_signal(int sig) {
+    stopping = 1;
+}
+
+static peer_t *find_peer(relay_t *r, sxs_uint32_t id) {
+    peer_t *p;
+
+    p = &r->peers[id & 0xffff];
+    if ((id & 0xffff) >= r->max_conns || p->conn == NULL || p->id != id) {
+        return NULL;
+    }
+    return p;
+}
+
+/* Queues a copy of the message unless the peer has asked not to be
+ * sent it, encoding it into '*p_m' for the first peer that takes it. */
+static void send_to(relay_t *r, peer_t *p, const gnut_msg_hdr_t *hdr,
+    const unsigned char *payload, gnut_enc_msg_t **p_m) {
+
+    if (!gnut_conn_allows(p->conn, hdr)) {
+        r->pruned++;
+        return;
+    }
+    if (*p_m == NULL && gnut_enc_msg_encode(p_m, hdr, payload) !=
+        GNUT_SUCCESS) {
+        *p_m = NULL;
+        r->enc_failed++;
+        return;
+    }
+    if (gnut_conn_send(p->conn, *p_m) == GNUT_SUCCESS) {
+        r->fwd_copies++;
+    } else {
+        r->shed++;
+    }
+}
+
+/* Hands a message to shard 'dst'. Passing between shards is not a hop,
+ * so its TTL and hops go back to what they were when it arrived; the
+ * node of 'dst' updates them again. */
+static void send_shard(relay_t *r, int dst, const gnut_msg_hdr_t *hdr,
+    const unsigned char *payload) {
+
+    xmsg_t *x;
+
+    x = (xmsg_t *)malloc(sizeof(xmsg_t) + hdr->pl_len);
+    if (x == NULL) {
+        r->xshed++;
+        return;
+    }
+    x->from = r->id;
+    x->hdr = *hdr;
+    x->hdr.ttl++;
+    x->hdr.hops--;
+    memcpy(x->payload, payload, hdr->pl_len);
+    if (gnut_shard_forward(gnut_runtime_shard(r->rt, dst), x) !=
+        GNUT_SUCCESS) {
+        free(x);
+        r->xshed++;
+        return;
+    }
+    r->xfwd++;
+}
+
+static void on_xmsg(gnut_shard_t *shard, void *item, void *arg) {
+    relay_t *r;
+    xmsg_t *x;
+
+    r = &relays[gnut_shard_id(shard)];
+    x = (xmsg_t *)item;
+    gnut_node_dispatch(&r->node, SHARD_CONN_ID(x->from), &x->hdr,
+        x->payload);
+    free(x);
+}
+
+static void on_forward(gnut_node_t *node, sxs_uint32_t to, sxs_uint32_t from,
+    const gnut_msg_hdr_t *hdr, const unsigned char *payload, void *arg) {
+
+    relay_t *r;
+    peer_t *p;
+    gnut_enc_msg_t *m;
+    sxs_uint32_t i;
+    int dst;
+
+    r = (relay_t *)arg;
+    m = NULL;
+    if (to == GNUT_NODE_BROADCAST) {
+        for (i = 0; i < r->num_live; i++) {
+            p = &r->peers[r->live[i]];
+            if (p->id != from) {
+                send_to(r, p, hdr, payload, &m);
+            }
+        }
+        /* Only what came from a connection of ours, or every shard
+         * would hand it on again. */
+        if (!IS_SHARD_CONN(from)) {
+            for (dst = 0; dst < num_relays; dst++) {
+                if (dst != r->id) {
+                    send_shard(r, dst, hdr, payload);
+                }
+            }
+        }
+    } else if (IS_SHARD_CONN(to)) {
+        send_shard(r, (int)to - 1, hdr, payload);
+    } else if ((p = find_peer(r, to)) != NULL) {
+        send_to(r, p, hdr, payload, &m);
+    } else {
+        r->shed++;
+    }
+    if (m != NULL) {
+        gnut_enc_msg_unref(m);
+    }
+}
+
+static void release_peer(relay_t *r, gnut_conn_t *c) {
+    peer_t *p;
+    sxs_uint32_t slot, last;
+
+    r->num_open--;
+    r->closed++;
+    p = (peer_t *)gnut_conn_user(c);
+    if (p == NULL) {
+        return;
+    }
+    slot = p->id & 0xffff;
+    last = r->live[--r->num_live];
+    r->live[p->live_idx] = last;
+    r->peers[last].live_idx = p->live_idx;
+    p->conn = NULL;
+    r->free_slots[r->num_free++] = slot;
+    if (p->outgoing) {
+        p->outgoing = 0;
+        r->num_out--;
+        gnut_dialer_set_needed(r->dialer,
+            (int)r->want_out - (int)r->num_out);
+    }
+}
+
+static void on_deliver(gnut_node_t *node, sxs_uint32_t from,
+    const gnut_msg_hdr_t *hdr, const unsigned char *payload, void *arg) {
+
+    relay_t *r;
+    peer_t *p;
+    gnut_conn_t *c;
+
+    r = (relay_t *)arg;
+    if (hdr->type == GNUT_MSG_BYE && (p = find_peer(r, from)) != NULL) {
+        c = p->conn;
+        release_peer(r, c);
+        gnut_conn_close(c);
+    }
+}
+
+static void on_caps(sxs_uint32_t from, const gnut_msg_hdr_t *hdr,
+    const gnut_vmsg_t *vm, void *arg) {
+
+    peer_t *p;
+
+    if ((p = find_peer((relay_t *)arg, from)) != NULL) {
+        gnut_caps_vmsg(gnut_conn_caps(p->conn), vm);
+    }
+}
+
+/* Tells a peer that speaks Vendor Messages which ones are handled. */
+static void send_supported(relay_t *r, peer_t *p) {
+    unsigned char pl[SUPPORTED_LEN];
+    gnut_msg_hdr_t hdr;
+    gnut_enc_msg_t *m;
+    sxs_uint32_t pl_len;
+
+    if (gnut_vmsg_build_supported(vmsgs, pl, sizeof(pl), &pl_len) !=
+        GNUT_SUCCESS ||
+        gnut_build_msg_hdr(&hdr, GNUT_MSG_VENDOR, pl_len) != GNUT_SUCCESS) {
+        return;
+    }
+    hdr.ttl = 1;
+    if (gnut_enc_msg_encode(&m, &hdr, pl) != GNUT_SUCCESS) {
+        r->enc_failed++;
+        return;
+    }
+    gnut_conn_send(p->conn, m);
+    gnut_enc_msg_unref(m);
+}
+
+/* Remembers the host a Pong advertises, to dial it now or later. */
+static void learn_pong(relay_t *r, const unsigned char *payload,
+    sxs_uint32_t len) {
+
+    gnut_pong_payload_t pong;
+
+    if ((r->hc == NULL && r->dialer == NULL) ||
+        _gnut_parse_pong_msg_payload(&pong, (unsigned char *)payload,
+        len) != 0) {
+        return;
+    }
+    if (r->hc != NULL) {
+        gnut_hostcache_put_pong(r->hc, &pong);
+    }
+    if (r->dialer != NULL) {
+        gnut_dialer_add_pong(r->dialer, &pong, gnut_evloop_now(r->loop));
+    }
+}
+
+static void on_msg(gnut_conn_t *c, const gnut_msg_hdr_t *hdr,
+    const unsigned char *raw, const unsigned char *payload, void *arg) {
+
+    relay_t *r;
+    peer_t *p;
+
+    r = (relay_t *)arg;
+    p = (peer_t *)gnut_conn_user(c);
+    if (hdr->type == GNUT_MSG_PONG) {
+        learn_pong(r, payload, hdr->pl_len);
+    }
+    if (r->node.qdedupe != NULL) {
+        gnut_qdedupe_tick(&r->qd, gnut_evloop_now(r->loop));
+    }
+    gnut_node_dispatch(&r->node, p->id, hdr, payload);
+}
+
+static void on_up(gnut_conn_t *c, void *arg) {
+    relay_t *r;
+    peer_t *p;
+    sxs_uint32_t slot;
+
+    r = (relay_t *)arg;
+    slot = r->free_slots[--r->num_free];
+    p = &r->peers[slot];
+    if (++r->gen > 0xffff) {
+        r->gen = 1;
+    }
+    p->conn = c;
+    p->id = (r->gen << 16) | slot;
+    p->live_idx = r->num_live;
+    r->live[r->num_live++] = slot;
+    gnut_conn_set_user(c, p);
+    if (r->cap != NULL) {
+        gnut_conn_capture(c, r->cap, p->id);
+    }
+    if (gnut_conn_caps(c)->flags & GNUT_CAPS_VENDOR_MSGS) {
+        send_supported(r, p);
+    }
+}
+
+static void on_close(gnut_conn_t *c, gnut_error_t reason, void *arg) {
+    relay_t *r;
+
+    r = (relay_t *)arg;
+    if (gnut_conn_user(c) == NULL) {
+        r->hs_failed++;
+    }
+    release_peer(r, c);
+}
+
+static void on_up_out(gnut_conn_t *c, void *arg) {
+    relay_t *r;
+    peer_t *p;
+    sxs_uint32_t ip;
+    sxs_uint16_t port;
+
+    r = (relay_t *)arg;
+    on_up(c, arg);
+    p = (peer_t *)gnut_conn_user(c);
+    p->outgoing = 1;
+    r->num_out++;
+    gnut_conn_peer(c, &ip, &port);
+    gnut_dialer_handshake_done(r->dialer, ip, port, 1);
+}
+
+static void on_close_out(gnut_conn_t *c, gnut_error_t reason, void *arg) {
+    relay_t *r;
+    sxs_uint32_t ip;
+    sxs_uint16_t port;
+
+    r = (relay_t *)arg;
+    if (gnut_conn_user(c) == NULL) {
+        gnut_conn_peer(c, &ip, &port);
+        gnut_dialer_handshake_done(r->dialer, ip, port, 0);
+    }
+    on_close(c, reason, arg);
+}
+
+/* Takes a socket the dialer connected and handshakes on it. */
+static void on_dialed(gnut_dialer_t *d, sxs_socket_t sd,
+    const struct sockaddr_in *addr, void *arg) {
+
+    relay_t *r;
+    gnut_conn_t *c;
+    int on;
+
+    r = (relay_t *)arg;
+    if (r->num_open >= r->max_conns) {
+        sxs_close(sd);
+        gnut_dialer_handshake_done(d, addr->sin_addr.s_addr,
+            sxs_ntohs(addr->sin_port), 0);
+        return;
+    }
+    on = 1;
+    sxs_setsockopt(sd, IPPROTO_TCP, TCP_NODELAY, (sxs_buf_t)&on,
+        sizeof(on));
+    if (gnut_conn_new(&c, r->loop, sd, addr, &r->occfg) != GNUT_SUCCESS) {
+        gnut_dialer_handshake_done(d, addr->sin_addr.s_addr,
+            sxs_ntohs(addr->sin_port), 0);
+        return;
+    }
+    r->num_open++;
+    r->dialed++;
+}
+
+static void on_dial_result(gnut_dialer_t *d, const gnut_dial_host_t *host,
+    int ok, void *arg) {
+
+    relay_t *r;
+
+    r = (relay_t *)arg;
+    if (r->hc != NULL) {
+        gnut_hostcache_result(r->hc, host, ok);
+    }
+}
+
+static void on_http(gnut_conn_t *c, sxs_socket_t sd, const char *data,
+    sxs_uint32_t len, void *arg) {
+
+    relay_t *r;
+
+    r = (relay_t *)arg;
+    r->num_open--;
+    r->http++;
+    gnut_metrics_adopt(r->metrics, sd, data, len);
+}
+
+static void on_accept(gnut_shard_t *shard, sxs_socket_t sd,
+    const struct sockaddr_in *addr, void *arg) {
+
+    relay_t *r;
+    gnut_conn_t *c;
+    int on;
+
+    r = &relays[gnut_shard_id(shard)];
+    if (r->num_open >= r->max_conns) {
+        r->rejected++;
+        sxs_close(sd);
+        return;
+    }
+    on = 1;
+    sxs_setsockopt(sd, IPPROTO_TCP, TCP_NODELAY, (sxs_buf_t)&on,
+        sizeof(on));
+    if (gnut_conn_new(&c, r->loop, sd, addr, &r->ccfg) != GNUT_SUCCESS) {
+        r->rejected++;
+        return;
+    }
+    r->num_open++;
+    r->accepted++;
+}
+
+static void print_stats(relay_t *r) {
+    gnut_node_stats_t *st;
+    gnut_uint64_t rx;
+    double secs;
+    int t;
+
+    st = &r->node.stats;
+    rx = 0;
+    for (t = 0; t < GNUT_NODE_NUM_T; t++) {
+        rx += st->rx[t];
+    }
+    secs = (gnut_time_us() - opts.started) / 1e6;
+    if (num_relays > 1) {
+        printf("relayd\tshard=%d", r->id);
+    } else {
+        printf("relayd");
+    }
+    printf("\tsecs=%.1f\tconns=%u\topen=%u\tout=%u\taccepted=%llu"
+        "\tdialed=%llu"
+        "\trejected=%llu\ths_failed=%llu\thttp=%llu\tclosed=%llu"
+        "\trx_msgs=%llu"
+        "\tfwd_copies=%llu\tshed=%llu\tpruned=%llu\tdup=%llu\tttl=%llu"
+        "\tunroutable=%llu"
+        "\tmalformed=%llu\trepeat=%llu\trepeat_bytes=%llu"
+        "\tdeflate_mem=%u\txfwd=%llu\txshed=%llu\n", secs,
+        r->num_live, r->num_open, r->num_out,
+        (unsigned long long)r->accepted, (unsigned long long)r->dialed,
+        (unsigned long long)r->rejected,
+        (unsigned long long)r->hs_failed, (unsigned long long)r->http,
+        (unsigned long long)r->closed,
+        (unsigned long long)rx, (unsigned long long)r->fwd_copies,
+        (unsigned long long)r->shed, (unsigned long long)r->pruned,
+        (unsigned long long)st->dropped_dup,
+        (unsigned long long)st->dropped_ttl,
+        (unsigned long long)st->dropped_unroutable,
+        (unsigned long long)st->dropped_malformed,
+        (unsigned long long)st->dropped_repeat,
+        (unsigned long long)r->qd.stats.bytes_saved, r->zbudget.used,
+        (unsigned long long)r->xfwd, (unsigned long long)r->xshed);
+    fflush(stdout);
+}
+
+static void stats_cb(gnut_evloop_t *loop, void *arg) {
+    relay_t *r;
+
+    r = (relay_t *)arg;
+    print_stats(r);
+    gnut_evloop_timer_start(loop, &r->stats_timer, opts.interval, stats_cb,
+        r);
+}
+
+static sxs_socket_t open_listener(const char *addr_str, int port) {
+    struct sockaddr_in addr;
+    sxs_socket_t sd;
+    int on;
+
+    if (sxs_socket(AF_INET, SOCK_STREAM, 0, &sd) != SXS_SUCCESS) {
+        return -1;
+    }
+    on = 1;
+    sxs_setsockopt(sd, SOL_SOCKET, SO_REUSEADDR, (sxs_buf_t)&on,
+        sizeof(on));
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = sxs_htons((sxs_uint16_t)port);
+    addr.sin_addr.s_addr = sxs_inet_addr(addr_str);
+    if (sxs_bind(sd, (const struct sockaddr *)&addr, sizeof(addr)) !=
+        SXS_SUCCESS || sxs_listen(sd, 1024) != SXS_SUCCESS ||
+        sxs_set_nonblock(sd, 1) != SXS_SUCCESS) {
+        sxs_close(sd);
+        return -1;
+    }
+    return sd;
+}
+
+/* Parses "a.b.c.d:port" into a network order address and a port. */
+static int parse_host(const char *str, sxs_uint32_t *p_ip,
+    sxs_uint16_t *p_port) {
+
+    char buf[16];
+    const char *colon;
+    int port;
+
+    colon = strchr(str, ':');
+    if (colon == NULL || colon - str >= (int)sizeof(buf)) {
+        return 0;
+    }
+    memcpy(buf, str, colon - str);
+    buf[colon - str] = '\0';
+    port = atoi(colon + 1);
+    *p_ip = (sxs_uint32_t)sxs_inet_addr(buf);
+    if (port <= 0 || port > 0xffff || *p_ip == 0 ||
+        *p_ip == (sxs_uint32_t)-1) {
+        return 0;
+    }
+    *p_port = (sxs_uint16_t)port;
+    return 1;
+}
+
+static void raise_fd_limit(void) {
+    struct rlimit rl;
+
+    if (getrlimit(RLIMIT_NOFILE, &rl) == 0 && rl.rlim_cur < rl.rlim_max) {
+        rl.rlim_cur = rl.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &rl);
+    }
+}
+
+/* Sets up the relay of 'shard' on its own thread. */
+static gnut_error_t start_relay(gnut_shard_t *shard, void *arg) {
+    relay_t *r;
+    gnut_dialer_cfg_t dcfg;
+    sxs_uint32_t i;
+
+    r = &relays[gnut_shard_id(shard)];
+    r->id = gnut_shard_id(shard);
+    r->rt = gnut_shard_runtime(shard);
+    r->loop = gnut_shard_loop(shard);
+    r->max_conns = opts.max_conns;
+    r->peers = (peer_t *)calloc(r->max_conns, sizeof(peer_t));
+    r->live = (sxs_uint32_t *)calloc(r->max_conns, sizeof(sxs_uint32_t));
+    r->free_slots = (sxs_uint32_t *)calloc(r->max_conns,
+        sizeof(sxs_uint32_t));
+    if (r->peers == NULL || r->live == NULL || r->free_slots == NULL ||
+        gnut_metrics_new(&r->metrics, r->loop) != GNUT_SUCCESS ||
+        gnut_node_init(&r->node, opts.route_capacity, on_forward,
+        on_deliver, r) != GNUT_SUCCESS) {
+        fprintf(stderr, "out of memory\n");
+        failed = 1;
+        return GNUT_ENOMEM;
+    }
+    for (i = 0; i < r->max_conns; i++) {
+        r->free_slots[r->num_free++] = r->max_conns - 1 - i;
+    }
+    if (opts.qcfg.window > 0) {
+        if (gnut_qdedupe_init(&r->qd, &opts.qcfg, opts.started) !=
+            GNUT_SUCCESS) {
+            fprintf(stderr, "out of memory\n");
+            failed = 1;
+            return GNUT_ENOMEM;
+        }
+        gnut_node_set_qdedupe(&r->node, &r->qd);
+    }
+    gnut_node_set_vmsgs(&r->node, vmsgs);
+    r->cap = opts.cap;
+    r->hc = opts.hc;
+
+    gnut_hs_tmpl_init(&r->tmpl, GNUT_HS_OK_LINE);
+    gnut_hs_tmpl_add_hdr(&r->tmpl, "User-Agent", "gnut_relayd");
+    gnut_hs_tmpl_add_hdr(&r->tmpl, "X-Ultrapeer", "True");
+    gnut_hs_tmpl_add_hdr(&r->tmpl, "Vendor-Message", "0.1");
+    gnut_shaper_init(&r->shaper, &opts.scfg, opts.started);
+    r->ccfg = opts.ccfg;
+    r->ccfg.shaper = &r->shaper;
+    r->ccfg.deflate_budget = &r->zbudget;
+    r->ccfg.tmpl = &r->tmpl;
+    r->ccfg.on_up = on_up;
+    r->ccfg.on_msg = on_msg;
+    r->ccfg.on_close = on_close;
+    r->ccfg.on_http = on_http;
+    r->ccfg.arg = r;
+
+    gnut_hs_tmpl_init(&r->otmpl, GNUT_HS_CONNECT_LINE);
+    gnut_hs_tmpl_add_hdr(&r->otmpl, "User-Agent", "gnut_relayd");
+    gnut_hs_tmpl_add_hdr(&r->otmpl, "X-Ultrapeer", "True");
+    gnut_hs_tmpl_add_hdr(&r->otmpl, "Vendor-Message", "0.1");
+    r->occfg = r->ccfg;
+    r->occfg.outgoing = 1;
+    r->occfg.tmpl = &r->otmpl;
+    r->occfg.on_up = on_up_out;
+    r->occfg.on_close = on_close_out;
+    r->occfg.on_http = NULL;
+
+    gnut_timer_init(&r->stats_timer);
+    r->ready = 1;
+
+    if (r->id == 0 && opts.msd >= 0 &&
+        gnut_metrics_listen(r->metrics, opts.msd) != GNUT_SUCCESS) {
+        fprintf(stderr, "cannot serve metrics\n");
+        failed = 1;
+        return GNUT_EEVLOOP;
+    }
+    if (r->id == 0 && opts.want_out > 0) {
+        r->want_out = opts.want_out;
+        gnut_dialer_cfg_init(&dcfg);
+        dcfg.on_connected = on_dialed;
+        dcfg.on_result = on_dial_result;
+        dcfg.arg = r;
+        if (gnut_dialer_new(&r->dialer, r->loop, &dcfg) != GNUT_SUCCESS) {
+            fprintf(stderr, "out of memory\n");
+            failed = 1;
+            return GNUT_ENOMEM;
+        }
+        if (r->hc != NULL) {
+            gnut_hostcache_feed_dialer(r->hc, r->dialer);
+        }
+        gnut_dialer_set_needed(r->dialer, r->want_out);
+    }
+
+    if (opts.interval > 0) {
+        gnut_evloop_timer_start(r->loop, &r->stats_timer, opts.interval,
+            stats_cb, r);
+    }
+
+    return GNUT_SUCCESS;
+}
+
+/* Closes what the relay of a joined shard holds on its event loop. */
+static void stop_relay(relay_t *r) {
+    gnut_evloop_timer_stop(r->loop, &r->stats_timer);
+    while (r->num_live > 0) {
+        gnut_conn_close(r->peers[r->live[r->num_live - 1]].conn);
+        r->num_live--;
+    }
+    if (r->dialer != NULL) {
+        gnut_dialer_free(r->dialer);
+    }
+    gnut_metrics_free(r->metrics);
+    gnut_node_destroy(&r->node);
+    if (r->node.qdedupe != NULL) {
+        gnut_qdedupe_destroy(&r->qd);
+    }
+    free(r->peers);
+    free(r->live);
+    free(r->free_slots);
+}
+
+int main(int argc, char *argv[]) {
+    gnut_runtime_cfg_t rcfg;
+    gnut_runtime_t *rt;
+    gnut_error_t err;
+    const char *addr, *cap_path, *hc_path, *seed;
+    sxs_uint32_t max_conns, seed_ip;
+    sxs_uint16_t seed_port;
+    gnut_uint64_t duration;
+    int port, metrics_port, num_shards, c, i;
+
+    addr = "127.0.0.1";
+    cap_path = NULL;
+    hc_path = NULL;
+    seed = NULL;
+    seed_ip = 0;
+    seed_port = 0;
+    port = 6346;
+    metrics_port = 0;
+    num_shards = 1;
+    duration = 0;
+    max_conns = 16384;
+    memset(&opts, 0, sizeof(opts));
+    opts.msd = -1;
+    gnut_conn_cfg_init(&opts.ccfg);
+    gnut_shaper_cfg_init(&opts.scfg);
+    gnut_qdedupe_cfg_init(&opts.qcfg);
+    opts.qcfg.window = 0;
+    while ((c = getopt(argc, argv,
+        "a:p:c:d:i:R:H:M:w:S:B:Q:K:D:zC:P:O:T:")) != -1) {
+        switch (c) {
+            case 'a':
+                addr = optarg;
+                break;
+            case 'p':
+                port = atoi(optarg);
+                break;
+            case 'c':
+                max_conns = (sxs_uint32_t)atol(optarg);
+                break;
+            case 'd':
+                duration = (gnut_uint64_t)(atof(optarg) * 1e6);
+                break;
+            case 'i':
+                opts.interval = (gnut_uint64_t)(atof(optarg) * 1e6);
+                break;
+            case 'R':
+                opts.route_capacity = (sxs_uint32_t)atol(optarg);
+                break;
+            case 'H':
+                opts.ccfg.outq.hi_water = (sxs_uint32_t)atol(optarg);
+                opts.ccfg.outq.lo_water = opts.ccfg.outq.hi_water / 2;
+                break;
+            case 'M':
+                opts.ccfg.outq.max_bytes = (sxs_uint32_t)atol(optarg);
+                break;
+            case 'w':
+                cap_path = optarg;
+                break;
+            case 'S':
+                metrics_port = atoi(optarg);
+                break;
+            case 'B':
+                opts.scfg.rate = (gnut_uint64_t)atof(optarg);
+                break;
+            case 'Q':
+                opts.scfg.bulk_rate = (gnut_uint64_t)atof(optarg);
+                break;
+            case 'K':
+                opts.ccfg.rate = (gnut_uint64_t)atof(optarg);
+                break;
+            case 'D':
+                opts.qcfg.window = (gnut_uint64_t)(atof(optarg) * 1e6);
+                break;
+            case 'z':
+                opts.ccfg.deflate = 1;
+                break;
+            case 'C':
+                hc_path = optarg;
+                break;
+            case 'P':
+                seed = optarg;
+                break;
+            case 'O':
+                opts.want_out = (sxs_uint32_t)atol(optarg);
+                break;
+            case 'T':
+                num_shards = atoi(optarg);
+                break;
+            default:
+                optind = argc + 1;
+                break;
+        }
+    }
+    if (optind != argc || max_conns == 0 || max_conns > MAX_SLOTS ||
+        opts.want_out > max_conns || num_shards < 0 ||
+        num_shards > GNUT_SHARD_MAX ||
+        (cap_path != NULL && num_shards != 1) ||
+        (seed != NULL && (hc_path == NULL ||
+        !parse_host(seed, &seed_ip, &seed_port)))) {
+        fprintf(stderr, "usage: %s [-a addr] [-p port] [-c max_conns] "
+            "[-d secs] [-i secs] [-R route_capacity] [-H hi_water] "
+            "[-M max_bytes] [-w capture] [-S metrics_port] [-B rate] "
+            "[-Q bulk_rate] [-K conn_rate] [-D dedupe_secs] [-z] "
+            "[-C host_cache] [-P addr:port] [-O outgoing] [-T shards]\n",
+            argv[0]);
+        return 2;
+    }
+
+    raise_fd_limit();
+    signal(SIGPIPE, SIG_IGN);
+    signal(SIGINT, on_signal);
+    signal(SIGTERM, on_signal);
+
+    gnut_runtime_cfg_init(&rcfg);
+    rcfg.num_shards = num_shards;
+    rcfg.pin_threads = (num_shards != 1);
+    rcfg.listen = 1;
+    rcfg.listen_addr.sin_port = sxs_htons((sxs_uint16_t)port);
+    rcfg.listen_addr.sin_addr.s_addr = sxs_inet_addr(addr);
+    rcfg.backlog = 1024;
+    rcfg.on_start = start_relay;
+    rcfg.on_accept = on_accept;
+    rcfg.on_forward = on_xmsg;
+    err = gnut_runtime_new(&rt, &rcfg);
+    if (err == GNUT_ESOCKET) {
+        fprintf(stderr, "%s:%d: cannot listen\n", addr, port);
+        return 1;
+    } else if (err != GNUT_SUCCESS) {
+        fprintf(stderr, "cannot create shards\n");
+        return 1;
+    }
+    num_relays = gnut_runtime_num_shards(rt);
+    relays = (relay_t *)calloc(num_relays, sizeof(relay_t));
+    if (relays == NULL) {
+        fprintf(stderr, "out of memory\n");
+        return 1;
+    }
+
+    /* Split the limits of the whole relay between the shards. */
+    opts.max_conns = (max_conns + num_relays - 1) / num_relays;
+    opts.scfg.rate /= num_relays;
+    opts.scfg.bulk_rate /= num_relays;
+
+    vmsgs[GNUT_VMSG_K_SUPPORTED] = on_caps;
+    vmsgs[GNUT_VMSG_K_HOPS_FLOW] = on_caps;
+
+    opts.started = gnut_time_us();
+    if (cap_path != NULL && gnut_capture_create(&opts.cap, cap_path,
+        opts.started) != GNUT_SUCCESS) {
+        fprintf(stderr, "%s: cannot create capture\n", cap_path);
+        return 1;
+    }
+    if (hc_path != NULL) {
+        if (gnut_hostcache_open(&opts.hc, hc_path, 0) != GNUT_SUCCESS) {
+            fprintf(stderr, "%s: cannot open host cache\n", hc_path);
+            return 1;
+        }
+        if (seed != NULL) {
+            gnut_hostcache_put(opts.hc, seed_ip, seed_port, 0, 0);
+        }
+    }
+    if (metrics_port > 0) {
+        opts.msd = open_listener(addr, metrics_port);
+        if (opts.msd < 0) {
+            fprintf(stderr, "%s:%d: cannot listen\n", addr, metrics_port);
+            return 1;
+        }
+    }
+
+    if (gnut_runtime_start(rt) != GNUT_SUCCESS) {
+        fprintf(stderr, "cannot start shards\n");
+        return 1;
+    }
+    while (!stopping && !failed && (duration == 0 ||
+        gnut_time_us() - opts.started < duration)) {
+        usleep(100000);
+    }
+    gnut_runtime_stop(rt);
+    gnut_runtime_join(rt);
+    if (failed) {
+        return 1;
+    }
+
+    for (i = 0; i < num_relays; i++) {
+        print_stats(&relays[i]);
+        stop_relay(&relays[i]);
+    }
+    if (opts.hc != NULL) {
+        gnut_hostcache_close(opts.hc);
+    }
+    if (opts.cap != NULL) {
+        gnut_capture_close(opts.cap);
+    }
+    gnut_runtime_free(rt);
+    free(relays);
+
+    return 0;
+}
@@ -0,0 +1,325 @@
+/*
+ * Copyright 2006-2007 Andrew De Ponte
+ *
+ * This file is part of lib_gnut.
+ *
+ * lib_gnut is the intellectual property of Andrew De Ponte; any
+ * distribution and/or modification and/or reproductions of any portion
+ * of lib_gnut MUST be approved by Andrew De Ponte.
+ *
+ * lib_gnut is distributed WITHOUT ANY WARRANTY; without even the
+ * implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE.
+ */
+
+/**
+ * @file gnut_replay.c
+ * @brief This is a tool which replays capture files through the node.
+ *
+ * The gnut_replay.c file is a program that reads a capture file into
+ * memory and feeds every connection's bytes through its own framer and
+ * then a shared node, as fast as it can, ignoring the recorded times.
+ * Forwarded messages have their headers encoded, as a relay would,
+ * but go nowhere. It prints tab separated key=value lines: the
+ * throughput, the heap allocations made while replaying, and the
+ * count, size and fate of each message type.
+ *
+ * usage: gnut_replay [-r repeat] [-m max_pl_len] [-R route_capacity]
+ *     capture
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h> /* getopt() */
+
+#include "gnut_capture.h"
+#include "gnut_framer.h"
+#include "gnut_node.h"
+
+#ifdef __GLIBC__
+/* Counting every heap allocation made by the library means replacing
+ * malloc() for the whole process, which glibc allows by forwarding to
+ * its own entry points. */
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t nmemb, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+
+static unsigned long long num_allocs = 0;
+static unsigned long long alloc_bytes = 0;
+
+void *malloc(size_t size) {
+    num_allocs++;
+    alloc_bytes += size;
+    return __libc_malloc(size);
+}
+
+void *calloc(size_t nmemb, size_t size) {
+    num_allocs++;
+    alloc_bytes += nmemb * size;
+    return __libc_calloc(nmemb, size);
+}
+
+void *realloc(void *ptr, size_t size) {
+    num_allocs++;
+    alloc_bytes += size;
+    return __libc_realloc(ptr, size);
+}
+#define ALLOCS_COUNTED 1
+#else
+static unsigned long long num_allocs = 0;
+static unsigned long long alloc_bytes = 0;
+#define ALLOCS_COUNTED 0
+#endif
+
+static const char *type_names[GNUT_NODE_NUM_T] = {
+    "ping", "pong", "bye", "push", "query", "query_hit", "other"
+};
+
+typedef struct replay_conn {
+    gnut_framer_t framer;
+    int open;
+} replay_conn_t;
+
+typedef struct replay {
+    gnut_node_t node;
+    replay_conn_t *conns;
+    sxs_uint32_t num_conns;
+    sxs_uint32_t cur;           /* Node id of the connection being fed */
+    sxs_uint32_t max_pl_len;
+    gnut_uint64_t bytes;
+    gnut_uint64_t frame_errors;
+    gnut_uint64_t fwd_bytes;
+    gnut_uint64_t copied;       /* Bytes framers had to buffer */
+    gnut_uint64_t conns_seen;
+    unsigned char scratch[GNUT_MSG_HDR_LEN];
+} replay_t;
+
+static double now_sec(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void on_forward(gnut_node_t *node, sxs_uint32_t to, sxs_uint32_t from,
+    const gnut_msg_hdr_t *hdr, const unsigned char *payload, void *arg) {
+
+    replay_t *r;
+
+    r = (replay_t *)arg;
+    gnut_encode_msg_hdr(hdr, r->scratch);
+    r->fwd_bytes += GNUT_MSG_HDR_LEN + hdr->pl_len;
+}
+
+static void on_msg(const gnut_msg_hdr_t *hdr, const unsigned char *raw,
+    const unsigned char *payload, void *arg) {
+
+    replay_t *r;
+
+    r = (replay_t *)arg;
+    gnut_node_dispatch(&r->node, r->cur, hdr, payload);
+}
+
+static replay_conn_t *get_conn(replay_t *r, sxs_uint32_t conn) {
+    replay_conn_t *conns;
+    sxs_uint32_t num;
+
+    if (conn >= r->num_conns) {
+        num = (r->num_conns > 0) ? r->num_conns : 64;
+        while (num <= conn) {
+            num *= 2;
+        }
+        conns = (replay_conn_t *)realloc(r->conns,
+            num * sizeof(replay_conn_t));
+        if (conns == NULL) {
+            fprintf(stderr, "out of memory\n");
+            exit(1);
+        }
+        memset(conns + r->num_conns, 0,
+            (num - r->num_conns) * sizeof(replay_conn_t));
+        r->conns = conns;
+        r->num_conns = num;
+    }
+
+    return &r->conns[conn];
+}
+
+static void close_conn(replay_t *r, replay_conn_t *c) {
+    if (c->open) {
+        r->copied += c->framer.copied;
+        gnut_framer_destroy(&c->framer);
+        c->open = 0;
+    }
+}
+
+/* Replays the capture once. Returns the capture's duration in us. */
+static gnut_uint64_t replay_once(replay_t *r, gnut_capture_t *cap) {
+    gnut_cap_rec_t rec;
+    replay_conn_t *c;
+    gnut_uint64_t first, last;
+    gnut_error_t err;
+    int have_first;
+
+    gnut_capture_rewind(cap);
+    have_first = 0;
+    first = last = 0;
+    while ((err = gnut_capture_next(cap, &rec)) == GNUT_SUCCESS) {
+        if (!have_first) {
+            first = rec.when;
+            have_first = 1;
+        }
+        last = rec.when;
+
+        c = get_conn(r, rec.conn);
+        switch (rec.kind) {
+            case GNUT_CAP_OPEN:
+                close_conn(r, c);
+                gnut_framer_init(&c->framer, r->max_pl_len);
+                c->open = 1;
+                r->conns_seen++;
+                break;
+            case GNUT_CAP_DATA:
+                if (!c->open) {
+                    /* The capture began after this connection did. */
+                    gnut_framer_init(&c->framer, r->max_pl_len);
+                    c->open = 1;
+                    r->conns_seen++;
+                }
+                r->bytes += rec.len;
+                r->cur = rec.conn + 1;
+                if (gnut_framer_feed(&c->framer, rec.data, rec.len, on_msg,
+                    r) != GNUT_SUCCESS) {
+                    r->frame_errors++;
+                    close_conn(r, c);
+                }
+                break;
+            default:
+                close_conn(r, c);
+                break;
+        }
+    }
+    if (err != GNUT_EEOF) {
+        fprintf(stderr, "capture is truncated or malformed\n");
+    }
+
+    return last - first;
+}
+
+int main(int argc, char *argv[]) {
+    gnut_capture_t *cap;
+    gnut_node_stats_t *st;
+    replay_t r;
+    sxs_uint32_t route_capacity, i;
+    gnut_uint64_t msgs, cap_us;
+    unsigned long long allocs, allocs0, bytes_allocd, alloc_bytes0;
+    double start, elapsed;
+    int repeat, n, t, c;
+
+    repeat = 1;
+    route_capacity = 0;
+    memset(&r, 0, sizeof(r));
+    while ((c = getopt(argc, argv, "r:m:R:")) != -1) {
+        switch (c) {
+            case 'r':
+                repeat = atoi(optarg);
+                break;
+            case 'm':
+                r.max_pl_len = (sxs_uint32_t)atol(optarg);
+                break;
+            case 'R':
+                route_capacity = (sxs_uint32_t)atol(optarg);
+                break;
+            default:
+                optind = argc;
+                break;
+        }
+    }
+    if (optind != argc - 1 || repeat < 1) {
+        fprintf(stderr, "usage: %s [-r repeat] [-m max_pl_len] "
+            "[-R route_capacity] capture\n", argv[0]);
+        return 2;
+    }
+
+    if (gnut_capture_open(&cap, argv[optind]) != GNUT_SUCCESS) {
+        fprintf(stderr, "%s: cannot read capture\n", argv[optind]);
+        return 1;
+    }
+
+    /* Each pass starts with fresh routing tables, or every message of
+     * the second would be a duplicate. Setting them up is neither timed
+     * nor counted, so the statistics below are those of the last pass
+     * and the allocations are only those made while replaying. */
+    elapsed = 0;
+    cap_us = 0;
+    allocs = bytes_allocd = 0;
+    for (n = 0; n < repeat; n++) {
+        if (n > 0) {
+            for (i = 0; i < r.num_conns; i++) {
+                close_conn(&r, &r.conns[i]);
+            }
+            gnut_node_destroy(&r.node);
+        }
+        if (gnut_node_init(&r.node, route_capacity, on_forward, NULL,
+            &r) != GNUT_SUCCESS) {
+            fprintf(stderr, "out of memory\n");
+            return 1;
+        }
+        allocs0 = num_allocs;
+        alloc_bytes0 = alloc_bytes;
+        start = now_sec();
+        cap_us = replay_once(&r, cap);
+        elapsed += now_sec() - start;
+        allocs += num_allocs - allocs0;
+        bytes_allocd += alloc_bytes - alloc_bytes0;
+    }
+    for (i = 0; i < r.num_conns; i++) {
+        close_conn(&r, &r.conns[i]);
+    }
+
+    st = &r.node.stats;
+    msgs = 0;
+    for (t = 0; t < GNUT_NODE_NUM_T; t++) {
+        msgs += st->rx[t];
+    }
+
+    printf("replay\tfile=%s\trepeat=%d\tconns=%llu\tbytes=%llu\tmsgs=%llu"
+        "\tcapture_secs=%.3f\telapsed_secs=%.6f\tmb_per_sec=%.1f"
+        "\tmsgs_per_sec=%.0f\tns_per_msg=%.1f\tframe_errors=%llu"
+        "\tframer_copied=%llu\tfwd_bytes=%llu\n", argv[optind], repeat,
+        (unsigned long long)r.conns_seen, (unsigned long long)r.bytes,
+        (unsigned long long)msgs * repeat, cap_us / 1e6, elapsed,
+        r.bytes / elapsed / 1e6, msgs * repeat / elapsed,
+        elapsed * 1e9 / (msgs * repeat > 0 ? msgs * repeat : 1),
+        (unsigned long long)r.frame_errors, (unsigned long long)r.copied,
+        (unsigned long long)r.fwd_bytes);
+    if (ALLOCS_COUNTED) {
+        printf("replay_allocs\tallocs=%llu\talloc_bytes=%llu"
+            "\tallocs_per_msg=%.4f\n", allocs, bytes_allocd,
+            (double)allocs / (msgs * repeat > 0 ? msgs * repeat : 1));
+    } else {
+        printf("replay_allocs\tallocs=n/a\n");
+    }
+    for (t = 0; t < GNUT_NODE_NUM_T; t++) {
+        printf("replay_type\ttype=%s\tmsgs=%llu\tbytes=%llu\tavg_len=%.1f"
+            "\tshare=%.4f\tforwarded=%llu\tdelivered=%llu\n", type_names[t],
+            (unsigned long long)st->rx[t],
+            (unsigned long long)st->rx_bytes[t],
+            st->rx[t] > 0 ? (double)st->rx_bytes[t] / st->rx[t] : 0.0,
+            msgs > 0 ? (double)st->rx[t] / msgs : 0.0,
+            (unsigned long long)st->forwarded[t],
+            (unsigned long long)st->delivered[t]);
+    }
+    printf("replay_drops\tdup=%llu\tttl=%llu\tunroutable=%llu"
+        "\tmalformed=%llu\n", (unsigned long long)st->dropped_dup,
+        (unsigned long long)st->dropped_ttl,
+        (unsigned long long)st->dropped_unroutable,
+        (unsigned long long)st->dropped_malformed);
+
+    free(r.conns);
+    gnut_node_destroy(&r.node);
+    gnut_capture_close(cap);
+
+    return 0;
+}
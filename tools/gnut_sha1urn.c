@@ -0,0 +1,122 @@
+/*
+ * Copyright 2006-2007 Andrew De Ponte
+ *
+ * This file is part of lib_gnut.
+ *
+ * lib_gnut is the intellectual property of Andrew De Ponte; any
+ * distribution and/or modification and/or reproductions of any portion
+ * of lib_gnut MUST be approved by Andrew De Ponte.
+ *
+ * lib_gnut is distributed WITHOUT ANY WARRANTY; without even the
+ * implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE.
+ */
+
+/**
+ * @file gnut_sha1urn.c
+ * @brief This is a tool which converts SHA-1 digests to urn:sha1 values.
+ *
+ * The gnut_sha1urn.c file is a program that reads one SHA-1 digest in
+ * hexadecimal per line of its standard input, as sha1sum prints them,
+ * and prints its urn:sha1 value. With -d it does the reverse, reading
+ * urn:sha1 values or bare base32 digests and printing hexadecimal. It
+ * replaces scripts/sha1_hash_encode.py.
+ *
+ * usage: gnut_sha1urn [-d]
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h> /* getopt() */
+
+#include "gnut_base32.h"
+
+#define LINE_LEN 1024
+
+static int hex_value(int ch) {
+    if (ch >= '0' && ch <= '9') {
+        return ch - '0';
+    }
+    if (ch >= 'a' && ch <= 'f') {
+        return ch - 'a' + 10;
+    }
+    if (ch >= 'A' && ch <= 'F') {
+        return ch - 'A' + 10;
+    }
+    return -1;
+}
+
+/* Reads the digest at the start of 'line', which sha1sum follows with
+ * the file name. */
+static int parse_hex(const char *line, unsigned char *sha1) {
+    int i, hi, lo;
+
+    for (i = 0; i < GNUT_SHA1_LEN; i++) {
+        hi = hex_value((unsigned char)line[i * 2]);
+        lo = (hi < 0) ? -1 : hex_value((unsigned char)line[i * 2 + 1]);
+        if (lo < 0) {
+            return 0;
+        }
+        sha1[i] = (unsigned char)(hi << 4 | lo);
+    }
+    return (line[GNUT_SHA1_LEN * 2] == '\0' ||
+        strchr(" \t", line[GNUT_SHA1_LEN * 2]) != NULL);
+}
+
+static int parse_urn(const char *line, unsigned char *sha1) {
+    size_t len;
+
+    len = strcspn(line, " \t");
+    if (len == GNUT_BASE32_SHA1_LEN) {
+        return gnut_base32_decode_sha1(line, sha1) == GNUT_SUCCESS;
+    }
+    return gnut_urn_sha1_parse(line, (sxs_uint32_t)len, sha1) ==
+        GNUT_SUCCESS;
+}
+
+int main(int argc, char *argv[]) {
+    char line[LINE_LEN], urn[GNUT_URN_SHA1_LEN];
+    unsigned char sha1[GNUT_SHA1_LEN];
+    int decode, bad, c, i;
+
+    decode = 0;
+    while ((c = getopt(argc, argv, "d")) != -1) {
+        switch (c) {
+            case 'd':
+                decode = 1;
+                break;
+            default:
+                optind = argc + 1;
+                break;
+        }
+    }
+    if (optind != argc) {
+        fprintf(stderr, "usage: %s [-d]\n", argv[0]);
+        return 1;
+    }
+
+    bad = 0;
+    while (fgets(line, sizeof(line), stdin) != NULL) {
+        line[strcspn(line, "\r\n")] = '\0';
+        if (line[0] == '\0') {
+            continue;
+        }
+        if (!(decode ? parse_urn(line, sha1) : parse_hex(line, sha1))) {
+            fprintf(stderr, "%s: not a %s\n", line,
+                decode ? "urn:sha1 value" : "SHA-1 digest");
+            bad = 1;
+            continue;
+        }
+        if (decode) {
+            for (i = 0; i < GNUT_SHA1_LEN; i++) {
+                printf("%02x", sha1[i]);
+            }
+            printf("\n");
+        } else {
+            gnut_urn_sha1_format(sha1, urn);
+            printf("%.*s\n", GNUT_URN_SHA1_LEN, urn);
+        }
+    }
+
+    return bad;
+}
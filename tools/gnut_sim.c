@@ -0,0 +1,1156 @@
+/*
+ * Copyright 2006-2007 Andrew De Ponte
+ *
+ * This file is part of lib_gnut.
+ *
+ * lib_gnut is the intellectual property of Andrew De Ponte; any
+ * distribution and/or modification and/or reproductions of any portion
+ * of lib_gnut MUST be approved by Andrew De Ponte.
+ *
+ * lib_gnut is distributed WITHOUT ANY WARRANTY; without even the
+ * implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE.
+ */
+
+/**
+ * @file gnut_sim.c
+ * @brief This is a deterministic network simulator.
+ *
+ * The gnut_sim.c file is a program that runs many nodes in one process
+ * over an in-memory transport and a virtual clock. It builds a random
+ * topology, gives each link a latency, and then issues Queries and
+ * Pings from random nodes at the given rates of virtual time. Every
+ * node answers Pings with a Pong and matches each Query it sees with
+ * the given probability, answering with a Query Hit, and an originator
+ * sends a Push for some of the hits it gets. Messages travel as shared
+ * encoded messages in a single event queue ordered by delivery time,
+ * and all randomness comes from the seed, so a run is reproduced
+ * exactly by the same arguments; the digest printed summarizes every
+ * delivery made so that runs can be compared.
+ *
+ * It prints tab separated key=value lines with the traffic, the
+ * success of Queries and Pushes, duplicate and routing drops, and the
+ * distribution over nodes of messages handled, routing table use and
+ * memory, and with -v a line per node.
+ *
+ * With -D each Query is searched for dynamically by its originator
+ * rather than flooded, until the given number of results come, waiting
+ * after each step for the round trip of the slowest links. A sim_dynq
+ * line then tells how the searches ended.
+ *
+ * With -O each Query asks for its Query Hits out of band: a node with a
+ * result offers it to the originator in a datagram sent straight to it,
+ * with the latency of a random link, and sends it the same way once
+ * asked for it. A sim_oob line then tells what went over UDP, to set
+ * against the Query Hits the overlay no longer carries.
+ *
+ * With -F the given fraction of nodes is busy: each sends its
+ * neighbours a Hops Flow of the given hops at the start, and drops the
+ * Queries that arrive with as many hops or more. The neighbours keep it
+ * with the capabilities of the link and stop queueing such Queries for
+ * it. A sim_caps line then tells how many copies were never sent, and
+ * how many still arrived to be dropped.
+ *
+ * usage: gnut_sim [-n nodes] [-d degree] [-s seed] [-T secs] [-q qps]
+ *     [-p pps] [-t ttl] [-h hit_prob] [-P push_prob] [-R route_capacity]
+ *     [-l min_ms:max_ms] [-D target] [-O] [-F frac:hops] [-v]
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h> /* getrusage() */
+#include <time.h>
+#include <unistd.h> /* getopt() */
+
+#include "gnut_enc_msg.h"
+#include "gnut_node.h"
+#include "gnut_dynq.h"
+#include "gnut_oob.h"
+#include "gnut_caps.h"
+#include "gnut_query.h"
+#include "gnut_twheel.h"
+#include "gnut_pong_msg.h"
+
+#define HIT_LEN 37              /* One result, two NULs, Servent ID */
+#define WHEEL_TICK 10000        /* Microseconds */
+#define OOB_PORT 6346           /* Node i is at address i + 1 */
+#define OOB_WANTED 150          /* Results each search asks for */
+
+static const char *type_names[GNUT_NODE_NUM_T] = {
+    "ping", "pong", "bye", "push", "query", "query_hit", "other"
+};
+
+typedef struct link {
+    sxs_uint32_t peer;          /* Node at the other end */
+    sxs_uint32_t rev;           /* Our conn id at the other end */
+    sxs_uint32_t lat;           /* Microseconds */
+} link_t;
+
+typedef struct event {
+    gnut_uint64_t when;
+    gnut_uint64_t seq;          /* Orders events due at the same time */
+    sxs_uint32_t node;
+    sxs_uint32_t from;          /* Conn id at the receiving node */
+    sxs_uint32_t udp_from;      /* Sending node plus one, for datagrams */
+    gnut_enc_msg_t *msg;
+} event_t;
+
+typedef struct query {
+    gnut_uint64_t sent;
+    gnut_uint64_t first_hit;    /* 0 until a hit arrives */
+    sxs_uint32_t hits;
+} query_t;
+
+typedef struct sim {
+    sxs_uint32_t num_nodes;
+    gnut_node_t *nodes;
+    gnut_dynq_t **dynqs;        /* NULL unless searching dynamically */
+    gnut_oob_t **oobs;          /* NULL unless replying out of band */
+    gnut_caps_t *caps;          /* Per link, NULL unless nodes are busy */
+    unsigned char *flows;       /* Hops Flow of each node */
+    gnut_twheel_t wheel;
+    int use_wheel;
+    sxs_uint32_t *link_off;     /* Links of node i are [off[i], off[i+1]) */
+    link_t *links;
+    sxs_uint32_t num_links;
+    event_t *heap;
+    sxs_uint32_t heap_len;
+    sxs_uint32_t heap_cap;
+    gnut_uint64_t seq;
+    gnut_uint64_t now;
+    sxs_uint32_t cur;           /* Node being dispatched to */
+    gnut_uint64_t rng;
+    gnut_uint64_t guid_seq;
+    query_t *queries;
+    sxs_uint32_t num_queries;
+    sxs_uint32_t queries_cap;
+    double hit_prob;
+    double push_prob;
+    gnut_uint64_t digest;
+    gnut_uint64_t events;
+    gnut_uint64_t max_heap;
+    gnut_uint64_t enc_msgs;
+    gnut_uint64_t pings;
+    gnut_uint64_t pongs_home;   /* Pongs back at the Ping's originator */
+    gnut_uint64_t hits_sent;
+    gnut_uint64_t hits_home;
+    gnut_uint64_t pushes;
+    gnut_uint64_t pushes_home;  /* Pushes at the servent they named */
+    gnut_uint64_t udp_msgs;
+    gnut_uint64_t udp_bytes;
+    sxs_uint32_t busy;
+    gnut_uint64_t pruned;       /* Copies over the limits of their link */
+    gnut_uint64_t pruned_bytes;
+    gnut_uint64_t flow_drops;   /* Queries busy nodes dropped on arrival */
+} sim_t;
+
+static gnut_vmsg_cb_t vmsgs[GNUT_VMSG_NUM_K];
+
+static gnut_uint64_t rnd(sim_t *s) {
+    s->rng ^= s->rng << 13;
+    s->rng ^= s->rng >> 7;
+    s->rng ^= s->rng << 17;
+    return s->rng;
+}
+
+static double rnd_unit(sim_t *s) {
+    return (rnd(s) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+static int ev_before(const event_t *a, const event_t *b) {
+    return a->when < b->when || (a->when == b->when && a->seq < b->seq);
+}
+
+static void heap_push(sim_t *s, const event_t *ev) {
+    event_t *heap, tmp;
+    sxs_uint32_t i, parent;
+
+    if (s->heap_len == s->heap_cap) {
+        s->heap_cap = (s->heap_cap > 0) ? s->heap_cap * 2 : 4096;
+        heap = (event_t *)realloc(s->heap, s->heap_cap * sizeof(event_t));
+        if (heap == NULL) {
+            fprintf(stderr, "out of memory\n");
+            exit(1);
+        }
+        s->heap = heap;
+    }
+    i = s->heap_len++;
+    s->heap[i] = *ev;
+    while (i > 0) {
+        parent = (i - 1) / 2;
+        if (!ev_before(&s->heap[i], &s->heap[parent])) {
+            break;
+        }
+        tmp = s->heap[i];
+        s->heap[i] = s->heap[parent];
+        s->heap[parent] = tmp;
+        i = parent;
+    }
+    if (s->heap_len > s->max_heap) {
+        s->max_heap = s->heap_len;
+    }
+}
+
+static void heap_pop(sim_t *s, event_t *ev) {
+    event_t tmp;
+    sxs_uint32_t i, l, m;
+
+    *ev = s->heap[0];
+    s->heap[0] = s->heap[--s->heap_len];
+    i = 0;
+    for (;;) {
+        l = 2 * i + 1;
+        if (l >= s->heap_len) {
+            break;
+        }
+        m = (l + 1 < s->heap_len && ev_before(&s->heap[l + 1], &s->heap[l]))
+            ? l + 1 : l;
+        if (!ev_before(&s->heap[m], &s->heap[i])) {
+            break;
+        }
+        tmp = s->heap[i];
+        s->heap[i] = s->heap[m];
+        s->heap[m] = tmp;
+        i = m;
+    }
+}
+
+/* Sends 'msg' from node 'node' over its link with conn id 'conn',
+ * unless the node at the other end has asked not to be sent it. */
+static void send_link(sim_t *s, sxs_uint32_t node, sxs_uint32_t conn,
+    gnut_enc_msg_t *msg) {
+
+    gnut_msg_hdr_t hdr;
+    event_t ev;
+    link_t *l;
+
+    l = &s->links[s->link_off[node] + conn - 1];
+    if (s->caps != NULL) {
+        gnut_decode_msg_hdr(msg->data, &hdr);
+        if (!gnut_caps_allows(&s->caps[l - s->links], &hdr)) {
+            s->pruned++;
+            s->pruned_bytes += msg->len;
+            return;
+        }
+    }
+    ev.when = s->now + l->lat;
+    ev.seq = s->seq++;
+    ev.node = l->peer;
+    ev.from = l->rev;
+    ev.udp_from = 0;
+    ev.msg = gnut_enc_msg_ref(msg);
+    heap_push(s, &ev);
+}
+
+static gnut_enc_msg_t *encode(sim_t *s, const gnut_msg_hdr_t *hdr,
+    const unsigned char *payload) {
+
+    gnut_enc_msg_t *msg;
+
+    if (gnut_enc_msg_encode(&msg, hdr, payload) != GNUT_SUCCESS) {
+        fprintf(stderr, "out of memory\n");
+        exit(1);
+    }
+    s->enc_msgs++;
+    return msg;
+}
+
+/* Bytes of a GUID holding its lead, little-endian, clear of those an
+ * address is encoded in, and the bytes holding random ones. */
+static const int lead_pos[8] = { 4, 5, 6, 7, 9, 10, 11, 12 };
+static const int rand_pos[8] = { 0, 1, 2, 3, 8, 13, 14, 15 };
+
+/* Builds a GUID holding 'lead' and random bytes. Queries are led by
+ * their index and everything else by a sequence number with the top
+ * bit set. */
+static void new_guid(sim_t *s, unsigned char *guid, gnut_uint64_t lead) {
+    gnut_uint64_t r;
+    int i;
+
+    r = rnd(s);
+    for (i = 0; i < 8; i++) {
+        guid[lead_pos[i]] = (unsigned char)(lead >> (8 * i));
+        guid[rand_pos[i]] = (unsigned char)(r >> (8 * i));
+    }
+}
+
+static gnut_uint64_t guid_lead(const unsigned char *guid) {
+    gnut_uint64_t lead;
+    int i;
+
+    lead = 0;
+    for (i = 7; i >= 0; i--) {
+        lead = (lead << 8) | guid[lead_pos[i]];
+    }
+    return lead;
+}
+
+/* Counts a Query Hit back at the originator of its Query. */
+static void count_hit(sim_t *s, const gnut_msg_hdr_t *hdr) {
+    query_t *q;
+    gnut_uint64_t qid;
+
+    s->hits_home++;
+    qid = guid_lead(hdr->message_id);
+    if (qid < s->num_queries) {
+        q = &s->queries[qid];
+        if (q->hits++ == 0) {
+            q->first_hit = s->now;
+        }
+    }
+}
+
+static void on_forward(gnut_node_t *node, sxs_uint32_t to, sxs_uint32_t from,
+    const gnut_msg_hdr_t *hdr, const unsigned char *payload, void *arg) {
+
+    sim_t *s;
+    gnut_enc_msg_t *msg;
+    sxs_uint32_t conn, num;
+
+    s = (sim_t *)arg;
+    msg = encode(s, hdr, payload);
+    if (to == GNUT_NODE_BROADCAST) {
+        num = s->link_off[s->cur + 1] - s->link_off[s->cur];
+        for (conn = 1; conn <= num; conn++) {
+            if (conn != from) {
+                send_link(s, s->cur, conn, msg);
+            }
+        }
+    } else {
+        send_link(s, s->cur, to, msg);
+    }
+    gnut_enc_msg_unref(msg);
+}
+
+/* Sends a step of a dynamic query from the node given as 'arg', which
+ * is not always the one being dispatched to. */
+static void on_dynq_send(gnut_dynq_t *dq, sxs_uint32_t to,
+    const gnut_msg_hdr_t *hdr, const unsigned char *payload, void *arg) {
+
+    gnut_node_t *node;
+    gnut_enc_msg_t *msg;
+    sim_t *s;
+
+    node = (gnut_node_t *)arg;
+    s = (sim_t *)node->arg;
+    msg = encode(s, hdr, payload);
+    send_link(s, (sxs_uint32_t)(node - s->nodes), to, msg);
+    gnut_enc_msg_unref(msg);
+}
+
+/* Sends a datagram from the node given as 'arg' straight to the node
+ * at 'ip', with the latency of a random link. */
+static void on_oob_send(gnut_oob_t *o, sxs_uint32_t ip, sxs_uint16_t port,
+    const unsigned char *dgram, sxs_uint32_t len, void *arg) {
+
+    gnut_node_t *node;
+    gnut_msg_hdr_t hdr;
+    event_t ev;
+    sim_t *s;
+
+    node = (gnut_node_t *)arg;
+    s = (sim_t *)node->arg;
+    if (ip == 0 || ip > s->num_nodes) {
+        return;
+    }
+    gnut_decode_msg_hdr(dgram, &hdr);
+    ev.when = s->now + s->links[rnd(s) % s->num_links].lat;
+    ev.seq = s->seq++;
+    ev.node = ip - 1;
+    ev.from = 0;
+    ev.udp_from = (sxs_uint32_t)(node - s->nodes) + 1;
+    ev.msg = encode(s, &hdr, dgram + GNUT_MSG_HDR_LEN);
+    heap_push(s, &ev);
+    s->udp_msgs++;
+    s->udp_bytes += len;
+}
+
+static void on_oob_deliver(gnut_oob_t *o, sxs_uint32_t ip, sxs_uint16_t port,
+    const gnut_msg_hdr_t *hdr, const unsigned char *payload, void *arg) {
+
+    gnut_node_t *node;
+    sim_t *s;
+
+    node = (gnut_node_t *)arg;
+    s = (sim_t *)node->arg;
+    count_hit(s, hdr);
+    /* The node never sees these, so dynamic queries are told here. */
+    if (s->dynqs != NULL) {
+        gnut_dynq_hit(s->dynqs[node - s->nodes], hdr->message_id,
+            payload[0]);
+    }
+}
+
+/* Keeps a Hops Flow with the capabilities of the link it came over. */
+static void on_hops_flow(sxs_uint32_t from, const gnut_msg_hdr_t *hdr,
+    const gnut_vmsg_t *vm, void *arg) {
+
+    sim_t *s;
+
+    s = (sim_t *)arg;
+    gnut_caps_vmsg(&s->caps[s->link_off[s->cur] + from - 1], vm);
+}
+
+/* Sends a reply to a request, back over the link it arrived on. */
+static void reply(sim_t *s, sxs_uint32_t from, const gnut_msg_hdr_t *req,
+    unsigned char type, const unsigned char *payload, sxs_uint32_t len) {
+
+    gnut_msg_hdr_t hdr;
+    gnut_enc_msg_t *msg;
+
+    memcpy((void *)hdr.message_id, (const void *)req->message_id, 16);
+    hdr.type = type;
+    hdr.ttl = req->hops + 1;
+    hdr.hops = 0;
+    hdr.pl_len = len;
+    msg = encode(s, &hdr, payload);
+    send_link(s, s->cur, from, msg);
+    gnut_enc_msg_unref(msg);
+}
+
+static void on_deliver(gnut_node_t *node, sxs_uint32_t from,
+    const gnut_msg_hdr_t *hdr, const unsigned char *payload, void *arg) {
+
+    sim_t *s;
+    unsigned char pl[GNUT_PUSH_PAYLOAD_LEN > HIT_LEN ?
+        GNUT_PUSH_PAYLOAD_LEN : HIT_LEN];
+    gnut_msg_hdr_t push;
+    gnut_enc_msg_t *msg;
+
+    s = (sim_t *)arg;
+    memset(pl, 0, sizeof(pl));
+    switch (hdr->type) {
+        case GNUT_MSG_PING:
+            reply(s, from, hdr, GNUT_MSG_PONG, pl, GNUT_PONG_PAYLOAD_LEN);
+            break;
+        case GNUT_MSG_QUERY:
+            if (rnd_unit(s) < s->hit_prob) {
+                pl[0] = 1;
+                memcpy((void *)(pl + HIT_LEN - 16),
+                    (const void *)node->servent_id, 16);
+                if (s->oobs == NULL || !gnut_oob_wanted(hdr, payload) ||
+                    gnut_oob_offer(s->oobs[s->cur], hdr->message_id, pl,
+                    HIT_LEN) != GNUT_SUCCESS) {
+                    reply(s, from, hdr, GNUT_MSG_QUERY_HIT, pl, HIT_LEN);
+                }
+                s->hits_sent++;
+            }
+            break;
+        case GNUT_MSG_PONG:
+            s->pongs_home++;
+            break;
+        case GNUT_MSG_QUERY_HIT:
+            count_hit(s, hdr);
+            if (rnd_unit(s) < s->push_prob) {
+                memset(&push, 0, sizeof(push));
+                new_guid(s, push.message_id,
+                    ((gnut_uint64_t)1 << 63) | s->guid_seq++);
+                push.type = GNUT_MSG_PUSH;
+                push.ttl = hdr->hops + 1;
+                push.pl_len = GNUT_PUSH_PAYLOAD_LEN;
+                memcpy((void *)pl, (const void *)(payload + hdr->pl_len - 16),
+                    16);
+                msg = encode(s, &push, pl);
+                send_link(s, s->cur, from, msg);
+                gnut_enc_msg_unref(msg);
+                s->pushes++;
+            }
+            break;
+        case GNUT_MSG_PUSH:
+            s->pushes_home++;
+            break;
+        default:
+            break;
+    }
+}
+
+/* Originates a Query or a Ping at a random node, sent on all links, or
+ * for a Query searched for dynamically, on a few at a time. */
+static void originate(sim_t *s, unsigned char type, unsigned char ttl) {
+    unsigned char query_pl[] = { 0, 0, 's', 'i', 'm', 0 };
+    gnut_msg_hdr_t hdr;
+    gnut_enc_msg_t *msg;
+    query_t *qs;
+    sxs_uint32_t node, conn, num;
+
+    node = (sxs_uint32_t)(rnd(s) % s->num_nodes);
+    memset(&hdr, 0, sizeof(hdr));
+    hdr.type = type;
+    hdr.ttl = ttl;
+    if (type == GNUT_MSG_QUERY) {
+        if (s->num_queries == s->queries_cap) {
+            s->queries_cap = (s->queries_cap > 0) ? s->queries_cap * 2 : 1024;
+            qs = (query_t *)realloc(s->queries,
+                s->queries_cap * sizeof(query_t));
+            if (qs == NULL) {
+                fprintf(stderr, "out of memory\n");
+                exit(1);
+            }
+            s->queries = qs;
+        }
+        new_guid(s, hdr.message_id, s->num_queries);
+        s->queries[s->num_queries].sent = s->now;
+        s->queries[s->num_queries].first_hit = 0;
+        s->queries[s->num_queries].hits = 0;
+        s->num_queries++;
+        hdr.pl_len = sizeof(query_pl);
+    } else {
+        new_guid(s, hdr.message_id,
+            ((gnut_uint64_t)1 << 63) | s->guid_seq++);
+        s->pings++;
+    }
+
+    if (type == GNUT_MSG_QUERY && s->oobs != NULL) {
+        query_pl[1] = (GNUT_QUERY_SPEED_FLAGS | GNUT_QUERY_SPEED_OOB) >> 8;
+        gnut_msg_id_set_oob_addr(hdr.message_id, node + 1, OOB_PORT);
+        gnut_oob_request(s->oobs[node], hdr.message_id, OOB_WANTED);
+    }
+    gnut_node_originate(&s->nodes[node], &hdr);
+    s->cur = node;
+    if (type == GNUT_MSG_QUERY && s->dynqs != NULL &&
+        gnut_dynq_start(s->dynqs[node], GNUT_ROUTE_SELF, &hdr,
+        query_pl) == GNUT_SUCCESS) {
+        return;
+    }
+    msg = encode(s, &hdr, query_pl);
+    num = s->link_off[node + 1] - s->link_off[node];
+    for (conn = 1; conn <= num; conn++) {
+        send_link(s, node, conn, msg);
+    }
+    gnut_enc_msg_unref(msg);
+}
+
+static void deliver(sim_t *s, const event_t *ev) {
+    gnut_msg_hdr_t hdr;
+
+    gnut_decode_msg_hdr(ev->msg->data, &hdr);
+    s->digest = (s->digest ^ ev->when ^ ((gnut_uint64_t)ev->node << 32) ^
+        hdr.type) * 0x100000001b3ULL;
+    s->cur = ev->node;
+    if (ev->udp_from != 0) {
+        gnut_oob_recv(s->oobs[ev->node], ev->udp_from, OOB_PORT,
+            ev->msg->data, ev->msg->len);
+        return;
+    }
+    if (s->flows != NULL && hdr.type == GNUT_MSG_QUERY &&
+        hdr.hops >= s->flows[ev->node]) {
+        s->flow_drops++;
+        return;
+    }
+    gnut_node_dispatch(&s->nodes[ev->node], ev->from, &hdr,
+        ev->msg->data + GNUT_MSG_HDR_LEN);
+}
+
+/* Builds a random graph in which each node opens degree / 2 links to
+ * distinct random nodes, so the mean degree is 'degree'. */
+static int build_topology(sim_t *s, sxs_uint32_t degree, sxs_uint32_t lat_min,
+    sxs_uint32_t lat_max) {
+
+    sxs_uint32_t *ea, *eb, *fill, num_edges, half, i, j, e, a, b, k;
+    sxs_uint32_t lat;
+    int dup;
+
+    half = (degree + 1) / 2;
+    if (half >= s->num_nodes) {
+        half = s->num_nodes - 1;
+    }
+    ea = (sxs_uint32_t *)malloc((size_t)s->num_nodes * half *
+        sizeof(sxs_uint32_t));
+    eb = (sxs_uint32_t *)malloc((size_t)s->num_nodes * half *
+        sizeof(sxs_uint32_t));
+    s->link_off = (sxs_uint32_t *)calloc(s->num_nodes + 1,
+        sizeof(sxs_uint32_t));
+    fill = (sxs_uint32_t *)calloc(s->num_nodes, sizeof(sxs_uint32_t));
+    if (ea == NULL || eb == NULL || s->link_off == NULL || fill == NULL) {
+        return -1;
+    }
+
+    num_edges = 0;
+    for (i = 0; i < s->num_nodes; i++) {
+        for (j = 0; j < half; j++) {
+            /* Duplicates are only checked against this node's picks,
+             * so a pair may rarely be linked twice, as on a real
+             * network where both sides dial each other. */
+            do {
+                b = (sxs_uint32_t)(rnd(s) % s->num_nodes);
+                dup = (b == i);
+                for (k = 0; k < j && !dup; k++) {
+                    dup = (eb[num_edges - j + k] == b);
+                }
+            } while (dup);
+            ea[num_edges] = i;
+            eb[num_edges] = b;
+            num_edges++;
+            s->link_off[i + 1]++;
+            s->link_off[b + 1]++;
+        }
+    }
+    for (i = 0; i < s->num_nodes; i++) {
+        s->link_off[i + 1] += s->link_off[i];
+    }
+    s->num_links = s->link_off[s->num_nodes];
+    s->links = (link_t *)malloc((size_t)s->num_links * sizeof(link_t));
+    if (s->links == NULL) {
+        return -1;
+    }
+    for (e = 0; e < num_edges; e++) {
+        a = ea[e];
+        b = eb[e];
+        lat = lat_min + (sxs_uint32_t)(rnd(s) % (lat_max - lat_min + 1));
+        i = fill[a]++;
+        j = fill[b]++;
+        s->links[s->link_off[a] + i].peer = b;
+        s->links[s->link_off[a] + i].rev = j + 1;
+        s->links[s->link_off[a] + i].lat = lat;
+        s->links[s->link_off[b] + j].peer = a;
+        s->links[s->link_off[b] + j].rev = i + 1;
+        s->links[s->link_off[b] + j].lat = lat;
+    }
+    free(ea);
+    free(eb);
+    free(fill);
+
+    return 0;
+}
+
+static int cmp_double(const void *a, const void *b) {
+    double x, y;
+
+    x = *(const double *)a;
+    y = *(const double *)b;
+    return (x < y) ? -1 : (x > y) ? 1 : 0;
+}
+
+static void print_dist(const char *metric, double *v, sxs_uint32_t n) {
+    double sum;
+    sxs_uint32_t i;
+
+    if (n == 0) {
+        printf("sim_dist\tmetric=%s\tn=0\n", metric);
+        return;
+    }
+    sum = 0;
+    for (i = 0; i < n; i++) {
+        sum += v[i];
+    }
+    qsort(v, n, sizeof(double), cmp_double);
+    printf("sim_dist\tmetric=%s\tn=%u\tmin=%.0f\tp50=%.0f\tp90=%.0f"
+        "\tp99=%.0f\tmax=%.0f\tmean=%.1f\n", metric, n, v[0], v[n / 2],
+        v[(sxs_uint32_t)(n * 0.9)], v[(sxs_uint32_t)(n * 0.99)], v[n - 1],
+        sum / n);
+}
+
+static sxs_uint32_t route_used(const gnut_route_t *rt) {
+    return rt->gens[0].len + rt->gens[1].len;
+}
+
+static size_t route_bytes(const gnut_route_t *rt) {
+    return 2 * ((size_t)rt->mask + 1) * sizeof(gnut_route_ent_t);
+}
+
+static void report(sim_t *s, double wall, gnut_uint64_t virt, int verbose) {
+    gnut_node_stats_t tot;
+    gnut_dynq_stats_t ds, dt;
+    gnut_oob_stats_t os, ot;
+    gnut_node_t *node;
+    struct rusage ru;
+    double *v, *w;
+    gnut_uint64_t rx, fwd, rotations, answered;
+    size_t mem;
+    sxs_uint32_t i, n, t;
+
+    memset(&tot, 0, sizeof(tot));
+    rotations = 0;
+    v = (double *)malloc((s->num_nodes + 1) * sizeof(double));
+    w = (double *)malloc((s->num_queries + 1) * sizeof(double));
+    if (v == NULL || w == NULL) {
+        fprintf(stderr, "out of memory\n");
+        exit(1);
+    }
+    for (i = 0; i < s->num_nodes; i++) {
+        node = &s->nodes[i];
+        for (t = 0; t < GNUT_NODE_NUM_T; t++) {
+            tot.rx[t] += node->stats.rx[t];
+            tot.rx_bytes[t] += node->stats.rx_bytes[t];
+            tot.forwarded[t] += node->stats.forwarded[t];
+            tot.delivered[t] += node->stats.delivered[t];
+        }
+        tot.dropped_dup += node->stats.dropped_dup;
+        tot.dropped_ttl += node->stats.dropped_ttl;
+        tot.dropped_unroutable += node->stats.dropped_unroutable;
+        tot.dropped_malformed += node->stats.dropped_malformed;
+        rotations += node->pings.rotations + node->queries.rotations +
+            node->pushes.rotations;
+    }
+
+    printf("sim\tnodes=%u\tlinks=%u\tvirtual_secs=%.3f\twall_secs=%.3f"
+        "\tevents=%llu\tevents_per_sec=%.0f\tmax_queued=%llu"
+        "\tencoded=%llu\tdigest=%016llx\n", s->num_nodes, s->num_links / 2,
+        virt / 1e6, wall, (unsigned long long)s->events,
+        (wall > 0) ? s->events / wall : 0.0,
+        (unsigned long long)s->max_heap, (unsigned long long)s->enc_msgs,
+        (unsigned long long)s->digest);
+
+    n = 0;
+    answered = 0;
+    for (i = 0; i < s->num_queries; i++) {
+        if (s->queries[i].hits > 0) {
+            answered++;
+            w[n++] = (s->queries[i].first_hit - s->queries[i].sent) / 1e3;
+        }
+    }
+    printf("sim_traffic\tqueries=%u\tanswered=%llu\tsuccess_rate=%.4f"
+        "\thits_sent=%llu\thits_home=%llu\tpings=%llu\tpongs_home=%llu"
+        "\tpushes=%llu\tpushes_home=%llu\n", s->num_queries,
+        (unsigned long long)answered,
+        s->num_queries > 0 ? (double)answered / s->num_queries : 0.0,
+        (unsigned long long)s->hits_sent, (unsigned long long)s->hits_home,
+        (unsigned long long)s->pings, (unsigned long long)s->pongs_home,
+        (unsigned long long)s->pushes, (unsigned long long)s->pushes_home);
+    print_dist("first_hit_ms", w, n);
+
+    rx = tot.rx[GNUT_NODE_T_PING] + tot.rx[GNUT_NODE_T_QUERY];
+    printf("sim_drops\tdup=%llu\tdup_rate=%.4f\tttl=%llu\tunroutable=%llu"
+        "\tmalformed=%llu\troute_rotations=%llu\n",
+        (unsigned long long)tot.dropped_dup,
+        rx > 0 ? (double)tot.dropped_dup / rx : 0.0,
+        (unsigned long long)tot.dropped_ttl,
+        (unsigned long long)tot.dropped_unroutable,
+        (unsigned long long)tot.dropped_malformed,
+        (unsigned long long)rotations);
+    if (s->dynqs != NULL) {
+        memset(&dt, 0, sizeof(dt));
+        for (i = 0; i < s->num_nodes; i++) {
+            gnut_dynq_stats(s->dynqs[i], &ds);
+            dt.started += ds.started;
+            for (t = 0; t < GNUT_DYNQ_NUM_DONE; t++) {
+                dt.done[t] += ds.done[t];
+            }
+            dt.steps += ds.steps;
+            dt.sends += ds.sends;
+            dt.results += ds.results;
+            dt.active += ds.active;
+        }
+        printf("sim_dynq\tstarted=%llu\ttarget=%llu\tpeers=%llu"
+            "\ttime=%llu\tactive=%u\tsteps=%llu\tsends=%llu"
+            "\tresults=%llu\n", (unsigned long long)dt.started,
+            (unsigned long long)dt.done[GNUT_DYNQ_DONE_TARGET],
+            (unsigned long long)dt.done[GNUT_DYNQ_DONE_PEERS],
+            (unsigned long long)dt.done[GNUT_DYNQ_DONE_TIME], dt.active,
+            (unsigned long long)dt.steps, (unsigned long long)dt.sends,
+            (unsigned long long)dt.results);
+    }
+    if (s->oobs != NULL) {
+        memset(&ot, 0, sizeof(ot));
+        for (i = 0; i < s->num_nodes; i++) {
+            gnut_oob_stats(s->oobs[i], &os);
+            ot.offers += os.offers;
+            ot.hits_sent += os.hits_sent;
+            ot.hit_bytes_sent += os.hit_bytes_sent;
+            ot.expired += os.expired;
+            ot.acks_sent += os.acks_sent;
+            ot.unsolicited += os.unsolicited;
+        }
+        printf("sim_oob\toffers=%llu\tacks=%llu\thits=%llu\thit_bytes=%llu"
+            "\texpired=%llu\tunsolicited=%llu\tudp_msgs=%llu"
+            "\tudp_bytes=%llu\n", (unsigned long long)ot.offers,
+            (unsigned long long)ot.acks_sent,
+            (unsigned long long)ot.hits_sent,
+            (unsigned long long)ot.hit_bytes_sent,
+            (unsigned long long)ot.expired,
+            (unsigned long long)ot.unsolicited,
+            (unsigned long long)s->udp_msgs,
+            (unsigned long long)s->udp_bytes);
+    }
+    if (s->caps != NULL) {
+        printf("sim_caps\tbusy=%u\tpruned=%llu\tpruned_bytes=%llu"
+            "\tflow_drops=%llu\n", s->busy, (unsigned long long)s->pruned,
+            (unsigned long long)s->pruned_bytes,
+            (unsigned long long)s->flow_drops);
+    }
+    for (t = 0; t < GNUT_NODE_T_OTHER; t++) {
+        printf("sim_type\ttype=%s\trx=%llu\trx_bytes=%llu\tforwarded=%llu"
+            "\tdelivered=%llu\n", type_names[t],
+            (unsigned long long)tot.rx[t],
+            (unsigned long long)tot.rx_bytes[t],
+            (unsigned long long)tot.forwarded[t],
+            (unsigned long long)tot.delivered[t]);
+    }
+
+    for (i = 0; i < s->num_nodes; i++) {
+        rx = 0;
+        for (t = 0; t < GNUT_NODE_NUM_T; t++) {
+            rx += s->nodes[i].stats.rx[t];
+        }
+        v[i] = (double)rx;
+    }
+    print_dist("rx_msgs", v, s->num_nodes);
+    for (i = 0; i < s->num_nodes; i++) {
+        fwd = 0;
+        for (t = 0; t < GNUT_NODE_NUM_T; t++) {
+            fwd += s->nodes[i].stats.forwarded[t];
+        }
+        v[i] = (double)fwd;
+    }
+    print_dist("fwd_msgs", v, s->num_nodes);
+    for (i = 0; i < s->num_nodes; i++) {
+        node = &s->nodes[i];
+        v[i] = route_used(&node->pings) + route_used(&node->queries) +
+            route_used(&node->pushes);
+    }
+    print_dist("route_entries", v, s->num_nodes);
+
+    mem = 0;
+    for (i = 0; i < s->num_nodes; i++) {
+        node = &s->nodes[i];
+        v[i] = (double)(sizeof(gnut_node_t) + route_bytes(&node->pings) +
+            route_bytes(&node->queries) + route_bytes(&node->pushes) +
+            (s->link_off[i + 1] - s->link_off[i]) * sizeof(link_t));
+        mem += (size_t)v[i];
+    }
+    getrusage(RUSAGE_SELF, &ru);
+    printf("sim_mem\tnode_bytes=%.0f\ttotal_node_bytes=%llu"
+        "\tmax_rss_kb=%ld\n", v[0], (unsigned long long)mem, ru.ru_maxrss);
+
+    if (verbose) {
+        for (i = 0; i < s->num_nodes; i++) {
+            node = &s->nodes[i];
+            rx = fwd = 0;
+            for (t = 0; t < GNUT_NODE_NUM_T; t++) {
+                rx += node->stats.rx[t];
+                fwd += node->stats.forwarded[t];
+            }
+            printf("sim_node\tid=%u\tdegree=%u\trx=%llu\tforwarded=%llu"
+                "\tdup=%llu\tunroutable=%llu\troute_entries=%u\n", i,
+                s->link_off[i + 1] - s->link_off[i], (unsigned long long)rx,
+                (unsigned long long)fwd,
+                (unsigned long long)node->stats.dropped_dup,
+                (unsigned long long)node->stats.dropped_unroutable,
+                route_used(&node->pings) + route_used(&node->queries) +
+                route_used(&node->pushes));
+        }
+    }
+    free(v);
+    free(w);
+}
+
+/* Gives every node a dynamic query controller with all its links as
+ * neighbours, waiting per TTL for a round trip over the slowest link. */
+static int setup_dynq(sim_t *s, sxs_uint32_t degree, int ttl,
+    sxs_uint32_t lat_max, sxs_uint32_t target) {
+
+    gnut_dynq_cfg_t cfg;
+    sxs_uint32_t i, conn, num;
+
+    s->dynqs = (gnut_dynq_t **)calloc(s->num_nodes, sizeof(gnut_dynq_t *));
+    if (s->dynqs == NULL) {
+        return -1;
+    }
+    for (i = 0; i < s->num_nodes; i++) {
+        gnut_dynq_cfg_init(&cfg, on_dynq_send, (void *)&s->nodes[i]);
+        cfg.target = target;
+        cfg.max_ttl = (unsigned char)ttl;
+        cfg.degree = degree;
+        cfg.hop_wait = 2 * (gnut_uint64_t)lat_max;
+        if (gnut_dynq_new(&s->dynqs[i], &cfg, &s->wheel) != GNUT_SUCCESS) {
+            return -1;
+        }
+        num = s->link_off[i + 1] - s->link_off[i];
+        for (conn = 1; conn <= num; conn++) {
+            if (gnut_dynq_add_conn(s->dynqs[i], conn, 0) != GNUT_SUCCESS) {
+                return -1;
+            }
+        }
+        gnut_node_set_dynq(&s->nodes[i], s->dynqs[i]);
+    }
+    return 0;
+}
+
+/* Gives every node an out of band Query Hit handler. */
+static int setup_oob(sim_t *s) {
+    gnut_oob_cfg_t cfg;
+    sxs_uint32_t i;
+
+    s->oobs = (gnut_oob_t **)calloc(s->num_nodes, sizeof(gnut_oob_t *));
+    if (s->oobs == NULL) {
+        return -1;
+    }
+    for (i = 0; i < s->num_nodes; i++) {
+        gnut_oob_cfg_init(&cfg, on_oob_send, on_oob_deliver,
+            (void *)&s->nodes[i]);
+        if (gnut_oob_new(&s->oobs[i], &cfg, &s->wheel) != GNUT_SUCCESS) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/* Makes the fraction 'frac' of nodes busy, each sending a Hops Flow of
+ * 'hops' on all its links, and has every node keep those it gets. */
+static int setup_busy(sim_t *s, double frac, unsigned char hops) {
+    unsigned char pl[GNUT_VMSG_HDR_LEN + 1];
+    gnut_msg_hdr_t hdr;
+    gnut_enc_msg_t *msg;
+    sxs_uint32_t i, conn, num, pl_len;
+
+    s->caps = (gnut_caps_t *)malloc((size_t)s->num_links *
+        sizeof(gnut_caps_t));
+    s->flows = (unsigned char *)malloc(s->num_nodes);
+    if (s->caps == NULL || s->flows == NULL) {
+        return -1;
+    }
+    for (i = 0; i < s->num_links; i++) {
+        gnut_caps_init(&s->caps[i]);
+    }
+    vmsgs[GNUT_VMSG_K_HOPS_FLOW] = on_hops_flow;
+    gnut_vmsg_build_known(GNUT_VMSG_K_HOPS_FLOW, &hops, 1, pl, sizeof(pl),
+        &pl_len);
+    for (i = 0; i < s->num_nodes; i++) {
+        gnut_node_set_vmsgs(&s->nodes[i], vmsgs);
+        s->flows[i] = GNUT_CAPS_NO_LIMIT;
+        if (rnd_unit(s) >= frac) {
+            continue;
+        }
+        s->flows[i] = hops;
+        s->busy++;
+        memset(&hdr, 0, sizeof(hdr));
+        new_guid(s, hdr.message_id, ((gnut_uint64_t)1 << 63) | s->guid_seq++);
+        hdr.type = GNUT_MSG_VENDOR;
+        hdr.ttl = 1;
+        hdr.pl_len = pl_len;
+        msg = encode(s, &hdr, pl);
+        num = s->link_off[i + 1] - s->link_off[i];
+        for (conn = 1; conn <= num; conn++) {
+            send_link(s, i, conn, msg);
+        }
+        gnut_enc_msg_unref(msg);
+    }
+    return 0;
+}
+
+static void advance_wheel(sim_t *s) {
+    if (s->use_wheel) {
+        gnut_twheel_advance(&s->wheel, s->now);
+    }
+}
+
+/* Returns when the next Query, Ping or delivery is due. */
+static gnut_uint64_t next_due(const sim_t *s, gnut_uint64_t next_query,
+    gnut_uint64_t next_ping, gnut_uint64_t end) {
+
+    gnut_uint64_t due;
+
+    due = (gnut_uint64_t)-1;
+    if (next_query < end) {
+        due = next_query;
+    }
+    if (next_ping < end && next_ping < due) {
+        due = next_ping;
+    }
+    if (s->heap_len > 0 && s->heap[0].when < due) {
+        due = s->heap[0].when;
+    }
+    return due;
+}
+
+static double now_sec(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int main(int argc, char *argv[]) {
+    sim_t s;
+    event_t ev;
+    const char *colon;
+    gnut_uint64_t end, next_query, next_ping, seed, tick;
+    double qps, pps, busy, start;
+    sxs_uint32_t degree, route_capacity, lat_min, lat_max, target, i, j;
+    int ttl, oob, flow, verbose, c;
+
+    memset(&s, 0, sizeof(s));
+    s.num_nodes = 10000;
+    degree = 8;
+    seed = 1;
+    end = 30000000;
+    qps = 10;
+    pps = 1;
+    ttl = GNUT_NODE_DEF_MAX_TTL;
+    s.hit_prob = 0.001;
+    s.push_prob = 0.1;
+    route_capacity = 128;
+    lat_min = 20000;
+    lat_max = 200000;
+    target = 0;
+    oob = 0;
+    busy = 0;
+    flow = 0;
+    verbose = 0;
+    while ((c = getopt(argc, argv, "n:d:s:T:q:p:t:h:P:R:l:D:OF:v")) != -1) {
+        switch (c) {
+            case 'n':
+                s.num_nodes = (sxs_uint32_t)atol(optarg);
+                break;
+            case 'd':
+                degree = (sxs_uint32_t)atol(optarg);
+                break;
+            case 's':
+                seed = (gnut_uint64_t)atoll(optarg);
+                break;
+            case 'T':
+                end = (gnut_uint64_t)(atof(optarg) * 1e6);
+                break;
+            case 'q':
+                qps = atof(optarg);
+                break;
+            case 'p':
+                pps = atof(optarg);
+                break;
+            case 't':
+                ttl = atoi(optarg);
+                break;
+            case 'h':
+                s.hit_prob = atof(optarg);
+                break;
+            case 'P':
+                s.push_prob = atof(optarg);
+                break;
+            case 'R':
+                route_capacity = (sxs_uint32_t)atol(optarg);
+                break;
+            case 'l':
+                lat_min = (sxs_uint32_t)(atof(optarg) * 1000);
+                colon = strchr(optarg, ':');
+                lat_max = (colon != NULL) ?
+                    (sxs_uint32_t)(atof(colon + 1) * 1000) : lat_min;
+                break;
+            case 'D':
+                target = (sxs_uint32_t)atol(optarg);
+                break;
+            case 'O':
+                oob = 1;
+                break;
+            case 'F':
+                busy = atof(optarg);
+                colon = strchr(optarg, ':');
+                flow = (colon != NULL) ? atoi(colon + 1) : 0;
+                break;
+            case 'v':
+                verbose = 1;
+                break;
+            default:
+                optind = argc + 1;
+                break;
+        }
+    }
+    if (optind != argc || s.num_nodes < 2 || degree < 1 || ttl < 1 ||
+        ttl > 255 || lat_max < lat_min || route_capacity == 0 ||
+        busy < 0 || flow < 0 || flow >= GNUT_CAPS_NO_LIMIT) {
+        fprintf(stderr, "usage: %s [-n nodes] [-d degree] [-s seed] "
+            "[-T secs] [-q qps] [-p pps] [-t ttl] [-h hit_prob] "
+            "[-P push_prob] [-R route_capacity] [-l min_ms:max_ms] "
+            "[-D target] [-O] [-F frac:hops] [-v]\n",
+            argv[0]);
+        return 2;
+    }
+    s.rng = seed * 0x9e3779b97f4a7c15ULL + 1;
+    s.digest = 0xcbf29ce484222325ULL;
+
+    s.nodes = (gnut_node_t *)calloc(s.num_nodes, sizeof(gnut_node_t));
+    if (s.nodes == NULL || build_topology(&s, degree, lat_min,
+        lat_max) != 0) {
+        fprintf(stderr, "out of memory\n");
+        return 1;
+    }
+    for (i = 0; i < s.num_nodes; i++) {
+        if (gnut_node_init(&s.nodes[i], route_capacity, on_forward,
+            on_deliver, &s) != GNUT_SUCCESS) {
+            fprintf(stderr, "out of memory at node %u\n", i);
+            return 1;
+        }
+        /* Servent IDs come from the seed too, for reproducibility. */
+        for (j = 0; j < 16; j += 8) {
+            seed = rnd(&s);
+            memcpy((void *)(s.nodes[i].servent_id + j), (const void *)&seed,
+                8);
+        }
+    }
+    s.use_wheel = (target > 0 || oob);
+    if ((s.use_wheel && gnut_twheel_init(&s.wheel, WHEEL_TICK, 0,
+        0) != GNUT_SUCCESS) || (target > 0 && setup_dynq(&s, degree, ttl,
+        lat_max, target) != 0) || (oob && setup_oob(&s) != 0) ||
+        (busy > 0 && setup_busy(&s, busy, (unsigned char)flow) != 0)) {
+        fprintf(stderr, "out of memory\n");
+        return 1;
+    }
+
+    start = now_sec();
+    next_query = (qps > 0) ?
+        (gnut_uint64_t)(-log(1.0 - rnd_unit(&s)) / qps * 1e6) : end;
+    next_ping = (pps > 0) ?
+        (gnut_uint64_t)(-log(1.0 - rnd_unit(&s)) / pps * 1e6) : end;
+    for (;;) {
+        /* Timers due before anything else is fire first. */
+        if (s.use_wheel && s.wheel.num_armed > 0) {
+            tick = s.wheel.cur * s.wheel.tick;
+            if (tick <= next_due(&s, next_query, next_ping, end)) {
+                s.now = tick;
+                gnut_twheel_advance(&s.wheel, s.now);
+                continue;
+            }
+        }
+        if (next_query < end && next_query <= next_ping &&
+            (s.heap_len == 0 || next_query <= s.heap[0].when)) {
+            s.now = next_query;
+            advance_wheel(&s);
+            originate(&s, GNUT_MSG_QUERY, (unsigned char)ttl);
+            next_query += (gnut_uint64_t)(-log(1.0 - rnd_unit(&s)) / qps *
+                1e6) + 1;
+        } else if (next_ping < end && (s.heap_len == 0 ||
+            next_ping <= s.heap[0].when)) {
+            s.now = next_ping;
+            advance_wheel(&s);
+            originate(&s, GNUT_MSG_PING, (unsigned char)ttl);
+            next_ping += (gnut_uint64_t)(-log(1.0 - rnd_unit(&s)) / pps *
+                1e6) + 1;
+        } else if (s.heap_len > 0) {
+            heap_pop(&s, &ev);
+            s.now = ev.when;
+            advance_wheel(&s);
+            s.events++;
+            deliver(&s, &ev);
+            gnut_enc_msg_unref(ev.msg);
+        } else {
+            break;
+        }
+    }
+
+    report(&s, now_sec() - start, s.now, verbose);
+
+    for (i = 0; i < s.num_nodes; i++) {
+        gnut_node_destroy(&s.nodes[i]);
+        if (s.dynqs != NULL) {
+            gnut_dynq_free(s.dynqs[i]);
+        }
+        if (s.oobs != NULL) {
+            gnut_oob_free(s.oobs[i]);
+        }
+    }
+    if (s.use_wheel) {
+        gnut_twheel_destroy(&s.wheel);
+    }
+    free(s.dynqs);
+    free(s.oobs);
+    free(s.caps);
+    free(s.flows);
+    free(s.nodes);
+    free(s.links);
+    free(s.link_off);
+    free(s.heap);
+    free(s.queries);
+
+    return 0;
+}